@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+#
+# Benchmark the cgi programs action by action against the simulated network
+# written by JIPSim. Every action is served from the snapshot and history in
+# /tmp, so the time measured is the programs' own rather than the network's.
+# This is the training run of the pgo build variant, and report.py uses it
+# to compare variants.
+#
+# Usage: bench.py [--runs N] <directory holding the programs>
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+# Border router and sensor of the simulated network, see SimNetwork.c
+BR_ADDRESS = '::1'
+SENSOR_ADDRESS = 'fd04:bd3:80e8:2::2'
+
+# Request mix: (action name, program, query string)
+ACTIONS = [
+    ('version',         'JIP.cgi',          'action=getVersion'),
+    ('discover',        'JIP.cgi',          'action=discover&BRaddress=%s&refresh=no' % BR_ADDRESS),
+    ('discover-cbor',   'JIP.cgi',          'action=discover&BRaddress=%s&refresh=no&format=cbor' % BR_ADDRESS),
+    ('history-hour',    'JIP.cgi',          'action=history&nodeaddress=%s&mib=Environment&var=Temperature&range=3600'
+                                            % SENSOR_ADDRESS),
+    ('history-day',     'JIP.cgi',          'action=history&nodeaddress=%s&mib=Environment&var=Temperature&range=86400'
+                                            '&points=200' % SENSOR_ADDRESS),
+    ('devices-view',    'SmartDevices.cgi', 'Mode=View&BRaddress=%s' % BR_ADDRESS),
+    ('devices-groups',  'SmartDevices.cgi', 'Mode=GroupState&BRaddress=%s' % BR_ADDRESS),
+]
+
+
+def cgi_environment(program, query):
+    env = dict(os.environ)
+    env['GATEWAY_INTERFACE'] = 'CGI/1.1'
+    env['REQUEST_METHOD'] = 'GET'
+    env['QUERY_STRING'] = query
+    env['SCRIPT_NAME'] = '/cgi-bin/' + os.path.basename(program)
+    return env
+
+
+def run_once(program, env):
+    start = time.perf_counter()
+    subprocess.run([program], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                   stdin=subprocess.DEVNULL, env=env)
+    return time.perf_counter() - start
+
+
+def percentile(samples, fraction):
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * fraction))]
+
+
+def bench(directory, runs):
+    """Time each action of the mix. Returns {action: [seconds, ...]}"""
+    results = {}
+    for name, program, query in ACTIONS:
+        program = os.path.abspath(os.path.join(directory, program))
+        if not os.path.exists(program):
+            continue
+        env = cgi_environment(program, query)
+        run_once(program, env)
+        results[name] = [run_once(program, env) for _ in range(runs)]
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark cgi actions against the simulated network')
+    parser.add_argument('--runs', type=int, default=100)
+    parser.add_argument('directory')
+    args = parser.parse_args()
+
+    results = bench(args.directory, args.runs)
+    print('%-16s %10s %10s %10s' % ('action', 'min ms', 'median ms', 'p90 ms'))
+    for name, _, _ in ACTIONS:
+        if name in results:
+            samples = results[name]
+            print('%-16s %10.3f %10.3f %10.3f' % (name, min(samples) * 1000.0,
+                                                   percentile(samples, 0.5) * 1000.0,
+                                                   percentile(samples, 0.9) * 1000.0))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
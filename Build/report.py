@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+#
+# Compare build variants: the size of each program, its startup time from
+# exec to first byte, and the latency of each action of the benchmarks.
+# Run JIPSim first so that the actions have a simulated network to serve.
+#
+# Usage: report.py [--runs N] <variant directory> [<variant directory> ...]
+#
+
+import argparse
+import os
+import sys
+
+import bench
+import ttfb
+
+PROGRAMS = ['JIP.cgi', 'Browser.cgi', 'SmartDevices.cgi', 'JIPd', 'JIPWeb']
+
+
+def median(samples):
+    return bench.percentile(samples, 0.5)
+
+
+def table(title, unit, variants, rows):
+    """Print rows of {variant: value}, each relative to the first variant"""
+    print('')
+    print('%s (%s)' % (title, unit))
+    print('%-18s' % '' + ''.join('%18s' % os.path.basename(v) for v in variants))
+    for name, values in rows:
+        base = values.get(variants[0])
+        cells = []
+        for variant in variants:
+            value = values.get(variant)
+            if value is None:
+                cells.append('%18s' % '-')
+            elif base and variant != variants[0]:
+                cells.append('%10.3f %+6.1f%%' % (value, (value - base) * 100.0 / base))
+            else:
+                cells.append('%18.3f' % value)
+        print('%-18s' % name + ''.join(cells))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare build variants')
+    parser.add_argument('--runs', type=int, default=200)
+    parser.add_argument('variants', nargs='+')
+    args = parser.parse_args()
+
+    sizes = []
+    for program in PROGRAMS:
+        values = {}
+        for variant in args.variants:
+            path = os.path.join(variant, program)
+            if os.path.exists(path):
+                values[variant] = os.path.getsize(path) / 1024.0
+        sizes.append((program, values))
+    table('Binary size', 'KiB', args.variants, sizes)
+
+    startup = []
+    for program in PROGRAMS[:3]:
+        values = {}
+        for variant in args.variants:
+            path = os.path.abspath(os.path.join(variant, program))
+            if os.path.exists(path):
+                env = bench.cgi_environment(path, 'action=getVersion')
+                ttfb.first_byte(path, env)
+                values[variant] = median([ttfb.first_byte(path, env) for _ in range(args.runs)]) * 1000.0
+        startup.append((program, values))
+    table('Startup, exec to first byte', 'median ms', args.variants, startup)
+
+    results = dict((variant, bench.bench(variant, args.runs)) for variant in args.variants)
+    latency = []
+    for name, _, _ in bench.ACTIONS:
+        latency.append((name, dict((variant, median(results[variant][name]) * 1000.0)
+                                   for variant in args.variants if name in results[variant])))
+    table('Action latency', 'median ms', args.variants, latency)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
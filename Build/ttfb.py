@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+#
+# Measure the time from exec to the first byte of output of cgi programs,
+# the latency a web server adds to every request by starting the program.
+# Each program is run as the web server would run it, with a CGI
+# environment for a request that does not touch the network, and timed
+# until its first byte arrives on stdout.
+#
+# Usage: ttfb.py [--runs N] [--query QUERY_STRING] [--library-path DIR]
+#                <program> [<program> ...]
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+
+def first_byte(program, env):
+    start = time.perf_counter()
+    proc = subprocess.Popen([program], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                            stdin=subprocess.DEVNULL, env=env)
+    proc.stdout.read(1)
+    elapsed = time.perf_counter() - start
+    proc.stdout.read()
+    proc.wait()
+    return elapsed
+
+
+def percentile(samples, fraction):
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * fraction))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Time from exec to first byte of cgi programs')
+    parser.add_argument('--runs', type=int, default=200)
+    parser.add_argument('--query', default='action=getVersion')
+    parser.add_argument('--library-path', default=None,
+                        help='directory added to LD_LIBRARY_PATH, for the Zeroconf plugin')
+    parser.add_argument('programs', nargs='+')
+    args = parser.parse_args()
+
+    print('%-32s %10s %10s %10s %10s' % ('program', 'size', 'min ms', 'median ms', 'p90 ms'))
+    for name in args.programs:
+        program = os.path.abspath(name)
+        env = dict(os.environ)
+        env['GATEWAY_INTERFACE'] = 'CGI/1.1'
+        env['REQUEST_METHOD'] = 'GET'
+        env['QUERY_STRING'] = args.query
+        env['SCRIPT_NAME'] = '/cgi-bin/' + os.path.basename(program)
+        if args.library_path:
+            env['LD_LIBRARY_PATH'] = os.pathsep.join(
+                p for p in (os.path.abspath(args.library_path), env.get('LD_LIBRARY_PATH')) if p)
+
+        # Warm the page cache so that the runs measure startup, not disk
+        first_byte(program, env)
+        samples = [first_byte(program, env) for _ in range(args.runs)]
+
+        print('%-32s %10d %10.3f %10.3f %10.3f' % (
+            name, os.path.getsize(os.path.realpath(program)),
+            min(samples) * 1000.0, percentile(samples, 0.5) * 1000.0, percentile(samples, 0.9) * 1000.0))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,501 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          History aggregation kernels
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Aggregate.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AGGREGATE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AGGREGATE_NEON
+#endif
+
+//#define DEBUG_AGGREGATE
+
+#ifdef DEBUG_AGGREGATE
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_AGGREGATE */
+
+
+/** Finds the point in [u32First, u32Last) making the largest triangle, by \ref u32AggregateLTTB */
+typedef uint32_t (*tprLargestTriangle)(const float *pfX, const float *pfY, uint32_t u32First, uint32_t u32Last,
+                                       float fA, float fB, float fC);
+
+/** Finds the sum of a column, by \ref u32AggregateLTTB */
+typedef void (*tprSumFloat)(const float *pfValues, uint32_t u32Count, tsAggregateFloat *psResult);
+
+
+const char *pcAggregateKernel(void)
+{
+#if defined(AGGREGATE_SSE2)
+    return "SSE2";
+#elif defined(AGGREGATE_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+
+void vAggregateFloatScalar(const float *pfValues, uint32_t u32Count, tsAggregateFloat *psResult)
+{
+    uint32_t i;
+    
+    memset(psResult, 0, sizeof(tsAggregateFloat));
+    if (u32Count == 0)
+    {
+        return;
+    }
+    
+    psResult->fMin = psResult->fMax = pfValues[0];
+    for (i = 0; i < u32Count; i++)
+    {
+        if (pfValues[i] < psResult->fMin)
+        {
+            psResult->fMin = pfValues[i];
+        }
+        if (pfValues[i] > psResult->fMax)
+        {
+            psResult->fMax = pfValues[i];
+        }
+        psResult->dSum += pfValues[i];
+    }
+    psResult->u32Count = u32Count;
+}
+
+
+void vAggregateFloat(const float *pfValues, uint32_t u32Count, tsAggregateFloat *psResult)
+{
+#if defined(AGGREGATE_SSE2) || defined(AGGREGATE_NEON)
+    float afMin[4], afMax[4], afSum[4];
+    uint32_t u32Vectors = u32Count & ~3;
+    uint32_t i, j;
+    
+    if (u32Count < 4)
+    {
+        vAggregateFloatScalar(pfValues, u32Count, psResult);
+        return;
+    }
+    
+    memset(psResult, 0, sizeof(tsAggregateFloat));
+    {
+#if defined(AGGREGATE_SSE2)
+        __m128 vMin = _mm_loadu_ps(pfValues);
+        __m128 vMax = vMin;
+        
+        for (i = 0; i < u32Vectors; i += AGGREGATE_BLOCK)
+        {
+            uint32_t u32End = (i + AGGREGATE_BLOCK < u32Vectors) ? i + AGGREGATE_BLOCK : u32Vectors;
+            __m128 vSum = _mm_setzero_ps();
+            
+            for (j = i; j < u32End; j += 4)
+            {
+                __m128 vValues = _mm_loadu_ps(&pfValues[j]);
+                vMin = _mm_min_ps(vMin, vValues);
+                vMax = _mm_max_ps(vMax, vValues);
+                vSum = _mm_add_ps(vSum, vValues);
+            }
+            _mm_storeu_ps(afSum, vSum);
+            psResult->dSum += ((double)afSum[0] + afSum[1]) + ((double)afSum[2] + afSum[3]);
+        }
+        _mm_storeu_ps(afMin, vMin);
+        _mm_storeu_ps(afMax, vMax);
+#else
+        float32x4_t vMin = vld1q_f32(pfValues);
+        float32x4_t vMax = vMin;
+        
+        for (i = 0; i < u32Vectors; i += AGGREGATE_BLOCK)
+        {
+            uint32_t u32End = (i + AGGREGATE_BLOCK < u32Vectors) ? i + AGGREGATE_BLOCK : u32Vectors;
+            float32x4_t vSum = vdupq_n_f32(0.0f);
+            
+            for (j = i; j < u32End; j += 4)
+            {
+                float32x4_t vValues = vld1q_f32(&pfValues[j]);
+                vMin = vminq_f32(vMin, vValues);
+                vMax = vmaxq_f32(vMax, vValues);
+                vSum = vaddq_f32(vSum, vValues);
+            }
+            vst1q_f32(afSum, vSum);
+            psResult->dSum += ((double)afSum[0] + afSum[1]) + ((double)afSum[2] + afSum[3]);
+        }
+        vst1q_f32(afMin, vMin);
+        vst1q_f32(afMax, vMax);
+#endif
+    }
+    
+    psResult->fMin = afMin[0];
+    psResult->fMax = afMax[0];
+    for (i = 1; i < 4; i++)
+    {
+        psResult->fMin = (afMin[i] < psResult->fMin) ? afMin[i] : psResult->fMin;
+        psResult->fMax = (afMax[i] > psResult->fMax) ? afMax[i] : psResult->fMax;
+    }
+    
+    /* Up to three left over */
+    for (i = u32Vectors; i < u32Count; i++)
+    {
+        psResult->fMin = (pfValues[i] < psResult->fMin) ? pfValues[i] : psResult->fMin;
+        psResult->fMax = (pfValues[i] > psResult->fMax) ? pfValues[i] : psResult->fMax;
+        psResult->dSum += pfValues[i];
+    }
+    psResult->u32Count = u32Count;
+#else
+    vAggregateFloatScalar(pfValues, u32Count, psResult);
+#endif
+}
+
+
+void vAggregateInt32Scalar(const int32_t *pi32Values, uint32_t u32Count, tsAggregateInt32 *psResult)
+{
+    uint32_t i;
+    
+    memset(psResult, 0, sizeof(tsAggregateInt32));
+    if (u32Count == 0)
+    {
+        return;
+    }
+    
+    psResult->i32Min = psResult->i32Max = pi32Values[0];
+    for (i = 0; i < u32Count; i++)
+    {
+        if (pi32Values[i] < psResult->i32Min)
+        {
+            psResult->i32Min = pi32Values[i];
+        }
+        if (pi32Values[i] > psResult->i32Max)
+        {
+            psResult->i32Max = pi32Values[i];
+        }
+        psResult->i64Sum += pi32Values[i];
+    }
+    psResult->u32Count = u32Count;
+}
+
+
+void vAggregateInt32(const int32_t *pi32Values, uint32_t u32Count, tsAggregateInt32 *psResult)
+{
+#if defined(AGGREGATE_SSE2) || defined(AGGREGATE_NEON)
+    int32_t ai32Min[4], ai32Max[4];
+    int64_t ai64Sum[2];
+    uint32_t u32Vectors = u32Count & ~3;
+    uint32_t i;
+    
+    if (u32Count < 4)
+    {
+        vAggregateInt32Scalar(pi32Values, u32Count, psResult);
+        return;
+    }
+    
+    memset(psResult, 0, sizeof(tsAggregateInt32));
+    {
+#if defined(AGGREGATE_SSE2)
+        /* SSE2 has no 32 bit min / max, so select with compare masks */
+        __m128i vMin = _mm_loadu_si128((const __m128i *)pi32Values);
+        __m128i vMax = vMin;
+        __m128i vSum = _mm_setzero_si128();
+        
+        for (i = 0; i < u32Vectors; i += 4)
+        {
+            __m128i vValues = _mm_loadu_si128((const __m128i *)&pi32Values[i]);
+            __m128i vLess   = _mm_cmplt_epi32(vValues, vMin);
+            __m128i vMore   = _mm_cmpgt_epi32(vValues, vMax);
+            __m128i vSign   = _mm_srai_epi32(vValues, 31);
+            
+            vMin = _mm_or_si128(_mm_and_si128(vLess, vValues), _mm_andnot_si128(vLess, vMin));
+            vMax = _mm_or_si128(_mm_and_si128(vMore, vValues), _mm_andnot_si128(vMore, vMax));
+            
+            /* Sign extend to 64 bits so the sum cannot overflow */
+            vSum = _mm_add_epi64(vSum, _mm_unpacklo_epi32(vValues, vSign));
+            vSum = _mm_add_epi64(vSum, _mm_unpackhi_epi32(vValues, vSign));
+        }
+        _mm_storeu_si128((__m128i *)ai32Min, vMin);
+        _mm_storeu_si128((__m128i *)ai32Max, vMax);
+        _mm_storeu_si128((__m128i *)ai64Sum, vSum);
+#else
+        int32x4_t vMin = vld1q_s32(pi32Values);
+        int32x4_t vMax = vMin;
+        int64x2_t vSum = vdupq_n_s64(0);
+        
+        for (i = 0; i < u32Vectors; i += 4)
+        {
+            int32x4_t vValues = vld1q_s32(&pi32Values[i]);
+            vMin = vminq_s32(vMin, vValues);
+            vMax = vmaxq_s32(vMax, vValues);
+            vSum = vpadalq_s32(vSum, vValues);
+        }
+        vst1q_s32(ai32Min, vMin);
+        vst1q_s32(ai32Max, vMax);
+        vst1q_s64(ai64Sum, vSum);
+#endif
+    }
+    
+    psResult->i32Min = ai32Min[0];
+    psResult->i32Max = ai32Max[0];
+    for (i = 1; i < 4; i++)
+    {
+        psResult->i32Min = (ai32Min[i] < psResult->i32Min) ? ai32Min[i] : psResult->i32Min;
+        psResult->i32Max = (ai32Max[i] > psResult->i32Max) ? ai32Max[i] : psResult->i32Max;
+    }
+    psResult->i64Sum = ai64Sum[0] + ai64Sum[1];
+    
+    /* Up to three left over */
+    for (i = u32Vectors; i < u32Count; i++)
+    {
+        psResult->i32Min = (pi32Values[i] < psResult->i32Min) ? pi32Values[i] : psResult->i32Min;
+        psResult->i32Max = (pi32Values[i] > psResult->i32Max) ? pi32Values[i] : psResult->i32Max;
+        psResult->i64Sum += pi32Values[i];
+    }
+    psResult->u32Count = u32Count;
+#else
+    vAggregateInt32Scalar(pi32Values, u32Count, psResult);
+#endif
+}
+
+
+/** Twice the area of the triangle from the kept point A to B to the mean C of the next bucket
+ *  is |(fA * y) + (fB * x) + fC|, with the constants worked out once per bucket */
+static uint32_t u32LargestTriangleScalar(const float *pfX, const float *pfY, uint32_t u32First, uint32_t u32Last,
+                                         float fA, float fB, float fC)
+{
+    uint32_t u32Largest = u32First;
+    float fLargest = -1.0f;
+    uint32_t j;
+    
+    for (j = u32First; j < u32Last; j++)
+    {
+        float fX = pfX ? pfX[j] : (float)j;
+        float fArea = fabsf(((fA * pfY[j]) + (fB * fX)) + fC);
+        
+        if (fArea > fLargest)
+        {
+            fLargest = fArea;
+            u32Largest = j;
+        }
+    }
+    return u32Largest;
+}
+
+
+#if defined(AGGREGATE_SSE2) || defined(AGGREGATE_NEON)
+/** Vector version of \ref u32LargestTriangleScalar. Each lane keeps the first
+ *  of its largest, and ties between lanes go to the earliest point, so the
+ *  same point is chosen. */
+static uint32_t u32LargestTriangle(const float *pfX, const float *pfY, uint32_t u32First, uint32_t u32Last,
+                                   float fA, float fB, float fC)
+{
+    float afLargest[4];
+    int32_t ai32Largest[4];
+    int32_t ai32Index[4] = { (int32_t)u32First, (int32_t)u32First + 1, (int32_t)u32First + 2, (int32_t)u32First + 3 };
+    uint32_t u32Largest = u32First;
+    float fLargest = -1.0f;
+    uint32_t i, j;
+    
+    {
+#if defined(AGGREGATE_SSE2)
+        const __m128 vA = _mm_set1_ps(fA), vB = _mm_set1_ps(fB), vC = _mm_set1_ps(fC);
+        const __m128 vAbs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 vLargest = _mm_set1_ps(-1.0f);
+        __m128i vLargestIndex = _mm_set1_epi32((int32_t)u32First);
+        __m128i vIndex = _mm_loadu_si128((const __m128i *)ai32Index);
+        const __m128i vStep = _mm_set1_epi32(4);
+        
+        for (j = u32First; j + 4 <= u32Last; j += 4)
+        {
+            __m128 vX = pfX ? _mm_loadu_ps(&pfX[j]) : _mm_cvtepi32_ps(vIndex);
+            __m128 vArea = _mm_and_ps(vAbs, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vA, _mm_loadu_ps(&pfY[j])), 
+                                                                  _mm_mul_ps(vB, vX)), vC));
+            __m128 vMore = _mm_cmpgt_ps(vArea, vLargest);
+            
+            vLargest = _mm_or_ps(_mm_and_ps(vMore, vArea), _mm_andnot_ps(vMore, vLargest));
+            vLargestIndex = _mm_or_si128(_mm_and_si128(_mm_castps_si128(vMore), vIndex), 
+                                         _mm_andnot_si128(_mm_castps_si128(vMore), vLargestIndex));
+            vIndex = _mm_add_epi32(vIndex, vStep);
+        }
+        _mm_storeu_ps(afLargest, vLargest);
+        _mm_storeu_si128((__m128i *)ai32Largest, vLargestIndex);
+#else
+        const float32x4_t vA = vdupq_n_f32(fA), vB = vdupq_n_f32(fB), vC = vdupq_n_f32(fC);
+        float32x4_t vLargest = vdupq_n_f32(-1.0f);
+        int32x4_t vLargestIndex = vdupq_n_s32((int32_t)u32First);
+        int32x4_t vIndex = vld1q_s32(ai32Index);
+        const int32x4_t vStep = vdupq_n_s32(4);
+        
+        for (j = u32First; j + 4 <= u32Last; j += 4)
+        {
+            float32x4_t vX = pfX ? vld1q_f32(&pfX[j]) : vcvtq_f32_s32(vIndex);
+            float32x4_t vArea = vabsq_f32(vaddq_f32(vaddq_f32(vmulq_f32(vA, vld1q_f32(&pfY[j])), 
+                                                              vmulq_f32(vB, vX)), vC));
+            uint32x4_t vMore = vcgtq_f32(vArea, vLargest);
+            
+            vLargest = vbslq_f32(vMore, vArea, vLargest);
+            vLargestIndex = vbslq_s32(vMore, vIndex, vLargestIndex);
+            vIndex = vaddq_s32(vIndex, vStep);
+        }
+        vst1q_f32(afLargest, vLargest);
+        vst1q_s32(ai32Largest, vLargestIndex);
+#endif
+    }
+    
+    for (i = 0; i < 4; i++)
+    {
+        if ((afLargest[i] > fLargest) || 
+            ((afLargest[i] == fLargest) && ((uint32_t)ai32Largest[i] < u32Largest)))
+        {
+            fLargest = afLargest[i];
+            u32Largest = (uint32_t)ai32Largest[i];
+        }
+    }
+    
+    /* Up to three left over, all after any found so far */
+    for (; j < u32Last; j++)
+    {
+        float fX = pfX ? pfX[j] : (float)j;
+        float fArea = fabsf(((fA * pfY[j]) + (fB * fX)) + fC);
+        
+        if (fArea > fLargest)
+        {
+            fLargest = fArea;
+            u32Largest = j;
+        }
+    }
+    return u32Largest;
+}
+#endif /* AGGREGATE_SSE2 || AGGREGATE_NEON */
+
+
+/** Largest-Triangle-Three-Buckets with the per bucket work done by the given kernels */
+static uint32_t u32LTTB(const float *pfX, const float *pfY, uint32_t u32Count, uint32_t u32Threshold, 
+                        uint32_t *pu32Selected, tprLargestTriangle prLargestTriangle, tprSumFloat prSum)
+{
+    double dEvery;
+    uint32_t u32Kept = 0;
+    uint32_t u32Previous = 0;
+    uint32_t i;
+    
+    if (u32Threshold >= u32Count)
+    {
+        for (i = 0; i < u32Count; i++)
+        {
+            pu32Selected[i] = i;
+        }
+        return u32Count;
+    }
+    if (u32Threshold < 3)
+    {
+        if (u32Threshold > 0)
+        {
+            pu32Selected[u32Kept++] = 0;
+        }
+        if (u32Threshold > 1)
+        {
+            pu32Selected[u32Kept++] = u32Count - 1;
+        }
+        return u32Kept;
+    }
+    
+    /* The first and last points are kept, the rest are split into buckets */
+    dEvery = (double)(u32Count - 2) / (u32Threshold - 2);
+    pu32Selected[u32Kept++] = 0;
+    
+    for (i = 0; i < u32Threshold - 2; i++)
+    {
+        uint32_t u32First   = (uint32_t)(i * dEvery) + 1;
+        uint32_t u32Last    = (uint32_t)((i + 1) * dEvery) + 1;
+        uint32_t u32NextEnd = (uint32_t)((i + 2) * dEvery) + 1;
+        tsAggregateFloat sNext;
+        float fAX, fAY, fCX, fCY, fA, fB;
+        
+        if (u32NextEnd > u32Count)
+        {
+            u32NextEnd = u32Count;
+        }
+        
+        /* Mean of the next bucket, or the last point once there are no more buckets */
+        prSum(&pfY[u32Last], u32NextEnd - u32Last, &sNext);
+        fCY = (float)(sNext.dSum / sNext.u32Count);
+        if (pfX)
+        {
+            prSum(&pfX[u32Last], u32NextEnd - u32Last, &sNext);
+            fCX = (float)(sNext.dSum / sNext.u32Count);
+        }
+        else
+        {
+            fCX = (float)(((double)u32Last + u32NextEnd - 1) / 2);
+        }
+        
+        fAX = pfX ? pfX[u32Previous] : (float)u32Previous;
+        fAY = pfY[u32Previous];
+        fA  = fAX - fCX;
+        fB  = fCY - fAY;
+        
+        u32Previous = prLargestTriangle(pfX, pfY, u32First, u32Last, fA, fB, -(fA * fAY) - (fAX * fB));
+        pu32Selected[u32Kept++] = u32Previous;
+    }
+    
+    pu32Selected[u32Kept++] = u32Count - 1;
+    PRINTF("LTTB kept %u of %u points\n", u32Kept, u32Count);
+    return u32Kept;
+}
+
+
+uint32_t u32AggregateLTTBScalar(const float *pfX, const float *pfY, uint32_t u32Count, 
+                                uint32_t u32Threshold, uint32_t *pu32Selected)
+{
+    return u32LTTB(pfX, pfY, u32Count, u32Threshold, pu32Selected, u32LargestTriangleScalar, vAggregateFloatScalar);
+}
+
+
+uint32_t u32AggregateLTTB(const float *pfX, const float *pfY, uint32_t u32Count, 
+                          uint32_t u32Threshold, uint32_t *pu32Selected)
+{
+#if defined(AGGREGATE_SSE2) || defined(AGGREGATE_NEON)
+    return u32LTTB(pfX, pfY, u32Count, u32Threshold, pu32Selected, u32LargestTriangle, vAggregateFloat);
+#else
+    return u32AggregateLTTBScalar(pfX, pfY, u32Count, u32Threshold, pu32Selected);
+#endif
+}
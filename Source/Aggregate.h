@@ -0,0 +1,122 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          History aggregation kernels
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#ifndef __AGGREGATE_H_
+#define __AGGREGATE_H_
+
+#include <stdint.h>
+
+/** Samples summed in float lanes before being added into a double,
+ *  so long columns keep their precision */
+#define AGGREGATE_BLOCK             4096
+
+
+/** Summary of a column of float samples */
+typedef struct
+{
+    float       fMin;               /**< Smallest sample, 0 if there are none */
+    float       fMax;               /**< Largest sample, 0 if there are none */
+    double      dSum;               /**< Sum of the samples */
+    uint32_t    u32Count;           /**< Number of samples */
+} tsAggregateFloat;
+
+
+/** Summary of a column of integer samples */
+typedef struct
+{
+    int32_t     i32Min;             /**< Smallest sample, 0 if there are none */
+    int32_t     i32Max;             /**< Largest sample, 0 if there are none */
+    int64_t     i64Sum;             /**< Sum of the samples */
+    uint32_t    u32Count;           /**< Number of samples */
+} tsAggregateInt32;
+
+
+/** Get the name of the vector instructions the kernels were built for.
+ *  \return "SSE2", "NEON" or "scalar"
+ */
+const char *pcAggregateKernel(void);
+
+
+/** Find the smallest, largest and sum of a column of floats.
+ *  \param pfValues         Samples
+ *  \param u32Count         Number of samples
+ *  \param psResult         Pointer to location to store the summary
+ */
+void vAggregateFloat(const float *pfValues, uint32_t u32Count, tsAggregateFloat *psResult);
+
+
+/** Reference version of \ref vAggregateFloat, one sample at a time. */
+void vAggregateFloatScalar(const float *pfValues, uint32_t u32Count, tsAggregateFloat *psResult);
+
+
+/** Find the smallest, largest and sum of a column of integers.
+ *  \param pi32Values       Samples
+ *  \param u32Count         Number of samples
+ *  \param psResult         Pointer to location to store the summary
+ */
+void vAggregateInt32(const int32_t *pi32Values, uint32_t u32Count, tsAggregateInt32 *psResult);
+
+
+/** Reference version of \ref vAggregateInt32, one sample at a time. */
+void vAggregateInt32Scalar(const int32_t *pi32Values, uint32_t u32Count, tsAggregateInt32 *psResult);
+
+
+/** Choose the points that best keep the shape of a series when drawn,
+ *  by Largest-Triangle-Three-Buckets. The first and last points are
+ *  always kept. Between them the series is split into equal buckets and
+ *  the point of each that makes the largest triangle with the point kept
+ *  before it and the mean of the next bucket is kept.
+ *  \param pfX              X of each point, in ascending order. NULL if the points are evenly spaced
+ *  \param pfY              Y of each point
+ *  \param u32Count         Number of points
+ *  \param u32Threshold     Number of points to keep. Every point is kept if this is not less than u32Count,
+ *                          and only the first and last if it is under 3
+ *  \param pu32Selected     Array of at least the smaller of u32Threshold and u32Count entries,
+ *                          to store the indices of the kept points in, in ascending order
+ *  \return Number of points kept
+ */
+uint32_t u32AggregateLTTB(const float *pfX, const float *pfY, uint32_t u32Count, 
+                          uint32_t u32Threshold, uint32_t *pu32Selected);
+
+
+/** Reference version of \ref u32AggregateLTTB, one point at a time. */
+uint32_t u32AggregateLTTBScalar(const float *pfX, const float *pfY, uint32_t u32Count, 
+                                uint32_t u32Threshold, uint32_t *pu32Selected);
+
+
+#endif /* __AGGREGATE_H_ */
@@ -0,0 +1,180 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Request arena
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arena.h"
+
+//#define DEBUG_ARENA
+
+#ifdef DEBUG_ARENA
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_ARENA */
+
+
+/** Round a size up to the arena alignment */
+#define ARENA_ROUND(s)  (((s) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+
+void vArenaInit(tsArena *psArena)
+{
+    memset(psArena, 0, sizeof(tsArena));
+}
+
+
+void *pvArenaAlloc(tsArena *psArena, size_t szSize)
+{
+    tsArenaBlock *psBlock = psArena->psBlocks;
+    void *pvMemory;
+    
+    szSize = ARENA_ROUND(szSize ? szSize : 1);
+    
+    if ((!psBlock) || (psBlock->szSize - psBlock->szUsed < szSize))
+    {
+        size_t szBlockSize = szSize > ARENA_BLOCK_SIZE ? szSize : ARENA_BLOCK_SIZE;
+        
+        psBlock = malloc(sizeof(tsArenaBlock) + szBlockSize);
+        if (!psBlock)
+        {
+            return NULL;
+        }
+        psBlock->szSize     = szBlockSize;
+        psBlock->szUsed     = 0;
+        
+        if ((psArena->psBlocks) && (szSize > ARENA_BLOCK_SIZE))
+        {
+            /* A large allocation gets a block to itself, behind the current one,
+             * so the room left in the current block is not wasted */
+            psBlock->psNext = psArena->psBlocks->psNext;
+            psArena->psBlocks->psNext = psBlock;
+        }
+        else
+        {
+            psBlock->psNext = psArena->psBlocks;
+            psArena->psBlocks = psBlock;
+        }
+        psArena->u32Blocks++;
+    }
+    
+    pvMemory = &psBlock->au8Data[psBlock->szUsed];
+    psBlock->szUsed += szSize;
+    
+    psArena->pvLast = pvMemory;
+    psArena->u32Allocations++;
+    psArena->szAllocated += szSize;
+    return pvMemory;
+}
+
+
+void *pvArenaZalloc(tsArena *psArena, size_t szSize)
+{
+    void *pvMemory = pvArenaAlloc(psArena, szSize);
+    
+    if (pvMemory)
+    {
+        memset(pvMemory, 0, szSize);
+    }
+    return pvMemory;
+}
+
+
+void *pvArenaGrow(tsArena *psArena, void *pvOld, size_t szOld, size_t szNew)
+{
+    tsArenaBlock *psBlock = psArena->psBlocks;
+    void *pvNew;
+    
+    if (szNew <= szOld)
+    {
+        return pvOld;
+    }
+    
+    if ((pvOld) && (pvOld == psArena->pvLast) && (psBlock) &&
+        ((uint8_t *)pvOld >= psBlock->au8Data) && ((uint8_t *)pvOld < &psBlock->au8Data[psBlock->szSize]))
+    {
+        size_t szOffset = (uint8_t *)pvOld - psBlock->au8Data;
+        
+        if (ARENA_ROUND(szNew) <= psBlock->szSize - szOffset)
+        {
+            psArena->szAllocated += ARENA_ROUND(szNew) - (psBlock->szUsed - szOffset);
+            psBlock->szUsed = szOffset + ARENA_ROUND(szNew);
+            return pvOld;
+        }
+    }
+    
+    pvNew = pvArenaAlloc(psArena, szNew);
+    if ((pvNew) && (pvOld))
+    {
+        memcpy(pvNew, pvOld, szOld);
+    }
+    return pvNew;
+}
+
+
+char *pcArenaStrdup(tsArena *psArena, const char *pcString)
+{
+    size_t szLength = strlen(pcString) + 1;
+    char *pcCopy = pvArenaAlloc(psArena, szLength);
+    
+    if (pcCopy)
+    {
+        memcpy(pcCopy, pcString, szLength);
+    }
+    return pcCopy;
+}
+
+
+void vArenaFree(tsArena *psArena)
+{
+    tsArenaBlock *psBlock = psArena->psBlocks;
+    
+    PRINTF("Arena: %u allocations, %lu bytes, in %u blocks\n", 
+           psArena->u32Allocations, (unsigned long)psArena->szAllocated, psArena->u32Blocks);
+    
+    while (psBlock)
+    {
+        tsArenaBlock *psNext = psBlock->psNext;
+        free(psBlock);
+        psBlock = psNext;
+    }
+    memset(psArena, 0, sizeof(tsArena));
+}
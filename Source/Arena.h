@@ -0,0 +1,124 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Request arena
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __ARENA_H_
+#define __ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Minimum size of an arena block */
+#define ARENA_BLOCK_SIZE            4096
+
+/** Alignment of every allocation */
+#define ARENA_ALIGNMENT             16
+
+
+/** Block of memory that allocations are carved from */
+typedef struct _tsArenaBlock
+{
+    struct _tsArenaBlock *psNext;       /**< Next block in list */
+    size_t          szSize;             /**< Size of au8Data */
+    size_t          szUsed;             /**< Bytes of au8Data handed out */
+    uint8_t         au8Data[] __attribute__((aligned(ARENA_ALIGNMENT)));
+} tsArenaBlock;
+
+
+/** Arena that everything a request allocates comes from.
+ *  Allocations are never freed individually - the whole arena is
+ *  released at once when the request is finished with. */
+typedef struct
+{
+    tsArenaBlock   *psBlocks;           /**< List of blocks, most recent first */
+    void           *pvLast;             /**< Most recent allocation, which may still grow in place */
+    uint32_t        u32Allocations;     /**< Number of allocations made */
+    uint32_t        u32Blocks;          /**< Number of blocks malloc'd for them */
+    size_t          szAllocated;        /**< Bytes handed out */
+} tsArena;
+
+
+/** Initialise an empty arena. No memory is allocated until it is used.
+ *  \param psArena          Arena to initialise
+ */
+void vArenaInit(tsArena *psArena);
+
+
+/** Allocate memory from an arena.
+ *  \param psArena          Arena
+ *  \param szSize           Number of bytes
+ *  \return Pointer to memory, aligned to \ref ARENA_ALIGNMENT, or NULL if out of memory
+ */
+void *pvArenaAlloc(tsArena *psArena, size_t szSize);
+
+
+/** Allocate zeroed memory from an arena.
+ *  \param psArena          Arena
+ *  \param szSize           Number of bytes
+ *  \return Pointer to memory, or NULL if out of memory
+ */
+void *pvArenaZalloc(tsArena *psArena, size_t szSize);
+
+
+/** Grow an allocation, keeping its contents.
+ *  The most recent allocation grows in place if its block has room,
+ *  otherwise it is copied and the old copy abandoned until the arena is freed.
+ *  \param psArena          Arena
+ *  \param pvOld            Allocation to grow, or NULL
+ *  \param szOld            Its current size
+ *  \param szNew            Size required
+ *  \return Pointer to memory, or NULL if out of memory (pvOld is unchanged)
+ */
+void *pvArenaGrow(tsArena *psArena, void *pvOld, size_t szOld, size_t szNew);
+
+
+/** Copy a string into an arena.
+ *  \param psArena          Arena
+ *  \param pcString         String to copy
+ *  \return Pointer to copy, or NULL if out of memory
+ */
+char *pcArenaStrdup(tsArena *psArena, const char *pcString);
+
+
+/** Release everything allocated from an arena, leaving it empty and ready for reuse.
+ *  \param psArena          Arena
+ */
+void vArenaFree(tsArena *psArena);
+
+
+#endif /* __ARENA_H_ */
@@ -0,0 +1,242 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Static asset pack
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "AssetPack.h"
+
+//#define DEBUG_ASSET_PACK
+
+#ifdef DEBUG_ASSET_PACK
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_ASSET_PACK */
+
+/* Layout of a pack, every number a big endian uint32_t so that a pack built
+ * on the host serves on any router:
+ *   Header:    magic, version, number of files, offset of index
+ *   Index:     for each file, sorted by path, ASSET_ENTRY_WORDS words:
+ *              path, content type and hash (offsets of nul terminated strings),
+ *              offset and length of content, offset and length of gzip content
+ *   Data:      strings and content, anywhere after the header */
+#define ASSET_HEADER_SIZE           16
+#define ASSET_ENTRY_WORDS           7
+#define ASSET_ENTRY_SIZE            (ASSET_ENTRY_WORDS * 4)
+
+#define ASSET_PATH                  0
+#define ASSET_CONTENT_TYPE          1
+#define ASSET_HASH                  2
+#define ASSET_DATA                  3
+#define ASSET_DATA_LENGTH           4
+#define ASSET_GZIP                  5
+#define ASSET_GZIP_LENGTH           6
+
+
+static uint32_t u32Word(const uint8_t *pu8Data, uint32_t u32Index)
+{
+    uint32_t u32Value;
+    
+    memcpy(&u32Value, &pu8Data[u32Index * 4], sizeof(uint32_t));
+    return ntohl(u32Value);
+}
+
+
+/** Check that a nul terminated string lies within the pack */
+static int iValidString(const tsAssetPack *psPack, uint32_t u32Offset)
+{
+    return (u32Offset < psPack->szMap) && 
+           (memchr(&psPack->pu8Map[u32Offset], '\0', psPack->szMap - u32Offset) != NULL);
+}
+
+
+/** Check that a block of data lies within the pack */
+static int iValidData(const tsAssetPack *psPack, uint32_t u32Offset, uint32_t u32Length)
+{
+    return (u32Offset <= psPack->szMap) && (u32Length <= psPack->szMap - u32Offset);
+}
+
+
+static void vAsset(const tsAssetPack *psPack, uint32_t u32Index, tsAsset *psAsset)
+{
+    const uint8_t *pu8Entry = &psPack->pu8Index[u32Index * ASSET_ENTRY_SIZE];
+    
+    psAsset->pcPath         = (const char *)&psPack->pu8Map[u32Word(pu8Entry, ASSET_PATH)];
+    psAsset->pcContentType  = (const char *)&psPack->pu8Map[u32Word(pu8Entry, ASSET_CONTENT_TYPE)];
+    psAsset->pcHash         = (const char *)&psPack->pu8Map[u32Word(pu8Entry, ASSET_HASH)];
+    psAsset->pu8Data        = &psPack->pu8Map[u32Word(pu8Entry, ASSET_DATA)];
+    psAsset->u32Length      = u32Word(pu8Entry, ASSET_DATA_LENGTH);
+    psAsset->u32GzipLength  = u32Word(pu8Entry, ASSET_GZIP_LENGTH);
+    psAsset->pu8Gzip        = psAsset->u32GzipLength ? &psPack->pu8Map[u32Word(pu8Entry, ASSET_GZIP)] : NULL;
+}
+
+
+teAssetPackStatus eAssetPackOpen(tsAssetPack *psPack, const char *pcFileName)
+{
+    struct stat sStat;
+    uint32_t u32IndexOffset;
+    void *pvMap;
+    uint32_t i;
+    
+    memset(psPack, 0, sizeof(tsAssetPack));
+    psPack->iFd = open(pcFileName, O_RDONLY | O_CLOEXEC);
+    if (psPack->iFd < 0)
+    {
+        return E_ASSET_PACK_ERROR;
+    }
+    if (fstat(psPack->iFd, &sStat) < 0)
+    {
+        close(psPack->iFd);
+        return E_ASSET_PACK_ERROR;
+    }
+    if ((sStat.st_size < ASSET_HEADER_SIZE) || (sStat.st_size > UINT32_MAX))
+    {
+        close(psPack->iFd);
+        return E_ASSET_PACK_INVALID;
+    }
+    
+    pvMap = mmap(NULL, sStat.st_size, PROT_READ, MAP_SHARED, psPack->iFd, 0);
+    if (pvMap == MAP_FAILED)
+    {
+        close(psPack->iFd);
+        return E_ASSET_PACK_ERROR;
+    }
+    psPack->pu8Map  = pvMap;
+    psPack->szMap   = sStat.st_size;
+    
+    if ((memcmp(psPack->pu8Map, ASSET_PACK_MAGIC, 4) != 0) || (u32Word(psPack->pu8Map, 1) != ASSET_PACK_VERSION))
+    {
+        vAssetPackClose(psPack);
+        return E_ASSET_PACK_INVALID;
+    }
+    psPack->u32NumAssets    = u32Word(psPack->pu8Map, 2);
+    u32IndexOffset          = u32Word(psPack->pu8Map, 3);
+    if ((psPack->u32NumAssets > psPack->szMap / ASSET_ENTRY_SIZE) || 
+        !iValidData(psPack, u32IndexOffset, psPack->u32NumAssets * ASSET_ENTRY_SIZE))
+    {
+        vAssetPackClose(psPack);
+        return E_ASSET_PACK_INVALID;
+    }
+    psPack->pu8Index = &psPack->pu8Map[u32IndexOffset];
+    
+    /* Check everything once, so that lookups need not */
+    for (i = 0; i < psPack->u32NumAssets; i++)
+    {
+        const uint8_t *pu8Entry = &psPack->pu8Index[i * ASSET_ENTRY_SIZE];
+        tsAsset sAsset;
+        
+        if (!iValidString(psPack, u32Word(pu8Entry, ASSET_PATH)) || 
+            !iValidString(psPack, u32Word(pu8Entry, ASSET_CONTENT_TYPE)) || 
+            !iValidString(psPack, u32Word(pu8Entry, ASSET_HASH)) || 
+            !iValidData(psPack, u32Word(pu8Entry, ASSET_DATA), u32Word(pu8Entry, ASSET_DATA_LENGTH)) || 
+            !iValidData(psPack, u32Word(pu8Entry, ASSET_GZIP), u32Word(pu8Entry, ASSET_GZIP_LENGTH)))
+        {
+            vAssetPackClose(psPack);
+            return E_ASSET_PACK_INVALID;
+        }
+        if (i > 0)
+        {
+            tsAsset sPrevious;
+            
+            vAsset(psPack, i - 1, &sPrevious);
+            vAsset(psPack, i, &sAsset);
+            if (strcmp(sPrevious.pcPath, sAsset.pcPath) >= 0)
+            {
+                /* Not sorted, so lookups would miss files */
+                vAssetPackClose(psPack);
+                return E_ASSET_PACK_INVALID;
+            }
+        }
+    }
+    
+    PRINTF("Asset pack %s: %u files, %zu bytes\n", pcFileName, psPack->u32NumAssets, psPack->szMap);
+    return E_ASSET_PACK_OK;
+}
+
+
+void vAssetPackClose(tsAssetPack *psPack)
+{
+    if (psPack->pu8Map)
+    {
+        munmap((void *)psPack->pu8Map, psPack->szMap);
+    }
+    if (psPack->iFd >= 0)
+    {
+        close(psPack->iFd);
+    }
+    memset(psPack, 0, sizeof(tsAssetPack));
+    psPack->iFd = -1;
+}
+
+
+int iAssetPackLookup(const tsAssetPack *psPack, const char *pcPath, tsAsset *psAsset)
+{
+    uint32_t u32Low = 0;
+    uint32_t u32High = psPack->u32NumAssets;
+    
+    while (u32Low < u32High)
+    {
+        uint32_t u32Middle = u32Low + ((u32High - u32Low) / 2);
+        int iCompare;
+        
+        vAsset(psPack, u32Middle, psAsset);
+        iCompare = strcmp(pcPath, psAsset->pcPath);
+        if (iCompare == 0)
+        {
+            return 1;
+        }
+        if (iCompare < 0)
+        {
+            u32High = u32Middle;
+        }
+        else
+        {
+            u32Low = u32Middle + 1;
+        }
+    }
+    return 0;
+}
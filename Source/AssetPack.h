@@ -0,0 +1,109 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Static asset pack
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __ASSET_PACK_H_
+#define __ASSET_PACK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Magic number at the start of an asset pack */
+#define ASSET_PACK_MAGIC            "JIPA"
+
+/** Version of the asset pack format, see asset-pack.py */
+#define ASSET_PACK_VERSION          1
+
+
+/** Enumerated type of status codes from the asset pack */
+typedef enum
+{
+    E_ASSET_PACK_OK,            /**< All ok */
+    E_ASSET_PACK_ERROR,         /**< The pack could not be read */
+    E_ASSET_PACK_INVALID,       /**< The pack is corrupt or of another version */
+} teAssetPackStatus;
+
+
+/** A file of the pack. Everything points into the mapped pack */
+typedef struct
+{
+    const char          *pcPath;        /**< Path of the file, eg. "/js/JIP.js" */
+    const char          *pcContentType; /**< Content-Type to serve it with */
+    const char          *pcHash;        /**< Hash of its content, unquoted, the base of its ETags */
+    const uint8_t       *pu8Data;       /**< Content */
+    uint32_t            u32Length;      /**< Length of content */
+    const uint8_t       *pu8Gzip;       /**< Content compressed with gzip, NULL if it does not compress */
+    uint32_t            u32GzipLength;  /**< Length of compressed content */
+} tsAsset;
+
+
+/** An asset pack: the static files of the web pages, built into one file
+ *  by asset-pack.py, with the compressible ones also compressed ahead of
+ *  time. The pack is mapped, so files are served from the page cache. */
+typedef struct
+{
+    int                 iFd;            /**< The pack file */
+    const uint8_t       *pu8Map;        /**< Mapping of the pack */
+    size_t              szMap;          /**< Length of the mapping */
+    const uint8_t       *pu8Index;      /**< Index of the files, sorted by path */
+    uint32_t            u32NumAssets;   /**< Number of files */
+} tsAssetPack;
+
+
+/** Open and map an asset pack, checking that all of it is in bounds.
+ *  \param psPack           Pointer to pack to open
+ *  \param pcFileName       File of the pack
+ *  \return E_ASSET_PACK_OK on success
+ */
+teAssetPackStatus eAssetPackOpen(tsAssetPack *psPack, const char *pcFileName);
+
+
+/** Unmap and close an asset pack */
+void vAssetPackClose(tsAssetPack *psPack);
+
+
+/** Find a file in an asset pack.
+ *  \param psPack           Pointer to pack
+ *  \param pcPath           Path of the file
+ *  \param psAsset          Location to store the file
+ *  \return Non zero if the file was found
+ */
+int iAssetPackLookup(const tsAssetPack *psPack, const char *pcPath, tsAsset *psAsset);
+
+
+#endif /* __ASSET_PACK_H_ */
@@ -0,0 +1,212 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Border router set
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+#include <Zeroconf.h>
+
+#include "NetworkCache.h"
+#include "BRSet.h"
+
+//#define DEBUG_BR_SET
+
+#ifdef DEBUG_BR_SET
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_BR_SET */
+
+
+/** Thread that connects to one border router and populates its network */
+static void *pvMemberThread(void *pvMember)
+{
+    tsBRSetMember *psMember = (tsBRSetMember *)pvMember;
+    
+    psMember->eStatus = eJIP_Init(&psMember->sJIP_Context, E_JIP_CONTEXT_CLIENT);
+    if (psMember->eStatus != E_JIP_OK)
+    {
+        return NULL;
+    }
+    psMember->iInitialised = 1;
+    
+    psMember->eStatus = eJIP_Connect(&psMember->sJIP_Context, psMember->acAddress, JIP_DEFAULT_PORT);
+    if (psMember->eStatus != E_JIP_OK)
+    {
+        return NULL;
+    }
+    
+    /* Each border router has its own snapshot, so members never save over one another's */
+    psMember->eStatus = eNetworkCacheAcquire(&psMember->sJIP_Context, psMember->acAddress, 
+                                             psMember->eRefresh, &psMember->iAge);
+    
+    PRINTF("Border router %s: %s\n", psMember->acAddress, pcJIP_strerror(psMember->eStatus));
+    return NULL;
+}
+
+
+teBRSetStatus eBRSetOpen(tsBRSet *psBRSet, teNetworkCacheRefresh eRefresh)
+{
+    struct in6_addr *asAddresses;
+    int iNumAddresses;
+    uint32_t i;
+    
+    memset(psBRSet, 0, sizeof(tsBRSet));
+    
+    if (ZC_Get_Module_Addresses(&asAddresses, &iNumAddresses) != 0)
+    {
+        return E_BR_SET_NO_BRS;
+    }
+    if (iNumAddresses <= 0)
+    {
+        free(asAddresses);
+        return E_BR_SET_NO_BRS;
+    }
+    
+    psBRSet->psMembers = calloc(iNumAddresses, sizeof(tsBRSetMember));
+    if (!psBRSet->psMembers)
+    {
+        free(asAddresses);
+        return E_BR_SET_NO_MEMORY;
+    }
+    psBRSet->u32NumMembers = iNumAddresses;
+    
+    /* JIPd only refreshes the snapshot of one border router. The rest would be
+     * rediscovered on every request under AUTO, so they use their snapshot
+     * until a refresh is forced */
+    if (eRefresh == E_NETWORK_CACHE_REFRESH_AUTO)
+    {
+        eRefresh = E_NETWORK_CACHE_REFRESH_NEVER;
+    }
+    
+    for (i = 0; i < psBRSet->u32NumMembers; i++)
+    {
+        tsBRSetMember *psMember = &psBRSet->psMembers[i];
+        
+        psMember->sAddress  = asAddresses[i];
+        psMember->eStatus   = E_JIP_ERROR_FAILED;
+        psMember->eRefresh  = eRefresh;
+        inet_ntop(AF_INET6, &asAddresses[i], psMember->acAddress, INET6_ADDRSTRLEN);
+    }
+    free(asAddresses);
+    
+    for (i = 0; i < psBRSet->u32NumMembers; i++)
+    {
+        tsBRSetMember *psMember = &psBRSet->psMembers[i];
+        
+        if (pthread_create(&psMember->sThread, NULL, pvMemberThread, psMember) != 0)
+        {
+            /* Fall back to doing this one in line */
+            PRINTF("Could not start thread for %s\n", psMember->acAddress);
+            (void)pvMemberThread(psMember);
+            psMember->sThread = pthread_self();
+        }
+    }
+    
+    for (i = 0; i < psBRSet->u32NumMembers; i++)
+    {
+        tsBRSetMember *psMember = &psBRSet->psMembers[i];
+        
+        if (!pthread_equal(psMember->sThread, pthread_self()))
+        {
+            pthread_join(psMember->sThread, NULL);
+        }
+    }
+    return E_BR_SET_OK;
+}
+
+
+void vBRSetClose(tsBRSet *psBRSet)
+{
+    uint32_t i;
+    
+    for (i = 0; i < psBRSet->u32NumMembers; i++)
+    {
+        if (psBRSet->psMembers[i].iInitialised)
+        {
+            eJIP_Destroy(&psBRSet->psMembers[i].sJIP_Context);
+        }
+    }
+    free(psBRSet->psMembers);
+    memset(psBRSet, 0, sizeof(tsBRSet));
+}
+
+
+tsBRSetMember *psBRSetLookupNode(tsBRSet *psBRSet, const struct in6_addr *psAddress)
+{
+    uint32_t i, j;
+    
+    for (i = 0; i < psBRSet->u32NumMembers; i++)
+    {
+        tsBRSetMember *psMember = &psBRSet->psMembers[i];
+        tsJIPAddress *asAddresses = NULL;
+        uint32_t u32NumAddresses = 0;
+        int iFound = 0;
+        
+        if (psMember->eStatus != E_JIP_OK)
+        {
+            continue;
+        }
+        
+        if (eJIP_GetNodeAddressList(&psMember->sJIP_Context, JIP_DEVICEID_ALL, &asAddresses, &u32NumAddresses) != E_JIP_OK)
+        {
+            continue;
+        }
+        
+        for (j = 0; j < u32NumAddresses; j++)
+        {
+            if (memcmp(&asAddresses[j].sin6_addr, psAddress, sizeof(struct in6_addr)) == 0)
+            {
+                iFound = 1;
+                break;
+            }
+        }
+        free(asAddresses);
+        
+        if (iFound)
+        {
+            return psMember;
+        }
+    }
+    return NULL;
+}
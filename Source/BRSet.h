@@ -0,0 +1,116 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Border router set
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __BR_SET_H_
+#define __BR_SET_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "NetworkCache.h"
+
+/** Value of the BRaddress request variable that selects every border router */
+#define BR_SET_ALL                  "all"
+
+
+/** Enumerated type of status codes from the border router set */
+typedef enum
+{
+    E_BR_SET_OK,                /**< All ok */
+    E_BR_SET_ERROR,             /**< Generic error */
+    E_BR_SET_NO_BRS,            /**< No border routers were found */
+    E_BR_SET_NO_MEMORY,         /**< Memory allocation failed */
+} teBRSetStatus;
+
+
+/** One border router of a set, with its own context */
+typedef struct
+{
+    struct in6_addr     sAddress;                       /**< Address of the border router */
+    char                acAddress[INET6_ADDRSTRLEN];    /**< Address as a string */
+    tsJIP_Context       sJIP_Context;                   /**< Context connected to the border router */
+    teJIP_Status        eStatus;                        /**< Result of connecting and populating the network */
+    int                 iInitialised;                   /**< Set if sJIP_Context needs destroying */
+    int                 iAge;                           /**< Age of the network in seconds */
+    teNetworkCacheRefresh eRefresh;                     /**< Refresh policy for the snapshot */
+    pthread_t           sThread;                        /**< Thread connecting to the border router */
+} tsBRSetMember;
+
+
+/** Set of border routers that are used together.
+ *  Every border router found by Zeroconf is connected to concurrently, one
+ *  thread and context each, so the time taken is that of the slowest one
+ *  rather than the sum of them all. */
+typedef struct
+{
+    uint32_t            u32NumMembers;                  /**< Number of border routers */
+    tsBRSetMember       *psMembers;                     /**< Array of border routers */
+} tsBRSet;
+
+
+/** Find every border router and populate a context with each one's network.
+ *  Each border router is loaded from its own snapshot, and only discovered,
+ *  and its snapshot saved, when it has none or a refresh is forced.
+ *  Members that failed have eStatus set - the set is still usable.
+ *  \param psBRSet          Set to open
+ *  \param eRefresh         Refresh policy for the snapshots. AUTO is treated as NEVER
+ *  \return E_BR_SET_OK if at least one border router was found
+ */
+teBRSetStatus eBRSetOpen(tsBRSet *psBRSet, teNetworkCacheRefresh eRefresh);
+
+
+/** Disconnect from every border router in a set and free it.
+ *  \param psBRSet          Set to close
+ */
+void vBRSetClose(tsBRSet *psBRSet);
+
+
+/** Find the border router whose network contains a node.
+ *  \param psBRSet          Set to search
+ *  \param psAddress        Address of the node
+ *  \return Pointer to the owning member, or NULL if no network contains the node
+ */
+tsBRSetMember *psBRSetLookupNode(tsBRSet *psBRSet, const struct in6_addr *psAddress);
+
+
+#endif /* __BR_SET_H_ */
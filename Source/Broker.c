@@ -0,0 +1,1069 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Connection broker
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "Broker.h"
+
+//#define DEBUG_BROKER
+
+#ifdef DEBUG_BROKER
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_BROKER */
+
+/** MiB and variable read to check that a border router is answering */
+#define BROKER_HEALTH_MIB           "Node"
+#define BROKER_HEALTH_VAR           "DescriptiveName"
+
+
+/** Read exactly szLength bytes from a socket. \return non-zero on success */
+static int iReadFull(int iSocket, void *pvBuffer, size_t szLength)
+{
+    uint8_t *pu8Buffer = (uint8_t *)pvBuffer;
+    
+    while (szLength)
+    {
+        ssize_t iBytes = recv(iSocket, pu8Buffer, szLength, 0);
+        if (iBytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return 0;
+        }
+        if (iBytes == 0)
+        {
+            /* Tells a closed connection apart from a timeout */
+            errno = ECONNRESET;
+            return 0;
+        }
+        pu8Buffer += iBytes;
+        szLength  -= iBytes;
+    }
+    return 1;
+}
+
+
+/** Write exactly szLength bytes to a socket, without being killed if the peer has gone. \return non-zero on success */
+static int iWriteFull(int iSocket, const void *pvBuffer, size_t szLength)
+{
+    const uint8_t *pu8Buffer = (const uint8_t *)pvBuffer;
+    
+    while (szLength)
+    {
+        ssize_t iBytes = send(iSocket, pu8Buffer, szLength, MSG_NOSIGNAL);
+        if (iBytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return 0;
+        }
+        pu8Buffer += iBytes;
+        szLength  -= iBytes;
+    }
+    return 1;
+}
+
+
+static void vSetTimeout(int iSocket, int iSeconds)
+{
+    struct timeval sTimeout;
+    
+    sTimeout.tv_sec  = iSeconds;
+    sTimeout.tv_usec = 0;
+    setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &sTimeout, sizeof(sTimeout));
+    setsockopt(iSocket, SOL_SOCKET, SO_SNDTIMEO, &sTimeout, sizeof(sTimeout));
+}
+
+
+static time_t tNow(void)
+{
+    struct timespec sNow;
+    
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return sNow.tv_sec;
+}
+
+
+static void vMakeAddress(tsJIPAddress *psAddress, const struct in6_addr *psAddr)
+{
+    memset(psAddress, 0, sizeof(tsJIPAddress));
+    psAddress->sin6_family  = AF_INET6;
+    psAddress->sin6_port    = htons(JIP_DEFAULT_PORT);
+    psAddress->sin6_addr    = *psAddr;
+}
+
+
+/** Find the variable a request names. \return The variable, with its node locked, or NULL */
+static tsVar *psLookupVar(tsJIP_Context *psJIP_Context, tsJIPAddress *psAddress, 
+                          const char *pcMib, const char *pcVar, tsNode **ppsNode)
+{
+    tsNode *psNode;
+    tsMib *psMib;
+    tsVar *psVar;
+    
+    /* Lookup returns the node locked */
+    psNode = psJIP_LookupNode(psJIP_Context, psAddress);
+    if (!psNode)
+    {
+        return NULL;
+    }
+    psMib = psJIP_LookupMib(psNode, NULL, pcMib);
+    psVar = psMib ? psJIP_LookupVar(psMib, NULL, pcVar) : NULL;
+    if (!psVar)
+    {
+        eJIP_UnlockNode(psNode);
+        return NULL;
+    }
+    *ppsNode = psNode;
+    return psVar;
+}
+
+
+/****************************************************************************
+ * JIPd side
+ ****************************************************************************/
+
+/** Check that a border router is answering by reading one of its variables.
+ *  Other border routers' networks are rediscovered when due, or if the
+ *  border router's own node has gone from them. */
+static teJIP_Status eCheckConnection(tsBrokerConnection *psConnection, int iDiscover)
+{
+    tsJIPAddress sAddress;
+    struct in6_addr sAddr;
+    tsNode *psNode = NULL;
+    tsVar *psVar;
+    teJIP_Status eStatus;
+    
+    if (iDiscover)
+    {
+        PRINTF("Rediscovering network of %s\n", psConnection->acBRAddress);
+        eStatus = eJIPService_DiscoverNetwork(psConnection->psJIP_Context);
+        if (eStatus != E_JIP_OK)
+        {
+            return eStatus;
+        }
+    }
+    
+    inet_pton(AF_INET6, psConnection->acBRAddress, &sAddr);
+    vMakeAddress(&sAddress, &sAddr);
+    psVar = psLookupVar(psConnection->psJIP_Context, &sAddress, BROKER_HEALTH_MIB, BROKER_HEALTH_VAR, &psNode);
+    if (!psVar)
+    {
+        if ((psConnection->iOwned) && (!iDiscover))
+        {
+            return eCheckConnection(psConnection, 1);
+        }
+        /* JIPd's scheduler has yet to discover its network - it tells us
+         * nothing about whether the border router is answering */
+        return E_JIP_OK;
+    }
+    
+    eStatus = eJIP_GetVar(psConnection->psJIP_Context, psVar);
+    eJIP_UnlockNode(psNode);
+    return eStatus;
+}
+
+
+/** Connect a context to another border router and discover its network */
+static teJIP_Status eConnect(tsBrokerConnection *psConnection)
+{
+    teJIP_Status eStatus;
+    
+    PRINTF("Connecting to %s\n", psConnection->acBRAddress);
+    
+    if ((eStatus = eJIP_Init(&psConnection->sJIP_Context, E_JIP_CONTEXT_CLIENT)) != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    if ((eStatus = eJIP_Connect(&psConnection->sJIP_Context, psConnection->acBRAddress, JIP_DEFAULT_PORT)) != E_JIP_OK)
+    {
+        eJIP_Destroy(&psConnection->sJIP_Context);
+        return eStatus;
+    }
+    
+    /* Start from the cached device id's so that discovery is quick */
+    (void)eNetworkCacheLoadDefinitions(&psConnection->sJIP_Context, psConnection->acBRAddress);
+    
+    if ((eStatus = eJIPService_DiscoverNetwork(&psConnection->sJIP_Context)) != E_JIP_OK)
+    {
+        eJIP_Destroy(&psConnection->sJIP_Context);
+        return eStatus;
+    }
+    psConnection->psJIP_Context = &psConnection->sJIP_Context;
+    return E_JIP_OK;
+}
+
+
+/** Service one connection on behalf of the check thread. Called with the mutex held, which it releases while talking to the border router */
+static void vServiceConnection(tsBroker *psBroker, tsBrokerConnection *psConnection, time_t tTime)
+{
+    teJIP_Status eStatus;
+    int iHome = (psConnection == &psBroker->asConnections[0]);
+    
+    if ((!iHome) && (psConnection->u32Users == 0) && (tTime - psConnection->tUsed >= BROKER_IDLE_TIMEOUT))
+    {
+        PRINTF("Closing idle connection to %s\n", psConnection->acBRAddress);
+        if (psConnection->iOwned)
+        {
+            eJIP_Destroy(&psConnection->sJIP_Context);
+        }
+        memset(psConnection, 0, sizeof(tsBrokerConnection));
+        return;
+    }
+    
+    if (!psConnection->iUp)
+    {
+        if ((tTime < psConnection->tRetry) || (psConnection->u32Users))
+        {
+            return;
+        }
+        
+        /* Nothing else uses the context while the connection is down */
+        pthread_mutex_unlock(&psBroker->sMutex);
+        if (!iHome)
+        {
+            if (psConnection->iOwned)
+            {
+                eJIP_Destroy(&psConnection->sJIP_Context);
+                psConnection->iOwned = 0;
+            }
+            eStatus = eConnect(psConnection);
+            psConnection->iOwned = (eStatus == E_JIP_OK);
+        }
+        else
+        {
+            eStatus = eCheckConnection(psConnection, 0);
+        }
+        pthread_mutex_lock(&psBroker->sMutex);
+        psConnection->tDiscovered = tTime;
+    }
+    else
+    {
+        int iDiscover = (psConnection->iOwned) && (tTime - psConnection->tDiscovered >= BROKER_DISCOVER_INTERVAL);
+        
+        if ((!iDiscover) && (tTime - psConnection->tChecked < BROKER_CHECK_INTERVAL))
+        {
+            return;
+        }
+        
+        /* Requests carry on through the context while it is checked */
+        psConnection->u32Users++;
+        pthread_mutex_unlock(&psBroker->sMutex);
+        eStatus = eCheckConnection(psConnection, iDiscover);
+        pthread_mutex_lock(&psBroker->sMutex);
+        psConnection->u32Users--;
+        if (iDiscover)
+        {
+            psConnection->tDiscovered = tTime;
+        }
+    }
+    psConnection->tChecked = tTime;
+    
+    if (eStatus == E_JIP_OK)
+    {
+        if (!psConnection->iUp)
+        {
+            PRINTF("%s is up\n", psConnection->acBRAddress);
+        }
+        psConnection->iUp           = 1;
+        psConnection->u32Backoff    = 0;
+        return;
+    }
+    
+    /* Back off exponentially while the border router stays down */
+    psConnection->u32Backoff = psConnection->u32Backoff ? psConnection->u32Backoff * 2 : BROKER_MIN_BACKOFF;
+    if (psConnection->u32Backoff > BROKER_MAX_BACKOFF)
+    {
+        psConnection->u32Backoff = BROKER_MAX_BACKOFF;
+    }
+    psConnection->iUp       = 0;
+    psConnection->tRetry    = tNow() + psConnection->u32Backoff;
+    PRINTF("%s is down (%s), retrying in %us\n", psConnection->acBRAddress, 
+           pcJIP_strerror(eStatus), psConnection->u32Backoff);
+}
+
+
+static void *pvCheckThread(void *pvUser)
+{
+    tsBroker *psBroker = (tsBroker *)pvUser;
+    struct timespec sWake;
+    int i;
+    
+    pthread_mutex_lock(&psBroker->sMutex);
+    while (psBroker->iRun)
+    {
+        for (i = 0; (i < BROKER_MAX_CONNECTIONS) && (psBroker->iRun); i++)
+        {
+            if (psBroker->asConnections[i].acBRAddress[0])
+            {
+                vServiceConnection(psBroker, &psBroker->asConnections[i], tNow());
+            }
+        }
+        
+        /* Backoffs and new connections are timed to the second */
+        clock_gettime(CLOCK_MONOTONIC, &sWake);
+        sWake.tv_sec++;
+        pthread_cond_timedwait(&psBroker->sCond, &psBroker->sMutex, &sWake);
+    }
+    pthread_mutex_unlock(&psBroker->sMutex);
+    return NULL;
+}
+
+
+/** Find the connection to a border router, starting one if there is none.
+ *  Called with the mutex held. \return The connection, with a user counted, if it is up */
+static tsBrokerConnection *psUseConnection(tsBroker *psBroker, const char *pcBRAddress)
+{
+    tsBrokerConnection *psFree = NULL;
+    int i;
+    
+    for (i = 0; i < BROKER_MAX_CONNECTIONS; i++)
+    {
+        tsBrokerConnection *psConnection = &psBroker->asConnections[i];
+        
+        if (strcmp(psConnection->acBRAddress, pcBRAddress) == 0)
+        {
+            psConnection->tUsed = tNow();
+            if (!psConnection->iUp)
+            {
+                return NULL;
+            }
+            psConnection->u32Users++;
+            return psConnection;
+        }
+        if ((!psFree) && (!psConnection->acBRAddress[0]))
+        {
+            psFree = psConnection;
+        }
+    }
+    
+    if (psFree)
+    {
+        /* The check thread connects, so that this request does not wait
+         * for it. The client makes this one itself. */
+        strcpy(psFree->acBRAddress, pcBRAddress);
+        psFree->tUsed = tNow();
+        pthread_cond_broadcast(&psBroker->sCond);
+    }
+    return NULL;
+}
+
+
+/** Carry out a request */
+static void vHandleRequest(tsBroker *psBroker, tsBrokerRequest *psRequest, tsBrokerReply *psReply)
+{
+    tsBrokerConnection *psConnection;
+    struct in6_addr sBRAddr, sAddr, sGroupAddr;
+    tsJIPAddress sAddress;
+    tsNode *psNode;
+    tsVar *psVar;
+    teJIP_Status eStatus;
+    char acBRAddress[INET6_ADDRSTRLEN];
+    
+    memset(psReply, 0, sizeof(tsBrokerReply));
+    
+#define NOT_HANDLED(d) do { psReply->i32Status = E_JIP_ERROR_FAILED; psReply->u32NotHandled = 1; \
+                            strcpy(psReply->acDescription, d); return; } while (0)
+    
+    if ((psRequest->u32Operation > E_BROKER_MULTICAST_SET_VAR) ||
+        (psRequest->u32Size > BROKER_MAX_VALUE) ||
+        (inet_pton(AF_INET6, psRequest->acAddress, &sAddr) != 1) ||
+        ((psRequest->u32Operation == E_BROKER_MULTICAST_SET_VAR) && 
+         (inet_pton(AF_INET6, psRequest->acGroup, &sGroupAddr) != 1)))
+    {
+        NOT_HANDLED("Invalid request");
+    }
+    
+    /* Connections must compare equal however the address was written */
+    if (!psRequest->acBRAddress[0])
+    {
+        strcpy(acBRAddress, psBroker->asConnections[0].acBRAddress);
+    }
+    else if (inet_pton(AF_INET6, psRequest->acBRAddress, &sBRAddr) == 1)
+    {
+        inet_ntop(AF_INET6, &sBRAddr, acBRAddress, INET6_ADDRSTRLEN);
+    }
+    else
+    {
+        NOT_HANDLED("Invalid border router address");
+    }
+    
+    pthread_mutex_lock(&psBroker->sMutex);
+    psConnection = psUseConnection(psBroker, acBRAddress);
+    pthread_mutex_unlock(&psBroker->sMutex);
+    if (!psConnection)
+    {
+        NOT_HANDLED("No connection to border router");
+    }
+    
+    vMakeAddress(&sAddress, &sAddr);
+    psVar = psLookupVar(psConnection->psJIP_Context, &sAddress, psRequest->acMib, psRequest->acVar, &psNode);
+    if ((!psVar) || (psVar->eVarType >= E_JIP_VAR_TYPE_TABLE_BLOB))
+    {
+        /* Not discovered yet, or a table, which is not carried by a reply */
+        if (psVar)
+        {
+            eJIP_UnlockNode(psNode);
+        }
+        pthread_mutex_lock(&psBroker->sMutex);
+        psConnection->u32Users--;
+        pthread_mutex_unlock(&psBroker->sMutex);
+        NOT_HANDLED("Variable not found");
+    }
+#undef NOT_HANDLED
+    
+    switch (psRequest->u32Operation)
+    {
+        case (E_BROKER_GET_VAR):
+            PRINTF("Get %s %s.%s via %s\n", psRequest->acAddress, psRequest->acMib, psRequest->acVar, acBRAddress);
+            eStatus = eJIP_GetVar(psConnection->psJIP_Context, psVar);
+            if ((eStatus == E_JIP_OK) && (psVar->pvData))
+            {
+                psReply->u32Size = psVar->u8Size;
+                memcpy(psReply->au8Value, psVar->pvData, psReply->u32Size);
+            }
+            break;
+            
+        case (E_BROKER_SET_VAR):
+            PRINTF("Set %s %s.%s via %s\n", psRequest->acAddress, psRequest->acMib, psRequest->acVar, acBRAddress);
+            eStatus = eJIP_SetVar(psConnection->psJIP_Context, psVar, psRequest->au8Value, psRequest->u32Size);
+            break;
+            
+        default:
+            vMakeAddress(&sAddress, &sGroupAddr);
+            PRINTF("Set %s %s.%s via %s\n", psRequest->acGroup, psRequest->acMib, psRequest->acVar, acBRAddress);
+            eStatus = eJIP_MulticastSetVar(psConnection->psJIP_Context, psVar, psRequest->au8Value, psRequest->u32Size,
+                                           &sAddress, psRequest->u32Hops);
+            break;
+    }
+    eJIP_UnlockNode(psNode);
+    
+    pthread_mutex_lock(&psBroker->sMutex);
+    psConnection->u32Users--;
+    if (eStatus == E_JIP_ERROR_NETWORK)
+    {
+        /* Check the border router now rather than at the next interval */
+        psConnection->tChecked = 0;
+        pthread_cond_broadcast(&psBroker->sCond);
+    }
+    pthread_mutex_unlock(&psBroker->sMutex);
+    
+    psReply->i32Status = eStatus;
+    strncpy(psReply->acDescription, pcJIP_strerror(eStatus), sizeof(psReply->acDescription) - 1);
+}
+
+
+typedef struct
+{
+    tsBroker    *psBroker;
+    int         iClient;
+} tsBrokerClient;
+
+
+/** Serve the requests of a client until it closes its connection or leaves it idle */
+static void *pvClientThread(void *pvUser)
+{
+    tsBrokerClient *psClient = (tsBrokerClient *)pvUser;
+    tsBroker *psBroker = psClient->psBroker;
+    int iClient = psClient->iClient;
+    tsBrokerRequest sRequest;
+    tsBrokerReply sReply;
+    int i;
+    
+    free(psClient);
+    vSetTimeout(iClient, BROKER_CLIENT_IDLE_TIMEOUT);
+    
+    while (iReadFull(iClient, &sRequest, sizeof(tsBrokerRequest)))
+    {
+        sRequest.acBRAddress[sizeof(sRequest.acBRAddress) - 1] = '\0';
+        sRequest.acAddress[sizeof(sRequest.acAddress) - 1] = '\0';
+        sRequest.acGroup[sizeof(sRequest.acGroup) - 1] = '\0';
+        sRequest.acMib[sizeof(sRequest.acMib) - 1] = '\0';
+        sRequest.acVar[sizeof(sRequest.acVar) - 1] = '\0';
+        
+        vHandleRequest(psBroker, &sRequest, &sReply);
+        if (!iWriteFull(iClient, &sReply, sizeof(tsBrokerReply)))
+        {
+            PRINTF("Client went away before its reply\n");
+            break;
+        }
+    }
+    
+    pthread_mutex_lock(&psBroker->sMutex);
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++)
+    {
+        if (psBroker->aiClients[i] == iClient)
+        {
+            psBroker->aiClients[i] = -1;
+            break;
+        }
+    }
+    close(iClient);
+    psBroker->u32Clients--;
+    pthread_cond_broadcast(&psBroker->sCond);
+    pthread_mutex_unlock(&psBroker->sMutex);
+    return NULL;
+}
+
+
+/** Start a thread for a new client, if there is room for it */
+static void vAcceptClient(tsBroker *psBroker, int iClient)
+{
+    tsBrokerClient *psClient;
+    pthread_attr_t sAttr;
+    pthread_t sThread;
+    int i;
+    
+    pthread_mutex_lock(&psBroker->sMutex);
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++)
+    {
+        if (psBroker->aiClients[i] < 0)
+        {
+            break;
+        }
+    }
+    psClient = (i < BROKER_MAX_CLIENTS) && (psBroker->iRun) ? malloc(sizeof(tsBrokerClient)) : NULL;
+    if (!psClient)
+    {
+        /* The client connects to the border router itself */
+        pthread_mutex_unlock(&psBroker->sMutex);
+        close(iClient);
+        return;
+    }
+    psClient->psBroker  = psBroker;
+    psClient->iClient   = iClient;
+    
+    pthread_attr_init(&sAttr);
+    pthread_attr_setdetachstate(&sAttr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&sThread, &sAttr, pvClientThread, psClient) != 0)
+    {
+        pthread_mutex_unlock(&psBroker->sMutex);
+        pthread_attr_destroy(&sAttr);
+        free(psClient);
+        close(iClient);
+        return;
+    }
+    pthread_attr_destroy(&sAttr);
+    
+    psBroker->aiClients[i] = iClient;
+    psBroker->u32Clients++;
+    pthread_mutex_unlock(&psBroker->sMutex);
+}
+
+
+static void *pvAcceptThread(void *pvUser)
+{
+    tsBroker *psBroker = (tsBroker *)pvUser;
+    
+    for (;;)
+    {
+        int iClient = accept(psBroker->iSocket, NULL, NULL);
+        
+        if (iClient < 0)
+        {
+            int iRun;
+            
+            pthread_mutex_lock(&psBroker->sMutex);
+            iRun = psBroker->iRun;
+            pthread_mutex_unlock(&psBroker->sMutex);
+            
+            if (!iRun)
+            {
+                break;
+            }
+            if ((errno != EINTR) && (errno != ECONNABORTED))
+            {
+                /* Such as EMFILE, which passes as clients close. Until then
+                 * the CGIs make their own connections */
+                fprintf(stderr, "Broker failed to accept client (%s)\n", strerror(errno));
+                usleep(BROKER_ACCEPT_RETRY * 1000);
+            }
+            continue;
+        }
+        vAcceptClient(psBroker, iClient);
+    }
+    return NULL;
+}
+
+
+teBrokerStatus eBrokerStart(tsBroker *psBroker, tsJIP_Context *psJIP_Context, const char *pcBRAddress)
+{
+    struct sockaddr_un sAddress;
+    pthread_condattr_t sCondAttr;
+    int i;
+    
+    memset(psBroker, 0, sizeof(tsBroker));
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++)
+    {
+        psBroker->aiClients[i] = -1;
+    }
+    
+    /* JIPd's own connection is kept up by its scheduler, and only checked here */
+    strncpy(psBroker->asConnections[0].acBRAddress, pcBRAddress, INET6_ADDRSTRLEN - 1);
+    psBroker->asConnections[0].psJIP_Context    = psJIP_Context;
+    psBroker->asConnections[0].iUp              = 1;
+    psBroker->asConnections[0].tChecked         = tNow();
+    
+    psBroker->iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (psBroker->iSocket < 0)
+    {
+        perror("Error creating broker socket");
+        return E_BROKER_ERROR;
+    }
+    
+    memset(&sAddress, 0, sizeof(struct sockaddr_un));
+    sAddress.sun_family = AF_UNIX;
+    strncpy(sAddress.sun_path, BROKER_SOCKET_NAME, sizeof(sAddress.sun_path) - 1);
+    
+    /* Left behind if the last JIPd did not exit cleanly */
+    unlink(BROKER_SOCKET_NAME);
+    
+    if ((bind(psBroker->iSocket, (struct sockaddr *)&sAddress, sizeof(struct sockaddr_un)) < 0) ||
+        (listen(psBroker->iSocket, 16) < 0))
+    {
+        perror("Error listening on broker socket");
+        close(psBroker->iSocket);
+        return E_BROKER_ERROR;
+    }
+    
+    /* The CGIs run as the web server's user */
+    chmod(BROKER_SOCKET_NAME, 0666);
+    
+    pthread_mutex_init(&psBroker->sMutex, NULL);
+    pthread_condattr_init(&sCondAttr);
+    pthread_condattr_setclock(&sCondAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&psBroker->sCond, &sCondAttr);
+    pthread_condattr_destroy(&sCondAttr);
+    psBroker->iRun = 1;
+    
+    if (pthread_create(&psBroker->sCheckThread, NULL, pvCheckThread, psBroker) != 0)
+    {
+        perror("Error starting broker check thread");
+        goto fail;
+    }
+    
+    if (pthread_create(&psBroker->sAcceptThread, NULL, pvAcceptThread, psBroker) != 0)
+    {
+        perror("Error starting broker accept thread");
+        pthread_mutex_lock(&psBroker->sMutex);
+        psBroker->iRun = 0;
+        pthread_cond_broadcast(&psBroker->sCond);
+        pthread_mutex_unlock(&psBroker->sMutex);
+        pthread_join(psBroker->sCheckThread, NULL);
+        goto fail;
+    }
+    return E_BROKER_OK;
+    
+fail:
+    psBroker->iRun = 0;
+    pthread_cond_destroy(&psBroker->sCond);
+    pthread_mutex_destroy(&psBroker->sMutex);
+    close(psBroker->iSocket);
+    unlink(BROKER_SOCKET_NAME);
+    return E_BROKER_ERROR;
+}
+
+
+teBrokerStatus eBrokerStop(tsBroker *psBroker)
+{
+    teBrokerStatus eStatus = E_BROKER_OK;
+    int i;
+    
+    pthread_mutex_lock(&psBroker->sMutex);
+    psBroker->iRun = 0;
+    pthread_cond_broadcast(&psBroker->sCond);
+    pthread_mutex_unlock(&psBroker->sMutex);
+    
+    /* Wakes the accept thread */
+    unlink(BROKER_SOCKET_NAME);
+    shutdown(psBroker->iSocket, SHUT_RDWR);
+    
+    if ((pthread_join(psBroker->sAcceptThread, NULL) != 0) ||
+        (pthread_join(psBroker->sCheckThread, NULL) != 0))
+    {
+        eStatus = E_BROKER_ERROR;
+    }
+    
+    /* Wake the client threads waiting for requests, and wait for them to finish any in progress */
+    pthread_mutex_lock(&psBroker->sMutex);
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++)
+    {
+        if (psBroker->aiClients[i] >= 0)
+        {
+            shutdown(psBroker->aiClients[i], SHUT_RDWR);
+        }
+    }
+    while (psBroker->u32Clients)
+    {
+        pthread_cond_wait(&psBroker->sCond, &psBroker->sMutex);
+    }
+    pthread_mutex_unlock(&psBroker->sMutex);
+    
+    for (i = 1; i < BROKER_MAX_CONNECTIONS; i++)
+    {
+        if (psBroker->asConnections[i].iOwned)
+        {
+            eJIP_Destroy(&psBroker->asConnections[i].sJIP_Context);
+        }
+    }
+    
+    close(psBroker->iSocket);
+    pthread_cond_destroy(&psBroker->sCond);
+    pthread_mutex_destroy(&psBroker->sMutex);
+    return eStatus;
+}
+
+
+/****************************************************************************
+ * CGI side
+ ****************************************************************************/
+
+teJIP_Status eBrokerLinkOpen(tsBrokerLink *psLink, tsJIP_Context *psJIP_Context, const char *pcBRAddress)
+{
+    memset(psLink, 0, sizeof(tsBrokerLink));
+    psLink->psJIP_Context   = psJIP_Context;
+    psLink->pcBRAddress     = pcBRAddress;
+    psLink->eConnectStatus  = E_JIP_OK;
+    pthread_mutex_init(&psLink->sMutex, NULL);
+    return E_JIP_OK;
+}
+
+
+teJIP_Status eBrokerLinkConnect(tsBrokerLink *psLink)
+{
+    teJIP_Status eStatus;
+    
+    pthread_mutex_lock(&psLink->sMutex);
+    if (!psLink->iConnected)
+    {
+        /* Only tried once - a border router that did not answer now will not in the rest of the request */
+        psLink->eConnectStatus  = eJIP_Connect(psLink->psJIP_Context, psLink->pcBRAddress, JIP_DEFAULT_PORT);
+        psLink->iConnected      = 1;
+        PRINTF("Connected to %s directly: %s\n", psLink->pcBRAddress, pcJIP_strerror(psLink->eConnectStatus));
+    }
+    eStatus = psLink->eConnectStatus;
+    pthread_mutex_unlock(&psLink->sMutex);
+    return eStatus;
+}
+
+
+void vBrokerLinkClose(tsBrokerLink *psLink)
+{
+    uint32_t i;
+    
+    if (!psLink->psJIP_Context)
+    {
+        return;
+    }
+    for (i = 0; i < psLink->u32NumSockets; i++)
+    {
+        close(psLink->aiSockets[i]);
+    }
+    pthread_mutex_destroy(&psLink->sMutex);
+    memset(psLink, 0, sizeof(tsBrokerLink));
+}
+
+
+teJIP_Status eBrokerAcquireNetwork(tsBrokerLink *psLink, teNetworkCacheRefresh eRefresh, int *piAge)
+{
+    uint32_t u32Version;
+    teJIP_Status eStatus;
+    
+    /* Connecting is only needed to discover the network */
+    if (eNetworkCacheVersion(psLink->pcBRAddress, eRefresh, &u32Version) == E_NETWORK_CACHE_OK)
+    {
+        eStatus = eNetworkCacheAcquire(psLink->psJIP_Context, psLink->pcBRAddress, eRefresh, piAge);
+        if ((eStatus == E_JIP_OK) || (psLink->iConnected))
+        {
+            return eStatus;
+        }
+    }
+    if ((eStatus = eBrokerLinkConnect(psLink)) != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    return eNetworkCacheAcquire(psLink->psJIP_Context, psLink->pcBRAddress, eRefresh, piAge);
+}
+
+
+teJIP_Status eBrokerAcquireModel(tsBrokerLink *psLink, teNetworkCacheRefresh eRefresh, 
+                                 tsNetworkCacheModel *psModel, int *piAge)
+{
+    uint32_t u32Version;
+    teJIP_Status eStatus;
+    
+    if (eNetworkCacheVersion(psLink->pcBRAddress, eRefresh, &u32Version) == E_NETWORK_CACHE_OK)
+    {
+        eStatus = eNetworkCacheAcquireModel(psLink->psJIP_Context, psLink->pcBRAddress, eRefresh, psModel, piAge);
+        if ((eStatus == E_JIP_OK) || (psLink->iConnected))
+        {
+            return eStatus;
+        }
+    }
+    if ((eStatus = eBrokerLinkConnect(psLink)) != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    return eNetworkCacheAcquireModel(psLink->psJIP_Context, psLink->pcBRAddress, eRefresh, psModel, piAge);
+}
+
+
+/** Take an idle connection to JIPd, or make a new one. \return The socket, or -1 if JIPd is not running */
+static int iLinkSocket(tsBrokerLink *psLink, int *piPooled)
+{
+    struct sockaddr_un sAddress;
+    int iSocket = -1;
+    
+    pthread_mutex_lock(&psLink->sMutex);
+    if (psLink->u32NumSockets)
+    {
+        iSocket = psLink->aiSockets[--psLink->u32NumSockets];
+    }
+    pthread_mutex_unlock(&psLink->sMutex);
+    
+    *piPooled = (iSocket >= 0);
+    if (iSocket >= 0)
+    {
+        return iSocket;
+    }
+    
+    iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (iSocket < 0)
+    {
+        return -1;
+    }
+    
+    memset(&sAddress, 0, sizeof(struct sockaddr_un));
+    sAddress.sun_family = AF_UNIX;
+    strncpy(sAddress.sun_path, BROKER_SOCKET_NAME, sizeof(sAddress.sun_path) - 1);
+    
+    if (connect(iSocket, (struct sockaddr *)&sAddress, sizeof(struct sockaddr_un)) < 0)
+    {
+        PRINTF("JIPd is not accepting requests (%s)\n", strerror(errno));
+        close(iSocket);
+        pthread_mutex_lock(&psLink->sMutex);
+        psLink->iNoServer = 1;
+        pthread_mutex_unlock(&psLink->sMutex);
+        return -1;
+    }
+    vSetTimeout(iSocket, BROKER_CLIENT_TIMEOUT);
+    return iSocket;
+}
+
+
+/** Return a connection to JIPd to the idle pool */
+static void vLinkRelease(tsBrokerLink *psLink, int iSocket)
+{
+    pthread_mutex_lock(&psLink->sMutex);
+    if (psLink->u32NumSockets < BROKER_LINK_SOCKETS)
+    {
+        psLink->aiSockets[psLink->u32NumSockets++] = iSocket;
+        iSocket = -1;
+    }
+    pthread_mutex_unlock(&psLink->sMutex);
+    
+    if (iSocket >= 0)
+    {
+        close(iSocket);
+    }
+}
+
+
+/** Send a request for a variable to JIPd and wait for the answer */
+static teBrokerStatus eLinkRequest(tsBrokerLink *psLink, teBrokerOperation eOperation, tsVar *psVar, 
+                                   void *pvData, uint32_t u32Size, tsJIPAddress *psGroup, int iHops,
+                                   tsBrokerReply *psReply)
+{
+    tsBrokerRequest sRequest;
+    tsMib *psMib = psVar->psOwnerMib;
+    int iSocket;
+    int iPooled;
+    int iNoServer;
+    
+    pthread_mutex_lock(&psLink->sMutex);
+    iNoServer = psLink->iNoServer;
+    pthread_mutex_unlock(&psLink->sMutex);
+    if (iNoServer)
+    {
+        return E_BROKER_NO_SERVER;
+    }
+    
+    memset(&sRequest, 0, sizeof(tsBrokerRequest));
+    if ((u32Size > BROKER_MAX_VALUE) || 
+        (strlen(psMib->pcName) >= BROKER_MAX_NAME) || (strlen(psVar->pcName) >= BROKER_MAX_NAME) ||
+        (strlen(psLink->pcBRAddress) >= INET6_ADDRSTRLEN))
+    {
+        return E_BROKER_TOO_LONG;
+    }
+    sRequest.u32Operation   = eOperation;
+    sRequest.u32Hops        = iHops;
+    sRequest.u32Size        = u32Size;
+    strcpy(sRequest.acBRAddress, psLink->pcBRAddress);
+    strcpy(sRequest.acMib, psMib->pcName);
+    strcpy(sRequest.acVar, psVar->pcName);
+    inet_ntop(AF_INET6, &psMib->psOwnerNode->sNode_Address.sin6_addr, sRequest.acAddress, INET6_ADDRSTRLEN);
+    if (psGroup)
+    {
+        inet_ntop(AF_INET6, &psGroup->sin6_addr, sRequest.acGroup, INET6_ADDRSTRLEN);
+    }
+    if (u32Size)
+    {
+        memcpy(sRequest.au8Value, pvData, u32Size);
+    }
+    
+    for (;;)
+    {
+        iSocket = iLinkSocket(psLink, &iPooled);
+        if (iSocket < 0)
+        {
+            return E_BROKER_NO_SERVER;
+        }
+        if (iWriteFull(iSocket, &sRequest, sizeof(tsBrokerRequest)) &&
+            iReadFull(iSocket, psReply, sizeof(tsBrokerReply)))
+        {
+            break;
+        }
+        close(iSocket);
+        
+        /* JIPd closes idle connections before reading from them, so the
+         * request can be sent again on a new one. After a timeout it may
+         * have been carried out, so it is left to the caller. */
+        if ((!iPooled) || ((errno != ECONNRESET) && (errno != EPIPE)))
+        {
+            return E_BROKER_ERROR;
+        }
+    }
+    vLinkRelease(psLink, iSocket);
+    
+    psReply->acDescription[sizeof(psReply->acDescription) - 1] = '\0';
+    if (psReply->u32NotHandled)
+    {
+        return E_BROKER_NOT_HANDLED;
+    }
+    return E_BROKER_OK;
+}
+
+
+teJIP_Status eBrokerGetVar(tsBrokerLink *psLink, tsVar *psVar)
+{
+    tsBrokerReply sReply;
+    teJIP_Status eStatus;
+    void *pvData;
+    
+    if (eLinkRequest(psLink, E_BROKER_GET_VAR, psVar, NULL, 0, NULL, 0, &sReply) == E_BROKER_OK)
+    {
+        if (sReply.i32Status == E_JIP_OK)
+        {
+            /* Stored as libJIP does, terminated so that strings can be used in place */
+            pvData = malloc(sReply.u32Size + 1);
+            if (!pvData)
+            {
+                return E_JIP_ERROR_NO_MEM;
+            }
+            memcpy(pvData, sReply.au8Value, sReply.u32Size);
+            ((uint8_t *)pvData)[sReply.u32Size] = '\0';
+            free(psVar->pvData);
+            psVar->pvData   = pvData;
+            psVar->u8Size   = sReply.u32Size;
+        }
+        return sReply.i32Status;
+    }
+    
+    if ((eStatus = eBrokerLinkConnect(psLink)) != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    return eJIP_GetVar(psLink->psJIP_Context, psVar);
+}
+
+
+teJIP_Status eBrokerSetVar(tsBrokerLink *psLink, tsVar *psVar, void *pvData, uint32_t u32Size)
+{
+    tsBrokerReply sReply;
+    teJIP_Status eStatus;
+    
+    if (eLinkRequest(psLink, E_BROKER_SET_VAR, psVar, pvData, u32Size, NULL, 0, &sReply) == E_BROKER_OK)
+    {
+        return sReply.i32Status;
+    }
+    
+    if ((eStatus = eBrokerLinkConnect(psLink)) != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    return eJIP_SetVar(psLink->psJIP_Context, psVar, pvData, u32Size);
+}
+
+
+teJIP_Status eBrokerMulticastSetVar(tsBrokerLink *psLink, tsVar *psVar, void *pvData, uint32_t u32Size, 
+                                    tsJIPAddress *psAddress, int iHops)
+{
+    tsBrokerReply sReply;
+    teJIP_Status eStatus;
+    
+    if (eLinkRequest(psLink, E_BROKER_MULTICAST_SET_VAR, psVar, pvData, u32Size, psAddress, iHops, &sReply) == E_BROKER_OK)
+    {
+        return sReply.i32Status;
+    }
+    
+    if ((eStatus = eBrokerLinkConnect(psLink)) != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    return eJIP_MulticastSetVar(psLink->psJIP_Context, psVar, pvData, u32Size, psAddress, iHops);
+}
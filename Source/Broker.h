@@ -0,0 +1,292 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Connection broker
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __BROKER_H_
+#define __BROKER_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "NetworkCache.h"
+
+/** Unix socket that JIPd accepts variable requests on */
+#ifndef BROKER_SOCKET_NAME
+#define BROKER_SOCKET_NAME          "/tmp/jipd_broker"
+#endif /* BROKER_SOCKET_NAME */
+
+/** Border routers JIPd holds a connection to, its own and those the CGIs asked for */
+#ifndef BROKER_MAX_CONNECTIONS
+#define BROKER_MAX_CONNECTIONS      8
+#endif /* BROKER_MAX_CONNECTIONS */
+
+/** Interval between health checks of each connection, in seconds */
+#define BROKER_CHECK_INTERVAL       30
+
+/** Interval between rediscoveries of the networks of other border routers, in seconds.
+ *  JIPd's own network is kept fresh by its scheduler. */
+#define BROKER_DISCOVER_INTERVAL    300
+
+/** Time after which a connection to another border router that has not been used is closed, in seconds */
+#define BROKER_IDLE_TIMEOUT         900
+
+/** Shortest and longest wait before reconnecting to a border router that failed its health check, in seconds.
+ *  The wait doubles with each failure in between. */
+#define BROKER_MIN_BACKOFF          1
+#define BROKER_MAX_BACKOFF          64
+
+/** Longest a client waits for an answer, in seconds */
+#define BROKER_CLIENT_TIMEOUT       10
+
+/** Time a client may leave its connection to JIPd unused before it is closed, in seconds */
+#define BROKER_CLIENT_IDLE_TIMEOUT  30
+
+/** Clients JIPd serves at once. Others make their requests themselves */
+#define BROKER_MAX_CLIENTS          64
+
+/** Time to wait before accepting again after accept fails, eg. when out of file descriptors, in milliseconds */
+#define BROKER_ACCEPT_RETRY         100
+
+/** Connections to JIPd a client keeps open for its threads to reuse */
+#define BROKER_LINK_SOCKETS         8
+
+/** Longest MiB or variable name in a request */
+#define BROKER_MAX_NAME             64
+
+/** Largest value carried by a request or answer. Variables hold at most 255 bytes */
+#define BROKER_MAX_VALUE            256
+
+
+/** Enumerated type of status codes from the broker */
+typedef enum
+{
+    E_BROKER_OK,                    /**< All ok */
+    E_BROKER_ERROR,                 /**< Generic error */
+    E_BROKER_NO_SERVER,             /**< JIPd is not running, or not accepting requests */
+    E_BROKER_NOT_HANDLED,           /**< JIPd cannot handle the request - make it directly */
+    E_BROKER_TOO_LONG,              /**< A field of the request is too long to send */
+} teBrokerStatus;
+
+
+/** Enumerated type of requests to the broker */
+typedef enum
+{
+    E_BROKER_GET_VAR,               /**< Read a variable of a node */
+    E_BROKER_SET_VAR,               /**< Set a variable of a node */
+    E_BROKER_MULTICAST_SET_VAR,     /**< Set a variable of a group, as found on a node */
+} teBrokerOperation;
+
+
+/** Request sent to JIPd */
+typedef struct
+{
+    uint32_t    u32Operation;                   /**< teBrokerOperation */
+    char        acBRAddress[INET6_ADDRSTRLEN];  /**< Border router to send the request through */
+    char        acAddress[INET6_ADDRSTRLEN];    /**< Node that has the variable */
+    char        acGroup[INET6_ADDRSTRLEN];      /**< Group address, for a multicast set */
+    uint32_t    u32Hops;                        /**< Hops of a multicast set */
+    char        acMib[BROKER_MAX_NAME];         /**< MiB name */
+    char        acVar[BROKER_MAX_NAME];         /**< Variable name */
+    uint32_t    u32Size;                        /**< Size of the value to set */
+    uint8_t     au8Value[BROKER_MAX_VALUE];     /**< Value to set, as for eJIP_SetVar */
+} tsBrokerRequest;
+
+
+/** Answer to a request from JIPd */
+typedef struct
+{
+    int32_t     i32Status;                      /**< teJIP_Status of the request */
+    uint32_t    u32NotHandled;                  /**< Non-zero if the client should make the request itself */
+    uint32_t    u32Size;                        /**< Size of the value read */
+    uint8_t     au8Value[BROKER_MAX_VALUE];     /**< Value read */
+    char        acDescription[64];              /**< Description of the result */
+} tsBrokerReply;
+
+
+/** Connection to a border router held by JIPd */
+typedef struct
+{
+    char                acBRAddress[INET6_ADDRSTRLEN];  /**< Border router, empty if the slot is free */
+    tsJIP_Context       sJIP_Context;   /**< Context for another border router */
+    tsJIP_Context       *psJIP_Context; /**< Context in use - JIPd's own for its border router */
+    int                 iOwned;         /**< Set if sJIP_Context is in use and the broker looks after it */
+    int                 iUp;            /**< Set while the border router is answering */
+    uint32_t            u32Users;       /**< Requests in progress. The context is not replaced while any are */
+    uint32_t            u32Backoff;     /**< Wait before the next reconnect, in seconds */
+    time_t              tRetry;         /**< When to reconnect, while down */
+    time_t              tChecked;       /**< Last health check */
+    time_t              tDiscovered;    /**< Last discovery of the network, for another border router */
+    time_t              tUsed;          /**< Last request */
+} tsBrokerConnection;
+
+
+/** Structure for the connection broker in JIPd.
+ *  The CGIs send their variable requests to JIPd rather than connecting
+ *  to the border router themselves, so that connecting is not part of
+ *  each request. JIPd serves them from connections it keeps warm: its
+ *  own context for its border router, and others made on the first
+ *  request for a border router and closed once they go unused. Each
+ *  connection is checked periodically by reading a variable of the
+ *  border router, and reconnected with a backoff while it fails. */
+typedef struct
+{
+    tsBrokerConnection  asConnections[BROKER_MAX_CONNECTIONS]; /**< Connections, JIPd's own first */
+    int                 iSocket;        /**< Listening socket */
+    int                 aiClients[BROKER_MAX_CLIENTS]; /**< Sockets of the clients being served, -1 if unused */
+    int                 iRun;           /**< Cleared to stop the threads */
+    uint32_t            u32Clients;     /**< Client threads running */
+    pthread_t           sAcceptThread;  /**< Thread accepting clients */
+    pthread_t           sCheckThread;   /**< Thread checking connections */
+    pthread_mutex_t     sMutex;         /**< Protects the connections, iRun and u32Clients */
+    pthread_cond_t      sCond;          /**< Signalled when the threads should stop, or a client thread exits */
+} tsBroker;
+
+
+/** Client side of the broker, used by the CGIs in place of connecting
+ *  their context. Requests go to JIPd when it is running, and through
+ *  the context, connected on first use, when it is not or when JIPd
+ *  cannot handle them. The context is still used to hold the network. */
+typedef struct
+{
+    tsJIP_Context       *psJIP_Context; /**< Context holding the network, NULL if the link is not open */
+    const char          *pcBRAddress;   /**< Border router */
+    int                 iConnected;     /**< Set once connecting the context has been tried */
+    teJIP_Status        eConnectStatus; /**< Result of connecting the context */
+    int                 iNoServer;      /**< Set once JIPd has been found not to be running */
+    int                 aiSockets[BROKER_LINK_SOCKETS]; /**< Idle connections to JIPd */
+    uint32_t            u32NumSockets;  /**< Number of idle connections */
+    pthread_mutex_t     sMutex;         /**< Protects the above, as batches run requests on several threads */
+} tsBrokerLink;
+
+
+/** Start accepting requests on \ref BROKER_SOCKET_NAME.
+ *  \param psBroker         Pointer to broker structure to initialise
+ *  \param psJIP_Context    JIPd's connected context, to serve requests for its border router with
+ *  \param pcBRAddress      Address of the border router the context is connected to
+ *  \return E_BROKER_OK on success
+ */
+teBrokerStatus eBrokerStart(tsBroker *psBroker, tsJIP_Context *psJIP_Context, const char *pcBRAddress);
+
+
+/** Stop accepting requests, wait for the threads to exit and close the connections.
+ *  \param psBroker         Pointer to running broker
+ *  \return E_BROKER_OK on success
+ */
+teBrokerStatus eBrokerStop(tsBroker *psBroker);
+
+
+/** Open a link for a context that has been initialised but not connected.
+ *  \param psLink           Pointer to link structure to initialise
+ *  \param psJIP_Context    Initialised context
+ *  \param pcBRAddress      Border router
+ *  \return E_JIP_OK
+ */
+teJIP_Status eBrokerLinkOpen(tsBrokerLink *psLink, tsJIP_Context *psJIP_Context, const char *pcBRAddress);
+
+
+/** Connect the link's context to the border router, if it is not already.
+ *  Needed before using the context directly, eg. to discover the network.
+ *  \param psLink           Open link
+ *  \return E_JIP_OK if the context is connected
+ */
+teJIP_Status eBrokerLinkConnect(tsBrokerLink *psLink);
+
+
+/** Close the connections to JIPd. The context is left for the caller to destroy.
+ *  \param psLink           Link, which may never have been opened if zeroed
+ */
+void vBrokerLinkClose(tsBrokerLink *psLink);
+
+
+/** As \ref eNetworkCacheAcquire, connecting the context only if the network must be discovered.
+ *  \param psLink           Open link
+ *  \param eRefresh         Refresh policy
+ *  \param piAge            Pointer to location to store the age of the snapshot, or NULL
+ *  \return E_JIP_OK on success
+ */
+teJIP_Status eBrokerAcquireNetwork(tsBrokerLink *psLink, teNetworkCacheRefresh eRefresh, int *piAge);
+
+
+/** As \ref eNetworkCacheAcquireModel, connecting the context only if the network must be discovered.
+ *  \param psLink           Open link
+ *  \param eRefresh         Refresh policy
+ *  \param psModel          Pointer to model to open
+ *  \param piAge            Pointer to location to store the age of the snapshot, or NULL
+ *  \return E_JIP_OK on success
+ */
+teJIP_Status eBrokerAcquireModel(tsBrokerLink *psLink, teNetworkCacheRefresh eRefresh, 
+                                 tsNetworkCacheModel *psModel, int *piAge);
+
+
+/** As eJIP_GetVar, through JIPd if it can.
+ *  \param psLink           Open link
+ *  \param psVar            Variable of a node in the link's context
+ *  \return Status of the read
+ */
+teJIP_Status eBrokerGetVar(tsBrokerLink *psLink, tsVar *psVar);
+
+
+/** As eJIP_SetVar, through JIPd if it can.
+ *  \param psLink           Open link
+ *  \param psVar            Variable of a node in the link's context
+ *  \param pvData           Value
+ *  \param u32Size          Size of value
+ *  \return Status of the set
+ */
+teJIP_Status eBrokerSetVar(tsBrokerLink *psLink, tsVar *psVar, void *pvData, uint32_t u32Size);
+
+
+/** As eJIP_MulticastSetVar, through JIPd if it can.
+ *  \param psLink           Open link
+ *  \param psVar            Variable of a node in the link's context, giving the MiB, variable and type
+ *  \param pvData           Value
+ *  \param u32Size          Size of value
+ *  \param psAddress        Group address
+ *  \param iHops            Hops to multicast for
+ *  \return Status of the set
+ */
+teJIP_Status eBrokerMulticastSetVar(tsBrokerLink *psLink, tsVar *psVar, void *pvData, uint32_t u32Size, 
+                                    tsJIPAddress *psAddress, int iHops);
+
+
+#endif /* __BROKER_H_ */
@@ -52,25 +52,32 @@
 #include <Zeroconf.h> 
 #include <JIP.h>
 
+#include "Broker.h"
 #include "CGI.h"
+#include "Multicall.h"
+#include "NetworkCache.h"
+#include "NodeWalk.h"
+#include "Response.h"
+#include "Template.h"
+#include "Browser_tmpl.h"
 
 #define DISPLAY_JENNET_MIB
 
 //#define TIME_ANALYSIS
 
-#define CACHE_DEFINITIONS_FILE_NAME "/tmp/jip_cache_definitions.xml"
-#define CACHE_NETWORK_FILE_NAME "/tmp/jip_cache_network.xml"
-
 static int verbosity = 0;
 
 #ifndef VERSION
 #error Version is not defined!
 #else
-const char *Version = "0.5 (r" VERSION ")";
+static const char *Version = "0.5 (r" VERSION ")";
 #endif
 
 static tsJIP_Context sJIP_Context;
 
+/** Link that variables are read and set through, via JIPd where it is running */
+static tsBrokerLink sLink;
+
 #ifdef TIME_ANALYSIS
 struct timeval time_now;
 #define TIME_NOW(a) gettimeofday(&time_now, NULL); printf("%s: %u.%u\n", a, (unsigned int)time_now.tv_sec, (unsigned int)time_now.tv_usec);fflush(stdout); 
@@ -80,6 +87,9 @@ struct timeval time_now;
 
 static tsCGI sCGI;
 
+/** Response to the request, compressed if the client allows it */
+static tsResponse sResponse;
+
 static char *pcConnect_address = NULL;
 
 static const int read_config(void)
@@ -88,23 +98,28 @@ static const int read_config(void)
     struct in6_addr *asAddresses;
     if (ZC_Get_Module_Addresses(&asAddresses, &iNumAddresses) != 0)
     {
-        printf("Could not get coordinator address\n");
+        fprintf(stderr, "Could not get coordinator address\n");
     }
     else
     {
-        if (iNumAddresses != 1)
+        if (iNumAddresses < 1)
         {
-            printf("Discovered an unhandled number of coordinators (%d)\n", iNumAddresses);
+            fprintf(stderr, "Discovered no coordinators\n");
         }
         else
         {
             char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
-            /* Just use the first one for now */
+            
+            if (iNumAddresses > 1)
+            {
+                /* JIP.cgi can merge them all with BRaddress=all. This page shows one network */
+                fprintf(stderr, "Discovered %d coordinators, using the first\n", iNumAddresses);
+            }
             inet_ntop(AF_INET6, asAddresses, buffer, INET6_ADDRSTRLEN);
             
             //printf("Got address %s\n", buffer);
             
-            pcConnect_address = strdup(buffer);
+            pcConnect_address = pcArenaStrdup(&sCGI.sArena, buffer);
         }
         free(asAddresses);
     }
@@ -113,7 +128,7 @@ static const int read_config(void)
 }
 
 
-int main(int argc, char *argv[])
+int CGI_MAIN(Browser_cgi)(int argc, char *argv[])
 {
     char *pcMode = NULL;
     char *pcNodeAddress = NULL;
@@ -123,6 +138,12 @@ int main(int argc, char *argv[])
     char *pcUpdateVar = NULL;
     char *pcUpdateValue = NULL;
     char *pcMiB = NULL;
+    char *pcRefresh = NULL;
+    teNetworkCacheRefresh eRefresh;
+    int iAge = 0;
+    int iNeedVariables;
+    tsNetworkCacheModel sModel;
+    tsTemplateOutput sOutput;
 
     if (eCGIReadVariables(&sCGI) != E_CGI_OK)
     {
@@ -143,6 +164,7 @@ int main(int argc, char *argv[])
     pcUpdateMib         = pcCGIGetValue(&sCGI, "mib");
     pcUpdateVar         = pcCGIGetValue(&sCGI, "var");
     pcUpdateValue       = pcCGIGetValue(&sCGI, "value");
+    pcRefresh           = pcCGIGetValue(&sCGI, "refresh");
 
     
     if (pcMulticastAddress)
@@ -154,7 +176,8 @@ int main(int argc, char *argv[])
         pcUpdateAddress = pcNodeAddress;
     }
     
-    printf("Content-type: text/html\r\n\r\n");
+    eResponseInit(&sResponse, STDOUT_FILENO);
+    eResponseHeader(&sResponse, "Content-type: text/html");
     
     TIME_NOW("Read config");
 
@@ -162,29 +185,52 @@ int main(int argc, char *argv[])
     
     if (pcConnect_address == NULL)
     {
-        printf("Failed to find gateway address\n");
+        eResponsePrintf(&sResponse, "Failed to find gateway address\n");
+        eResponseFinish(&sResponse);
         return -1;
     }
 
     if (eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK)
     {
-        printf("JIP startup failed\n");
+        eResponsePrintf(&sResponse, "JIP startup failed\n");
     }
 
-    if (eJIP_Connect(&sJIP_Context, pcConnect_address, JIP_DEFAULT_PORT) != E_JIP_OK)
+    /* Only connects to the border router if the network must be rediscovered,
+     * or JIPd is not running to make the requests through */
+    eBrokerLinkOpen(&sLink, &sJIP_Context, pcConnect_address);
+    
+    TIME_NOW("JIP link open");
+    
+    if (((pcUpdateAddress) && (pcUpdateMib) && (pcUpdateVar) && (pcUpdateValue)) && (!pcRefresh))
+    {
+        /* Updates only need to find the variable - any snapshot will do */
+        eRefresh = E_NETWORK_CACHE_REFRESH_NEVER;
+    }
+    else
     {
-        printf("JIP connect failed\n");
+        eRefresh = eNetworkCacheRefreshPolicy(pcRefresh);
     }
     
-    TIME_NOW("JIP Connected");
+    /* Only updates and the MiB page need live variables. The network and
+     * node pages are drawn from the node model of the snapshot, so the
+     * cached network does not have to be loaded for them. */
+    iNeedVariables = ((pcUpdateAddress) && (pcUpdateMib) && (pcUpdateVar) && (pcUpdateValue)) ||
+                     ((pcNodeAddress) && (pcMiB));
     
-    /* Load the cached device id's and any network contents if possible */
-    if (eJIPService_PersistXMLLoadDefinitions(&sJIP_Context, CACHE_DEFINITIONS_FILE_NAME) != E_JIP_OK)
+    memset(&sModel, 0, sizeof(tsNetworkCacheModel));
+    
+    if (iNeedVariables)
+    {
+        if (eBrokerAcquireNetwork(&sLink, eRefresh, &iAge) != E_JIP_OK)
+        {
+            eResponsePrintf(&sResponse, "JIP discover network failed\n");
+        }
+    }
+    else
     {
-        // Couldn't load the definitions file, fall back to discovery.
-        if (eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
+        if (eBrokerAcquireModel(&sLink, eRefresh, &sModel, &iAge) != E_JIP_OK)
         {
-            printf("JIP discover network failed\n");
+            eResponsePrintf(&sResponse, "JIP discover network failed\n");
         }
     }
     
@@ -192,26 +238,16 @@ int main(int argc, char *argv[])
     
     if (((pcUpdateAddress) && (pcUpdateMib) && (pcUpdateVar) && (pcUpdateValue)))
     {
+        tsNodeWalk sWalk;
         tsNode *psNode;
         tsMib *psMib;
         tsVar *psVar;
         
-        /* Load the cached network if possible */
-        if (eJIPService_PersistXMLLoadNetwork(&sJIP_Context, CACHE_NETWORK_FILE_NAME) != E_JIP_OK)
-        {
-            // Couldn't load the network file, fall back to discovery.
-            if (eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
-            {
-                printf("JIP discover network failed\n");
-            }
-        }
-
-        printf("Update node %s, mib %s, var %s to value %s ... \n", pcUpdateAddress, pcUpdateMib, pcUpdateVar, pcUpdateValue);
+        eResponsePrintf(&sResponse, "Update node %s, mib %s, var %s to value %s ... \n", pcUpdateAddress, pcUpdateMib, pcUpdateVar, pcUpdateValue);
         
-        eJIP_Lock(&sJIP_Context);
-
-        psNode = sJIP_Context.sNetwork.psNodes;
-        while (psNode)
+        /* Only the node being looked at is locked while the value is set */
+        (void)eNodeWalkStart(&sWalk, &sJIP_Context, JIP_DEVICEID_ALL);
+        for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
         {
             char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
             inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, buffer, INET6_ADDRSTRLEN);
@@ -227,8 +263,9 @@ int main(int argc, char *argv[])
                     psVar = psJIP_LookupVar(psMib, NULL, pcUpdateVar);
                     if (psVar)
                     {
+                        /* Value buffers come from the request's arena */
                         char *buf = NULL;
-                        int supported = 1, freeable = 1;
+                        int supported = 1;
                         uint32_t u32Size = 0;
                         
                         //printf("Found variable to update\n");
@@ -237,12 +274,13 @@ int main(int argc, char *argv[])
                         {
                             case (E_JIP_VAR_TYPE_INT8):
                             case (E_JIP_VAR_TYPE_UINT8):
-                                buf = malloc(sizeof(uint8_t));
+                                buf = pvArenaAlloc(&sCGI.sArena, sizeof(uint8_t));
                                 errno = 0;
                                 buf[0] = strtoul(pcUpdateValue, NULL, 0);
                                 if (errno)
                                 {
-                                    printf("Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponsePrintf(&sResponse, "Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponseFinish(&sResponse);
                                     return 0;
                                 }
                                 break;
@@ -255,10 +293,11 @@ int main(int argc, char *argv[])
                                 u16Var = strtoul(pcUpdateValue, NULL, 0);
                                 if (errno)
                                 {
-                                    printf("Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponsePrintf(&sResponse, "Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponseFinish(&sResponse);
                                     return 0;
                                 }
-                                buf = malloc(sizeof(uint16_t));
+                                buf = pvArenaAlloc(&sCGI.sArena, sizeof(uint16_t));
                                 memcpy(buf, &u16Var, sizeof(uint16_t));
                                 break;
                             }
@@ -271,10 +310,11 @@ int main(int argc, char *argv[])
                                 u32Var = strtoul(pcUpdateValue, NULL, 0);
                                 if (errno)
                                 {
-                                    printf("Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponsePrintf(&sResponse, "Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponseFinish(&sResponse);
                                     return 0;
                                 }
-                                buf = malloc(sizeof(uint32_t));
+                                buf = pvArenaAlloc(&sCGI.sArena, sizeof(uint32_t));
                                 memcpy(buf, &u32Var, sizeof(uint32_t));
                                 break;
                             }
@@ -287,10 +327,11 @@ int main(int argc, char *argv[])
                                 u64Var = strtoull(pcUpdateValue, NULL, 0);
                                 if (errno)
                                 {
-                                    printf("Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponsePrintf(&sResponse, "Invalid value: '%s'\n\r", pcUpdateValue);
+                                    eResponseFinish(&sResponse);
                                     return 0;
                                 }
-                                buf = malloc(sizeof(uint64_t));
+                                buf = pvArenaAlloc(&sCGI.sArena, sizeof(uint64_t));
                                 memcpy(buf, &u64Var, sizeof(uint64_t));
                                 break;
                             }
@@ -298,7 +339,7 @@ int main(int argc, char *argv[])
                             case (E_JIP_VAR_TYPE_FLT):
                             {
                                 float f32Var = strtof(pcUpdateValue, NULL);
-                                buf = malloc(sizeof(uint32_t));
+                                buf = pvArenaAlloc(&sCGI.sArena, sizeof(uint32_t));
                                 memcpy(buf, &f32Var, sizeof(uint32_t));
                                 break;
                             }
@@ -306,7 +347,7 @@ int main(int argc, char *argv[])
                             case (E_JIP_VAR_TYPE_DBL):
                             {
                                 double d64Var = strtod(pcUpdateValue, NULL);
-                                buf = malloc(sizeof(uint64_t));
+                                buf = pvArenaAlloc(&sCGI.sArena, sizeof(uint64_t));
                                 memcpy(buf, &d64Var, sizeof(uint64_t));
                                 break;
                             }
@@ -316,15 +357,13 @@ int main(int argc, char *argv[])
                                 buf = pcUpdateValue;
                                 //printf("Update to \"%s\"\n", buf);
                                 u32Size = strlen(pcUpdateValue);
-                                freeable = 0;
                                 break;
                             }
                                 
                             case(E_JIP_VAR_TYPE_BLOB):
                             {
                                 int i, j;
-                                buf = malloc(strlen(pcUpdateValue));
-                                memset(buf, 0, strlen(pcUpdateValue));
+                                buf = pvArenaZalloc(&sCGI.sArena, strlen(pcUpdateValue));
                                 if (strncmp(pcUpdateValue, "0x", 2) == 0)
                                 {
                                     pcUpdateValue += 2;
@@ -348,7 +387,7 @@ int main(int argc, char *argv[])
                                     }
                                     else
                                     {
-                                        printf("String contains non-hex character\n");
+                                        eResponsePrintf(&sResponse, "String contains non-hex character\n");
                                         supported = 0;
                                         break;
                                     }
@@ -400,303 +439,146 @@ int main(int argc, char *argv[])
                                     if (s == 0)
                                     {
                                         fprintf(stderr, "Unknown host: %s\n", pcUpdateAddress);
+                                        eResponseFinish(&sResponse);
                                         return 0;
                                     }
                                     else if (s < 0)
                                     {
                                         perror("inet_pton failed");
+                                        eResponseFinish(&sResponse);
                                         return 0;
                                     }
                                 }
                                 
-                                if (eJIP_MulticastSetVar(&sJIP_Context, psVar, buf, u32Size, &MCastAddress, 2) != E_JIP_OK)
+                                if (eBrokerMulticastSetVar(&sLink, psVar, buf, u32Size, &MCastAddress, 2) != E_JIP_OK)
                                 {
-                                    printf("Error setting new value\n");
+                                    eResponsePrintf(&sResponse, "Error setting new value\n");
                                 }
                                 else
                                 {
-                                    printf("Success\n");
+                                    eResponsePrintf(&sResponse, "Success\n");
                                 }
                             }
                             else
                             {
-                                if (eJIP_SetVar(&sJIP_Context, psVar, buf, u32Size) != E_JIP_OK)
+                                if (eBrokerSetVar(&sLink, psVar, buf, u32Size) != E_JIP_OK)
                                 {
-                                    printf("Error setting new value\n");
+                                    eResponsePrintf(&sResponse, "Error setting new value\n");
                                 }
                                 else
                                 {
-                                    printf("Success\n");
+                                    eResponsePrintf(&sResponse, "Success\n");
                                 }
                             }
                         }
                         else
                         {
-                            printf("Variable type not supported\n");
-                        }
-                        
-                        if (freeable)
-                        {
-                            free(buf);
+                            eResponsePrintf(&sResponse, "Variable type not supported\n");
                         }
                         goto updated;
                     }
                 }
             }
-            psNode = psNode->psNext;
         }
 updated:
-        eJIP_Unlock(&sJIP_Context);
+        vNodeWalkEnd(&sWalk);
         TIME_NOW("Variable updated");
     }
     else
     {
-        printf("<HTML><HEAD><TITLE>\n");
-        printf("JenNet-IP Browser\n");
-        printf("</TITLE>\n");
-        printf("<link rel=\"stylesheet\" href=\"/style.css\" type=\"text/css\" media=\"screen\" />\n");
-        
-        printf("<script type=\"text/javascript\"> \n\
-                function UpdateVariable(address, mib, variable, mcastaddress, value) \n\
-                { \n\
-                    var xmlhttp; \n\
-                    if (window.XMLHttpRequest) \n\
-                    {// code for IE7+, Firefox, Chrome, Opera, Safari \n\
-                        xmlhttp=new XMLHttpRequest(); \n\
-                    } \n\
-                    else \n\
-                    {// code for IE6, IE5 \n\
-                        xmlhttp=new ActiveXObject(\"Microsoft.XMLHTTP\"); \n\
-                    } \n\
-                    var request; \n\
-                    var path = \"Browser.cgi\"; \n\
-                    if (mcastaddress) {\n\
-                        request = \"mcastaddress=\" + mcastaddress \n\
-                    }\n\
-                    else {\n\
-                        request = \"nodeaddress=\" + address \n\
-                    }\n\
-                    request = request + \"&mib=\" + mib \n\
-                    request = request + \"&var=\" + variable \n\
-                    request = request + \"&value=\" + value \n\
-                    \n\
-                    xmlhttp.onreadystatechange=function() \n\
-                    { \n\
-                        if (xmlhttp.readyState==4 && xmlhttp.status==200) \n\
-                        { \n\
-                            document.getElementById(\"result\").innerHTML=xmlhttp.responseText; \n\
-                        } \n\
-                    } \n\
-                    xmlhttp.open(\"POST\",path,true); \n\
-                    xmlhttp.setRequestHeader(\"Content-type\",\"application/x-www-form-urlencoded\"); \n\
-                    xmlhttp.send(request); \n\
-                } \n\
-                </script>");
-        
-        printf("<script type=\"text/javascript\"> \n\
-                function getWindowHeight() { \n\
-                var windowHeight=0; \n\
-                if (typeof(window.innerHeight)=='number') { \n\
-                windowHeight=window.innerHeight; \n\
-                } \n\
-                else { \n\
-                if (document.documentElement&& \n\
-                document.documentElement.clientHeight) { \n\
-                windowHeight= \n\
-                document.documentElement.clientHeight; \n\
-                } \n\
-                else { \n\
-                if (document.body&&document.body.clientHeight) { \n\
-                windowHeight=document.body.clientHeight; \n\
-                } \n\
-                } \n\
-                } \n\
-                return windowHeight; \n\
-                } \n\n\
-                function setFooter() { \n\
-                if (document.getElementById) { \n\
-                var windowHeight=getWindowHeight(); \n\
-                if (windowHeight>0) { \n\
-                var contentHeight= \n\
-                document.getElementById('content').offsetHeight + \n\
-                document.getElementById('header').offsetHeight + \n\
-                document.getElementById('navigation').offsetHeight; \n\
-                var footerElement= \n\
-                document.getElementById('footer'); \n\
-                var footerHeight=footerElement.offsetHeight; \n\
-                if (windowHeight-(contentHeight+footerHeight)>=0) { \n\
-                footerElement.style.position='relative'; \n\
-                footerElement.style.top=(windowHeight- \n\
-                (contentHeight+footerHeight))+'px'; \n\
-                } \n\
-                else { \n\
-                footerElement.style.position='static'; \n\
-                } \n\
-                } \n\
-                } \n\
-                } \n\
-                window.onload = function() { \n\
-                    setFooter(); \n\
-                    var forms = document.getElementsByTagName('form'); \n\
-                    for (var i = 0; i < forms.length; i++) { \n\
-                        forms[i].reset(); \n\
-                    } \n\
-                } \n\
-                window.onresize = function() { \n\
-                setFooter(); \n\
-                } \n\
-                </script>\n");
-
-        printf("</HEAD><body><div id=\"container\" >\n");
-        
-        printf("<div id=\"header\"><div style=\"float: left;\"><H1>NXP JenNet-IP Browser</H1></div>");
-        printf("<div style=\"float: right;\"><img src=\"/img/NXP_logo.gif\"></div>");
-   
-        printf("</div>\n"); 
-
-        printf("<div id=\"navigation\"><ul>\n");
-    
-        printf("  <li %s><a href=\"/cgi-bin/Browser.cgi?Mode=Network\">Network</a></li>\n", strcmp(pcMode, "Network") ? "": "class=\"selected\"");
+        eTemplateOutputInit(&sOutput);
+        eTemplateRender(&sOutput, &sTemplateBrowserHead);
+        eTemplateRender(&sOutput, &sTemplateBrowserNavNetwork, strcmp(pcMode, "Network") ? "": "class=\"selected\"");
         
         if (pcNodeAddress)
         {
-            printf("  <li %s><a href=\"/cgi-bin/Browser.cgi?Mode=Node&nodeaddress=%s\">Node: %s</a></li>\n", strcmp(pcMode, "Node") ? "": "class=\"selected\"", pcNodeAddress, pcNodeAddress);
+            eTemplateRender(&sOutput, &sTemplateBrowserNavNode, strcmp(pcMode, "Node") ? "": "class=\"selected\"", pcNodeAddress);
             
             if (pcMiB)
             {
-                printf("  <li %s><a href=\"/cgi-bin/Browser.cgi?Mode=MiB&nodeaddress=%s&mib=%s\">MiB: %s</a></li>\n", strcmp(pcMode, "MiB") ? "": "class=\"selected\"", pcNodeAddress, pcMiB, pcMiB);
+                eTemplateRender(&sOutput, &sTemplateBrowserNavMib, strcmp(pcMode, "MiB") ? "": "class=\"selected\"", pcNodeAddress, pcMiB);
             }
         }
-        printf("</ul></div>\n\n");
-        printf("<div id=\"content\">\n");
-        
-        if (eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
-        {
-            printf("JIP discover network failed\n");
-        }
+        eTemplateRender(&sOutput, &sTemplateBrowserNavEnd);
 
         if ((!pcNodeAddress))
         {
             // Show all available nodes
-            tsNode *psNode;
-            tsMib *psMib;
-            tsVar *psVar;
-            printf("<div>\n");
-            printf("<P style=\"margin-left: 10px; \"><H2>Network Contents</H2></P>\n");
+            uint32_t i;
             
-            eJIP_Lock(&sJIP_Context);
+            eTemplateRender(&sOutput, &sTemplateBrowserNetworkBegin, pcTemplateFormat(&sOutput, "%d", iAge));
             
-            psNode = sJIP_Context.sNetwork.psNodes;
-            while (psNode)
+            for (i = 0; (sModel.psHeader) && (i < sModel.psHeader->u32NumNodes); i++)
             {
-                char acName[255] = "Unknown";
+                const tsNetworkCacheNode *psModelNode = &sModel.psNodes[i];
                 char *pcIPv6URL;
                 char tempbuffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
-                inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, tempbuffer, INET6_ADDRSTRLEN);
+                inet_ntop(AF_INET6, &psModelNode->sAddress, tempbuffer, INET6_ADDRSTRLEN);
                 
-                if (eCGIURLEncode(&pcIPv6URL, tempbuffer) != E_CGI_OK)
+                if (eCGIURLEncode(&sCGI.sArena, &pcIPv6URL, tempbuffer) != E_CGI_OK)
                 {
-                    pcIPv6URL = strdup("Unknown Address");
+                    pcIPv6URL = "Unknown Address";
                 }
                 
-                psMib = psJIP_LookupMib(psNode, NULL, "Node");
-
-                if (psMib)
+                if (psModelNode->u32Name)
                 {
-                    psVar = psJIP_LookupVar(psMib, NULL, "DescriptiveName");
-                    
-                    if (psVar)
-                    {
-                        if (eJIP_GetVar(&sJIP_Context, psVar) == E_JIP_OK)
-                        {
-                            if ((psVar->pvData) && (psVar->eVarType == E_JIP_VAR_TYPE_STR))
-                            {
-                                sprintf(acName, "%s", ((uint8_t*)psVar->pvData));
-                                printf("<div><H3><a href=\"/cgi-bin/Browser.cgi?Mode=Node&nodeaddress=%s\">%s</a></H3></div>\n", pcIPv6URL, acName);
-                            }
-                        }
-                        else
-                        {
-                            printf("<div><H3><a href=\"/cgi-bin/Browser.cgi?Mode=Node&nodeaddress=%s\">Unknown name (%s)</a></H3></div>\n", pcIPv6URL, tempbuffer);
-                        }
-                    }
+                    eTemplateRender(&sOutput, &sTemplateBrowserNetworkNode, 
+                                    pcIPv6URL, pcNetworkCacheModelString(&sModel, psModelNode->u32Name));
                 }
                 else
                 {
-                    printf("No Node Mib for address %s<BR>\n", tempbuffer);
+                    eTemplateRender(&sOutput, &sTemplateBrowserNetworkNodeUnknown, pcIPv6URL, tempbuffer);
                 }
-                free(pcIPv6URL);
-                psNode = psNode->psNext;
             }
-            eJIP_Unlock(&sJIP_Context);
-            printf("</div>\n");
+            eTemplateRender(&sOutput, &sTemplateBrowserSectionEnd);
         }
         else
         {
             if (!pcMiB)
             {
                 // Viewing a specific Node
-                tsNode *psNode;
-                tsMib *psMib;
-                tsVar *psVar;
+                const tsNetworkCacheNode *psModelNode = NULL;
+                struct in6_addr sNodeAddress;
+                uint32_t i;
 
-                printf("<div>\n");
-                printf("<P style=\"margin-left: 10px; \"><H2>Node \"%s\" MiBs:</H2></P><HR>\n", pcNodeAddress);
+                eTemplateRender(&sOutput, &sTemplateBrowserNodeBegin, pcNodeAddress);
 
-                eJIP_Lock(&sJIP_Context);
+                if ((sModel.psHeader) && (inet_pton(AF_INET6, pcNodeAddress, &sNodeAddress) == 1))
+                {
+                    psModelNode = psNetworkCacheModelLookupNode(&sModel, &sNodeAddress);
+                }
                 
-                psNode = sJIP_Context.sNetwork.psNodes;
-                while (psNode)
+                for (i = 0; (psModelNode) && (i < psModelNode->u32NumMibs); i++)
                 {
-                    char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
-                    inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, buffer, INET6_ADDRSTRLEN);
-                    
-                    if (strcmp(pcNodeAddress, buffer))
+                    const tsNetworkCacheMib *psModelMib = &sModel.psMibs[psModelNode->u32FirstMib + i];
+                    const char *pcMibName = pcNetworkCacheModelString(&sModel, psModelMib->u32Name);
+#ifndef DISPLAY_JENNET_MIB
+                    if (strcmp("JenNet", pcMibName) == 0)
                     {
-                        /* Not the node - next */
-                        psNode = psNode->psNext;
+                        /* Don't care much about this */
                         continue;
                     }
-
-                    psMib = psNode->psMibs;
-                    while (psMib)
-                    {
-#ifndef DISPLAY_JENNET_MIB
-                        if (strcmp("JenNet", psMib->pcName) == 0)
-                        {
-                            /* Don't care much about this */
-                            psMib = psMib->psNext;
-                            continue;
-                        }
 #endif /* DISPLAY_JENNET_MIB */
 
-                        if (!pcUpdateMib)
-                        {
-                            printf("  <div class=\"MiB\"><span>MiB ID 0x%08x</span><a href=\"/cgi-bin/Browser.cgi?Mode=MiB&nodeaddress=%s&mib=%s\"><H2>%s</H2></a></div><HR>\n", 
-                                   psMib->u32MibId, buffer, psMib->pcName, psMib->pcName);
-                        }
-                        psMib = psMib->psNext;
-                    }
-                    psNode = psNode->psNext;
+                    eTemplateRender(&sOutput, &sTemplateBrowserNodeMib, 
+                                    pcTemplateFormat(&sOutput, "0x%08x", psModelMib->u32MibId), pcNodeAddress, pcMibName);
                 }
-                eJIP_Unlock(&sJIP_Context);
-                printf("</div>\n");
+                eTemplateRender(&sOutput, &sTemplateBrowserSectionEnd);
             }
             else
             {
                 // Viewing a specific MiB on a specific Node
+                tsNodeWalk sWalk;
                 tsNode *psNode;
                 tsMib *psMib;
                 tsVar *psVar;
                 int VarID = 0;
                 
-                printf("<div>\n");
-                printf("<P style=\"margin-left: 10px; \"><H2>MiB \"%s\" on Node \"%s\" variables:</H2></P><HR>\n", pcMiB, pcNodeAddress);
+                eTemplateRender(&sOutput, &sTemplateBrowserMibBegin, pcMiB, pcNodeAddress);
 
-                eJIP_Lock(&sJIP_Context);
-                
-                psNode = sJIP_Context.sNetwork.psNodes;
-                while (psNode)
+                /* Each variable is read over the network with only its node locked */
+                (void)eNodeWalkStart(&sWalk, &sJIP_Context, JIP_DEVICEID_ALL);
+                for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
                 {
                     char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
                     inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, buffer, INET6_ADDRSTRLEN);
@@ -704,7 +586,6 @@ updated:
                     if (strcmp(pcNodeAddress, buffer))
                     {
                         /* Not the node - next */
-                        psNode = psNode->psNext;
                         continue;
                     }
 
@@ -716,10 +597,15 @@ updated:
                             psVar = psMib->psVars;
                             while (psVar)
                             {
-                                char *acCurrentValue = malloc(255);
                                 uint32_t u32CurrentValueLength = 255;
+                                char *acCurrentValue = pvArenaAlloc(&sCGI.sArena, u32CurrentValueLength);
                                 
-                                if (eJIP_GetVar(&sJIP_Context, psVar) == E_JIP_OK)
+                                if (!acCurrentValue)
+                                {
+                                    break;
+                                }
+                                
+                                if (eBrokerGetVar(&sLink, psVar) == E_JIP_OK)
                                 {
                                     if (psVar->pvData)
                                     {
@@ -762,9 +648,26 @@ updated:
 
                                                     for (i = 0; i < psTable->u32NumRows; i++)
                                                     {
-                                                        uint8_t *pcNewCurrentValue;
+                                                        char *pcNewCurrentValue;
+                                                        uint32_t u32RowLength;
                                                         psTableRow = &psTable->psRows[i];
                                                         
+                                                        /* Make room for the row before printing it. Only the 
+                                                         * latest allocation is grown, so this is normally in place */
+                                                        u32RowLength = 64 + (psTableRow->pvData ? psTableRow->u32Length * 2 : 0);
+                                                        if (u32CurrentValuePos + u32RowLength > u32CurrentValueLength)
+                                                        {
+                                                            pcNewCurrentValue = pvArenaGrow(&sCGI.sArena, acCurrentValue, u32CurrentValueLength,
+                                                                                            u32CurrentValuePos + u32RowLength + 255);
+                                                            if (!pcNewCurrentValue)
+                                                            {
+                                                                eTemplateWriteStatic(&sOutput, "Failed to print Table\n");
+                                                                break;
+                                                            }
+                                                            acCurrentValue = pcNewCurrentValue;
+                                                            u32CurrentValueLength = u32CurrentValuePos + u32RowLength + 255;
+                                                        }
+                                                        
                                                         if (psTableRow->pvData)
                                                         {
                                                             uint32_t j;
@@ -780,16 +683,6 @@ updated:
                                                         {
                                                             u32CurrentValuePos += sprintf(&acCurrentValue[u32CurrentValuePos], "<P style=\"margin-left: 50px; \"> %03d { Empty Row }</P>\n", i);
                                                         }
-                                                        u32CurrentValueLength = u32CurrentValuePos + 255;
-
-                                                        pcNewCurrentValue = realloc(acCurrentValue, u32CurrentValueLength);
-                                                        
-                                                        if (!pcNewCurrentValue)
-                                                        {
-                                                            printf("Failed to print Table\n");
-                                                            break;
-                                                        }
-                                                        acCurrentValue = pcNewCurrentValue;
                                                     }
                                                 }
                                                 else
@@ -814,62 +707,41 @@ updated:
 
                                 if (psVar->eAccessType == E_JIP_ACCESS_TYPE_READ_WRITE)
                                 {
-                                    printf("<div class=\"Var\">");
-                                    printf("<span>Variable Index %d</span>\n", psVar->u8Index);
-                                    printf("<H2>%s</H2>", psVar->pcName);
-                                    printf("<form name=\"Var%dEditForm\">\n", VarID);
-                                    
-                                    printf("<script language=\"javascript\"> \n\
-                                        var VarEdit%dChange = function() { \
-                                        UpdateVariable('%s', '%s', '%s', document.Var%dEditForm.mcastaddress.value, document.Var%dEditForm.value.value) \n} \n</script>"
-                                        , VarID, buffer, psMib->pcName, psVar->pcName, VarID, VarID);
-                            
-                                    printf("<div align=\"left\" style=\"position:relative; float:left;\" ><input type=\"text\" name=\"value\" value=\"%s\" /></div>\n", acCurrentValue);
-
-                                    printf("<div align=\"right\" style=\"position:relative; float:right\">\n");
-                                    
-                                    printf("Set via Multicast Address: <input type=\"text\", name=\"mcastaddress\", value=\"%s\">\n", pcMulticastAddress ? pcMulticastAddress : "");
-                                    
-                                    printf("<input type=\"button\" value=\"Update\" onclick=\"VarEdit%dChange();\"/>\n", VarID);
-                                    printf("</div>\n");
-                                    
-                                    printf("</form>\n");
+                                    eTemplateRender(&sOutput, &sTemplateBrowserVarReadWrite,
+                                                    pcTemplateFormat(&sOutput, "%d", psVar->u8Index), psVar->pcName,
+                                                    pcTemplateFormat(&sOutput, "%d", VarID), buffer, psMib->pcName,
+                                                    acCurrentValue, pcMulticastAddress);
                                     VarID++;
-                                    
-                                    printf("</div>");
                                 }
                                 else
                                 {
-                                    printf("<div class=\"Var\"><span>Variable Index %d</span><H2>%s</H2><BR>%s</div>", psVar->u8Index, psVar->pcName, acCurrentValue);
+                                    eTemplateRender(&sOutput, &sTemplateBrowserVarReadOnly,
+                                                    pcTemplateFormat(&sOutput, "%d", psVar->u8Index), psVar->pcName, acCurrentValue);
                                 }
-                                printf("<HR>\n");
+                                /* The value has been copied into the output. Its buffer goes with the arena */
                                 psVar = psVar->psNext;
                             }
                         }
                         psMib = psMib->psNext;
                     }
-                    psNode = psNode->psNext;
                 }
-                eJIP_Unlock(&sJIP_Context);
-                printf("</div>\n");
+                vNodeWalkEnd(&sWalk);
+                eTemplateRender(&sOutput, &sTemplateBrowserSectionEnd);
             }
         }
         
-        printf("<div id=\"result\"></div>\n");
-        printf("</div>"); //content
-        printf("<div id=\"footer\">JIP Browser cgi version %s using libJIP version %s</div>\n", Version, JIP_Version);
-        printf("</div>"); //Container
-        printf("</body></HTML>\n");
+        eTemplateRender(&sOutput, &sTemplateBrowserFooter, Version, JIP_Version);
+        
+        /* Send the whole page in one go */
+        eTemplateFlush(&sOutput, &sResponse);
         
         TIME_NOW("Content generated");
     }
 
-    /* Save the device id's and network contents */
-    (void)eJIPService_PersistXMLSaveDefinitions(&sJIP_Context, CACHE_DEFINITIONS_FILE_NAME);
-    (void)eJIPService_PersistXMLSaveNetwork(&sJIP_Context, CACHE_NETWORK_FILE_NAME);
-
-    TIME_NOW("Network saved");
-    
+    eResponseFinish(&sResponse);
+    vNetworkCacheModelClose(&sModel);
+    vBrokerLinkClose(&sLink);
     eJIP_Destroy(&sJIP_Context);
-
+    vCGIFree(&sCGI);
+    return 0;
 }
@@ -39,6 +39,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <errno.h>
 
 #include <CGI.h>
@@ -62,6 +64,7 @@ teCGIStatus eCGIReadVariables(tsCGI *psCGI)
     /* Initialise variable list */
     psCGI->iNumVars = 0;
     psCGI->asVars   = NULL;
+    vArenaInit(&psCGI->sArena);
     
     /* For debug */
     PRINTF("Content-type: text/html\r\n\r\n");
@@ -92,7 +95,7 @@ teCGIStatus eCGIReadVariables(tsCGI *psCGI)
         if (pcQueryString)
         {
             /* Input provided as QUERY_STRING env variable */
-            pcInputPairs = strdup(pcQueryString);
+            pcInputPairs = pcArenaStrdup(&psCGI->sArena, pcQueryString);
             if (!pcInputPairs)
             {
                 return E_CGI_MEM_ERROR;
@@ -108,7 +111,7 @@ teCGIStatus eCGIReadVariables(tsCGI *psCGI)
             
             if (iLength > 0)
             {
-                pcInputPairs = malloc(iLength+1);
+                pcInputPairs = pvArenaAlloc(&psCGI->sArena, iLength+1);
                 if (!pcInputPairs)
                 {
                     return E_CGI_MEM_ERROR;
@@ -137,6 +140,22 @@ teCGIStatus eCGIReadVariables(tsCGI *psCGI)
     if (pcInputPairs)
     {
         char *pcInputPair = pcInputPairs;
+        const char *pcSeparator;
+        int iMaxVars = 1;
+        
+        /* Size the variable array once, from the number of separators */
+        for (pcSeparator = pcInputPairs; *pcSeparator; pcSeparator++)
+        {
+            if ((*pcSeparator == '&') || (*pcSeparator == ';'))
+            {
+                iMaxVars++;
+            }
+        }
+        psCGI->asVars = pvArenaAlloc(&psCGI->sArena, sizeof(tsCGIVar) * iMaxVars);
+        if (!psCGI->asVars)
+        {
+            return E_CGI_MEM_ERROR;
+        }
         
         while (*pcInputPair)
         {
@@ -158,8 +177,8 @@ teCGIStatus eCGIReadVariables(tsCGI *psCGI)
                 }
                 else
                 {
-                    /* Last pair - point next input pair to end of the pair */
-                    pcNextInputPair = pcInputPair + strlen(pcInputPair);
+                    /* Last pair - point next input pair to the terminating NULL */
+                    pcNextInputPair = pcInputPair + strlen(pcInputPair) - 1;
                 }
             }
             
@@ -176,63 +195,37 @@ teCGIStatus eCGIReadVariables(tsCGI *psCGI)
                 goto next_ip;
             }
             
+            /* Names and values are decoded in place in the input buffer, 
+             * which lives as long as the request's arena */
+            *pcValue = '\0';
+            if ((eCGIURLDecode(pcInputPair)  != E_CGI_OK) ||
+                (eCGIURLDecode(pcValue+1)    != E_CGI_OK))
             {
-                char *pcVarName;
-                char *pcVarValue;
-                
-                pcVarValue = strdup(pcValue+1);
-                if (!pcVarValue)
-                {
-                    return E_CGI_MEM_ERROR;
-                }
-                *pcValue = '\0';
-                
-                pcVarName = strdup(pcInputPair);
-                if (!pcVarName)
-                {
-                    free(pcVarValue);
-                    return E_CGI_MEM_ERROR;
-                }
-                PRINTF("Got var: '%s' = '%s'\n\r", pcVarName, pcVarValue);
-                {
-                    /* Insert into array of variables */
-                    tsCGIVar *psNewCGIVars;
-                    
-                    psCGI->iNumVars++;
-                    psNewCGIVars = realloc(psCGI->asVars, sizeof(tsCGIVar) * psCGI->iNumVars);
-                    if (!psNewCGIVars)
-                    {
-                        free(pcVarName);
-                        free(pcVarValue);
-                        return E_CGI_MEM_ERROR;
-                    }
-                    psCGI->asVars = psNewCGIVars;
-                    
-                    if ((eCGIURLDecode(pcVarName)    != E_CGI_OK) ||
-                        (eCGIURLDecode(pcVarValue)   != E_CGI_OK))
-                    {
-                        free(pcVarName);
-                        free(pcVarValue);
-                        return E_CGI_MEM_ERROR;
-                    }
-                    
-                    psCGI->asVars[psCGI->iNumVars-1].pcName     = pcVarName;
-                    psCGI->asVars[psCGI->iNumVars-1].pcValue    = pcVarValue;
-                }
+                return E_CGI_MEM_ERROR;
             }
+            PRINTF("Got var: '%s' = '%s'\n\r", pcInputPair, pcValue+1);
+            
+            psCGI->asVars[psCGI->iNumVars].pcName     = pcInputPair;
+            psCGI->asVars[psCGI->iNumVars].pcValue    = pcValue+1;
+            psCGI->iNumVars++;
 next_ip:
             /* Move on to next pair - skip the NULL we inserted into the string */
             pcInputPair = pcNextInputPair+1;
         }
     }
     
-    /* Free buffer */
-    free(pcInputPairs);
-    
     return E_CGI_OK;
 }
 
 
+void vCGIFree(tsCGI *psCGI)
+{
+    vArenaFree(&psCGI->sArena);
+    psCGI->iNumVars = 0;
+    psCGI->asVars   = NULL;
+}
+
+
 char* pcCGIGetValue(tsCGI *psCGI, const char *pcVarName)
 {
     int i;
@@ -249,14 +242,18 @@ char* pcCGIGetValue(tsCGI *psCGI, const char *pcVarName)
 }
 
 
-teCGIStatus eCGIURLEncode(char **ppcOutput, const char *pcInput)
+teCGIStatus eCGIURLEncode(tsArena *psArena, char **ppcOutput, const char *pcInput)
 {
     char *pcOutputPos;
     int iLength;
     
-    /* Malloc a buffer double the length of the input to start off with. */
-    iLength = sizeof(char) * strlen(pcInput) * 2;
-    *ppcOutput = malloc(iLength);
+    /* Every character may need escaping as three */
+    iLength = sizeof(char) * ((strlen(pcInput) * 3) + 1);
+    *ppcOutput = psArena ? pvArenaAlloc(psArena, iLength) : malloc(iLength);
+    if (!*ppcOutput)
+    {
+        return E_CGI_MEM_ERROR;
+    }
     
     memset(*ppcOutput, 0, iLength);
     
@@ -290,27 +287,19 @@ teCGIStatus eCGIURLDecode (char *pcInput)
     
     while (*pcInput)
     {
-        if (*pcInput == '%')
+        /* A '%' that is not followed by two hex digits is not an escape, 
+         * and is copied like any other character */
+        if ((*pcInput == '%') && isxdigit((unsigned char)pcInput[1]) && isxdigit((unsigned char)pcInput[2]))
         {
-            char acValue[3] = { 0,0,0 };
+            char acValue[3] = { pcInput[1], pcInput[2], 0 };
             int iCharValue;
             
-            strncpy(acValue, pcInput+1, 2);
-            errno = 0;
             iCharValue = strtoul(acValue, NULL, 16);
+            PRINTF("Unescaped value: 0x%s = '%c'\n", acValue, iCharValue);
             
-            if (!errno)
-            {
-                PRINTF("Unescaped value: 0x%s = '%c'\n", acValue, iCharValue);
-                
-                *pcOutput = (char)iCharValue;
-                pcOutput++;
-                pcInput += 2;
-            }
-            else
-            {
-                PRINTF("Could not unescape value: 0x%s\n", acValue);
-            }
+            *pcOutput = (char)iCharValue;
+            pcOutput++;
+            pcInput += 2;
         } 
         else
         {
@@ -325,3 +314,103 @@ teCGIStatus eCGIURLDecode (char *pcInput)
     return E_CGI_OK;
 }
 
+
+int iCGIETagMatches(const char *pcETag)
+{
+    const char *pcIfNoneMatch = getenv("HTTP_IF_NONE_MATCH");
+    
+    PRINTF("HTTP_IF_NONE_MATCH: %s\n\r", pcIfNoneMatch);
+    return iCGIETagListMatches(pcIfNoneMatch, pcETag);
+}
+
+
+int iCGIETagListMatches(const char *pcIfNoneMatch, const char *pcETag)
+{
+    size_t szETag = strlen(pcETag);
+    const char *pcTag;
+    
+    if (!pcIfNoneMatch)
+    {
+        return 0;
+    }
+    
+    /* Comma separated list of tags, possibly weak ("W/" prefixed) */
+    pcTag = pcIfNoneMatch;
+    while (pcTag)
+    {
+        while ((*pcTag == ' ') || (*pcTag == '\t') || (*pcTag == ','))
+        {
+            pcTag++;
+        }
+        if (strncmp(pcTag, "W/", 2) == 0)
+        {
+            pcTag += 2;
+        }
+        if (*pcTag == '*')
+        {
+            return 1;
+        }
+        if ((strncmp(pcTag, pcETag, szETag) == 0) && 
+            ((pcTag[szETag] == '\0') || (pcTag[szETag] == ',') || (pcTag[szETag] == ' ')))
+        {
+            return 1;
+        }
+        pcTag = strchr(pcTag, ',');
+    }
+    return 0;
+}
+
+
+int iCGIAccepts(const char *pcMediaType)
+{
+    const char *pcAccept = getenv("HTTP_ACCEPT");
+    size_t szMediaType = strlen(pcMediaType);
+    const char *pcRange;
+    
+    if (!pcAccept)
+    {
+        return 0;
+    }
+    PRINTF("HTTP_ACCEPT: %s\n\r", pcAccept);
+    
+    /* Comma separated list of media ranges, each with optional parameters */
+    pcRange = pcAccept;
+    while (pcRange)
+    {
+        const char *pcEnd;
+        const char *pcQuality;
+        
+        while ((*pcRange == ' ') || (*pcRange == '\t') || (*pcRange == ','))
+        {
+            pcRange++;
+        }
+        pcEnd = strchr(pcRange, ',');
+        
+        if ((strncasecmp(pcRange, pcMediaType, szMediaType) == 0) &&
+            ((pcRange[szMediaType] == '\0') || (pcRange[szMediaType] == ',') || 
+             (pcRange[szMediaType] == ';') || (pcRange[szMediaType] == ' ')))
+        {
+            pcQuality = strstr(pcRange, "q=");
+            if ((pcQuality) && ((!pcEnd) || (pcQuality < pcEnd)) && (strtod(pcQuality + 2, NULL) == 0.0))
+            {
+                return 0;
+            }
+            return 1;
+        }
+        pcRange = pcEnd;
+    }
+    return 0;
+}
+
+
+uint32_t u32CGIHash(uint32_t u32Hash, const void *pvData, size_t szLength)
+{
+    const uint8_t *pu8Data = (const uint8_t *)pvData;
+    
+    while (szLength--)
+    {
+        u32Hash ^= *pu8Data++;
+        u32Hash *= 16777619U;
+    }
+    return u32Hash;
+}
@@ -39,6 +39,11 @@
 #ifndef __CGI_H_
 #define __CGI_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Arena.h"
+
 /** Enumerated type of status codes from cgi driver */
 typedef enum
 {
@@ -62,17 +67,24 @@ typedef struct
 {
     int         iNumVars;   /**< Number of variables passed to the cgi program */
     tsCGIVar*   asVars;     /**< Array of \ref tsCGIVar structures containing the variables */
+    tsArena     sArena;     /**< Arena for everything allocated while handling the request */
 } tsCGI;
 
 
 /** Read variables that have been passed to the cgi, either as environment variables 
- *  or on stdinput.
+ *  or on stdinput. The variables, and the request's arena, last until \ref vCGIFree.
  *  \param psCGI            Pointer to CGI structure to populate with variables.
  *  \return E_CGI_OK on success
  */
 teCGIStatus eCGIReadVariables(tsCGI *psCGI);
 
 
+/** Release the variables and everything else allocated from the request's arena.
+ *  \param psCGI            Pointer to CGI structure populated with variables.
+ */
+void vCGIFree(tsCGI *psCGI);
+
+
 /** Get the string value of a variable passed to the program
  *  \param psCGI            Pointer to CGI structure populated with variables.
  *  \param pcVarName        String containging variable name
@@ -82,11 +94,12 @@ char* pcCGIGetValue(tsCGI *psCGI, const char *pcVarName);
 
 
 /** URL Encode the given string.
- *  \param ppcOutput        Pointer to location to store newly mallocd string output
+ *  \param psArena          Arena to allocate the output from, or NULL to malloc it
+ *  \param ppcOutput        Pointer to location to store the new string output
  *  \param pcInput          String containging input string
  *  \return E_CGI_OK on success
  */
-teCGIStatus eCGIURLEncode(char **ppcOutput, const char *pcInput);
+teCGIStatus eCGIURLEncode(tsArena *psArena, char **ppcOutput, const char *pcInput);
 
 
 /** Replaces escaped values in the input string with the real characters.
@@ -96,4 +109,42 @@ teCGIStatus eCGIURLEncode(char **ppcOutput, const char *pcInput);
 teCGIStatus eCGIURLDecode (char *pcInput);
 
 
+/** Check whether the client already holds the current version of a response.
+ *  \param pcETag           Quoted entity tag of the response that would be sent
+ *  \return 1 if the If-None-Match request header lists pcETag (or "*"), otherwise 0.
+ */
+int iCGIETagMatches(const char *pcETag);
+
+
+/** Check whether an If-None-Match header lists an entity tag, as \ref iCGIETagMatches
+ *  does for the request's own header.
+ *  \param pcIfNoneMatch    Value of the If-None-Match header, may be NULL
+ *  \param pcETag           Quoted entity tag
+ *  \return 1 if pcIfNoneMatch lists pcETag (or "*"), otherwise 0.
+ */
+int iCGIETagListMatches(const char *pcIfNoneMatch, const char *pcETag);
+
+
+/** Check whether the client accepts a media type.
+ *  Only an explicit mention of the type counts - wildcard ranges do not, so
+ *  that browsers keep getting the default representation.
+ *  \param pcMediaType      Media type, e.g. "application/cbor"
+ *  \return 1 if the Accept request header lists pcMediaType with a non-zero quality, otherwise 0.
+ */
+int iCGIAccepts(const char *pcMediaType);
+
+
+/** Initial value for \ref u32CGIHash */
+#define CGI_HASH_INIT           2166136261U
+
+/** Accumulate data into a hash (FNV-1a), for building entity tags from
+ *  whatever the response is derived from.
+ *  \param u32Hash          Hash so far, \ref CGI_HASH_INIT to start
+ *  \param pvData           Data to add
+ *  \param szLength         Length of data
+ *  \return Updated hash
+ */
+uint32_t u32CGIHash(uint32_t u32Hash, const void *pvData, size_t szLength);
+
+
 #endif /* __CGI_H_ */
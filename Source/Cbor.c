@@ -0,0 +1,423 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          CBOR encoder
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include <json.h>
+
+#include "Cbor.h"
+
+//#define DEBUG_CBOR
+
+#ifdef DEBUG_CBOR
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_CBOR */
+
+/** Initial size of the output buffer */
+#define CBOR_BUFFER_SIZE            1024
+
+/** Number of entries a table of marked strings grows by */
+#define CBOR_MARKS_INCREMENT        16
+
+/** @{ Major types */
+#define CBOR_MAJOR_UINT             0
+#define CBOR_MAJOR_NINT             1
+#define CBOR_MAJOR_BYTES            2
+#define CBOR_MAJOR_TEXT             3
+#define CBOR_MAJOR_ARRAY            4
+#define CBOR_MAJOR_MAP              5
+#define CBOR_MAJOR_SIMPLE           7
+/** @} */
+
+
+/** Make room for szLength more bytes of output */
+static teCborStatus eReserve(tsCbor *psCbor, size_t szLength)
+{
+    uint8_t *pu8NewBuffer;
+    size_t szNewSize;
+    
+    if (psCbor->eStatus != E_CBOR_OK)
+    {
+        return psCbor->eStatus;
+    }
+    
+    if (psCbor->szLength + szLength <= psCbor->szSize)
+    {
+        return E_CBOR_OK;
+    }
+    
+    szNewSize = psCbor->szSize ? psCbor->szSize : CBOR_BUFFER_SIZE;
+    while (szNewSize < psCbor->szLength + szLength)
+    {
+        szNewSize *= 2;
+    }
+    
+    pu8NewBuffer = realloc(psCbor->pu8Buffer, szNewSize);
+    if (!pu8NewBuffer)
+    {
+        psCbor->eStatus = E_CBOR_NO_MEMORY;
+        return psCbor->eStatus;
+    }
+    psCbor->pu8Buffer = pu8NewBuffer;
+    psCbor->szSize = szNewSize;
+    return E_CBOR_OK;
+}
+
+
+/** Append the initial byte of an item and its argument, in the shortest form */
+static teCborStatus eHead(tsCbor *psCbor, uint8_t u8Major, uint64_t u64Argument)
+{
+    uint8_t *pu8Out;
+    int iNumBytes;
+    int i;
+    
+    if (eReserve(psCbor, 9) != E_CBOR_OK)
+    {
+        return psCbor->eStatus;
+    }
+    pu8Out = &psCbor->pu8Buffer[psCbor->szLength];
+    
+    if (u64Argument < 24)
+    {
+        pu8Out[0] = (u8Major << 5) | (uint8_t)u64Argument;
+        psCbor->szLength += 1;
+        return E_CBOR_OK;
+    }
+    else if (u64Argument <= 0xFF)
+    {
+        pu8Out[0] = (u8Major << 5) | 24;
+        iNumBytes = 1;
+    }
+    else if (u64Argument <= 0xFFFF)
+    {
+        pu8Out[0] = (u8Major << 5) | 25;
+        iNumBytes = 2;
+    }
+    else if (u64Argument <= 0xFFFFFFFFULL)
+    {
+        pu8Out[0] = (u8Major << 5) | 26;
+        iNumBytes = 4;
+    }
+    else
+    {
+        pu8Out[0] = (u8Major << 5) | 27;
+        iNumBytes = 8;
+    }
+    
+    /* Network byte order */
+    for (i = iNumBytes; i > 0; i--)
+    {
+        pu8Out[i] = (uint8_t)u64Argument;
+        u64Argument >>= 8;
+    }
+    psCbor->szLength += 1 + iNumBytes;
+    return E_CBOR_OK;
+}
+
+
+/** Append raw data after a head */
+static teCborStatus eData(tsCbor *psCbor, const void *pvData, size_t szLength)
+{
+    if (eReserve(psCbor, szLength) != E_CBOR_OK)
+    {
+        return psCbor->eStatus;
+    }
+    memcpy(&psCbor->pu8Buffer[psCbor->szLength], pvData, szLength);
+    psCbor->szLength += szLength;
+    return E_CBOR_OK;
+}
+
+
+teCborStatus eCborInit(tsCbor *psCbor)
+{
+    memset(psCbor, 0, sizeof(tsCbor));
+    psCbor->eStatus = E_CBOR_OK;
+    return eReserve(psCbor, CBOR_BUFFER_SIZE);
+}
+
+
+void vCborFree(tsCbor *psCbor)
+{
+    free(psCbor->pu8Buffer);
+    free(psCbor->sBytes.ppsObjects);
+    free(psCbor->sUints.ppsObjects);
+    memset(psCbor, 0, sizeof(tsCbor));
+}
+
+
+teCborStatus eCborUint(tsCbor *psCbor, uint64_t u64Value)
+{
+    return eHead(psCbor, CBOR_MAJOR_UINT, u64Value);
+}
+
+
+teCborStatus eCborInt(tsCbor *psCbor, int64_t i64Value)
+{
+    if (i64Value < 0)
+    {
+        /* Negative integers are encoded as -1 - n */
+        return eHead(psCbor, CBOR_MAJOR_NINT, (uint64_t)(-(i64Value + 1)));
+    }
+    return eHead(psCbor, CBOR_MAJOR_UINT, (uint64_t)i64Value);
+}
+
+
+teCborStatus eCborFloat(tsCbor *psCbor, double dValue)
+{
+    uint8_t au8Value[8];
+    int i;
+    
+    if (eReserve(psCbor, 9) != E_CBOR_OK)
+    {
+        return psCbor->eStatus;
+    }
+    
+    if (isnan(dValue))
+    {
+        /* Canonical half precision NaN */
+        static const uint8_t au8NaN[] = { 0xF9, 0x7E, 0x00 };
+        return eData(psCbor, au8NaN, sizeof(au8NaN));
+    }
+    
+    /* Converting a double outside the range of a float is undefined, so
+     * only narrow values that a float can represent, and then only when
+     * nothing is lost */
+    if (isinf(dValue) || ((fabs(dValue) <= FLT_MAX) && ((double)(float)dValue == dValue)))
+    {
+        float fValue = (float)dValue;
+        uint32_t u32Bits;
+        
+        memcpy(&u32Bits, &fValue, sizeof(uint32_t));
+        psCbor->pu8Buffer[psCbor->szLength++] = (CBOR_MAJOR_SIMPLE << 5) | 26;
+        for (i = 3; i >= 0; i--)
+        {
+            au8Value[i] = (uint8_t)u32Bits;
+            u32Bits >>= 8;
+        }
+        return eData(psCbor, au8Value, 4);
+    }
+    else
+    {
+        uint64_t u64Bits;
+        
+        memcpy(&u64Bits, &dValue, sizeof(uint64_t));
+        psCbor->pu8Buffer[psCbor->szLength++] = (CBOR_MAJOR_SIMPLE << 5) | 27;
+        for (i = 7; i >= 0; i--)
+        {
+            au8Value[i] = (uint8_t)u64Bits;
+            u64Bits >>= 8;
+        }
+        return eData(psCbor, au8Value, 8);
+    }
+}
+
+
+teCborStatus eCborText(tsCbor *psCbor, const char *pcText, size_t szLength)
+{
+    if (eHead(psCbor, CBOR_MAJOR_TEXT, szLength) != E_CBOR_OK)
+    {
+        return psCbor->eStatus;
+    }
+    return eData(psCbor, pcText, szLength);
+}
+
+
+teCborStatus eCborBytes(tsCbor *psCbor, const void *pvData, size_t szLength)
+{
+    if (eHead(psCbor, CBOR_MAJOR_BYTES, szLength) != E_CBOR_OK)
+    {
+        return psCbor->eStatus;
+    }
+    return eData(psCbor, pvData, szLength);
+}
+
+
+teCborStatus eCborArray(tsCbor *psCbor, uint32_t u32NumItems)
+{
+    return eHead(psCbor, CBOR_MAJOR_ARRAY, u32NumItems);
+}
+
+
+teCborStatus eCborMap(tsCbor *psCbor, uint32_t u32NumPairs)
+{
+    return eHead(psCbor, CBOR_MAJOR_MAP, u32NumPairs);
+}
+
+
+teCborStatus eCborSimple(tsCbor *psCbor, uint8_t u8Value)
+{
+    return eHead(psCbor, CBOR_MAJOR_SIMPLE, u8Value);
+}
+
+
+/** Add a json-c object to a set of marked objects */
+static teCborStatus eMark(tsCbor *psCbor, tsCborMarks *psMarks, struct json_object *psObject)
+{
+    if (psMarks->u32NumObjects == psMarks->u32Size)
+    {
+        struct json_object **ppsNewObjects;
+        
+        ppsNewObjects = realloc(psMarks->ppsObjects, (psMarks->u32Size + CBOR_MARKS_INCREMENT) * sizeof(struct json_object *));
+        if (!ppsNewObjects)
+        {
+            psCbor->eStatus = E_CBOR_NO_MEMORY;
+            return psCbor->eStatus;
+        }
+        psMarks->ppsObjects = ppsNewObjects;
+        psMarks->u32Size += CBOR_MARKS_INCREMENT;
+    }
+    psMarks->ppsObjects[psMarks->u32NumObjects++] = psObject;
+    psMarks->iSorted = 0;
+    return E_CBOR_OK;
+}
+
+
+teCborStatus eCborMarkBytes(tsCbor *psCbor, struct json_object *psString)
+{
+    return eMark(psCbor, &psCbor->sBytes, psString);
+}
+
+
+teCborStatus eCborMarkUint(tsCbor *psCbor, struct json_object *psString)
+{
+    return eMark(psCbor, &psCbor->sUints, psString);
+}
+
+
+/** Order json-c objects by address */
+static int iComparePointers(const void *pvA, const void *pvB)
+{
+    const struct json_object *psA = *(struct json_object * const *)pvA;
+    const struct json_object *psB = *(struct json_object * const *)pvB;
+    
+    return (psA < psB) ? -1 : (psA > psB);
+}
+
+
+/** Check whether a json-c object is in a set of marked objects */
+static int iIsMarked(tsCborMarks *psMarks, struct json_object *psObject)
+{
+    if (psMarks->u32NumObjects == 0)
+    {
+        return 0;
+    }
+    if (!psMarks->iSorted)
+    {
+        qsort(psMarks->ppsObjects, psMarks->u32NumObjects, sizeof(struct json_object *), iComparePointers);
+        psMarks->iSorted = 1;
+    }
+    return bsearch(&psObject, psMarks->ppsObjects, psMarks->u32NumObjects, sizeof(struct json_object *), iComparePointers) != NULL;
+}
+
+
+teCborStatus eCborEncodeJson(tsCbor *psCbor, struct json_object *psObject)
+{
+    if (!psObject)
+    {
+        return eCborSimple(psCbor, CBOR_NULL);
+    }
+    
+    switch (json_object_get_type(psObject))
+    {
+        case (json_type_null):
+            return eCborSimple(psCbor, CBOR_NULL);
+            
+        case (json_type_boolean):
+            return eCborSimple(psCbor, json_object_get_boolean(psObject) ? CBOR_TRUE : CBOR_FALSE);
+            
+        case (json_type_int):
+            return eCborInt(psCbor, json_object_get_int64(psObject));
+            
+        case (json_type_double):
+            return eCborFloat(psCbor, json_object_get_double(psObject));
+            
+        case (json_type_string):
+        {
+            const char *pcString = json_object_get_string(psObject);
+            size_t szLength = json_object_get_string_len(psObject);
+            
+            if (iIsMarked(&psCbor->sBytes, psObject))
+            {
+                return eCborBytes(psCbor, pcString, szLength);
+            }
+            if (iIsMarked(&psCbor->sUints, psObject))
+            {
+                return eCborUint(psCbor, strtoull(pcString, NULL, 10));
+            }
+            return eCborText(psCbor, pcString, szLength);
+        }
+            
+        case (json_type_array):
+        {
+            int iLength = json_object_array_length(psObject);
+            int i;
+            
+            eCborArray(psCbor, iLength);
+            for (i = 0; i < iLength; i++)
+            {
+                eCborEncodeJson(psCbor, json_object_array_get_idx(psObject, i));
+            }
+            return psCbor->eStatus;
+        }
+            
+        case (json_type_object):
+        {
+            eCborMap(psCbor, json_object_get_object(psObject)->count);
+            {
+                json_object_object_foreach(psObject, pcKey, psValue)
+                {
+                    eCborText(psCbor, pcKey, strlen(pcKey));
+                    eCborEncodeJson(psCbor, psValue);
+                }
+            }
+            return psCbor->eStatus;
+        }
+            
+        default:
+            PRINTF("Unhandled json type %d\n", json_object_get_type(psObject));
+            psCbor->eStatus = E_CBOR_ERROR;
+            return psCbor->eStatus;
+    }
+}
@@ -0,0 +1,204 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          CBOR encoder
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __CBOR_H_
+#define __CBOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <json.h>
+
+/** MIME type of CBOR responses */
+#define CBOR_CONTENT_TYPE           "application/cbor"
+
+
+/** Enumerated type of status codes from the CBOR encoder */
+typedef enum
+{
+    E_CBOR_OK,                  /**< All ok */
+    E_CBOR_ERROR,               /**< Generic error */
+    E_CBOR_NO_MEMORY,           /**< Memory allocation failed */
+} teCborStatus;
+
+
+/** Set of json-c objects marked for special encoding */
+typedef struct
+{
+    struct json_object      **ppsObjects;   /**< Marked objects */
+    uint32_t                u32NumObjects;  /**< Number of marked objects */
+    uint32_t                u32Size;        /**< Allocated size of ppsObjects */
+    int                     iSorted;        /**< Set once ppsObjects has been sorted for searching */
+} tsCborMarks;
+
+
+/** CBOR (RFC 7049) encoder.
+ *  Items are appended to a growable buffer. A json-c tree can be encoded
+ *  in one go, with strings that hold raw data marked beforehand so that
+ *  they are sent as byte strings rather than text, and strings that hold
+ *  unsigned 64 bit integers beyond the range of json-c marked so that they
+ *  are sent as integers. */
+typedef struct
+{
+    uint8_t                 *pu8Buffer;     /**< Encoded data */
+    size_t                  szLength;       /**< Length of encoded data */
+    size_t                  szSize;         /**< Allocated size of buffer */
+    
+    tsCborMarks             sBytes;         /**< json-c strings to encode as byte strings */
+    tsCborMarks             sUints;         /**< json-c strings to encode as unsigned integers */
+    
+    teCborStatus            eStatus;        /**< First error, sticky */
+} tsCbor;
+
+
+/** Initialise an encoder.
+ *  \param psCbor           Encoder
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborInit(tsCbor *psCbor);
+
+
+/** Free an encoder and the data it encoded.
+ *  \param psCbor           Encoder
+ */
+void vCborFree(tsCbor *psCbor);
+
+
+/** Append an unsigned integer, in the shortest form.
+ *  \param psCbor           Encoder
+ *  \param u64Value         Value
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborUint(tsCbor *psCbor, uint64_t u64Value);
+
+
+/** Append a signed integer, in the shortest form.
+ *  \param psCbor           Encoder
+ *  \param i64Value         Value
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborInt(tsCbor *psCbor, int64_t i64Value);
+
+
+/** Append a floating point number.
+ *  Single precision is used when it represents the value exactly.
+ *  \param psCbor           Encoder
+ *  \param dValue           Value
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborFloat(tsCbor *psCbor, double dValue);
+
+
+/** Append a UTF-8 text string.
+ *  \param psCbor           Encoder
+ *  \param pcText           Text
+ *  \param szLength         Length of text in bytes
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborText(tsCbor *psCbor, const char *pcText, size_t szLength);
+
+
+/** Append a byte string.
+ *  \param psCbor           Encoder
+ *  \param pvData           Data
+ *  \param szLength         Length of data
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborBytes(tsCbor *psCbor, const void *pvData, size_t szLength);
+
+
+/** Start an array. The following u32NumItems items are its elements.
+ *  \param psCbor           Encoder
+ *  \param u32NumItems      Number of elements
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborArray(tsCbor *psCbor, uint32_t u32NumItems);
+
+
+/** Start a map. The following 2 * u32NumPairs items are its keys and values.
+ *  \param psCbor           Encoder
+ *  \param u32NumPairs      Number of key / value pairs
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborMap(tsCbor *psCbor, uint32_t u32NumPairs);
+
+
+/** Append a simple value - true, false or null.
+ *  \param psCbor           Encoder
+ *  \param u8Value          One of CBOR_FALSE, CBOR_TRUE or CBOR_NULL
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborSimple(tsCbor *psCbor, uint8_t u8Value);
+
+#define CBOR_FALSE                  20
+#define CBOR_TRUE                   21
+#define CBOR_NULL                   22
+
+
+/** Mark a json-c string as holding raw data.
+ *  \ref eCborEncodeJson sends it as a byte string. Strings can be created
+ *  with json_object_new_string_len so that they may contain any bytes.
+ *  \param psCbor           Encoder
+ *  \param psString         json-c string object
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborMarkBytes(tsCbor *psCbor, struct json_object *psString);
+
+
+/** Mark a json-c string as holding an unsigned 64 bit integer in decimal.
+ *  json-c integers are signed, so values above INT64_MAX are carried this
+ *  way and \ref eCborEncodeJson sends them as CBOR unsigned integers.
+ *  \param psCbor           Encoder
+ *  \param psString         json-c string object
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborMarkUint(tsCbor *psCbor, struct json_object *psString);
+
+
+/** Append a json-c tree.
+ *  Integers keep their width, doubles are sent as floats where that is
+ *  exact and marked strings as byte strings or unsigned integers.
+ *  \param psCbor           Encoder
+ *  \param psObject         Root of the tree. NULL is encoded as null.
+ *  \return E_CBOR_OK on success
+ */
+teCborStatus eCborEncodeJson(tsCbor *psCbor, struct json_object *psObject);
+
+
+#endif /* __CBOR_H_ */
@@ -0,0 +1,597 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          SetVar coalescer
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "Codec.h"
+#include "Coalesce.h"
+#include "GroupModel.h"
+
+//#define DEBUG_COALESCE
+
+#ifdef DEBUG_COALESCE
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_COALESCE */
+
+/** Longest the accept thread waits for a connected client to send its request, in seconds */
+#define COALESCE_REQUEST_TIMEOUT    1
+
+/** Time to wait before accepting again after accept fails, eg. when out of file descriptors, in milliseconds */
+#define COALESCE_ACCEPT_RETRY       100
+
+
+/** Read exactly szLength bytes from a socket. \return non-zero on success */
+static int iReadFull(int iSocket, void *pvBuffer, size_t szLength)
+{
+    uint8_t *pu8Buffer = (uint8_t *)pvBuffer;
+    
+    while (szLength)
+    {
+        ssize_t iBytes = recv(iSocket, pu8Buffer, szLength, 0);
+        if (iBytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return 0;
+        }
+        if (iBytes == 0)
+        {
+            return 0;
+        }
+        pu8Buffer += iBytes;
+        szLength  -= iBytes;
+    }
+    return 1;
+}
+
+
+/** Write exactly szLength bytes to a socket, without being killed if the peer has gone. \return non-zero on success */
+static int iWriteFull(int iSocket, const void *pvBuffer, size_t szLength)
+{
+    const uint8_t *pu8Buffer = (const uint8_t *)pvBuffer;
+    
+    while (szLength)
+    {
+        ssize_t iBytes = send(iSocket, pu8Buffer, szLength, MSG_NOSIGNAL);
+        if (iBytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return 0;
+        }
+        pu8Buffer += iBytes;
+        szLength  -= iBytes;
+    }
+    return 1;
+}
+
+
+static void vSetTimeout(int iSocket, int iSeconds)
+{
+    struct timeval sTimeout;
+    
+    sTimeout.tv_sec  = iSeconds;
+    sTimeout.tv_usec = 0;
+    setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &sTimeout, sizeof(sTimeout));
+    setsockopt(iSocket, SOL_SOCKET, SO_SNDTIMEO, &sTimeout, sizeof(sTimeout));
+}
+
+
+/** Answer a client and close its connection */
+static void vReply(int iClient, teJIP_Status eStatus, int iSuperseded, int iNotHandled, const char *pcDescription)
+{
+    tsCoalesceReply sReply;
+    
+    memset(&sReply, 0, sizeof(tsCoalesceReply));
+    sReply.i32Status        = eStatus;
+    sReply.u32Superseded    = iSuperseded;
+    sReply.u32NotHandled    = iNotHandled;
+    strncpy(sReply.acDescription, pcDescription, sizeof(sReply.acDescription) - 1);
+    
+    if (!iWriteFull(iClient, &sReply, sizeof(tsCoalesceReply)))
+    {
+        PRINTF("Client went away before its reply\n");
+    }
+    close(iClient);
+}
+
+
+/** Find a MiB by name, or failing that by ID */
+static tsMib *psFindMib(tsNode *psNode, const char *pcMib)
+{
+    tsMib *psMib;
+    uint32_t u32MibId;
+    char *pcEnd;
+    
+    psMib = psJIP_LookupMib(psNode, NULL, pcMib);
+    if (psMib)
+    {
+        return psMib;
+    }
+    
+    u32MibId = strtoul(pcMib, &pcEnd, 0);
+    if ((pcEnd == pcMib) || (*pcEnd != '\0'))
+    {
+        return NULL;
+    }
+    for (psMib = psNode->psMibs; psMib; psMib = psMib->psNext)
+    {
+        if (psMib->u32MibId == u32MibId)
+        {
+            return psMib;
+        }
+    }
+    return NULL;
+}
+
+
+/** Find a variable by name, or failing that by index */
+static tsVar *psFindVar(tsMib *psMib, const char *pcVar)
+{
+    tsVar *psVar;
+    uint32_t u32Index;
+    char *pcEnd;
+    
+    psVar = psJIP_LookupVar(psMib, NULL, pcVar);
+    if (psVar)
+    {
+        return psVar;
+    }
+    
+    u32Index = strtoul(pcVar, &pcEnd, 0);
+    if ((pcEnd == pcVar) || (*pcEnd != '\0'))
+    {
+        return NULL;
+    }
+    for (psVar = psMib->psVars; psVar; psVar = psVar->psNext)
+    {
+        if (psVar->u8Index == u32Index)
+        {
+            return psVar;
+        }
+    }
+    return NULL;
+}
+
+
+/** Set the variable of a pending entry and answer its client */
+static void vSetEntry(tsCoalescer *psCoalescer, tsCoalesceEntry *psEntry)
+{
+    tsCoalesceRequest *psRequest = &psEntry->sRequest;
+    tsJIPAddress sAddress;
+    tsNode *psNode;
+    tsMib *psMib;
+    tsVar *psVar;
+    void *pvBuffer;
+    uint32_t u32Size;
+    const char *pcError;
+    teJIP_Status eStatus;
+    
+    memset(&sAddress, 0, sizeof(tsJIPAddress));
+    sAddress.sin6_family    = AF_INET6;
+    sAddress.sin6_port      = htons(JIP_DEFAULT_PORT);
+    inet_pton(AF_INET6, psRequest->acAddress, &sAddress.sin6_addr);
+    
+    /* Lookup returns the node locked */
+    psNode = psJIP_LookupNode(psCoalescer->psJIP_Context, &sAddress);
+    if (!psNode)
+    {
+        /* Not discovered yet - the client may have a newer snapshot */
+        vReply(psEntry->iClient, E_JIP_ERROR_FAILED, 0, 1, "Node not found");
+        return;
+    }
+    
+    psMib = psFindMib(psNode, psRequest->acMib);
+    psVar = psMib ? psFindVar(psMib, psRequest->acVar) : NULL;
+    if (!psVar)
+    {
+        eJIP_UnlockNode(psNode);
+        vReply(psEntry->iClient, E_JIP_ERROR_FAILED, 0, 1, "Variable not found");
+        return;
+    }
+    
+    if (eCodecParseValue(NULL, psVar->eVarType, psRequest->acValue, &pvBuffer, &u32Size, &pcError) != E_CODEC_OK)
+    {
+        eJIP_UnlockNode(psNode);
+        vReply(psEntry->iClient, E_JIP_ERROR_BAD_VALUE, 0, 0, pcError);
+        return;
+    }
+    
+    PRINTF("Set %s %s.%s to %s\n", psRequest->acAddress, psRequest->acMib, psRequest->acVar, psRequest->acValue);
+    eStatus = eJIP_SetVar(psCoalescer->psJIP_Context, psVar, pvBuffer, u32Size);
+    if (eStatus == E_JIP_OK)
+    {
+        (void)eGroupModelSetVar(&sAddress.sin6_addr, psMib->pcName, psVar->pcName, psVar->eVarType, pvBuffer);
+    }
+    eJIP_UnlockNode(psNode);
+    free(pvBuffer);
+    
+    vReply(psEntry->iClient, eStatus, 0, 0, pcJIP_strerror(eStatus));
+}
+
+
+/** Read a request from a new client and make it pending, superseding any pending request for the same variable */
+static void vAcceptRequest(tsCoalescer *psCoalescer, int iClient)
+{
+    tsCoalesceRequest sRequest;
+    tsCoalesceEntry *psEntry;
+    tsCoalesceEntry **ppsLast;
+    struct in6_addr sAddress;
+    int iSuperseded = -1;
+    
+    vSetTimeout(iClient, COALESCE_REQUEST_TIMEOUT);
+    if (!iReadFull(iClient, &sRequest, sizeof(tsCoalesceRequest)))
+    {
+        close(iClient);
+        return;
+    }
+    sRequest.acBRAddress[sizeof(sRequest.acBRAddress) - 1] = '\0';
+    sRequest.acAddress[sizeof(sRequest.acAddress) - 1] = '\0';
+    sRequest.acMib[sizeof(sRequest.acMib) - 1] = '\0';
+    sRequest.acVar[sizeof(sRequest.acVar) - 1] = '\0';
+    sRequest.acValue[sizeof(sRequest.acValue) - 1] = '\0';
+    
+    if (inet_pton(AF_INET6, sRequest.acAddress, &sAddress) != 1)
+    {
+        vReply(iClient, E_JIP_ERROR_BAD_VALUE, 0, 0, "Invalid IPv6 address");
+        return;
+    }
+    if (IN6_IS_ADDR_MULTICAST(&sAddress) || 
+        ((sRequest.acBRAddress[0]) && (strcmp(sRequest.acBRAddress, psCoalescer->pcBRAddress) != 0)))
+    {
+        /* Group sets and other border routers are made by the client */
+        vReply(iClient, E_JIP_ERROR_FAILED, 0, 1, "Not handled");
+        return;
+    }
+    /* Requests for the same node must compare equal however the address was written */
+    inet_ntop(AF_INET6, &sAddress, sRequest.acAddress, INET6_ADDRSTRLEN);
+    
+    pthread_mutex_lock(&psCoalescer->sMutex);
+    
+    for (ppsLast = &psCoalescer->psPending; *ppsLast; ppsLast = &(*ppsLast)->psNext)
+    {
+        psEntry = *ppsLast;
+        if ((strcmp(psEntry->sRequest.acAddress, sRequest.acAddress) == 0) &&
+            (strcmp(psEntry->sRequest.acMib, sRequest.acMib) == 0) &&
+            (strcmp(psEntry->sRequest.acVar, sRequest.acVar) == 0))
+        {
+            /* Take over the pending SetVar, keeping its place and deadline */
+            PRINTF("Superseding %s with %s\n", psEntry->sRequest.acValue, sRequest.acValue);
+            iSuperseded         = psEntry->iClient;
+            psEntry->sRequest   = sRequest;
+            psEntry->iClient    = iClient;
+            break;
+        }
+    }
+    
+    if (iSuperseded < 0)
+    {
+        psEntry = malloc(sizeof(tsCoalesceEntry));
+        if (!psEntry)
+        {
+            pthread_mutex_unlock(&psCoalescer->sMutex);
+            vReply(iClient, E_JIP_ERROR_NO_MEM, 0, 1, pcJIP_strerror(E_JIP_ERROR_NO_MEM));
+            return;
+        }
+        psEntry->sRequest   = sRequest;
+        psEntry->iClient    = iClient;
+        psEntry->psNext     = NULL;
+        
+        clock_gettime(CLOCK_MONOTONIC, &psEntry->sDeadline);
+        psEntry->sDeadline.tv_sec  += psCoalescer->u32Window / 1000;
+        psEntry->sDeadline.tv_nsec += (psCoalescer->u32Window % 1000) * 1000000;
+        if (psEntry->sDeadline.tv_nsec >= 1000000000)
+        {
+            psEntry->sDeadline.tv_sec++;
+            psEntry->sDeadline.tv_nsec -= 1000000000;
+        }
+        
+        /* Appending keeps the list in deadline order */
+        *ppsLast = psEntry;
+        pthread_cond_signal(&psCoalescer->sCond);
+    }
+    
+    pthread_mutex_unlock(&psCoalescer->sMutex);
+    
+    if (iSuperseded >= 0)
+    {
+        vReply(iSuperseded, E_JIP_OK, 1, 0, "Superseded");
+    }
+}
+
+
+static void *pvAcceptThread(void *pvUser)
+{
+    tsCoalescer *psCoalescer = (tsCoalescer *)pvUser;
+    
+    for (;;)
+    {
+        int iClient = accept(psCoalescer->iSocket, NULL, NULL);
+        
+        if (iClient < 0)
+        {
+            int iRun;
+            
+            pthread_mutex_lock(&psCoalescer->sMutex);
+            iRun = psCoalescer->iRun;
+            pthread_mutex_unlock(&psCoalescer->sMutex);
+            
+            if (!iRun)
+            {
+                break;
+            }
+            if ((errno != EINTR) && (errno != ECONNABORTED))
+            {
+                /* Such as EMFILE, which passes as requests are answered. Until
+                 * then the CGIs set their variables directly */
+                fprintf(stderr, "Coalescer failed to accept request (%s)\n", strerror(errno));
+                usleep(COALESCE_ACCEPT_RETRY * 1000);
+            }
+            continue;
+        }
+        vAcceptRequest(psCoalescer, iClient);
+    }
+    return NULL;
+}
+
+
+static void *pvSetThread(void *pvUser)
+{
+    tsCoalescer *psCoalescer = (tsCoalescer *)pvUser;
+    
+    pthread_mutex_lock(&psCoalescer->sMutex);
+    while (psCoalescer->iRun || psCoalescer->psPending)
+    {
+        tsCoalesceEntry *psEntry = psCoalescer->psPending;
+        struct timespec sNow;
+        
+        if (!psEntry)
+        {
+            pthread_cond_wait(&psCoalescer->sCond, &psCoalescer->sMutex);
+            continue;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &sNow);
+        if ((psCoalescer->iRun) && 
+            ((sNow.tv_sec < psEntry->sDeadline.tv_sec) || 
+             ((sNow.tv_sec == psEntry->sDeadline.tv_sec) && (sNow.tv_nsec < psEntry->sDeadline.tv_nsec))))
+        {
+            /* Newer values for this variable may still arrive */
+            pthread_cond_timedwait(&psCoalescer->sCond, &psCoalescer->sMutex, &psEntry->sDeadline);
+            continue;
+        }
+        
+        /* Once taken off the list, later requests for the variable start a new window */
+        psCoalescer->psPending = psEntry->psNext;
+        pthread_mutex_unlock(&psCoalescer->sMutex);
+        
+        vSetEntry(psCoalescer, psEntry);
+        free(psEntry);
+        
+        pthread_mutex_lock(&psCoalescer->sMutex);
+    }
+    pthread_mutex_unlock(&psCoalescer->sMutex);
+    return NULL;
+}
+
+
+teCoalesceStatus eCoalesceStart(tsCoalescer *psCoalescer, tsJIP_Context *psJIP_Context, 
+                                const char *pcBRAddress, uint32_t u32Window)
+{
+    struct sockaddr_un sAddress;
+    pthread_condattr_t sCondAttr;
+    
+    memset(psCoalescer, 0, sizeof(tsCoalescer));
+    psCoalescer->psJIP_Context  = psJIP_Context;
+    psCoalescer->pcBRAddress    = pcBRAddress;
+    psCoalescer->u32Window      = u32Window;
+    
+    psCoalescer->iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (psCoalescer->iSocket < 0)
+    {
+        perror("Error creating SetVar socket");
+        return E_COALESCE_ERROR;
+    }
+    
+    memset(&sAddress, 0, sizeof(struct sockaddr_un));
+    sAddress.sun_family = AF_UNIX;
+    strncpy(sAddress.sun_path, COALESCE_SOCKET_NAME, sizeof(sAddress.sun_path) - 1);
+    
+    /* Left behind if the last JIPd did not exit cleanly */
+    unlink(COALESCE_SOCKET_NAME);
+    
+    if ((bind(psCoalescer->iSocket, (struct sockaddr *)&sAddress, sizeof(struct sockaddr_un)) < 0) ||
+        (listen(psCoalescer->iSocket, 16) < 0))
+    {
+        perror("Error listening on SetVar socket");
+        close(psCoalescer->iSocket);
+        return E_COALESCE_ERROR;
+    }
+    
+    /* The CGIs run as the web server's user */
+    chmod(COALESCE_SOCKET_NAME, 0666);
+    
+    pthread_mutex_init(&psCoalescer->sMutex, NULL);
+    pthread_condattr_init(&sCondAttr);
+    pthread_condattr_setclock(&sCondAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&psCoalescer->sCond, &sCondAttr);
+    pthread_condattr_destroy(&sCondAttr);
+    psCoalescer->iRun = 1;
+    
+    if (pthread_create(&psCoalescer->sSetThread, NULL, pvSetThread, psCoalescer) != 0)
+    {
+        perror("Error starting SetVar thread");
+        goto fail;
+    }
+    
+    if (pthread_create(&psCoalescer->sAcceptThread, NULL, pvAcceptThread, psCoalescer) != 0)
+    {
+        perror("Error starting SetVar accept thread");
+        pthread_mutex_lock(&psCoalescer->sMutex);
+        psCoalescer->iRun = 0;
+        pthread_cond_signal(&psCoalescer->sCond);
+        pthread_mutex_unlock(&psCoalescer->sMutex);
+        pthread_join(psCoalescer->sSetThread, NULL);
+        goto fail;
+    }
+    return E_COALESCE_OK;
+    
+fail:
+    psCoalescer->iRun = 0;
+    pthread_cond_destroy(&psCoalescer->sCond);
+    pthread_mutex_destroy(&psCoalescer->sMutex);
+    close(psCoalescer->iSocket);
+    unlink(COALESCE_SOCKET_NAME);
+    return E_COALESCE_ERROR;
+}
+
+
+teCoalesceStatus eCoalesceStop(tsCoalescer *psCoalescer)
+{
+    teCoalesceStatus eStatus = E_COALESCE_OK;
+    
+    pthread_mutex_lock(&psCoalescer->sMutex);
+    psCoalescer->iRun = 0;
+    pthread_cond_signal(&psCoalescer->sCond);
+    pthread_mutex_unlock(&psCoalescer->sMutex);
+    
+    /* Wakes the accept thread */
+    unlink(COALESCE_SOCKET_NAME);
+    shutdown(psCoalescer->iSocket, SHUT_RDWR);
+    
+    if ((pthread_join(psCoalescer->sAcceptThread, NULL) != 0) ||
+        (pthread_join(psCoalescer->sSetThread, NULL) != 0))
+    {
+        eStatus = E_COALESCE_ERROR;
+    }
+    
+    close(psCoalescer->iSocket);
+    pthread_cond_destroy(&psCoalescer->sCond);
+    pthread_mutex_destroy(&psCoalescer->sMutex);
+    return eStatus;
+}
+
+
+/** Copy a field of a request, failing if it does not fit */
+static int iCopyField(char *pcField, size_t szField, const char *pcValue)
+{
+    if (!pcValue)
+    {
+        pcField[0] = '\0';
+        return 1;
+    }
+    if (strlen(pcValue) >= szField)
+    {
+        return 0;
+    }
+    strcpy(pcField, pcValue);
+    return 1;
+}
+
+
+teCoalesceStatus eCoalesceSetVar(const char *pcBRAddress, const char *pcAddress, const char *pcMib, 
+                                 const char *pcVar, const char *pcValue, tsCoalesceReply *psReply)
+{
+    tsCoalesceRequest sRequest;
+    struct sockaddr_un sAddress;
+    int iSocket;
+    
+    memset(&sRequest, 0, sizeof(tsCoalesceRequest));
+    if (!(iCopyField(sRequest.acBRAddress, sizeof(sRequest.acBRAddress), pcBRAddress) &&
+          iCopyField(sRequest.acAddress,   sizeof(sRequest.acAddress),   pcAddress) &&
+          iCopyField(sRequest.acMib,       sizeof(sRequest.acMib),       pcMib) &&
+          iCopyField(sRequest.acVar,       sizeof(sRequest.acVar),       pcVar) &&
+          iCopyField(sRequest.acValue,     sizeof(sRequest.acValue),     pcValue)))
+    {
+        return E_COALESCE_TOO_LONG;
+    }
+    
+    iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (iSocket < 0)
+    {
+        return E_COALESCE_NO_SERVER;
+    }
+    
+    memset(&sAddress, 0, sizeof(struct sockaddr_un));
+    sAddress.sun_family = AF_UNIX;
+    strncpy(sAddress.sun_path, COALESCE_SOCKET_NAME, sizeof(sAddress.sun_path) - 1);
+    
+    /* Connecting waits while the listen queue is full, so is bounded by the timeout too */
+    vSetTimeout(iSocket, COALESCE_CLIENT_TIMEOUT);
+    if (connect(iSocket, (struct sockaddr *)&sAddress, sizeof(struct sockaddr_un)) < 0)
+    {
+        PRINTF("JIPd is not accepting SetVars (%s)\n", strerror(errno));
+        close(iSocket);
+        return E_COALESCE_NO_SERVER;
+    }
+    
+    if ((!iWriteFull(iSocket, &sRequest, sizeof(tsCoalesceRequest))) ||
+        (!iReadFull(iSocket, psReply, sizeof(tsCoalesceReply))))
+    {
+        close(iSocket);
+        return E_COALESCE_ERROR;
+    }
+    close(iSocket);
+    
+    psReply->acDescription[sizeof(psReply->acDescription) - 1] = '\0';
+    if (psReply->u32NotHandled)
+    {
+        return E_COALESCE_NOT_HANDLED;
+    }
+    return E_COALESCE_OK;
+}
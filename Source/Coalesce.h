@@ -0,0 +1,166 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          SetVar coalescer
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __COALESCE_H_
+#define __COALESCE_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+/** Unix socket that JIPd accepts SetVar requests on */
+#ifndef COALESCE_SOCKET_NAME
+#define COALESCE_SOCKET_NAME        "/tmp/jipd_setvar"
+#endif /* COALESCE_SOCKET_NAME */
+
+/** Default time in milliseconds that a SetVar waits for a newer value of the same variable */
+#define COALESCE_DEFAULT_WINDOW     50
+
+/** Longest a client waits for its SetVar to be answered, in seconds */
+#define COALESCE_CLIENT_TIMEOUT     10
+
+/** Longest MiB or variable name or number in a request */
+#define COALESCE_MAX_NAME           64
+
+/** Longest value in a request */
+#define COALESCE_MAX_VALUE          512
+
+
+/** Enumerated type of status codes from the coalescer */
+typedef enum
+{
+    E_COALESCE_OK,                  /**< All ok */
+    E_COALESCE_ERROR,               /**< Generic error. The request may still have been made */
+    E_COALESCE_NO_SERVER,           /**< JIPd is not running, or not accepting requests */
+    E_COALESCE_NOT_HANDLED,         /**< JIPd cannot handle the request - make it directly */
+    E_COALESCE_TOO_LONG,            /**< A field of the request is too long to send */
+} teCoalesceStatus;
+
+
+/** SetVar request sent to JIPd */
+typedef struct
+{
+    char        acBRAddress[INET6_ADDRSTRLEN];  /**< Border router the client would have used */
+    char        acAddress[INET6_ADDRSTRLEN];    /**< Unicast address of the node */
+    char        acMib[COALESCE_MAX_NAME];       /**< MiB name or ID */
+    char        acVar[COALESCE_MAX_NAME];       /**< Variable name or index */
+    char        acValue[COALESCE_MAX_VALUE];    /**< Text form of the value, as for \ref eCodecParseValue */
+} tsCoalesceRequest;
+
+
+/** Answer to a SetVar request from JIPd */
+typedef struct
+{
+    int32_t     i32Status;                      /**< teJIP_Status of the SetVar */
+    uint32_t    u32Superseded;                  /**< Non-zero if a newer value was set instead */
+    uint32_t    u32NotHandled;                  /**< Non-zero if the client should set the variable itself */
+    char        acDescription[64];              /**< Description of the result */
+} tsCoalesceReply;
+
+
+/** Pending SetVar waiting for its window to close */
+typedef struct _tsCoalesceEntry
+{
+    tsCoalesceRequest           sRequest;       /**< Latest request for the variable */
+    int                         iClient;        /**< Socket of the client that sent it */
+    struct timespec             sDeadline;      /**< When the variable is set */
+    struct _tsCoalesceEntry     *psNext;        /**< Next pending SetVar */
+} tsCoalesceEntry;
+
+
+/** Structure for the SetVar coalescer in JIPd.
+ *  SetVars arriving for a variable that already has one pending replace its
+ *  value. The client of the replaced request is told it was superseded.
+ *  A variable is set u32Window milliseconds after the first SetVar that
+ *  made it pending, so a dragged slider is followed at that rate rather
+ *  than replaying every step. */
+typedef struct
+{
+    tsJIP_Context      *psJIP_Context;  /**< Connected context to set variables with */
+    const char         *pcBRAddress;    /**< Border router the context is connected to */
+    uint32_t            u32Window;      /**< Time in milliseconds a SetVar waits for a newer value */
+    int                 iSocket;        /**< Listening socket */
+    
+    tsCoalesceEntry    *psPending;      /**< SetVars waiting, oldest first */
+    int                 iRun;           /**< Cleared to stop the threads */
+    pthread_t           sAcceptThread;  /**< Thread accepting requests */
+    pthread_t           sSetThread;     /**< Thread setting variables */
+    pthread_mutex_t     sMutex;         /**< Protects psPending and iRun */
+    pthread_cond_t      sCond;          /**< Signalled when a SetVar becomes pending */
+} tsCoalescer;
+
+
+/** Start accepting SetVar requests on \ref COALESCE_SOCKET_NAME.
+ *  \param psCoalescer      Pointer to coalescer structure to initialise
+ *  \param psJIP_Context    Connected context to set variables with
+ *  \param pcBRAddress      Address of the border router the context is connected to
+ *  \param u32Window        Time in milliseconds a SetVar waits for a newer value
+ *  \return E_COALESCE_OK on success
+ */
+teCoalesceStatus eCoalesceStart(tsCoalescer *psCoalescer, tsJIP_Context *psJIP_Context, 
+                                const char *pcBRAddress, uint32_t u32Window);
+
+
+/** Stop accepting requests, answer any pending ones and wait for the threads to exit.
+ *  \param psCoalescer      Pointer to running coalescer
+ *  \return E_COALESCE_OK on success
+ */
+teCoalesceStatus eCoalesceStop(tsCoalescer *psCoalescer);
+
+
+/** Ask JIPd to set a variable of a unicast node.
+ *  Used by the CGIs, which fall back to setting the variable themselves if
+ *  this does not return E_COALESCE_OK.
+ *  \param pcBRAddress      Border router the caller would have used
+ *  \param pcAddress        Unicast address of the node
+ *  \param pcMib            MiB name or ID
+ *  \param pcVar            Variable name or index
+ *  \param pcValue          Text form of the value
+ *  \param psReply          Pointer to location to store JIPd's answer
+ *  \return E_COALESCE_OK if JIPd answered the request
+ */
+teCoalesceStatus eCoalesceSetVar(const char *pcBRAddress, const char *pcAddress, const char *pcMib, 
+                                 const char *pcVar, const char *pcValue, tsCoalesceReply *psReply);
+
+
+#endif /* __COALESCE_H_ */
@@ -0,0 +1,314 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Variable value codec
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <JIP.h>
+
+#include "Codec.h"
+
+//#define DEBUG_CODEC
+
+#ifdef DEBUG_CODEC
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_CODEC */
+
+/** Longest text around the hex of one table row, "000 { 0x", " }\n" or "000 { Empty Row }",
+ *  allowing for row numbers of more than three digits */
+#define TABLE_ROW_OVERHEAD  32
+
+
+/** Convert a hex string to a blob. An odd number of digits leaves the low nibble of the last byte clear. */
+static teCodecStatus eParseBlob(const char *pcValue, uint8_t *pu8Buffer, uint32_t *pu32Size, const char **ppcError)
+{
+    uint32_t u32Digits = 0;
+    
+    if (strncmp(pcValue, "0x", 2) == 0)
+    {
+        pcValue += 2;
+    }
+    
+    for (; *pcValue; pcValue++, u32Digits++)
+    {
+        uint8_t u8Nibble;
+        
+        if ((*pcValue >= '0') && (*pcValue <= '9'))
+        {
+            u8Nibble = *pcValue - '0';
+        }
+        else if ((*pcValue >= 'a') && (*pcValue <= 'f'))
+        {
+            u8Nibble = *pcValue - 'a' + 0x0A;
+        }
+        else if ((*pcValue >= 'A') && (*pcValue <= 'F'))
+        {
+            u8Nibble = *pcValue - 'A' + 0x0A;
+        }
+        else
+        {
+            *ppcError = "String contains illegal hexadecimal characters";
+            return E_CODEC_BAD_VALUE;
+        }
+        
+        if ((u32Digits & 0x01) == 0)
+        {
+            pu8Buffer[u32Digits >> 1] = u8Nibble << 4;
+        }
+        else
+        {
+            pu8Buffer[u32Digits >> 1] |= u8Nibble;
+        }
+    }
+    
+    *pu32Size = (u32Digits + 1) >> 1;
+    return E_CODEC_OK;
+}
+
+
+teCodecStatus eCodecParseValue(tsArena *psArena, teJIP_VarType eVarType, const char *pcValue, 
+                               void **ppvBuffer, uint32_t *pu32Size, const char **ppcError)
+{
+    union
+    {
+        uint8_t     u8Var;
+        uint16_t    u16Var;
+        uint32_t    u32Var;
+        uint64_t    u64Var;
+        float       f32Var;
+        double      d64Var;
+    } uValue;
+    uint32_t u32Size;
+    void *pvBuffer;
+    
+    *ppvBuffer = NULL;
+    *pu32Size = 0;
+    *ppcError = pcJIP_strerror(E_JIP_OK);
+    
+    errno = 0;
+    switch (eVarType)
+    {
+        case (E_JIP_VAR_TYPE_INT8):
+        case (E_JIP_VAR_TYPE_UINT8):
+            uValue.u8Var = strtoul(pcValue, NULL, 0);
+            u32Size = sizeof(uint8_t);
+            *ppcError = "Could not convert string to 8 bit integer";
+            break;
+        
+        case (E_JIP_VAR_TYPE_INT16):
+        case (E_JIP_VAR_TYPE_UINT16):
+            uValue.u16Var = strtoul(pcValue, NULL, 0);
+            u32Size = sizeof(uint16_t);
+            *ppcError = "Could not convert string to 16 bit integer";
+            break;
+            
+        case (E_JIP_VAR_TYPE_INT32):
+        case (E_JIP_VAR_TYPE_UINT32):
+            uValue.u32Var = strtoul(pcValue, NULL, 0);
+            u32Size = sizeof(uint32_t);
+            *ppcError = "Could not convert string to 32 bit integer";
+            break;
+        
+        case (E_JIP_VAR_TYPE_INT64):
+        case (E_JIP_VAR_TYPE_UINT64):
+            uValue.u64Var = strtoull(pcValue, NULL, 0);
+            u32Size = sizeof(uint64_t);
+            *ppcError = "Could not convert string to 64 bit integer";
+            break;
+        
+        case (E_JIP_VAR_TYPE_FLT):
+            uValue.f32Var = strtof(pcValue, NULL);
+            u32Size = sizeof(float);
+            *ppcError = "Could not convert string to float";
+            break;
+        
+        case (E_JIP_VAR_TYPE_DBL):
+            uValue.d64Var = strtod(pcValue, NULL);
+            u32Size = sizeof(double);
+            *ppcError = "Could not convert string to double";
+            break;
+            
+        case (E_JIP_VAR_TYPE_STR):
+            pvBuffer = psArena ? pcArenaStrdup(psArena, pcValue) : strdup(pcValue);
+            if (!pvBuffer)
+            {
+                *ppcError = pcJIP_strerror(E_JIP_ERROR_NO_MEM);
+                return E_CODEC_NO_MEMORY;
+            }
+            *ppvBuffer = pvBuffer;
+            *pu32Size = strlen(pcValue);
+            return E_CODEC_OK;
+            
+        case (E_JIP_VAR_TYPE_BLOB):
+        {
+            teCodecStatus eStatus;
+            
+            /* Two hex digits per byte, so the text is always long enough */
+            pvBuffer = psArena ? pvArenaZalloc(psArena, strlen(pcValue) + 1) : calloc(1, strlen(pcValue) + 1);
+            if (!pvBuffer)
+            {
+                *ppcError = pcJIP_strerror(E_JIP_ERROR_NO_MEM);
+                return E_CODEC_NO_MEMORY;
+            }
+            eStatus = eParseBlob(pcValue, pvBuffer, pu32Size, ppcError);
+            if (eStatus != E_CODEC_OK)
+            {
+                if (!psArena)
+                {
+                    free(pvBuffer);
+                }
+                return eStatus;
+            }
+            *ppvBuffer = pvBuffer;
+            return E_CODEC_OK;
+        }
+        
+        default:
+            *ppcError = "Variable type not supported";
+            return E_CODEC_UNSUPPORTED;
+    }
+    
+    if (errno)
+    {
+        PRINTF("Could not convert '%s' (%s)\n", pcValue, strerror(errno));
+        return E_CODEC_BAD_VALUE;
+    }
+    
+    pvBuffer = psArena ? pvArenaAlloc(psArena, u32Size) : malloc(u32Size);
+    if (!pvBuffer)
+    {
+        *ppcError = pcJIP_strerror(E_JIP_ERROR_NO_MEM);
+        return E_CODEC_NO_MEMORY;
+    }
+    memcpy(pvBuffer, &uValue, u32Size);
+    
+    *ppvBuffer = pvBuffer;
+    *pu32Size = u32Size;
+    *ppcError = pcJIP_strerror(E_JIP_OK);
+    return E_CODEC_OK;
+}
+
+
+/** Write two lower case hex digits per byte, without a terminator */
+static void vFormatHex(char *pcText, const uint8_t *pu8Data, uint32_t u32Length)
+{
+    static const char acHexDigits[] = "0123456789abcdef";
+    uint32_t i;
+    
+    for (i = 0; i < u32Length; i++)
+    {
+        pcText[i * 2]       = acHexDigits[pu8Data[i] >> 4];
+        pcText[(i * 2) + 1] = acHexDigits[pu8Data[i] & 0x0F];
+    }
+}
+
+
+teCodecStatus eCodecFormatBlob(tsArena *psArena, const uint8_t *pu8Data, uint32_t u32Length, char **ppcText)
+{
+    char *pcText;
+    
+    pcText = psArena ? pvArenaAlloc(psArena, (u32Length * 2) + 3) : malloc((u32Length * 2) + 3);
+    if (!pcText)
+    {
+        return E_CODEC_NO_MEMORY;
+    }
+    pcText[0] = '0';
+    pcText[1] = 'x';
+    vFormatHex(&pcText[2], pu8Data, u32Length);
+    pcText[(u32Length * 2) + 2] = '\0';
+    *ppcText = pcText;
+    return E_CODEC_OK;
+}
+
+
+teCodecStatus eCodecFormatTable(tsArena *psArena, const tsTable *psTable, char **ppcText)
+{
+    const tsTableRow *psTableRow;
+    uint32_t u32Length = 1;
+    uint32_t u32Pos = 0;
+    char *pcText;
+    uint32_t i;
+    
+    if (psTable->u32NumRows == 0)
+    {
+        pcText = psArena ? pcArenaStrdup(psArena, "Empty Table") : strdup("Empty Table");
+        if (!pcText)
+        {
+            return E_CODEC_NO_MEMORY;
+        }
+        *ppcText = pcText;
+        return E_CODEC_OK;
+    }
+    
+    /* Size the text for the whole table up front: the row number and 
+     * braces, then two hex digits per byte */
+    for (i = 0; i < psTable->u32NumRows; i++)
+    {
+        u32Length += TABLE_ROW_OVERHEAD + (psTable->psRows[i].u32Length * 2);
+    }
+    
+    pcText = psArena ? pvArenaAlloc(psArena, u32Length) : malloc(u32Length);
+    if (!pcText)
+    {
+        return E_CODEC_NO_MEMORY;
+    }
+    pcText[0] = '\0';
+    
+    for (i = 0; i < psTable->u32NumRows; i++)
+    {
+        psTableRow = &psTable->psRows[i];
+        if (psTableRow->pvData)
+        {
+            u32Pos += sprintf(&pcText[u32Pos], "%03u { 0x", i);
+            vFormatHex(&pcText[u32Pos], psTableRow->pvData, psTableRow->u32Length);
+            u32Pos += psTableRow->u32Length * 2;
+            u32Pos += sprintf(&pcText[u32Pos], " }\n");
+        }
+        else
+        {
+            u32Pos += sprintf(&pcText[u32Pos], "%03u { Empty Row }", i);
+        }
+    }
+    *ppcText = pcText;
+    return E_CODEC_OK;
+}
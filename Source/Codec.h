@@ -0,0 +1,99 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Variable value codec
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __CODEC_H_
+#define __CODEC_H_
+
+#include <stdint.h>
+
+#include <JIP.h>
+
+#include "Arena.h"
+
+
+/** Enumerated type of status codes from the codec */
+typedef enum
+{
+    E_CODEC_OK,                 /**< All ok */
+    E_CODEC_BAD_VALUE,          /**< The text could not be converted to the variable's type */
+    E_CODEC_UNSUPPORTED,        /**< Variables of this type cannot be set */
+    E_CODEC_NO_MEMORY,          /**< Memory allocation failed */
+} teCodecStatus;
+
+
+/** Convert the text form of a value, as sent by the web pages, into the
+ *  buffer that eJIP_SetVar expects for a variable type.
+ *  Integers may be given in decimal, hex or octal. Blobs are hex, optionally
+ *  prefixed with 0x. Strings are used as they are.
+ *  \param psArena          Arena to allocate the buffer from, or NULL to use malloc
+ *  \param eVarType         Type of the variable being set
+ *  \param pcValue          Text form of the value
+ *  \param ppvBuffer        Pointer to location to store the buffer. Free with free() if psArena is NULL,
+ *                          otherwise it is released with the arena.
+ *  \param pu32Size         Pointer to location to store the size of the buffer
+ *  \param ppcError         Pointer to location to store a description of any failure
+ *  \return E_CODEC_OK on success
+ */
+teCodecStatus eCodecParseValue(tsArena *psArena, teJIP_VarType eVarType, const char *pcValue, 
+                               void **ppvBuffer, uint32_t *pu32Size, const char **ppcError);
+
+
+/** Convert the value of a blob variable into the text sent to JSON clients,
+ *  "0x" followed by two hex digits per byte.
+ *  \param psArena          Arena to allocate the text from, or NULL to use malloc
+ *  \param pu8Data          Value of the blob
+ *  \param u32Length        Length of the blob in bytes
+ *  \param ppcText          Pointer to location to store the text
+ *  \return E_CODEC_OK on success
+ */
+teCodecStatus eCodecFormatBlob(tsArena *psArena, const uint8_t *pu8Data, uint32_t u32Length, char **ppcText);
+
+
+/** Convert the value of a table variable into the text sent to JSON clients.
+ *  Each row is given as its number and its bytes in hex, and a table with
+ *  no rows as "Empty Table".
+ *  \param psArena          Arena to allocate the text from, or NULL to use malloc
+ *  \param psTable          Value of the table
+ *  \param ppcText          Pointer to location to store the text
+ *  \return E_CODEC_OK on success
+ */
+teCodecStatus eCodecFormatTable(tsArena *psArena, const tsTable *psTable, char **ppcText);
+
+
+#endif /* __CODEC_H_ */
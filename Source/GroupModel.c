@@ -0,0 +1,682 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Group read model
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "GroupModel.h"
+
+//#define DEBUG_GROUP_MODEL
+
+#ifdef DEBUG_GROUP_MODEL
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_GROUP_MODEL */
+
+
+/** Whole group model, as held in memory while it is built or updated */
+typedef struct
+{
+    tsGroupModelHeader  sHeader;
+    tsGroupModelGroup   *psGroups;
+    tsGroupModelNode    *psNodes;
+} tsGroupModel;
+
+
+/** Read a variable's value as an integer. \return Value, or GROUP_MODEL_UNKNOWN if it is not an integer */
+static int32_t i32IntegerValue(teJIP_VarType eVarType, const void *pvValue)
+{
+    if (!pvValue)
+    {
+        return GROUP_MODEL_UNKNOWN;
+    }
+    
+    switch (eVarType)
+    {
+        case (E_JIP_VAR_TYPE_INT8):     return *(const int8_t *)pvValue;
+        case (E_JIP_VAR_TYPE_UINT8):    return *(const uint8_t *)pvValue;
+        case (E_JIP_VAR_TYPE_INT16):    return *(const int16_t *)pvValue;
+        case (E_JIP_VAR_TYPE_UINT16):   return *(const uint16_t *)pvValue;
+        case (E_JIP_VAR_TYPE_INT32):    return *(const int32_t *)pvValue;
+        case (E_JIP_VAR_TYPE_UINT32):   return (int32_t)(*(const uint32_t *)pvValue & 0x7FFFFFFF);
+        default:                        return GROUP_MODEL_UNKNOWN;
+    }
+}
+
+
+/** Add or remove (iSign -1) one node's values to the aggregates of every group it is a member of */
+static void vAccumulate(tsGroupModel *psModel, const tsGroupModelNode *psNode, int iSign)
+{
+    uint32_t i;
+    
+    for (i = 0; i < psModel->sHeader.u32NumGroups; i++)
+    {
+        tsGroupModelGroup *psGroup = &psModel->psGroups[i];
+        
+        if (!(psNode->u32Groups & (1U << i)))
+        {
+            continue;
+        }
+        
+        psGroup->u32Members += iSign;
+        if (psNode->i32State != GROUP_MODEL_UNKNOWN)
+        {
+            if (psNode->i32State)
+            {
+                psGroup->u32On += iSign;
+            }
+            else
+            {
+                psGroup->u32Off += iSign;
+            }
+        }
+        if (psNode->i32Level != GROUP_MODEL_UNKNOWN)
+        {
+            psGroup->u32LevelCount += iSign;
+            psGroup->u32LevelSum   += iSign * psNode->i32Level;
+        }
+    }
+}
+
+
+/** Open the model file and lock it. \return File descriptor, or -1 */
+static int iOpenLocked(int iFlags, int iOperation)
+{
+    int iFd;
+    
+    iFd = open(GROUP_MODEL_FILE_NAME, iFlags, 0666);
+    if (iFd < 0)
+    {
+        return -1;
+    }
+    if (flock(iFd, iOperation) != 0)
+    {
+        close(iFd);
+        return -1;
+    }
+    return iFd;
+}
+
+
+/** Read the whole model from a locked file */
+static teGroupModelStatus eReadModel(int iFd, tsGroupModel *psModel)
+{
+    size_t szGroups, szNodes;
+    
+    memset(psModel, 0, sizeof(tsGroupModel));
+    if ((pread(iFd, &psModel->sHeader, sizeof(tsGroupModelHeader), 0) != sizeof(tsGroupModelHeader)) ||
+        (psModel->sHeader.u32Magic != GROUP_MODEL_MAGIC) ||
+        (psModel->sHeader.u32NumGroups > GROUP_MODEL_MAX_GROUPS))
+    {
+        return E_GROUP_MODEL_NO_MODEL;
+    }
+    
+    szGroups = psModel->sHeader.u32NumGroups * sizeof(tsGroupModelGroup);
+    szNodes  = psModel->sHeader.u32NumNodes  * sizeof(tsGroupModelNode);
+    psModel->psGroups = malloc(szGroups ? szGroups : 1);
+    psModel->psNodes  = malloc(szNodes ? szNodes : 1);
+    
+    if ((!psModel->psGroups) || (!psModel->psNodes) ||
+        (pread(iFd, psModel->psGroups, szGroups, sizeof(tsGroupModelHeader)) != (ssize_t)szGroups) ||
+        (pread(iFd, psModel->psNodes, szNodes, sizeof(tsGroupModelHeader) + szGroups) != (ssize_t)szNodes))
+    {
+        free(psModel->psGroups);
+        free(psModel->psNodes);
+        return E_GROUP_MODEL_NO_MODEL;
+    }
+    return E_GROUP_MODEL_OK;
+}
+
+
+/** Write the whole model to a locked file */
+static teGroupModelStatus eWriteModel(int iFd, const tsGroupModel *psModel)
+{
+    size_t szGroups = psModel->sHeader.u32NumGroups * sizeof(tsGroupModelGroup);
+    size_t szNodes  = psModel->sHeader.u32NumNodes  * sizeof(tsGroupModelNode);
+    
+    /* Readers hold a shared lock, so never see the file part written */
+    if ((pwrite(iFd, &psModel->sHeader, sizeof(tsGroupModelHeader), 0) != sizeof(tsGroupModelHeader)) ||
+        (pwrite(iFd, psModel->psGroups, szGroups, sizeof(tsGroupModelHeader)) != (ssize_t)szGroups) ||
+        (pwrite(iFd, psModel->psNodes, szNodes, sizeof(tsGroupModelHeader) + szGroups) != (ssize_t)szNodes) ||
+        (ftruncate(iFd, sizeof(tsGroupModelHeader) + szGroups + szNodes) != 0))
+    {
+        fprintf(stderr, "Failed to write group model (%s)\n", strerror(errno));
+        return E_GROUP_MODEL_ERROR;
+    }
+    return E_GROUP_MODEL_OK;
+}
+
+
+/** Find a variable of a node by MiB and variable name */
+static tsVar *psLookupVar(tsNode *psNode, const char *pcMib, const char *pcVar)
+{
+    tsMib *psMib;
+    
+    if ((!pcMib) || (!pcVar))
+    {
+        return NULL;
+    }
+    psMib = psJIP_LookupMib(psNode, NULL, pcMib);
+    return psMib ? psJIP_LookupVar(psMib, NULL, pcVar) : NULL;
+}
+
+
+/** Read a control's value from a node. \return Value, or GROUP_MODEL_UNKNOWN */
+static int32_t i32ReadControl(tsJIP_Context *psJIP_Context, tsVar *psVar)
+{
+    if ((!psVar) || (eJIP_GetVar(psJIP_Context, psVar) != E_JIP_OK))
+    {
+        return GROUP_MODEL_UNKNOWN;
+    }
+    return i32IntegerValue(psVar->eVarType, psVar->pvData);
+}
+
+
+/** Read the groups a node is a member of from its membership table */
+static uint32_t u32ReadMemberships(tsJIP_Context *psJIP_Context, tsNode *psNode, const tsGroupModelDefinition *psDefinition)
+{
+    tsVar *psVar;
+    tsTable *psTable;
+    uint32_t u32Groups = 1; /* Everybody is in the global group */
+    uint32_t i, j;
+    
+    psVar = psLookupVar(psNode, GROUP_MODEL_MEMBERSHIP_MIB, GROUP_MODEL_MEMBERSHIP_VAR);
+    if ((!psVar) || (psVar->eVarType != E_JIP_VAR_TYPE_TABLE_BLOB) ||
+        (eJIP_GetVar(psJIP_Context, psVar) != E_JIP_OK) || (!psVar->pvData))
+    {
+        return u32Groups;
+    }
+    
+    psTable = (tsTable *)psVar->pvData;
+    for (i = 0; i < psTable->u32NumRows; i++)
+    {
+        if ((psTable->psRows[i].u32Length != sizeof(struct in6_addr)) || (!psTable->psRows[i].pvData))
+        {
+            continue;
+        }
+        for (j = 1; j < psDefinition->u32NumGroups; j++)
+        {
+            if (memcmp(psTable->psRows[i].pvData, &psDefinition->asGroups[j], sizeof(struct in6_addr)) == 0)
+            {
+                u32Groups |= (1U << j);
+            }
+        }
+    }
+    return u32Groups;
+}
+
+
+static void vCopyName(char *pcDest, const char *pcSource)
+{
+    if (pcSource)
+    {
+        strncpy(pcDest, pcSource, GROUP_MODEL_MAX_NAME - 1);
+    }
+}
+
+
+/** Compare two sequence numbers, allowing for wrap around. \return Non-zero if u32A is later than u32B */
+static int iSequenceAfter(uint32_t u32A, uint32_t u32B)
+{
+    return (int32_t)(u32A - u32B) > 0;
+}
+
+
+/** Order model nodes by address */
+static int iCompareNodes(const void *pvA, const void *pvB)
+{
+    return memcmp(&((const tsGroupModelNode *)pvA)->sAddress, &((const tsGroupModelNode *)pvB)->sAddress, sizeof(struct in6_addr));
+}
+
+
+/** Read the sequence number of the current model. \return Non-zero if there is a model */
+static int iReadSequence(uint32_t *pu32Sequence)
+{
+    tsGroupModelHeader sHeader;
+    int iFd;
+    int iHaveModel = 0;
+    
+    iFd = iOpenLocked(O_RDONLY, LOCK_SH);
+    if (iFd < 0)
+    {
+        return 0;
+    }
+    if ((pread(iFd, &sHeader, sizeof(tsGroupModelHeader), 0) == sizeof(tsGroupModelHeader)) &&
+        (sHeader.u32Magic == GROUP_MODEL_MAGIC))
+    {
+        *pu32Sequence = sHeader.u32Sequence;
+        iHaveModel = 1;
+    }
+    close(iFd);
+    return iHaveModel;
+}
+
+
+/** Carry values set since a build started reading the network over from the model
+ *  they were recorded in, as the network may have been read before they were made */
+static void vMergeUpdates(tsGroupModel *psModel, tsGroupModel *psPrevModel, uint32_t u32StartSequence)
+{
+    uint32_t i;
+    
+    qsort(psPrevModel->psNodes, psPrevModel->sHeader.u32NumNodes, sizeof(tsGroupModelNode), iCompareNodes);
+    
+    for (i = 0; i < psModel->sHeader.u32NumNodes; i++)
+    {
+        tsGroupModelNode *psNode = &psModel->psNodes[i];
+        const tsGroupModelNode *psPrevNode;
+        
+        psPrevNode = bsearch(psNode, psPrevModel->psNodes, psPrevModel->sHeader.u32NumNodes, 
+                             sizeof(tsGroupModelNode), iCompareNodes);
+        if (!psPrevNode)
+        {
+            continue;
+        }
+        if (psPrevNode->u32StateSequence && iSequenceAfter(psPrevNode->u32StateSequence, u32StartSequence))
+        {
+            psNode->i32State            = psPrevNode->i32State;
+            psNode->u32StateSequence    = psPrevNode->u32StateSequence;
+        }
+        if (psPrevNode->u32LevelSequence && iSequenceAfter(psPrevNode->u32LevelSequence, u32StartSequence))
+        {
+            psNode->i32Level            = psPrevNode->i32Level;
+            psNode->u32LevelSequence    = psPrevNode->u32LevelSequence;
+        }
+    }
+}
+
+
+teGroupModelStatus eGroupModelBuild(tsJIP_Context *psJIP_Context, const tsGroupModelDefinition *psDefinition)
+{
+    tsGroupModel sModel, sPrevModel;
+    tsJIPAddress *asAddresses = NULL;
+    uint32_t u32NumAddresses = 0;
+    tsGroupModelDefinition sDefinition;
+    teGroupModelStatus eStatus;
+    uint32_t u32StartSequence = 0;
+    int iHaveStartSequence;
+    uint32_t i;
+    int iFd;
+    
+    if (psDefinition->u32NumGroups == 0)
+    {
+        return E_GROUP_MODEL_INVALID_PARAMS;
+    }
+    
+    if (psDefinition->u32NumGroups > GROUP_MODEL_MAX_GROUPS)
+    {
+        /* Memberships are a bitmap, so the rest are left out rather than failing the whole model */
+        fprintf(stderr, "Group model only holds the first %d of %u groups\n", 
+                GROUP_MODEL_MAX_GROUPS, psDefinition->u32NumGroups);
+        sDefinition = *psDefinition;
+        sDefinition.u32NumGroups = GROUP_MODEL_MAX_GROUPS;
+        psDefinition = &sDefinition;
+    }
+    
+    if (eJIP_GetNodeAddressList(psJIP_Context, JIP_DEVICEID_ALL, &asAddresses, &u32NumAddresses) != E_JIP_OK)
+    {
+        return E_GROUP_MODEL_ERROR;
+    }
+    
+    memset(&sModel, 0, sizeof(tsGroupModel));
+    sModel.sHeader.u32Magic     = GROUP_MODEL_MAGIC;
+    sModel.sHeader.u32NumGroups = psDefinition->u32NumGroups;
+    sModel.sHeader.i64Built     = time(NULL);
+    vCopyName(sModel.sHeader.acStateMib, psDefinition->pcStateMib);
+    vCopyName(sModel.sHeader.acStateVar, psDefinition->pcStateVar);
+    vCopyName(sModel.sHeader.acLevelMib, psDefinition->pcLevelMib);
+    vCopyName(sModel.sHeader.acLevelVar, psDefinition->pcLevelVar);
+    
+    sModel.psGroups = calloc(psDefinition->u32NumGroups, sizeof(tsGroupModelGroup));
+    sModel.psNodes  = calloc(u32NumAddresses ? u32NumAddresses : 1, sizeof(tsGroupModelNode));
+    if ((!sModel.psGroups) || (!sModel.psNodes))
+    {
+        free(sModel.psGroups);
+        free(sModel.psNodes);
+        free(asAddresses);
+        return E_GROUP_MODEL_ERROR;
+    }
+    for (i = 0; i < psDefinition->u32NumGroups; i++)
+    {
+        sModel.psGroups[i].sAddress = psDefinition->asGroups[i];
+    }
+    
+    /* The network is read without the model locked, so pages are not held up.
+     * Values set meanwhile are recorded with later sequence numbers */
+    iHaveStartSequence = iReadSequence(&u32StartSequence);
+    for (i = 0; i < u32NumAddresses; i++)
+    {
+        tsGroupModelNode *psModelNode = &sModel.psNodes[sModel.sHeader.u32NumNodes];
+        tsNode *psNode;
+        tsVar *psStateVar, *psLevelVar;
+        
+        /* Lookup returns the node locked */
+        psNode = psJIP_LookupNode(psJIP_Context, &asAddresses[i]);
+        if (!psNode)
+        {
+            continue;
+        }
+        
+        psStateVar = psLookupVar(psNode, psDefinition->pcStateMib, psDefinition->pcStateVar);
+        psLevelVar = psLookupVar(psNode, psDefinition->pcLevelMib, psDefinition->pcLevelVar);
+        if ((psStateVar) || (psLevelVar))
+        {
+            psModelNode->sAddress   = asAddresses[i].sin6_addr;
+            psModelNode->u32Groups  = u32ReadMemberships(psJIP_Context, psNode, psDefinition);
+            psModelNode->i32State   = i32ReadControl(psJIP_Context, psStateVar);
+            psModelNode->i32Level   = i32ReadControl(psJIP_Context, psLevelVar);
+            sModel.sHeader.u32NumNodes++;
+        }
+        eJIP_UnlockNode(psNode);
+    }
+    free(asAddresses);
+    
+    eStatus = E_GROUP_MODEL_ERROR;
+    iFd = iOpenLocked(O_RDWR | O_CREAT, LOCK_EX);
+    if (iFd >= 0)
+    {
+        /* Pages and the gateway's own writes share the file */
+        (void)fchmod(iFd, 0666);
+        
+        if (eReadModel(iFd, &sPrevModel) == E_GROUP_MODEL_OK)
+        {
+            if (iHaveStartSequence)
+            {
+                vMergeUpdates(&sModel, &sPrevModel, u32StartSequence);
+            }
+            for (i = 0; i < sModel.sHeader.u32NumNodes; i++)
+            {
+                vAccumulate(&sModel, &sModel.psNodes[i], 1);
+            }
+            
+            sModel.sHeader.u32Version  = sPrevModel.sHeader.u32Version;
+            sModel.sHeader.u32Sequence = sPrevModel.sHeader.u32Sequence;
+            if ((sPrevModel.sHeader.u32NumGroups != sModel.sHeader.u32NumGroups) ||
+                (memcmp(sPrevModel.psGroups, sModel.psGroups, sModel.sHeader.u32NumGroups * sizeof(tsGroupModelGroup)) != 0))
+            {
+                sModel.sHeader.u32Version++;
+            }
+            free(sPrevModel.psGroups);
+            free(sPrevModel.psNodes);
+        }
+        else
+        {
+            for (i = 0; i < sModel.sHeader.u32NumNodes; i++)
+            {
+                vAccumulate(&sModel, &sModel.psNodes[i], 1);
+            }
+            sModel.sHeader.u32Version = (uint32_t)sModel.sHeader.i64Built;
+        }
+        
+        PRINTF("Group model version %u: %u groups, %u nodes\n", 
+               sModel.sHeader.u32Version, sModel.sHeader.u32NumGroups, sModel.sHeader.u32NumNodes);
+        eStatus = eWriteModel(iFd, &sModel);
+        close(iFd);
+    }
+    
+    free(sModel.psGroups);
+    free(sModel.psNodes);
+    return eStatus;
+}
+
+
+teGroupModelStatus eGroupModelSetVar(const struct in6_addr *psDestination, const char *pcMib, const char *pcVar,
+                                     teJIP_VarType eVarType, const void *pvValue)
+{
+    tsGroupModel sModel;
+    teGroupModelStatus eStatus;
+    int32_t i32Value;
+    int iState, iMatched = 0, iChanged = 0;
+    uint32_t u32Groups = 0;
+    uint32_t u32Sequence;
+    uint32_t i;
+    int iFd;
+    
+    i32Value = i32IntegerValue(eVarType, pvValue);
+    if ((!pcMib) || (!pcVar) || (i32Value == GROUP_MODEL_UNKNOWN))
+    {
+        return E_GROUP_MODEL_OK;
+    }
+    
+    iFd = iOpenLocked(O_RDWR, LOCK_EX);
+    if (iFd < 0)
+    {
+        return E_GROUP_MODEL_NO_MODEL;
+    }
+    
+    eStatus = eReadModel(iFd, &sModel);
+    if (eStatus != E_GROUP_MODEL_OK)
+    {
+        close(iFd);
+        return eStatus;
+    }
+    
+    if ((strcmp(pcMib, sModel.sHeader.acStateMib) == 0) && (strcmp(pcVar, sModel.sHeader.acStateVar) == 0))
+    {
+        iState = 1;
+    }
+    else if ((strcmp(pcMib, sModel.sHeader.acLevelMib) == 0) && (strcmp(pcVar, sModel.sHeader.acLevelVar) == 0))
+    {
+        iState = 0;
+    }
+    else
+    {
+        goto done;
+    }
+    
+    if (IN6_IS_ADDR_MULTICAST(psDestination))
+    {
+        for (i = 0; i < sModel.sHeader.u32NumGroups; i++)
+        {
+            if (memcmp(&sModel.psGroups[i].sAddress, psDestination, sizeof(struct in6_addr)) == 0)
+            {
+                u32Groups |= (1U << i);
+            }
+        }
+        if (!u32Groups)
+        {
+            /* Sent to a group that is not tracked */
+            goto done;
+        }
+    }
+    
+    /* Advanced for every set, changed or not, so that a build that read the
+     * nodes from the network before the set can tell that it happened since */
+    u32Sequence = sModel.sHeader.u32Sequence + 1;
+    if (u32Sequence == 0)
+    {
+        /* 0 marks values read from the network */
+        u32Sequence++;
+    }
+    
+    for (i = 0; i < sModel.sHeader.u32NumNodes; i++)
+    {
+        tsGroupModelNode *psNode = &sModel.psNodes[i];
+        int32_t *pi32Value = iState ? &psNode->i32State : &psNode->i32Level;
+        
+        if (u32Groups ? !(psNode->u32Groups & u32Groups) :
+                        (memcmp(&psNode->sAddress, psDestination, sizeof(struct in6_addr)) != 0))
+        {
+            continue;
+        }
+        
+        if (iState)
+        {
+            psNode->u32StateSequence = u32Sequence;
+        }
+        else
+        {
+            psNode->u32LevelSequence = u32Sequence;
+        }
+        iMatched = 1;
+        
+        if (*pi32Value == i32Value)
+        {
+            continue;
+        }
+        
+        vAccumulate(&sModel, psNode, -1);
+        *pi32Value = i32Value;
+        vAccumulate(&sModel, psNode, 1);
+        iChanged = 1;
+    }
+    
+    if (iMatched)
+    {
+        sModel.sHeader.u32Sequence = u32Sequence;
+        if (iChanged)
+        {
+            sModel.sHeader.u32Version++;
+        }
+        eStatus = eWriteModel(iFd, &sModel);
+    }
+    
+done:
+    close(iFd);
+    free(sModel.psGroups);
+    free(sModel.psNodes);
+    return eStatus;
+}
+
+
+teGroupModelStatus eGroupModelRead(tsGroupModelView *psView)
+{
+    size_t szGroups;
+    int iFd;
+    
+    memset(psView, 0, sizeof(tsGroupModelView));
+    
+    iFd = iOpenLocked(O_RDONLY, LOCK_SH);
+    if (iFd < 0)
+    {
+        return E_GROUP_MODEL_NO_MODEL;
+    }
+    
+    if ((pread(iFd, &psView->sHeader, sizeof(tsGroupModelHeader), 0) != sizeof(tsGroupModelHeader)) ||
+        (psView->sHeader.u32Magic != GROUP_MODEL_MAGIC) ||
+        (psView->sHeader.u32NumGroups > GROUP_MODEL_MAX_GROUPS))
+    {
+        close(iFd);
+        return E_GROUP_MODEL_NO_MODEL;
+    }
+    
+    szGroups = psView->sHeader.u32NumGroups * sizeof(tsGroupModelGroup);
+    psView->psGroups = malloc(szGroups ? szGroups : 1);
+    if ((!psView->psGroups) ||
+        (pread(iFd, psView->psGroups, szGroups, sizeof(tsGroupModelHeader)) != (ssize_t)szGroups))
+    {
+        close(iFd);
+        vGroupModelViewFree(psView);
+        return E_GROUP_MODEL_NO_MODEL;
+    }
+    close(iFd);
+    return E_GROUP_MODEL_OK;
+}
+
+
+void vGroupModelViewFree(tsGroupModelView *psView)
+{
+    free(psView->psGroups);
+    memset(psView, 0, sizeof(tsGroupModelView));
+}
+
+
+const tsGroupModelGroup *psGroupModelLookupGroup(const tsGroupModelView *psView, const struct in6_addr *psAddress)
+{
+    uint32_t i;
+    
+    for (i = 0; i < psView->sHeader.u32NumGroups; i++)
+    {
+        if (memcmp(&psView->psGroups[i].sAddress, psAddress, sizeof(struct in6_addr)) == 0)
+        {
+            return &psView->psGroups[i];
+        }
+    }
+    return NULL;
+}
+
+
+teGroupModelState eGroupModelGroupState(const tsGroupModelGroup *psGroup)
+{
+    if (psGroup->u32On && psGroup->u32Off)
+    {
+        return E_GROUP_MODEL_STATE_MIXED;
+    }
+    else if (psGroup->u32On)
+    {
+        return E_GROUP_MODEL_STATE_ON;
+    }
+    else if (psGroup->u32Off)
+    {
+        return E_GROUP_MODEL_STATE_OFF;
+    }
+    return E_GROUP_MODEL_STATE_UNKNOWN;
+}
+
+
+const char *pcGroupModelState(teGroupModelState eState)
+{
+    switch (eState)
+    {
+        case (E_GROUP_MODEL_STATE_OFF):     return "Off";
+        case (E_GROUP_MODEL_STATE_ON):      return "On";
+        case (E_GROUP_MODEL_STATE_MIXED):   return "Mixed";
+        default:                            return "Unknown";
+    }
+}
+
+
+int32_t i32GroupModelGroupLevel(const tsGroupModelGroup *psGroup)
+{
+    if (psGroup->u32LevelCount == 0)
+    {
+        return GROUP_MODEL_UNKNOWN;
+    }
+    return (int32_t)((psGroup->u32LevelSum + (psGroup->u32LevelCount / 2)) / psGroup->u32LevelCount);
+}
@@ -0,0 +1,219 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Group read model
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __GROUP_MODEL_H_
+#define __GROUP_MODEL_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include <JIP.h>
+
+/** File holding group membership and aggregated group state */
+#define GROUP_MODEL_FILE_NAME       "/tmp/jip_cache_groups"
+
+#define GROUP_MODEL_MAGIC           0x4A495047
+
+/** Most groups that can be tracked, including the global group. 
+ *  Each node holds its memberships as a bitmask. */
+#define GROUP_MODEL_MAX_GROUPS      32
+
+/** Longest MiB / variable name held for the state and level controls */
+#define GROUP_MODEL_MAX_NAME        32
+
+/** MiB and variable listing the groups a node is a member of */
+#define GROUP_MODEL_MEMBERSHIP_MIB  "Groups"
+#define GROUP_MODEL_MEMBERSHIP_VAR  "Groups"
+
+/** Value of a node's state or level before it has been read */
+#define GROUP_MODEL_UNKNOWN         -1
+
+
+/** Enumerated type of status codes from the group model */
+typedef enum
+{
+    E_GROUP_MODEL_OK,               /**< All ok */
+    E_GROUP_MODEL_ERROR,            /**< Generic error */
+    E_GROUP_MODEL_NO_MODEL,         /**< No group model has been built */
+    E_GROUP_MODEL_INVALID_PARAMS,   /**< Invalid parameters were passed */
+} teGroupModelStatus;
+
+
+/** Aggregated state of a group */
+typedef enum
+{
+    E_GROUP_MODEL_STATE_UNKNOWN,    /**< No member's state is known */
+    E_GROUP_MODEL_STATE_OFF,        /**< Every member with a known state is off */
+    E_GROUP_MODEL_STATE_ON,         /**< Every member with a known state is on */
+    E_GROUP_MODEL_STATE_MIXED,      /**< Some members are on and some off */
+} teGroupModelState;
+
+
+/** Header of the group model file.
+ *  Followed by u32NumGroups \ref tsGroupModelGroup records, then
+ *  u32NumNodes \ref tsGroupModelNode records. */
+typedef struct
+{
+    uint32_t        u32Magic;           /**< \ref GROUP_MODEL_MAGIC */
+    uint32_t        u32NumGroups;       /**< Number of groups. Group 0 is the global group */
+    uint32_t        u32NumNodes;        /**< Number of nodes with the state or level control */
+    uint32_t        u32Version;         /**< Advanced whenever any group's state changes */
+    uint32_t        u32Sequence;        /**< Advanced by every value recorded with \ref eGroupModelSetVar */
+    int64_t         i64Built;           /**< Time membership was last read from the network */
+    char            acStateMib[GROUP_MODEL_MAX_NAME];   /**< MiB of the state control */
+    char            acStateVar[GROUP_MODEL_MAX_NAME];   /**< Variable of the state control */
+    char            acLevelMib[GROUP_MODEL_MAX_NAME];   /**< MiB of the level control */
+    char            acLevelVar[GROUP_MODEL_MAX_NAME];   /**< Variable of the level control */
+} tsGroupModelHeader;
+
+
+/** Group with its aggregated state, kept up to date as members change */
+typedef struct
+{
+    struct in6_addr sAddress;           /**< Multicast address of the group */
+    uint32_t        u32Members;         /**< Number of member nodes */
+    uint32_t        u32On;              /**< Members known to be on */
+    uint32_t        u32Off;             /**< Members known to be off */
+    uint32_t        u32LevelCount;      /**< Members with a known level */
+    uint32_t        u32LevelSum;        /**< Sum of the known levels */
+} tsGroupModelGroup;
+
+
+/** Node with the groups it is a member of and its last known values */
+typedef struct
+{
+    struct in6_addr sAddress;           /**< Address of the node */
+    uint32_t        u32Groups;          /**< Bit n set if the node is a member of group n */
+    int32_t         i32State;           /**< Last known state, or \ref GROUP_MODEL_UNKNOWN */
+    int32_t         i32Level;           /**< Last known level, or \ref GROUP_MODEL_UNKNOWN */
+    uint32_t        u32StateSequence;   /**< Sequence number the state was last set in, 0 if it was read from the network */
+    uint32_t        u32LevelSequence;   /**< Sequence number the level was last set in, 0 if it was read from the network */
+} tsGroupModelNode;
+
+
+/** What to build a group model from */
+typedef struct
+{
+    const char             *pcStateMib;     /**< MiB of the state control, may be NULL */
+    const char             *pcStateVar;     /**< Variable of the state control, may be NULL */
+    const char             *pcLevelMib;     /**< MiB of the level control, may be NULL */
+    const char             *pcLevelVar;     /**< Variable of the level control, may be NULL */
+    uint32_t                u32NumGroups;   /**< Number of groups. Only the first \ref GROUP_MODEL_MAX_GROUPS are modelled */
+    const struct in6_addr  *asGroups;       /**< Group addresses. The first is the global group, 
+                                                 which every node with the controls is a member of */
+} tsGroupModelDefinition;
+
+
+/** Groups read from the model, without their members */
+typedef struct
+{
+    tsGroupModelHeader      sHeader;        /**< Header of the model */
+    tsGroupModelGroup      *psGroups;       /**< sHeader.u32NumGroups groups */
+} tsGroupModelView;
+
+
+/** Build the group model from the network held in a context, replacing any previous model.
+ *  Each node's memberships, state and level are read from the network, so this
+ *  is meant for the scheduler rather than for page requests. Values recorded by
+ *  \ref eGroupModelSetVar while the network was being read are kept.
+ *  \param psJIP_Context    Context holding the network
+ *  \param psDefinition     Controls and groups to track
+ *  \return E_GROUP_MODEL_OK on success
+ */
+teGroupModelStatus eGroupModelBuild(tsJIP_Context *psJIP_Context, const tsGroupModelDefinition *psDefinition);
+
+
+/** Record a value that was successfully set, updating the state of every group it affects.
+ *  Values of variables other than the state and level controls are ignored,
+ *  as are calls when no model has been built.
+ *  \param psDestination    Node or group address the value was sent to
+ *  \param pcMib            Name of the MiB
+ *  \param pcVar            Name of the variable
+ *  \param eVarType         Type of the variable
+ *  \param pvValue          Value, in the variable's type
+ *  \return E_GROUP_MODEL_OK on success
+ */
+teGroupModelStatus eGroupModelSetVar(const struct in6_addr *psDestination, const char *pcMib, const char *pcVar,
+                                     teJIP_VarType eVarType, const void *pvValue);
+
+
+/** Read the groups and their aggregated state.
+ *  Only the header and group table are read, however many nodes there are.
+ *  \param psView           View to fill in. Free with \ref vGroupModelViewFree
+ *  \return E_GROUP_MODEL_OK on success, E_GROUP_MODEL_NO_MODEL if none has been built
+ */
+teGroupModelStatus eGroupModelRead(tsGroupModelView *psView);
+
+
+/** Free a view of the groups.
+ *  \param psView           View to free
+ */
+void vGroupModelViewFree(tsGroupModelView *psView);
+
+
+/** Find a group in a view by address.
+ *  \param psView           View to search
+ *  \param psAddress        Address of the group
+ *  \return Pointer to the group, or NULL if it is not tracked
+ */
+const tsGroupModelGroup *psGroupModelLookupGroup(const tsGroupModelView *psView, const struct in6_addr *psAddress);
+
+
+/** Get the aggregated on / off state of a group.
+ *  \param psGroup          Group
+ *  \return State of the group
+ */
+teGroupModelState eGroupModelGroupState(const tsGroupModelGroup *psGroup);
+
+
+/** Get a name for a group state.
+ *  \param eState           State
+ *  \return Name of the state
+ */
+const char *pcGroupModelState(teGroupModelState eState);
+
+
+/** Get the average level of a group's members.
+ *  \param psGroup          Group
+ *  \return Average level, or \ref GROUP_MODEL_UNKNOWN if no member's level is known
+ */
+int32_t i32GroupModelGroupLevel(const tsGroupModelGroup *psGroup);
+
+
+#endif /* __GROUP_MODEL_H_ */
@@ -0,0 +1,582 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Time-series history store
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "Aggregate.h"
+#include "History.h"
+
+//#define DEBUG_HISTORY
+
+#ifdef DEBUG_HISTORY
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_HISTORY */
+
+
+/** Resolutions each series is kept at, finest first */
+static const struct
+{
+    uint32_t    u32Resolution;      /**< Length of a bucket in seconds */
+    uint32_t    u32NumBuckets;      /**< Length of the ring */
+    uint32_t    u32First;           /**< Index of the ring's first bucket in asBuckets */
+} asResolutions[HISTORY_NUM_RESOLUTIONS] =
+{
+    {  10, HISTORY_BUCKETS_FINE,   0 },
+    {  60, HISTORY_BUCKETS_MEDIUM, HISTORY_BUCKETS_FINE },
+    { 900, HISTORY_BUCKETS_COARSE, HISTORY_BUCKETS_FINE + HISTORY_BUCKETS_MEDIUM },
+};
+
+
+/** Find the series of a variable. \return Pointer to the series, or NULL */
+static tsHistorySeries *psFindSeries(tsHistoryFile *psFile, const struct in6_addr *psAddress, 
+                                     const char *pcMib, const char *pcVar)
+{
+    uint32_t i;
+    
+    for (i = 0; i < HISTORY_MAX_SERIES; i++)
+    {
+        tsHistorySeries *psSeries = &psFile->asSeries[i];
+        
+        if ((psSeries->acMib[0]) &&
+            (memcmp(&psSeries->sAddress, psAddress, sizeof(struct in6_addr)) == 0) &&
+            (strncmp(psSeries->acMib, pcMib, HISTORY_MAX_NAME) == 0) &&
+            (strncmp(psSeries->acVar, pcVar, HISTORY_MAX_NAME) == 0))
+        {
+            return psSeries;
+        }
+    }
+    return NULL;
+}
+
+
+/** Start a series for a variable, in a free slot or in place of the one sampled least recently */
+static tsHistorySeries *psNewSeries(tsHistoryFile *psFile, const struct in6_addr *psAddress, 
+                                    const char *pcMib, const char *pcVar)
+{
+    tsHistorySeries *psSeries = NULL;
+    uint32_t i;
+    
+    for (i = 0; i < HISTORY_MAX_SERIES; i++)
+    {
+        if (!psFile->asSeries[i].acMib[0])
+        {
+            psSeries = &psFile->asSeries[i];
+            psFile->u32NumSeries++;
+            break;
+        }
+        if ((!psSeries) || (psFile->asSeries[i].u32LastSample < psSeries->u32LastSample))
+        {
+            psSeries = &psFile->asSeries[i];
+        }
+    }
+    
+    PRINTF("Series %u for %s/%s\n", (uint32_t)(psSeries - psFile->asSeries), pcMib, pcVar);
+    
+    memset(psSeries, 0, sizeof(tsHistorySeries));
+    psSeries->sAddress = *psAddress;
+    strncpy(psSeries->acMib, pcMib, HISTORY_MAX_NAME - 1);
+    strncpy(psSeries->acVar, pcVar, HISTORY_MAX_NAME - 1);
+    return psSeries;
+}
+
+
+teHistoryStatus eHistoryOpen(tsHistory *psHistory, int iWritable)
+{
+    struct stat sStat;
+    void *pvMap;
+    
+    memset(psHistory, 0, sizeof(tsHistory));
+    psHistory->iWritable = iWritable;
+    
+    psHistory->iFd = open(HISTORY_FILE_NAME, iWritable ? (O_RDWR | O_CREAT) : O_RDONLY, 0666);
+    if (psHistory->iFd < 0)
+    {
+        return iWritable ? E_HISTORY_ERROR : E_HISTORY_NO_HISTORY;
+    }
+    
+    if (iWritable)
+    {
+        /* Size the file, and start it again if it is not one of ours */
+        (void)fchmod(psHistory->iFd, 0666);
+        if ((flock(psHistory->iFd, LOCK_EX) != 0) || (fstat(psHistory->iFd, &sStat) != 0))
+        {
+            close(psHistory->iFd);
+            return E_HISTORY_ERROR;
+        }
+        if ((size_t)sStat.st_size != sizeof(tsHistoryFile))
+        {
+            if ((ftruncate(psHistory->iFd, 0) != 0) || (ftruncate(psHistory->iFd, sizeof(tsHistoryFile)) != 0))
+            {
+                fprintf(stderr, "Failed to size history store (%s)\n", strerror(errno));
+                close(psHistory->iFd);
+                return E_HISTORY_ERROR;
+            }
+        }
+    }
+    else if ((fstat(psHistory->iFd, &sStat) != 0) || ((size_t)sStat.st_size != sizeof(tsHistoryFile)))
+    {
+        close(psHistory->iFd);
+        return E_HISTORY_NO_HISTORY;
+    }
+    
+    pvMap = mmap(NULL, sizeof(tsHistoryFile), iWritable ? (PROT_READ | PROT_WRITE) : PROT_READ, 
+                 MAP_SHARED, psHistory->iFd, 0);
+    if (pvMap == MAP_FAILED)
+    {
+        close(psHistory->iFd);
+        return E_HISTORY_ERROR;
+    }
+    psHistory->psFile = (tsHistoryFile *)pvMap;
+    
+    if (iWritable)
+    {
+        if (psHistory->psFile->u32Magic != HISTORY_MAGIC)
+        {
+            memset(psHistory->psFile, 0, sizeof(tsHistoryFile));
+            psHistory->psFile->u32Magic = HISTORY_MAGIC;
+            psHistory->psFile->u32Interval = HISTORY_DEFAULT_INTERVAL;
+        }
+        (void)flock(psHistory->iFd, LOCK_UN);
+    }
+    else if (psHistory->psFile->u32Magic != HISTORY_MAGIC)
+    {
+        vHistoryClose(psHistory);
+        return E_HISTORY_NO_HISTORY;
+    }
+    return E_HISTORY_OK;
+}
+
+
+void vHistoryClose(tsHistory *psHistory)
+{
+    if (psHistory->psFile)
+    {
+        munmap(psHistory->psFile, sizeof(tsHistoryFile));
+        psHistory->psFile = NULL;
+    }
+    if (psHistory->iFd >= 0)
+    {
+        close(psHistory->iFd);
+    }
+    psHistory->iFd = -1;
+}
+
+
+teHistoryStatus eHistoryRecord(tsHistory *psHistory, const struct in6_addr *psAddress, const char *pcMib,
+                               const char *pcVar, time_t tTime, double dValue)
+{
+    tsHistorySeries *psSeries;
+    uint32_t u32Time = (uint32_t)tTime;
+    float fValue = (float)dValue;
+    uint32_t i;
+    
+    if ((!psHistory->psFile) || (!psHistory->iWritable) || (!pcMib) || (!pcMib[0]) || (!pcVar))
+    {
+        return E_HISTORY_INVALID_PARAMS;
+    }
+    
+    /* Readers copy a series under a shared lock, so never see it part updated */
+    if (flock(psHistory->iFd, LOCK_EX) != 0)
+    {
+        return E_HISTORY_ERROR;
+    }
+    
+    psSeries = psFindSeries(psHistory->psFile, psAddress, pcMib, pcVar);
+    if (!psSeries)
+    {
+        psSeries = psNewSeries(psHistory->psFile, psAddress, pcMib, pcVar);
+    }
+    
+    for (i = 0; i < HISTORY_NUM_RESOLUTIONS; i++)
+    {
+        uint32_t u32Resolution = asResolutions[i].u32Resolution;
+        uint32_t u32Start = u32Time - (u32Time % u32Resolution);
+        tsHistoryBucket *psBucket;
+        
+        psBucket = &psSeries->asBuckets[asResolutions[i].u32First + 
+                                        ((u32Time / u32Resolution) % asResolutions[i].u32NumBuckets)];
+        if (psBucket->u32Start != u32Start)
+        {
+            /* Last time round the ring - start the bucket again */
+            psBucket->u32Start  = u32Start;
+            psBucket->u32Count  = 0;
+            psBucket->fSum      = 0.0f;
+        }
+        
+        if ((psBucket->u32Count == 0) || (fValue < psBucket->fMin))
+        {
+            psBucket->fMin = fValue;
+        }
+        if ((psBucket->u32Count == 0) || (fValue > psBucket->fMax))
+        {
+            psBucket->fMax = fValue;
+        }
+        psBucket->fSum += fValue;
+        psBucket->u32Count++;
+    }
+    psSeries->u32LastSample = u32Time;
+    
+    (void)flock(psHistory->iFd, LOCK_UN);
+    return E_HISTORY_OK;
+}
+
+
+teHistoryStatus eHistoryQuery(tsHistory *psHistory, const struct in6_addr *psAddress, const char *pcMib,
+                              const char *pcVar, time_t tEnd, uint32_t u32Range, tsHistoryRange *psRange)
+{
+    const tsHistorySeries *psSeries;
+    uint32_t u32End = (uint32_t)tEnd;
+    uint32_t u32Resolution, u32NumSlots, u32First, u32NumBuckets;
+    uint32_t i;
+    void *pvColumns;
+    
+    memset(psRange, 0, sizeof(tsHistoryRange));
+    if ((!psHistory->psFile) || (!pcMib) || (!pcVar) || (u32Range == 0) || (u32Range > u32End))
+    {
+        return E_HISTORY_INVALID_PARAMS;
+    }
+    
+    /* Finest resolution that covers the range, or as much of it as the coarsest holds */
+    for (i = 0; i < HISTORY_NUM_RESOLUTIONS - 1; i++)
+    {
+        if ((asResolutions[i].u32Resolution * asResolutions[i].u32NumBuckets) >= u32Range)
+        {
+            break;
+        }
+    }
+    u32Resolution   = asResolutions[i].u32Resolution;
+    u32First        = asResolutions[i].u32First;
+    u32NumBuckets   = asResolutions[i].u32NumBuckets;
+    
+    psRange->u32Resolution = u32Resolution;
+    psRange->u32Start = (u32End - u32Range) - ((u32End - u32Range) % u32Resolution);
+    u32NumSlots = ((u32End - psRange->u32Start) / u32Resolution) + 1;
+    if (u32NumSlots > u32NumBuckets)
+    {
+        psRange->u32Start += (u32NumSlots - u32NumBuckets) * u32Resolution;
+        u32NumSlots = u32NumBuckets;
+    }
+    
+    /* One allocation for all of the columns */
+    pvColumns = malloc(u32NumSlots * (sizeof(uint32_t) + (3 * sizeof(float))));
+    if (!pvColumns)
+    {
+        return E_HISTORY_NO_MEMORY;
+    }
+    psRange->pu32Offset = (uint32_t *)pvColumns;
+    psRange->pfMin = (float *)&psRange->pu32Offset[u32NumSlots];
+    psRange->pfMax = &psRange->pfMin[u32NumSlots];
+    psRange->pfAvg = &psRange->pfMax[u32NumSlots];
+    
+    if (flock(psHistory->iFd, LOCK_SH) != 0)
+    {
+        vHistoryRangeFree(psRange);
+        return E_HISTORY_ERROR;
+    }
+    
+    psSeries = psFindSeries(psHistory->psFile, psAddress, pcMib, pcVar);
+    if (!psSeries)
+    {
+        (void)flock(psHistory->iFd, LOCK_UN);
+        vHistoryRangeFree(psRange);
+        return E_HISTORY_NO_HISTORY;
+    }
+    
+    for (i = 0; i < u32NumSlots; i++)
+    {
+        uint32_t u32Start = psRange->u32Start + (i * u32Resolution);
+        const tsHistoryBucket *psBucket = &psSeries->asBuckets[u32First + ((u32Start / u32Resolution) % u32NumBuckets)];
+        
+        /* Skip buckets holding an older time round the ring, or never filled */
+        if ((psBucket->u32Start != u32Start) || (psBucket->u32Count == 0))
+        {
+            continue;
+        }
+        psRange->pu32Offset[psRange->u32NumBuckets] = i;
+        psRange->pfMin[psRange->u32NumBuckets]      = psBucket->fMin;
+        psRange->pfMax[psRange->u32NumBuckets]      = psBucket->fMax;
+        psRange->pfAvg[psRange->u32NumBuckets]      = psBucket->fSum / psBucket->u32Count;
+        psRange->u32NumBuckets++;
+    }
+    psRange->u32LastSample = psSeries->u32LastSample;
+    
+    (void)flock(psHistory->iFd, LOCK_UN);
+    return E_HISTORY_OK;
+}
+
+
+teHistoryStatus eHistoryDownsample(tsHistoryRange *psRange, uint32_t u32Points)
+{
+    float *pfX;
+    uint32_t *pu32Selected;
+    uint32_t u32Kept, u32SpanStart, i;
+    
+    if (psRange->u32NumBuckets <= u32Points)
+    {
+        return E_HISTORY_OK;
+    }
+    
+    pfX = malloc(psRange->u32NumBuckets * sizeof(float));
+    pu32Selected = malloc(u32Points * sizeof(uint32_t));
+    if ((!pfX) || (!pu32Selected))
+    {
+        free(pfX);
+        free(pu32Selected);
+        return E_HISTORY_NO_MEMORY;
+    }
+    for (i = 0; i < psRange->u32NumBuckets; i++)
+    {
+        pfX[i] = (float)psRange->pu32Offset[i];
+    }
+    
+    u32Kept = u32AggregateLTTB(pfX, psRange->pfAvg, psRange->u32NumBuckets, u32Points, pu32Selected);
+    
+    /* Kept bucket i stands for those after kept bucket i - 1, up to itself. 
+     * Its span starts at or after i, so the columns can be compacted in place */
+    u32SpanStart = 0;
+    for (i = 0; i < u32Kept; i++)
+    {
+        uint32_t u32Bucket = pu32Selected[i];
+        tsAggregateFloat sMin, sMax;
+        
+        vAggregateFloat(&psRange->pfMin[u32SpanStart], u32Bucket - u32SpanStart + 1, &sMin);
+        vAggregateFloat(&psRange->pfMax[u32SpanStart], u32Bucket - u32SpanStart + 1, &sMax);
+        
+        psRange->pu32Offset[i]  = psRange->pu32Offset[u32Bucket];
+        psRange->pfAvg[i]       = psRange->pfAvg[u32Bucket];
+        psRange->pfMin[i]       = sMin.fMin;
+        psRange->pfMax[i]       = sMax.fMax;
+        u32SpanStart = u32Bucket + 1;
+    }
+    PRINTF("Downsampled %u buckets to %u\n", psRange->u32NumBuckets, u32Kept);
+    psRange->u32NumBuckets = u32Kept;
+    
+    free(pfX);
+    free(pu32Selected);
+    return E_HISTORY_OK;
+}
+
+
+void vHistoryRangeFree(tsHistoryRange *psRange)
+{
+    free(psRange->pu32Offset);
+    psRange->pu32Offset = NULL;
+    psRange->pfMin = psRange->pfMax = psRange->pfAvg = NULL;
+    psRange->u32NumBuckets = 0;
+}
+
+
+/** Read a variable's value as a number. \return non-zero if it is numeric */
+static int iNumericValue(const tsVar *psVar, double *pdValue)
+{
+    const void *pvValue = psVar->pvData;
+    
+    if (!pvValue)
+    {
+        return 0;
+    }
+    
+    switch (psVar->eVarType)
+    {
+        case (E_JIP_VAR_TYPE_INT8):     *pdValue = *(const int8_t *)pvValue;    break;
+        case (E_JIP_VAR_TYPE_UINT8):    *pdValue = *(const uint8_t *)pvValue;   break;
+        case (E_JIP_VAR_TYPE_INT16):    *pdValue = *(const int16_t *)pvValue;   break;
+        case (E_JIP_VAR_TYPE_UINT16):   *pdValue = *(const uint16_t *)pvValue;  break;
+        case (E_JIP_VAR_TYPE_INT32):    *pdValue = *(const int32_t *)pvValue;   break;
+        case (E_JIP_VAR_TYPE_UINT32):   *pdValue = *(const uint32_t *)pvValue;  break;
+        case (E_JIP_VAR_TYPE_INT64):    *pdValue = *(const int64_t *)pvValue;   break;
+        case (E_JIP_VAR_TYPE_UINT64):   *pdValue = *(const uint64_t *)pvValue;  break;
+        case (E_JIP_VAR_TYPE_FLT):      *pdValue = *(const float *)pvValue;     break;
+        case (E_JIP_VAR_TYPE_DBL):      *pdValue = *(const double *)pvValue;    break;
+        default:                        return 0;
+    }
+    return 1;
+}
+
+
+/** Read every watched variable from every node that has it, and record them */
+static void vHistorySample(tsHistorySampler *psSampler)
+{
+    tsJIPAddress *asAddresses = NULL;
+    uint32_t u32NumAddresses = 0;
+    time_t tNow = time(NULL);
+    uint32_t i, j;
+    
+    if (eJIP_GetNodeAddressList(psSampler->psJIP_Context, JIP_DEVICEID_ALL, &asAddresses, &u32NumAddresses) != E_JIP_OK)
+    {
+        return;
+    }
+    
+    for (i = 0; i < u32NumAddresses; i++)
+    {
+        tsNode *psNode;
+        
+        /* Lookup returns the node locked */
+        psNode = psJIP_LookupNode(psSampler->psJIP_Context, &asAddresses[i]);
+        if (!psNode)
+        {
+            continue;
+        }
+        
+        for (j = 0; j < psSampler->u32NumWatches; j++)
+        {
+            const tsHistoryWatch *psWatch = &psSampler->asWatches[j];
+            tsMib *psMib;
+            tsVar *psVar = NULL;
+            double dValue;
+            
+            psMib = psJIP_LookupMib(psNode, NULL, psWatch->acMib);
+            if (psMib)
+            {
+                psVar = psJIP_LookupVar(psMib, NULL, psWatch->acVar);
+            }
+            if ((psVar) && (eJIP_GetVar(psSampler->psJIP_Context, psVar) == E_JIP_OK) &&
+                (iNumericValue(psVar, &dValue)))
+            {
+                (void)eHistoryRecord(&psSampler->sHistory, &asAddresses[i].sin6_addr, 
+                                     psWatch->acMib, psWatch->acVar, tNow, dValue);
+            }
+        }
+        eJIP_UnlockNode(psNode);
+    }
+    free(asAddresses);
+}
+
+
+static void *pvHistoryThread(void *pvUser)
+{
+    tsHistorySampler *psSampler = (tsHistorySampler *)pvUser;
+    struct timespec sDeadline;
+    
+    clock_gettime(CLOCK_REALTIME, &sDeadline);
+    
+    pthread_mutex_lock(&psSampler->sMutex);
+    while (psSampler->iRun)
+    {
+        pthread_mutex_unlock(&psSampler->sMutex);
+        
+        vHistorySample(psSampler);
+        
+        /* Keep to the interval however long the sample took */
+        sDeadline.tv_sec += psSampler->u32Interval;
+        
+        pthread_mutex_lock(&psSampler->sMutex);
+        while (psSampler->iRun)
+        {
+            if (pthread_cond_timedwait(&psSampler->sCond, &psSampler->sMutex, &sDeadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&psSampler->sMutex);
+    return NULL;
+}
+
+
+teHistoryStatus eHistoryStart(tsHistorySampler *psSampler, tsJIP_Context *psJIP_Context, uint32_t u32Interval,
+                              uint32_t u32NumWatches, const tsHistoryWatch *asWatches)
+{
+    teHistoryStatus eStatus;
+    
+    if ((u32Interval == 0) || (u32NumWatches == 0) || (u32NumWatches > HISTORY_MAX_WATCHES))
+    {
+        return E_HISTORY_INVALID_PARAMS;
+    }
+    
+    memset(psSampler, 0, sizeof(tsHistorySampler));
+    psSampler->psJIP_Context    = psJIP_Context;
+    psSampler->u32Interval      = u32Interval;
+    psSampler->u32NumWatches    = u32NumWatches;
+    memcpy(psSampler->asWatches, asWatches, u32NumWatches * sizeof(tsHistoryWatch));
+    
+    eStatus = eHistoryOpen(&psSampler->sHistory, 1);
+    if (eStatus != E_HISTORY_OK)
+    {
+        return eStatus;
+    }
+    psSampler->sHistory.psFile->u32Interval = u32Interval;
+    psSampler->iRun = 1;
+    
+    pthread_mutex_init(&psSampler->sMutex, NULL);
+    pthread_cond_init(&psSampler->sCond, NULL);
+    
+    if (pthread_create(&psSampler->sThread, NULL, pvHistoryThread, psSampler) != 0)
+    {
+        perror("Error starting history thread");
+        psSampler->iRun = 0;
+        pthread_cond_destroy(&psSampler->sCond);
+        pthread_mutex_destroy(&psSampler->sMutex);
+        vHistoryClose(&psSampler->sHistory);
+        return E_HISTORY_ERROR;
+    }
+    return E_HISTORY_OK;
+}
+
+
+teHistoryStatus eHistoryStop(tsHistorySampler *psSampler)
+{
+    pthread_mutex_lock(&psSampler->sMutex);
+    psSampler->iRun = 0;
+    pthread_cond_signal(&psSampler->sCond);
+    pthread_mutex_unlock(&psSampler->sMutex);
+    
+    if (pthread_join(psSampler->sThread, NULL) != 0)
+    {
+        return E_HISTORY_ERROR;
+    }
+    
+    pthread_cond_destroy(&psSampler->sCond);
+    pthread_mutex_destroy(&psSampler->sMutex);
+    vHistoryClose(&psSampler->sHistory);
+    return E_HISTORY_OK;
+}
@@ -0,0 +1,254 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Time-series history store
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __HISTORY_H_
+#define __HISTORY_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include <JIP.h>
+
+/** Memory mapped file holding the history of every watched variable */
+#define HISTORY_FILE_NAME           "/tmp/jip_history"
+
+#define HISTORY_MAGIC               0x4A495048
+
+/** Most variables that have history kept. When full, the variable sampled
+ *  least recently makes way for a new one */
+#define HISTORY_MAX_SERIES          16
+
+/** Longest MiB / variable name of a watched variable */
+#define HISTORY_MAX_NAME            32
+
+/** Most MiB / variable names that JIPd watches */
+#define HISTORY_MAX_WATCHES         8
+
+/** Default interval between samples in seconds */
+#define HISTORY_DEFAULT_INTERVAL    10
+
+/** Number of resolutions each variable is kept at */
+#define HISTORY_NUM_RESOLUTIONS     3
+
+/** Buckets kept at each resolution: an hour of 10 second buckets,
+ *  a day of 1 minute buckets and a week of 15 minute buckets */
+#define HISTORY_BUCKETS_FINE        360
+#define HISTORY_BUCKETS_MEDIUM      1440
+#define HISTORY_BUCKETS_COARSE      672
+#define HISTORY_BUCKETS_TOTAL       (HISTORY_BUCKETS_FINE + HISTORY_BUCKETS_MEDIUM + HISTORY_BUCKETS_COARSE)
+
+
+/** Enumerated type of status codes from the history store */
+typedef enum
+{
+    E_HISTORY_OK,                   /**< All ok */
+    E_HISTORY_ERROR,                /**< Generic error */
+    E_HISTORY_NO_HISTORY,           /**< The store has not been created, or the variable is not watched */
+    E_HISTORY_INVALID_PARAMS,       /**< Invalid parameters were passed */
+    E_HISTORY_NO_MEMORY,            /**< Memory allocation failed */
+} teHistoryStatus;
+
+
+/** Samples that fell into one interval of time */
+typedef struct
+{
+    uint32_t        u32Start;           /**< Start of the interval, Unix time. 0 if never used */
+    uint32_t        u32Count;           /**< Number of samples */
+    float           fMin;               /**< Smallest sample */
+    float           fMax;               /**< Largest sample */
+    float           fSum;               /**< Sum of the samples */
+} tsHistoryBucket;
+
+
+/** History of one variable of one node.
+ *  Each resolution is a ring of buckets indexed by time, so a bucket found
+ *  to hold an older interval than the one being looked for is stale. */
+typedef struct
+{
+    struct in6_addr sAddress;                   /**< Address of the node */
+    char            acMib[HISTORY_MAX_NAME];    /**< MiB name, empty if the series is free */
+    char            acVar[HISTORY_MAX_NAME];    /**< Variable name */
+    uint32_t        u32LastSample;              /**< Time of the latest sample */
+    uint32_t        u32Reserved;
+    tsHistoryBucket asBuckets[HISTORY_BUCKETS_TOTAL];   /**< Rings of every resolution, finest first */
+} tsHistorySeries;
+
+
+/** Layout of the history file. It is a fixed size, created once by JIPd */
+typedef struct
+{
+    uint32_t        u32Magic;           /**< \ref HISTORY_MAGIC */
+    uint32_t        u32Interval;        /**< Interval between samples in seconds */
+    uint32_t        u32NumSeries;       /**< Number of series in use */
+    uint32_t        u32Reserved;
+    tsHistorySeries asSeries[HISTORY_MAX_SERIES];
+} tsHistoryFile;
+
+
+/** Open history store */
+typedef struct
+{
+    int             iFd;                /**< Open history file */
+    int             iWritable;          /**< Non-zero if opened for recording */
+    tsHistoryFile  *psFile;             /**< Mapping of the file */
+} tsHistory;
+
+
+/** Range of history, column by column so that it encodes compactly.
+ *  Buckets with no samples are left out. */
+typedef struct
+{
+    uint32_t        u32Resolution;      /**< Length of each bucket in seconds */
+    uint32_t        u32Start;           /**< Start of the first bucket asked for, Unix time */
+    uint32_t        u32NumBuckets;      /**< Number of buckets with samples */
+    uint32_t        u32LastSample;      /**< Time of the latest sample of the variable */
+    uint32_t       *pu32Offset;         /**< Index of each bucket from u32Start, in buckets */
+    float          *pfMin;              /**< Smallest sample in each bucket */
+    float          *pfMax;              /**< Largest sample in each bucket */
+    float          *pfAvg;              /**< Mean of the samples in each bucket */
+} tsHistoryRange;
+
+
+/** MiB and variable that JIPd samples on every node that has it */
+typedef struct
+{
+    char            acMib[HISTORY_MAX_NAME];    /**< MiB name */
+    char            acVar[HISTORY_MAX_NAME];    /**< Variable name */
+} tsHistoryWatch;
+
+
+/** Structure for the history sampler in JIPd.
+ *  Every u32Interval seconds each watched variable is read from every node
+ *  that has it and recorded at every resolution. */
+typedef struct
+{
+    tsJIP_Context      *psJIP_Context;  /**< Connected context to read variables with */
+    tsHistory           sHistory;       /**< Store being recorded into */
+    uint32_t            u32Interval;    /**< Interval between samples in seconds */
+    uint32_t            u32NumWatches;  /**< Number of watched variables */
+    tsHistoryWatch      asWatches[HISTORY_MAX_WATCHES]; /**< Watched variables */
+    
+    int                 iRun;           /**< Cleared to stop the sampler thread */
+    pthread_t           sThread;        /**< Sampler thread */
+    pthread_mutex_t     sMutex;         /**< Protects iRun */
+    pthread_cond_t      sCond;          /**< Signalled to stop the sampler thread */
+} tsHistorySampler;
+
+
+/** Open the history store.
+ *  \param psHistory        Pointer to history structure to initialise
+ *  \param iWritable        Non-zero to create the store if need be and record into it
+ *  \return E_HISTORY_OK on success, E_HISTORY_NO_HISTORY if it does not exist and iWritable is 0
+ */
+teHistoryStatus eHistoryOpen(tsHistory *psHistory, int iWritable);
+
+
+/** Close the history store.
+ *  \param psHistory        Open history store
+ */
+void vHistoryClose(tsHistory *psHistory);
+
+
+/** Record a sample of a variable at every resolution.
+ *  A series is started for a variable not seen before.
+ *  \param psHistory        History store opened for recording
+ *  \param psAddress        Address of the node
+ *  \param pcMib            Name of the MiB
+ *  \param pcVar            Name of the variable
+ *  \param tTime            Time of the sample
+ *  \param dValue           Value of the sample
+ *  \return E_HISTORY_OK on success
+ */
+teHistoryStatus eHistoryRecord(tsHistory *psHistory, const struct in6_addr *psAddress, const char *pcMib,
+                               const char *pcVar, time_t tTime, double dValue);
+
+
+/** Read a range of a variable's history.
+ *  The finest resolution that holds the whole range is used.
+ *  \param psHistory        Open history store
+ *  \param psAddress        Address of the node
+ *  \param pcMib            Name of the MiB
+ *  \param pcVar            Name of the variable
+ *  \param tEnd             End of the range
+ *  \param u32Range         Length of the range in seconds
+ *  \param psRange          Range to fill in. Free with \ref vHistoryRangeFree
+ *  \return E_HISTORY_OK on success, E_HISTORY_NO_HISTORY if the variable has none
+ */
+teHistoryStatus eHistoryQuery(tsHistory *psHistory, const struct in6_addr *psAddress, const char *pcMib,
+                              const char *pcVar, time_t tEnd, uint32_t u32Range, tsHistoryRange *psRange);
+
+
+/** Reduce a range to at most u32Points buckets for drawing.
+ *  The buckets kept are chosen from the averages by Largest-Triangle-Three-Buckets.
+ *  Each kept bucket's Min and Max are widened to cover the buckets dropped before it,
+ *  so peaks are not lost.
+ *  \param psRange          Range to reduce in place
+ *  \param u32Points        Most buckets to keep
+ *  \return E_HISTORY_OK on success
+ */
+teHistoryStatus eHistoryDownsample(tsHistoryRange *psRange, uint32_t u32Points);
+
+
+/** Free a range of history.
+ *  \param psRange          Range to free
+ */
+void vHistoryRangeFree(tsHistoryRange *psRange);
+
+
+/** Start a thread to sample watched variables into the history store.
+ *  \param psSampler        Pointer to sampler structure to initialise
+ *  \param psJIP_Context    Connected context to read variables with
+ *  \param u32Interval      Interval between samples in seconds
+ *  \param u32NumWatches    Number of watched variables
+ *  \param asWatches        Watched variables
+ *  \return E_HISTORY_OK on success
+ */
+teHistoryStatus eHistoryStart(tsHistorySampler *psSampler, tsJIP_Context *psJIP_Context, uint32_t u32Interval,
+                              uint32_t u32NumWatches, const tsHistoryWatch *asWatches);
+
+
+/** Stop the sampler thread and wait for it to exit.
+ *  \param psSampler        Pointer to running sampler
+ *  \return E_HISTORY_OK on success
+ */
+teHistoryStatus eHistoryStop(tsHistorySampler *psSampler);
+
+
+#endif /* __HISTORY_H_ */
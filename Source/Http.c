@@ -0,0 +1,464 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTTP/1.1 message parsing
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "Http.h"
+
+//#define DEBUG_HTTP
+
+#ifdef DEBUG_HTTP
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_HTTP */
+
+
+/** Find the end of the line starting at pcLine.
+ *  \param ppcNext          Location to store the start of the next line
+ *  \return End of the line, without its CR LF, or NULL if the line is not complete */
+static char *pcLineEnd(char *pcLine, char *pcLimit, char **ppcNext)
+{
+    char *pcNewLine = memchr(pcLine, '\n', pcLimit - pcLine);
+    
+    if (!pcNewLine)
+    {
+        return NULL;
+    }
+    *ppcNext = pcNewLine + 1;
+    if ((pcNewLine > pcLine) && (pcNewLine[-1] == '\r'))
+    {
+        pcNewLine--;
+    }
+    return pcNewLine;
+}
+
+
+static int iIsSpace(char c)
+{
+    return (c == ' ') || (c == '\t');
+}
+
+
+/** Compare a field name of known length, ignoring case */
+static int iNameIs(const char *pcName, size_t szName, const char *pcExpected)
+{
+    return (strlen(pcExpected) == szName) && (strncasecmp(pcName, pcExpected, szName) == 0);
+}
+
+
+/** Check for a token in a comma separated field value, ignoring case */
+static int iHasToken(const char *pcValue, size_t szValue, const char *pcToken)
+{
+    size_t szToken = strlen(pcToken);
+    const char *pcLimit = pcValue + szValue;
+    
+    while (pcValue < pcLimit)
+    {
+        const char *pcEnd;
+        
+        while ((pcValue < pcLimit) && ((*pcValue == ',') || iIsSpace(*pcValue)))
+        {
+            pcValue++;
+        }
+        pcEnd = pcValue;
+        while ((pcEnd < pcLimit) && (*pcEnd != ',') && !iIsSpace(*pcEnd))
+        {
+            pcEnd++;
+        }
+        if (((size_t)(pcEnd - pcValue) == szToken) && (strncasecmp(pcValue, pcToken, szToken) == 0))
+        {
+            return 1;
+        }
+        pcValue = pcEnd;
+    }
+    return 0;
+}
+
+
+teHttpStatus eHttpParseRequest(tsHttpRequest *psRequest, char *pcBuffer, size_t szLength)
+{
+    /* Places to terminate strings at once the whole request is there */
+    char *apcEnds[3 + (2 * HTTP_MAX_HEADERS)];
+    uint32_t u32NumEnds = 0;
+    char *pcLimit = pcBuffer + szLength;
+    char *pcPos = pcBuffer;
+    char *pcNext;
+    char *pcEnd;
+    char *pcMethodEnd;
+    char *pcTarget;
+    char *pcTargetEnd;
+    char *pcQuery;
+    int iClose = 0;
+    int iKeepAlive = 0;
+    int iHaveLength = 0;
+    size_t szBody = 0;
+    uint32_t i;
+    
+    memset(psRequest, 0, sizeof(tsHttpRequest));
+    
+    /* Empty lines before a request are ignored, some clients send one after a POST body */
+    while ((pcPos < pcLimit) && ((*pcPos == '\r') || (*pcPos == '\n')))
+    {
+        pcPos++;
+    }
+    
+    /* Request line: method SP target SP version */
+    pcEnd = pcLineEnd(pcPos, pcLimit, &pcNext);
+    if (!pcEnd)
+    {
+        return E_HTTP_INCOMPLETE;
+    }
+    pcMethodEnd = memchr(pcPos, ' ', pcEnd - pcPos);
+    if (!pcMethodEnd || (pcMethodEnd == pcPos))
+    {
+        return E_HTTP_BAD_REQUEST;
+    }
+    pcTarget = pcMethodEnd + 1;
+    pcTargetEnd = memchr(pcTarget, ' ', pcEnd - pcTarget);
+    if (!pcTargetEnd || (pcTargetEnd == pcTarget) || (*pcTarget != '/'))
+    {
+        return E_HTTP_BAD_REQUEST;
+    }
+    if (((pcEnd - pcTargetEnd) != 9) || strncmp(pcTargetEnd + 1, "HTTP/", 5) || (pcTargetEnd[7] != '.'))
+    {
+        return E_HTTP_BAD_REQUEST;
+    }
+    if ((pcTargetEnd[6] != '1') || (pcTargetEnd[8] < '0') || (pcTargetEnd[8] > '9'))
+    {
+        return E_HTTP_UNSUPPORTED;
+    }
+    psRequest->iMinorVersion = pcTargetEnd[8] - '0';
+    
+    psRequest->pcMethod = pcPos;
+    apcEnds[u32NumEnds++] = pcMethodEnd;
+    psRequest->pcPath = pcTarget;
+    pcQuery = memchr(pcTarget, '?', pcTargetEnd - pcTarget);
+    if (pcQuery)
+    {
+        apcEnds[u32NumEnds++] = pcQuery;
+        psRequest->pcQuery = pcQuery + 1;
+    }
+    else
+    {
+        psRequest->pcQuery = "";
+    }
+    apcEnds[u32NumEnds++] = pcTargetEnd;
+    
+    /* Header lines, up to an empty line */
+    for (pcPos = pcNext; ; pcPos = pcNext)
+    {
+        char *pcColon;
+        char *pcValue;
+        char *pcValueEnd;
+        size_t szName;
+        
+        pcEnd = pcLineEnd(pcPos, pcLimit, &pcNext);
+        if (!pcEnd)
+        {
+            return E_HTTP_INCOMPLETE;
+        }
+        if (pcEnd == pcPos)
+        {
+            break;
+        }
+        
+        /* Lines folded onto the previous one are obsolete */
+        if (iIsSpace(*pcPos) || (psRequest->u32NumHeaders == HTTP_MAX_HEADERS))
+        {
+            return E_HTTP_BAD_REQUEST;
+        }
+        pcColon = memchr(pcPos, ':', pcEnd - pcPos);
+        if (!pcColon || (pcColon == pcPos) || iIsSpace(pcColon[-1]))
+        {
+            return E_HTTP_BAD_REQUEST;
+        }
+        szName = pcColon - pcPos;
+        for (pcValue = pcColon + 1; (pcValue < pcEnd) && iIsSpace(*pcValue); pcValue++);
+        for (pcValueEnd = pcEnd; (pcValueEnd > pcValue) && iIsSpace(pcValueEnd[-1]); pcValueEnd--);
+        
+        if (iNameIs(pcPos, szName, "Content-Length"))
+        {
+            char *pcDigitsEnd;
+            unsigned long long ullLength;
+            
+            if ((pcValue == pcValueEnd) || (*pcValue < '0') || (*pcValue > '9'))
+            {
+                return E_HTTP_BAD_REQUEST;
+            }
+            ullLength = strtoull(pcValue, &pcDigitsEnd, 10);
+            if ((pcDigitsEnd != pcValueEnd) || (ullLength > (size_t)-1) || 
+                (iHaveLength && (szBody != ullLength)))
+            {
+                return E_HTTP_BAD_REQUEST;
+            }
+            szBody = ullLength;
+            iHaveLength = 1;
+        }
+        else if (iNameIs(pcPos, szName, "Transfer-Encoding"))
+        {
+            /* Chunked bodies are not needed by any of the pages */
+            return E_HTTP_UNSUPPORTED;
+        }
+        else if (iNameIs(pcPos, szName, "Connection"))
+        {
+            iClose      |= iHasToken(pcValue, pcValueEnd - pcValue, "close");
+            iKeepAlive  |= iHasToken(pcValue, pcValueEnd - pcValue, "keep-alive");
+        }
+        
+        psRequest->asHeaders[psRequest->u32NumHeaders].pcName   = pcPos;
+        psRequest->asHeaders[psRequest->u32NumHeaders].pcValue  = pcValue;
+        psRequest->u32NumHeaders++;
+        apcEnds[u32NumEnds++] = pcColon;
+        apcEnds[u32NumEnds++] = pcValueEnd;
+    }
+    
+    if (szBody > (size_t)(pcLimit - pcNext))
+    {
+        return E_HTTP_INCOMPLETE;
+    }
+    
+    /* The whole request is there, so its strings can be terminated in place */
+    for (i = 0; i < u32NumEnds; i++)
+    {
+        *apcEnds[i] = '\0';
+    }
+    psRequest->pcBody       = pcNext;
+    psRequest->szBody       = szBody;
+    psRequest->szLength     = (pcNext + szBody) - pcBuffer;
+    
+    /* HTTP/1.1 connections persist unless closed, HTTP/1.0 ones only if asked to */
+    if (psRequest->iMinorVersion >= 1)
+    {
+        psRequest->iKeepAlive = !iClose;
+    }
+    else
+    {
+        psRequest->iKeepAlive = iKeepAlive && !iClose;
+    }
+    
+    PRINTF("%s %s?%s HTTP/1.%d, %u headers, %zu byte body\n", psRequest->pcMethod, psRequest->pcPath, 
+           psRequest->pcQuery, psRequest->iMinorVersion, psRequest->u32NumHeaders, psRequest->szBody);
+    return E_HTTP_OK;
+}
+
+
+const char *pcHttpHeader(const tsHttpRequest *psRequest, const char *pcName)
+{
+    uint32_t i;
+    
+    for (i = 0; i < psRequest->u32NumHeaders; i++)
+    {
+        if (strcasecmp(psRequest->asHeaders[i].pcName, pcName) == 0)
+        {
+            return psRequest->asHeaders[i].pcValue;
+        }
+    }
+    return NULL;
+}
+
+
+const char *pcHttpReason(int iStatus)
+{
+    switch (iStatus)
+    {
+        case 200:   return "OK";
+        case 204:   return "No Content";
+        case 301:   return "Moved Permanently";
+        case 302:   return "Found";
+        case 303:   return "See Other";
+        case 304:   return "Not Modified";
+        case 400:   return "Bad Request";
+        case 403:   return "Forbidden";
+        case 404:   return "Not Found";
+        case 405:   return "Method Not Allowed";
+        case 413:   return "Payload Too Large";
+        case 500:   return "Internal Server Error";
+        case 501:   return "Not Implemented";
+        case 502:   return "Bad Gateway";
+        case 503:   return "Service Unavailable";
+        case 504:   return "Gateway Timeout";
+        case 505:   return "HTTP Version Not Supported";
+        default:    return "Unknown";
+    }
+}
+
+
+size_t szHttpFormatHead(char *pcBuffer, size_t szSize, int iStatus, const char *pcContentType,
+                        size_t szContentLength, int iKeepAlive)
+{
+    int iLength;
+    
+    iLength = snprintf(pcBuffer, szSize, "HTTP/1.1 %d %s\r\n%s%s%sContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                       iStatus, pcHttpReason(iStatus), 
+                       pcContentType ? "Content-Type: " : "", pcContentType ? pcContentType : "", pcContentType ? "\r\n" : "",
+                       szContentLength, iKeepAlive ? "keep-alive" : "close");
+    if ((iLength < 0) || ((size_t)iLength >= szSize))
+    {
+        return 0;
+    }
+    return iLength;
+}
+
+
+teHttpStatus eHttpFromCgi(const char *pcOutput, size_t szOutput, int iHeadOnly, int iKeepAlive,
+                          char **ppcResponse, size_t *pszResponse)
+{
+    char *pcLimit = (char *)pcOutput + szOutput;
+    char *pcPos;
+    char *pcNext;
+    char *pcEnd;
+    const char *pcReason = NULL;
+    size_t szReason = 0;
+    const char *pcBody;
+    size_t szBody;
+    size_t szHead;
+    size_t szSize;
+    char *pcResponse;
+    size_t szResponse;
+    int iStatus = 0;
+    int iLocation = 0;
+    int iSendBody;
+    
+    /* Find the status and the end of the headers */
+    for (pcPos = (char *)pcOutput; ; pcPos = pcNext)
+    {
+        char *pcColon;
+        
+        pcEnd = pcLineEnd(pcPos, pcLimit, &pcNext);
+        if (!pcEnd)
+        {
+            return E_HTTP_BAD_REQUEST;
+        }
+        if (pcEnd == pcPos)
+        {
+            break;
+        }
+        pcColon = memchr(pcPos, ':', pcEnd - pcPos);
+        if (!pcColon || (pcColon == pcPos))
+        {
+            return E_HTTP_BAD_REQUEST;
+        }
+        if (iNameIs(pcPos, pcColon - pcPos, "Status"))
+        {
+            char *pcCode;
+            
+            iStatus = strtol(pcColon + 1, &pcCode, 10);
+            if ((iStatus < 100) || (iStatus > 999))
+            {
+                return E_HTTP_BAD_REQUEST;
+            }
+            for (; (pcCode < pcEnd) && iIsSpace(*pcCode); pcCode++);
+            if (pcCode < pcEnd)
+            {
+                pcReason = pcCode;
+                szReason = pcEnd - pcCode;
+            }
+        }
+        else if (iNameIs(pcPos, pcColon - pcPos, "Location"))
+        {
+            iLocation = 1;
+        }
+    }
+    pcBody = pcNext;
+    szBody = pcLimit - pcNext;
+    szHead = pcBody - pcOutput;
+    
+    if (!iStatus)
+    {
+        /* A redirect without a status is a Found */
+        iStatus = iLocation ? 302 : 200;
+    }
+    if (!pcReason)
+    {
+        pcReason = pcHttpReason(iStatus);
+        szReason = strlen(pcReason);
+    }
+    iSendBody = !iHeadOnly && (iStatus != 204) && (iStatus != 304);
+    
+    /* Every header line may grow by a CR, plus the status and framing lines */
+    szSize = (2 * szHead) + szReason + 128 + (iSendBody ? szBody : 0);
+    pcResponse = malloc(szSize);
+    if (!pcResponse)
+    {
+        return E_HTTP_NO_MEMORY;
+    }
+    szResponse = sprintf(pcResponse, "HTTP/1.1 %d %.*s\r\n", iStatus, (int)szReason, pcReason);
+    
+    for (pcPos = (char *)pcOutput; pcPos < pcBody; pcPos = pcNext)
+    {
+        size_t szName;
+        
+        pcEnd = pcLineEnd(pcPos, pcLimit, &pcNext);
+        if (pcEnd == pcPos)
+        {
+            break;
+        }
+        szName = (char *)memchr(pcPos, ':', pcEnd - pcPos) - pcPos;
+        
+        /* The framing of the body is the server's */
+        if (iNameIs(pcPos, szName, "Status") || iNameIs(pcPos, szName, "Content-Length") ||
+            iNameIs(pcPos, szName, "Connection") || iNameIs(pcPos, szName, "Transfer-Encoding"))
+        {
+            continue;
+        }
+        memcpy(&pcResponse[szResponse], pcPos, pcEnd - pcPos);
+        szResponse += pcEnd - pcPos;
+        pcResponse[szResponse++] = '\r';
+        pcResponse[szResponse++] = '\n';
+    }
+    
+    if ((iStatus != 204) && (iStatus != 304))
+    {
+        szResponse += sprintf(&pcResponse[szResponse], "Content-Length: %zu\r\n", szBody);
+    }
+    szResponse += sprintf(&pcResponse[szResponse], "Connection: %s\r\n\r\n", iKeepAlive ? "keep-alive" : "close");
+    if (iSendBody)
+    {
+        memcpy(&pcResponse[szResponse], pcBody, szBody);
+        szResponse += szBody;
+    }
+    
+    *ppcResponse = pcResponse;
+    *pszResponse = szResponse;
+    return E_HTTP_OK;
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTTP/1.1 message parsing
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __HTTP_H_
+#define __HTTP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Most header lines a request may have */
+#define HTTP_MAX_HEADERS            32
+
+
+/** Enumerated type of status codes from the HTTP parser */
+typedef enum
+{
+    E_HTTP_OK,                  /**< All ok */
+    E_HTTP_INCOMPLETE,          /**< More of the message is needed */
+    E_HTTP_BAD_REQUEST,         /**< Malformed message */
+    E_HTTP_UNSUPPORTED,         /**< Valid, but uses a feature that is not supported */
+    E_HTTP_NO_MEMORY,           /**< Memory allocation failed */
+} teHttpStatus;
+
+
+/** A header line of a request */
+typedef struct
+{
+    const char          *pcName;        /**< Field name, as sent */
+    const char          *pcValue;       /**< Field value, without surrounding white space */
+} tsHttpHeader;
+
+
+/** A parsed request. The strings point into the buffer it was parsed from */
+typedef struct
+{
+    const char          *pcMethod;      /**< Method, eg. "GET" */
+    const char          *pcPath;        /**< Path of the target, without the query */
+    const char          *pcQuery;       /**< Query of the target after the '?', "" if it has none */
+    int                 iMinorVersion;  /**< HTTP/1.x minor version */
+    int                 iKeepAlive;     /**< Set if the connection stays open after the response */
+    
+    tsHttpHeader        asHeaders[HTTP_MAX_HEADERS]; /**< Header lines */
+    uint32_t            u32NumHeaders;  /**< Number of header lines */
+    
+    const char          *pcBody;        /**< Body */
+    size_t              szBody;         /**< Length of body */
+    size_t              szLength;       /**< Length of the whole message, head and body */
+} tsHttpRequest;
+
+
+/** Parse the request at the start of a buffer. Further requests may follow
+ *  it, pipelined, from szLength on. The buffer is only modified, to
+ *  terminate the strings of the request, once the whole of it is there.
+ *  \param psRequest        Pointer to request to fill in
+ *  \param pcBuffer         Received data
+ *  \param szLength         Length of received data
+ *  \return E_HTTP_OK if a whole request was parsed, E_HTTP_INCOMPLETE if more data is needed
+ */
+teHttpStatus eHttpParseRequest(tsHttpRequest *psRequest, char *pcBuffer, size_t szLength);
+
+
+/** Find a header of a request, ignoring case.
+ *  \param psRequest        Pointer to request
+ *  \param pcName           Field name
+ *  \return Field value, or NULL if the request does not have it
+ */
+const char *pcHttpHeader(const tsHttpRequest *psRequest, const char *pcName);
+
+
+/** Reason phrase of a status code */
+const char *pcHttpReason(int iStatus);
+
+
+/** Format the head of a response with a body of known length.
+ *  \param pcBuffer         Buffer to format into
+ *  \param szSize           Size of buffer
+ *  \param iStatus          Status code
+ *  \param pcContentType    Content-Type of the body, NULL for none
+ *  \param szContentLength  Length of the body
+ *  \param iKeepAlive       Non zero if the connection stays open
+ *  \return Length of the head, or 0 if it does not fit
+ */
+size_t szHttpFormatHead(char *pcBuffer, size_t szSize, int iStatus, const char *pcContentType,
+                        size_t szContentLength, int iKeepAlive);
+
+
+/** Convert the output of a CGI program into a HTTP/1.1 response. The status
+ *  is taken from a "Status:" header, the other headers are passed on, and
+ *  the length of the body framed with Content-Length.
+ *  \param pcOutput         Output of the program, headers and body
+ *  \param szOutput         Length of output
+ *  \param iHeadOnly        Non zero to leave out the body, for a HEAD request
+ *  \param iKeepAlive       Non zero if the connection stays open
+ *  \param ppcResponse      Location to store the response, to be freed by the caller
+ *  \param pszResponse      Location to store the length of the response
+ *  \return E_HTTP_OK on success, E_HTTP_BAD_REQUEST if the output is not a CGI response
+ */
+teHttpStatus eHttpFromCgi(const char *pcOutput, size_t szOutput, int iHeadOnly, int iKeepAlive,
+                          char **ppcResponse, size_t *pszResponse);
+
+
+#endif /* __HTTP_H_ */
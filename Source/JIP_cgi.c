@@ -47,27 +47,36 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
+#include <inttypes.h>
 
 #include <json.h>
 
 #include <Zeroconf.h> 
 #include <JIP.h>
 
+#include "Aggregate.h"
+#include "BRSet.h"
+#include "Broker.h"
 #include "CGI.h"
+#include "Cbor.h"
+#include "Codec.h"
+#include "Coalesce.h"
+#include "GroupModel.h"
+#include "History.h"
+#include "Multicall.h"
+#include "NetworkCache.h"
+#include "Response.h"
 
 #define DISPLAY_JENNET_MIB
 
 
-#define CACHE_DEFINITIONS_FILE_NAME "/tmp/jip_cache_definitions.xml"
-#define CACHE_NETWORK_FILE_NAME "/tmp/jip_cache_network.xml"
-
-
 static int verbosity = 0;
 
 #ifndef VERSION
 #error Version is not defined!
 #else
-const char *Version = "0.2 (r" VERSION ")";
+static const char *Version = "0.2 (r" VERSION ")";
 #endif
 
 
@@ -89,11 +98,23 @@ typedef struct
 } tsVarAction;
 
 
-/* Filter variables */
-static char *filter_ipv6 = NULL;
-static char *filter_device = NULL;
-static char *filter_mib = NULL;
-static char *filter_var = NULL;
+/** Most requests accepted in one batch */
+#define BATCH_MAX_REQUESTS  64
+
+/** Most threads a batch is executed on, including the one handling the request */
+#define BATCH_MAX_THREADS   8
+
+
+/* Filter variables. Batches are executed on several threads at once, so
+ * these and the lists being encoded into are per thread */
+static __thread const char *filter_ipv6 = NULL;
+static __thread const char *filter_device = NULL;
+static __thread const char *filter_mib = NULL;
+static __thread const char *filter_var = NULL;
+
+/* Arena for the working buffers of the request being handled. Batch threads
+ * each use their own so that no locking is needed to allocate */
+static __thread tsArena *psArena = NULL;
 
 /* Callback function types from \ref jip_iterate */
 typedef int(*tprCbNode) (tsNode *psNode, void *pvUser);
@@ -106,19 +127,64 @@ static int jip_iterate(tprCbNode prCbNode,   void *pvNodeUser,
 
 static tsJIP_Context sJIP_Context;
 
+/** Context that the callbacks of \ref jip_iterate operate on.
+ *  Points at one border router's context of a \ref tsBRSet when
+ *  every border router is being used. */
+static tsJIP_Context *psJIP_Context = &sJIP_Context;
+
+/** Address of the border router being iterated, to tag nodes with, or NULL for a single border router */
+static const char *pcBorderRouter = NULL;
+
+static tsBrokerLink sLink;
+
+/** Link that variables of \ref psJIP_Context are read and set through,
+ *  or NULL to use the context directly */
+static tsBrokerLink *psLink = NULL;
+
 static tsCGI sCGI;
 
+/** Response to the request, compressed if the client allows it */
+static tsResponse sResponse;
+
+/** Entity tag of the response, empty if the response may not be cached */
+static char acETag[32];
+
+/** Set if the client already holds the response described by \ref acETag */
+static int iNotModified = 0;
+
+/** Set if the response is encoded as CBOR rather than JSON text */
+static int iCbor = 0;
+
+/** Encoder for CBOR responses */
+static tsCbor sCbor;
+
 
 /** @{ Command handlers */
 static tsResult cmd_getVersion(struct json_object* psResult);
 static tsResult cmd_discoverBRs(struct json_object* psResult);
-static tsResult cmd_discoverNetwork(struct json_object* psResult);
+static tsResult cmd_discoverNetwork(struct json_object* psResult, tsNetworkCacheModel *psModel, const char *pcDepth, const char *pcSince);
 static tsResult cmd_getVar(struct json_object* psResult);
-static tsResult cmd_setVar(char *pcUpdateValue);
+static tsResult cmd_setVar(const char *pcUpdateValue);
+static tsResult cmd_batch(struct json_object* psJsonResult, const char *pcBRAddress, const char *pcRequests);
+static tsResult cmd_aggregate(struct json_object* psJsonNetwork, const char *pcAction, teNetworkCacheRefresh eRefresh, char *pcUpdateValue, int *piAge);
+static tsResult cmd_history(struct json_object* psJsonResult, const char *pcNodeAddress, const char *pcMib, const char *pcVar,
+                            const char *pcRange, const char *pcEnd, const char *pcPoints);
 
 /** @} */
 
-int main(int argc, char *argv[])
+
+/** Set the entity tag of the response from a version stamp of what it is built from.
+ *  \return non-zero if the client already holds that version, so nothing needs serialising.
+ */
+static int iSetETag(uint32_t u32Stamp)
+{
+    snprintf(acETag, sizeof(acETag), "\"" VERSION "-%08x%s\"", u32Stamp, iCbor ? ".cbor" : "");
+    iNotModified = iCGIETagMatches(acETag);
+    return iNotModified;
+}
+
+
+int CGI_MAIN(JIP_cgi)(int argc, char *argv[])
 {
     char *pcAction                          = NULL;
     char *pcBRNAddress                      = NULL;
@@ -128,16 +194,23 @@ int main(int argc, char *argv[])
     char *pcVarIndex                        = NULL;
     char *pcRefreshNodes                    = NULL;
     char *pcUpdateValue                     = NULL;
+    char *pcDepth                           = NULL;
+    char *pcFormat                          = NULL;
+    char *pcSince                           = NULL;
     teJIP_Status eStatus;
+    int iAge;
+    tsNetworkCacheModel sModel;
     
     tsResult sResult;
     
     struct json_object* psJsonResult        = NULL;
+    const char *pcJson;
     struct json_object* psJsonNetwork       = NULL;
     
     struct json_object* psJsonStatus        = NULL;
     struct json_object* psJsonStatusInt     = NULL;
     struct json_object* psJsonStatusText    = NULL;
+    struct json_object* psJsonStatusAge     = NULL;
     
 #define SET_STATUS(i, t) \
         psJsonStatusInt     = json_object_new_int(i); \
@@ -156,8 +229,25 @@ int main(int argc, char *argv[])
         printf("Error initialising CGI\n\r");
         return -1;
     }
+    psArena = &sCGI.sArena;
+    
+    eResponseInit(&sResponse, STDOUT_FILENO);
+    memset(&sModel, 0, sizeof(tsNetworkCacheModel));
     
-    printf("Content-type: application/json\r\n\r\n");
+    /* Clients can ask for CBOR explicitly, or negotiate it with the Accept header */
+    pcFormat = pcCGIGetValue(&sCGI, "format");
+    if (pcFormat)
+    {
+        iCbor = (strcasecmp(pcFormat, "cbor") == 0);
+    }
+    else
+    {
+        iCbor = iCGIAccepts(CBOR_CONTENT_TYPE);
+    }
+    if ((iCbor) && (eCborInit(&sCbor) != E_CBOR_OK))
+    {
+        iCbor = 0;
+    }
     
     pcAction = pcCGIGetValue(&sCGI, "action");
     if (!pcAction)
@@ -171,11 +261,8 @@ int main(int argc, char *argv[])
     pcVarIndex          = pcCGIGetValue(&sCGI, "var");
     pcRefreshNodes      = pcCGIGetValue(&sCGI, "refresh");
     pcUpdateValue       = pcCGIGetValue(&sCGI, "value");
-    
-    if (pcRefreshNodes == NULL)
-    {
-        pcRefreshNodes = "yes";
-    }
+    pcDepth             = pcCGIGetValue(&sCGI, "depth");
+    pcSince             = pcCGIGetValue(&sCGI, "since");
     
     if (strcasecmp(pcAction, "getVersion") == 0)
     {
@@ -187,63 +274,114 @@ int main(int argc, char *argv[])
         sResult = cmd_discoverBRs(psJsonResult);
         EXIT_STATUS(sResult.iValue, sResult.pcDescription);
     }
+    else if (strcasecmp(pcAction, "history") == 0)
+    {
+        /* Served from JIPd's store without connecting to the border router */
+        sResult = cmd_history(psJsonResult, pcNodeAddress, pcMibId, pcVarIndex, 
+                              pcCGIGetValue(&sCGI, "range"), pcCGIGetValue(&sCGI, "end"), pcCGIGetValue(&sCGI, "points"));
+        EXIT_STATUS(sResult.iValue, sResult.pcDescription);
+    }
 
     if (pcBRNAddress == NULL)
     {
         EXIT_STATUS(E_CGI_ERROR, "No BR Specified");
     }
+    
+    if (strcasecmp(pcBRNAddress, BR_SET_ALL) == 0)
+    {
+        /* Every border router at once, merged into one network */
+        filter_ipv6 = pcNodeAddress;
+        filter_mib = pcMibId;
+        filter_var = pcVarIndex;
+        
+        psJsonNetwork = json_object_new_object();
+        sResult = cmd_aggregate(psJsonNetwork, pcAction, eNetworkCacheRefreshPolicy(pcRefreshNodes), pcUpdateValue, &iAge);
+        psJsonStatusAge = json_object_new_int(iAge);
+        EXIT_STATUS(sResult.iValue, sResult.pcDescription);
+    }
+    
+    if ((strcasecmp(pcAction, "SetVar") == 0) && (pcNodeAddress) && (pcMibId) && (pcVarIndex) && (pcUpdateValue) &&
+        (strncasecmp(pcNodeAddress, "FF", 2) != 0))
+    {
+        static tsCoalesceReply sReply;
+        teCoalesceStatus eCoalesceStatus;
+        
+        /* JIPd collapses bursts of SetVars to the same variable, such as
+         * from a slider being dragged, into the latest value */
+        eCoalesceStatus = eCoalesceSetVar(pcBRNAddress, pcNodeAddress, pcMibId, pcVarIndex, pcUpdateValue, &sReply);
+        if (eCoalesceStatus == E_COALESCE_OK)
+        {
+            EXIT_STATUS(sReply.i32Status, sReply.acDescription);
+        }
+        else if (eCoalesceStatus == E_COALESCE_ERROR)
+        {
+            /* JIPd may already have made it. Setting it again could repeat
+             * it after a newer value from another client */
+            EXIT_STATUS(E_JIP_ERROR_FAILED, "No answer from JIPd");
+        }
+    }
+    
+    if (strcasecmp(pcAction, "discover") == 0)
+    {
+        uint32_t u32Version;
+        
+        /* If the snapshot will be used as it is, the client's copy can be
+         * validated from its version stamp without connecting to the border router */
+        if ((eNetworkCacheVersion(pcBRNAddress, eNetworkCacheRefreshPolicy(pcRefreshNodes), &u32Version) == E_NETWORK_CACHE_OK) &&
+            (iSetETag(u32Version)))
+        {
+            goto end;
+        }
+    }
 
     if (eStatus = eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK)
     {
         EXIT_STATUS(eStatus, "JIP startup failed");
     }
 
-    if (eStatus = eJIP_Connect(&sJIP_Context, pcBRNAddress, JIP_DEFAULT_PORT) != E_JIP_OK)
-    {
-        EXIT_STATUS(eStatus, "JIP connect failed");
-    }
+    /* Variables are read and set through JIPd's connection to the border
+     * router where it can, so ours is only made if it is needed */
+    eBrokerLinkOpen(&sLink, &sJIP_Context, pcBRNAddress);
+    psLink = &sLink;
     
-    /* Load the cached device id's and any network contents if possible */
-    if (eJIPService_PersistXMLLoadDefinitions(&sJIP_Context, CACHE_DEFINITIONS_FILE_NAME) != E_JIP_OK)
+    if (strcasecmp(pcAction, "discover") == 0)
     {
-        // Couldn't load the definitions file, fall back to discovery.
-        if ((eStatus = eJIPService_DiscoverNetwork(&sJIP_Context)) != E_JIP_OK)
+        /* Discovery only describes the structure of the network, so it is
+         * served from the node model without loading the cached network */
+        if ((eStatus = eBrokerAcquireModel(&sLink, eNetworkCacheRefreshPolicy(pcRefreshNodes), &sModel, &iAge)) != E_JIP_OK)
         {
+            acETag[0] = '\0';
             EXIT_STATUS(eStatus, "JIP discover network failed");
         }
-    }
-    else
-    {
-        if (strcmp(pcRefreshNodes, "yes") == 0)
+        
+        if (iSetETag(sModel.psHeader->u32Version))
         {
-            if (eStatus = eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
-            {
-                EXIT_STATUS(eStatus, "JIP discover network failed");
-            }
+            goto end;
         }
-        else
+        psJsonStatusAge = json_object_new_int(iAge);
+        
+        filter_ipv6 = pcNodeAddress;
+        
+        psJsonNetwork = json_object_new_object();
+        sResult = cmd_discoverNetwork(psJsonNetwork, &sModel, pcDepth, pcSince);
+        if (sResult.iValue != E_JIP_OK)
         {
-            /* Load the cached network if possible */
-            if (eJIPService_PersistXMLLoadNetwork(&sJIP_Context, CACHE_NETWORK_FILE_NAME) != E_JIP_OK)
-            {
-                // Couldn't load the network file, fall back to discovery.
-                if ((eStatus = eJIPService_DiscoverNetwork(&sJIP_Context)) != E_JIP_OK)
-                {
-                    EXIT_STATUS(eStatus, "JIP discover network failed");
-                }
-            }
+            acETag[0] = '\0';
         }
+        SET_STATUS(sResult.iValue, sResult.pcDescription);
+        goto end;
     }
     
-    //eJIP_PrintNetworkContent(&sJIP_Context);
-    
-    if (strcasecmp(pcAction, "discover") == 0)
+    /* Use the latest snapshot of the network unless asked to rediscover it */
+    if ((eStatus = eBrokerAcquireNetwork(&sLink, eNetworkCacheRefreshPolicy(pcRefreshNodes), &iAge)) != E_JIP_OK)
     {
-        psJsonNetwork = json_object_new_object();
-        sResult = cmd_discoverNetwork(psJsonNetwork);
-        SET_STATUS(sResult.iValue, sResult.pcDescription);
+        EXIT_STATUS(eStatus, "JIP discover network failed");
     }
-    else if (strcasecmp(pcAction, "GetVar") == 0)
+    psJsonStatusAge = json_object_new_int(iAge);
+    
+    //eJIP_PrintNetworkContent(&sJIP_Context);
+    
+    if (strcasecmp(pcAction, "GetVar") == 0)
     {
         filter_ipv6 = pcNodeAddress;
         filter_mib = pcMibId;
@@ -262,15 +400,44 @@ int main(int argc, char *argv[])
         sResult = cmd_setVar(pcUpdateValue);
         SET_STATUS(sResult.iValue, sResult.pcDescription);
     }
+    else if (strcasecmp(pcAction, "batch") == 0)
+    {
+        sResult = cmd_batch(psJsonResult, pcBRNAddress, pcCGIGetValue(&sCGI, "requests"));
+        SET_STATUS(sResult.iValue, sResult.pcDescription);
+    }
     else
     {
         SET_STATUS(E_JIP_ERROR_FAILED, "Unknown action");
     }
 
-    (void)eJIPService_PersistXMLSaveDefinitions(&sJIP_Context, CACHE_DEFINITIONS_FILE_NAME);
-    (void)eJIPService_PersistXMLSaveNetwork(&sJIP_Context, CACHE_NETWORK_FILE_NAME);
-
 end:
+    if (!pcFormat)
+    {
+        /* The representation depends on the Accept header */
+        eResponseHeader(&sResponse, "Vary: Accept");
+    }
+    
+    if (iNotModified)
+    {
+        eResponseHeader(&sResponse, "Status: 304 Not Modified");
+        eResponseHeader(&sResponse, "ETag: W/%s", acETag);
+        eResponseFinish(&sResponse);
+        vNetworkCacheModelClose(&sModel);
+        vBrokerLinkClose(&sLink);
+        vCborFree(&sCbor);
+        vCGIFree(&sCGI);
+        return 0;
+    }
+    
+    eResponseHeader(&sResponse, "Content-type: %s", iCbor ? CBOR_CONTENT_TYPE : "application/json");
+    if (acETag[0])
+    {
+        /* Cacheable, but always revalidated with If-None-Match. The tag is
+         * weak as gzip'd and plain representations are not byte identical */
+        eResponseHeader(&sResponse, "Cache-Control: no-cache");
+        eResponseHeader(&sResponse, "ETag: W/%s", acETag);
+    }
+    
     json_object_object_add (psJsonResult,
                             "Status",
                             psJsonStatus);
@@ -283,6 +450,14 @@ end:
                             "Description",
                             psJsonStatusText);
     
+    if (psJsonStatusAge)
+    {
+        /* Age of the network snapshot in seconds */
+        json_object_object_add (psJsonStatus,
+                                "Age",
+                                psJsonStatusAge);
+    }
+    
     if (psJsonNetwork)
     {
         json_object_object_add (psJsonResult,
@@ -290,7 +465,24 @@ end:
                                 psJsonNetwork);
     }
     
-    printf("%s", json_object_to_json_string(psJsonResult));
+    if (iCbor)
+    {
+        if (eCborEncodeJson(&sCbor, psJsonResult) == E_CBOR_OK)
+        {
+            eResponseWrite(&sResponse, sCbor.pu8Buffer, sCbor.szLength);
+        }
+        vCborFree(&sCbor);
+    }
+    else
+    {
+        pcJson = json_object_to_json_string(psJsonResult);
+        eResponseWrite(&sResponse, pcJson, strlen(pcJson));
+    }
+    eResponseFinish(&sResponse);
+    
+    vNetworkCacheModelClose(&sModel);
+    vBrokerLinkClose(&sLink);
+    vCGIFree(&sCGI);
 #undef SET_STATUS
 #undef EXIT_STATUS
     return 0;
@@ -338,6 +530,12 @@ static tsResult cmd_discoverBRs(struct json_object* psJsonResult)
     {
         SET_RESULT(E_CGI_ERROR, "Failed to find gateway address via Zeroconf");
     }
+    else if (iSetETag(u32CGIHash(CGI_HASH_INIT, asAddresses, iNumAddresses * sizeof(struct in6_addr))))
+    {
+        /* Same border routers as the client already has */
+        free(asAddresses);
+        SET_RESULT(E_JIP_OK, "Not modified");
+    }
     else
     {
         struct json_object* psJsonBRList;
@@ -367,11 +565,152 @@ static tsResult cmd_discoverBRs(struct json_object* psJsonResult)
 }
 
 
+/** Encode one column of history. Whole numbers, as most variables are, are sent as integers */
+static struct json_object *psEncodeHistoryColumn(const float *pfColumn, uint32_t u32Length)
+{
+    struct json_object *psJsonColumn = json_object_new_array();
+    uint32_t i;
+    
+    for (i = 0; i < u32Length; i++)
+    {
+        if ((pfColumn[i] > -2e9f) && (pfColumn[i] < 2e9f) && (pfColumn[i] == (float)(int32_t)pfColumn[i]))
+        {
+            json_object_array_add(psJsonColumn, json_object_new_int((int32_t)pfColumn[i]));
+        }
+        else
+        {
+            json_object_array_add(psJsonColumn, json_object_new_double(pfColumn[i]));
+        }
+    }
+    return psJsonColumn;
+}
+
+
+/** Command handler to return the history of a variable over a range of time.
+ *  The buckets are sent column by column. The start of each is Start + (Offset * Resolution).
+ *  If points is given, no more than that many buckets are sent, chosen to keep the shape of the graph. */
+static tsResult cmd_history(struct json_object* psJsonResult, const char *pcNodeAddress, const char *pcMib, const char *pcVar,
+                            const char *pcRange, const char *pcEnd, const char *pcPoints)
+{
+    tsHistory sHistory;
+    tsHistoryRange sRange;
+    struct in6_addr sAddress;
+    struct json_object* psJsonHistory;
+    struct json_object* psJsonOffset;
+    struct json_object* psJsonSummary;
+    tsAggregateFloat sMin, sMax, sAvg;
+    uint32_t u32Range = 3600;
+    uint32_t u32Points = 0;
+    uint32_t u32Tag;
+    time_t tEnd = time(NULL);
+    teHistoryStatus eStatus;
+    tsResult sResult;
+    uint32_t i;
+    
+    if ((!pcNodeAddress) || (!pcMib) || (!pcVar) || (inet_pton(AF_INET6, pcNodeAddress, &sAddress) != 1))
+    {
+        SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Node address, mib and var are required");
+        return sResult;
+    }
+    if (pcRange)
+    {
+        u32Range = strtoul(pcRange, NULL, 10);
+    }
+    if (pcEnd)
+    {
+        tEnd = (time_t)strtoul(pcEnd, NULL, 10);
+    }
+    if (pcPoints)
+    {
+        u32Points = strtoul(pcPoints, NULL, 10);
+    }
+    
+    if (eHistoryOpen(&sHistory, 0) != E_HISTORY_OK)
+    {
+        SET_RESULT(E_JIP_ERROR_FAILED, "No history is being kept");
+        return sResult;
+    }
+    eStatus = eHistoryQuery(&sHistory, &sAddress, pcMib, pcVar, tEnd, u32Range, &sRange);
+    vHistoryClose(&sHistory);
+    
+    switch (eStatus)
+    {
+        case (E_HISTORY_OK):
+            break;
+        case (E_HISTORY_NO_HISTORY):
+            SET_RESULT(E_JIP_ERROR_FAILED, "No history of that variable");
+            return sResult;
+        case (E_HISTORY_INVALID_PARAMS):
+            SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Invalid range");
+            return sResult;
+        default:
+            SET_RESULT(E_JIP_ERROR_NO_MEM, pcJIP_strerror(E_JIP_ERROR_NO_MEM));
+            return sResult;
+    }
+    
+    /* The range only changes with a new sample or when its start moves on.
+     * Every input goes into the tag, as a sliding window keeps the gap between them. */
+    u32Tag = u32CGIHash(CGI_HASH_INIT, &sRange.u32Start, sizeof(sRange.u32Start));
+    u32Tag = u32CGIHash(u32Tag, &sRange.u32LastSample, sizeof(sRange.u32LastSample));
+    u32Tag = u32CGIHash(u32Tag, &u32Range, sizeof(u32Range));
+    u32Tag = u32CGIHash(u32Tag, &u32Points, sizeof(u32Points));
+    u32Tag = u32CGIHash(u32Tag, &sAddress, sizeof(sAddress));
+    u32Tag = u32CGIHash(u32Tag, pcMib, strlen(pcMib) + 1);
+    u32Tag = u32CGIHash(u32Tag, pcVar, strlen(pcVar) + 1);
+    if (iSetETag(u32Tag))
+    {
+        vHistoryRangeFree(&sRange);
+        SET_RESULT(E_JIP_OK, "Success");
+        return sResult;
+    }
+    
+    /* Summary of the whole range, before any buckets are dropped */
+    vAggregateFloat(sRange.pfMin, sRange.u32NumBuckets, &sMin);
+    vAggregateFloat(sRange.pfMax, sRange.u32NumBuckets, &sMax);
+    vAggregateFloat(sRange.pfAvg, sRange.u32NumBuckets, &sAvg);
+    
+    if ((u32Points) && (eHistoryDownsample(&sRange, u32Points) != E_HISTORY_OK))
+    {
+        vHistoryRangeFree(&sRange);
+        SET_RESULT(E_JIP_ERROR_NO_MEM, pcJIP_strerror(E_JIP_ERROR_NO_MEM));
+        return sResult;
+    }
+    
+    psJsonHistory = json_object_new_object();
+    json_object_object_add(psJsonResult, "History", psJsonHistory);
+    json_object_object_add(psJsonHistory, "Resolution", json_object_new_int(sRange.u32Resolution));
+    json_object_object_add(psJsonHistory, "Start", json_object_new_int64(sRange.u32Start));
+    json_object_object_add(psJsonHistory, "LastSample", json_object_new_int64(sRange.u32LastSample));
+    if (sAvg.u32Count)
+    {
+        psJsonSummary = json_object_new_object();
+        json_object_object_add(psJsonSummary, "Min", json_object_new_double(sMin.fMin));
+        json_object_object_add(psJsonSummary, "Max", json_object_new_double(sMax.fMax));
+        json_object_object_add(psJsonSummary, "Mean", json_object_new_double(sAvg.dSum / sAvg.u32Count));
+        json_object_object_add(psJsonHistory, "Summary", psJsonSummary);
+    }
+    
+    psJsonOffset = json_object_new_array();
+    for (i = 0; i < sRange.u32NumBuckets; i++)
+    {
+        json_object_array_add(psJsonOffset, json_object_new_int(sRange.pu32Offset[i]));
+    }
+    json_object_object_add(psJsonHistory, "Offset", psJsonOffset);
+    json_object_object_add(psJsonHistory, "Min", psEncodeHistoryColumn(sRange.pfMin, sRange.u32NumBuckets));
+    json_object_object_add(psJsonHistory, "Max", psEncodeHistoryColumn(sRange.pfMax, sRange.u32NumBuckets));
+    json_object_object_add(psJsonHistory, "Avg", psEncodeHistoryColumn(sRange.pfAvg, sRange.u32NumBuckets));
+    
+    vHistoryRangeFree(&sRange);
+    SET_RESULT(E_JIP_OK, "Success");
+    return sResult;
+}
+
+
 /* Network discovery */
 
 
-struct json_object* psJsonMibList = NULL;
-struct json_object* psJsonVarList = NULL;
+static __thread struct json_object* psJsonMibList = NULL;
+static __thread struct json_object* psJsonVarList = NULL;
 
 /** Callback funtion to encode node details */
 int json_encode_node (tsNode *psNode, void *pvUser)
@@ -397,6 +736,13 @@ int json_encode_node (tsNode *psNode, void *pvUser)
                     "DeviceID",
                     psJsonNodeDeviceId);
     
+    if (pcBorderRouter)
+    {
+        json_object_object_add (psJsonNode,
+                        "BorderRouter",
+                        json_object_new_string(pcBorderRouter));
+    }
+    
     json_object_array_add(psJsonNodeList, psJsonNode);
     
     psJsonMibList = json_object_new_array();
@@ -436,6 +782,76 @@ int json_encode_mib (tsMib *psMib, void *pvUser)
 }
 
 
+/** Encode the value of an integer variable.
+ *  JSON clients have always been given doubles. CBOR keeps the integer. */
+static struct json_object *psEncodeInteger(int64_t i64Value)
+{
+    if (iCbor)
+    {
+        return json_object_new_int64(i64Value);
+    }
+    return json_object_new_double((double)i64Value);
+}
+
+
+/** Serialises marking of CBOR strings, as batches encode values on several threads */
+static pthread_mutex_t sCborMarkMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/** Encode the value of an unsigned 64 bit variable.
+ *  Values beyond the range of a json-c integer are sent to CBOR clients
+ *  as a marked decimal string, which the encoder turns back into an
+ *  unsigned integer. JSON clients are given a double as before. */
+static struct json_object *psEncodeUnsigned(uint64_t u64Value)
+{
+    struct json_object *psJsonValue;
+    char acValue[24];
+    
+    if (u64Value <= INT64_MAX)
+    {
+        return psEncodeInteger((int64_t)u64Value);
+    }
+    if (!iCbor)
+    {
+        return json_object_new_double((double)u64Value);
+    }
+    
+    snprintf(acValue, sizeof(acValue), "%" PRIu64, u64Value);
+    psJsonValue = json_object_new_string(acValue);
+    
+    pthread_mutex_lock(&sCborMarkMutex);
+    eCborMarkUint(&sCbor, psJsonValue);
+    pthread_mutex_unlock(&sCborMarkMutex);
+    return psJsonValue;
+}
+
+
+/** Encode the value of a blob variable.
+ *  JSON clients are given a hex string. CBOR sends a byte string. */
+static struct json_object *psEncodeBlob(const uint8_t *pu8Data, uint32_t u32Length)
+{
+    struct json_object *psJsonValue;
+    char *pcHex;
+    
+    if (iCbor)
+    {
+        psJsonValue = json_object_new_string_len((const char *)pu8Data, u32Length);
+        
+        pthread_mutex_lock(&sCborMarkMutex);
+        eCborMarkBytes(&sCbor, psJsonValue);
+        pthread_mutex_unlock(&sCborMarkMutex);
+        return psJsonValue;
+    }
+    
+    if (eCodecFormatBlob(psArena, pu8Data, u32Length, &pcHex) != E_CODEC_OK)
+    {
+        return NULL;
+    }
+    psJsonValue = json_object_new_string(pcHex);
+    return psJsonValue;
+}
+
+
 /** Callback funtion to encode variable details */
 int json_encode_var (tsVar *psVar, void *pvUser)
 {
@@ -481,35 +897,35 @@ int json_encode_var (tsVar *psVar, void *pvUser)
     {
         if (strcmp(psVarAction->pcAction, "get") == 0)
         {
-            eStatus = eJIP_GetVar(&sJIP_Context, psVar);
+            eStatus = psLink ? eBrokerGetVar(psLink, psVar) : eJIP_GetVar(psJIP_Context, psVar);
                             
             if ((eStatus == E_JIP_OK) && psVar->pvData)
             {
                 switch (psVar->eVarType)
                 {
                     case(E_JIP_VAR_TYPE_INT8):
-                        psJsonVarValue = json_object_new_double((double)*(int8_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(int8_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_UINT8):
-                        psJsonVarValue = json_object_new_double((double)*(uint8_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(uint8_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_INT16):
-                        psJsonVarValue = json_object_new_double((double)*(int16_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(int16_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_UINT16):
-                        psJsonVarValue = json_object_new_double((double)*(uint16_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(uint16_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_INT32):
-                        psJsonVarValue = json_object_new_double((double)*(int32_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(int32_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_UINT32):
-                        psJsonVarValue = json_object_new_double((double)*(uint32_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(uint32_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_INT64):
-                        psJsonVarValue = json_object_new_double((double)*(int64_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeInteger(*(int64_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_UINT64):
-                        psJsonVarValue = json_object_new_double((double)*(uint64_t*)psVar->pvData);
+                        psJsonVarValue = psEncodeUnsigned(*(uint64_t*)psVar->pvData);
                         break;
                     case(E_JIP_VAR_TYPE_FLT):
                         psJsonVarValue = json_object_new_double((double)*(float*)psVar->pvData);
@@ -521,85 +937,36 @@ int json_encode_var (tsVar *psVar, void *pvUser)
                         psJsonVarValue = json_object_new_string((uint8_t*)psVar->pvData);
                         break;
                     case (E_JIP_VAR_TYPE_BLOB):
-                    {
-#if 1
-// Return blob as hex string for now.
-                        uint32_t i, u32Position = 0;
-                        char acCurrentValue[255];
-                        u32Position += sprintf(acCurrentValue, "0x");
-                        for (i = 0; i < psVar->u8Size; i++)
-                        {
-                            u32Position += sprintf(&acCurrentValue[u32Position], "%02x", ((uint8_t*)psVar->pvData)[i]);
-                        }
-                        psJsonVarValue = json_object_new_string(acCurrentValue);
-#else                   
-                        uint32_t i;
-                        psJsonVarValue = json_object_new_array();
-                        for (i = 0; i < psVar->u8Size; i++)
-                        {
-                            struct json_object* psJsonByte;
-                            psJsonByte = json_object_new_int(((uint8_t*)psVar->pvData)[i]);
-                            json_object_array_add (psJsonVarValue, psJsonByte);
-                        }
-#endif
+                        psJsonVarValue = psEncodeBlob((uint8_t*)psVar->pvData, psVar->u8Size);
                         break;
-                    }
                     case (E_JIP_VAR_TYPE_TABLE_BLOB):
                     {
                         tsTable *psTable;
                         tsTableRow *psTableRow;
                         psTable = (tsTable *)psVar->pvData;
-                        uint32_t u32CurrentValuePos = 0;
+                        char *pcCurrentValue;
                         int i;
-                        uint32_t u32CurrentValueLength = 255;
-                        uint8_t *pcCurrentValue = malloc(255);
-                        if (!pcCurrentValue)
-                        {
-                            psVarAction->sResult.iValue = E_JIP_ERROR_NO_MEM;
-                            psVarAction->sResult.pcDescription = pcJIP_strerror(psVarAction->sResult.iValue);
-                            return 0;
-                        }
-
-                        if (psTable->u32NumRows > 0)
+                        
+                        if (iCbor)
                         {
+                            /* Array of rows as byte strings, null for empty rows */
+                            psJsonVarValue = json_object_new_array();
                             for (i = 0; i < psTable->u32NumRows; i++)
                             {
                                 psTableRow = &psTable->psRows[i];
-                                if (psTableRow->pvData)
-                                {
-                                    uint32_t j;
-                                    uint8_t *pcNewCurrentValue;
-                                    
-                                    pcNewCurrentValue = realloc(pcCurrentValue, u32CurrentValueLength + psTableRow->u32Length);
-                                    
-                                    if (!pcNewCurrentValue)
-                                    {
-                                        psVarAction->sResult.iValue = E_JIP_ERROR_NO_MEM;
-                                        psVarAction->sResult.pcDescription = pcJIP_strerror(psVarAction->sResult.iValue);
-                                        return 0;
-                                    }
-                                    
-                                    pcCurrentValue = pcNewCurrentValue;
-                                    u32CurrentValueLength += psTableRow->u32Length;
-
-                                    u32CurrentValuePos += sprintf(&pcCurrentValue[u32CurrentValuePos], "%03d { 0x", i);
-                                    for (j = 0; j < psTableRow->u32Length; j++)
-                                    {
-                                        u32CurrentValuePos += sprintf(&pcCurrentValue[u32CurrentValuePos], "%02x", ((uint8_t*)psTableRow->pvData)[j]);
-                                    }
-                                    u32CurrentValuePos += sprintf(&pcCurrentValue[u32CurrentValuePos], " }\n");
-                                }
-                                else
-                                {
-                                    u32CurrentValuePos += sprintf(&pcCurrentValue[u32CurrentValuePos], "%03d { Empty Row }", i);
-                                }
+                                json_object_array_add(psJsonVarValue, psTableRow->pvData ?
+                                                      psEncodeBlob((uint8_t*)psTableRow->pvData, psTableRow->u32Length) : NULL);
                             }
-                            psJsonVarValue = json_object_new_string(pcCurrentValue);
+                            break;
                         }
-                        else
+                        
+                        if (eCodecFormatTable(psArena, psTable, &pcCurrentValue) != E_CODEC_OK)
                         {
-                            psJsonVarValue = json_object_new_string("Empty Table");
+                            psVarAction->sResult.iValue = E_JIP_ERROR_NO_MEM;
+                            psVarAction->sResult.pcDescription = pcJIP_strerror(psVarAction->sResult.iValue);
+                            return 0;
                         }
+                        psJsonVarValue = json_object_new_string(pcCurrentValue);
                         break;
                     }
                    default: 
@@ -634,12 +1001,11 @@ int set_var(tsVar *psVar, void *pvUser)
     tsMib *psMib;
     struct timeval tvBefore, tvAfter;
     char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
-    int supported   = 1;
-    int freeable    = 1;
     int is_multicast = 0;
     struct in6_addr node_addr;
     uint32_t u32Size = 0;
     char *buf = NULL;
+    const char *pcError;
     teJIP_Status eStatus;
     
     psMib = psVar->psOwnerMib;
@@ -661,222 +1027,266 @@ int set_var(tsVar *psVar, void *pvUser)
         }
     }
 
-    switch (psVar->eVarType)
+    switch (eCodecParseValue(psArena, psVar->eVarType, psVarAction->pcUpdateValue, (void **)&buf, &u32Size, &pcError))
     {
-        case (E_JIP_VAR_TYPE_INT8):
-        case (E_JIP_VAR_TYPE_UINT8):
-            buf = malloc(sizeof(uint8_t));
-            errno = 0;
-            buf[0] = strtoul(psVarAction->pcUpdateValue, NULL, 0);
-            if (errno)
-            {
-                SET_STATUS(E_JIP_ERROR_BAD_VALUE, "Could not convert string to 8 bit integer");
-                supported = 0;
-                break;
-            }
-            break;
-        
-        case (E_JIP_VAR_TYPE_INT16):
-        case (E_JIP_VAR_TYPE_UINT16):
-        {
-            uint16_t u16Var;
-            errno = 0;
-            u16Var = strtoul(psVarAction->pcUpdateValue, NULL, 0);
-            if (errno)
-            {
-                SET_STATUS(E_JIP_ERROR_BAD_VALUE, "Could not convert string to 16 bit integer");
-                supported = 0;
-                break;
-            }
-            buf = malloc(sizeof(uint16_t));
-            memcpy(buf, &u16Var, sizeof(uint16_t));
-            break;
-        }
-            
-        case (E_JIP_VAR_TYPE_INT32):
-        case (E_JIP_VAR_TYPE_UINT32):
-        {
-            uint32_t u32Var;
-            errno = 0;
-            u32Var = strtoul(psVarAction->pcUpdateValue, NULL, 0);
-            if (errno)
-            {
-                SET_STATUS(E_JIP_ERROR_BAD_VALUE, "Could not convert string to 32 bit integer");
-                supported = 0;
-                break;
-            }
-            buf = malloc(sizeof(uint32_t));
-            memcpy(buf, &u32Var, sizeof(uint32_t));
+        case (E_CODEC_OK):
             break;
-        }
         
-        case (E_JIP_VAR_TYPE_INT64):
-        case (E_JIP_VAR_TYPE_UINT64):
-        {
-            uint64_t u64Var;
-            errno = 0;
-            u64Var = strtoull(psVarAction->pcUpdateValue, NULL, 0);
-            if (errno)
-            {
-                SET_STATUS(E_JIP_ERROR_BAD_VALUE, "Could not convert string to 64 bit integer");
-                supported = 0;
-                break;
-            }
-            buf = malloc(sizeof(uint64_t));
-            memcpy(buf, &u64Var, sizeof(uint64_t));
-            break;
-        }
+        case (E_CODEC_UNSUPPORTED):
+            SET_STATUS(E_JIP_ERROR_FAILED, pcError);
+            return 1;
         
-        case (E_JIP_VAR_TYPE_FLT):
-        {
-            float f32Var;
-            errno = 0;
-            f32Var = strtof(psVarAction->pcUpdateValue, NULL);
-            if (errno)
-            {
-                SET_STATUS(E_JIP_ERROR_BAD_VALUE, "Could not convert string to float");
-                supported = 0;
-                break;
-            }
-            buf = malloc(sizeof(uint32_t));
-            memcpy(buf, &f32Var, sizeof(uint32_t));
-            break;
-        }
+        default:
+            SET_STATUS(E_JIP_ERROR_BAD_VALUE, pcError);
+            return 1;
+    }
+    
+    if (is_multicast)
+    {
+        tsJIPAddress MCastAddress;
+
+        memset (&MCastAddress, 0, sizeof(struct sockaddr_in6));
+        MCastAddress.sin6_family  = AF_INET6;
+        MCastAddress.sin6_port    = htons(JIP_DEFAULT_PORT);
+        MCastAddress.sin6_addr    = node_addr;
         
-        case (E_JIP_VAR_TYPE_DBL):
-        {
-            double d64Var;
-            errno = 0;
-            d64Var = strtod(psVarAction->pcUpdateValue, NULL);
-            if (errno)
-            {
-                SET_STATUS(E_JIP_ERROR_BAD_VALUE, "Could not convert string to double");
-                supported = 0;
-                break;
-            }
-            buf = malloc(sizeof(uint64_t));
-            memcpy(buf, &d64Var, sizeof(uint64_t));
-            break;
-        }
-            
-        case(E_JIP_VAR_TYPE_STR):
-        {
-            buf = (char *)psVarAction->pcUpdateValue;
-            u32Size = strlen(psVarAction->pcUpdateValue);
-            freeable = 0;
-            break;
-        }
-            
-        case(E_JIP_VAR_TYPE_BLOB):
+        eStatus = psLink ? eBrokerMulticastSetVar(psLink, psVar, buf, u32Size, &MCastAddress, 2) :
+                           eJIP_MulticastSetVar(psJIP_Context, psVar, buf, u32Size, &MCastAddress, 2);
+    }
+    else
+    {
+        eStatus = psLink ? eBrokerSetVar(psLink, psVar, buf, u32Size) : eJIP_SetVar(psJIP_Context, psVar, buf, u32Size);
+    }
+    SET_STATUS(eStatus, pcJIP_strerror(eStatus));
+    
+    if (eStatus == E_JIP_OK)
+    {
+        (void)eGroupModelSetVar(is_multicast ? &node_addr : &psNode->sNode_Address.sin6_addr, 
+                                psMib->pcName, psVar->pcName, psVar->eVarType, buf);
+    }
+    
+#undef SET_STATUS
+    return 1;
+}
+
+
+/** Encode the description of one node from the node model.
+ *  \param psJsonNodeList   Array to add the node to
+ *  \param psModel          Node model
+ *  \param psModelNode      Node to encode
+ *  \param iHeaderOnly      Non-zero to leave out the node's MiBs
+ */
+static void json_encode_model_node(struct json_object* psJsonNodeList, tsNetworkCacheModel *psModel,
+                                   const tsNetworkCacheNode *psModelNode, int iHeaderOnly)
+{
+    struct json_object* psJsonNode;
+    struct json_object* psJsonMibs;
+    uint32_t i, j;
+    char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
+    
+    inet_ntop(AF_INET6, &psModelNode->sAddress, buffer, INET6_ADDRSTRLEN);
+    
+    psJsonNode = json_object_new_object();
+    json_object_object_add (psJsonNode,
+                    "IPv6Address",
+                    json_object_new_string(buffer));
+    
+    json_object_object_add (psJsonNode,
+                    "DeviceID",
+                    json_object_new_int(psModelNode->u32DeviceId));
+    
+    if (psModelNode->u32Name)
+    {
+        json_object_object_add (psJsonNode,
+                        "Name",
+                        json_object_new_string(pcNetworkCacheModelString(psModel, psModelNode->u32Name)));
+    }
+    
+    json_object_array_add(psJsonNodeList, psJsonNode);
+    
+    if (iHeaderOnly)
+    {
+        /* Client fetches MiBs of the nodes it displays later */
+        return;
+    }
+    
+    psJsonMibs = json_object_new_array();
+    json_object_object_add (psJsonNode,
+                    "MiBs",
+                    psJsonMibs);
+    
+    for (i = 0; i < psModelNode->u32NumMibs; i++)
+    {
+        const tsNetworkCacheMib *psModelMib = &psModel->psMibs[psModelNode->u32FirstMib + i];
+        struct json_object* psJsonMib;
+        struct json_object* psJsonVars;
+        
+        psJsonMib = json_object_new_object();
+        json_object_object_add (psJsonMib,
+                        "ID",
+                        json_object_new_int(psModelMib->u32MibId));
+        
+        json_object_object_add (psJsonMib,
+                        "Name",
+                        json_object_new_string(pcNetworkCacheModelString(psModel, psModelMib->u32Name)));
+        
+        json_object_array_add(psJsonMibs, psJsonMib);
+        
+        psJsonVars = json_object_new_array();
+        json_object_object_add (psJsonMib,
+                        "Vars",
+                        psJsonVars);
+        
+        for (j = 0; j < psModelMib->u32NumVars; j++)
         {
-            int i, j;
-            buf = malloc(strlen(psVarAction->pcUpdateValue));
-            memset(buf, 0, strlen(psVarAction->pcUpdateValue));
-            if (strncmp(psVarAction->pcUpdateValue, "0x", 2) == 0)
-            {
-                psVarAction->pcUpdateValue += 2;
-            }
-            u32Size = 0;
-            for (i = 0, j = 0; (i < strlen(psVarAction->pcUpdateValue)) && supported; i++)
-            {
-                uint8_t u8Nibble = 0;
-                if ((psVarAction->pcUpdateValue[i] >= '0') && (psVarAction->pcUpdateValue[i] <= '9'))
-                {
-                    u8Nibble = psVarAction->pcUpdateValue[i]-'0';
-                }
-                else if ((psVarAction->pcUpdateValue[i] >= 'a') && (psVarAction->pcUpdateValue[i] <= 'f'))
-                {
-                    u8Nibble = psVarAction->pcUpdateValue[i]-'a' + 0x0A;
-                }
-                else if ((psVarAction->pcUpdateValue[i] >= 'A') && (psVarAction->pcUpdateValue[i] <= 'F'))
-                {
-                    u8Nibble = psVarAction->pcUpdateValue[i]-'A' + 0x0A;
-                }
-                else
-                {
-                    SET_STATUS(E_JIP_ERROR_BAD_VALUE, "String contains illegal hexadecimal characters");
-                    supported = 0;
-                    break;
-                }
-                    
-                if ((u32Size & 0x01) == 0)
-                {
-                    // Even numbered byte
-                    buf[j] = u8Nibble << 4;
-                }
-                else
-                {
-                    buf[j] |= u8Nibble & 0x0F;
-                    j++;
-                }
-                u32Size++;
-            }
-            if (u32Size & 0x01)
-            {
-                // Odd length string
-                u32Size = (u32Size >> 1) + 1;
-            }
-            else
-            {
-                u32Size = u32Size >> 1;
-            }
+            const tsNetworkCacheVar *psModelVar = &psModel->psVars[psModelMib->u32FirstVar + j];
+            struct json_object* psJsonVar;
             
-            break;
+            psJsonVar = json_object_new_object();
+            json_object_object_add (psJsonVar,
+                            "Name",
+                            json_object_new_string(pcNetworkCacheModelString(psModel, psModelVar->u32Name)));
+            
+            json_object_object_add (psJsonVar,
+                            "Index",
+                            json_object_new_int(psModelVar->u8Index));
+            
+            json_object_object_add (psJsonVar,
+                            "Type",
+                            json_object_new_int(psModelVar->u8VarType));
+            
+            json_object_object_add (psJsonVar,
+                            "AccessType",
+                            json_object_new_int(psModelVar->u8AccessType));
+            
+            json_object_object_add (psJsonVar,
+                            "Security",
+                            json_object_new_int(psModelVar->u8Security));
+            
+            json_object_array_add(psJsonVars, psJsonVar);
         }
-        
-        default:
-            supported = 0;
+    }
+}
+
+
+/** Encode the nodes that changed since a version of the network the client holds.
+ *  Changed and added nodes are sent in Nodes, removed nodes in Removed.
+ *  \return non-zero on success, 0 if the changelog does not go back far
+ *          enough and the whole network has to be sent. */
+static int json_encode_model_delta(struct json_object* psJsonNetwork, struct json_object* psJsonNodeList, 
+                                   tsNetworkCacheModel *psModel, const char *pcSince, int iHeaderOnly)
+{
+    struct json_object* psJsonRemoved;
+    struct in6_addr *asAddresses;
+    uint32_t u32NumAddresses;
+    uint32_t u32Since;
+    char *pcEnd;
+    uint32_t i;
+    
+    errno = 0;
+    u32Since = strtoul(pcSince, &pcEnd, 0);
+    if ((errno) || (*pcEnd != '\0'))
+    {
+        return 0;
     }
     
-    if (supported)
+    if (eNetworkCacheChanges(psModel, u32Since, &asAddresses, &u32NumAddresses) != E_NETWORK_CACHE_OK)
     {
-        if (is_multicast)
+        return 0;
+    }
+    
+    psJsonRemoved = json_object_new_array();
+    for (i = 0; i < u32NumAddresses; i++)
+    {
+        const tsNetworkCacheNode *psModelNode = psNetworkCacheModelLookupNode(psModel, &asAddresses[i]);
+        
+        if (psModelNode)
         {
-            tsJIPAddress MCastAddress;
-
-            memset (&MCastAddress, 0, sizeof(struct sockaddr_in6));
-            MCastAddress.sin6_family  = AF_INET6;
-            MCastAddress.sin6_port    = htons(JIP_DEFAULT_PORT);
-            MCastAddress.sin6_addr    = node_addr;
-            
-            eStatus = eJIP_MulticastSetVar(&sJIP_Context, psVar, buf, u32Size, &MCastAddress, 2);
+            json_encode_model_node(psJsonNodeList, psModel, psModelNode, iHeaderOnly);
         }
         else
         {
-            eStatus = eJIP_SetVar(&sJIP_Context, psVar, buf, u32Size);
+            char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
+            
+            inet_ntop(AF_INET6, &asAddresses[i], buffer, INET6_ADDRSTRLEN);
+            json_object_array_add(psJsonRemoved, json_object_new_string(buffer));
         }
-        SET_STATUS(eStatus, pcJIP_strerror(eStatus));
-    }
-    else
-    {
-        SET_STATUS(E_JIP_ERROR_FAILED, "Variable type not supported");
     }
+    free(asAddresses);
     
-    if (freeable)
-    {
-        free(buf);
-    }
-#undef SET_STATUS
+    json_object_object_add (psJsonNetwork,
+                            "Delta",
+                            json_object_new_boolean(1));
+    json_object_object_add (psJsonNetwork,
+                            "Removed",
+                            psJsonRemoved);
     return 1;
 }
 
 
-/** Command handler for discovering network */
-static tsResult cmd_discoverNetwork(struct json_object* psJsonNetwork)
+/** Command handler for discovering network.
+ *  depth=nodes returns only the node headers. filter_ipv6 restricts the
+ *  response to a single node, so that clients can fetch MiBs on demand.
+ *  since=<version> returns only the nodes that changed after that version,
+ *  if the changelog still covers it. Version is the version of the response. */
+static tsResult cmd_discoverNetwork(struct json_object* psJsonNetwork, tsNetworkCacheModel *psModel, const char *pcDepth, const char *pcSince)
 {
     struct json_object* psJsonNodeList;
-    psJsonNodeList = json_object_new_array();
     tsResult sResult;
-    tsVarAction sVarAction;
-    sVarAction.pcAction = "discover";
-
-    jip_iterate(json_encode_node, psJsonNodeList, json_encode_mib, NULL, json_encode_var, &sVarAction);
+    int iHeaderOnly = 0;
+    uint32_t i;
+    
+    if (pcDepth)
+    {
+        if (strcasecmp(pcDepth, "nodes") == 0)
+        {
+            iHeaderOnly = 1;
+        }
+        else if (strcasecmp(pcDepth, "full") != 0)
+        {
+            SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Unknown depth");
+            return sResult;
+        }
+    }
     
+    json_object_object_add (psJsonNetwork,
+                            "Version",
+                            json_object_new_int64(psModel->psHeader->u32Version));
+    
+    psJsonNodeList = json_object_new_array();
     json_object_object_add (psJsonNetwork,
                             "Nodes",
                             psJsonNodeList);
+    
+    if (filter_ipv6)
+    {
+        const tsNetworkCacheNode *psModelNode;
+        struct in6_addr node_addr;
+        
+        if (inet_pton(AF_INET6, filter_ipv6, &node_addr) != 1)
+        {
+            SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Invalid IPv6 address");
+            return sResult;
+        }
+        
+        psModelNode = psNetworkCacheModelLookupNode(psModel, &node_addr);
+        if (!psModelNode)
+        {
+            SET_RESULT(E_JIP_ERROR_FAILED, "Node not found");
+            return sResult;
+        }
+        json_encode_model_node(psJsonNodeList, psModel, psModelNode, iHeaderOnly);
+    }
+    else if ((!pcSince) || (!json_encode_model_delta(psJsonNetwork, psJsonNodeList, psModel, pcSince, iHeaderOnly)))
+    {
+        for (i = 0; i < psModel->psHeader->u32NumNodes; i++)
+        {
+            json_encode_model_node(psJsonNodeList, psModel, &psModel->psNodes[i], iHeaderOnly);
+        }
+    }
 
-    return  sVarAction.sResult;
+    SET_RESULT(E_JIP_OK, pcJIP_strerror(E_JIP_OK));
+    return  sResult;
 }
 
 
@@ -902,7 +1312,7 @@ static tsResult cmd_getVar(struct json_object* psJsonNetwork)
 
 
 /** Command handler for set var */
-static tsResult cmd_setVar(char *pcUpdateValue)
+static tsResult cmd_setVar(const char *pcUpdateValue)
 {
     tsVarAction sVarAction;
     sVarAction.pcAction = "set";
@@ -916,6 +1326,439 @@ static tsResult cmd_setVar(char *pcUpdateValue)
 }
 
 
+/** Command handler for requests to every border router.
+ *  The border routers are connected to concurrently, and their networks
+ *  merged with each node tagged by the border router that owns it.
+ *  Variable requests for a unicast address only go to the owning border
+ *  router. Multicast requests go to all of them.
+ *  \param psJsonNetwork    Object to add the merged network to
+ *  \param pcAction         discover, GetVar or SetVar
+ *  \param eRefresh         Refresh policy for the network snapshot
+ *  \param pcUpdateValue    Value to set for SetVar
+ *  \param piAge            Pointer to location to store the age of the oldest network
+ */
+static tsResult cmd_aggregate(struct json_object* psJsonNetwork, const char *pcAction, teNetworkCacheRefresh eRefresh, char *pcUpdateValue, int *piAge)
+{
+    static const char *pcNotFound = "Node not found";
+    tsBRSet sBRSet;
+    tsBRSetMember *psOwner = NULL;
+    struct json_object* psJsonBRList;
+    struct json_object* psJsonNodeList = NULL;
+    tsResult sResult;
+    int iDiscover, iGet, iSet;
+    uint32_t i;
+    
+    *piAge = 0;
+    
+    iDiscover   = (strcasecmp(pcAction, "discover") == 0);
+    iGet        = (strcasecmp(pcAction, "GetVar") == 0);
+    iSet        = (strcasecmp(pcAction, "SetVar") == 0);
+    if (!(iDiscover || iGet || iSet))
+    {
+        SET_RESULT(E_JIP_ERROR_FAILED, "Unknown action");
+        return sResult;
+    }
+    
+    if (eBRSetOpen(&sBRSet, eRefresh) != E_BR_SET_OK)
+    {
+        SET_RESULT(E_CGI_ERROR, "Failed to find gateway address via Zeroconf");
+        return sResult;
+    }
+    
+    if ((!iDiscover) && (filter_ipv6) && (strncasecmp(filter_ipv6, "FF", 2) != 0))
+    {
+        struct in6_addr sNodeAddress;
+        
+        if (inet_pton(AF_INET6, filter_ipv6, &sNodeAddress) != 1)
+        {
+            vBRSetClose(&sBRSet);
+            SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Invalid IPv6 address");
+            return sResult;
+        }
+        
+        psOwner = psBRSetLookupNode(&sBRSet, &sNodeAddress);
+        if (!psOwner)
+        {
+            vBRSetClose(&sBRSet);
+            SET_RESULT(E_JIP_ERROR_FAILED, pcNotFound);
+            return sResult;
+        }
+    }
+    
+    psJsonBRList = json_object_new_array();
+    json_object_object_add (psJsonNetwork,
+                            "BorderRouters",
+                            psJsonBRList);
+    
+    if (!iSet)
+    {
+        psJsonNodeList = json_object_new_array();
+        json_object_object_add (psJsonNetwork,
+                                "Nodes",
+                                psJsonNodeList);
+    }
+    
+    SET_RESULT(E_JIP_ERROR_FAILED, pcNotFound);
+    
+    for (i = 0; i < sBRSet.u32NumMembers; i++)
+    {
+        tsBRSetMember *psMember = &sBRSet.psMembers[i];
+        struct json_object* psJsonBR;
+        tsVarAction sVarAction;
+        
+        psJsonBR = json_object_new_object();
+        json_object_object_add (psJsonBR,
+                                "Address",
+                                json_object_new_string(psMember->acAddress));
+        json_object_object_add (psJsonBR,
+                                "Status",
+                                json_object_new_int(psMember->eStatus));
+        json_object_object_add (psJsonBR,
+                                "Age",
+                                json_object_new_int(psMember->iAge));
+        json_object_array_add(psJsonBRList, psJsonBR);
+        
+        if (psMember->eStatus != E_JIP_OK)
+        {
+            continue;
+        }
+        if (psMember->iAge > *piAge)
+        {
+            *piAge = psMember->iAge;
+        }
+        if ((psOwner) && (psOwner != psMember))
+        {
+            continue;
+        }
+        
+        psJIP_Context   = &psMember->sJIP_Context;
+        pcBorderRouter  = psMember->acAddress;
+        
+        if (iDiscover)
+        {
+            jip_iterate(json_encode_node, psJsonNodeList, json_encode_mib, NULL, json_encode_var, NULL);
+            SET_RESULT(E_JIP_OK, "Success");
+            continue;
+        }
+        
+        sVarAction.pcAction = iGet ? "get" : "set";
+        sVarAction.pcUpdateValue = pcUpdateValue;
+        sVarAction.sResult.iValue = E_JIP_ERROR_FAILED;
+        sVarAction.sResult.pcDescription = pcNotFound;
+        
+        if (iGet)
+        {
+            jip_iterate(json_encode_node, psJsonNodeList, json_encode_mib, NULL, json_encode_var, &sVarAction);
+        }
+        else
+        {
+            jip_iterate(NULL, NULL, NULL, NULL, set_var, &sVarAction);
+        }
+        
+        if (sVarAction.sResult.pcDescription == pcNotFound)
+        {
+            /* None of this border router's nodes matched */
+            continue;
+        }
+        
+        /* Report the first failure, otherwise success */
+        if ((sResult.iValue == E_JIP_OK) || (sResult.pcDescription == pcNotFound))
+        {
+            sResult = sVarAction.sResult;
+        }
+    }
+    
+    psJIP_Context   = &sJIP_Context;
+    pcBorderRouter  = NULL;
+    vBRSetClose(&sBRSet);
+    return sResult;
+}
+
+
+/** One request of a batch */
+typedef struct
+{
+    const char         *pcAction;       /**< GetVar or SetVar */
+    const char         *pcNodeAddress;  /**< Address of the node */
+    const char         *pcMib;          /**< MiB name or ID */
+    const char         *pcVar;          /**< Variable name or index */
+    const char         *pcValue;        /**< Value to set */
+    struct in6_addr     sAddress;       /**< Parsed address of the node */
+    int                 iNext;          /**< Index of the next request for the same node, or -1 */
+    struct json_object *psJsonResult;   /**< Result, in the same form as the response to a single request */
+} tsBatchRequest;
+
+
+/** Batch of requests being executed */
+typedef struct
+{
+    const char         *pcBRAddress;    /**< Border router the requests are for */
+    tsBatchRequest     *psRequests;     /**< Requests in the order they were made */
+    int                 aiFirst[BATCH_MAX_REQUESTS]; /**< First request for each node */
+    int                 iNumNodes;      /**< Number of nodes in aiFirst */
+    int                 iNextNode;      /**< Next node to be taken by a thread */
+    pthread_mutex_t     sMutex;         /**< Protects iNextNode */
+} tsBatch;
+
+
+/** Execute one request of a batch on the calling thread */
+static void vBatchExecute(const char *pcBRAddress, tsBatchRequest *psRequest)
+{
+    struct json_object* psJsonStatus;
+    struct json_object* psJsonNetwork = NULL;
+    tsCoalesceReply sReply;
+    teCoalesceStatus eCoalesceStatus = E_COALESCE_NO_SERVER;
+    tsResult sResult;
+    
+    filter_ipv6 = psRequest->pcNodeAddress;
+    filter_mib  = psRequest->pcMib;
+    filter_var  = psRequest->pcVar;
+    
+    if (strcasecmp(psRequest->pcAction, "GetVar") == 0)
+    {
+        psJsonNetwork = json_object_new_object();
+        sResult = cmd_getVar(psJsonNetwork);
+    }
+    else if ((strcasecmp(psRequest->pcAction, "SetVar") == 0) && (psRequest->pcValue))
+    {
+        /* Unicast SetVars are coalesced by JIPd, as when made on their own */
+        if ((psRequest->pcNodeAddress) && (psRequest->pcMib) && (psRequest->pcVar) &&
+            (!IN6_IS_ADDR_MULTICAST(&psRequest->sAddress)))
+        {
+            eCoalesceStatus = eCoalesceSetVar(pcBRAddress, psRequest->pcNodeAddress, psRequest->pcMib, psRequest->pcVar,
+                                              psRequest->pcValue, &sReply);
+        }
+        
+        if (eCoalesceStatus == E_COALESCE_OK)
+        {
+            SET_RESULT(sReply.i32Status, sReply.acDescription);
+        }
+        else if (eCoalesceStatus == E_COALESCE_ERROR)
+        {
+            /* JIPd may already have made it - don't repeat it out of order */
+            SET_RESULT(E_JIP_ERROR_FAILED, "No answer from JIPd");
+        }
+        else
+        {
+            sResult = cmd_setVar(psRequest->pcValue);
+        }
+    }
+    else
+    {
+        SET_RESULT(E_JIP_ERROR_FAILED, "Unknown action");
+    }
+    
+    psJsonStatus = json_object_new_object();
+    json_object_object_add (psJsonStatus,
+                            "Value",
+                            json_object_new_int(sResult.iValue));
+    json_object_object_add (psJsonStatus,
+                            "Description",
+                            json_object_new_string(sResult.pcDescription));
+    json_object_object_add (psRequest->psJsonResult,
+                            "Status",
+                            psJsonStatus);
+    if (psJsonNetwork)
+    {
+        json_object_object_add (psRequest->psJsonResult,
+                                "Network",
+                                psJsonNetwork);
+    }
+}
+
+
+/** Thread that takes nodes from a batch and executes their requests in order until there are none left */
+static void *pvBatchThread(void *pvBatch)
+{
+    tsBatch *psBatch = (tsBatch *)pvBatch;
+    tsArena *psRequestArena = psArena;
+    tsArena sThreadArena;
+    
+    vArenaInit(&sThreadArena);
+    psArena = &sThreadArena;
+    
+    for (;;)
+    {
+        int iNode, i;
+        
+        pthread_mutex_lock(&psBatch->sMutex);
+        iNode = psBatch->iNextNode++;
+        pthread_mutex_unlock(&psBatch->sMutex);
+        
+        if (iNode >= psBatch->iNumNodes)
+        {
+            break;
+        }
+        
+        for (i = psBatch->aiFirst[iNode]; i >= 0; i = psBatch->psRequests[i].iNext)
+        {
+            vBatchExecute(psBatch->pcBRAddress, &psBatch->psRequests[i]);
+        }
+    }
+    
+    vArenaFree(&sThreadArena);
+    psArena = psRequestArena;
+    return NULL;
+}
+
+
+/** Command handler for a batch of GetVar and SetVar requests.
+ *  Requests for different nodes are executed concurrently. Requests for the
+ *  same node are executed in the order they were made. A batch containing a
+ *  multicast request is executed in order, on one thread.
+ *  \param psJsonResult     Object to add the array of Results to, one per request
+ *  \param pcBRAddress      Border router the requests are for
+ *  \param pcRequests       JSON array of requests, each with action, nodeaddress, mib, var and value
+ */
+static tsResult cmd_batch(struct json_object* psJsonResult, const char *pcBRAddress, const char *pcRequests)
+{
+    struct json_object* psJsonRequests;
+    struct json_object* psJsonResults;
+    tsBatch sBatch;
+    pthread_t asThreads[BATCH_MAX_THREADS - 1];
+    int iNumRequests, iNumThreads, iSerial = 0;
+    int i, j;
+    tsResult sResult;
+    
+    if (!pcRequests)
+    {
+        SET_RESULT(E_JIP_ERROR_FAILED, "No requests");
+        return sResult;
+    }
+    
+    psJsonRequests = json_tokener_parse(pcRequests);
+    if ((!psJsonRequests) || (!json_object_is_type(psJsonRequests, json_type_array)))
+    {
+        if (psJsonRequests)
+        {
+            json_object_put(psJsonRequests);
+        }
+        SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Requests are not a JSON array");
+        return sResult;
+    }
+    
+    iNumRequests = json_object_array_length(psJsonRequests);
+    if (iNumRequests > BATCH_MAX_REQUESTS)
+    {
+        json_object_put(psJsonRequests);
+        SET_RESULT(E_JIP_ERROR_BAD_VALUE, "Too many requests in batch");
+        return sResult;
+    }
+    
+    memset(&sBatch, 0, sizeof(tsBatch));
+    sBatch.pcBRAddress = pcBRAddress;
+    sBatch.psRequests = calloc(iNumRequests ? iNumRequests : 1, sizeof(tsBatchRequest));
+    if (!sBatch.psRequests)
+    {
+        json_object_put(psJsonRequests);
+        SET_RESULT(E_JIP_ERROR_NO_MEM, pcJIP_strerror(E_JIP_ERROR_NO_MEM));
+        return sResult;
+    }
+    
+    psJsonResults = json_object_new_array();
+    json_object_object_add (psJsonResult,
+                            "Results",
+                            psJsonResults);
+    
+    for (i = 0; i < iNumRequests; i++)
+    {
+        struct json_object* psJsonRequest = json_object_array_get_idx(psJsonRequests, i);
+        tsBatchRequest *psRequest = &sBatch.psRequests[i];
+        
+#define BATCH_FIELD(n) \
+        ((json_object_object_get(psJsonRequest, n)) ? json_object_get_string(json_object_object_get(psJsonRequest, n)) : NULL)
+        
+        psRequest->pcAction       = "";
+        psRequest->iNext          = -1;
+        psRequest->psJsonResult   = json_object_new_object();
+        json_object_array_add(psJsonResults, psRequest->psJsonResult);
+        
+        if ((psJsonRequest) && (json_object_is_type(psJsonRequest, json_type_object)))
+        {
+            psRequest->pcAction       = BATCH_FIELD("action");
+            psRequest->pcNodeAddress  = BATCH_FIELD("nodeaddress");
+            psRequest->pcMib          = BATCH_FIELD("mib");
+            psRequest->pcVar          = BATCH_FIELD("var");
+            psRequest->pcValue        = BATCH_FIELD("value");
+            if (!psRequest->pcAction)
+            {
+                psRequest->pcAction = "";
+            }
+        }
+#undef BATCH_FIELD
+        
+        if ((!psRequest->pcNodeAddress) || 
+            (inet_pton(AF_INET6, psRequest->pcNodeAddress, &psRequest->sAddress) != 1) ||
+            (IN6_IS_ADDR_MULTICAST(&psRequest->sAddress)))
+        {
+            /* May touch any node, so cannot be run alongside the others */
+            iSerial = 1;
+        }
+    }
+    
+    /* Chain the requests for each node together, in order */
+    for (i = 0; i < iNumRequests; i++)
+    {
+        int iLast;
+        
+        for (j = 0; (j < sBatch.iNumNodes) && (!iSerial); j++)
+        {
+            if (memcmp(&sBatch.psRequests[sBatch.aiFirst[j]].sAddress, &sBatch.psRequests[i].sAddress, sizeof(struct in6_addr)) == 0)
+            {
+                break;
+            }
+        }
+        if ((j == sBatch.iNumNodes) && ((!iSerial) || (sBatch.iNumNodes == 0)))
+        {
+            sBatch.aiFirst[sBatch.iNumNodes++] = i;
+            continue;
+        }
+        
+        iLast = sBatch.aiFirst[iSerial ? 0 : j];
+        while (sBatch.psRequests[iLast].iNext >= 0)
+        {
+            iLast = sBatch.psRequests[iLast].iNext;
+        }
+        sBatch.psRequests[iLast].iNext = i;
+    }
+    
+    pthread_mutex_init(&sBatch.sMutex, NULL);
+    
+    /* This thread works through the nodes too */
+    iNumThreads = sBatch.iNumNodes - 1;
+    if (iNumThreads > BATCH_MAX_THREADS - 1)
+    {
+        iNumThreads = BATCH_MAX_THREADS - 1;
+    }
+    for (i = 0; i < iNumThreads; i++)
+    {
+        if (pthread_create(&asThreads[i], NULL, pvBatchThread, &sBatch) != 0)
+        {
+            break;
+        }
+    }
+    iNumThreads = i;
+    
+    (void)pvBatchThread(&sBatch);
+    
+    for (i = 0; i < iNumThreads; i++)
+    {
+        pthread_join(asThreads[i], NULL);
+    }
+    pthread_mutex_destroy(&sBatch.sMutex);
+    
+    /* The strings in the requests belong to psJsonRequests */
+    filter_ipv6 = NULL;
+    filter_mib = NULL;
+    filter_var = NULL;
+    free(sBatch.psRequests);
+    json_object_put(psJsonRequests);
+    
+    SET_RESULT(E_JIP_OK, "Success");
+    return sResult;
+}
+
+
 /** General purpose function to iterate over the known devices,
  *  filtering on known items and call function callbacks as
  *  required for each node / mib / variable that matches.
@@ -938,6 +1781,10 @@ static int jip_iterate(tprCbNode prCbNode,   void *pvNodeUser,
     uint32_t        u32NumNodes = 0;
     uint32_t        NodeIndex;
     uint32_t        Device_ID;
+    uint32_t        u32MibId = 0;
+    uint32_t        u32VarIndex = 0;
+    int             iMibById = 0;
+    int             iVarById = 0;
     struct in6_addr node_addr;
     int is_multicast = 0;
     
@@ -976,7 +1823,37 @@ static int jip_iterate(tprCbNode prCbNode,   void *pvNodeUser,
         Device_ID = JIP_DEVICEID_ALL;
     }
     
-    if (eJIP_GetNodeAddressList(&sJIP_Context, Device_ID, &NodeAddressList, &u32NumNodes) != E_JIP_OK)
+    /* Parse the MiB and Var filters once, before any node is locked, so that
+     * a bad one cannot return with a node still held */
+    if (filter_mib)
+    {
+        char *pcEnd;
+        errno = 0;
+        u32MibId = strtoul(filter_mib, &pcEnd, 0);
+        if (errno)
+        {
+            fprintf(stderr, "MiB ID '%s' cannot be converted to 32 bit integer (%s)\n\r", filter_mib, strerror(errno));
+            return 0;
+        }
+        /* Whole string has been converted - must be a legit number */
+        iMibById = (pcEnd != filter_mib) && (*pcEnd == '\0');
+    }
+    
+    if (filter_var)
+    {
+        char *pcEnd;
+        errno = 0;
+        u32VarIndex = strtoul(filter_var, &pcEnd, 0);
+        if ((errno) || ((u32VarIndex > 0x000000FF) ? (errno=ERANGE) : (errno=0)))
+        {
+            fprintf(stderr, "Var Index '%s' cannot be converted to 8 bit integer (%s)\n\r", filter_var, strerror(errno));
+            return 0;
+        }
+        /* Whole string has been converted - must be a legit number */
+        iVarById = (pcEnd != filter_var) && (*pcEnd == '\0');
+    }
+    
+    if (eJIP_GetNodeAddressList(psJIP_Context, Device_ID, &NodeAddressList, &u32NumNodes) != E_JIP_OK)
     {
         fprintf(stderr, "Error reading node list\n");
         return 0;
@@ -984,27 +1861,24 @@ static int jip_iterate(tprCbNode prCbNode,   void *pvNodeUser,
 
     for (NodeIndex = 0; NodeIndex < u32NumNodes; NodeIndex++)
     {
-        psNode = psJIP_LookupNode(&sJIP_Context, &NodeAddressList[NodeIndex]);
+        if ((filter_ipv6) && (!is_multicast))
+        {
+            /* Filter on IPv6 address before locking the node, so as not to
+             * wait for another thread that has a different node locked */
+            if (memcmp(&NodeAddressList[NodeIndex].sin6_addr, &node_addr, sizeof(struct in6_addr)) != 0)
+            {
+                /* Not the node we want */
+                continue;
+            }
+        }
+        
+        psNode = psJIP_LookupNode(psJIP_Context, &NodeAddressList[NodeIndex]);
         if (!psNode)
         {
             fprintf(stderr, "Node has been removed\n");
             continue;
         }
 
-        if (filter_ipv6)
-        {
-            if (!is_multicast)
-            {
-                /* Filter on IPv6 address */
-                if (memcmp(&psNode->sNode_Address.sin6_addr, &node_addr, sizeof(struct in6_addr)) != 0)
-                {
-                    /* Not the node we want */
-                    eJIP_UnlockNode(psNode);
-                    continue;
-                }
-            }
-        }
-
         if (prCbNode)
         {
             /* Call node callback */
@@ -1020,20 +1894,8 @@ static int jip_iterate(tprCbNode prCbNode,   void *pvNodeUser,
         {
             if (filter_mib)
             {
-                char *pcEnd;
-                uint32_t u32MibId;
-                
                 /* Filtering on MiB */
-
-                errno = 0;
-                u32MibId = strtoul(filter_mib, &pcEnd, 0);
-                if (errno)
-                {
-                    fprintf(stderr, "MiB ID '%s' cannot be converted to 32 bit integer (%s)\n\r", filter_mib, strerror(errno));
-                    return 0;
-                }
-
-                if ((pcEnd != filter_mib) && (*pcEnd == '\0')) /* Whole string has been converted - must be a legit number */
+                if (iMibById)
                 {
                     if (u32MibId != psMib->u32MibId)
                     {
@@ -1066,20 +1928,8 @@ static int jip_iterate(tprCbNode prCbNode,   void *pvNodeUser,
             {
                 if (filter_var)
                 {
-                    char *pcEnd;
-                    uint32_t u32VarIndex;
-                    
                     /* Filtering on Var */
-
-                    errno = 0;
-                    u32VarIndex = strtoul(filter_var, &pcEnd, 0);
-                    if ((errno) || ((u32VarIndex > 0x000000FF) ? (errno=ERANGE) : (errno=0)))
-                    {
-                        fprintf(stderr, "Var Index '%s' cannot be converted to 8 bit integer (%s)\n\r", filter_var, strerror(errno));
-                        return 0;
-                    }
-
-                    if ((pcEnd != filter_var) && (*pcEnd == '\0')) /* Whole string has been converted - must be a legit number */
+                    if (iVarById)
                     {
                         if (u32VarIndex != psVar->u8Index)
                         {
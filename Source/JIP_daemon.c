@@ -0,0 +1,367 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          JIP daemon
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <Zeroconf.h> 
+#include <JIP.h>
+
+#include "Broker.h"
+#include "Coalesce.h"
+#include "GroupModel.h"
+#include "NetworkCache.h"
+#include "History.h"
+#include "Scheduler.h"
+#include "SmartDevicesConfig.h"
+
+#ifndef VERSION
+#error Version is not defined!
+#else
+const char *Version = "0.1 (r" VERSION ")";
+#endif
+
+static tsJIP_Context sJIP_Context;
+
+static tsScheduler sScheduler;
+
+static tsCoalescer sCoalescer;
+static tsBroker sBroker;
+
+static tsHistorySampler sSampler;
+
+
+static void print_usage_exit(char *argv[])
+{
+    fprintf(stderr, "JIPd Version: %s\n", Version);
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "  Options:\n");
+    fprintf(stderr, "    -h               Print this help.\n");
+    fprintf(stderr, "    -b <address>     IPv6 address of the border router. Found via Zeroconf if not given.\n");
+    fprintf(stderr, "    -i <seconds>     Shortest interval between network refreshes. Default %d.\n", SCHEDULER_DEFAULT_MIN_INTERVAL);
+    fprintf(stderr, "    -m <seconds>     Longest interval between network refreshes. Default %d.\n", SCHEDULER_DEFAULT_MAX_INTERVAL);
+    fprintf(stderr, "    -w <ms>          Time a SetVar waits for a newer value of the same variable. Default %d.\n", COALESCE_DEFAULT_WINDOW);
+    fprintf(stderr, "    -t <seconds>     Interval between samples of watched variables. Default %d, 0 to keep no history.\n", HISTORY_DEFAULT_INTERVAL);
+    fprintf(stderr, "    -H <mib>/<var>   Keep the history of a variable on every node that has it. May be repeated.\n");
+    fprintf(stderr, "  The state of the groups in %s is tracked after each refresh.\n", CONFIG_FILE_NAME);
+    fprintf(stderr, "  The history of its feedback variables is kept in %s.\n", HISTORY_FILE_NAME);
+    fprintf(stderr, "  Send SIGHUP to refresh the network immediately.\n");
+    exit(EXIT_FAILURE);
+}
+
+
+/** Find the address of the one border router on the network via Zeroconf */
+static char *pcFindBorderRouter(void)
+{
+    int iNumAddresses;
+    struct in6_addr *asAddresses;
+    char *pcAddress = NULL;
+    
+    if (ZC_Get_Module_Addresses(&asAddresses, &iNumAddresses) != 0)
+    {
+        fprintf(stderr, "Could not get coordinator address\n");
+        return NULL;
+    }
+    
+    if (iNumAddresses != 1)
+    {
+        fprintf(stderr, "Discovered an unhandled number of coordinators (%d)\n", iNumAddresses);
+    }
+    else
+    {
+        char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
+        inet_ntop(AF_INET6, asAddresses, buffer, INET6_ADDRSTRLEN);
+        pcAddress = strdup(buffer);
+    }
+    free(asAddresses);
+    return pcAddress;
+}
+
+
+/** Add a variable to the watch list, unless it is already on it. \return non-zero on success */
+static int iAddWatch(tsHistoryWatch *asWatches, uint32_t *pu32NumWatches, const char *pcMib, const char *pcVar)
+{
+    uint32_t i;
+    
+    if ((!pcMib) || (!pcVar) || (strlen(pcMib) >= HISTORY_MAX_NAME) || (strlen(pcVar) >= HISTORY_MAX_NAME))
+    {
+        return 0;
+    }
+    for (i = 0; i < *pu32NumWatches; i++)
+    {
+        if ((strcmp(asWatches[i].acMib, pcMib) == 0) && (strcmp(asWatches[i].acVar, pcVar) == 0))
+        {
+            return 1;
+        }
+    }
+    if (*pu32NumWatches >= HISTORY_MAX_WATCHES)
+    {
+        fprintf(stderr, "Too many watched variables, not keeping history of %s/%s\n", pcMib, pcVar);
+        return 0;
+    }
+    strcpy(asWatches[i].acMib, pcMib);
+    strcpy(asWatches[i].acVar, pcVar);
+    (*pu32NumWatches)++;
+    return 1;
+}
+
+
+/** Watch the feedback variable of every device in the configuration file, as graphed by the Smart Devices page */
+static void vAddFeedbackWatches(tsHistoryWatch *asWatches, uint32_t *pu32NumWatches)
+{
+    tsConfig sConfig;
+    uint32_t i;
+    
+    if (eConfigLoad(&sConfig, CONFIG_FILE_NAME, CONFIG_IMAGE_FILE_NAME) != E_CONFIG_OK)
+    {
+        return;
+    }
+    for (i = 0; i < sConfig.psHeader->u32NumDevices; i++)
+    {
+        (void)iAddWatch(asWatches, pu32NumWatches, 
+                        pcConfigString(&sConfig, sConfig.psDevices[i].u32LevelFeedbackMib),
+                        pcConfigString(&sConfig, sConfig.psDevices[i].u32LevelFeedbackVar));
+    }
+    vConfigUnload(&sConfig);
+}
+
+
+/** Rebuild the group model after each refresh, from the groups currently configured */
+static void vBuildGroupModel(tsJIP_Context *psJIP_Context, void *pvUser)
+{
+    tsConfig sConfig;
+    const tsConfigHeader *psHeader;
+    struct in6_addr asGroups[GROUP_MODEL_MAX_GROUPS];
+    tsGroupModelDefinition sDefinition;
+    uint32_t i;
+    
+    (void)pvUser;
+    
+    if (eConfigLoad(&sConfig, CONFIG_FILE_NAME, CONFIG_IMAGE_FILE_NAME) != E_CONFIG_OK)
+    {
+        return;
+    }
+    psHeader = sConfig.psHeader;
+    
+    memset(asGroups, 0, sizeof(asGroups));
+    if (psHeader->sGlobalGroup.u32Address)
+    {
+        inet_pton(AF_INET6, pcConfigString(&sConfig, psHeader->sGlobalGroup.u32Address), &asGroups[0]);
+    }
+    for (i = 0; (i < psHeader->u32NumGroups) && (i + 1 < GROUP_MODEL_MAX_GROUPS); i++)
+    {
+        inet_pton(AF_INET6, pcConfigString(&sConfig, sConfig.psGroups[i].u32Address), &asGroups[i + 1]);
+    }
+    
+    sDefinition.pcStateMib      = pcConfigString(&sConfig, psHeader->u32GroupStateControlMib);
+    sDefinition.pcStateVar      = pcConfigString(&sConfig, psHeader->u32GroupStateControlVar);
+    sDefinition.pcLevelMib      = pcConfigString(&sConfig, psHeader->u32GroupLevelControlMib);
+    sDefinition.pcLevelVar      = pcConfigString(&sConfig, psHeader->u32GroupLevelControlVar);
+    sDefinition.u32NumGroups    = i + 1;
+    sDefinition.asGroups        = asGroups;
+    
+    if (eGroupModelBuild(psJIP_Context, &sDefinition) != E_GROUP_MODEL_OK)
+    {
+        fprintf(stderr, "Failed to build group model\n");
+    }
+    vConfigUnload(&sConfig);
+}
+
+
+int main(int argc, char *argv[])
+{
+    char *pcBRAddress = NULL;
+    char acBRAddress[INET6_ADDRSTRLEN];
+    struct in6_addr sBRAddress;
+    uint32_t u32MinInterval = SCHEDULER_DEFAULT_MIN_INTERVAL;
+    uint32_t u32MaxInterval = SCHEDULER_DEFAULT_MAX_INTERVAL;
+    uint32_t u32Window = COALESCE_DEFAULT_WINDOW;
+    uint32_t u32SampleInterval = HISTORY_DEFAULT_INTERVAL;
+    tsHistoryWatch asWatches[HISTORY_MAX_WATCHES];
+    uint32_t u32NumWatches = 0;
+    char *pcSeparator;
+    sigset_t sSignals;
+    int iSignal;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "hb:i:m:w:t:H:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                pcBRAddress = optarg;
+                break;
+            case 'i':
+                u32MinInterval = strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                u32MaxInterval = strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                u32Window = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                u32SampleInterval = strtoul(optarg, NULL, 10);
+                break;
+            case 'H':
+                pcSeparator = strchr(optarg, '/');
+                if (!pcSeparator)
+                {
+                    print_usage_exit(argv);
+                }
+                *pcSeparator = '\0';
+                if (!iAddWatch(asWatches, &u32NumWatches, optarg, pcSeparator + 1))
+                {
+                    print_usage_exit(argv);
+                }
+                break;
+            case 'h':
+            default:
+                print_usage_exit(argv);
+        }
+    }
+    
+    if ((u32MinInterval == 0) || (u32MaxInterval < u32MinInterval))
+    {
+        fprintf(stderr, "Invalid refresh intervals (%u - %u seconds)\n", u32MinInterval, u32MaxInterval);
+        print_usage_exit(argv);
+    }
+    
+    if (!pcBRAddress)
+    {
+        pcBRAddress = pcFindBorderRouter();
+        if (!pcBRAddress)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    
+    /* Use the same textual form of the address as the web pages get from Zeroconf */
+    if (inet_pton(AF_INET6, pcBRAddress, &sBRAddress) != 1)
+    {
+        fprintf(stderr, "Invalid border router address '%s'\n", pcBRAddress);
+        return EXIT_FAILURE;
+    }
+    inet_ntop(AF_INET6, &sBRAddress, acBRAddress, INET6_ADDRSTRLEN);
+    
+    if (eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK)
+    {
+        fprintf(stderr, "JIP startup failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if (eJIP_Connect(&sJIP_Context, acBRAddress, JIP_DEFAULT_PORT) != E_JIP_OK)
+    {
+        fprintf(stderr, "JIP connect failed\n");
+        return EXIT_FAILURE;
+    }
+    
+    /* Start from the cached device id's so that the first discovery is quick */
+    (void)eNetworkCacheLoadDefinitions(&sJIP_Context, acBRAddress);
+    
+    /* Block the signals we handle so that only this thread receives them */
+    sigemptyset(&sSignals);
+    sigaddset(&sSignals, SIGHUP);
+    sigaddset(&sSignals, SIGINT);
+    sigaddset(&sSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sSignals, NULL);
+    
+    if (eSchedulerStart(&sScheduler, &sJIP_Context, acBRAddress, u32MinInterval, u32MaxInterval,
+                        vBuildGroupModel, NULL) != E_SCHEDULER_OK)
+    {
+        fprintf(stderr, "Failed to start discovery scheduler\n");
+        return EXIT_FAILURE;
+    }
+    
+    if (eCoalesceStart(&sCoalescer, &sJIP_Context, acBRAddress, u32Window) != E_COALESCE_OK)
+    {
+        /* The CGIs set variables themselves without us */
+        fprintf(stderr, "Failed to start accepting SetVars\n");
+    }
+    
+    if (eBrokerStart(&sBroker, &sJIP_Context, acBRAddress) != E_BROKER_OK)
+    {
+        /* The CGIs connect to the border router themselves without us */
+        fprintf(stderr, "Failed to start connection broker\n");
+    }
+    
+    if (u32SampleInterval)
+    {
+        vAddFeedbackWatches(asWatches, &u32NumWatches);
+    }
+    if ((u32SampleInterval) && (u32NumWatches) &&
+        (eHistoryStart(&sSampler, &sJIP_Context, u32SampleInterval, u32NumWatches, asWatches) != E_HISTORY_OK))
+    {
+        /* Pages fall back to the samples they take themselves */
+        fprintf(stderr, "Failed to start keeping history\n");
+    }
+    
+    while (sigwait(&sSignals, &iSignal) == 0)
+    {
+        if (iSignal == SIGHUP)
+        {
+            vSchedulerTrigger(&sScheduler);
+            continue;
+        }
+        break;
+    }
+    
+    if (sSampler.iRun)
+    {
+        (void)eHistoryStop(&sSampler);
+    }
+    if (sBroker.iRun)
+    {
+        (void)eBrokerStop(&sBroker);
+    }
+    if (sCoalescer.iRun)
+    {
+        (void)eCoalesceStop(&sCoalescer);
+    }
+    (void)eSchedulerStop(&sScheduler);
+    eJIP_Destroy(&sJIP_Context);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1573 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTTP server
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "AssetPack.h"
+#include "CGI.h"
+#include "Http.h"
+#include "Multicall.h"
+#include "Response.h"
+
+//#define DEBUG_HTTPD
+
+#ifdef DEBUG_HTTPD
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_HTTPD */
+
+#ifndef VERSION
+#error Version is not defined!
+#else
+static const char *Version = "0.1 (r" VERSION ")";
+#endif
+
+/** Port listened on by default */
+#define HTTPD_DEFAULT_PORT          80
+
+/** Directory the static files are served from by default */
+#define HTTPD_DEFAULT_ROOT          "/www"
+
+/** Page served for a directory */
+#define HTTPD_INDEX                 "index.html"
+
+/** Path under which the CGI programs are found */
+#define HTTPD_CGI_PREFIX            "/cgi-bin/"
+
+/** Caching of a file of the asset pack requested with its hash, see asset-pack.py */
+#define HTTPD_CACHE_VERSIONED       "public, max-age=31536000, immutable"
+
+/** Caching of a file of the asset pack requested without its hash */
+#define HTTPD_CACHE_REVALIDATE      "no-cache"
+
+/** Number of CGI requests run at once by default */
+#define HTTPD_DEFAULT_WORKERS       4
+
+/** Most CGI requests run at once */
+#define HTTPD_MAX_WORKERS           32
+
+/** Most connections open at once */
+#define HTTPD_MAX_CONNECTIONS       128
+
+/** Most requests of a connection received ahead of their responses */
+#define HTTPD_MAX_PIPELINE          8
+
+/** Size of a connection's receive buffer, the largest request with its body */
+#define HTTPD_BUFFER_SIZE           16384
+
+/** Largest output of a CGI program */
+#define HTTPD_MAX_OUTPUT            (4 * 1024 * 1024)
+
+/** Seconds a connection is kept open without a request */
+#define HTTPD_IDLE_TIMEOUT          30
+
+/** Seconds a CGI program may run before it is killed */
+#define HTTPD_CGI_TIMEOUT           60
+
+/** Events handled per wait */
+#define HTTPD_MAX_EVENTS            32
+
+/** Sources of events, in the top half of their epoll data */
+#define HTTPD_EVENT_LISTEN          0
+#define HTTPD_EVENT_SIGNAL          1
+#define HTTPD_EVENT_CONNECTION      2
+#define HTTPD_EVENT_WORKER          3
+
+#define HTTPD_EVENT(type, index)    (((uint64_t)(type) << 32) | (uint32_t)(index))
+
+
+/** Enumerated type of the states of a response */
+typedef enum
+{
+    E_HTTPD_QUEUED,             /**< CGI request waiting for a worker */
+    E_HTTPD_RUNNING,            /**< CGI request being run by a worker */
+    E_HTTPD_READY,              /**< Ready to send */
+} teHttpdState;
+
+
+/** A CGI request waiting for a worker. The request points into acData */
+typedef struct
+{
+    tsHttpRequest       sRequest;       /**< Request */
+    tprCgiMain          prMain;         /**< Program to run it */
+    char                acData[];       /**< Copy of the request as received */
+} tsHttpdCgiRequest;
+
+
+/** Response to a request of a connection, sent in the order they were received */
+typedef struct
+{
+    teHttpdState        eState;         /**< State of the response */
+    uint32_t            u32Sequence;    /**< Order of queued CGI requests across connections */
+    tsHttpdCgiRequest   *psCgiRequest;  /**< CGI request, while queued */
+    int                 iHeadOnly;      /**< Set for a HEAD request */
+    int                 iKeepAlive;     /**< Set if the connection stays open after this response */
+    
+    char                *pcData;        /**< Head, and body unless it comes from iFile */
+    size_t              szData;         /**< Length of data */
+    size_t              szSent;         /**< Bytes of data and body sent */
+    
+    const uint8_t       *pu8Body;       /**< Body in the asset pack, sent with the head in one write */
+    size_t              szBody;         /**< Length of body in the asset pack */
+    
+    int                 iFile;          /**< Static file the body is sent from, or -1 */
+    off_t               iOffset;        /**< Offset in the file of the next byte to send */
+    size_t              szRemaining;    /**< Bytes of the file still to send */
+} tsHttpdResponse;
+
+
+/** A client connection */
+typedef struct
+{
+    int                 iSocket;        /**< Socket, -1 if the slot is free */
+    char                acAddress[INET6_ADDRSTRLEN]; /**< Address of the client */
+    uint32_t            u32Events;      /**< Events being waited for */
+    time_t              tActivity;      /**< Time of the last request or response */
+    int                 iClosing;       /**< Set once no more requests are read */
+    int                 iEof;           /**< Set once the client has finished sending */
+    
+    char                *pcBuffer;      /**< Received data not yet parsed */
+    size_t              szBuffer;       /**< Length of received data */
+    
+    tsHttpdResponse     asResponses[HTTPD_MAX_PIPELINE]; /**< Ring of responses, oldest first */
+    uint32_t            u32First;       /**< Index of the oldest response */
+    uint32_t            u32NumResponses;/**< Number of responses in the ring */
+} tsHttpdConnection;
+
+
+/** A worker, a child process running a CGI request */
+typedef struct
+{
+    pid_t               iPid;           /**< Process id, 0 once it has exited */
+    int                 iFd;            /**< Output of the process, -1 once it has all been read */
+    tsHttpdConnection   *psConnection;  /**< Connection of the request, NULL if it has gone */
+    tsHttpdResponse     *psResponse;    /**< Response to the request */
+    time_t              tStarted;       /**< Time the process was started */
+    int                 iTimedOut;      /**< Set if the process was killed for taking too long */
+    
+    char                *pcOutput;      /**< Output of the process */
+    size_t              szOutput;       /**< Length of output */
+    size_t              szOutputSize;   /**< Allocated size of output */
+} tsHttpdWorker;
+
+
+/** State of the server */
+typedef struct
+{
+    const char          *pcRoot;        /**< Directory of the static files */
+    tsAssetPack         sPack;          /**< Static files built into a pack, served before those of pcRoot */
+    int                 iPack;          /**< Set if sPack is open */
+    uint16_t            u16Port;        /**< Port listened on */
+    int                 iListen;        /**< Listening socket */
+    int                 iEpoll;         /**< Event poll */
+    int                 iSignals;       /**< Signals, as a file descriptor */
+    int                 iRun;           /**< Cleared to stop */
+    uint32_t            u32Sequence;    /**< Sequence of the next queued CGI request */
+    
+    uint32_t            u32MaxWorkers;  /**< Most CGI requests run at once */
+    uint32_t            u32NumWorkers;  /**< Workers in use */
+    tsHttpdWorker       asWorkers[HTTPD_MAX_WORKERS];
+    
+    tsHttpdConnection   asConnections[HTTPD_MAX_CONNECTIONS];
+} tsHttpd;
+
+
+/** Content types of the static files, by extension */
+static const struct
+{
+    const char *pcExtension;
+    const char *pcType;
+} asContentTypes[] =
+{
+    { "html",   "text/html" },
+    { "htm",    "text/html" },
+    { "css",    "text/css" },
+    { "js",     "application/javascript" },
+    { "json",   "application/json" },
+    { "txt",    "text/plain" },
+    { "xml",    "text/xml" },
+    { "png",    "image/png" },
+    { "gif",    "image/gif" },
+    { "jpg",    "image/jpeg" },
+    { "jpeg",   "image/jpeg" },
+    { "ico",    "image/x-icon" },
+    { "svg",    "image/svg+xml" },
+};
+
+#define NUM_CONTENT_TYPES (sizeof(asContentTypes) / sizeof(asContentTypes[0]))
+
+
+static tsHttpd sHttpd;
+
+
+static void print_usage_exit(char *argv[])
+{
+    const char *pcName;
+    uint32_t i;
+    
+    fprintf(stderr, "JIPHttpd Version: %s\n", Version);
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "  Options:\n");
+    fprintf(stderr, "    -h               Print this help.\n");
+    fprintf(stderr, "    -p <port>        Port to listen on. Default %d.\n", HTTPD_DEFAULT_PORT);
+    fprintf(stderr, "    -r <directory>   Directory of the static files. Default %s.\n", HTTPD_DEFAULT_ROOT);
+    fprintf(stderr, "    -a <pack>        Asset pack of the static files, built by asset-pack.py.\n");
+    fprintf(stderr, "                     Files not in it are served from the directory.\n");
+    fprintf(stderr, "    -w <workers>     Number of CGI requests run at once. Default %d, at most %d.\n", 
+            HTTPD_DEFAULT_WORKERS, HTTPD_MAX_WORKERS);
+    fprintf(stderr, "  These programs are run for requests under %s:\n", HTTPD_CGI_PREFIX);
+    for (i = 0; (pcName = pcMulticallAppletName(i)) != NULL; i++)
+    {
+        fprintf(stderr, "    %s\n", pcName);
+    }
+    exit(EXIT_FAILURE);
+}
+
+
+static time_t tNow(void)
+{
+    struct timespec sNow;
+    
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return sNow.tv_sec;
+}
+
+
+static int iSetNonBlocking(int iFd)
+{
+    int iFlags = fcntl(iFd, F_GETFL);
+    
+    return (iFlags >= 0) && (fcntl(iFd, F_SETFL, iFlags | O_NONBLOCK) == 0);
+}
+
+
+static const char *pcContentType(const char *pcPath)
+{
+    const char *pcExtension = strrchr(pcPath, '.');
+    uint32_t i;
+    
+    if (pcExtension && !strchr(pcExtension, '/'))
+    {
+        for (i = 0; i < NUM_CONTENT_TYPES; i++)
+        {
+            if (strcasecmp(pcExtension + 1, asContentTypes[i].pcExtension) == 0)
+            {
+                return asContentTypes[i].pcType;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+
+/****************************************************************************
+ * Responses
+ ****************************************************************************/
+
+static void vResponseFree(tsHttpdResponse *psResponse)
+{
+    free(psResponse->psCgiRequest);
+    free(psResponse->pcData);
+    if (psResponse->iFile >= 0)
+    {
+        close(psResponse->iFile);
+    }
+    memset(psResponse, 0, sizeof(tsHttpdResponse));
+    psResponse->iFile = -1;
+}
+
+
+/** Make a response ready to send with a body held in memory */
+static void vResponseSet(tsHttpdResponse *psResponse, char *pcData, size_t szData)
+{
+    psResponse->eState  = E_HTTPD_READY;
+    psResponse->pcData  = pcData;
+    psResponse->szData  = szData;
+    psResponse->szSent  = 0;
+}
+
+
+/** Respond with a status and a short text body */
+static void vResponseError(tsHttpdResponse *psResponse, int iStatus)
+{
+    char acBody[64];
+    char *pcData;
+    size_t szBody;
+    size_t szHead;
+    
+    szBody = snprintf(acBody, sizeof(acBody), "%d %s\n", iStatus, pcHttpReason(iStatus));
+    pcData = malloc(256 + szBody);
+    if (!pcData)
+    {
+        /* Nothing can be sent, so the connection is closed in its place */
+        psResponse->iKeepAlive = 0;
+        vResponseSet(psResponse, NULL, 0);
+        return;
+    }
+    szHead = szHttpFormatHead(pcData, 256, iStatus, "text/plain", szBody, psResponse->iKeepAlive);
+    if (!psResponse->iHeadOnly)
+    {
+        memcpy(&pcData[szHead], acBody, szBody);
+        szHead += szBody;
+    }
+    vResponseSet(psResponse, pcData, szHead);
+}
+
+
+/****************************************************************************
+ * Static files
+ ****************************************************************************/
+
+/** Decode the path of a request into a file name under the root. 
+ *  \return Non zero on success, 0 if the path is invalid or would leave the root */
+static int iFileName(const char *pcRoot, const char *pcPath, char *pcFileName, size_t szSize)
+{
+    size_t szLength = strlen(pcRoot);
+    const char *pcSegment;
+    
+    if (szLength >= szSize)
+    {
+        return 0;
+    }
+    memcpy(pcFileName, pcRoot, szLength);
+    pcSegment = &pcFileName[szLength];
+    
+    for (; *pcPath; pcPath++)
+    {
+        char c = *pcPath;
+        
+        if (c == '%')
+        {
+            unsigned int uValue;
+            
+            if (!pcPath[1] || !pcPath[2] || (sscanf(pcPath + 1, "%2x", &uValue) != 1))
+            {
+                return 0;
+            }
+            c = (char)uValue;
+            pcPath += 2;
+        }
+        if (c == '\0')
+        {
+            return 0;
+        }
+        if (szLength + 1 >= szSize)
+        {
+            return 0;
+        }
+        pcFileName[szLength++] = c;
+        pcFileName[szLength] = '\0';
+        
+        if (c == '/')
+        {
+            /* Refuse any ".." segment, however it was encoded */
+            if (strcmp(pcSegment, "/../") == 0)
+            {
+                return 0;
+            }
+            pcSegment = &pcFileName[szLength - 1];
+        }
+    }
+    pcFileName[szLength] = '\0';
+    return strcmp(pcSegment, "/..") != 0;
+}
+
+
+/** Respond to a request for a file of the asset pack */
+static void vServeAsset(tsHttpdResponse *psResponse, const tsHttpRequest *psRequest, const tsAsset *psAsset)
+{
+    const char *pcCacheControl = HTTPD_CACHE_REVALIDATE;
+    char acETag[64];
+    int iGzip = 0;
+    int iStatus = 200;
+    int iLength;
+    
+    if (psAsset->pu8Gzip && 
+        (eResponseAcceptedEncoding(pcHttpHeader(psRequest, "Accept-Encoding")) == E_RESPONSE_ENCODING_GZIP))
+    {
+        iGzip = 1;
+    }
+    
+    /* Each variant has a tag of its own, as they are not the same bytes */
+    snprintf(acETag, sizeof(acETag), "\"%s%s\"", psAsset->pcHash, iGzip ? "-gz" : "");
+    if (iCGIETagListMatches(pcHttpHeader(psRequest, "If-None-Match"), acETag))
+    {
+        iStatus = 304;
+    }
+    
+    /* A URL with the hash of the file changes when the file does */
+    if ((strncmp(psRequest->pcQuery, "v=", 2) == 0) && (strcmp(&psRequest->pcQuery[2], psAsset->pcHash) == 0))
+    {
+        pcCacheControl = HTTPD_CACHE_VERSIONED;
+    }
+    
+    psResponse->pcData = malloc(512);
+    if (!psResponse->pcData)
+    {
+        vResponseError(psResponse, 500);
+        return;
+    }
+    if (iStatus == 200)
+    {
+        iLength = snprintf(psResponse->pcData, 512, 
+                           "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s%s"
+                           "ETag: %s\r\nCache-Control: %s\r\nConnection: %s\r\n\r\n",
+                           psAsset->pcContentType, iGzip ? psAsset->u32GzipLength : psAsset->u32Length,
+                           iGzip ? "Content-Encoding: gzip\r\n" : "", psAsset->pu8Gzip ? "Vary: Accept-Encoding\r\n" : "",
+                           acETag, pcCacheControl, psResponse->iKeepAlive ? "keep-alive" : "close");
+    }
+    else
+    {
+        iLength = snprintf(psResponse->pcData, 512, 
+                           "HTTP/1.1 304 Not Modified\r\n%sETag: %s\r\nCache-Control: %s\r\nConnection: %s\r\n\r\n",
+                           psAsset->pu8Gzip ? "Vary: Accept-Encoding\r\n" : "",
+                           acETag, pcCacheControl, psResponse->iKeepAlive ? "keep-alive" : "close");
+    }
+    if ((iLength < 0) || (iLength >= 512))
+    {
+        free(psResponse->pcData);
+        psResponse->pcData = NULL;
+        vResponseError(psResponse, 500);
+        return;
+    }
+    vResponseSet(psResponse, psResponse->pcData, iLength);
+    
+    if ((iStatus == 200) && !psResponse->iHeadOnly)
+    {
+        psResponse->pu8Body = iGzip ? psAsset->pu8Gzip : psAsset->pu8Data;
+        psResponse->szBody  = iGzip ? psAsset->u32GzipLength : psAsset->u32Length;
+    }
+}
+
+
+/** Respond to a request for a static file */
+static void vServeFile(tsHttpd *psHttpd, tsHttpdResponse *psResponse, const tsHttpRequest *psRequest)
+{
+    char acPath[PATH_MAX];
+    char acFileName[PATH_MAX];
+    struct stat sStat;
+    tsAsset sAsset;
+    size_t szHead;
+    int iFile;
+    
+    if (strcmp(psRequest->pcMethod, "GET") && strcmp(psRequest->pcMethod, "HEAD"))
+    {
+        vResponseError(psResponse, 405);
+        return;
+    }
+    
+    /* The pack and the root are looked up by the same decoded path */
+    if (!iFileName("", psRequest->pcPath, acPath, sizeof(acPath) - sizeof(HTTPD_INDEX)))
+    {
+        vResponseError(psResponse, 404);
+        return;
+    }
+    if (acPath[strlen(acPath) - 1] == '/')
+    {
+        strcat(acPath, HTTPD_INDEX);
+    }
+    
+    if (psHttpd->iPack && iAssetPackLookup(&psHttpd->sPack, acPath, &sAsset))
+    {
+        vServeAsset(psResponse, psRequest, &sAsset);
+        return;
+    }
+    if (snprintf(acFileName, sizeof(acFileName), "%s%s", psHttpd->pcRoot, acPath) >= (int)sizeof(acFileName))
+    {
+        vResponseError(psResponse, 404);
+        return;
+    }
+    
+    iFile = open(acFileName, O_RDONLY | O_CLOEXEC);
+    if (iFile < 0)
+    {
+        vResponseError(psResponse, (errno == EACCES) ? 403 : 404);
+        return;
+    }
+    if ((fstat(iFile, &sStat) < 0) || !S_ISREG(sStat.st_mode))
+    {
+        close(iFile);
+        vResponseError(psResponse, 404);
+        return;
+    }
+    
+    psResponse->pcData = malloc(256);
+    if (!psResponse->pcData)
+    {
+        close(iFile);
+        vResponseError(psResponse, 500);
+        return;
+    }
+    szHead = szHttpFormatHead(psResponse->pcData, 256, 200, pcContentType(acFileName), 
+                              sStat.st_size, psResponse->iKeepAlive);
+    vResponseSet(psResponse, psResponse->pcData, szHead);
+    if (psResponse->iHeadOnly || (sStat.st_size == 0))
+    {
+        close(iFile);
+        return;
+    }
+    psResponse->iFile       = iFile;
+    psResponse->iOffset     = 0;
+    psResponse->szRemaining = sStat.st_size;
+}
+
+
+/****************************************************************************
+ * CGI workers
+ ****************************************************************************/
+
+/** Copy a CGI request out of the receive buffer, to be run when a worker is free */
+static tsHttpdCgiRequest *psCgiRequestCopy(const tsHttpRequest *psRequest, const char *pcBuffer, tprCgiMain prMain)
+{
+    tsHttpdCgiRequest *psCgiRequest;
+    uint32_t i;
+    
+    psCgiRequest = malloc(sizeof(tsHttpdCgiRequest) + psRequest->szLength);
+    if (!psCgiRequest)
+    {
+        return NULL;
+    }
+    memcpy(psCgiRequest->acData, pcBuffer, psRequest->szLength);
+    psCgiRequest->prMain = prMain;
+    psCgiRequest->sRequest = *psRequest;
+    
+#define REBASE(pc) ((((pc) >= pcBuffer) && ((pc) < pcBuffer + psRequest->szLength)) ? \
+                    psCgiRequest->acData + ((pc) - pcBuffer) : (pc))
+    psCgiRequest->sRequest.pcMethod = REBASE(psRequest->pcMethod);
+    psCgiRequest->sRequest.pcPath   = REBASE(psRequest->pcPath);
+    psCgiRequest->sRequest.pcQuery  = REBASE(psRequest->pcQuery);
+    psCgiRequest->sRequest.pcBody   = REBASE(psRequest->pcBody);
+    for (i = 0; i < psRequest->u32NumHeaders; i++)
+    {
+        psCgiRequest->sRequest.asHeaders[i].pcName  = REBASE(psRequest->asHeaders[i].pcName);
+        psCgiRequest->sRequest.asHeaders[i].pcValue = REBASE(psRequest->asHeaders[i].pcValue);
+    }
+#undef REBASE
+    return psCgiRequest;
+}
+
+
+/** Set the CGI environment of a request, with each header as HTTP_<NAME> */
+static void vCgiEnvironment(tsHttpd *psHttpd, const tsHttpRequest *psRequest, const char *pcAddress)
+{
+    char acValue[32];
+    uint32_t i;
+    
+    setenv("GATEWAY_INTERFACE", "CGI/1.1", 1);
+    setenv("SERVER_SOFTWARE", "JIPHttpd", 1);
+    snprintf(acValue, sizeof(acValue), "HTTP/1.%d", psRequest->iMinorVersion);
+    setenv("SERVER_PROTOCOL", acValue, 1);
+    snprintf(acValue, sizeof(acValue), "%u", psHttpd->u16Port);
+    setenv("SERVER_PORT", acValue, 1);
+    setenv("REMOTE_ADDR", pcAddress, 1);
+    /* The programs answer a HEAD as a GET, and the body is dropped from the response */
+    setenv("REQUEST_METHOD", strcmp(psRequest->pcMethod, "HEAD") ? psRequest->pcMethod : "GET", 1);
+    setenv("SCRIPT_NAME", psRequest->pcPath, 1);
+    setenv("QUERY_STRING", psRequest->pcQuery, 1);
+    snprintf(acValue, sizeof(acValue), "%zu", psRequest->szBody);
+    setenv("CONTENT_LENGTH", acValue, 1);
+    
+    for (i = 0; i < psRequest->u32NumHeaders; i++)
+    {
+        const tsHttpHeader *psHeader = &psRequest->asHeaders[i];
+        char acName[64];
+        size_t szName = strlen(psHeader->pcName);
+        size_t j;
+        
+        if (strcasecmp(psHeader->pcName, "Content-Type") == 0)
+        {
+            setenv("CONTENT_TYPE", psHeader->pcValue, 1);
+            continue;
+        }
+        /* Proxy would become HTTP_PROXY, which programs take as their proxy */
+        if ((strcasecmp(psHeader->pcName, "Content-Length") == 0) || 
+            (strcasecmp(psHeader->pcName, "Proxy") == 0) || (szName + 6 > sizeof(acName)))
+        {
+            continue;
+        }
+        memcpy(acName, "HTTP_", 5);
+        for (j = 0; j < szName; j++)
+        {
+            char c = psHeader->pcName[j];
+            acName[5 + j] = (c == '-') ? '_' : ((c >= 'a') && (c <= 'z')) ? c - 'a' + 'A' : c;
+        }
+        acName[5 + szName] = '\0';
+        setenv(acName, psHeader->pcValue, 1);
+    }
+}
+
+
+/** Run a CGI request in a newly forked worker, with its output going to iOutput. Does not return */
+static void vWorkerRun(tsHttpd *psHttpd, tsHttpdCgiRequest *psCgiRequest, const char *pcAddress, int iOutput)
+{
+    tsHttpRequest *psRequest = &psCgiRequest->sRequest;
+    char *apcArgv[2];
+    sigset_t sSignals;
+    int aiInput[2];
+    uint32_t i;
+    
+    /* Nothing of the server's is the program's business */
+    sigemptyset(&sSignals);
+    sigprocmask(SIG_SETMASK, &sSignals, NULL);
+    signal(SIGPIPE, SIG_DFL);
+    close(psHttpd->iListen);
+    close(psHttpd->iEpoll);
+    close(psHttpd->iSignals);
+    if (psHttpd->iPack)
+    {
+        vAssetPackClose(&psHttpd->sPack);
+    }
+    for (i = 0; i < HTTPD_MAX_CONNECTIONS; i++)
+    {
+        if (psHttpd->asConnections[i].iSocket >= 0)
+        {
+            close(psHttpd->asConnections[i].iSocket);
+        }
+    }
+    for (i = 0; i < HTTPD_MAX_WORKERS; i++)
+    {
+        if (psHttpd->asWorkers[i].iFd >= 0)
+        {
+            close(psHttpd->asWorkers[i].iFd);
+        }
+    }
+    
+    /* The body is at most HTTPD_BUFFER_SIZE, which a pipe holds without blocking */
+    if ((pipe(aiInput) < 0) || 
+        ((psRequest->szBody) && (write(aiInput[1], psRequest->pcBody, psRequest->szBody) != (ssize_t)psRequest->szBody)))
+    {
+        _exit(EXIT_FAILURE);
+    }
+    close(aiInput[1]);
+    if ((dup2(aiInput[0], STDIN_FILENO) < 0) || (dup2(iOutput, STDOUT_FILENO) < 0))
+    {
+        _exit(EXIT_FAILURE);
+    }
+    close(aiInput[0]);
+    close(iOutput);
+    
+    vCgiEnvironment(psHttpd, psRequest, pcAddress);
+    
+    apcArgv[0] = (char *)psRequest->pcPath;
+    apcArgv[1] = NULL;
+    exit(psCgiRequest->prMain(1, apcArgv));
+}
+
+
+/** Start a worker on a queued CGI request. \return Non zero on success */
+static int iWorkerStart(tsHttpd *psHttpd, tsHttpdConnection *psConnection, tsHttpdResponse *psResponse)
+{
+    tsHttpdWorker *psWorker = NULL;
+    struct epoll_event sEvent;
+    int aiOutput[2];
+    uint32_t i;
+    
+    for (i = 0; i < HTTPD_MAX_WORKERS; i++)
+    {
+        if ((psHttpd->asWorkers[i].iPid == 0) && (psHttpd->asWorkers[i].iFd < 0))
+        {
+            psWorker = &psHttpd->asWorkers[i];
+            break;
+        }
+    }
+    if (!psWorker || (pipe(aiOutput) < 0))
+    {
+        return 0;
+    }
+    if (!iSetNonBlocking(aiOutput[0]))
+    {
+        close(aiOutput[0]);
+        close(aiOutput[1]);
+        return 0;
+    }
+    
+    fflush(NULL);
+    psWorker->iPid = fork();
+    if (psWorker->iPid < 0)
+    {
+        psWorker->iPid = 0;
+        close(aiOutput[0]);
+        close(aiOutput[1]);
+        return 0;
+    }
+    if (psWorker->iPid == 0)
+    {
+        close(aiOutput[0]);
+        vWorkerRun(psHttpd, psResponse->psCgiRequest, psConnection->acAddress, aiOutput[1]);
+    }
+    close(aiOutput[1]);
+    
+    PRINTF("Worker %u (pid %d) running %s for %s\n", i, psWorker->iPid, 
+           psResponse->psCgiRequest->sRequest.pcPath, psConnection->acAddress);
+    
+    psWorker->iFd           = aiOutput[0];
+    psWorker->psConnection  = psConnection;
+    psWorker->psResponse    = psResponse;
+    psWorker->tStarted      = tNow();
+    psWorker->iTimedOut     = 0;
+    psWorker->szOutput      = 0;
+    psHttpd->u32NumWorkers++;
+    
+    sEvent.events   = EPOLLIN;
+    sEvent.data.u64 = HTTPD_EVENT(HTTPD_EVENT_WORKER, i);
+    if (epoll_ctl(psHttpd->iEpoll, EPOLL_CTL_ADD, psWorker->iFd, &sEvent) < 0)
+    {
+        /* The worker runs on, and its output is lost */
+        kill(psWorker->iPid, SIGKILL);
+        close(psWorker->iFd);
+        psWorker->iFd = -1;
+        psWorker->psConnection = NULL;
+        free(psResponse->psCgiRequest);
+        psResponse->psCgiRequest = NULL;
+        vResponseError(psResponse, 500);
+        return 1;
+    }
+    
+    free(psResponse->psCgiRequest);
+    psResponse->psCgiRequest = NULL;
+    psResponse->eState = E_HTTPD_RUNNING;
+    return 1;
+}
+
+
+static void vConnectionEvents(tsHttpd *psHttpd, tsHttpdConnection *psConnection);
+static void vConnectionService(tsHttpd *psHttpd, tsHttpdConnection *psConnection);
+
+
+/** Start workers on the queued CGI requests, oldest first, while there are workers free */
+static void vWorkersStart(tsHttpd *psHttpd)
+{
+    while (psHttpd->u32NumWorkers < psHttpd->u32MaxWorkers)
+    {
+        tsHttpdConnection *psOldestConnection = NULL;
+        tsHttpdResponse *psOldest = NULL;
+        uint32_t i, j;
+        
+        for (i = 0; i < HTTPD_MAX_CONNECTIONS; i++)
+        {
+            tsHttpdConnection *psConnection = &psHttpd->asConnections[i];
+            
+            if (psConnection->iSocket < 0)
+            {
+                continue;
+            }
+            for (j = 0; j < psConnection->u32NumResponses; j++)
+            {
+                tsHttpdResponse *psResponse = &psConnection->asResponses[(psConnection->u32First + j) % HTTPD_MAX_PIPELINE];
+                
+                if ((psResponse->eState == E_HTTPD_QUEUED) && 
+                    (!psOldest || ((int32_t)(psResponse->u32Sequence - psOldest->u32Sequence) < 0)))
+                {
+                    psOldestConnection = psConnection;
+                    psOldest = psResponse;
+                }
+            }
+        }
+        if (!psOldest)
+        {
+            return;
+        }
+        if (!iWorkerStart(psHttpd, psOldestConnection, psOldest))
+        {
+            fprintf(stderr, "Failed to start a worker: %s\n", strerror(errno));
+            free(psOldest->psCgiRequest);
+            psOldest->psCgiRequest = NULL;
+            vResponseError(psOldest, 503);
+            vConnectionEvents(psHttpd, psOldestConnection);
+        }
+    }
+}
+
+
+/** Free a worker once its process has exited and its output has all been read */
+static void vWorkerRelease(tsHttpd *psHttpd, tsHttpdWorker *psWorker)
+{
+    if ((psWorker->iPid == 0) && (psWorker->iFd < 0))
+    {
+        free(psWorker->pcOutput);
+        psWorker->pcOutput = NULL;
+        psWorker->szOutput = psWorker->szOutputSize = 0;
+        psHttpd->u32NumWorkers--;
+        vWorkersStart(psHttpd);
+    }
+}
+
+
+/** Turn the complete output of a worker into the response to its request */
+static void vWorkerComplete(tsHttpd *psHttpd, tsHttpdWorker *psWorker)
+{
+    tsHttpdConnection *psConnection = psWorker->psConnection;
+    tsHttpdResponse *psResponse = psWorker->psResponse;
+    char *pcData;
+    size_t szData;
+    
+    epoll_ctl(psHttpd->iEpoll, EPOLL_CTL_DEL, psWorker->iFd, NULL);
+    close(psWorker->iFd);
+    psWorker->iFd = -1;
+    psWorker->psConnection = NULL;
+    
+    if (psConnection)
+    {
+        if (psWorker->iTimedOut)
+        {
+            vResponseError(psResponse, 504);
+        }
+        else if (eHttpFromCgi(psWorker->pcOutput, psWorker->szOutput, psResponse->iHeadOnly, 
+                              psResponse->iKeepAlive, &pcData, &szData) == E_HTTP_OK)
+        {
+            vResponseSet(psResponse, pcData, szData);
+        }
+        else
+        {
+            vResponseError(psResponse, 502);
+        }
+        psConnection->tActivity = tNow();
+        vConnectionService(psHttpd, psConnection);
+    }
+    vWorkerRelease(psHttpd, psWorker);
+}
+
+
+static void vWorkerRead(tsHttpd *psHttpd, tsHttpdWorker *psWorker)
+{
+    for (;;)
+    {
+        ssize_t iBytes;
+        
+        if (psWorker->szOutput == psWorker->szOutputSize)
+        {
+            size_t szSize = psWorker->szOutputSize ? psWorker->szOutputSize * 2 : HTTPD_BUFFER_SIZE;
+            char *pcOutput;
+            
+            if ((szSize > HTTPD_MAX_OUTPUT) || ((pcOutput = realloc(psWorker->pcOutput, szSize)) == NULL))
+            {
+                fprintf(stderr, "Output of pid %d is too large\n", psWorker->iPid);
+                kill(psWorker->iPid, SIGKILL);
+                psWorker->szOutput = 0;
+                vWorkerComplete(psHttpd, psWorker);
+                return;
+            }
+            psWorker->pcOutput = pcOutput;
+            psWorker->szOutputSize = szSize;
+        }
+        
+        iBytes = read(psWorker->iFd, &psWorker->pcOutput[psWorker->szOutput], psWorker->szOutputSize - psWorker->szOutput);
+        if (iBytes > 0)
+        {
+            psWorker->szOutput += iBytes;
+        }
+        else if (iBytes == 0)
+        {
+            vWorkerComplete(psHttpd, psWorker);
+            return;
+        }
+        else if (errno != EINTR)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                vWorkerComplete(psHttpd, psWorker);
+            }
+            return;
+        }
+    }
+}
+
+
+/** Reap the workers that have exited */
+static void vWorkersReap(tsHttpd *psHttpd)
+{
+    struct signalfd_siginfo sInfo;
+    int iStatus;
+    pid_t iPid;
+    uint32_t i;
+    
+    while (read(psHttpd->iSignals, &sInfo, sizeof(sInfo)) == sizeof(sInfo))
+    {
+        if ((sInfo.ssi_signo == SIGINT) || (sInfo.ssi_signo == SIGTERM))
+        {
+            psHttpd->iRun = 0;
+        }
+    }
+    
+    while ((iPid = waitpid(-1, &iStatus, WNOHANG)) > 0)
+    {
+        for (i = 0; i < HTTPD_MAX_WORKERS; i++)
+        {
+            tsHttpdWorker *psWorker = &psHttpd->asWorkers[i];
+            
+            if (psWorker->iPid == iPid)
+            {
+                PRINTF("Worker %u (pid %d) exited with status %d\n", i, iPid, iStatus);
+                psWorker->iPid = 0;
+                vWorkerRelease(psHttpd, psWorker);
+                break;
+            }
+        }
+    }
+}
+
+
+/****************************************************************************
+ * Connections
+ ****************************************************************************/
+
+static void vConnectionClose(tsHttpd *psHttpd, tsHttpdConnection *psConnection)
+{
+    uint32_t i;
+    
+    PRINTF("Closing connection from %s\n", psConnection->acAddress);
+    
+    /* Running workers finish, and their output is thrown away */
+    for (i = 0; i < HTTPD_MAX_WORKERS; i++)
+    {
+        if (psHttpd->asWorkers[i].psConnection == psConnection)
+        {
+            psHttpd->asWorkers[i].psConnection = NULL;
+        }
+    }
+    for (i = 0; i < HTTPD_MAX_PIPELINE; i++)
+    {
+        vResponseFree(&psConnection->asResponses[i]);
+    }
+    
+    /* Closing with data unread resets the connection, which loses the last
+     * response, such as an error for a request that was too large */
+    for (i = 0; (i < 4) && (recv(psConnection->iSocket, psConnection->pcBuffer, HTTPD_BUFFER_SIZE, 0) > 0); i++);
+    close(psConnection->iSocket);
+    psConnection->iSocket = -1;
+    free(psConnection->pcBuffer);
+    psConnection->pcBuffer = NULL;
+}
+
+
+/** Handle a request parsed from a connection, adding its response to the ring */
+static void vConnectionRequest(tsHttpd *psHttpd, tsHttpdConnection *psConnection, const tsHttpRequest *psRequest)
+{
+    tsHttpdResponse *psResponse;
+    tprCgiMain prMain;
+    
+    psResponse = &psConnection->asResponses[(psConnection->u32First + psConnection->u32NumResponses) % HTTPD_MAX_PIPELINE];
+    psConnection->u32NumResponses++;
+    psResponse->iHeadOnly = (strcmp(psRequest->pcMethod, "HEAD") == 0);
+    psResponse->iKeepAlive = psRequest->iKeepAlive;
+    if (!psRequest->iKeepAlive)
+    {
+        psConnection->iClosing = 1;
+    }
+    
+    if (strncmp(psRequest->pcPath, HTTPD_CGI_PREFIX, sizeof(HTTPD_CGI_PREFIX) - 1) != 0)
+    {
+        vServeFile(psHttpd, psResponse, psRequest);
+        return;
+    }
+    
+    prMain = prMulticallApplet(psRequest->pcPath);
+    if (!prMain)
+    {
+        vResponseError(psResponse, 404);
+        return;
+    }
+    psResponse->psCgiRequest = psCgiRequestCopy(psRequest, psConnection->pcBuffer, prMain);
+    if (!psResponse->psCgiRequest)
+    {
+        vResponseError(psResponse, 500);
+        return;
+    }
+    psResponse->eState = E_HTTPD_QUEUED;
+    psResponse->u32Sequence = psHttpd->u32Sequence++;
+}
+
+
+/** Parse the requests received on a connection, while there is room for their responses */
+static void vConnectionParse(tsHttpd *psHttpd, tsHttpdConnection *psConnection)
+{
+    tsHttpRequest sRequest;
+    teHttpStatus eStatus;
+    int iQueued = 0;
+    
+    while (!psConnection->iClosing && (psConnection->u32NumResponses < HTTPD_MAX_PIPELINE) && psConnection->szBuffer)
+    {
+        eStatus = eHttpParseRequest(&sRequest, psConnection->pcBuffer, psConnection->szBuffer);
+        if (eStatus == E_HTTP_INCOMPLETE)
+        {
+            if (psConnection->szBuffer < HTTPD_BUFFER_SIZE)
+            {
+                break;
+            }
+            eStatus = E_HTTP_BAD_REQUEST;
+        }
+        if (eStatus != E_HTTP_OK)
+        {
+            /* Where the next request starts is not known, so this is the last */
+            tsHttpdResponse *psResponse = &psConnection->asResponses[
+                (psConnection->u32First + psConnection->u32NumResponses) % HTTPD_MAX_PIPELINE];
+            
+            psConnection->u32NumResponses++;
+            psConnection->iClosing = 1;
+            vResponseError(psResponse, (psConnection->szBuffer >= HTTPD_BUFFER_SIZE) ? 413 :
+                                       (eStatus == E_HTTP_UNSUPPORTED) ? 501 : 400);
+            psConnection->szBuffer = 0;
+            break;
+        }
+        
+        vConnectionRequest(psHttpd, psConnection, &sRequest);
+        iQueued |= (psConnection->asResponses[(psConnection->u32First + psConnection->u32NumResponses - 1) % 
+                                              HTTPD_MAX_PIPELINE].eState == E_HTTPD_QUEUED);
+        
+        psConnection->szBuffer -= sRequest.szLength;
+        memmove(psConnection->pcBuffer, &psConnection->pcBuffer[sRequest.szLength], psConnection->szBuffer);
+        psConnection->tActivity = tNow();
+    }
+    
+    if (iQueued)
+    {
+        vWorkersStart(psHttpd);
+    }
+}
+
+
+/** Send the responses of a connection that are ready, in order.
+ *  \return Number of responses sent, or -1 if the connection was closed */
+static int iConnectionWrite(tsHttpd *psHttpd, tsHttpdConnection *psConnection)
+{
+    int iSent = 0;
+    
+    while (psConnection->u32NumResponses)
+    {
+        tsHttpdResponse *psResponse = &psConnection->asResponses[psConnection->u32First];
+        
+        if (psResponse->eState != E_HTTPD_READY)
+        {
+            break;
+        }
+        
+        while (psResponse->szSent < psResponse->szData + psResponse->szBody)
+        {
+            struct iovec asVectors[2];
+            struct msghdr sMessage;
+            ssize_t iBytes;
+            
+            /* Head and body of an asset go together, usually in one segment */
+            memset(&sMessage, 0, sizeof(sMessage));
+            sMessage.msg_iov = asVectors;
+            if (psResponse->szSent < psResponse->szData)
+            {
+                asVectors[sMessage.msg_iovlen].iov_base = &psResponse->pcData[psResponse->szSent];
+                asVectors[sMessage.msg_iovlen].iov_len  = psResponse->szData - psResponse->szSent;
+                sMessage.msg_iovlen++;
+            }
+            if (psResponse->szBody)
+            {
+                size_t szOffset = (psResponse->szSent > psResponse->szData) ? psResponse->szSent - psResponse->szData : 0;
+                
+                asVectors[sMessage.msg_iovlen].iov_base = (void *)&psResponse->pu8Body[szOffset];
+                asVectors[sMessage.msg_iovlen].iov_len  = psResponse->szBody - szOffset;
+                sMessage.msg_iovlen++;
+            }
+            
+            iBytes = sendmsg(psConnection->iSocket, &sMessage, MSG_NOSIGNAL | (psResponse->szRemaining ? MSG_MORE : 0));
+            if (iBytes < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                {
+                    return iSent;
+                }
+                vConnectionClose(psHttpd, psConnection);
+                return -1;
+            }
+            psResponse->szSent += iBytes;
+        }
+        
+        while (psResponse->szRemaining)
+        {
+            ssize_t iBytes = sendfile(psConnection->iSocket, psResponse->iFile, &psResponse->iOffset, psResponse->szRemaining);
+            if (iBytes <= 0)
+            {
+                if ((iBytes < 0) && (errno == EINTR))
+                {
+                    continue;
+                }
+                if ((iBytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+                {
+                    return iSent;
+                }
+                /* The file was truncated under us, so the length sent is wrong */
+                vConnectionClose(psHttpd, psConnection);
+                return -1;
+            }
+            psResponse->szRemaining -= iBytes;
+        }
+        
+        if (!psResponse->iKeepAlive)
+        {
+            vConnectionClose(psHttpd, psConnection);
+            return -1;
+        }
+        vResponseFree(psResponse);
+        psConnection->u32First = (psConnection->u32First + 1) % HTTPD_MAX_PIPELINE;
+        psConnection->u32NumResponses--;
+        psConnection->tActivity = tNow();
+        iSent++;
+    }
+    return iSent;
+}
+
+
+/** Wait for the events a connection can make progress on */
+static void vConnectionEvents(tsHttpd *psHttpd, tsHttpdConnection *psConnection)
+{
+    struct epoll_event sEvent;
+    uint32_t u32Events = 0;
+    
+    if (!psConnection->iClosing && !psConnection->iEof && (psConnection->u32NumResponses < HTTPD_MAX_PIPELINE) && 
+        (psConnection->szBuffer < HTTPD_BUFFER_SIZE))
+    {
+        u32Events |= EPOLLIN;
+    }
+    if (psConnection->u32NumResponses && 
+        (psConnection->asResponses[psConnection->u32First].eState == E_HTTPD_READY))
+    {
+        /* Only left ready if the socket could not take all of it */
+        u32Events |= EPOLLOUT;
+    }
+    if (u32Events != psConnection->u32Events)
+    {
+        sEvent.events   = u32Events;
+        sEvent.data.u64 = HTTPD_EVENT(HTTPD_EVENT_CONNECTION, psConnection - psHttpd->asConnections);
+        epoll_ctl(psHttpd->iEpoll, EPOLL_CTL_MOD, psConnection->iSocket, &sEvent);
+        psConnection->u32Events = u32Events;
+    }
+}
+
+
+/** Make what progress can be made on a connection, parsing requests as responses go */
+static void vConnectionService(tsHttpd *psHttpd, tsHttpdConnection *psConnection)
+{
+    int iSent;
+    
+    do
+    {
+        vConnectionParse(psHttpd, psConnection);
+        iSent = iConnectionWrite(psHttpd, psConnection);
+        if (iSent < 0)
+        {
+            return;
+        }
+    } while (iSent && psConnection->szBuffer && !psConnection->iClosing);
+    
+    /* Requests received before the end are answered first, but a partial one never will be */
+    if ((psConnection->iClosing || psConnection->iEof) && (psConnection->u32NumResponses == 0))
+    {
+        vConnectionClose(psHttpd, psConnection);
+        return;
+    }
+    vConnectionEvents(psHttpd, psConnection);
+}
+
+
+static void vConnectionRead(tsHttpd *psHttpd, tsHttpdConnection *psConnection)
+{
+    while (psConnection->szBuffer < HTTPD_BUFFER_SIZE)
+    {
+        ssize_t iBytes = recv(psConnection->iSocket, &psConnection->pcBuffer[psConnection->szBuffer], 
+                              HTTPD_BUFFER_SIZE - psConnection->szBuffer, 0);
+        if (iBytes > 0)
+        {
+            psConnection->szBuffer += iBytes;
+            continue;
+        }
+        if (iBytes == 0)
+        {
+            /* The client has finished sending, but may still want the responses */
+            psConnection->iEof = 1;
+            break;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        {
+            vConnectionClose(psHttpd, psConnection);
+            return;
+        }
+        break;
+    }
+    vConnectionService(psHttpd, psConnection);
+}
+
+
+static void vConnectionAccept(tsHttpd *psHttpd)
+{
+    for (;;)
+    {
+        struct sockaddr_in6 sAddress;
+        socklen_t sAddressLength = sizeof(sAddress);
+        tsHttpdConnection *psConnection = NULL;
+        struct epoll_event sEvent;
+        int iSocket;
+        int iOne = 1;
+        uint32_t i;
+        
+        iSocket = accept(psHttpd->iListen, (struct sockaddr *)&sAddress, &sAddressLength);
+        if (iSocket < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            {
+                fprintf(stderr, "Failed to accept connection: %s\n", strerror(errno));
+            }
+            return;
+        }
+        if (!iSetNonBlocking(iSocket))
+        {
+            close(iSocket);
+            continue;
+        }
+        
+        for (i = 0; i < HTTPD_MAX_CONNECTIONS; i++)
+        {
+            if (psHttpd->asConnections[i].iSocket < 0)
+            {
+                psConnection = &psHttpd->asConnections[i];
+                break;
+            }
+        }
+        if (!psConnection || ((psConnection->pcBuffer = malloc(HTTPD_BUFFER_SIZE)) == NULL))
+        {
+            PRINTF("Refusing connection, %s\n", psConnection ? "out of memory" : "too many connections");
+            close(iSocket);
+            continue;
+        }
+        
+        /* Responses are written whole, so there is nothing to gain from delaying them */
+        setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+        
+        psConnection->iSocket           = iSocket;
+        psConnection->u32Events         = EPOLLIN;
+        psConnection->tActivity         = tNow();
+        psConnection->iClosing          = 0;
+        psConnection->iEof              = 0;
+        psConnection->szBuffer          = 0;
+        psConnection->u32First          = 0;
+        psConnection->u32NumResponses   = 0;
+        inet_ntop(AF_INET6, &sAddress.sin6_addr, psConnection->acAddress, sizeof(psConnection->acAddress));
+        
+        sEvent.events   = EPOLLIN;
+        sEvent.data.u64 = HTTPD_EVENT(HTTPD_EVENT_CONNECTION, i);
+        if (epoll_ctl(psHttpd->iEpoll, EPOLL_CTL_ADD, iSocket, &sEvent) < 0)
+        {
+            vConnectionClose(psHttpd, psConnection);
+            continue;
+        }
+        PRINTF("Connection %u from %s\n", i, psConnection->acAddress);
+    }
+}
+
+
+/** Close idle connections and kill workers that have run for too long */
+static void vTimeouts(tsHttpd *psHttpd, time_t tTime)
+{
+    uint32_t i;
+    
+    for (i = 0; i < HTTPD_MAX_CONNECTIONS; i++)
+    {
+        tsHttpdConnection *psConnection = &psHttpd->asConnections[i];
+        
+        if ((psConnection->iSocket >= 0) && (tTime - psConnection->tActivity > HTTPD_IDLE_TIMEOUT))
+        {
+            uint32_t j;
+            int iWaiting = 0;
+            
+            /* A client waiting for a slow program is not idle */
+            for (j = 0; j < psConnection->u32NumResponses; j++)
+            {
+                iWaiting |= (psConnection->asResponses[(psConnection->u32First + j) % HTTPD_MAX_PIPELINE].eState != E_HTTPD_READY);
+            }
+            if (!iWaiting)
+            {
+                vConnectionClose(psHttpd, psConnection);
+            }
+        }
+    }
+    
+    for (i = 0; i < HTTPD_MAX_WORKERS; i++)
+    {
+        tsHttpdWorker *psWorker = &psHttpd->asWorkers[i];
+        
+        if (psWorker->iPid && (psWorker->iFd >= 0) && !psWorker->iTimedOut &&
+            (tTime - psWorker->tStarted > HTTPD_CGI_TIMEOUT))
+        {
+            fprintf(stderr, "Killing pid %d, it has run for more than %d seconds\n", psWorker->iPid, HTTPD_CGI_TIMEOUT);
+            psWorker->iTimedOut = 1;
+            kill(psWorker->iPid, SIGKILL);
+        }
+    }
+}
+
+
+/****************************************************************************
+ * Server
+ ****************************************************************************/
+
+static int iListen(uint16_t u16Port)
+{
+    struct sockaddr_in6 sAddress;
+    int iSocket;
+    int iOne = 1;
+    int iZero = 0;
+    
+    iSocket = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (iSocket < 0)
+    {
+        return -1;
+    }
+    /* Accept IPv4 clients too, as mapped addresses */
+    setsockopt(iSocket, IPPROTO_IPV6, IPV6_V6ONLY, &iZero, sizeof(iZero));
+    setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iOne, sizeof(iOne));
+    
+    memset(&sAddress, 0, sizeof(sAddress));
+    sAddress.sin6_family    = AF_INET6;
+    sAddress.sin6_port      = htons(u16Port);
+    sAddress.sin6_addr      = in6addr_any;
+    if ((bind(iSocket, (struct sockaddr *)&sAddress, sizeof(sAddress)) < 0) || (listen(iSocket, SOMAXCONN) < 0))
+    {
+        close(iSocket);
+        return -1;
+    }
+    return iSocket;
+}
+
+
+int main(int argc, char *argv[])
+{
+    tsHttpd *psHttpd = &sHttpd;
+    struct epoll_event asEvents[HTTPD_MAX_EVENTS];
+    struct epoll_event sEvent;
+    sigset_t sSignals;
+    time_t tLastTimeouts;
+    uint32_t i, j;
+    int opt;
+    
+    psHttpd->pcRoot         = HTTPD_DEFAULT_ROOT;
+    psHttpd->u16Port        = HTTPD_DEFAULT_PORT;
+    psHttpd->u32MaxWorkers  = HTTPD_DEFAULT_WORKERS;
+    
+    while ((opt = getopt(argc, argv, "hp:r:a:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'a':
+                if (eAssetPackOpen(&psHttpd->sPack, optarg) != E_ASSET_PACK_OK)
+                {
+                    fprintf(stderr, "Invalid asset pack '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                psHttpd->iPack = 1;
+                break;
+            case 'p':
+                psHttpd->u16Port = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                psHttpd->pcRoot = optarg;
+                break;
+            case 'w':
+                psHttpd->u32MaxWorkers = strtoul(optarg, NULL, 10);
+                break;
+            case 'h':
+            default:
+                print_usage_exit(argv);
+        }
+    }
+    
+    if ((psHttpd->u32MaxWorkers == 0) || (psHttpd->u32MaxWorkers > HTTPD_MAX_WORKERS))
+    {
+        fprintf(stderr, "Invalid number of workers (%u)\n", psHttpd->u32MaxWorkers);
+        print_usage_exit(argv);
+    }
+    
+    for (i = 0; i < HTTPD_MAX_CONNECTIONS; i++)
+    {
+        psHttpd->asConnections[i].iSocket = -1;
+        for (j = 0; j < HTTPD_MAX_PIPELINE; j++)
+        {
+            psHttpd->asConnections[i].asResponses[j].iFile = -1;
+        }
+    }
+    for (i = 0; i < HTTPD_MAX_WORKERS; i++)
+    {
+        psHttpd->asWorkers[i].iFd = -1;
+    }
+    
+    /* Workers and the end of the server are signalled through the event loop */
+    signal(SIGPIPE, SIG_IGN);
+    sigemptyset(&sSignals);
+    sigaddset(&sSignals, SIGCHLD);
+    sigaddset(&sSignals, SIGINT);
+    sigaddset(&sSignals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &sSignals, NULL);
+    psHttpd->iSignals = signalfd(-1, &sSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    
+    psHttpd->iListen = iListen(psHttpd->u16Port);
+    if (psHttpd->iListen < 0)
+    {
+        fprintf(stderr, "Failed to listen on port %u: %s\n", psHttpd->u16Port, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    
+    psHttpd->iEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if ((psHttpd->iSignals < 0) || (psHttpd->iEpoll < 0))
+    {
+        fprintf(stderr, "Failed to start event loop: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    sEvent.events   = EPOLLIN;
+    sEvent.data.u64 = HTTPD_EVENT(HTTPD_EVENT_LISTEN, 0);
+    epoll_ctl(psHttpd->iEpoll, EPOLL_CTL_ADD, psHttpd->iListen, &sEvent);
+    sEvent.data.u64 = HTTPD_EVENT(HTTPD_EVENT_SIGNAL, 0);
+    epoll_ctl(psHttpd->iEpoll, EPOLL_CTL_ADD, psHttpd->iSignals, &sEvent);
+    
+    tLastTimeouts = tNow();
+    psHttpd->iRun = 1;
+    while (psHttpd->iRun)
+    {
+        int iNumEvents = epoll_wait(psHttpd->iEpoll, asEvents, HTTPD_MAX_EVENTS, 1000);
+        time_t tTime;
+        int iEvent;
+        
+        if ((iNumEvents < 0) && (errno != EINTR))
+        {
+            fprintf(stderr, "Event loop failed: %s\n", strerror(errno));
+            break;
+        }
+        
+        for (iEvent = 0; iEvent < iNumEvents; iEvent++)
+        {
+            uint32_t u32Index = (uint32_t)asEvents[iEvent].data.u64;
+            
+            switch (asEvents[iEvent].data.u64 >> 32)
+            {
+                case HTTPD_EVENT_LISTEN:
+                    vConnectionAccept(psHttpd);
+                    break;
+                    
+                case HTTPD_EVENT_SIGNAL:
+                    vWorkersReap(psHttpd);
+                    break;
+                    
+                case HTTPD_EVENT_WORKER:
+                    if (psHttpd->asWorkers[u32Index].iFd >= 0)
+                    {
+                        vWorkerRead(psHttpd, &psHttpd->asWorkers[u32Index]);
+                    }
+                    break;
+                    
+                case HTTPD_EVENT_CONNECTION:
+                {
+                    tsHttpdConnection *psConnection = &psHttpd->asConnections[u32Index];
+                    
+                    /* Closed by an earlier event of this batch */
+                    if (psConnection->iSocket < 0)
+                    {
+                        break;
+                    }
+                    if (asEvents[iEvent].events & (EPOLLERR | EPOLLHUP))
+                    {
+                        vConnectionClose(psHttpd, psConnection);
+                    }
+                    else if (asEvents[iEvent].events & EPOLLIN)
+                    {
+                        vConnectionRead(psHttpd, psConnection);
+                    }
+                    else
+                    {
+                        vConnectionService(psHttpd, psConnection);
+                    }
+                    break;
+                }
+            }
+        }
+        
+        tTime = tNow();
+        if (tTime != tLastTimeouts)
+        {
+            vTimeouts(psHttpd, tTime);
+            tLastTimeouts = tTime;
+        }
+    }
+    
+    for (i = 0; i < HTTPD_MAX_CONNECTIONS; i++)
+    {
+        if (psHttpd->asConnections[i].iSocket >= 0)
+        {
+            vConnectionClose(psHttpd, &psHttpd->asConnections[i]);
+        }
+    }
+    close(psHttpd->iListen);
+    close(psHttpd->iEpoll);
+    if (psHttpd->iPack)
+    {
+        vAssetPackClose(&psHttpd->sPack);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Multi-call CGI binary
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Multicall.h"
+
+
+int main(int argc, char *argv[])
+{
+    const char *pcName;
+    tprCgiMain prMain;
+    uint32_t i;
+    
+    /* Invoked through a link named after the program */
+    prMain = prMulticallApplet(argv[0]);
+    if (prMain)
+    {
+        return prMain(argc, argv);
+    }
+    
+    /* Run by a web server that executes the binary itself for the script */
+    prMain = prMulticallApplet(getenv("SCRIPT_NAME"));
+    if (prMain)
+    {
+        return prMain(argc, argv);
+    }
+    
+    /* Or named as the first argument */
+    if (argc > 1)
+    {
+        prMain = prMulticallApplet(argv[1]);
+        if (prMain)
+        {
+            return prMain(argc - 1, &argv[1]);
+        }
+    }
+    
+    fprintf(stderr, "Usage: %s <program> [arguments], or link to this binary as one of:\n", argv[0]);
+    for (i = 0; (pcName = pcMulticallAppletName(i)) != NULL; i++)
+    {
+        fprintf(stderr, "    %s\n", pcName);
+    }
+    return EXIT_FAILURE;
+}
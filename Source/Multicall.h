@@ -0,0 +1,79 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Multi-call CGI binary
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#ifndef __MULTICALL_H_
+#define __MULTICALL_H_
+
+#include <stdint.h>
+
+/** Name of the main function of a CGI program.
+ *  Each CGI is linked on its own as main. The multi-call build (MULTICALL
+ *  defined) links them all into one binary, which runs the one it was
+ *  invoked as. */
+#ifdef MULTICALL
+#define CGI_MAIN(applet)        applet##_main
+#else
+#define CGI_MAIN(applet)        main
+#endif /* MULTICALL */
+
+
+/** Entry points of the CGI programs in the multi-call build */
+int JIP_cgi_main(int argc, char *argv[]);
+int Browser_cgi_main(int argc, char *argv[]);
+int Smart_Devices_cgi_main(int argc, char *argv[]);
+
+
+/** Main function of a CGI program */
+typedef int (*tprCgiMain)(int argc, char *argv[]);
+
+
+/** Find the CGI program for a path, by its last component, eg. "/cgi-bin/JIP.cgi".
+ *  \param pcPath           Path, may be NULL
+ *  eturn Main function of the program, or NULL if there is none of that name
+ */
+tprCgiMain prMulticallApplet(const char *pcPath);
+
+
+/** Name of a CGI program in the multi-call build.
+ *  \param u32Index         Index of the program, from 0
+ *  eturn Name of the program, or NULL after the last one
+ */
+const char *pcMulticallAppletName(uint32_t u32Index);
+
+
+#endif /* __MULTICALL_H_ */
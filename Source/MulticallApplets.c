@@ -0,0 +1,92 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Multi-call CGI binary
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Multicall.h"
+
+
+/** Program run for each name the binary is invoked as */
+static const struct
+{
+    const char *pcName;
+    tprCgiMain  prMain;
+} asApplets[] =
+{
+    { "JIP.cgi",            JIP_cgi_main },
+    { "Browser.cgi",        Browser_cgi_main },
+    { "SmartDevices.cgi",   Smart_Devices_cgi_main },
+};
+
+#define NUM_APPLETS (sizeof(asApplets) / sizeof(asApplets[0]))
+
+
+tprCgiMain prMulticallApplet(const char *pcPath)
+{
+    const char *pcName;
+    unsigned int i;
+    
+    if (!pcPath)
+    {
+        return NULL;
+    }
+    pcName = strrchr(pcPath, '/');
+    pcName = pcName ? pcName + 1 : pcPath;
+    
+    for (i = 0; i < NUM_APPLETS; i++)
+    {
+        if (strcmp(pcName, asApplets[i].pcName) == 0)
+        {
+            return asApplets[i].prMain;
+        }
+    }
+    return NULL;
+}
+
+
+const char *pcMulticallAppletName(uint32_t u32Index)
+{
+    if (u32Index >= NUM_APPLETS)
+    {
+        return NULL;
+    }
+    return asApplets[u32Index].pcName;
+}
@@ -0,0 +1,1362 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Network cache
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <JIP.h>
+
+#include "NetworkCache.h"
+#include "NodeWalk.h"
+
+//#define DEBUG_NETWORK_CACHE
+
+#ifdef DEBUG_NETWORK_CACHE
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_NETWORK_CACHE */
+
+/** FNV-1a parameters used for the network fingerprint */
+#define FNV_OFFSET_BASIS    2166136261U
+#define FNV_PRIME           16777619U
+
+/** Number of entries the node model tables grow by */
+#define MODEL_TABLE_INCREMENT   64
+
+/** Number of times a reader tries again when a save replaces the snapshot it is opening */
+#define CACHE_OPEN_ATTEMPTS     3
+
+
+/** Growable tables used while building a node model */
+typedef struct
+{
+    tsNetworkCacheNode  *psNodes;
+    uint32_t            u32NumNodes;
+    uint32_t            u32NodesSize;
+    tsNetworkCacheMib   *psMibs;
+    uint32_t            u32NumMibs;
+    uint32_t            u32MibsSize;
+    tsNetworkCacheVar   *psVars;
+    uint32_t            u32NumVars;
+    uint32_t            u32VarsSize;
+    char                *pcStrings;
+    uint32_t            u32StringsLength;
+    uint32_t            u32StringsSize;
+} tsModelBuilder;
+
+
+static teNetworkCacheStatus eModelOpenState(tsNetworkCacheModel *psModel, const tsNetworkCacheState *psState);
+
+
+static uint32_t u32Hash(uint32_t u32Hash, const void *pvData, size_t szLength)
+{
+    const uint8_t *pu8Data = (const uint8_t *)pvData;
+    
+    while (szLength--)
+    {
+        u32Hash ^= *pu8Data++;
+        u32Hash *= FNV_PRIME;
+    }
+    return u32Hash;
+}
+
+
+/** Build the name of the temporary file that a cache file is written to before being renamed into place.
+ *  Threads of one process save too, so the name is unique to the thread */
+static void vTempFileName(char *pcBuffer, size_t szBufferLength, const char *pcFileName)
+{
+    snprintf(pcBuffer, szBufferLength, "%s.%d.%lx", pcFileName, (int)getpid(), (unsigned long)pthread_self());
+}
+
+
+void vNetworkCacheBRFileName(char *pcBuffer, size_t szBufferLength, const char *pcFileName, const struct in6_addr *psBRAddress)
+{
+    char acAddress[INET6_ADDRSTRLEN];
+    
+    inet_ntop(AF_INET6, psBRAddress, acAddress, sizeof(acAddress));
+    snprintf(pcBuffer, szBufferLength, "%s.%s", pcFileName, acAddress);
+}
+
+
+void vNetworkCacheFileName(char *pcBuffer, size_t szBufferLength, const char *pcFileName, const tsNetworkCacheState *psState)
+{
+    char acAddress[INET6_ADDRSTRLEN];
+    
+    inet_ntop(AF_INET6, &psState->sBRAddress, acAddress, sizeof(acAddress));
+    snprintf(pcBuffer, szBufferLength, "%s.%s.%08x", pcFileName, acAddress, psState->u32Generation);
+}
+
+
+/** Remove the files of a snapshot that has been replaced.
+ *  Readers that already have them open keep their copy */
+static void vRemoveFiles(const tsNetworkCacheState *psState)
+{
+    const char *apcFileNames[] = { CACHE_DEFINITIONS_FILE_NAME, CACHE_NETWORK_FILE_NAME, 
+                                   CACHE_MODEL_FILE_NAME, CACHE_CHANGELOG_FILE_NAME };
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    uint32_t i;
+    
+    for (i = 0; i < sizeof(apcFileNames) / sizeof(apcFileNames[0]); i++)
+    {
+        vNetworkCacheFileName(acFileName, sizeof(acFileName), apcFileNames[i], psState);
+        unlink(acFileName);
+    }
+}
+
+
+/** Atomically replace a cache file with the temporary file that was written */
+static teNetworkCacheStatus eCommitFile(const char *pcTempFileName, const char *pcFileName)
+{
+    if (rename(pcTempFileName, pcFileName) != 0)
+    {
+        PRINTF("Could not rename %s to %s (%s)\n", pcTempFileName, pcFileName, strerror(errno));
+        unlink(pcTempFileName);
+        return E_NETWORK_CACHE_ERROR;
+    }
+    return E_NETWORK_CACHE_OK;
+}
+
+
+teNetworkCacheRefresh eNetworkCacheRefreshPolicy(const char *pcRefresh)
+{
+    if (pcRefresh)
+    {
+        if (strcasecmp(pcRefresh, "force") == 0)
+        {
+            return E_NETWORK_CACHE_REFRESH_FORCE;
+        }
+        if (strcasecmp(pcRefresh, "no") == 0)
+        {
+            return E_NETWORK_CACHE_REFRESH_NEVER;
+        }
+    }
+    return E_NETWORK_CACHE_REFRESH_AUTO;
+}
+
+
+/** Read the state of the current snapshot of a border router */
+static teNetworkCacheStatus eReadState(const struct in6_addr *psBRAddress, tsNetworkCacheState *psState)
+{
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    FILE *psFile;
+    size_t szRead;
+    
+    vNetworkCacheBRFileName(acFileName, sizeof(acFileName), CACHE_STATE_FILE_NAME, psBRAddress);
+    psFile = fopen(acFileName, "rb");
+    if (!psFile)
+    {
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    szRead = fread(psState, 1, sizeof(tsNetworkCacheState), psFile);
+    fclose(psFile);
+    
+    if ((szRead != sizeof(tsNetworkCacheState)) || (psState->u32Magic != CACHE_STATE_MAGIC) ||
+        (memcmp(&psState->sBRAddress, psBRAddress, sizeof(struct in6_addr)) != 0))
+    {
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    return E_NETWORK_CACHE_OK;
+}
+
+
+teNetworkCacheStatus eNetworkCacheReadState(const char *pcBRAddress, tsNetworkCacheState *psState)
+{
+    struct in6_addr sBRAddress;
+    
+    if (inet_pton(AF_INET6, pcBRAddress, &sBRAddress) != 1)
+    {
+        return E_NETWORK_CACHE_ERROR;
+    }
+    return eReadState(&sBRAddress, psState);
+}
+
+
+/** Write a new state record over the current one of its border router */
+static teNetworkCacheStatus eWriteState(const tsNetworkCacheState *psState)
+{
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    char acTempFileName[CACHE_FILE_NAME_LENGTH];
+    FILE *psFile;
+    int iError = 0;
+    
+    vNetworkCacheBRFileName(acFileName, sizeof(acFileName), CACHE_STATE_FILE_NAME, &psState->sBRAddress);
+    vTempFileName(acTempFileName, sizeof(acTempFileName), acFileName);
+    
+    psFile = fopen(acTempFileName, "wb");
+    if (!psFile)
+    {
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    if (fwrite(psState, sizeof(tsNetworkCacheState), 1, psFile) != 1)
+    {
+        iError = 1;
+    }
+    if (fclose(psFile) != 0)
+    {
+        iError = 1;
+    }
+    
+    if (iError)
+    {
+        unlink(acTempFileName);
+        return E_NETWORK_CACHE_ERROR;
+    }
+    return eCommitFile(acTempFileName, acFileName);
+}
+
+
+/** Calculate the fingerprint of one node's structure */
+static uint32_t u32NodeFingerprint(tsNode *psNode)
+{
+    tsMib *psMib;
+    tsVar *psVar;
+    uint32_t u32NodeHash = FNV_OFFSET_BASIS;
+    
+    u32NodeHash = u32Hash(u32NodeHash, &psNode->sNode_Address.sin6_addr, sizeof(struct in6_addr));
+    u32NodeHash = u32Hash(u32NodeHash, &psNode->u32DeviceId, sizeof(uint32_t));
+    
+    psMib = psNode->psMibs;
+    while (psMib)
+    {
+        u32NodeHash = u32Hash(u32NodeHash, &psMib->u32MibId, sizeof(uint32_t));
+        
+        psVar = psMib->psVars;
+        while (psVar)
+        {
+            uint32_t u32VarType = psVar->eVarType;
+            
+            u32NodeHash = u32Hash(u32NodeHash, &psVar->u8Index, sizeof(uint8_t));
+            u32NodeHash = u32Hash(u32NodeHash, &u32VarType, sizeof(uint32_t));
+            psVar = psVar->psNext;
+        }
+        psMib = psMib->psNext;
+    }
+    return u32NodeHash;
+}
+
+
+uint32_t u32NetworkCacheFingerprint(tsJIP_Context *psJIP_Context, uint32_t *pu32NumNodes)
+{
+    tsNode *psNode;
+    uint32_t u32Fingerprint = 0;
+    uint32_t u32NumNodes = 0;
+    
+    eJIP_Lock(psJIP_Context);
+    
+    psNode = psJIP_Context->sNetwork.psNodes;
+    while (psNode)
+    {
+        /* Combine node hashes so that the order nodes were discovered in does not matter */
+        u32Fingerprint += u32NodeFingerprint(psNode);
+        u32NumNodes++;
+        psNode = psNode->psNext;
+    }
+    
+    eJIP_Unlock(psJIP_Context);
+    
+    if (pu32NumNodes)
+    {
+        *pu32NumNodes = u32NumNodes;
+    }
+    return u32Fingerprint;
+}
+
+
+/** Make room for one more entry in a node model table */
+static int iGrowTable(void **ppvTable, uint32_t u32NumEntries, uint32_t *pu32Size, size_t szEntry)
+{
+    void *pvNewTable;
+    
+    if (u32NumEntries < *pu32Size)
+    {
+        return 1;
+    }
+    
+    pvNewTable = realloc(*ppvTable, (*pu32Size + MODEL_TABLE_INCREMENT) * szEntry);
+    if (!pvNewTable)
+    {
+        return 0;
+    }
+    *ppvTable = pvNewTable;
+    *pu32Size += MODEL_TABLE_INCREMENT;
+    return 1;
+}
+
+
+/** Add a string to the string table of a node model.
+ *  \return Offset of the string, 0 for empty strings or on failure */
+static uint32_t u32AddString(tsModelBuilder *psBuilder, const char *pcString)
+{
+    uint32_t u32Offset;
+    size_t szLength;
+    
+    if ((!pcString) || (pcString[0] == '\0'))
+    {
+        return 0;
+    }
+    
+    szLength = strlen(pcString) + 1;
+    if (psBuilder->u32StringsLength + szLength > psBuilder->u32StringsSize)
+    {
+        uint32_t u32NewSize = psBuilder->u32StringsSize + szLength + 1024;
+        char *pcNewStrings = realloc(psBuilder->pcStrings, u32NewSize);
+        if (!pcNewStrings)
+        {
+            return 0;
+        }
+        psBuilder->pcStrings = pcNewStrings;
+        psBuilder->u32StringsSize = u32NewSize;
+    }
+    
+    u32Offset = psBuilder->u32StringsLength;
+    memcpy(&psBuilder->pcStrings[u32Offset], pcString, szLength);
+    psBuilder->u32StringsLength += szLength;
+    return u32Offset;
+}
+
+
+/** Find the descriptive name of a node.
+ *  The name from the previous model is reused if the node has not changed,
+ *  otherwise it is read from the node. */
+static const char *pcNodeName(tsJIP_Context *psJIP_Context, tsNode *psNode, uint32_t u32Fingerprint,
+                              const tsNetworkCacheModel *psOldModel, int iReadNames)
+{
+    tsMib *psMib;
+    tsVar *psVar;
+    
+    psMib = psJIP_LookupMib(psNode, NULL, "Node");
+    if (!psMib)
+    {
+        return NULL;
+    }
+    
+    psVar = psJIP_LookupVar(psMib, NULL, "DescriptiveName");
+    if ((!psVar) || (psVar->eVarType != E_JIP_VAR_TYPE_STR))
+    {
+        return NULL;
+    }
+    
+    if ((!iReadNames) && (psOldModel))
+    {
+        const tsNetworkCacheNode *psOldNode = psNetworkCacheModelLookupNode(psOldModel, &psNode->sNode_Address.sin6_addr);
+        
+        if ((psOldNode) && (psOldNode->u32Fingerprint == u32Fingerprint) && (psOldNode->u32Name != 0))
+        {
+            return pcNetworkCacheModelString(psOldModel, psOldNode->u32Name);
+        }
+    }
+    
+    if ((iReadNames) || (!psVar->pvData))
+    {
+        if (eJIP_GetVar(psJIP_Context, psVar) != E_JIP_OK)
+        {
+            return NULL;
+        }
+    }
+    return (const char *)psVar->pvData;
+}
+
+
+/** Assign the version stamp of a new node model.
+ *  The stamp of the previous snapshot is kept if the model is identical,
+ *  otherwise it is advanced. Without a previous snapshot the stamp starts
+ *  from the current time, so that a restart does not reuse old stamps. */
+static void vAssignVersion(const tsModelBuilder *psBuilder, tsNetworkCacheState *psState, const tsNetworkCacheState *psPrevState)
+{
+    uint32_t u32ModelHash = FNV_OFFSET_BASIS;
+    
+    u32ModelHash = u32Hash(u32ModelHash, psBuilder->psNodes, psBuilder->u32NumNodes * sizeof(tsNetworkCacheNode));
+    u32ModelHash = u32Hash(u32ModelHash, psBuilder->psMibs, psBuilder->u32NumMibs * sizeof(tsNetworkCacheMib));
+    u32ModelHash = u32Hash(u32ModelHash, psBuilder->psVars, psBuilder->u32NumVars * sizeof(tsNetworkCacheVar));
+    u32ModelHash = u32Hash(u32ModelHash, psBuilder->pcStrings, psBuilder->u32StringsLength);
+    
+    psState->u32ModelHash = u32ModelHash;
+    
+    if (!psPrevState)
+    {
+        psState->u32Version = (uint32_t)time(NULL);
+    }
+    else if ((psPrevState->u32ModelHash == u32ModelHash) &&
+             (memcmp(&psPrevState->sBRAddress, &psState->sBRAddress, sizeof(struct in6_addr)) == 0))
+    {
+        psState->u32Version = psPrevState->u32Version;
+    }
+    else
+    {
+        psState->u32Version = psPrevState->u32Version + 1;
+    }
+}
+
+
+/** Order node model entries by address */
+static int iCompareNodes(const void *pvA, const void *pvB)
+{
+    return memcmp(&((const tsNetworkCacheNode *)pvA)->sAddress, 
+                  &((const tsNetworkCacheNode *)pvB)->sAddress, sizeof(struct in6_addr));
+}
+
+
+/** Build the node model of the network held in a context and write it to a file.
+ *  The version stamp of the model is assigned in psState. */
+static teNetworkCacheStatus eWriteModel(tsJIP_Context *psJIP_Context, const char *pcFileName, int iReadNames,
+                                        tsNetworkCacheState *psState, const tsNetworkCacheState *psPrevState)
+{
+    tsModelBuilder sBuilder;
+    tsNodeWalk sWalk;
+    tsNetworkCacheModel sOldModel;
+    tsNetworkCacheModelHeader sHeader;
+    int iHaveOldModel;
+    tsNode *psNode;
+    tsMib *psMib;
+    tsVar *psVar;
+    FILE *psFile;
+    teNetworkCacheStatus eStatus = E_NETWORK_CACHE_ERROR;
+    
+    memset(&sBuilder, 0, sizeof(tsModelBuilder));
+    
+    /* Offset 0 of the string table is always the empty string */
+    sBuilder.pcStrings = malloc(1024);
+    if (!sBuilder.pcStrings)
+    {
+        return E_NETWORK_CACHE_ERROR;
+    }
+    sBuilder.pcStrings[0] = '\0';
+    sBuilder.u32StringsLength = 1;
+    sBuilder.u32StringsSize = 1024;
+    
+    iHaveOldModel = psPrevState && (eModelOpenState(&sOldModel, psPrevState) == E_NETWORK_CACHE_OK);
+    
+    /* Node names may be read from the network, so only the node being
+     * added is locked - JIPd carries on serving requests for the others */
+    if (eNodeWalkStart(&sWalk, psJIP_Context, JIP_DEVICEID_ALL) != E_JIP_OK)
+    {
+        goto done;
+    }
+    
+    for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
+    {
+        tsNetworkCacheNode *psModelNode;
+        
+        if (!iGrowTable((void **)&sBuilder.psNodes, sBuilder.u32NumNodes, &sBuilder.u32NodesSize, sizeof(tsNetworkCacheNode)))
+        {
+            vNodeWalkEnd(&sWalk);
+            goto done;
+        }
+        psModelNode = &sBuilder.psNodes[sBuilder.u32NumNodes++];
+        
+        psModelNode->sAddress       = psNode->sNode_Address.sin6_addr;
+        psModelNode->u32DeviceId    = psNode->u32DeviceId;
+        psModelNode->u32Fingerprint = u32NodeFingerprint(psNode);
+        psModelNode->u32Name        = u32AddString(&sBuilder, pcNodeName(psJIP_Context, psNode, psModelNode->u32Fingerprint, 
+                                                                         iHaveOldModel ? &sOldModel : NULL, iReadNames));
+        psModelNode->u32FirstMib    = sBuilder.u32NumMibs;
+        psModelNode->u32NumMibs     = 0;
+        
+        psMib = psNode->psMibs;
+        while (psMib)
+        {
+            tsNetworkCacheMib *psModelMib;
+            
+            if (!iGrowTable((void **)&sBuilder.psMibs, sBuilder.u32NumMibs, &sBuilder.u32MibsSize, sizeof(tsNetworkCacheMib)))
+            {
+                vNodeWalkEnd(&sWalk);
+                goto done;
+            }
+            psModelMib = &sBuilder.psMibs[sBuilder.u32NumMibs++];
+            psModelNode->u32NumMibs++;
+            
+            psModelMib->u32MibId    = psMib->u32MibId;
+            psModelMib->u32Name     = u32AddString(&sBuilder, psMib->pcName);
+            psModelMib->u32FirstVar = sBuilder.u32NumVars;
+            psModelMib->u32NumVars  = 0;
+            
+            psVar = psMib->psVars;
+            while (psVar)
+            {
+                tsNetworkCacheVar *psModelVar;
+                
+                if (!iGrowTable((void **)&sBuilder.psVars, sBuilder.u32NumVars, &sBuilder.u32VarsSize, sizeof(tsNetworkCacheVar)))
+                {
+                    vNodeWalkEnd(&sWalk);
+                    goto done;
+                }
+                psModelVar = &sBuilder.psVars[sBuilder.u32NumVars++];
+                psModelMib->u32NumVars++;
+                
+                psModelVar->u32Name         = u32AddString(&sBuilder, psVar->pcName);
+                psModelVar->u8Index         = psVar->u8Index;
+                psModelVar->u8VarType       = psVar->eVarType;
+                psModelVar->u8AccessType    = psVar->eAccessType;
+                psModelVar->u8Security      = psVar->eSecurity;
+                psVar = psVar->psNext;
+            }
+            psMib = psMib->psNext;
+        }
+    }
+    
+    vNodeWalkEnd(&sWalk);
+    
+    /* Sorted so that nodes can be looked up with a binary search */
+    if (sBuilder.u32NumNodes)
+    {
+        qsort(sBuilder.psNodes, sBuilder.u32NumNodes, sizeof(tsNetworkCacheNode), iCompareNodes);
+    }
+    
+    vAssignVersion(&sBuilder, psState, psPrevState);
+    
+    sHeader.u32Magic            = CACHE_MODEL_MAGIC;
+    sHeader.u32NumNodes         = sBuilder.u32NumNodes;
+    sHeader.u32NumMibs          = sBuilder.u32NumMibs;
+    sHeader.u32NumVars          = sBuilder.u32NumVars;
+    sHeader.u32StringsLength    = sBuilder.u32StringsLength;
+    sHeader.u32Version          = psState->u32Version;
+    sHeader.u32Generation       = psState->u32Generation;
+    
+    psFile = fopen(pcFileName, "wb");
+    if (!psFile)
+    {
+        goto done;
+    }
+    
+    if ((fwrite(&sHeader, sizeof(tsNetworkCacheModelHeader), 1, psFile) == 1) &&
+        (fwrite(sBuilder.psNodes, sizeof(tsNetworkCacheNode), sBuilder.u32NumNodes, psFile) == sBuilder.u32NumNodes) &&
+        (fwrite(sBuilder.psMibs, sizeof(tsNetworkCacheMib), sBuilder.u32NumMibs, psFile) == sBuilder.u32NumMibs) &&
+        (fwrite(sBuilder.psVars, sizeof(tsNetworkCacheVar), sBuilder.u32NumVars, psFile) == sBuilder.u32NumVars) &&
+        (fwrite(sBuilder.pcStrings, 1, sBuilder.u32StringsLength, psFile) == sBuilder.u32StringsLength))
+    {
+        eStatus = E_NETWORK_CACHE_OK;
+    }
+    
+    if (fclose(psFile) != 0)
+    {
+        eStatus = E_NETWORK_CACHE_ERROR;
+    }
+    
+    PRINTF("Wrote node model of %u nodes, %u MiBs, %u variables\n", 
+           sBuilder.u32NumNodes, sBuilder.u32NumMibs, sBuilder.u32NumVars);
+    
+done:
+    if (iHaveOldModel)
+    {
+        vNetworkCacheModelClose(&sOldModel);
+    }
+    free(sBuilder.psNodes);
+    free(sBuilder.psMibs);
+    free(sBuilder.psVars);
+    free(sBuilder.pcStrings);
+    return eStatus;
+}
+
+
+/** Compare version stamps, allowing for wrap around.
+ *  \return non-zero if u32A is a later version than u32B */
+static int iVersionAfter(uint32_t u32A, uint32_t u32B)
+{
+    return (int32_t)(u32A - u32B) > 0;
+}
+
+
+/** Hash everything a client is sent about a node in a node model */
+static uint32_t u32ModelNodeHash(const tsNetworkCacheModel *psModel, const tsNetworkCacheNode *psNode)
+{
+    const char *pcString;
+    uint32_t u32NodeHash = FNV_OFFSET_BASIS;
+    uint32_t i, j;
+    
+    u32NodeHash = u32Hash(u32NodeHash, &psNode->u32DeviceId, sizeof(uint32_t));
+    pcString = pcNetworkCacheModelString(psModel, psNode->u32Name);
+    u32NodeHash = u32Hash(u32NodeHash, pcString, strlen(pcString) + 1);
+    
+    for (i = 0; i < psNode->u32NumMibs; i++)
+    {
+        const tsNetworkCacheMib *psMib = &psModel->psMibs[psNode->u32FirstMib + i];
+        
+        u32NodeHash = u32Hash(u32NodeHash, &psMib->u32MibId, sizeof(uint32_t));
+        pcString = pcNetworkCacheModelString(psModel, psMib->u32Name);
+        u32NodeHash = u32Hash(u32NodeHash, pcString, strlen(pcString) + 1);
+        
+        for (j = 0; j < psMib->u32NumVars; j++)
+        {
+            const tsNetworkCacheVar *psVar = &psModel->psVars[psMib->u32FirstVar + j];
+            
+            pcString = pcNetworkCacheModelString(psModel, psVar->u32Name);
+            u32NodeHash = u32Hash(u32NodeHash, pcString, strlen(pcString) + 1);
+            u32NodeHash = u32Hash(u32NodeHash, &psVar->u8Index, sizeof(uint8_t));
+            u32NodeHash = u32Hash(u32NodeHash, &psVar->u8VarType, sizeof(uint8_t));
+            u32NodeHash = u32Hash(u32NodeHash, &psVar->u8AccessType, sizeof(uint8_t));
+            u32NodeHash = u32Hash(u32NodeHash, &psVar->u8Security, sizeof(uint8_t));
+        }
+    }
+    return u32NodeHash;
+}
+
+
+/** Read the changelog of a snapshot.
+ *  \return Pointer to malloc'd header followed by the entries, or NULL if there is no valid changelog */
+static tsNetworkCacheChangelogHeader *psReadChangelog(const tsNetworkCacheState *psState)
+{
+    tsNetworkCacheChangelogHeader sHeader;
+    tsNetworkCacheChangelogHeader *psChangelog;
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    size_t szEntries;
+    FILE *psFile;
+    
+    vNetworkCacheFileName(acFileName, sizeof(acFileName), CACHE_CHANGELOG_FILE_NAME, psState);
+    psFile = fopen(acFileName, "rb");
+    if (!psFile)
+    {
+        return NULL;
+    }
+    
+    if ((fread(&sHeader, sizeof(tsNetworkCacheChangelogHeader), 1, psFile) != 1) ||
+        (sHeader.u32Magic != CACHE_CHANGELOG_MAGIC) ||
+        (sHeader.u32Generation != psState->u32Generation) ||
+        (sHeader.u32NumEntries > CACHE_CHANGELOG_ENTRIES))
+    {
+        fclose(psFile);
+        return NULL;
+    }
+    
+    szEntries = sHeader.u32NumEntries * sizeof(tsNetworkCacheChange);
+    psChangelog = malloc(sizeof(tsNetworkCacheChangelogHeader) + szEntries);
+    if (!psChangelog)
+    {
+        fclose(psFile);
+        return NULL;
+    }
+    *psChangelog = sHeader;
+    
+    if ((szEntries) && (fread(&psChangelog[1], szEntries, 1, psFile) != 1))
+    {
+        free(psChangelog);
+        psChangelog = NULL;
+    }
+    fclose(psFile);
+    return psChangelog;
+}
+
+
+/** Record the nodes that differ between two node models in the changelog of the new one.
+ *  Changes already recorded are carried over if they lead up to the old model,
+ *  and the oldest versions are dropped to keep the changelog bounded. */
+static teNetworkCacheStatus eWriteChangelog(const char *pcFileName, const tsNetworkCacheModel *psOldModel, 
+                                            const tsNetworkCacheModel *psNewModel)
+{
+    tsNetworkCacheChangelogHeader *psOld;
+    tsNetworkCacheChangelogHeader sHeader;
+    tsNetworkCacheChange *psChanges;
+    const tsNetworkCacheChange *psOldChanges = NULL;
+    uint32_t u32NumChanges = 0;
+    uint32_t u32First;
+    uint32_t u32MaxChanges;
+    uint32_t i;
+    FILE *psFile;
+    int iError = 0;
+    
+    u32MaxChanges = psOldModel->psHeader->u32NumNodes + psNewModel->psHeader->u32NumNodes;
+    
+    sHeader.u32Magic    = CACHE_CHANGELOG_MAGIC;
+    sHeader.u32Oldest   = psOldModel->psHeader->u32Version;
+    sHeader.u32Newest   = psNewModel->psHeader->u32Version;
+    sHeader.u32Generation = psNewModel->psHeader->u32Generation;
+    
+    psOld = psReadChangelog(&psOldModel->sState);
+    if ((psOld) && (psOld->u32Newest == psOldModel->psHeader->u32Version))
+    {
+        /* Existing changes lead up to the old model - keep them */
+        psOldChanges = (const tsNetworkCacheChange *)&psOld[1];
+        sHeader.u32Oldest = psOld->u32Oldest;
+        u32MaxChanges += psOld->u32NumEntries;
+    }
+    
+    psChanges = malloc((u32MaxChanges + 1) * sizeof(tsNetworkCacheChange));
+    if (!psChanges)
+    {
+        free(psOld);
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    if (psOldChanges)
+    {
+        memcpy(psChanges, psOldChanges, psOld->u32NumEntries * sizeof(tsNetworkCacheChange));
+        u32NumChanges = psOld->u32NumEntries;
+    }
+    free(psOld);
+    
+    /* Nodes that were added or changed */
+    for (i = 0; i < psNewModel->psHeader->u32NumNodes; i++)
+    {
+        const tsNetworkCacheNode *psNewNode = &psNewModel->psNodes[i];
+        const tsNetworkCacheNode *psOldNode = psNetworkCacheModelLookupNode(psOldModel, &psNewNode->sAddress);
+        
+        if ((!psOldNode) || (u32ModelNodeHash(psOldModel, psOldNode) != u32ModelNodeHash(psNewModel, psNewNode)))
+        {
+            psChanges[u32NumChanges].sAddress   = psNewNode->sAddress;
+            psChanges[u32NumChanges].u32Version = sHeader.u32Newest;
+            u32NumChanges++;
+        }
+    }
+    
+    /* Nodes that were removed */
+    for (i = 0; i < psOldModel->psHeader->u32NumNodes; i++)
+    {
+        if (!psNetworkCacheModelLookupNode(psNewModel, &psOldModel->psNodes[i].sAddress))
+        {
+            psChanges[u32NumChanges].sAddress   = psOldModel->psNodes[i].sAddress;
+            psChanges[u32NumChanges].u32Version = sHeader.u32Newest;
+            u32NumChanges++;
+        }
+    }
+    
+    /* Drop whole versions until the changelog fits. Clients that held a
+     * dropped version can no longer be brought up to date with deltas. */
+    u32First = 0;
+    while (u32NumChanges - u32First > CACHE_CHANGELOG_ENTRIES)
+    {
+        uint32_t u32Dropped = psChanges[u32First].u32Version;
+        
+        while ((u32First < u32NumChanges) && (psChanges[u32First].u32Version == u32Dropped))
+        {
+            u32First++;
+        }
+        sHeader.u32Oldest = u32Dropped;
+    }
+    sHeader.u32NumEntries = u32NumChanges - u32First;
+    
+    PRINTF("Changelog holds %u changes from version 0x%08x to 0x%08x\n", 
+           sHeader.u32NumEntries, sHeader.u32Oldest, sHeader.u32Newest);
+    
+    psFile = fopen(pcFileName, "wb");
+    if (!psFile)
+    {
+        free(psChanges);
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    if ((fwrite(&sHeader, sizeof(tsNetworkCacheChangelogHeader), 1, psFile) != 1) ||
+        (fwrite(&psChanges[u32First], sizeof(tsNetworkCacheChange), sHeader.u32NumEntries, psFile) != sHeader.u32NumEntries))
+    {
+        iError = 1;
+    }
+    if (fclose(psFile) != 0)
+    {
+        iError = 1;
+    }
+    free(psChanges);
+    
+    if (iError)
+    {
+        unlink(pcFileName);
+        return E_NETWORK_CACHE_ERROR;
+    }
+    return E_NETWORK_CACHE_OK;
+}
+
+
+/** Write the changelog of a new snapshot, from the changes since the previous one.
+ *  Without a previous node model no changelog is written, so clients are sent the whole network */
+static void vUpdateChangelog(const char *pcFileName, const tsNetworkCacheState *psOldState, const tsNetworkCacheState *psNewState)
+{
+    tsNetworkCacheModel sOldModel;
+    tsNetworkCacheModel sNewModel;
+    
+    if (eModelOpenState(&sOldModel, psOldState) != E_NETWORK_CACHE_OK)
+    {
+        return;
+    }
+    if (eModelOpenState(&sNewModel, psNewState) == E_NETWORK_CACHE_OK)
+    {
+        (void)eWriteChangelog(pcFileName, &sOldModel, &sNewModel);
+        vNetworkCacheModelClose(&sNewModel);
+    }
+    vNetworkCacheModelClose(&sOldModel);
+}
+
+
+/** Take the lock that saves of a border router's snapshot are serialised with.
+ *  \return File descriptor holding the lock, or -1 on failure */
+static int iLockSaves(const struct in6_addr *psBRAddress)
+{
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    int iFd;
+    
+    vNetworkCacheBRFileName(acFileName, sizeof(acFileName), CACHE_LOCK_FILE_NAME, psBRAddress);
+    iFd = open(acFileName, O_RDWR | O_CREAT, 0666);
+    if (iFd < 0)
+    {
+        return -1;
+    }
+    
+    /* The cgi programs save too, and may not run as the same user as JIPd */
+    (void)fchmod(iFd, 0666);
+    
+    if (flock(iFd, LOCK_EX) != 0)
+    {
+        close(iFd);
+        return -1;
+    }
+    return iFd;
+}
+
+
+teNetworkCacheStatus eNetworkCacheSave(tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                       int64_t i64NextRefresh, int iReadNames, int *piChanged)
+{
+    tsNetworkCacheState sState;
+    tsNetworkCacheState sOldState;
+    char acDefinitionsFileName[CACHE_FILE_NAME_LENGTH];
+    char acNetworkFileName[CACHE_FILE_NAME_LENGTH];
+    char acModelFileName[CACHE_FILE_NAME_LENGTH];
+    char acChangelogFileName[CACHE_FILE_NAME_LENGTH];
+    teNetworkCacheStatus eStatus = E_NETWORK_CACHE_ERROR;
+    int iHaveOldState;
+    int iLockFd;
+    
+    memset(&sState, 0, sizeof(tsNetworkCacheState));
+    sState.u32Magic = CACHE_STATE_MAGIC;
+    
+    if (inet_pton(AF_INET6, pcBRAddress, &sState.sBRAddress) != 1)
+    {
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    sState.u32Fingerprint   = u32NetworkCacheFingerprint(psJIP_Context, &sState.u32NumNodes);
+    sState.i64Refreshed     = time(NULL);
+    sState.i64Changed       = sState.i64Refreshed;
+    sState.i64NextRefresh   = i64NextRefresh;
+    
+    /* Each generation follows on from the previous state, so saves must not overlap */
+    iLockFd = iLockSaves(&sState.sBRAddress);
+    if (iLockFd < 0)
+    {
+        PRINTF("Could not lock snapshot of %s (%s)\n", pcBRAddress, strerror(errno));
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    iHaveOldState = (eReadState(&sState.sBRAddress, &sOldState) == E_NETWORK_CACHE_OK);
+    
+    if (iHaveOldState)
+    {
+        if (sOldState.u32Fingerprint == sState.u32Fingerprint)
+        {
+            sState.i64Changed = sOldState.i64Changed;
+        }
+        if (i64NextRefresh == 0)
+        {
+            /* Not saved by the scheduler - don't lose track of its next run */
+            sState.i64NextRefresh = sOldState.i64NextRefresh;
+        }
+    }
+    
+    /* Without a previous snapshot the generation starts from the current time,
+     * so that files a reader of an earlier snapshot still has open are not reused */
+    sState.u32Generation = iHaveOldState ? sOldState.u32Generation + 1 : (uint32_t)time(NULL);
+    
+    if (piChanged)
+    {
+        *piChanged = !iHaveOldState || (sOldState.u32Fingerprint != sState.u32Fingerprint);
+    }
+    
+    /* Nothing refers to the files of the new generation until its state
+     * is written, so they are written in place */
+    vNetworkCacheFileName(acDefinitionsFileName, sizeof(acDefinitionsFileName), CACHE_DEFINITIONS_FILE_NAME, &sState);
+    vNetworkCacheFileName(acNetworkFileName, sizeof(acNetworkFileName), CACHE_NETWORK_FILE_NAME, &sState);
+    vNetworkCacheFileName(acModelFileName, sizeof(acModelFileName), CACHE_MODEL_FILE_NAME, &sState);
+    vNetworkCacheFileName(acChangelogFileName, sizeof(acChangelogFileName), CACHE_CHANGELOG_FILE_NAME, &sState);
+    
+    if ((eJIPService_PersistXMLSaveDefinitions(psJIP_Context, acDefinitionsFileName) == E_JIP_OK) &&
+        (eJIPService_PersistXMLSaveNetwork(psJIP_Context, acNetworkFileName) == E_JIP_OK) &&
+        (eWriteModel(psJIP_Context, acModelFileName, iReadNames, &sState, iHaveOldState ? &sOldState : NULL) == E_NETWORK_CACHE_OK))
+    {
+        if (iHaveOldState)
+        {
+            vUpdateChangelog(acChangelogFileName, &sOldState, &sState);
+        }
+        eStatus = eWriteState(&sState);
+    }
+    
+    if (eStatus == E_NETWORK_CACHE_OK)
+    {
+        PRINTF("Saved snapshot of %u nodes, fingerprint 0x%08x, version 0x%08x, generation 0x%08x\n", 
+               sState.u32NumNodes, sState.u32Fingerprint, sState.u32Version, sState.u32Generation);
+        if (iHaveOldState)
+        {
+            vRemoveFiles(&sOldState);
+        }
+    }
+    else
+    {
+        vRemoveFiles(&sState);
+    }
+    
+    close(iLockFd);
+    return eStatus;
+}
+
+
+/** Decide whether the current snapshot of a border router can be used under a refresh policy */
+static int iSnapshotUsable(const char *pcBRAddress, teNetworkCacheRefresh eRefresh, tsNetworkCacheState *psState)
+{
+    if ((eRefresh != E_NETWORK_CACHE_REFRESH_FORCE) &&
+        (eNetworkCacheReadState(pcBRAddress, psState) == E_NETWORK_CACHE_OK))
+    {
+        if (eRefresh == E_NETWORK_CACHE_REFRESH_NEVER)
+        {
+            return 1;
+        }
+        else if ((psState->i64NextRefresh != 0) && (time(NULL) <= psState->i64NextRefresh + CACHE_SCHEDULER_GRACE))
+        {
+            /* The scheduler is keeping the snapshot fresh */
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+teNetworkCacheStatus eNetworkCacheLoadDefinitions(tsJIP_Context *psJIP_Context, const char *pcBRAddress)
+{
+    tsNetworkCacheState sState;
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    int i;
+    
+    /* A save may replace the snapshot between its state being read and the file being opened */
+    for (i = 0; (i < CACHE_OPEN_ATTEMPTS) && (eNetworkCacheReadState(pcBRAddress, &sState) == E_NETWORK_CACHE_OK); i++)
+    {
+        vNetworkCacheFileName(acFileName, sizeof(acFileName), CACHE_DEFINITIONS_FILE_NAME, &sState);
+        if (eJIPService_PersistXMLLoadDefinitions(psJIP_Context, acFileName) == E_JIP_OK)
+        {
+            return E_NETWORK_CACHE_OK;
+        }
+    }
+    return E_NETWORK_CACHE_NO_SNAPSHOT;
+}
+
+
+teNetworkCacheStatus eNetworkCacheVersion(const char *pcBRAddress, teNetworkCacheRefresh eRefresh, uint32_t *pu32Version)
+{
+    tsNetworkCacheState sState;
+    
+    if (!iSnapshotUsable(pcBRAddress, eRefresh, &sState))
+    {
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    *pu32Version = sState.u32Version;
+    return E_NETWORK_CACHE_OK;
+}
+
+
+/** Work out the age of a snapshot */
+static int iSnapshotAge(const tsNetworkCacheState *psState)
+{
+    time_t tNow = time(NULL);
+    
+    return (tNow > psState->i64Refreshed) ? (int)(tNow - psState->i64Refreshed) : 0;
+}
+
+
+/** Discover the network synchronously and save it as the new snapshot.
+ *  Definitions must already be loaded into the context if they are available. */
+static teJIP_Status eDiscover(tsJIP_Context *psJIP_Context, const char *pcBRAddress, teNetworkCacheRefresh eRefresh)
+{
+    teJIP_Status eStatus;
+    
+    PRINTF("Discovering network synchronously\n");
+    
+    eStatus = eJIPService_DiscoverNetwork(psJIP_Context);
+    if (eStatus != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    
+    /* A forced refresh is the user's way to pick up renamed nodes */
+    (void)eNetworkCacheSave(psJIP_Context, pcBRAddress, 0, eRefresh == E_NETWORK_CACHE_REFRESH_FORCE, NULL);
+    return E_JIP_OK;
+}
+
+
+teJIP_Status eNetworkCacheAcquire(tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                  teNetworkCacheRefresh eRefresh, int *piAge)
+{
+    tsNetworkCacheState sState;
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    int i;
+    
+    if (piAge)
+    {
+        *piAge = 0;
+    }
+    
+    for (i = 0; (i < CACHE_OPEN_ATTEMPTS) && iSnapshotUsable(pcBRAddress, eRefresh, &sState); i++)
+    {
+        /* The network is only loaded with the definitions saved alongside it */
+        vNetworkCacheFileName(acFileName, sizeof(acFileName), CACHE_DEFINITIONS_FILE_NAME, &sState);
+        if (eJIPService_PersistXMLLoadDefinitions(psJIP_Context, acFileName) != E_JIP_OK)
+        {
+            /* Replaced by a save since the state was read */
+            continue;
+        }
+        
+        vNetworkCacheFileName(acFileName, sizeof(acFileName), CACHE_NETWORK_FILE_NAME, &sState);
+        if (eJIPService_PersistXMLLoadNetwork(psJIP_Context, acFileName) == E_JIP_OK)
+        {
+            if (piAge)
+            {
+                *piAge = iSnapshotAge(&sState);
+            }
+            return E_JIP_OK;
+        }
+        // Couldn't load the network file, fall back to discovery with the definitions loaded.
+        return eDiscover(psJIP_Context, pcBRAddress, eRefresh);
+    }
+    
+    /* Load the cached device id's - speeds up discovery */
+    (void)eNetworkCacheLoadDefinitions(psJIP_Context, pcBRAddress);
+    
+    return eDiscover(psJIP_Context, pcBRAddress, eRefresh);
+}
+
+
+teJIP_Status eNetworkCacheAcquireModel(tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                       teNetworkCacheRefresh eRefresh, tsNetworkCacheModel *psModel, int *piAge)
+{
+    tsNetworkCacheState sState;
+    teJIP_Status eStatus;
+    int i;
+    
+    if (piAge)
+    {
+        *piAge = 0;
+    }
+    
+    for (i = 0; (i < CACHE_OPEN_ATTEMPTS) && iSnapshotUsable(pcBRAddress, eRefresh, &sState); i++)
+    {
+        if (eModelOpenState(psModel, &sState) == E_NETWORK_CACHE_OK)
+        {
+            if (piAge)
+            {
+                *piAge = iSnapshotAge(&sState);
+            }
+            return E_JIP_OK;
+        }
+        // Couldn't open the model - it may have been replaced by a save since the state was read.
+    }
+    
+    (void)eNetworkCacheLoadDefinitions(psJIP_Context, pcBRAddress);
+    
+    eStatus = eDiscover(psJIP_Context, pcBRAddress, eRefresh);
+    if (eStatus != E_JIP_OK)
+    {
+        return eStatus;
+    }
+    
+    if (eNetworkCacheModelOpen(psModel, pcBRAddress) != E_NETWORK_CACHE_OK)
+    {
+        return E_JIP_ERROR_FAILED;
+    }
+    return E_JIP_OK;
+}
+
+
+/** Map a node model file, written by the save of a generation */
+static teNetworkCacheStatus eModelOpenFile(tsNetworkCacheModel *psModel, const char *pcFileName, uint32_t u32Generation)
+{
+    const tsNetworkCacheModelHeader *psHeader;
+    struct stat sStat;
+    size_t szExpected;
+    uint32_t i;
+    int iFd;
+    
+    memset(psModel, 0, sizeof(tsNetworkCacheModel));
+    
+    iFd = open(pcFileName, O_RDONLY);
+    if (iFd < 0)
+    {
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    if ((fstat(iFd, &sStat) != 0) || (sStat.st_size < (off_t)sizeof(tsNetworkCacheModelHeader)))
+    {
+        close(iFd);
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    psModel->szMap = sStat.st_size;
+    psModel->pvMap = mmap(NULL, psModel->szMap, PROT_READ, MAP_SHARED, iFd, 0);
+    close(iFd);
+    
+    if (psModel->pvMap == MAP_FAILED)
+    {
+        psModel->pvMap = NULL;
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    psHeader = (const tsNetworkCacheModelHeader *)psModel->pvMap;
+    if ((psHeader->u32NumNodes > psModel->szMap / sizeof(tsNetworkCacheNode)) ||
+        (psHeader->u32NumMibs  > psModel->szMap / sizeof(tsNetworkCacheMib)) ||
+        (psHeader->u32NumVars  > psModel->szMap / sizeof(tsNetworkCacheVar)))
+    {
+        PRINTF("Node model is corrupt\n");
+        vNetworkCacheModelClose(psModel);
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    szExpected = sizeof(tsNetworkCacheModelHeader) +
+                 (size_t)psHeader->u32NumNodes * sizeof(tsNetworkCacheNode) +
+                 (size_t)psHeader->u32NumMibs  * sizeof(tsNetworkCacheMib) +
+                 (size_t)psHeader->u32NumVars  * sizeof(tsNetworkCacheVar) +
+                 psHeader->u32StringsLength;
+    
+    if ((psHeader->u32Magic != CACHE_MODEL_MAGIC) || (psHeader->u32Generation != u32Generation) ||
+        (szExpected != psModel->szMap) || (psHeader->u32StringsLength == 0))
+    {
+        PRINTF("Node model is corrupt\n");
+        vNetworkCacheModelClose(psModel);
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    psModel->psHeader   = psHeader;
+    psModel->psNodes    = (const tsNetworkCacheNode *)&psHeader[1];
+    psModel->psMibs     = (const tsNetworkCacheMib *)&psModel->psNodes[psHeader->u32NumNodes];
+    psModel->psVars     = (const tsNetworkCacheVar *)&psModel->psMibs[psHeader->u32NumMibs];
+    psModel->pcStrings  = (const char *)&psModel->psVars[psHeader->u32NumVars];
+    
+    if (psModel->pcStrings[psHeader->u32StringsLength - 1] != '\0')
+    {
+        PRINTF("Node model string table is not terminated\n");
+        vNetworkCacheModelClose(psModel);
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    /* The subtrees are indexed without further checks, so a stale or
+     * truncated file must not point outside the tables. Nodes are looked
+     * up with a binary search, so they must be in order */
+    for (i = 0; i < psHeader->u32NumNodes; i++)
+    {
+        const tsNetworkCacheNode *psNode = &psModel->psNodes[i];
+        
+        if ((psNode->u32FirstMib > psHeader->u32NumMibs) ||
+            (psNode->u32NumMibs > psHeader->u32NumMibs - psNode->u32FirstMib))
+        {
+            PRINTF("Node model node %u has MiBs out of range\n", i);
+            vNetworkCacheModelClose(psModel);
+            return E_NETWORK_CACHE_NO_SNAPSHOT;
+        }
+        if ((i > 0) && (iCompareNodes(&psModel->psNodes[i - 1], psNode) >= 0))
+        {
+            PRINTF("Node model node %u is out of order\n", i);
+            vNetworkCacheModelClose(psModel);
+            return E_NETWORK_CACHE_NO_SNAPSHOT;
+        }
+    }
+    for (i = 0; i < psHeader->u32NumMibs; i++)
+    {
+        const tsNetworkCacheMib *psMib = &psModel->psMibs[i];
+        
+        if ((psMib->u32FirstVar > psHeader->u32NumVars) ||
+            (psMib->u32NumVars > psHeader->u32NumVars - psMib->u32FirstVar))
+        {
+            PRINTF("Node model MiB %u has variables out of range\n", i);
+            vNetworkCacheModelClose(psModel);
+            return E_NETWORK_CACHE_NO_SNAPSHOT;
+        }
+    }
+    return E_NETWORK_CACHE_OK;
+}
+
+
+/** Map the node model of a snapshot */
+static teNetworkCacheStatus eModelOpenState(tsNetworkCacheModel *psModel, const tsNetworkCacheState *psState)
+{
+    char acFileName[CACHE_FILE_NAME_LENGTH];
+    teNetworkCacheStatus eStatus;
+    
+    vNetworkCacheFileName(acFileName, sizeof(acFileName), CACHE_MODEL_FILE_NAME, psState);
+    eStatus = eModelOpenFile(psModel, acFileName, psState->u32Generation);
+    if (eStatus == E_NETWORK_CACHE_OK)
+    {
+        psModel->sState = *psState;
+    }
+    return eStatus;
+}
+
+
+teNetworkCacheStatus eNetworkCacheModelOpen(tsNetworkCacheModel *psModel, const char *pcBRAddress)
+{
+    tsNetworkCacheState sState;
+    int i;
+    
+    /* A save may replace the snapshot between its state being read and the model being opened */
+    for (i = 0; (i < CACHE_OPEN_ATTEMPTS) && (eNetworkCacheReadState(pcBRAddress, &sState) == E_NETWORK_CACHE_OK); i++)
+    {
+        if (eModelOpenState(psModel, &sState) == E_NETWORK_CACHE_OK)
+        {
+            return E_NETWORK_CACHE_OK;
+        }
+    }
+    return E_NETWORK_CACHE_NO_SNAPSHOT;
+}
+
+
+void vNetworkCacheModelClose(tsNetworkCacheModel *psModel)
+{
+    if (psModel->pvMap)
+    {
+        munmap(psModel->pvMap, psModel->szMap);
+    }
+    memset(psModel, 0, sizeof(tsNetworkCacheModel));
+}
+
+
+teNetworkCacheStatus eNetworkCacheChanges(const tsNetworkCacheModel *psModel, uint32_t u32Since,
+                                          struct in6_addr **ppsAddresses, uint32_t *pu32NumAddresses)
+{
+    tsNetworkCacheChangelogHeader *psChangelog;
+    const tsNetworkCacheChange *psChanges;
+    struct in6_addr *psAddresses;
+    uint32_t u32Version = psModel->psHeader->u32Version;
+    uint32_t u32NumAddresses = 0;
+    uint32_t i, j;
+    
+    *ppsAddresses = NULL;
+    *pu32NumAddresses = 0;
+    
+    if (u32Since == u32Version)
+    {
+        return E_NETWORK_CACHE_OK;
+    }
+    
+    psChangelog = psReadChangelog(&psModel->sState);
+    if (!psChangelog)
+    {
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    if (iVersionAfter(psChangelog->u32Oldest, u32Since) || 
+        iVersionAfter(u32Version, psChangelog->u32Newest) ||
+        iVersionAfter(u32Since, u32Version))
+    {
+        PRINTF("Changelog (0x%08x - 0x%08x) does not cover 0x%08x - 0x%08x\n", 
+               psChangelog->u32Oldest, psChangelog->u32Newest, u32Since, u32Version);
+        free(psChangelog);
+        return E_NETWORK_CACHE_NO_SNAPSHOT;
+    }
+    
+    psAddresses = malloc((psChangelog->u32NumEntries + 1) * sizeof(struct in6_addr));
+    if (!psAddresses)
+    {
+        free(psChangelog);
+        return E_NETWORK_CACHE_ERROR;
+    }
+    
+    psChanges = (const tsNetworkCacheChange *)&psChangelog[1];
+    for (i = 0; i < psChangelog->u32NumEntries; i++)
+    {
+        if ((!iVersionAfter(psChanges[i].u32Version, u32Since)) || 
+            (iVersionAfter(psChanges[i].u32Version, u32Version)))
+        {
+            continue;
+        }
+        
+        for (j = 0; j < u32NumAddresses; j++)
+        {
+            if (memcmp(&psAddresses[j], &psChanges[i].sAddress, sizeof(struct in6_addr)) == 0)
+            {
+                break;
+            }
+        }
+        if (j == u32NumAddresses)
+        {
+            psAddresses[u32NumAddresses++] = psChanges[i].sAddress;
+        }
+    }
+    free(psChangelog);
+    
+    *ppsAddresses = psAddresses;
+    *pu32NumAddresses = u32NumAddresses;
+    return E_NETWORK_CACHE_OK;
+}
+
+
+const tsNetworkCacheNode *psNetworkCacheModelLookupNode(const tsNetworkCacheModel *psModel, const struct in6_addr *psAddress)
+{
+    uint32_t u32Low = 0;
+    uint32_t u32High = psModel->psHeader->u32NumNodes;
+    
+    while (u32Low < u32High)
+    {
+        uint32_t u32Mid = u32Low + (u32High - u32Low) / 2;
+        int iCompare = memcmp(&psModel->psNodes[u32Mid].sAddress, psAddress, sizeof(struct in6_addr));
+        
+        if (iCompare == 0)
+        {
+            return &psModel->psNodes[u32Mid];
+        }
+        else if (iCompare < 0)
+        {
+            u32Low = u32Mid + 1;
+        }
+        else
+        {
+            u32High = u32Mid;
+        }
+    }
+    return NULL;
+}
+
+
+const char *pcNetworkCacheModelString(const tsNetworkCacheModel *psModel, uint32_t u32Offset)
+{
+    if (u32Offset >= psModel->psHeader->u32StringsLength)
+    {
+        return "";
+    }
+    return &psModel->pcStrings[u32Offset];
+}
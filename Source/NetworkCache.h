@@ -0,0 +1,354 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Network cache
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#ifndef __NETWORK_CACHE_H_
+#define __NETWORK_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+/** @{ Base names of the cache files.
+ *  Each border router has its own snapshot, so the state and lock files are
+ *  named after the border router, see \ref vNetworkCacheBRFileName, and the
+ *  rest after the border router and generation, see \ref vNetworkCacheFileName */
+#define CACHE_DEFINITIONS_FILE_NAME "/tmp/jip_cache_definitions.xml"
+#define CACHE_NETWORK_FILE_NAME     "/tmp/jip_cache_network.xml"
+#define CACHE_STATE_FILE_NAME       "/tmp/jip_cache_state"
+#define CACHE_MODEL_FILE_NAME       "/tmp/jip_cache_nodes"
+#define CACHE_CHANGELOG_FILE_NAME   "/tmp/jip_cache_changes"
+#define CACHE_LOCK_FILE_NAME        "/tmp/jip_cache_lock"
+/** @} */
+
+/** Size of buffer to hold the name of a snapshot file, see \ref vNetworkCacheFileName */
+#define CACHE_FILE_NAME_LENGTH      160
+
+/** Number of seconds past its advertised next refresh that the scheduler
+ *  may be late before readers consider it to have stopped. */
+#define CACHE_SCHEDULER_GRACE       30
+
+
+/** Enumerated type of status codes from the network cache */
+typedef enum
+{
+    E_NETWORK_CACHE_OK,             /**< All ok */
+    E_NETWORK_CACHE_ERROR,          /**< Generic error */
+    E_NETWORK_CACHE_NO_SNAPSHOT,    /**< No usable snapshot of the network exists */
+} teNetworkCacheStatus;
+
+
+/** Enumerated type of refresh policies for readers of the network */
+typedef enum
+{
+    E_NETWORK_CACHE_REFRESH_NEVER,  /**< Use any snapshot, however old */
+    E_NETWORK_CACHE_REFRESH_AUTO,   /**< Use the snapshot while the scheduler keeps it fresh */
+    E_NETWORK_CACHE_REFRESH_FORCE,  /**< Always rediscover synchronously */
+} teNetworkCacheRefresh;
+
+
+/** Structure describing the current snapshot of a border router's network.
+ *  Every save writes a new set of cache files, named after its generation,
+ *  and then replaces this record atomically to point readers at them. A
+ *  reader therefore never pairs the state of one save with files of another. */
+typedef struct
+{
+    uint32_t        u32Magic;           /**< \ref CACHE_STATE_MAGIC */
+    uint32_t        u32Fingerprint;     /**< Hash of the network tree structure */
+    uint32_t        u32NumNodes;        /**< Number of nodes in the snapshot */
+    uint32_t        u32Version;         /**< Version stamp, changes whenever the node model does */
+    uint32_t        u32ModelHash;       /**< Hash of the node model the version stamp was assigned to */
+    uint32_t        u32Generation;      /**< Generation of the cache files, advanced by every save */
+    int64_t         i64Refreshed;       /**< Time of the discovery that produced the snapshot */
+    int64_t         i64Changed;         /**< Time the network tree last changed */
+    int64_t         i64NextRefresh;     /**< Time the scheduler will next refresh, 0 if not scheduled */
+    struct in6_addr sBRAddress;         /**< Border router the snapshot was taken from */
+} tsNetworkCacheState;
+
+#define CACHE_STATE_MAGIC           0x4A495053
+
+
+/** Header of the node model file.
+ *  The file holds the node table, then the MiB table, the variable table
+ *  and finally the string table. Each node's MiBs, and each MiB's variables,
+ *  are stored contiguously so that reading one node's subtree only touches
+ *  the pages that belong to it. Nodes are sorted by address. */
+typedef struct
+{
+    uint32_t        u32Magic;           /**< \ref CACHE_MODEL_MAGIC */
+    uint32_t        u32NumNodes;        /**< Number of entries in the node table */
+    uint32_t        u32NumMibs;         /**< Number of entries in the MiB table */
+    uint32_t        u32NumVars;         /**< Number of entries in the variable table */
+    uint32_t        u32StringsLength;   /**< Length of the string table in bytes */
+    uint32_t        u32Version;         /**< Version stamp of the snapshot, see \ref tsNetworkCacheState */
+    uint32_t        u32Generation;      /**< Generation of the save that wrote the file */
+} tsNetworkCacheModelHeader;
+
+#define CACHE_MODEL_MAGIC           0x4A49504D
+
+
+#ifndef CACHE_CHANGELOG_ENTRIES
+/** Number of node changes kept in the changelog.
+ *  Clients further behind than this are sent the whole network. */
+#define CACHE_CHANGELOG_ENTRIES     256
+#endif /* CACHE_CHANGELOG_ENTRIES */
+
+/** Header of the changelog file.
+ *  Followed by u32NumEntries \ref tsNetworkCacheChange records, oldest first. */
+typedef struct
+{
+    uint32_t        u32Magic;           /**< \ref CACHE_CHANGELOG_MAGIC */
+    uint32_t        u32NumEntries;      /**< Number of changes recorded */
+    uint32_t        u32Oldest;          /**< Changes are complete for clients holding this version or later */
+    uint32_t        u32Newest;          /**< Version the latest changes were made in */
+    uint32_t        u32Generation;      /**< Generation of the save that wrote the file */
+} tsNetworkCacheChangelogHeader;
+
+#define CACHE_CHANGELOG_MAGIC       0x4A495043
+
+/** Node that was added, removed or changed in a version of the snapshot */
+typedef struct
+{
+    struct in6_addr sAddress;           /**< Address of the node */
+    uint32_t        u32Version;         /**< Version stamp of the snapshot the change appeared in */
+} tsNetworkCacheChange;
+
+
+/** Node header as stored in the node model file */
+typedef struct
+{
+    struct in6_addr sAddress;           /**< Address of the node */
+    uint32_t        u32DeviceId;        /**< Device ID of the node */
+    uint32_t        u32Fingerprint;     /**< Hash of the node's MiB / variable structure */
+    uint32_t        u32Name;            /**< String offset of Node.DescriptiveName, 0 if unknown */
+    uint32_t        u32FirstMib;        /**< Index of the node's first MiB */
+    uint32_t        u32NumMibs;         /**< Number of MiBs on the node */
+} tsNetworkCacheNode;
+
+
+/** MiB as stored in the node model file */
+typedef struct
+{
+    uint32_t        u32MibId;           /**< ID of the MiB */
+    uint32_t        u32Name;            /**< String offset of the MiB name */
+    uint32_t        u32FirstVar;        /**< Index of the MiB's first variable */
+    uint32_t        u32NumVars;         /**< Number of variables in the MiB */
+} tsNetworkCacheMib;
+
+
+/** Variable as stored in the node model file */
+typedef struct
+{
+    uint32_t        u32Name;            /**< String offset of the variable name */
+    uint8_t         u8Index;            /**< Index of the variable in its MiB */
+    uint8_t         u8VarType;          /**< teJIP_VarType */
+    uint8_t         u8AccessType;       /**< teJIP_AccessType */
+    uint8_t         u8Security;         /**< teJIP_Security */
+} tsNetworkCacheVar;
+
+
+/** Read only view of the node model of a snapshot.
+ *  The file is mapped rather than parsed, so node headers are available
+ *  immediately and MiB / variable subtrees are only paged in when used. */
+typedef struct
+{
+    void                        *pvMap;     /**< Mapping of the model file */
+    size_t                      szMap;      /**< Length of the mapping */
+    const tsNetworkCacheModelHeader *psHeader;
+    const tsNetworkCacheNode    *psNodes;   /**< Node table */
+    const tsNetworkCacheMib     *psMibs;    /**< MiB table */
+    const tsNetworkCacheVar     *psVars;    /**< Variable table */
+    const char                  *pcStrings; /**< String table */
+    tsNetworkCacheState         sState;     /**< State of the snapshot the model belongs to */
+} tsNetworkCacheModel;
+
+
+/** Convert the value of a "refresh" request variable into a refresh policy.
+ *  \param pcRefresh        "force", "yes" or "no". NULL selects the default.
+ *  \return Refresh policy
+ */
+teNetworkCacheRefresh eNetworkCacheRefreshPolicy(const char *pcRefresh);
+
+
+/** Read the state of the current snapshot of a border router.
+ *  \param pcBRAddress      Address of the border router
+ *  \param psState          Pointer to structure to fill in
+ *  \return E_NETWORK_CACHE_OK if a valid state record was read
+ */
+teNetworkCacheStatus eNetworkCacheReadState(const char *pcBRAddress, tsNetworkCacheState *psState);
+
+
+/** Build the name of one of the files kept per border router.
+ *  \param pcBuffer         Buffer to hold the name, of \ref CACHE_FILE_NAME_LENGTH bytes
+ *  \param szBufferLength   Length of buffer
+ *  \param pcFileName       Base name of the file, e.g. \ref CACHE_STATE_FILE_NAME
+ *  \param psBRAddress      Address of the border router
+ */
+void vNetworkCacheBRFileName(char *pcBuffer, size_t szBufferLength, const char *pcFileName, const struct in6_addr *psBRAddress);
+
+
+/** Build the name of one of the files of a snapshot.
+ *  \param pcBuffer         Buffer to hold the name, of \ref CACHE_FILE_NAME_LENGTH bytes
+ *  \param szBufferLength   Length of buffer
+ *  \param pcFileName       Base name of the file, e.g. \ref CACHE_MODEL_FILE_NAME
+ *  \param psState          State of the snapshot
+ */
+void vNetworkCacheFileName(char *pcBuffer, size_t szBufferLength, const char *pcFileName, const tsNetworkCacheState *psState);
+
+
+/** Load the device definitions of a border router's current snapshot into a context,
+ *  so that discovering the network does not have to read them from every node.
+ *  \param psJIP_Context    Context to load the definitions into
+ *  \param pcBRAddress      Address of the border router
+ *  \return E_NETWORK_CACHE_OK if definitions were loaded
+ */
+teNetworkCacheStatus eNetworkCacheLoadDefinitions(tsJIP_Context *psJIP_Context, const char *pcBRAddress);
+
+
+/** Get the version stamp of the snapshot that would be used under a refresh policy.
+ *  Only the state record is read, so this is cheap enough to answer
+ *  conditional requests before connecting to the border router.
+ *  \param pcBRAddress      Address of the border router
+ *  \param eRefresh         Refresh policy
+ *  \param pu32Version      Location to store the version stamp
+ *  \return E_NETWORK_CACHE_OK if the snapshot would be used without rediscovering the network
+ */
+teNetworkCacheStatus eNetworkCacheVersion(const char *pcBRAddress, teNetworkCacheRefresh eRefresh, uint32_t *pu32Version);
+
+
+/** Calculate a fingerprint of the structure of the network held in a context.
+ *  Nodes, device IDs, MiBs and variables contribute - variable values do not.
+ *  \param psJIP_Context    Context containing the network
+ *  \param pu32NumNodes     Location to store number of nodes, may be NULL
+ *  \return 32 bit fingerprint
+ */
+uint32_t u32NetworkCacheFingerprint(tsJIP_Context *psJIP_Context, uint32_t *pu32NumNodes);
+
+
+/** Save the network held in a context as the current snapshot of its border router.
+ *  The cache files, node model and state record are replaced atomically.
+ *  Saves of each border router are serialised with a lock on its \ref CACHE_LOCK_FILE_NAME.
+ *  Node names are carried over from the previous snapshot for nodes that have
+ *  not changed, and read from the network for the rest. The version stamp is
+ *  advanced if the resulting node model differs from the previous one, and
+ *  the nodes that differ are recorded in the changelog.
+ *  \param psJIP_Context    Context containing the network
+ *  \param pcBRAddress      Address of the border router the network belongs to
+ *  \param i64NextRefresh   Time of the next scheduled refresh, or 0
+ *  \param iReadNames       Non-zero to read every node's name from the network
+ *  \param piChanged        Location to store whether the network changed, may be NULL
+ *  \return E_NETWORK_CACHE_OK on success
+ */
+teNetworkCacheStatus eNetworkCacheSave(tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                       int64_t i64NextRefresh, int iReadNames, int *piChanged);
+
+
+/** Populate a connected context with the network, according to a refresh policy.
+ *  Synchronous discovery only happens when forced, when no snapshot of this
+ *  border router exists, or when the policy is AUTO and no scheduler is refreshing it.
+ *  Any network discovered here is saved as the new snapshot.
+ *  \param psJIP_Context    Connected context to populate
+ *  \param pcBRAddress      Address of the border router the context is connected to
+ *  \param eRefresh         Refresh policy
+ *  \param piAge            Location to store the age of the network in seconds, may be NULL
+ *  \return E_JIP_OK on success
+ */
+teJIP_Status eNetworkCacheAcquire(tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                  teNetworkCacheRefresh eRefresh, int *piAge);
+
+
+/** Make the node model of the network available, according to a refresh policy.
+ *  Unlike \ref eNetworkCacheAcquire the cached network is not loaded into the
+ *  context - it is only used if the network has to be rediscovered.
+ *  \param psJIP_Context    Connected context to use for discovery
+ *  \param pcBRAddress      Address of the border router the context is connected to
+ *  \param eRefresh         Refresh policy
+ *  \param psModel          Model to open. Close with \ref vNetworkCacheModelClose
+ *  \param piAge            Location to store the age of the network in seconds, may be NULL
+ *  \return E_JIP_OK on success
+ */
+teJIP_Status eNetworkCacheAcquireModel(tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                       teNetworkCacheRefresh eRefresh, tsNetworkCacheModel *psModel, int *piAge);
+
+
+/** Open the node model of a border router's current snapshot.
+ *  \param psModel          Model to open
+ *  \param pcBRAddress      Address of the border router
+ *  \return E_NETWORK_CACHE_OK on success
+ */
+teNetworkCacheStatus eNetworkCacheModelOpen(tsNetworkCacheModel *psModel, const char *pcBRAddress);
+
+
+/** Find the nodes that changed since a version of the snapshot, from the changelog
+ *  saved with a node model. A node is listed once however many times it changed.
+ *  Whether it was added, changed or removed follows from the node model.
+ *  \param psModel          Open node model, of the version the client is to be brought up to
+ *  \param u32Since         Version the client holds
+ *  \param ppsAddresses     Location to store malloc'd array of node addresses
+ *  \param pu32NumAddresses Location to store number of addresses
+ *  \return E_NETWORK_CACHE_OK on success. E_NETWORK_CACHE_NO_SNAPSHOT if the
+ *          changelog does not cover the versions, so the whole network must be sent.
+ */
+teNetworkCacheStatus eNetworkCacheChanges(const tsNetworkCacheModel *psModel, uint32_t u32Since,
+                                          struct in6_addr **ppsAddresses, uint32_t *pu32NumAddresses);
+
+
+/** Close a node model.
+ *  \param psModel          Model to close
+ */
+void vNetworkCacheModelClose(tsNetworkCacheModel *psModel);
+
+
+/** Find a node in a model by address, with a binary search of the sorted node table.
+ *  \param psModel          Model to search
+ *  \param psAddress        Address of the node
+ *  \return Pointer to node header, or NULL if the node is not in the model
+ */
+const tsNetworkCacheNode *psNetworkCacheModelLookupNode(const tsNetworkCacheModel *psModel, const struct in6_addr *psAddress);
+
+
+/** Get a string from a model's string table.
+ *  \param psModel          Model
+ *  \param u32Offset        Offset of the string
+ *  \return Pointer to string. Offset 0 is the empty string.
+ */
+const char *pcNetworkCacheModelString(const tsNetworkCacheModel *psModel, uint32_t u32Offset);
+
+
+#endif /* __NETWORK_CACHE_H_ */
@@ -0,0 +1,105 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Node walk
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <JIP.h>
+
+#include "NodeWalk.h"
+
+//#define DEBUG_NODE_WALK
+
+#ifdef DEBUG_NODE_WALK
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_NODE_WALK */
+
+
+teJIP_Status eNodeWalkStart(tsNodeWalk *psWalk, tsJIP_Context *psJIP_Context, uint32_t u32DeviceId)
+{
+    teJIP_Status eStatus;
+    
+    memset(psWalk, 0, sizeof(tsNodeWalk));
+    psWalk->psJIP_Context = psJIP_Context;
+    
+    /* The only time the whole context is locked */
+    eStatus = eJIP_GetNodeAddressList(psJIP_Context, u32DeviceId, &psWalk->asAddresses, &psWalk->u32NumAddresses);
+    if (eStatus != E_JIP_OK)
+    {
+        psWalk->asAddresses     = NULL;
+        psWalk->u32NumAddresses = 0;
+    }
+    return eStatus;
+}
+
+
+tsNode *psNodeWalkNext(tsNodeWalk *psWalk)
+{
+    if (psWalk->psNode)
+    {
+        eJIP_UnlockNode(psWalk->psNode);
+        psWalk->psNode = NULL;
+    }
+    
+    while (psWalk->u32Next < psWalk->u32NumAddresses)
+    {
+        /* Lookup returns the node locked */
+        psWalk->psNode = psJIP_LookupNode(psWalk->psJIP_Context, &psWalk->asAddresses[psWalk->u32Next++]);
+        if (psWalk->psNode)
+        {
+            return psWalk->psNode;
+        }
+        PRINTF("Node has been removed\n");
+    }
+    return NULL;
+}
+
+
+void vNodeWalkEnd(tsNodeWalk *psWalk)
+{
+    if (psWalk->psNode)
+    {
+        eJIP_UnlockNode(psWalk->psNode);
+    }
+    free(psWalk->asAddresses);
+    memset(psWalk, 0, sizeof(tsNodeWalk));
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Node walk
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __NODE_WALK_H_
+#define __NODE_WALK_H_
+
+#include <stdint.h>
+
+#include <JIP.h>
+
+/** Walk over the nodes of a context that holds only one node's lock at a time.
+ *  The node addresses are copied under the context lock when the walk
+ *  starts, which is brief. Each node is then looked up and locked in turn,
+ *  so reading a variable over the network while visiting a node only holds
+ *  up others that want that node - discovery and requests for other nodes
+ *  carry on. Nodes added after the walk started are not visited, and nodes
+ *  removed since are skipped.
+ *
+ *  \code
+ *  for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
+ *  \endcode
+ */
+typedef struct
+{
+    tsJIP_Context       *psJIP_Context; /**< Context being walked */
+    tsJIPAddress        *asAddresses;   /**< Addresses of the nodes when the walk started */
+    uint32_t            u32NumAddresses;/**< Number of addresses */
+    uint32_t            u32Next;        /**< Index of the next address to visit */
+    tsNode              *psNode;        /**< Node being visited, locked, or NULL */
+} tsNodeWalk;
+
+
+/** Start a walk over the nodes of a context.
+ *  \param psWalk           Pointer to walk structure to initialise
+ *  \param psJIP_Context    Context to walk
+ *  \param u32DeviceId      Device ID of the nodes to visit, or JIP_DEVICEID_ALL
+ *  \return E_JIP_OK on success. The walk must then be finished with \ref vNodeWalkEnd
+ */
+teJIP_Status eNodeWalkStart(tsNodeWalk *psWalk, tsJIP_Context *psJIP_Context, uint32_t u32DeviceId);
+
+
+/** Move on to the next node, unlocking the one being visited.
+ *  \param psWalk           Walk in progress
+ *  \return The next node, locked, or NULL when all have been visited
+ */
+tsNode *psNodeWalkNext(tsNodeWalk *psWalk);
+
+
+/** Finish a walk, unlocking the node being visited if the walk was left early.
+ *  \param psWalk           Walk to finish
+ */
+void vNodeWalkEnd(tsNodeWalk *psWalk);
+
+
+#endif /* __NODE_WALK_H_ */
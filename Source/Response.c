@@ -0,0 +1,552 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTTP response writer
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <zlib.h>
+
+#include "Response.h"
+
+//#define DEBUG_RESPONSE
+
+#ifdef DEBUG_RESPONSE
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_RESPONSE */
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif /* IOV_MAX */
+
+
+/** Write a set of io vectors completely, coping with partial writes.
+ *  The io vectors are modified. */
+static teResponseStatus eWriteAll(int iFd, struct iovec *psIov, int iNumIov)
+{
+    while (iNumIov > 0)
+    {
+        ssize_t iWritten = writev(iFd, psIov, iNumIov > IOV_MAX ? IOV_MAX : iNumIov);
+        
+        if (iWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            PRINTF("writev failed (%s)\n", strerror(errno));
+            return E_RESPONSE_ERROR;
+        }
+        
+        /* Skip over the vectors that were written, adjusting a partially written one */
+        while ((iNumIov > 0) && ((size_t)iWritten >= psIov->iov_len))
+        {
+            iWritten -= psIov->iov_len;
+            psIov++;
+            iNumIov--;
+        }
+        if (iNumIov > 0)
+        {
+            psIov->iov_base = (char *)psIov->iov_base + iWritten;
+            psIov->iov_len -= iWritten;
+        }
+    }
+    return E_RESPONSE_OK;
+}
+
+
+/** Append data to a growable buffer */
+static teResponseStatus eAppend(char **ppcBuffer, size_t *pszLength, size_t *pszSize, const void *pvData, size_t szLength)
+{
+    if (*pszLength + szLength > *pszSize)
+    {
+        size_t szNewSize = (*pszSize * 2) + szLength;
+        char *pcNewBuffer = realloc(*ppcBuffer, szNewSize);
+        
+        if (!pcNewBuffer)
+        {
+            return E_RESPONSE_NO_MEMORY;
+        }
+        *ppcBuffer = pcNewBuffer;
+        *pszSize = szNewSize;
+    }
+    memcpy(&(*ppcBuffer)[*pszLength], pvData, szLength);
+    *pszLength += szLength;
+    return E_RESPONSE_OK;
+}
+
+
+teResponseEncoding eResponseAcceptedEncoding(const char *pcAcceptEncoding)
+{
+    int iGzip = 0, iDeflate = 0;
+    const char *pcCoding = pcAcceptEncoding;
+    
+    while ((pcCoding) && (*pcCoding))
+    {
+        const char *pcEnd = strchr(pcCoding, ',');
+        const char *pcParams;
+        size_t szName;
+        int iAllowed = 1;
+        
+        while ((*pcCoding == ' ') || (*pcCoding == '\t'))
+        {
+            pcCoding++;
+        }
+        if (!pcEnd)
+        {
+            pcEnd = pcCoding + strlen(pcCoding);
+        }
+        
+        pcParams = memchr(pcCoding, ';', pcEnd - pcCoding);
+        szName = (pcParams ? pcParams : pcEnd) - pcCoding;
+        while ((szName > 0) && ((pcCoding[szName - 1] == ' ') || (pcCoding[szName - 1] == '\t')))
+        {
+            szName--;
+        }
+        
+        if (pcParams)
+        {
+            const char *pcQ = strstr(pcParams, "q=");
+            if ((pcQ) && (pcQ < pcEnd) && (strtod(pcQ + 2, NULL) <= 0.0))
+            {
+                iAllowed = 0;
+            }
+        }
+        
+        if (((szName == 4) && (strncasecmp(pcCoding, "gzip", 4) == 0)) ||
+            ((szName == 6) && (strncasecmp(pcCoding, "x-gzip", 6) == 0)))
+        {
+            iGzip = iAllowed ? 1 : -1;
+        }
+        else if ((szName == 7) && (strncasecmp(pcCoding, "deflate", 7) == 0))
+        {
+            iDeflate = iAllowed ? 1 : -1;
+        }
+        else if ((szName == 1) && (pcCoding[0] == '*') && (iAllowed))
+        {
+            /* Anything not explicitly refused */
+            iGzip = iGzip ? iGzip : 1;
+            iDeflate = iDeflate ? iDeflate : 1;
+        }
+        
+        pcCoding = (*pcEnd) ? pcEnd + 1 : pcEnd;
+    }
+    
+    if (iGzip > 0)
+    {
+        return E_RESPONSE_ENCODING_GZIP;
+    }
+    if (iDeflate > 0)
+    {
+        return E_RESPONSE_ENCODING_DEFLATE;
+    }
+    return E_RESPONSE_ENCODING_IDENTITY;
+}
+
+
+/** Run the compressor over some data, writing out each chunk of compressed output as it fills */
+static teResponseStatus eDeflate(tsResponse *psResponse, const void *pvData, size_t szLength, int iFlush)
+{
+    z_stream *psStream = &psResponse->sStream;
+    
+    psStream->next_in  = (Bytef *)pvData;
+    psStream->avail_in = szLength;
+    
+    do
+    {
+        int iResult = deflate(psStream, iFlush);
+        
+        if (iResult == Z_STREAM_ERROR)
+        {
+            return E_RESPONSE_ERROR;
+        }
+        
+        if ((psStream->avail_out == 0) || ((iFlush == Z_FINISH) && (psStream->avail_out < RESPONSE_CHUNK_SIZE)))
+        {
+            struct iovec sIov;
+            
+            sIov.iov_base = psResponse->pu8Chunk;
+            sIov.iov_len  = RESPONSE_CHUNK_SIZE - psStream->avail_out;
+            psResponse->szWire += sIov.iov_len;
+            if (eWriteAll(psResponse->iFd, &sIov, 1) != E_RESPONSE_OK)
+            {
+                return E_RESPONSE_ERROR;
+            }
+            psStream->next_out  = psResponse->pu8Chunk;
+            psStream->avail_out = RESPONSE_CHUNK_SIZE;
+        }
+        
+        if ((iFlush == Z_FINISH) && (iResult == Z_STREAM_END))
+        {
+            break;
+        }
+    } while ((psStream->avail_in > 0) || (iFlush == Z_FINISH));
+    
+    return E_RESPONSE_OK;
+}
+
+
+/** Choose the encoding of the body and finish off the headers.
+ *  \param iCompress    Non zero if the body is big enough to be worth compressing */
+static teResponseStatus eStart(tsResponse *psResponse, int iCompress)
+{
+    const char *pcEncodingHeader = NULL;
+    
+    psResponse->iStarted = 1;
+    psResponse->iPending = 1;
+    psResponse->eEncoding = E_RESPONSE_ENCODING_IDENTITY;
+    
+    if ((iCompress) && (psResponse->iLevel > 0) && (psResponse->eAccepted != E_RESPONSE_ENCODING_IDENTITY))
+    {
+        /* Window bits of 15 gives a zlib stream, adding 16 asks for a gzip wrapper instead */
+        int iWindowBits = (psResponse->eAccepted == E_RESPONSE_ENCODING_GZIP) ? 15 + 16 : 15;
+        
+        psResponse->pu8Chunk = malloc(RESPONSE_CHUNK_SIZE);
+        memset(&psResponse->sStream, 0, sizeof(z_stream));
+        
+        if ((psResponse->pu8Chunk) && 
+            (deflateInit2(&psResponse->sStream, psResponse->iLevel, Z_DEFLATED, iWindowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK))
+        {
+            psResponse->eEncoding = psResponse->eAccepted;
+            psResponse->sStream.next_out  = psResponse->pu8Chunk;
+            psResponse->sStream.avail_out = RESPONSE_CHUNK_SIZE;
+            pcEncodingHeader = (psResponse->eEncoding == E_RESPONSE_ENCODING_GZIP) ? "gzip" : "deflate";
+        }
+        else
+        {
+            /* Fall back to sending it uncompressed */
+            free(psResponse->pu8Chunk);
+            psResponse->pu8Chunk = NULL;
+        }
+    }
+    
+    if (pcEncodingHeader)
+    {
+        eResponseHeader(psResponse, "Content-Encoding: %s", pcEncodingHeader);
+    }
+    if (psResponse->iLevel > 0)
+    {
+        /* Caches must not give a compressed copy to a client that can't take it */
+        eResponseHeader(psResponse, "Vary: Accept-Encoding");
+    }
+    if (eAppend(&psResponse->pcHeaders, &psResponse->szHeaders, &psResponse->szHeadersSize, "\r\n", 2) != E_RESPONSE_OK)
+    {
+        return E_RESPONSE_NO_MEMORY;
+    }
+    
+    /* Anything already printed with stdio must go first */
+    fflush(stdout);
+    
+    if (psResponse->eEncoding != E_RESPONSE_ENCODING_IDENTITY)
+    {
+        struct iovec sIov;
+        
+        /* Send the headers now and push the held body through the compressor */
+        sIov.iov_base = psResponse->pcHeaders;
+        sIov.iov_len  = psResponse->szHeaders;
+        psResponse->iPending = 0;
+        if (eWriteAll(psResponse->iFd, &sIov, 1) != E_RESPONSE_OK)
+        {
+            return E_RESPONSE_ERROR;
+        }
+        if (psResponse->szHeld)
+        {
+            if (eDeflate(psResponse, psResponse->pcHeld, psResponse->szHeld, Z_NO_FLUSH) != E_RESPONSE_OK)
+            {
+                return E_RESPONSE_ERROR;
+            }
+        }
+    }
+    PRINTF("Response encoding %d after %d bytes\n", psResponse->eEncoding, (int)psResponse->szHeld);
+    return E_RESPONSE_OK;
+}
+
+
+teResponseStatus eResponseInit(tsResponse *psResponse, int iFd)
+{
+    const char *pcValue;
+    
+    memset(psResponse, 0, sizeof(tsResponse));
+    psResponse->iFd             = iFd;
+    psResponse->eStatus         = E_RESPONSE_OK;
+    psResponse->u32Threshold    = RESPONSE_DEFAULT_THRESHOLD;
+    psResponse->iLevel          = RESPONSE_DEFAULT_LEVEL;
+    
+    pcValue = getenv(RESPONSE_THRESHOLD_ENV);
+    if (pcValue)
+    {
+        psResponse->u32Threshold = strtoul(pcValue, NULL, 0);
+    }
+    
+    pcValue = getenv(RESPONSE_LEVEL_ENV);
+    if (pcValue)
+    {
+        psResponse->iLevel = strtol(pcValue, NULL, 0);
+        if (psResponse->iLevel > Z_BEST_COMPRESSION)
+        {
+            psResponse->iLevel = Z_BEST_COMPRESSION;
+        }
+    }
+    
+    psResponse->eAccepted = eResponseAcceptedEncoding(getenv("HTTP_ACCEPT_ENCODING"));
+    return E_RESPONSE_OK;
+}
+
+
+teResponseStatus eResponseHeader(tsResponse *psResponse, const char *pcFormat, ...)
+{
+    char acLine[256];
+    va_list ap;
+    int iLength;
+    
+    if ((psResponse->iStarted) && (!psResponse->iPending))
+    {
+        return E_RESPONSE_STARTED;
+    }
+    
+    va_start(ap, pcFormat);
+    iLength = vsnprintf(acLine, sizeof(acLine) - 2, pcFormat, ap);
+    va_end(ap);
+    
+    if ((iLength < 0) || (iLength >= (int)sizeof(acLine) - 2))
+    {
+        return E_RESPONSE_ERROR;
+    }
+    acLine[iLength++] = '\r';
+    acLine[iLength++] = '\n';
+    
+    if (eAppend(&psResponse->pcHeaders, &psResponse->szHeaders, &psResponse->szHeadersSize, acLine, iLength) != E_RESPONSE_OK)
+    {
+        psResponse->eStatus = E_RESPONSE_NO_MEMORY;
+        return E_RESPONSE_NO_MEMORY;
+    }
+    return E_RESPONSE_OK;
+}
+
+
+teResponseStatus eResponseWrite(tsResponse *psResponse, const void *pvData, size_t szLength)
+{
+    struct iovec sIov;
+    
+    sIov.iov_base = (void *)pvData;
+    sIov.iov_len  = szLength;
+    return eResponseWritev(psResponse, &sIov, 1);
+}
+
+
+teResponseStatus eResponseWritev(tsResponse *psResponse, const struct iovec *psIov, int iNumIov)
+{
+    size_t szTotal = 0;
+    int i;
+    
+    if (psResponse->eStatus != E_RESPONSE_OK)
+    {
+        return psResponse->eStatus;
+    }
+    
+    for (i = 0; i < iNumIov; i++)
+    {
+        szTotal += psIov[i].iov_len;
+    }
+    psResponse->szBody += szTotal;
+    
+    if (!psResponse->iStarted)
+    {
+        if (psResponse->szHeld + szTotal < psResponse->u32Threshold)
+        {
+            /* Not yet enough to decide on compression - hold on to it */
+            for (i = 0; i < iNumIov; i++)
+            {
+                if (eAppend(&psResponse->pcHeld, &psResponse->szHeld, &psResponse->szHeldSize, 
+                            psIov[i].iov_base, psIov[i].iov_len) != E_RESPONSE_OK)
+                {
+                    psResponse->eStatus = E_RESPONSE_NO_MEMORY;
+                    return E_RESPONSE_NO_MEMORY;
+                }
+            }
+            return E_RESPONSE_OK;
+        }
+        
+        if (eStart(psResponse, 1) != E_RESPONSE_OK)
+        {
+            psResponse->eStatus = E_RESPONSE_ERROR;
+            return E_RESPONSE_ERROR;
+        }
+    }
+    
+    if (psResponse->eEncoding != E_RESPONSE_ENCODING_IDENTITY)
+    {
+        for (i = 0; i < iNumIov; i++)
+        {
+            if (eDeflate(psResponse, psIov[i].iov_base, psIov[i].iov_len, Z_NO_FLUSH) != E_RESPONSE_OK)
+            {
+                psResponse->eStatus = E_RESPONSE_ERROR;
+                return E_RESPONSE_ERROR;
+            }
+        }
+    }
+    else
+    {
+        /* Send headers and held body in the same writev as the new data */
+        struct iovec *psAllIov = malloc((iNumIov + 2) * sizeof(struct iovec));
+        int iNumAllIov = 0;
+        
+        if (!psAllIov)
+        {
+            psResponse->eStatus = E_RESPONSE_NO_MEMORY;
+            return E_RESPONSE_NO_MEMORY;
+        }
+        if (psResponse->iPending)
+        {
+            psAllIov[iNumAllIov].iov_base = psResponse->pcHeaders;
+            psAllIov[iNumAllIov++].iov_len = psResponse->szHeaders;
+            psAllIov[iNumAllIov].iov_base = psResponse->pcHeld;
+            psAllIov[iNumAllIov++].iov_len = psResponse->szHeld;
+            psResponse->szWire += psResponse->szHeld;
+            psResponse->iPending = 0;
+        }
+        memcpy(&psAllIov[iNumAllIov], psIov, iNumIov * sizeof(struct iovec));
+        iNumAllIov += iNumIov;
+        psResponse->szWire += szTotal;
+        
+        if (eWriteAll(psResponse->iFd, psAllIov, iNumAllIov) != E_RESPONSE_OK)
+        {
+            psResponse->eStatus = E_RESPONSE_ERROR;
+        }
+        free(psAllIov);
+    }
+    return psResponse->eStatus;
+}
+
+
+teResponseStatus eResponsePrintf(tsResponse *psResponse, const char *pcFormat, ...)
+{
+    char acBuffer[512];
+    char *pcBuffer = acBuffer;
+    teResponseStatus eStatus;
+    va_list ap;
+    int iLength;
+    
+    va_start(ap, pcFormat);
+    iLength = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, ap);
+    va_end(ap);
+    
+    if (iLength < 0)
+    {
+        return E_RESPONSE_ERROR;
+    }
+    
+    if (iLength >= (int)sizeof(acBuffer))
+    {
+        pcBuffer = malloc(iLength + 1);
+        if (!pcBuffer)
+        {
+            return E_RESPONSE_NO_MEMORY;
+        }
+        va_start(ap, pcFormat);
+        vsnprintf(pcBuffer, iLength + 1, pcFormat, ap);
+        va_end(ap);
+    }
+    
+    eStatus = eResponseWrite(psResponse, pcBuffer, iLength);
+    
+    if (pcBuffer != acBuffer)
+    {
+        free(pcBuffer);
+    }
+    return eStatus;
+}
+
+
+teResponseStatus eResponseFinish(tsResponse *psResponse)
+{
+    teResponseStatus eStatus = psResponse->eStatus;
+    
+    if ((eStatus == E_RESPONSE_OK) && (!psResponse->iStarted))
+    {
+        /* The whole body is under the threshold */
+        if (eStart(psResponse, 0) != E_RESPONSE_OK)
+        {
+            eStatus = E_RESPONSE_ERROR;
+        }
+    }
+    
+    if (eStatus == E_RESPONSE_OK)
+    {
+        if (psResponse->eEncoding != E_RESPONSE_ENCODING_IDENTITY)
+        {
+            eStatus = eDeflate(psResponse, NULL, 0, Z_FINISH);
+        }
+        else if (psResponse->iPending)
+        {
+            struct iovec asIov[2];
+            
+            asIov[0].iov_base = psResponse->pcHeaders;
+            asIov[0].iov_len  = psResponse->szHeaders;
+            asIov[1].iov_base = psResponse->pcHeld;
+            asIov[1].iov_len  = psResponse->szHeld;
+            psResponse->szWire += psResponse->szHeld;
+            eStatus = eWriteAll(psResponse->iFd, asIov, 2);
+        }
+    }
+    PRINTF("Response body %d bytes, %d on the wire\n", (int)psResponse->szBody, (int)psResponse->szWire);
+    
+    if (psResponse->eEncoding != E_RESPONSE_ENCODING_IDENTITY)
+    {
+        deflateEnd(&psResponse->sStream);
+    }
+    free(psResponse->pu8Chunk);
+    free(psResponse->pcHeaders);
+    free(psResponse->pcHeld);
+    psResponse->pu8Chunk    = NULL;
+    psResponse->pcHeaders   = NULL;
+    psResponse->pcHeld      = NULL;
+    psResponse->iStarted    = 1;
+    psResponse->iPending    = 0;
+    psResponse->eEncoding   = E_RESPONSE_ENCODING_IDENTITY;
+    psResponse->eStatus     = E_RESPONSE_STARTED;
+    return eStatus;
+}
@@ -0,0 +1,177 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTTP response writer
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __RESPONSE_H_
+#define __RESPONSE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <zlib.h>
+
+/** Environment variable giving the smallest body, in bytes, that is compressed */
+#define RESPONSE_THRESHOLD_ENV      "JIPWEB_GZIP_THRESHOLD"
+
+/** Environment variable giving the zlib compression level, 0 disables compression */
+#define RESPONSE_LEVEL_ENV          "JIPWEB_GZIP_LEVEL"
+
+#ifndef RESPONSE_DEFAULT_THRESHOLD
+/** Default compression threshold. Below this the gzip overhead outweighs the saving. */
+#define RESPONSE_DEFAULT_THRESHOLD  1024
+#endif /* RESPONSE_DEFAULT_THRESHOLD */
+
+#ifndef RESPONSE_DEFAULT_LEVEL
+/** Default compression level. Low levels get most of the saving for text at a fraction of the CPU. */
+#define RESPONSE_DEFAULT_LEVEL      3
+#endif /* RESPONSE_DEFAULT_LEVEL */
+
+/** Size of the buffer compressed output is collected in before being written */
+#define RESPONSE_CHUNK_SIZE         16384
+
+
+/** Enumerated type of status codes from the response writer */
+typedef enum
+{
+    E_RESPONSE_OK,              /**< All ok */
+    E_RESPONSE_ERROR,           /**< Generic error */
+    E_RESPONSE_NO_MEMORY,       /**< Memory allocation failed */
+    E_RESPONSE_STARTED,         /**< Headers have already been sent */
+} teResponseStatus;
+
+
+/** Enumerated type of content encodings */
+typedef enum
+{
+    E_RESPONSE_ENCODING_IDENTITY,   /**< Uncompressed */
+    E_RESPONSE_ENCODING_GZIP,       /**< gzip */
+    E_RESPONSE_ENCODING_DEFLATE,    /**< zlib format deflate */
+} teResponseEncoding;
+
+
+/** A CGI response. Headers are held back until enough of the body has been
+ *  written to decide whether to compress it, then the body is streamed, 
+ *  through the compressor if the client accepts it. */
+typedef struct
+{
+    int                 iFd;            /**< File descriptor the response is written to */
+    teResponseEncoding  eAccepted;      /**< Best encoding the client accepts */
+    teResponseEncoding  eEncoding;      /**< Encoding of the body, once started */
+    int                 iStarted;       /**< Set once the encoding has been chosen */
+    int                 iPending;       /**< Set while headers / held body are still to be written */
+    uint32_t            u32Threshold;   /**< Smallest body that is compressed */
+    int                 iLevel;         /**< zlib compression level */
+    
+    char                *pcHeaders;     /**< Header lines */
+    size_t              szHeaders;      /**< Length of header lines */
+    size_t              szHeadersSize;  /**< Allocated size of header lines */
+    
+    char                *pcHeld;        /**< Body written before the encoding was chosen */
+    size_t              szHeld;         /**< Length of held body */
+    size_t              szHeldSize;     /**< Allocated size of held body */
+    
+    z_stream            sStream;        /**< Compressor state */
+    uint8_t             *pu8Chunk;      /**< Compressed output buffer */
+    
+    size_t              szBody;         /**< Bytes of body written by the application */
+    size_t              szWire;         /**< Bytes of body sent */
+    teResponseStatus    eStatus;        /**< First error seen */
+} tsResponse;
+
+
+/** Initialise a response. Reads the Accept-Encoding request header and
+ *  the compression settings from the environment.
+ *  \param psResponse       Pointer to response to initialise
+ *  \param iFd              File descriptor to write to, normally STDOUT_FILENO
+ *  \return E_RESPONSE_OK
+ */
+teResponseStatus eResponseInit(tsResponse *psResponse, int iFd);
+
+
+/** Work out the best encoding allowed by an Accept-Encoding header.
+ *  Codings with q=0 are refused, gzip is preferred over deflate.
+ *  \param pcAcceptEncoding Value of the Accept-Encoding header, may be NULL
+ *  \return Best encoding, E_RESPONSE_ENCODING_IDENTITY if none is accepted
+ */
+teResponseEncoding eResponseAcceptedEncoding(const char *pcAcceptEncoding);
+
+
+/** Add a header line to the response, eg. "Content-type: text/html".
+ *  \param psResponse       Pointer to response
+ *  \param pcFormat         printf style format of the line, without line ending
+ *  \return E_RESPONSE_OK on success, E_RESPONSE_STARTED if the headers have already gone
+ */
+teResponseStatus eResponseHeader(tsResponse *psResponse, const char *pcFormat, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+
+/** Write part of the body.
+ *  \param psResponse       Pointer to response
+ *  \param pvData           Data to write
+ *  \param szLength         Length of data
+ *  \return E_RESPONSE_OK on success
+ */
+teResponseStatus eResponseWrite(tsResponse *psResponse, const void *pvData, size_t szLength);
+
+
+/** Write part of the body from a set of io vectors.
+ *  \param psResponse       Pointer to response
+ *  \param psIov            Array of io vectors
+ *  \param iNumIov          Number of io vectors
+ *  \return E_RESPONSE_OK on success
+ */
+teResponseStatus eResponseWritev(tsResponse *psResponse, const struct iovec *psIov, int iNumIov);
+
+
+/** Write formatted text to the body.
+ *  \param psResponse       Pointer to response
+ *  \param pcFormat         printf style format string
+ *  \return E_RESPONSE_OK on success
+ */
+teResponseStatus eResponsePrintf(tsResponse *psResponse, const char *pcFormat, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+
+/** Complete the response, sending anything still held back, and free its resources.
+ *  \param psResponse       Pointer to response
+ *  \return E_RESPONSE_OK if the whole response was sent
+ */
+teResponseStatus eResponseFinish(tsResponse *psResponse);
+
+
+#endif /* __RESPONSE_H_ */
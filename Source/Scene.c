@@ -0,0 +1,357 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Scene engine
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "Codec.h"
+#include "Scene.h"
+
+//#define DEBUG_SCENE
+
+#ifdef DEBUG_SCENE
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_SCENE */
+
+
+/** Scene being executed, shared by the threads checking nodes */
+typedef struct
+{
+    tsJIP_Context      *psJIP_Context;  /**< Context holding the network */
+    const tsScenePlan  *psPlan;         /**< Plan being executed */
+    tsSceneResult      *psResult;       /**< Outcome being built */
+    void               *pvValue;        /**< Scene value as set */
+    uint32_t            u32Size;        /**< Size of pvValue */
+    struct timespec     sStart;         /**< When execution started */
+    uint32_t            u32NextNode;    /**< Next node to be taken by a thread */
+    pthread_mutex_t     sMutex;         /**< Protects u32NextNode */
+} tsSceneExecution;
+
+
+/** Milliseconds since execution started */
+static uint32_t u32Elapsed(const tsSceneExecution *psExecution)
+{
+    struct timespec sNow;
+    
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return ((sNow.tv_sec - psExecution->sStart.tv_sec) * 1000) + 
+           ((sNow.tv_nsec - psExecution->sStart.tv_nsec) / 1000000);
+}
+
+
+/** Find the scene variable of a node. \return Pointer to the variable, with the node locked, or NULL */
+static tsVar *psLookupSceneVar(tsJIP_Context *psJIP_Context, const tsScenePlan *psPlan, 
+                               const struct in6_addr *psAddress, tsNode **ppsNode)
+{
+    tsJIPAddress sAddress;
+    tsMib *psMib;
+    tsVar *psVar;
+    
+    memset(&sAddress, 0, sizeof(tsJIPAddress));
+    sAddress.sin6_family    = AF_INET6;
+    sAddress.sin6_port      = htons(JIP_DEFAULT_PORT);
+    sAddress.sin6_addr      = *psAddress;
+    
+    /* Lookup returns the node locked */
+    *ppsNode = psJIP_LookupNode(psJIP_Context, &sAddress);
+    if (!*ppsNode)
+    {
+        return NULL;
+    }
+    
+    psMib = psJIP_LookupMib(*ppsNode, NULL, psPlan->pcMib);
+    psVar = psMib ? psJIP_LookupVar(psMib, NULL, psPlan->pcVar) : NULL;
+    if (!psVar)
+    {
+        eJIP_UnlockNode(*ppsNode);
+    }
+    return psVar;
+}
+
+
+/** Check that one node has applied the scene, retrying by unicast until it has, or retries or budget run out */
+static void vSceneCheckNode(tsSceneExecution *psExecution, tsSceneNode *psSceneNode)
+{
+    const tsScenePlan *psPlan = psExecution->psPlan;
+    
+    while (u32Elapsed(psExecution) < psPlan->u32Budget)
+    {
+        tsNode *psNode;
+        tsVar *psVar;
+        
+        psVar = psLookupSceneVar(psExecution->psJIP_Context, psPlan, &psSceneNode->sAddress, &psNode);
+        if (!psVar)
+        {
+            /* Left the network since the plan started */
+            psSceneNode->eResult = E_SCENE_NODE_FAILED;
+            psSceneNode->eStatus = E_JIP_ERROR_FAILED;
+            return;
+        }
+        
+        /* String variables may be shorter than the scene value, so only
+         * compare their data once the lengths are known to match */
+        psSceneNode->eStatus = eJIP_GetVar(psExecution->psJIP_Context, psVar);
+        if ((psSceneNode->eStatus == E_JIP_OK) && (psVar->pvData) &&
+            (psVar->u8Size == psExecution->u32Size) &&
+            (memcmp(psVar->pvData, psExecution->pvValue, psVar->u8Size) == 0))
+        {
+            eJIP_UnlockNode(psNode);
+            psSceneNode->eResult = psSceneNode->u32Attempts ? E_SCENE_NODE_RETRIED : E_SCENE_NODE_APPLIED;
+            return;
+        }
+        
+        if (psSceneNode->u32Attempts >= psPlan->u32Retries)
+        {
+            eJIP_UnlockNode(psNode);
+            psSceneNode->eResult = E_SCENE_NODE_FAILED;
+            return;
+        }
+        
+        if (u32Elapsed(psExecution) >= psPlan->u32Budget)
+        {
+            eJIP_UnlockNode(psNode);
+            break;
+        }
+        
+        PRINTF("Retrying scene on node %u\n", (uint32_t)(psSceneNode - psExecution->psResult->psNodes));
+        psSceneNode->u32Attempts++;
+        psSceneNode->eStatus = eJIP_SetVar(psExecution->psJIP_Context, psVar, psExecution->pvValue, psExecution->u32Size);
+        eJIP_UnlockNode(psNode);
+        
+        if (psSceneNode->eStatus == E_JIP_OK)
+        {
+            /* Unicast sets are acknowledged, so there is no need to read it back */
+            psSceneNode->eResult = E_SCENE_NODE_RETRIED;
+            return;
+        }
+    }
+    psSceneNode->eResult = E_SCENE_NODE_UNVERIFIED;
+}
+
+
+/** Thread that takes nodes from a scene execution and checks them until there are none left */
+static void *pvSceneThread(void *pvExecution)
+{
+    tsSceneExecution *psExecution = (tsSceneExecution *)pvExecution;
+    
+    for (;;)
+    {
+        uint32_t u32Node;
+        
+        pthread_mutex_lock(&psExecution->sMutex);
+        u32Node = psExecution->u32NextNode++;
+        pthread_mutex_unlock(&psExecution->sMutex);
+        
+        if (u32Node >= psExecution->psResult->u32NumNodes)
+        {
+            break;
+        }
+        vSceneCheckNode(psExecution, &psExecution->psResult->psNodes[u32Node]);
+    }
+    return NULL;
+}
+
+
+/** Find every node with the scene variable. \return Type of the variable, through peVarType */
+static teSceneStatus eSceneFindNodes(tsJIP_Context *psJIP_Context, const tsScenePlan *psPlan, 
+                                     tsSceneResult *psResult, teJIP_VarType *peVarType)
+{
+    tsJIPAddress *asAddresses = NULL;
+    uint32_t u32NumAddresses = 0;
+    uint32_t i;
+    
+    if (eJIP_GetNodeAddressList(psJIP_Context, JIP_DEVICEID_ALL, &asAddresses, &u32NumAddresses) != E_JIP_OK)
+    {
+        return E_SCENE_ERROR;
+    }
+    
+    psResult->psNodes = calloc(u32NumAddresses ? u32NumAddresses : 1, sizeof(tsSceneNode));
+    if (!psResult->psNodes)
+    {
+        free(asAddresses);
+        return E_SCENE_NO_MEMORY;
+    }
+    
+    for (i = 0; i < u32NumAddresses; i++)
+    {
+        tsNode *psNode;
+        tsVar *psVar;
+        
+        psVar = psLookupSceneVar(psJIP_Context, psPlan, &asAddresses[i].sin6_addr, &psNode);
+        if (psVar)
+        {
+            *peVarType = psVar->eVarType;
+            eJIP_UnlockNode(psNode);
+            
+            psResult->psNodes[psResult->u32NumNodes].sAddress   = asAddresses[i].sin6_addr;
+            psResult->psNodes[psResult->u32NumNodes].eResult    = E_SCENE_NODE_UNVERIFIED;
+            psResult->psNodes[psResult->u32NumNodes].eStatus    = E_JIP_OK;
+            psResult->u32NumNodes++;
+        }
+    }
+    free(asAddresses);
+    
+    return psResult->u32NumNodes ? E_SCENE_OK : E_SCENE_NO_NODES;
+}
+
+
+teSceneStatus eSceneExecute(tsJIP_Context *psJIP_Context, const tsScenePlan *psPlan, tsSceneResult *psResult)
+{
+    tsSceneExecution sExecution;
+    pthread_t asThreads[SCENE_MAX_THREADS];
+    teJIP_VarType eVarType = E_JIP_VAR_TYPE_UINT8;
+    teSceneStatus eStatus;
+    tsJIPAddress sGroupAddress;
+    tsNode *psNode;
+    tsVar *psVar;
+    const char *pcError;
+    uint32_t i, u32NumThreads;
+    
+    memset(psResult, 0, sizeof(tsSceneResult));
+    memset(&sExecution, 0, sizeof(tsSceneExecution));
+    sExecution.psJIP_Context    = psJIP_Context;
+    sExecution.psPlan           = psPlan;
+    sExecution.psResult         = psResult;
+    clock_gettime(CLOCK_MONOTONIC, &sExecution.sStart);
+    
+    eStatus = eSceneFindNodes(psJIP_Context, psPlan, psResult, &eVarType);
+    if (eStatus != E_SCENE_OK)
+    {
+        return eStatus;
+    }
+    
+    if (eCodecParseValue(NULL, eVarType, psPlan->pcValue, &sExecution.pvValue, &sExecution.u32Size, &pcError) != E_CODEC_OK)
+    {
+        PRINTF("Scene value: %s\n", pcError);
+        return E_SCENE_BAD_VALUE;
+    }
+    
+    /* The multicast is sent using any node's copy of the variable to describe it */
+    memset(&sGroupAddress, 0, sizeof(tsJIPAddress));
+    sGroupAddress.sin6_family   = AF_INET6;
+    sGroupAddress.sin6_port     = htons(JIP_DEFAULT_PORT);
+    sGroupAddress.sin6_addr     = psPlan->sGroupAddress;
+    
+    psVar = psLookupSceneVar(psJIP_Context, psPlan, &psResult->psNodes[0].sAddress, &psNode);
+    if (psVar)
+    {
+        psResult->eMulticastStatus = eJIP_MulticastSetVar(psJIP_Context, psVar, sExecution.pvValue, sExecution.u32Size, 
+                                                          &sGroupAddress, psPlan->u32Hops);
+        eJIP_UnlockNode(psNode);
+    }
+    else
+    {
+        psResult->eMulticastStatus = E_JIP_ERROR_FAILED;
+    }
+    PRINTF("Multicast: %s\n", pcJIP_strerror(psResult->eMulticastStatus));
+    
+    if (psPlan->iVerify)
+    {
+        struct timespec sSettle;
+        
+        /* Give the multicast time to get round the mesh before reading it back */
+        sSettle.tv_sec  = 0;
+        sSettle.tv_nsec = SCENE_SETTLE_TIME * 1000000;
+        if (u32Elapsed(&sExecution) + SCENE_SETTLE_TIME < psPlan->u32Budget)
+        {
+            nanosleep(&sSettle, NULL);
+        }
+        
+        pthread_mutex_init(&sExecution.sMutex, NULL);
+        
+        /* This thread checks nodes too */
+        u32NumThreads = psResult->u32NumNodes - 1;
+        if (u32NumThreads > SCENE_MAX_THREADS)
+        {
+            u32NumThreads = SCENE_MAX_THREADS;
+        }
+        for (i = 0; i < u32NumThreads; i++)
+        {
+            if (pthread_create(&asThreads[i], NULL, pvSceneThread, &sExecution) != 0)
+            {
+                break;
+            }
+        }
+        u32NumThreads = i;
+        
+        (void)pvSceneThread(&sExecution);
+        
+        for (i = 0; i < u32NumThreads; i++)
+        {
+            pthread_join(asThreads[i], NULL);
+        }
+        pthread_mutex_destroy(&sExecution.sMutex);
+    }
+    
+    for (i = 0; i < psResult->u32NumNodes; i++)
+    {
+        psResult->au32Count[psResult->psNodes[i].eResult]++;
+    }
+    psResult->u32Elapsed = u32Elapsed(&sExecution);
+    
+    free(sExecution.pvValue);
+    return E_SCENE_OK;
+}
+
+
+void vSceneResultFree(tsSceneResult *psResult)
+{
+    free(psResult->psNodes);
+    memset(psResult, 0, sizeof(tsSceneResult));
+}
+
+
+const char *pcSceneNodeResult(teSceneNodeResult eResult)
+{
+    switch (eResult)
+    {
+        case (E_SCENE_NODE_APPLIED):    return "Applied";
+        case (E_SCENE_NODE_RETRIED):    return "Retried";
+        case (E_SCENE_NODE_FAILED):     return "Failed";
+        default:                        return "Unverified";
+    }
+}
@@ -0,0 +1,148 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Scene engine
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __SCENE_H_
+#define __SCENE_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include <JIP.h>
+
+/** Default number of hops a scene's multicast is sent for */
+#define SCENE_DEFAULT_HOPS          2
+
+/** Default time in milliseconds a scene has to be applied to every node */
+#define SCENE_DEFAULT_BUDGET        2000
+
+/** Default number of unicast retries per node that did not apply a scene */
+#define SCENE_DEFAULT_RETRIES       2
+
+/** Time in milliseconds the multicast is given to reach the network before nodes are checked */
+#define SCENE_SETTLE_TIME           100
+
+/** Most threads that nodes are checked on */
+#define SCENE_MAX_THREADS           8
+
+
+/** Enumerated type of status codes from the scene engine */
+typedef enum
+{
+    E_SCENE_OK,                 /**< All ok */
+    E_SCENE_ERROR,              /**< Generic error */
+    E_SCENE_NO_NODES,           /**< No node has the scene variable */
+    E_SCENE_BAD_VALUE,          /**< The scene value cannot be converted to the variable's type */
+    E_SCENE_NO_MEMORY,          /**< Memory allocation failed */
+} teSceneStatus;
+
+
+/** What happened to the scene on one node */
+typedef enum
+{
+    E_SCENE_NODE_UNVERIFIED,    /**< The budget ran out before the node was checked */
+    E_SCENE_NODE_APPLIED,       /**< The node applied the multicast */
+    E_SCENE_NODE_RETRIED,       /**< The node applied a unicast retry */
+    E_SCENE_NODE_FAILED,        /**< The node had not applied the scene after every retry */
+} teSceneNodeResult;
+
+
+/** Plan for executing a scene.
+ *  The scene variable is multicast to the group first. If iVerify is set,
+ *  every node with the scene variable is then read back, and those that do
+ *  not hold the scene value are sent it by unicast, up to u32Retries times
+ *  each, for as long as the budget allows. */
+typedef struct
+{
+    struct in6_addr     sGroupAddress;  /**< Group the scene is multicast to */
+    const char         *pcMib;          /**< Name of the scene MiB */
+    const char         *pcVar;          /**< Name of the scene variable */
+    const char         *pcValue;        /**< Text form of the scene value, as for \ref eCodecParseValue */
+    uint32_t            u32Hops;        /**< Hops the multicast is sent for */
+    uint32_t            u32Budget;      /**< Time in milliseconds the plan may take */
+    uint32_t            u32Retries;     /**< Unicast retries per node */
+    int                 iVerify;        /**< Non-zero if every node with the variable is a member of the group */
+} tsScenePlan;
+
+
+/** Outcome for one node */
+typedef struct
+{
+    struct in6_addr     sAddress;       /**< Address of the node */
+    teSceneNodeResult   eResult;        /**< What happened */
+    uint32_t            u32Attempts;    /**< Unicast SetVars sent to the node */
+    teJIP_Status        eStatus;        /**< Last status from the node */
+} tsSceneNode;
+
+
+/** Outcome of executing a scene */
+typedef struct
+{
+    teJIP_Status        eMulticastStatus;   /**< Status of the multicast */
+    uint32_t            u32Elapsed;         /**< Time taken in milliseconds */
+    uint32_t            u32NumNodes;        /**< Number of nodes with the scene variable */
+    tsSceneNode        *psNodes;            /**< Outcome for each of them */
+    uint32_t            au32Count[E_SCENE_NODE_FAILED + 1]; /**< Number of nodes with each outcome */
+} tsSceneResult;
+
+
+/** Execute a scene plan.
+ *  The budget is checked before each operation, so a plan may overrun it
+ *  by up to one JIP timeout.
+ *  \param psJIP_Context    Context holding the network
+ *  \param psPlan           Plan to execute
+ *  \param psResult         Pointer to location to store the outcome. Free with \ref vSceneResultFree.
+ *  \return E_SCENE_OK if the scene was sent. The outcome says how many nodes applied it.
+ */
+teSceneStatus eSceneExecute(tsJIP_Context *psJIP_Context, const tsScenePlan *psPlan, tsSceneResult *psResult);
+
+
+/** Free the outcome of a scene.
+ *  \param psResult         Outcome to free
+ */
+void vSceneResultFree(tsSceneResult *psResult);
+
+
+/** Get a name for the outcome on a node.
+ *  \param eResult          Outcome
+ *  \return Name of the outcome
+ */
+const char *pcSceneNodeResult(teSceneNodeResult eResult);
+
+
+#endif /* __SCENE_H_ */
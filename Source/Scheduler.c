@@ -0,0 +1,203 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Discovery scheduler
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#include <JIP.h>
+
+#include "NetworkCache.h"
+#include "Scheduler.h"
+
+//#define DEBUG_SCHEDULER
+
+#ifdef DEBUG_SCHEDULER
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_SCHEDULER */
+
+
+/** Refresh the network once and work out when the next refresh is due.
+ *  Node names are only read again for changed nodes unless iReadNames is set. */
+static void vSchedulerRefresh(tsScheduler *psScheduler, int iReadNames)
+{
+    teJIP_Status eStatus;
+    uint32_t u32Fingerprint;
+    
+    eStatus = eJIPService_DiscoverNetwork(psScheduler->psJIP_Context);
+    if (eStatus != E_JIP_OK)
+    {
+        fprintf(stderr, "Scheduled discovery failed (%s)\n", pcJIP_strerror(eStatus));
+        /* Try again soon, but leave the last good snapshot in place */
+        psScheduler->u32Interval = psScheduler->u32MinInterval;
+        return;
+    }
+    
+    u32Fingerprint = u32NetworkCacheFingerprint(psScheduler->psJIP_Context, NULL);
+    if (u32Fingerprint == psScheduler->u32Fingerprint)
+    {
+        /* Nothing changed - back off */
+        psScheduler->u32Interval *= 2;
+        if (psScheduler->u32Interval > psScheduler->u32MaxInterval)
+        {
+            psScheduler->u32Interval = psScheduler->u32MaxInterval;
+        }
+    }
+    else
+    {
+        psScheduler->u32Interval = psScheduler->u32MinInterval;
+        psScheduler->u32Fingerprint = u32Fingerprint;
+    }
+    
+    PRINTF("Network fingerprint 0x%08x, next refresh in %us\n", u32Fingerprint, psScheduler->u32Interval);
+    
+    if (eNetworkCacheSave(psScheduler->psJIP_Context, psScheduler->pcBRAddress,
+                          time(NULL) + psScheduler->u32Interval, iReadNames, NULL) != E_NETWORK_CACHE_OK)
+    {
+        fprintf(stderr, "Failed to save network snapshot\n");
+    }
+    
+    if (psScheduler->prRefreshed)
+    {
+        psScheduler->prRefreshed(psScheduler->psJIP_Context, psScheduler->pvUser);
+    }
+}
+
+
+static void *pvSchedulerThread(void *pvUser)
+{
+    tsScheduler *psScheduler = (tsScheduler *)pvUser;
+    int iTriggered;
+    
+    pthread_mutex_lock(&psScheduler->sMutex);
+    while (psScheduler->iRun)
+    {
+        struct timespec sDeadline;
+        
+        iTriggered = psScheduler->iTriggered;
+        if (iTriggered)
+        {
+            /* Somebody expects a change - look again at the fastest rate */
+            psScheduler->u32Interval = psScheduler->u32MinInterval;
+            psScheduler->u32Fingerprint = 0;
+            psScheduler->iTriggered = 0;
+        }
+        pthread_mutex_unlock(&psScheduler->sMutex);
+        
+        vSchedulerRefresh(psScheduler, iTriggered);
+        
+        clock_gettime(CLOCK_REALTIME, &sDeadline);
+        sDeadline.tv_sec += psScheduler->u32Interval;
+        
+        pthread_mutex_lock(&psScheduler->sMutex);
+        while (psScheduler->iRun && !psScheduler->iTriggered)
+        {
+            if (pthread_cond_timedwait(&psScheduler->sCond, &psScheduler->sMutex, &sDeadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&psScheduler->sMutex);
+    return NULL;
+}
+
+
+teSchedulerStatus eSchedulerStart(tsScheduler *psScheduler, tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                  uint32_t u32MinInterval, uint32_t u32MaxInterval,
+                                  tprSchedulerRefreshed prRefreshed, void *pvUser)
+{
+    if ((u32MinInterval == 0) || (u32MaxInterval < u32MinInterval))
+    {
+        return E_SCHEDULER_INVALID_PARAMS;
+    }
+    
+    memset(psScheduler, 0, sizeof(tsScheduler));
+    psScheduler->psJIP_Context  = psJIP_Context;
+    psScheduler->pcBRAddress    = pcBRAddress;
+    psScheduler->u32MinInterval = u32MinInterval;
+    psScheduler->u32MaxInterval = u32MaxInterval;
+    psScheduler->u32Interval    = u32MinInterval;
+    psScheduler->prRefreshed    = prRefreshed;
+    psScheduler->pvUser         = pvUser;
+    psScheduler->iRun           = 1;
+    
+    pthread_mutex_init(&psScheduler->sMutex, NULL);
+    pthread_cond_init(&psScheduler->sCond, NULL);
+    
+    if (pthread_create(&psScheduler->sThread, NULL, pvSchedulerThread, psScheduler) != 0)
+    {
+        perror("Error starting scheduler thread");
+        pthread_cond_destroy(&psScheduler->sCond);
+        pthread_mutex_destroy(&psScheduler->sMutex);
+        return E_SCHEDULER_ERROR;
+    }
+    return E_SCHEDULER_OK;
+}
+
+
+void vSchedulerTrigger(tsScheduler *psScheduler)
+{
+    pthread_mutex_lock(&psScheduler->sMutex);
+    psScheduler->iTriggered = 1;
+    pthread_cond_signal(&psScheduler->sCond);
+    pthread_mutex_unlock(&psScheduler->sMutex);
+}
+
+
+teSchedulerStatus eSchedulerStop(tsScheduler *psScheduler)
+{
+    pthread_mutex_lock(&psScheduler->sMutex);
+    psScheduler->iRun = 0;
+    pthread_cond_signal(&psScheduler->sCond);
+    pthread_mutex_unlock(&psScheduler->sMutex);
+    
+    if (pthread_join(psScheduler->sThread, NULL) != 0)
+    {
+        return E_SCHEDULER_ERROR;
+    }
+    
+    pthread_cond_destroy(&psScheduler->sCond);
+    pthread_mutex_destroy(&psScheduler->sMutex);
+    return E_SCHEDULER_OK;
+}
@@ -0,0 +1,119 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Discovery scheduler
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#ifndef __SCHEDULER_H_
+#define __SCHEDULER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <JIP.h>
+
+/** Default shortest interval between network refreshes in seconds */
+#define SCHEDULER_DEFAULT_MIN_INTERVAL  15
+
+/** Default longest interval between network refreshes in seconds */
+#define SCHEDULER_DEFAULT_MAX_INTERVAL  240
+
+
+/** Enumerated type of status codes from the scheduler */
+typedef enum
+{
+    E_SCHEDULER_OK,                 /**< All ok */
+    E_SCHEDULER_ERROR,              /**< Generic error */
+    E_SCHEDULER_INVALID_PARAMS,     /**< Invalid parameters were passed */
+} teSchedulerStatus;
+
+
+/** Callback run on the scheduler thread after each successful refresh,
+ *  to derive further state from the network without holding up readers */
+typedef void (*tprSchedulerRefreshed)(tsJIP_Context *psJIP_Context, void *pvUser);
+
+
+/** Structure for the discovery scheduler.
+ *  The network is refreshed every u32MinInterval seconds while it is changing.
+ *  Each refresh that finds no change doubles the interval, up to u32MaxInterval. */
+typedef struct
+{
+    tsJIP_Context      *psJIP_Context;  /**< Connected context to refresh */
+    const char         *pcBRAddress;    /**< Border router the context is connected to */
+    uint32_t            u32MinInterval; /**< Shortest interval between refreshes in seconds */
+    uint32_t            u32MaxInterval; /**< Longest interval between refreshes in seconds */
+    uint32_t            u32Interval;    /**< Current interval between refreshes in seconds */
+    uint32_t            u32Fingerprint; /**< Fingerprint of the network at the last refresh */
+    tprSchedulerRefreshed prRefreshed;  /**< Called after each successful refresh, may be NULL */
+    void               *pvUser;         /**< Passed to prRefreshed */
+    
+    int                 iRun;           /**< Cleared to stop the scheduler thread */
+    int                 iTriggered;     /**< Set to request an immediate refresh */
+    pthread_t           sThread;        /**< Scheduler thread */
+    pthread_mutex_t     sMutex;         /**< Protects iRun and iTriggered */
+    pthread_cond_t      sCond;          /**< Signalled to wake the scheduler thread */
+} tsScheduler;
+
+
+/** Start a thread to refresh the network held in a context.
+ *  \param psScheduler      Pointer to scheduler structure to initialise
+ *  \param psJIP_Context    Connected context to refresh
+ *  \param pcBRAddress      Address of the border router the context is connected to
+ *  \param u32MinInterval   Shortest interval between refreshes in seconds
+ *  \param u32MaxInterval   Longest interval between refreshes in seconds
+ *  \param prRefreshed      Callback after each successful refresh, may be NULL
+ *  \param pvUser           Passed to prRefreshed
+ *  \return E_SCHEDULER_OK on success
+ */
+teSchedulerStatus eSchedulerStart(tsScheduler *psScheduler, tsJIP_Context *psJIP_Context, const char *pcBRAddress,
+                                  uint32_t u32MinInterval, uint32_t u32MaxInterval,
+                                  tprSchedulerRefreshed prRefreshed, void *pvUser);
+
+
+/** Request an immediate refresh of the network, resetting the interval to the minimum.
+ *  May be called from any thread.
+ *  \param psScheduler      Pointer to running scheduler
+ */
+void vSchedulerTrigger(tsScheduler *psScheduler);
+
+
+/** Stop the scheduler thread and wait for it to exit.
+ *  \param psScheduler      Pointer to running scheduler
+ *  \return E_SCHEDULER_OK on success
+ */
+teSchedulerStatus eSchedulerStop(tsScheduler *psScheduler);
+
+
+#endif /* __SCHEDULER_H_ */
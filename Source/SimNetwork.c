@@ -0,0 +1,442 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Simulated network
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+/* Writes the snapshot of a simulated network, as JIPd would after 
+ * discovering it, along with a history of its sensors. The cgi programs
+ * serve the pages drawn from the node model and the history from these
+ * files without any nodes being present, which is what the benchmarks and
+ * the training run of profile guided builds exercise. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include <JIP.h>
+
+#include "History.h"
+#include "NetworkCache.h"
+
+#ifndef VERSION
+#error Version is not defined!
+#else
+const char *Version = "0.1 (r" VERSION ")";
+#endif
+
+/** Border router the snapshot claims to come from. Connecting to it always succeeds */
+#define SIM_DEFAULT_BR_ADDRESS      "::1"
+
+/** Prefix of the simulated nodes' addresses */
+#define SIM_NODE_PREFIX             "fd04:bd3:80e8:2::"
+
+#define SIM_DEFAULT_NODES           32
+#define SIM_DEFAULT_HOURS           24
+
+/** Device IDs of the simulated dimmable lamps and environment sensors */
+#define SIM_DEVICE_ID_LAMP          0x08010010
+#define SIM_DEVICE_ID_SENSOR        0x8010aaaa
+
+#define FNV_OFFSET_BASIS            0x811C9DC5
+#define FNV_PRIME                   0x01000193
+
+
+/** Variable of a simulated MiB */
+typedef struct
+{
+    const char     *pcName;
+    teJIP_VarType   eVarType;
+    teJIP_AccessType eAccessType;
+} tsSimVar;
+
+/** MiB of a simulated device */
+typedef struct
+{
+    uint32_t        u32MibId;
+    const char     *pcName;
+    uint32_t        u32NumVars;
+    const tsSimVar *asVars;
+} tsSimMib;
+
+static const tsSimVar asNodeVars[] =
+{
+    { "DescriptiveName",    E_JIP_VAR_TYPE_STR,     E_JIP_ACCESS_TYPE_READ_WRITE },
+    { "Version",            E_JIP_VAR_TYPE_STR,     E_JIP_ACCESS_TYPE_CONST },
+    { "TreeVersion",        E_JIP_VAR_TYPE_UINT16,  E_JIP_ACCESS_TYPE_READ_ONLY },
+};
+
+static const tsSimVar asBulbControlVars[] =
+{
+    { "Mode",               E_JIP_VAR_TYPE_UINT8,   E_JIP_ACCESS_TYPE_READ_WRITE },
+    { "LumTarget",          E_JIP_VAR_TYPE_UINT8,   E_JIP_ACCESS_TYPE_READ_WRITE },
+    { "LumCurrent",         E_JIP_VAR_TYPE_UINT8,   E_JIP_ACCESS_TYPE_READ_ONLY },
+    { "LumChange",          E_JIP_VAR_TYPE_INT8,    E_JIP_ACCESS_TYPE_READ_WRITE },
+};
+
+static const tsSimVar asEnvironmentVars[] =
+{
+    { "Temperature",        E_JIP_VAR_TYPE_INT16,   E_JIP_ACCESS_TYPE_READ_ONLY },
+    { "Humidity",           E_JIP_VAR_TYPE_UINT8,   E_JIP_ACCESS_TYPE_READ_ONLY },
+    { "Illuminance",        E_JIP_VAR_TYPE_UINT32,  E_JIP_ACCESS_TYPE_READ_ONLY },
+};
+
+#define SIM_VARS(a)     (sizeof(a) / sizeof(a[0])), a
+
+static const tsSimMib asLampMibs[] =
+{
+    { 0xFFFFFE00, "Node",           SIM_VARS(asNodeVars) },
+    { 0xFFFFFE80, "BulbControl",    SIM_VARS(asBulbControlVars) },
+};
+
+static const tsSimMib asSensorMibs[] =
+{
+    { 0xFFFFFE00, "Node",           SIM_VARS(asNodeVars) },
+    { 0xFFFFFE90, "Environment",    SIM_VARS(asEnvironmentVars) },
+};
+
+
+/** Node model being written */
+typedef struct
+{
+    tsNetworkCacheModelHeader   sHeader;
+    tsNetworkCacheNode         *psNodes;
+    tsNetworkCacheMib          *psMibs;
+    tsNetworkCacheVar          *psVars;
+    char                       *pcStrings;
+    uint32_t                    u32StringsSize;
+} tsSimModel;
+
+
+static void print_usage_exit(char *argv[])
+{
+    fprintf(stderr, "JIPSim Version: %s\n", Version);
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "  Options:\n");
+    fprintf(stderr, "    -h               Print this help.\n");
+    fprintf(stderr, "    -b <address>     Border router of the snapshot. Default %s.\n", SIM_DEFAULT_BR_ADDRESS);
+    fprintf(stderr, "    -n <nodes>       Number of nodes, half lamps and half sensors. Default %d.\n", SIM_DEFAULT_NODES);
+    fprintf(stderr, "    -H <hours>       Hours of sensor history to record. Default %d, 0 for none.\n", SIM_DEFAULT_HOURS);
+    fprintf(stderr, "  The snapshot replaces the border router's in %s.<address>, so do not run this alongside JIPd.\n", CACHE_STATE_FILE_NAME);
+    exit(EXIT_FAILURE);
+}
+
+
+static uint32_t u32Hash(uint32_t u32Hash, const void *pvData, size_t szLength)
+{
+    const uint8_t *pu8Data = (const uint8_t *)pvData;
+    
+    while (szLength--)
+    {
+        u32Hash ^= *pu8Data++;
+        u32Hash *= FNV_PRIME;
+    }
+    return u32Hash;
+}
+
+
+static uint32_t u32AddString(tsSimModel *psModel, const char *pcString)
+{
+    uint32_t u32Offset = psModel->sHeader.u32StringsLength;
+    size_t szLength = strlen(pcString) + 1;
+    
+    if (u32Offset + szLength > psModel->u32StringsSize)
+    {
+        char *pcStrings;
+        
+        psModel->u32StringsSize = (psModel->u32StringsSize + szLength) * 2;
+        pcStrings = realloc(psModel->pcStrings, psModel->u32StringsSize);
+        if (!pcStrings)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        psModel->pcStrings = pcStrings;
+    }
+    memcpy(&psModel->pcStrings[u32Offset], pcString, szLength);
+    psModel->sHeader.u32StringsLength += szLength;
+    return u32Offset;
+}
+
+
+/** Address of the i'th simulated node. Addresses ascend with i, so the node table is sorted as readers expect */
+static void vNodeAddress(uint32_t u32Node, struct in6_addr *psAddress)
+{
+    char acAddress[INET6_ADDRSTRLEN];
+    
+    snprintf(acAddress, sizeof(acAddress), SIM_NODE_PREFIX "%x", u32Node + 1);
+    inet_pton(AF_INET6, acAddress, psAddress);
+}
+
+
+/** Build the node model of the simulated network. Even nodes are lamps, odd nodes sensors */
+static void vBuildModel(tsSimModel *psModel, uint32_t u32NumNodes)
+{
+    uint32_t u32NumMibs = 0;
+    uint32_t u32NumVars = 0;
+    uint32_t i, j, k;
+    
+    memset(psModel, 0, sizeof(tsSimModel));
+    
+    /* Every device type has two MiBs of at most four variables */
+    psModel->psNodes = calloc(u32NumNodes, sizeof(tsNetworkCacheNode));
+    psModel->psMibs  = calloc(u32NumNodes * 2, sizeof(tsNetworkCacheMib));
+    psModel->psVars  = calloc(u32NumNodes * 8, sizeof(tsNetworkCacheVar));
+    if (!psModel->psNodes || !psModel->psMibs || !psModel->psVars)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    /* Offset 0 of the string table is always the empty string */
+    u32AddString(psModel, "");
+    
+    for (i = 0; i < u32NumNodes; i++)
+    {
+        tsNetworkCacheNode *psNode = &psModel->psNodes[i];
+        const tsSimMib *asMibs = (i & 1) ? asSensorMibs : asLampMibs;
+        char acName[32];
+        
+        vNodeAddress(i, &psNode->sAddress);
+        psNode->u32DeviceId     = (i & 1) ? SIM_DEVICE_ID_SENSOR : SIM_DEVICE_ID_LAMP;
+        psNode->u32Fingerprint  = FNV_OFFSET_BASIS;
+        snprintf(acName, sizeof(acName), "%s %u", (i & 1) ? "Sensor" : "Lamp", i / 2 + 1);
+        psNode->u32Name         = u32AddString(psModel, acName);
+        psNode->u32FirstMib     = u32NumMibs;
+        psNode->u32NumMibs      = 2;
+        
+        for (j = 0; j < 2; j++)
+        {
+            tsNetworkCacheMib *psMib = &psModel->psMibs[u32NumMibs++];
+            
+            psMib->u32MibId     = asMibs[j].u32MibId;
+            psMib->u32Name      = u32AddString(psModel, asMibs[j].pcName);
+            psMib->u32FirstVar  = u32NumVars;
+            psMib->u32NumVars   = asMibs[j].u32NumVars;
+            psNode->u32Fingerprint = u32Hash(psNode->u32Fingerprint, asMibs[j].pcName, strlen(asMibs[j].pcName));
+            
+            for (k = 0; k < asMibs[j].u32NumVars; k++)
+            {
+                tsNetworkCacheVar *psVar = &psModel->psVars[u32NumVars++];
+                
+                psVar->u32Name      = u32AddString(psModel, asMibs[j].asVars[k].pcName);
+                psVar->u8Index      = k;
+                psVar->u8VarType    = asMibs[j].asVars[k].eVarType;
+                psVar->u8AccessType = asMibs[j].asVars[k].eAccessType;
+                psVar->u8Security   = E_JIP_SECURITY_NONE;
+                psNode->u32Fingerprint = u32Hash(psNode->u32Fingerprint, &psVar->u8VarType, 1);
+            }
+        }
+    }
+    
+    psModel->sHeader.u32Magic       = CACHE_MODEL_MAGIC;
+    psModel->sHeader.u32NumNodes    = u32NumNodes;
+    psModel->sHeader.u32NumMibs     = u32NumMibs;
+    psModel->sHeader.u32NumVars     = u32NumVars;
+}
+
+
+/** Write a cache file through a temporary file, so readers never see it half written */
+static int iWriteFile(const char *pcFileName, const void *pvHeader, size_t szHeader, const tsSimModel *psModel)
+{
+    char acTempFileName[CACHE_FILE_NAME_LENGTH + 16];
+    FILE *psFile;
+    int iError = 0;
+    
+    snprintf(acTempFileName, sizeof(acTempFileName), "%s.%d", pcFileName, (int)getpid());
+    
+    psFile = fopen(acTempFileName, "wb");
+    if (!psFile)
+    {
+        perror(acTempFileName);
+        return 0;
+    }
+    
+    if (fwrite(pvHeader, szHeader, 1, psFile) != 1)
+    {
+        iError = 1;
+    }
+    if (psModel && !iError)
+    {
+        const tsNetworkCacheModelHeader *psHeader = &psModel->sHeader;
+        
+        if ((fwrite(psModel->psNodes, sizeof(tsNetworkCacheNode), psHeader->u32NumNodes, psFile) != psHeader->u32NumNodes) ||
+            (fwrite(psModel->psMibs, sizeof(tsNetworkCacheMib), psHeader->u32NumMibs, psFile) != psHeader->u32NumMibs) ||
+            (fwrite(psModel->psVars, sizeof(tsNetworkCacheVar), psHeader->u32NumVars, psFile) != psHeader->u32NumVars) ||
+            (fwrite(psModel->pcStrings, 1, psHeader->u32StringsLength, psFile) != psHeader->u32StringsLength))
+        {
+            iError = 1;
+        }
+    }
+    if (fclose(psFile) != 0)
+    {
+        iError = 1;
+    }
+    
+    if (iError || (rename(acTempFileName, pcFileName) != 0))
+    {
+        perror(pcFileName);
+        unlink(acTempFileName);
+        return 0;
+    }
+    return 1;
+}
+
+
+/** Record a daily swing of temperature for each sensor. Sensors beyond the
+ *  \ref HISTORY_MAX_SERIES the store holds push out the earlier ones */
+static int iRecordHistory(uint32_t u32NumNodes, uint32_t u32Hours, time_t tNow)
+{
+    tsHistory sHistory;
+    uint32_t u32Interval;
+    uint32_t i;
+    time_t tTime;
+    
+    if (eHistoryOpen(&sHistory, 1) != E_HISTORY_OK)
+    {
+        fprintf(stderr, "Could not open %s\n", HISTORY_FILE_NAME);
+        return 0;
+    }
+    u32Interval = sHistory.psFile->u32Interval ? sHistory.psFile->u32Interval : HISTORY_DEFAULT_INTERVAL;
+    
+    for (i = 1; i < u32NumNodes; i += 2)
+    {
+        struct in6_addr sAddress;
+        
+        vNodeAddress(i, &sAddress);
+        for (tTime = tNow - (time_t)u32Hours * 3600; tTime <= tNow; tTime += u32Interval)
+        {
+            double dDay = 2.0 * M_PI * (double)(tTime % 86400) / 86400.0;
+            double dNoise = (double)((tTime * 2654435761u + i) % 1000) / 1000.0;
+            
+            (void)eHistoryRecord(&sHistory, &sAddress, "Environment", "Temperature", tTime, 
+                                 200.0 - 40.0 * cos(dDay) + 5.0 * dNoise + i);
+        }
+    }
+    vHistoryClose(&sHistory);
+    return 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *pcBRAddress = SIM_DEFAULT_BR_ADDRESS;
+    uint32_t u32NumNodes = SIM_DEFAULT_NODES;
+    uint32_t u32Hours = SIM_DEFAULT_HOURS;
+    tsNetworkCacheState sState;
+    tsSimModel sModel;
+    char acModelFileName[CACHE_FILE_NAME_LENGTH];
+    char acStateFileName[CACHE_FILE_NAME_LENGTH];
+    uint32_t i;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "hb:n:H:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                pcBRAddress = optarg;
+                break;
+            case 'n':
+                u32NumNodes = strtoul(optarg, NULL, 10);
+                break;
+            case 'H':
+                u32Hours = strtoul(optarg, NULL, 10);
+                break;
+            case 'h':
+            default:
+                print_usage_exit(argv);
+        }
+    }
+    
+    if ((u32NumNodes == 0) || (u32NumNodes > 0xFFFF))
+    {
+        print_usage_exit(argv);
+    }
+    
+    memset(&sState, 0, sizeof(tsNetworkCacheState));
+    if (inet_pton(AF_INET6, pcBRAddress, &sState.sBRAddress) != 1)
+    {
+        fprintf(stderr, "Invalid border router address %s\n", pcBRAddress);
+        return EXIT_FAILURE;
+    }
+    
+    vBuildModel(&sModel, u32NumNodes);
+    
+    sState.u32Magic         = CACHE_STATE_MAGIC;
+    sState.u32NumNodes      = u32NumNodes;
+    sState.u32Fingerprint   = FNV_OFFSET_BASIS;
+    for (i = 0; i < u32NumNodes; i++)
+    {
+        sState.u32Fingerprint = u32Hash(sState.u32Fingerprint, &sModel.psNodes[i].u32Fingerprint, sizeof(uint32_t));
+        sState.u32Fingerprint = u32Hash(sState.u32Fingerprint, &sModel.psNodes[i].sAddress, sizeof(struct in6_addr));
+    }
+    sState.u32ModelHash     = sState.u32Fingerprint;
+    sState.u32Version       = sState.u32Fingerprint | 1;
+    sState.i64Refreshed     = time(NULL);
+    sState.i64Changed       = sState.i64Refreshed;
+    sState.u32Generation    = (uint32_t)sState.i64Refreshed;
+    sModel.sHeader.u32Version = sState.u32Version;
+    sModel.sHeader.u32Generation = sState.u32Generation;
+    
+    /* The model goes in ahead of the state that points readers at it. 
+     * No changelog is written, so clients are sent the whole network */
+    vNetworkCacheFileName(acModelFileName, sizeof(acModelFileName), CACHE_MODEL_FILE_NAME, &sState);
+    vNetworkCacheBRFileName(acStateFileName, sizeof(acStateFileName), CACHE_STATE_FILE_NAME, &sState.sBRAddress);
+    if (!iWriteFile(acModelFileName, &sModel.sHeader, sizeof(tsNetworkCacheModelHeader), &sModel) ||
+        !iWriteFile(acStateFileName, &sState, sizeof(tsNetworkCacheState), NULL))
+    {
+        return EXIT_FAILURE;
+    }
+    
+    if (u32Hours && !iRecordHistory(u32NumNodes, u32Hours, (time_t)sState.i64Refreshed))
+    {
+        return EXIT_FAILURE;
+    }
+    
+    printf("Simulated network of %u nodes behind %s, version 0x%08x, %u hours of history\n",
+           u32NumNodes, pcBRAddress, sState.u32Version, u32Hours);
+    
+    free(sModel.psNodes);
+    free(sModel.psMibs);
+    free(sModel.psVars);
+    free(sModel.pcStrings);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1021 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Smart Devices configuration
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libxml/encoding.h>
+#include <libxml/xmlreader.h>
+
+#include "SmartDevicesConfig.h"
+
+//#define DEBUG_CONFIG
+
+#ifdef DEBUG_CONFIG
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_CONFIG */
+
+
+/* Configuration file example format:
+ * 
+<?xml version="1.0" encoding="ISO-8859-1"?>
+<SmartDevicesCgiConfig Version="1">
+  <Device ID="0x80821cab" Name="Lamp">
+    <!--<Image src="/lamp.gif" />-->
+    <StateControl MiB="BulbControl" Var="Mode"/>
+    <LevelControl MiB="BulbControl" Var="LumTarget" Max="255"/>
+  </Device>
+  <Device ID="0x00000002" Name="Plug">
+    <StateControl MiB="DeviceControl" Var="Mode"/>
+    <LevelFeedback MiB="PlugStatus" Var="P" Label="Power(W)"/>
+  </Device>
+  <Device ID="0x80ae000a" Name="Relay">
+    <StateControl MiB="Relay" Var="Relay One"/>
+  </Device>
+  
+  <Device BaseType="0xE1" Name="DimmableBulb">
+    <Image src="/lamp.gif" />
+    <StateControl MiB="BulbControl" Var="Mode"/>
+    <LevelControl MiB="BulbControl" Var="LumTarget" Max="255"/>
+  </Device>
+
+  <Groups>
+    <StateControl MiB="BulbControl" Var="Mode"/>
+    <LevelControl MiB="BulbControl" Var="LumTarget" Max="255"/>
+    <Global Name="Control all" Address="ff15::f00f"/>
+    <Group Name="Hall" Address="ff15::a00a"/>
+    <Group Name="Lounge" Address="ff15::b00b"/>
+  </Groups>
+
+  <Scenes>
+    <SceneControl MiB="BulbControl" Var="SceneId" />
+    <Scene Name="Home" Address="ff15::f00f" Value="1" />
+    <Scene Name="Away" Address="ff15::f00f" Value="2" />
+    <Scene Name="Watch TV" Image="/tv.png" Address="ff15::f00f" Value="3" />
+    <Scene Name="Night" Address="ff15::f00f" Value="4" Hops="3" Budget="1500" Retries="1" />
+  </Scenes>
+
+  Hops, Budget (milliseconds) and Retries of a scene are optional and tune how
+  it is executed: multicast for Hops hops, then nodes that did not apply it are
+  retried by unicast up to Retries times each, within Budget.
+</SmartDevicesCgiConfig>
+*/
+
+
+/** Number of entries the tables grow by while compiling */
+#define TABLE_INCREMENT         16
+
+/** Initial number of slots in the string de-duplication hash */
+#define STRING_HASH_SIZE        256
+
+/** Multiplier used to hash device IDs (Knuth's multiplicative hash) */
+#define DEVICE_ID_HASH_MULTIPLIER   2654435761U
+
+/** FNV-1a parameters used to hash strings */
+#define FNV_OFFSET_BASIS        2166136261U
+#define FNV_PRIME               16777619U
+
+
+/** State of the compiler while it reads through the configuration file */
+typedef struct
+{
+    int             iValidConfigFile;
+    int             iError;
+    enum 
+    {
+        E_NONE, E_DEVICE, E_GROUPS, E_SCENES, 
+        E_IGNORE,                       /**< In an element that was rejected, whose children are skipped */
+    } eState;
+    
+    tsConfigHeader  sHeader;
+    
+    tsConfigDevice  *psDevices;
+    uint32_t        u32DevicesSize;
+    tsConfigGroup   *psGroups;
+    uint32_t        u32GroupsSize;
+    tsConfigScene   *psScenes;
+    uint32_t        u32ScenesSize;
+    
+    char            *pcStrings;
+    uint32_t        u32StringsSize;
+    
+    uint32_t        *pu32StringHash;    /**< Offsets of strings already in the table, 0 for empty slots */
+    uint32_t        u32StringHashSize;
+    uint32_t        u32StringHashUsed;
+} tsConfigCompiler;
+
+
+/** Empty configuration used when no image could be loaded */
+static const tsConfigHeader sEmptyHeader = { .u32Magic = CONFIG_IMAGE_MAGIC };
+
+
+static uint32_t u32StringHash(const char *pcString)
+{
+    uint32_t u32Hash = FNV_OFFSET_BASIS;
+    
+    while (*pcString)
+    {
+        u32Hash ^= (uint8_t)*pcString++;
+        u32Hash *= FNV_PRIME;
+    }
+    return u32Hash;
+}
+
+
+/** Insert an offset into the string de-duplication hash */
+static void vStringHashInsert(uint32_t *pu32StringHash, uint32_t u32StringHashSize, const char *pcStrings, uint32_t u32Offset)
+{
+    uint32_t u32Slot = u32StringHash(&pcStrings[u32Offset]) & (u32StringHashSize - 1);
+    
+    while (pu32StringHash[u32Slot] != 0)
+    {
+        u32Slot = (u32Slot + 1) & (u32StringHashSize - 1);
+    }
+    pu32StringHash[u32Slot] = u32Offset;
+}
+
+
+/** Double the size of the string de-duplication hash */
+static int iStringHashGrow(tsConfigCompiler *psCompiler)
+{
+    uint32_t u32NewSize = psCompiler->u32StringHashSize ? psCompiler->u32StringHashSize * 2 : STRING_HASH_SIZE;
+    uint32_t *pu32NewHash;
+    uint32_t i;
+    
+    pu32NewHash = calloc(u32NewSize, sizeof(uint32_t));
+    if (!pu32NewHash)
+    {
+        return 0;
+    }
+    
+    for (i = 0; i < psCompiler->u32StringHashSize; i++)
+    {
+        if (psCompiler->pu32StringHash[i])
+        {
+            vStringHashInsert(pu32NewHash, u32NewSize, psCompiler->pcStrings, psCompiler->pu32StringHash[i]);
+        }
+    }
+    
+    free(psCompiler->pu32StringHash);
+    psCompiler->pu32StringHash = pu32NewHash;
+    psCompiler->u32StringHashSize = u32NewSize;
+    return 1;
+}
+
+
+/** Add a string to the string table, reusing an identical string if there is one.
+ *  \return Offset of the string, or 0 on failure */
+static uint32_t u32AddString(tsConfigCompiler *psCompiler, const char *pcString)
+{
+    uint32_t u32Slot;
+    uint32_t u32Offset;
+    size_t szLength;
+    
+    if ((psCompiler->u32StringHashUsed + 1) * 2 > psCompiler->u32StringHashSize)
+    {
+        if (!iStringHashGrow(psCompiler))
+        {
+            psCompiler->iError = 1;
+            return 0;
+        }
+    }
+    
+    u32Slot = u32StringHash(pcString) & (psCompiler->u32StringHashSize - 1);
+    while (psCompiler->pu32StringHash[u32Slot] != 0)
+    {
+        if (strcmp(&psCompiler->pcStrings[psCompiler->pu32StringHash[u32Slot]], pcString) == 0)
+        {
+            return psCompiler->pu32StringHash[u32Slot];
+        }
+        u32Slot = (u32Slot + 1) & (psCompiler->u32StringHashSize - 1);
+    }
+    
+    szLength = strlen(pcString) + 1;
+    if (psCompiler->sHeader.u32StringsLength + szLength > psCompiler->u32StringsSize)
+    {
+        uint32_t u32NewSize = psCompiler->u32StringsSize + szLength + 1024;
+        char *pcNewStrings = realloc(psCompiler->pcStrings, u32NewSize);
+        if (!pcNewStrings)
+        {
+            psCompiler->iError = 1;
+            return 0;
+        }
+        psCompiler->pcStrings = pcNewStrings;
+        psCompiler->u32StringsSize = u32NewSize;
+    }
+    
+    u32Offset = psCompiler->sHeader.u32StringsLength;
+    memcpy(&psCompiler->pcStrings[u32Offset], pcString, szLength);
+    psCompiler->sHeader.u32StringsLength += szLength;
+    
+    psCompiler->pu32StringHash[u32Slot] = u32Offset;
+    psCompiler->u32StringHashUsed++;
+    return u32Offset;
+}
+
+
+/** Read an attribute of the current element into the string table.
+ *  \return Offset of the string, or 0 if the attribute is not present */
+static uint32_t u32Attribute(tsConfigCompiler *psCompiler, xmlTextReaderPtr reader, const char *pcName)
+{
+    char *pcValue;
+    uint32_t u32Offset;
+    
+    pcValue = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)pcName);
+    if (pcValue == NULL)
+    {
+        return 0;
+    }
+    u32Offset = u32AddString(psCompiler, pcValue);
+    free(pcValue);
+    return u32Offset;
+}
+
+
+/** Read a numeric attribute of the current element.
+ *  \return Value of the attribute, or 0 if it is not present or not a number */
+static uint32_t u32NumericAttribute(xmlTextReaderPtr reader, const char *pcName)
+{
+    char *pcValue;
+    char *pcEnd;
+    unsigned long ulValue;
+    
+    pcValue = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)pcName);
+    if (pcValue == NULL)
+    {
+        return 0;
+    }
+    ulValue = strtoul(pcValue, &pcEnd, 0);
+    if ((pcEnd == pcValue) || (*pcEnd != '\0') || (ulValue > UINT32_MAX))
+    {
+        ulValue = 0;
+    }
+    free(pcValue);
+    return (uint32_t)ulValue;
+}
+
+
+/** Make room for one more entry in a table */
+static void *pvGrowTable(tsConfigCompiler *psCompiler, void **ppvTable, uint32_t u32NumEntries, uint32_t *pu32Size, size_t szEntry)
+{
+    if (u32NumEntries >= *pu32Size)
+    {
+        void *pvNewTable = realloc(*ppvTable, (*pu32Size + TABLE_INCREMENT) * szEntry);
+        if (!pvNewTable)
+        {
+            psCompiler->iError = 1;
+            return NULL;
+        }
+        *ppvTable = pvNewTable;
+        *pu32Size += TABLE_INCREMENT;
+    }
+    return (uint8_t *)*ppvTable + (u32NumEntries * szEntry);
+}
+
+
+static void
+processNode(tsConfigCompiler *psCompiler, xmlTextReaderPtr reader)
+{
+    char *NodeName;
+    tsConfigHeader *psHeader = &psCompiler->sHeader;
+    tsConfigDevice *psDevice = NULL;
+    
+    NodeName = (char *)xmlTextReaderName(reader);
+    
+    if (strcmp(NodeName, "SmartDevicesCgiConfig") == 0)
+    {
+        if (xmlTextReaderAttributeCount(reader) > 0)
+        {
+            char *pcVersion;
+            long int u32Version;
+            
+            pcVersion = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Version");
+            if (pcVersion == NULL)
+            {
+                u32Version = 0;
+            }
+            else
+            {
+                errno = 0;
+                u32Version = strtoll(pcVersion, NULL, 16);
+                if (errno)
+                {
+                    u32Version = 0;
+                    perror("strtol");
+                }
+                free(pcVersion);
+            }
+            
+            if (u32Version == CONFIG_FILE_VERSION)
+            {
+                psCompiler->iValidConfigFile = 1;
+            }
+        }
+    }
+    
+    if (!psCompiler->iValidConfigFile)
+    {
+        /* Not a valid config file */
+        goto done;
+    }
+    
+    if (psHeader->u32NumDevices > 0)
+    {
+        psDevice = &psCompiler->psDevices[psHeader->u32NumDevices-1];
+    }
+    
+    if (strcmp(NodeName, "Device") == 0)
+    {
+        /* Until the device is accepted, so that the children of a rejected
+         * device are not attached to the previous one */
+        psCompiler->eState = E_IGNORE;
+        
+        if (xmlTextReaderAttributeCount(reader) == 2)
+        {
+            teDeviceLookup eDeviceLookup = E_LOOKUP_NONE;
+            char *pcDeviceId = NULL;
+            uint32_t u32DeviceId = 0;
+            char *pcBaseType = NULL;
+            uint8_t u8BaseType = 0;
+            uint32_t u32Name;
+            
+            pcDeviceId = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"ID");
+            if (pcDeviceId != NULL)
+            {
+                errno = 0;
+                u32DeviceId = strtoll(pcDeviceId, NULL, 16);
+                free(pcDeviceId);
+                if (errno)
+                {
+                    perror("strtol");
+                    goto done;
+                }
+                eDeviceLookup = E_LOOKUP_DEVICEID;
+            }
+            
+            pcBaseType = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"BaseType");
+            if (pcBaseType != NULL)
+            {
+                errno = 0;
+                u8BaseType = (uint8_t)strtoll(pcBaseType, NULL, 16);
+                free(pcBaseType);
+                if (errno)
+                {
+                    perror("strtol");
+                    goto done;
+                }
+                eDeviceLookup = E_LOOKUP_BASETYPE;
+            }
+            
+            if (eDeviceLookup == E_LOOKUP_NONE)
+            {
+                /* Need either device ID or base type to be specified */
+                goto done;
+            }
+            
+            u32Name = u32Attribute(psCompiler, reader, "Name");
+            if (u32Name == 0)
+            {
+                goto done;
+            }
+            
+            psDevice = pvGrowTable(psCompiler, (void **)&psCompiler->psDevices, psHeader->u32NumDevices, 
+                                   &psCompiler->u32DevicesSize, sizeof(tsConfigDevice));
+            if (!psDevice)
+            {
+                goto done;
+            }
+            psHeader->u32NumDevices++;
+            
+            memset(psDevice, 0, sizeof(tsConfigDevice));
+            psDevice->u8DeviceLookup    = eDeviceLookup;
+            psDevice->u32DeviceId       = u32DeviceId;
+            psDevice->u8BaseType        = u8BaseType;
+            psDevice->u32Name           = u32Name;
+            
+            psCompiler->eState = E_DEVICE;
+            
+            PRINTF("Got Device, ID: 0x%08x, Name: %s\n", u32DeviceId, &psCompiler->pcStrings[u32Name]);
+            goto done;
+        }
+    }
+    else if (strcmp(NodeName, "Groups") == 0)
+    {
+        if (xmlTextReaderAttributeCount(reader) == 0)
+        {
+            psCompiler->eState = E_GROUPS;
+            goto done;
+        }
+    }
+    else if (strcmp(NodeName, "Scenes") == 0)
+    {
+        if (xmlTextReaderAttributeCount(reader) == 0)
+        {
+            psCompiler->eState = E_SCENES;
+            goto done;
+        }
+    }
+    
+    switch (psCompiler->eState)
+    {
+        case E_DEVICE:
+        {
+            if (strcmp(NodeName, "Image") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 1)
+                {
+                    psDevice->u32Image = u32Attribute(psCompiler, reader, "src");
+                }
+            }
+            else if (strcmp(NodeName, "StateControl") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 2)
+                {
+                    psDevice->u32StateControlMib = u32Attribute(psCompiler, reader, "MiB");
+                    psDevice->u32StateControlVar = u32Attribute(psCompiler, reader, "Var");
+                }
+            }
+            else if (strcmp(NodeName, "LevelControl") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 3)
+                {
+                    psDevice->u32LevelControlMib = u32Attribute(psCompiler, reader, "MiB");
+                    psDevice->u32LevelControlVar = u32Attribute(psCompiler, reader, "Var");
+                    psDevice->u32LevelControlMax = u32Attribute(psCompiler, reader, "Max");
+                }
+            }
+            else if (strcmp(NodeName, "LevelFeedback") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 3)
+                {
+                    psDevice->u32LevelFeedbackMib   = u32Attribute(psCompiler, reader, "MiB");
+                    psDevice->u32LevelFeedbackVar   = u32Attribute(psCompiler, reader, "Var");
+                    psDevice->u32LevelFeedbackLabel = u32Attribute(psCompiler, reader, "Label");
+                }
+            }
+            break;
+        }
+        
+        case E_GROUPS:
+        {
+            if (strcmp(NodeName, "StateControl") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 2)
+                {
+                    psHeader->u32GroupStateControlMib   = u32Attribute(psCompiler, reader, "MiB");
+                    psHeader->u32GroupStateControlVar   = u32Attribute(psCompiler, reader, "Var");
+                }
+            }
+            else if (strcmp(NodeName, "LevelControl") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 3)
+                {
+                    psHeader->u32GroupLevelControlMib   = u32Attribute(psCompiler, reader, "MiB");
+                    psHeader->u32GroupLevelControlVar   = u32Attribute(psCompiler, reader, "Var");
+                    psHeader->u32GroupLevelControlMax   = u32Attribute(psCompiler, reader, "Max");
+                }
+            }
+            else if (strcmp(NodeName, "Global") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 2)
+                {
+                    tsConfigGroup sGroup;
+                    
+                    sGroup.u32Name      = u32Attribute(psCompiler, reader, "Name");
+                    sGroup.u32Address   = u32Attribute(psCompiler, reader, "Address");
+                    
+                    if (sGroup.u32Name && sGroup.u32Address)
+                    {
+                        psHeader->sGlobalGroup = sGroup;
+                    }
+                }
+            }
+            else if (strcmp(NodeName, "Group") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 2)
+                {
+                    tsConfigGroup sGroup;
+                    tsConfigGroup *psGroup;
+                    
+                    sGroup.u32Name      = u32Attribute(psCompiler, reader, "Name");
+                    sGroup.u32Address   = u32Attribute(psCompiler, reader, "Address");
+                    
+                    if (!(sGroup.u32Name && sGroup.u32Address))
+                    {
+                        goto done;
+                    }
+                    
+                    psGroup = pvGrowTable(psCompiler, (void **)&psCompiler->psGroups, psHeader->u32NumGroups, 
+                                          &psCompiler->u32GroupsSize, sizeof(tsConfigGroup));
+                    if (psGroup)
+                    {
+                        *psGroup = sGroup;
+                        psHeader->u32NumGroups++;
+                    }
+                }
+            }
+            break;
+        }
+            
+        case E_SCENES:
+        {
+            if (strcmp(NodeName, "SceneControl") == 0)
+            {
+                if (xmlTextReaderAttributeCount(reader) == 2)
+                {
+                    psHeader->u32SceneControlMib    = u32Attribute(psCompiler, reader, "MiB");
+                    psHeader->u32SceneControlVar    = u32Attribute(psCompiler, reader, "Var");
+                }
+            }
+            else if (strcmp(NodeName, "Scene") == 0)
+            {
+                int attributes = xmlTextReaderAttributeCount(reader);
+                if (attributes >= 3 && attributes <= 7)
+                {
+                    tsConfigScene sScene;
+                    tsConfigScene *psScene;
+                    
+                    sScene.u32Name      = u32Attribute(psCompiler, reader, "Name");
+                    sScene.u32Address   = u32Attribute(psCompiler, reader, "Address");
+                    sScene.u32Value     = u32Attribute(psCompiler, reader, "Value");
+                    sScene.u32Image     = u32Attribute(psCompiler, reader, "Image");
+                    sScene.u32Hops      = u32NumericAttribute(reader, "Hops");
+                    sScene.u32Budget    = u32NumericAttribute(reader, "Budget");
+                    sScene.u32Retries   = u32NumericAttribute(reader, "Retries");
+                    
+                    if (!(sScene.u32Name && sScene.u32Address && sScene.u32Value))
+                    {
+                        goto done;
+                    }
+                    
+                    psScene = pvGrowTable(psCompiler, (void **)&psCompiler->psScenes, psHeader->u32NumScenes, 
+                                          &psCompiler->u32ScenesSize, sizeof(tsConfigScene));
+                    if (psScene)
+                    {
+                        *psScene = sScene;
+                        psHeader->u32NumScenes++;
+                    }
+                }
+            }
+            break;
+        }
+        
+        default:
+            break;
+    }
+    
+done:
+    xmlFree(NodeName);
+    return;
+}
+
+
+/** Find the first slot to probe for a device ID in the hash table */
+static uint32_t u32DeviceIdSlot(uint32_t u32DeviceId, uint32_t u32HashSize)
+{
+    uint32_t u32Hash = u32DeviceId * DEVICE_ID_HASH_MULTIPLIER;
+    
+    return (u32Hash ^ (u32Hash >> 16)) & (u32HashSize - 1);
+}
+
+
+/** Build the device ID hash table and base type table from the device entries.
+ *  \return Pointer to the hash table followed by the base type table */
+static tsConfigLookup *psBuildLookup(tsConfigCompiler *psCompiler)
+{
+    tsConfigHeader *psHeader = &psCompiler->sHeader;
+    tsConfigLookup *psDeviceIdHash;
+    uint32_t *pu32BaseTypes;
+    uint32_t u32NumDeviceIds = 0;
+    uint32_t i;
+    
+    for (i = 0; i < psHeader->u32NumDevices; i++)
+    {
+        if (psCompiler->psDevices[i].u8DeviceLookup == E_LOOKUP_DEVICEID)
+        {
+            u32NumDeviceIds++;
+        }
+    }
+    
+    /* Keep the load factor at or below one half */
+    psHeader->u32DeviceIdHashSize = 1;
+    while (psHeader->u32DeviceIdHashSize < (u32NumDeviceIds * 2))
+    {
+        psHeader->u32DeviceIdHashSize <<= 1;
+    }
+    
+    psDeviceIdHash = malloc(psHeader->u32DeviceIdHashSize * sizeof(tsConfigLookup) + CONFIG_NUM_BASETYPES * sizeof(uint32_t));
+    if (!psDeviceIdHash)
+    {
+        return NULL;
+    }
+    pu32BaseTypes = (uint32_t *)&psDeviceIdHash[psHeader->u32DeviceIdHashSize];
+    
+    for (i = 0; i < psHeader->u32DeviceIdHashSize; i++)
+    {
+        psDeviceIdHash[i].u32Key = 0;
+        psDeviceIdHash[i].u32Device = CONFIG_LOOKUP_NONE;
+    }
+    for (i = 0; i < CONFIG_NUM_BASETYPES; i++)
+    {
+        pu32BaseTypes[i] = CONFIG_LOOKUP_NONE;
+    }
+    
+    for (i = 0; i < psHeader->u32NumDevices; i++)
+    {
+        const tsConfigDevice *psDevice = &psCompiler->psDevices[i];
+        
+        if (psDevice->u8DeviceLookup == E_LOOKUP_DEVICEID)
+        {
+            uint32_t u32Slot = u32DeviceIdSlot(psDevice->u32DeviceId, psHeader->u32DeviceIdHashSize);
+            
+            while (psDeviceIdHash[u32Slot].u32Device != CONFIG_LOOKUP_NONE)
+            {
+                if (psDeviceIdHash[u32Slot].u32Key == psDevice->u32DeviceId)
+                {
+                    /* Duplicate - the first entry in the file wins */
+                    break;
+                }
+                u32Slot = (u32Slot + 1) & (psHeader->u32DeviceIdHashSize - 1);
+            }
+            
+            if (psDeviceIdHash[u32Slot].u32Device == CONFIG_LOOKUP_NONE)
+            {
+                psDeviceIdHash[u32Slot].u32Key = psDevice->u32DeviceId;
+                psDeviceIdHash[u32Slot].u32Device = i;
+            }
+        }
+        else if (psDevice->u8DeviceLookup == E_LOOKUP_BASETYPE)
+        {
+            if (pu32BaseTypes[psDevice->u8BaseType] == CONFIG_LOOKUP_NONE)
+            {
+                pu32BaseTypes[psDevice->u8BaseType] = i;
+            }
+        }
+    }
+    return psDeviceIdHash;
+}
+
+
+teConfigStatus eConfigCompile(const char *pcFileName, const char *pcImageFileName)
+{
+    tsConfigCompiler sCompiler;
+    tsConfigHeader *psHeader = &sCompiler.sHeader;
+    tsConfigLookup *psLookup = NULL;
+    xmlTextReaderPtr reader;
+    struct stat sStat;
+    char acTempFileName[256];
+    FILE *psFile;
+    int ret;
+    teConfigStatus eStatus = E_CONFIG_ERROR;
+    
+    /* Stat before reading, so that a change made while reading causes another rebuild */
+    if (stat(pcFileName, &sStat) != 0)
+    {
+        return E_CONFIG_NO_FILE;
+    }
+    
+    memset(&sCompiler, 0, sizeof(tsConfigCompiler));
+    psHeader->u32Magic          = CONFIG_IMAGE_MAGIC;
+    psHeader->i64SourceMtime    = sStat.st_mtime;
+    psHeader->i64SourceSize     = sStat.st_size;
+    
+    /* Offset 0 of the string table is reserved for attributes that are not present */
+    sCompiler.pcStrings = malloc(1024);
+    if (!sCompiler.pcStrings)
+    {
+        return E_CONFIG_ERROR;
+    }
+    sCompiler.pcStrings[0] = '\0';
+    sCompiler.u32StringsSize = 1024;
+    psHeader->u32StringsLength = 1;
+    
+    LIBXML_TEST_VERSION
+    
+    reader = xmlReaderForFile(pcFileName, NULL, 0);
+    if (reader == NULL)
+    {
+        goto done;
+    }
+    
+    ret = xmlTextReaderRead(reader);
+    while ((ret == 1) && (!sCompiler.iError))
+    {
+        processNode(&sCompiler, reader);
+        ret = xmlTextReaderRead(reader);
+    }
+    xmlFreeTextReader(reader);
+    
+    if ((ret != 0) || (sCompiler.iError))
+    {
+        goto done;
+    }
+    
+    psLookup = psBuildLookup(&sCompiler);
+    if (!psLookup)
+    {
+        goto done;
+    }
+    
+    snprintf(acTempFileName, sizeof(acTempFileName), "%s.%d", pcImageFileName, (int)getpid());
+    
+    psFile = fopen(acTempFileName, "wb");
+    if (!psFile)
+    {
+        goto done;
+    }
+    
+    if ((fwrite(psHeader, sizeof(tsConfigHeader), 1, psFile) == 1) &&
+        (fwrite(sCompiler.psDevices, sizeof(tsConfigDevice), psHeader->u32NumDevices, psFile) == psHeader->u32NumDevices) &&
+        (fwrite(sCompiler.psGroups, sizeof(tsConfigGroup), psHeader->u32NumGroups, psFile) == psHeader->u32NumGroups) &&
+        (fwrite(sCompiler.psScenes, sizeof(tsConfigScene), psHeader->u32NumScenes, psFile) == psHeader->u32NumScenes) &&
+        (fwrite(psLookup, sizeof(tsConfigLookup), psHeader->u32DeviceIdHashSize, psFile) == psHeader->u32DeviceIdHashSize) &&
+        (fwrite(&psLookup[psHeader->u32DeviceIdHashSize], sizeof(uint32_t), CONFIG_NUM_BASETYPES, psFile) == CONFIG_NUM_BASETYPES) &&
+        (fwrite(sCompiler.pcStrings, 1, psHeader->u32StringsLength, psFile) == psHeader->u32StringsLength))
+    {
+        eStatus = E_CONFIG_OK;
+    }
+    
+    if (fclose(psFile) != 0)
+    {
+        eStatus = E_CONFIG_ERROR;
+    }
+    
+    if ((eStatus != E_CONFIG_OK) || (rename(acTempFileName, pcImageFileName) != 0))
+    {
+        unlink(acTempFileName);
+        eStatus = E_CONFIG_ERROR;
+    }
+    
+    PRINTF("Compiled %u devices, %u groups, %u scenes, %u bytes of strings\n", 
+           psHeader->u32NumDevices, psHeader->u32NumGroups, psHeader->u32NumScenes, psHeader->u32StringsLength);
+    
+done:
+    free(psLookup);
+    free(sCompiler.psDevices);
+    free(sCompiler.psGroups);
+    free(sCompiler.psScenes);
+    free(sCompiler.pcStrings);
+    free(sCompiler.pu32StringHash);
+    return eStatus;
+}
+
+
+/** Make a configuration describe an empty configuration */
+static void vConfigEmpty(tsConfig *psConfig)
+{
+    memset(psConfig, 0, sizeof(tsConfig));
+    psConfig->psHeader  = &sEmptyHeader;
+    psConfig->pcStrings = "";
+}
+
+
+/** Add the size of a table to the expected size of an image.
+ *  \return 0 if the size does not fit in a size_t */
+static int iAddTableSize(size_t *pszExpected, uint32_t u32NumEntries, size_t szEntry)
+{
+    if (u32NumEntries > (SIZE_MAX - *pszExpected) / szEntry)
+    {
+        return 0;
+    }
+    *pszExpected += (size_t)u32NumEntries * szEntry;
+    return 1;
+}
+
+
+/** Check that the lookup tables of a mapped image only refer to devices in
+ *  the image, and that the device ID hash has an empty slot to end probes at */
+static int iConfigLookupsValid(const tsConfig *psConfig)
+{
+    const tsConfigHeader *psHeader = psConfig->psHeader;
+    uint32_t u32NumEmpty = 0;
+    uint32_t i;
+    
+    for (i = 0; i < psHeader->u32DeviceIdHashSize; i++)
+    {
+        uint32_t u32Device = psConfig->psDeviceIdHash[i].u32Device;
+        
+        if (u32Device == CONFIG_LOOKUP_NONE)
+        {
+            u32NumEmpty++;
+        }
+        else if (u32Device >= psHeader->u32NumDevices)
+        {
+            return 0;
+        }
+    }
+    if (u32NumEmpty == 0)
+    {
+        return 0;
+    }
+    
+    for (i = 0; i < CONFIG_NUM_BASETYPES; i++)
+    {
+        if ((psConfig->pu32BaseTypes[i] != CONFIG_LOOKUP_NONE) && (psConfig->pu32BaseTypes[i] >= psHeader->u32NumDevices))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/** Map a compiled image and check that it is consistent */
+static teConfigStatus eConfigMap(tsConfig *psConfig, const char *pcImageFileName)
+{
+    const tsConfigHeader *psHeader;
+    struct stat sStat;
+    size_t szExpected = sizeof(tsConfigHeader);
+    int iFd;
+    
+    iFd = open(pcImageFileName, O_RDONLY);
+    if (iFd < 0)
+    {
+        return E_CONFIG_NO_FILE;
+    }
+    
+    if ((fstat(iFd, &sStat) != 0) || (sStat.st_size < (off_t)sizeof(tsConfigHeader)))
+    {
+        close(iFd);
+        return E_CONFIG_ERROR;
+    }
+    
+    psConfig->szMap = sStat.st_size;
+    psConfig->pvMap = mmap(NULL, psConfig->szMap, PROT_READ, MAP_SHARED, iFd, 0);
+    close(iFd);
+    
+    if (psConfig->pvMap == MAP_FAILED)
+    {
+        vConfigEmpty(psConfig);
+        return E_CONFIG_ERROR;
+    }
+    
+    psHeader = (const tsConfigHeader *)psConfig->pvMap;
+    
+    if (!iAddTableSize(&szExpected, psHeader->u32NumDevices, sizeof(tsConfigDevice)) ||
+        !iAddTableSize(&szExpected, psHeader->u32NumGroups, sizeof(tsConfigGroup)) ||
+        !iAddTableSize(&szExpected, psHeader->u32NumScenes, sizeof(tsConfigScene)) ||
+        !iAddTableSize(&szExpected, psHeader->u32DeviceIdHashSize, sizeof(tsConfigLookup)) ||
+        !iAddTableSize(&szExpected, CONFIG_NUM_BASETYPES, sizeof(uint32_t)) ||
+        !iAddTableSize(&szExpected, psHeader->u32StringsLength, sizeof(char)) ||
+        (psHeader->u32Magic != CONFIG_IMAGE_MAGIC) || (szExpected != psConfig->szMap) || (psHeader->u32StringsLength == 0) ||
+        (psHeader->u32DeviceIdHashSize == 0) || (psHeader->u32DeviceIdHashSize & (psHeader->u32DeviceIdHashSize - 1)))
+    {
+        PRINTF("Configuration image is corrupt\n");
+        vConfigUnload(psConfig);
+        return E_CONFIG_ERROR;
+    }
+    
+    psConfig->psHeader  = psHeader;
+    psConfig->psDevices = (const tsConfigDevice *)&psHeader[1];
+    psConfig->psGroups  = (const tsConfigGroup *)&psConfig->psDevices[psHeader->u32NumDevices];
+    psConfig->psScenes  = (const tsConfigScene *)&psConfig->psGroups[psHeader->u32NumGroups];
+    psConfig->psDeviceIdHash    = (const tsConfigLookup *)&psConfig->psScenes[psHeader->u32NumScenes];
+    psConfig->pu32BaseTypes     = (const uint32_t *)&psConfig->psDeviceIdHash[psHeader->u32DeviceIdHashSize];
+    psConfig->pcStrings         = (const char *)&psConfig->pu32BaseTypes[CONFIG_NUM_BASETYPES];
+    
+    if (psConfig->pcStrings[psHeader->u32StringsLength - 1] != '\0')
+    {
+        PRINTF("Configuration image string table is not terminated\n");
+        vConfigUnload(psConfig);
+        return E_CONFIG_ERROR;
+    }
+    
+    /* Lookups index the device table without further checks */
+    if (!iConfigLookupsValid(psConfig))
+    {
+        PRINTF("Configuration image lookup tables are corrupt\n");
+        vConfigUnload(psConfig);
+        return E_CONFIG_ERROR;
+    }
+    return E_CONFIG_OK;
+}
+
+
+teConfigStatus eConfigLoad(tsConfig *psConfig, const char *pcFileName, const char *pcImageFileName)
+{
+    struct stat sStat;
+    teConfigStatus eStatus;
+    
+    vConfigEmpty(psConfig);
+    
+    if (stat(pcFileName, &sStat) != 0)
+    {
+        return E_CONFIG_NO_FILE;
+    }
+    
+    if (eConfigMap(psConfig, pcImageFileName) == E_CONFIG_OK)
+    {
+        if ((psConfig->psHeader->i64SourceMtime == sStat.st_mtime) &&
+            (psConfig->psHeader->i64SourceSize == sStat.st_size))
+        {
+            return E_CONFIG_OK;
+        }
+        PRINTF("Configuration image is out of date\n");
+        vConfigUnload(psConfig);
+    }
+    
+    eStatus = eConfigCompile(pcFileName, pcImageFileName);
+    if (eStatus != E_CONFIG_OK)
+    {
+        return eStatus;
+    }
+    return eConfigMap(psConfig, pcImageFileName);
+}
+
+
+void vConfigUnload(tsConfig *psConfig)
+{
+    if (psConfig->pvMap)
+    {
+        munmap(psConfig->pvMap, psConfig->szMap);
+    }
+    vConfigEmpty(psConfig);
+}
+
+
+const char *pcConfigString(const tsConfig *psConfig, uint32_t u32Offset)
+{
+    if ((u32Offset == 0) || (u32Offset >= psConfig->psHeader->u32StringsLength))
+    {
+        return NULL;
+    }
+    return &psConfig->pcStrings[u32Offset];
+}
+
+
+const tsConfigDevice *psConfigLookupDevice(const tsConfig *psConfig, uint32_t u32DeviceId)
+{
+    const tsConfigHeader *psHeader = psConfig->psHeader;
+    uint32_t u32Slot;
+    uint32_t u32Device;
+    
+    if (psHeader->u32DeviceIdHashSize == 0)
+    {
+        /* Empty configuration */
+        return NULL;
+    }
+    
+    /* Exact device ID first */
+    u32Slot = u32DeviceIdSlot(u32DeviceId, psHeader->u32DeviceIdHashSize);
+    while (psConfig->psDeviceIdHash[u32Slot].u32Device != CONFIG_LOOKUP_NONE)
+    {
+        if (psConfig->psDeviceIdHash[u32Slot].u32Key == u32DeviceId)
+        {
+            return &psConfig->psDevices[psConfig->psDeviceIdHash[u32Slot].u32Device];
+        }
+        u32Slot = (u32Slot + 1) & (psHeader->u32DeviceIdHashSize - 1);
+    }
+    
+    /* Then fall back to the base type */
+    u32Device = psConfig->pu32BaseTypes[u32DeviceId & 0x000000FF];
+    if (u32Device != CONFIG_LOOKUP_NONE)
+    {
+        return &psConfig->psDevices[u32Device];
+    }
+    return NULL;
+}
@@ -0,0 +1,224 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Smart Devices configuration
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __SMART_DEVICES_CONFIG_H_
+#define __SMART_DEVICES_CONFIG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CONFIG_FILE_NAME            "/etc/SmartDevicesCgiConfig.xml"
+#define CONFIG_FILE_VERSION         1
+
+/** Compiled image of the configuration file, rebuilt whenever the file changes */
+#define CONFIG_IMAGE_FILE_NAME      "/tmp/SmartDevicesCgiConfig.bin"
+#define CONFIG_IMAGE_MAGIC          0x53444333
+
+/** Value of lookup table entries that do not refer to a device */
+#define CONFIG_LOOKUP_NONE          0xFFFFFFFF
+
+/** Number of entries in the base type lookup table */
+#define CONFIG_NUM_BASETYPES        256
+
+
+/** Enumerated type of status codes from the configuration module */
+typedef enum
+{
+    E_CONFIG_OK,                    /**< All ok */
+    E_CONFIG_ERROR,                 /**< Generic error */
+    E_CONFIG_NO_FILE,               /**< The configuration file does not exist */
+} teConfigStatus;
+
+
+/** How a device entry is matched against nodes */
+typedef enum {
+    E_LOOKUP_NONE,
+    E_LOOKUP_DEVICEID,
+    E_LOOKUP_BASETYPE,
+} teDeviceLookup;
+
+
+/* All strings in the image are offsets into its string table.
+ * Offset 0 is used for attributes that were not present. */
+
+/** Device entry in the compiled image */
+typedef struct
+{
+    uint32_t    u32DeviceId;            /**< Device ID, if matched by ID */
+    uint8_t     u8DeviceLookup;         /**< teDeviceLookup */
+    uint8_t     u8BaseType;             /**< Base type, if matched by base type */
+    uint16_t    u16Reserved;
+    
+    uint32_t    u32Name;
+    uint32_t    u32Image;
+    
+    uint32_t    u32StateControlMib;
+    uint32_t    u32StateControlVar;
+    
+    uint32_t    u32LevelControlMib;
+    uint32_t    u32LevelControlVar;
+    uint32_t    u32LevelControlMax;
+    
+    uint32_t    u32LevelFeedbackMib;
+    uint32_t    u32LevelFeedbackVar;
+    uint32_t    u32LevelFeedbackLabel;
+} tsConfigDevice;
+
+
+/** Group entry in the compiled image */
+typedef struct
+{
+    uint32_t    u32Name;
+    uint32_t    u32Address;
+} tsConfigGroup;
+
+
+/** Scene entry in the compiled image */
+typedef struct
+{
+    uint32_t    u32Name;
+    uint32_t    u32Address;
+    uint32_t    u32Image;
+    uint32_t    u32Value;
+    uint32_t    u32Hops;                /**< Hops the scene is multicast for, 0 for the default */
+    uint32_t    u32Budget;              /**< Time in milliseconds to apply the scene in, 0 for the default */
+    uint32_t    u32Retries;             /**< Unicast retries for nodes that missed the multicast, 0 for the default */
+} tsConfigScene;
+
+
+/** Entry of the device ID hash table */
+typedef struct
+{
+    uint32_t    u32Key;                 /**< Device ID */
+    uint32_t    u32Device;              /**< Index of the device entry, \ref CONFIG_LOOKUP_NONE if the slot is empty */
+} tsConfigLookup;
+
+
+/** Header of the compiled image.
+ *  Followed by the device, group, scene tables, the device lookup tables
+ *  and the string table.
+ *  Devices are looked up in two levels: an open addressed hash table of
+ *  device IDs, then a table indexed directly by base type. */
+typedef struct
+{
+    uint32_t    u32Magic;               /**< \ref CONFIG_IMAGE_MAGIC */
+    uint32_t    u32NumDevices;
+    uint32_t    u32NumGroups;
+    uint32_t    u32NumScenes;
+    uint32_t    u32DeviceIdHashSize;    /**< Number of slots in the device ID hash table, a power of 2 */
+    uint32_t    u32Reserved;
+    int64_t     i64SourceMtime;         /**< Modification time of the file the image was compiled from */
+    int64_t     i64SourceSize;          /**< Size of the file the image was compiled from */
+    uint32_t    u32StringsLength;       /**< Length of the string table in bytes */
+    
+    uint32_t    u32GroupStateControlMib;
+    uint32_t    u32GroupStateControlVar;
+    uint32_t    u32GroupLevelControlMib;
+    uint32_t    u32GroupLevelControlVar;
+    uint32_t    u32GroupLevelControlMax;
+    
+    uint32_t    u32SceneControlMib;
+    uint32_t    u32SceneControlVar;
+    
+    tsConfigGroup sGlobalGroup;         /**< Global group, name is 0 if there is none */
+} tsConfigHeader;
+
+
+/** Loaded configuration - a read only mapping of the compiled image */
+typedef struct
+{
+    void                    *pvMap;     /**< Mapping of the image */
+    size_t                  szMap;      /**< Length of the mapping */
+    const tsConfigHeader    *psHeader;
+    const tsConfigDevice    *psDevices;
+    const tsConfigGroup     *psGroups;
+    const tsConfigScene     *psScenes;
+    const tsConfigLookup    *psDeviceIdHash;    /**< Device ID hash table */
+    const uint32_t          *pu32BaseTypes;     /**< Device entry index for each base type */
+    const char              *pcStrings;
+} tsConfig;
+
+
+/** Compile a configuration file into an image.
+ *  The image is written to a temporary file and renamed into place.
+ *  \param pcFileName       Configuration file to compile
+ *  \param pcImageFileName  Image file to create
+ *  \return E_CONFIG_OK on success
+ */
+teConfigStatus eConfigCompile(const char *pcFileName, const char *pcImageFileName);
+
+
+/** Load the configuration.
+ *  The compiled image is used if it is up to date with the configuration
+ *  file, otherwise it is rebuilt first.
+ *  \param psConfig         Configuration to load
+ *  \param pcFileName       Configuration file
+ *  \param pcImageFileName  Compiled image of the configuration file
+ *  \return E_CONFIG_OK on success. On failure psConfig describes an empty configuration.
+ */
+teConfigStatus eConfigLoad(tsConfig *psConfig, const char *pcFileName, const char *pcImageFileName);
+
+
+/** Unload a configuration.
+ *  \param psConfig         Configuration to unload
+ */
+void vConfigUnload(tsConfig *psConfig);
+
+
+/** Get a string from the configuration.
+ *  \param psConfig         Configuration
+ *  \param u32Offset        Offset of the string
+ *  \return Pointer to the string, NULL if the attribute was not present
+ */
+const char *pcConfigString(const tsConfig *psConfig, uint32_t u32Offset);
+
+
+/** Find the device entry for a node.
+ *  An entry matching the node's device ID takes precedence over an entry
+ *  matching its base type (the low byte of the device ID). When several
+ *  entries of the same kind match, the first one in the configuration
+ *  file is used. Lookup time does not depend on the number of entries.
+ *  \param psConfig         Configuration
+ *  \param u32DeviceId      Device ID of the node
+ *  \return Pointer to the device entry, or NULL if no entry matches
+ */
+const tsConfigDevice *psConfigLookupDevice(const tsConfig *psConfig, uint32_t u32DeviceId);
+
+
+#endif /* __SMART_DEVICES_CONFIG_H_ */
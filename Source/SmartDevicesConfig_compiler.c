@@ -0,0 +1,107 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Smart Devices configuration compiler
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "SmartDevicesConfig.h"
+
+#ifndef VERSION
+#error Version is not defined!
+#else
+const char *Version = "0.1 (r" VERSION ")";
+#endif
+
+
+static void print_usage_exit(char *argv[])
+{
+    fprintf(stderr, "SmartDevicesConfig Version: %s\n", Version);
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "  Options:\n");
+    fprintf(stderr, "    -h               Print this help.\n");
+    fprintf(stderr, "    -i <file>        Configuration file to compile. Default %s.\n", CONFIG_FILE_NAME);
+    fprintf(stderr, "    -o <file>        Image file to write. Default %s.\n", CONFIG_IMAGE_FILE_NAME);
+    fprintf(stderr, "  SmartDevices.cgi rebuilds the image itself when the configuration file changes.\n");
+    exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *pcFileName = CONFIG_FILE_NAME;
+    const char *pcImageFileName = CONFIG_IMAGE_FILE_NAME;
+    tsConfig sConfig;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "hi:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':
+                pcFileName = optarg;
+                break;
+            case 'o':
+                pcImageFileName = optarg;
+                break;
+            case 'h':
+            default:
+                print_usage_exit(argv);
+        }
+    }
+    
+    if (eConfigCompile(pcFileName, pcImageFileName) != E_CONFIG_OK)
+    {
+        fprintf(stderr, "Failed to compile %s\n", pcFileName);
+        return EXIT_FAILURE;
+    }
+    
+    if (eConfigLoad(&sConfig, pcFileName, pcImageFileName) != E_CONFIG_OK)
+    {
+        fprintf(stderr, "Failed to load %s\n", pcImageFileName);
+        return EXIT_FAILURE;
+    }
+    
+    printf("%s: %u devices, %u groups, %u scenes, %u bytes of strings\n", pcImageFileName,
+           sConfig.psHeader->u32NumDevices, sConfig.psHeader->u32NumGroups, 
+           sConfig.psHeader->u32NumScenes, sConfig.psHeader->u32StringsLength);
+    
+    vConfigUnload(&sConfig);
+    return EXIT_SUCCESS;
+}
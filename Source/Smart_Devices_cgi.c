@@ -48,715 +48,797 @@
 #include <unistd.h>
 #include <time.h>
 
-#include <libxml/encoding.h>
-#include <libxml/xmlreader.h>
-
 #include <Zeroconf.h> 
 #include <JIP.h>
 
+#include "Broker.h"
 #include "CGI.h"
-
-#define CACHE_DEFINITIONS_FILE_NAME "/tmp/jip_cache_definitions.xml"
-#define CACHE_NETWORK_FILE_NAME "/tmp/jip_cache_network.xml"
-
-#define CONFIG_FILE_NAME "/etc/SmartDevicesCgiConfig.xml"
-#define CONFIG_FILE_VERSION 1
-
-
-/* Configuration file example format:
- * 
-<?xml version="1.0" encoding="ISO-8859-1"?>
-<SmartDevicesCgiConfig Version="1">
-  <Device ID="0x80821cab" Name="Lamp">
-    <!--<Image src="/lamp.gif" />-->
-    <StateControl MiB="BulbControl" Var="Mode"/>
-    <LevelControl MiB="BulbControl" Var="LumTarget" Max="255"/>
-  </Device>
-  <Device ID="0x00000002" Name="Plug">
-    <StateControl MiB="DeviceControl" Var="Mode"/>
-    <LevelFeedback MiB="PlugStatus" Var="P" Label="Power(W)"/>
-  </Device>
-  <Device ID="0x80ae000a" Name="Relay">
-    <StateControl MiB="Relay" Var="Relay One"/>
-  </Device>
-  
-  <Device BaseType="0xE1" Name="DimmableBulb">
-    <Image src="/lamp.gif" />
-    <StateControl MiB="BulbControl" Var="Mode"/>
-    <LevelControl MiB="BulbControl" Var="LumTarget" Max="255"/>
-  </Device>
-
-  <Groups>
-    <StateControl MiB="BulbControl" Var="Mode"/>
-    <LevelControl MiB="BulbControl" Var="LumTarget" Max="255"/>
-    <Global Name="Control all" Address="ff15::f00f"/>
-    <Group Name="Hall" Address="ff15::a00a"/>
-    <Group Name="Lounge" Address="ff15::b00b"/>
-  </Groups>
-
-  <Scenes>
-    <SceneControl MiB="BulbControl" Var="SceneId" />
-    <Scene Name="Home" Address="ff15::f00f" Value="1" />
-    <Scene Name="Away" Address="ff15::f00f" Value="2" />
-    <Scene Name="Watch TV" Image="/tv.png" Address="ff15::f00f" Value="3" />
-  </Scenes>
-</SmartDevicesCgiConfig>
-*/
+#include "Codec.h"
+#include "Coalesce.h"
+#include "GroupModel.h"
+#include "Multicall.h"
+#include "NetworkCache.h"
+#include "NodeWalk.h"
+#include "Scene.h"
+#include "SmartDevicesConfig.h"
+#include "Response.h"
+#include "Template.h"
+#include "SmartDevices_tmpl.h"
 
 #ifndef VERSION
 #error Version is not defined!
 #else
-const char *Version = "0.7 (r" VERSION ")";
+static const char *Version = "0.7 (r" VERSION ")";
 #endif
 
 //#define BUILD_SENSOR
 
 static tsJIP_Context sJIP_Context;
 
+/** Link that variables are read and set through, via JIPd where it is running */
+static tsBrokerLink sLink;
+
 static tsCGI sCGI;
 
 static char *pcConnect_address = NULL;
 
-/* Individual device control */
+/** Compiled configuration */
+static tsConfig sConfig;
 
-typedef enum {
-    E_LOOKUP_NONE,
-    E_LOOKUP_DEVICEID,
-    E_LOOKUP_BASETYPE,
-} teDeviceLookup;
+/** Macro to get a string from the configuration */
+#define CONFIG_STRING(a) pcConfigString(&sConfig, a)
 
-typedef struct
+/** Page being built from the compiled templates */
+static tsTemplateOutput sOutput;
+
+/** Response to the request, compressed if the client allows it */
+static tsResponse sResponse;
+
+/** Groups and their state from the group model, read once per page */
+static tsGroupModelView sGroupView;
+
+
+static const int read_config(const char *pcBRAddress)
 {
-    teDeviceLookup eDeviceLookup;
-                
-    uint32_t    u32DeviceId;
-    uint8_t     u8BaseType;
+    int iNumAddresses;
+    struct in6_addr *asAddresses;
+    
+    if (pcBRAddress)
+    {
+        /* The page has already chosen a border router */
+        pcConnect_address = pcArenaStrdup(&sCGI.sArena, pcBRAddress);
+    }
+    else if (ZC_Get_Module_Addresses(&asAddresses, &iNumAddresses) != 0)
+    {
+        fprintf(stderr, "Could not get coordinator address\n");
+    }
+    else
+    {
+        if (iNumAddresses < 1)
+        {
+            fprintf(stderr, "Discovered no coordinators\n");
+        }
+        else
+        {
+            char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
+            
+            if (iNumAddresses > 1)
+            {
+                /* JIP.cgi can merge them all with BRaddress=all. This page shows one network */
+                fprintf(stderr, "Discovered %d coordinators, using the first\n", iNumAddresses);
+            }
+            inet_ntop(AF_INET6, asAddresses, buffer, INET6_ADDRSTRLEN);
+            
+            //printf("Got address %s\n", buffer);
+            
+            pcConnect_address = pcArenaStrdup(&sCGI.sArena, buffer);
+        }
+        free(asAddresses);
+    }
     
-    char        *pcName;
+    /* Load the compiled config file, rebuilding it if the xml has changed */
+    if (eConfigLoad(&sConfig, CONFIG_FILE_NAME, CONFIG_IMAGE_FILE_NAME) != E_CONFIG_OK)
+    {
+        return 0;
+    }
+
+    return 0;
+}
+
+
+int Menu(const char *pcName, const char *pcAddress, const char *pcImage, const char *pcGroupState,
+         const char *pcStateControlMib, const char *pcStateControlVar,
+         const char *pcLevelControlMib, const char *pcLevelControlVar, const char *pcLevelControlMax,
+         const char *pcLevelFeedbackMib, const char *pcLevelFeedbackVar, const char *pcLevelFeedbackLabel)
+{
+    static int MenuID = 0;
+    const char *pcMenuID;
+    char *pcIPv6URL;
     
-    char        *pcImage;
+    if (eCGIURLEncode(&sCGI.sArena, &pcIPv6URL, pcAddress) != E_CGI_OK)
+    {
+        pcIPv6URL = "Unknown Address";
+    }
+
+    pcMenuID = pcTemplateFormat(&sOutput, "%d", MenuID);
+
+    eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuBegin, pcAddress, pcName);
+    if (pcImage)
+    {
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuImage, pcImage);
+    }
+    eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuImageEnd);
+    if (pcGroupState)
+    {
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuGroupState, pcGroupState);
+    }
     
-    char        *pcStateControlMib;
-    char        *pcStateControlVar;
+    if ((pcStateControlMib) && (pcStateControlVar))
+    {
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuState, pcIPv6URL, pcStateControlMib, pcStateControlVar);
+    }
     
-    char        *pcLevelControlMib;
-    char        *pcLevelControlVar;
-    char        *pcLevelControlMax;
+    if ((pcLevelControlMib) && (pcLevelControlVar) && (pcLevelControlMax))
+    {
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuLevel, 
+                        pcMenuID, pcLevelControlMax, pcIPv6URL, pcLevelControlMib, pcLevelControlVar);
+    }
     
-    char        *pcLevelFeedbackMib;
-    char        *pcLevelFeedbackVar;
-    char        *pcLevelFeedbackLabel;
-} tsDevice;
-
-static uint32_t u32NumDevices = 0;
-static tsDevice *psDevices = NULL;
+    if ((pcLevelFeedbackMib) && (pcLevelFeedbackVar) && (pcLevelFeedbackLabel))
+    {
+        /* The graph drawing script is part of the page head, shared by all devices */
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuFeedback, 
+                        pcMenuID, pcIPv6URL, pcLevelFeedbackMib, pcLevelFeedbackVar, pcLevelFeedbackLabel);
+    }
 
+    eTemplateRender(&sOutput, &sTemplateSmartDevicesMenuEnd);
+    
+    MenuID++;
+    
+    return 0;
+}
 
-/* Group control */
 
-static char *pcGroupStateControlMib = NULL;
-static char *pcGroupStateControlVar = NULL;
+int DeviceMenu(const tsConfigDevice *psDevice, const char *pcName, const char *pcAddress)
+{
+    return Menu(pcName, pcAddress, CONFIG_STRING(psDevice->u32Image), NULL,
+                CONFIG_STRING(psDevice->u32StateControlMib), CONFIG_STRING(psDevice->u32StateControlVar),
+                CONFIG_STRING(psDevice->u32LevelControlMib), CONFIG_STRING(psDevice->u32LevelControlVar), 
+                CONFIG_STRING(psDevice->u32LevelControlMax),
+                CONFIG_STRING(psDevice->u32LevelFeedbackMib), CONFIG_STRING(psDevice->u32LevelFeedbackVar), 
+                CONFIG_STRING(psDevice->u32LevelFeedbackLabel));
+}
 
-static char *pcGroupLevelControlMib = NULL;
-static char *pcGroupLevelControlVar = NULL;
-static char *pcGroupLevelControlMax = NULL;
 
-typedef struct
+/** Describe the aggregated state of a group from the group model, for the page */
+static const char *pcGroupStateText(const tsConfigGroup *psGroup)
 {
-    char *pcName;
-    char *pcAddress;
-} tsGroup;
+    const tsGroupModelGroup *psModelGroup;
+    struct in6_addr sAddress;
+    int32_t i32Level;
+    
+    if ((!sGroupView.psGroups) ||
+        (inet_pton(AF_INET6, CONFIG_STRING(psGroup->u32Address), &sAddress) != 1) ||
+        (!(psModelGroup = psGroupModelLookupGroup(&sGroupView, &sAddress))))
+    {
+        return NULL;
+    }
+    
+    i32Level = i32GroupModelGroupLevel(psModelGroup);
+    if (i32Level == GROUP_MODEL_UNKNOWN)
+    {
+        return pcTemplateFormat(&sOutput, "%s, %u of %u on", 
+                                pcGroupModelState(eGroupModelGroupState(psModelGroup)), 
+                                psModelGroup->u32On, psModelGroup->u32Members);
+    }
+    return pcTemplateFormat(&sOutput, "%s, %u of %u on, average level %d", 
+                            pcGroupModelState(eGroupModelGroupState(psModelGroup)), 
+                            psModelGroup->u32On, psModelGroup->u32Members, i32Level);
+}
 
-static uint32_t u32NumGroups = 0;
-static tsGroup *psGroups = NULL;
 
-/* Global Group */
-static tsGroup *psGlobalGroup = NULL;
+int GroupMenu(const tsConfigGroup *psGroup)
+{
+    const tsConfigHeader *psHeader = sConfig.psHeader;
+    
+    return Menu(CONFIG_STRING(psGroup->u32Name), CONFIG_STRING(psGroup->u32Address), NULL, pcGroupStateText(psGroup),
+                CONFIG_STRING(psHeader->u32GroupStateControlMib), CONFIG_STRING(psHeader->u32GroupStateControlVar),
+                CONFIG_STRING(psHeader->u32GroupLevelControlMib), CONFIG_STRING(psHeader->u32GroupLevelControlVar), 
+                CONFIG_STRING(psHeader->u32GroupLevelControlMax),
+                NULL, NULL, NULL);
+}
 
 
-/* Scene control */
+int SceneMenu(uint32_t u32Scene)
+{
+    const tsConfigScene *psScene = &sConfig.psScenes[u32Scene];
+    char acScene[16];
+    
+    /* Scenes are run by index, so the page does not need to know how they are sent */
+    snprintf(acScene, sizeof(acScene), "%u", u32Scene);
+    eTemplateRender(&sOutput, &sTemplateSmartDevicesScene, acScene, CONFIG_STRING(psScene->u32Name));
 
-static char *pcSceneControlMib = NULL;
-static char *pcSceneControlVar = NULL;
+    if (psScene->u32Image)
+    {
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesSceneImage, CONFIG_STRING(psScene->u32Image));
+    }
+    eTemplateRender(&sOutput, &sTemplateSmartDevicesSceneEnd);
+    return 0;
+}
 
-typedef struct
-{
-    char *pcName;
-    char *pcAddress;
-    char *pcImage;
-    char *pcValue;
-} tsScene;
 
-static uint32_t u32NumScenes = 0;
-static tsScene *psScenes = NULL;
 
-static void
-processNode(xmlTextReaderPtr reader)
+/** Append a JSON string, escaped, to the page. NULL is written as null */
+static void vJsonString(const char *pcString)
 {
-    char *NodeName;
-    static int iValidConfigFile = 0;
-    static enum 
-    {
-        E_NONE, E_DEVICE, E_GROUPS, E_SCENES
-    } eState = E_NONE;
+    const char *pcRun;
     
-    NodeName = (char *)xmlTextReaderName(reader);
+    if (!pcString)
+    {
+        eTemplateWriteStatic(&sOutput, "null");
+        return;
+    }
     
-    if (strcmp(NodeName, "SmartDevicesCgiConfig") == 0)
+    eTemplateWriteStatic(&sOutput, "\"");
+    for (pcRun = pcString; *pcString; pcString++)
     {
-        if (xmlTextReaderAttributeCount(reader) > 0)
+        unsigned char c = *pcString;
+        
+        if ((c >= 0x20) && (c != '"') && (c != '\\'))
         {
-            char *pcVersion;
-            long int u32Version;
-            
-            pcVersion = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Version");
-            if (pcVersion == NULL)
-            {
-                u32Version = 0;
-            }
-            else
-            {
-                errno = 0;
-                u32Version = strtoll(pcVersion, NULL, 16);
-                if (errno)
-                {
-                    u32Version = 0;
-                    perror("strtol");
-                }
-                free(pcVersion);
-            }
-            
-            if (u32Version == CONFIG_FILE_VERSION)
-            {
-                iValidConfigFile = 1;
-                //printf("Valid config file\n");
-            }
+            continue;
+        }
+        if (pcString > pcRun)
+        {
+            eTemplatePrintf(&sOutput, "%.*s", (int)(pcString - pcRun), pcRun);
         }
+        if ((c == '"') || (c == '\\'))
+        {
+            eTemplatePrintf(&sOutput, "\\%c", c);
+        }
+        else
+        {
+            eTemplatePrintf(&sOutput, "\\u%04x", c);
+        }
+        pcRun = pcString + 1;
+    }
+    if (pcString > pcRun)
+    {
+        eTemplatePrintf(&sOutput, "%.*s", (int)(pcString - pcRun), pcRun);
     }
+    eTemplateWriteStatic(&sOutput, "\"");
+}
+
+
+/** Append a "name":"value" member to the current JSON object.
+ *  Members with no value are left out to keep the view model compact. */
+static void vJsonMember(const char *pcName, const char *pcValue, int *piFirst)
+{
+    if (!pcValue)
+    {
+        return;
+    }
+    eTemplatePrintf(&sOutput, "%s\"%s\":", *piFirst ? "" : ",", pcName);
+    vJsonString(pcValue);
+    *piFirst = 0;
+}
+
+
+/** Append the JSON status object */
+static void vJsonStatus(int iValue, const char *pcDescription)
+{
+    eTemplatePrintf(&sOutput, "\"Status\":{\"Value\":%d,\"Description\":", iValue);
+    vJsonString(pcDescription);
+    eTemplateWriteStatic(&sOutput, "}");
+}
+
+
+/** Send the JSON response that has been built up in sOutput.
+ *  \param pcETag       Quoted entity tag of the response, or NULL if it may not be cached.
+ *                      If the client already holds it, 304 is sent instead of sOutput. */
+static void vJsonSend(const char *pcETag)
+{
+    eResponseInit(&sResponse, STDOUT_FILENO);
     
-    if (!iValidConfigFile)
+    if (!pcETag)
     {
-        /* Not a valid config file */
+        eResponseHeader(&sResponse, "Content-type: application/json");
+        eResponseHeader(&sResponse, "Cache-Control: no-store");
+        eTemplateFlush(&sOutput, &sResponse);
+        eResponseFinish(&sResponse);
         return;
     }
     
-    if (strcmp(NodeName, "Device") == 0)
+    /* Tags are weak: the gzip'd and plain representations are equivalent but not byte identical */
+    if (iCGIETagMatches(pcETag))
     {
-        if (xmlTextReaderAttributeCount(reader) == 2)
-        {
-            teDeviceLookup eDeviceLookup = E_LOOKUP_NONE;
-            char *pcDeviceId = NULL;
-            uint32_t u32DeviceId = 0;
-            char *pcBaseType = NULL;
-            uint8_t u8BaseType = 0;
-            char *pcName     = NULL;
-            
-            pcDeviceId = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"ID");
-            if (pcDeviceId != NULL)
-            {
-                errno = 0;
-                u32DeviceId = strtoll(pcDeviceId, NULL, 16);
-                if (errno)
-                {
-                    perror("strtol");
-                    return;
-                }
-                eDeviceLookup = E_LOOKUP_DEVICEID;
-                free(pcDeviceId);
-            }
-            
-            pcBaseType = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"BaseType");
-            if (pcBaseType != NULL)
-            {
-                errno = 0;
-                u8BaseType = (uint8_t)strtoll(pcBaseType, NULL, 16);
-                if (errno)
-                {
-                    perror("strtol");
-                    return;
-                }
-                eDeviceLookup = E_LOOKUP_BASETYPE;
-                free(pcBaseType);
-            }
-            
-            if (eDeviceLookup == E_LOOKUP_NONE)
-            {
-                /* Need either device ID or base type to be specified */
-                return;
-            }
-            
-            pcName = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Name");
-            if (pcName == NULL)
-            {
-                return;
-            }
-            
-            u32NumDevices++;
-            {
-                tsDevice *psNewDevices = realloc(psDevices, sizeof(tsDevice) * (u32NumDevices));
-                
-                if (!psNewDevices)
-                {
-                    return;
-                }
-                else
-                {
-                    psDevices = psNewDevices;
-                }
-            }
+        eResponseHeader(&sResponse, "Status: 304 Not Modified");
+        eResponseHeader(&sResponse, "ETag: W/%s", pcETag);
+        vTemplateOutputFree(&sOutput);
+        eResponseFinish(&sResponse);
+        return;
+    }
+    
+    /* Always revalidate, so the browser asks with If-None-Match rather than using a stale copy */
+    eResponseHeader(&sResponse, "Content-type: application/json");
+    eResponseHeader(&sResponse, "Cache-Control: no-cache");
+    eResponseHeader(&sResponse, "ETag: W/%s", pcETag);
+    eTemplateFlush(&sOutput, &sResponse);
+    eResponseFinish(&sResponse);
+}
 
-            memset(&psDevices[u32NumDevices-1], 0, sizeof(tsDevice));
-            psDevices[u32NumDevices-1].eDeviceLookup = eDeviceLookup;
-            psDevices[u32NumDevices-1].u32DeviceId = u32DeviceId;
-            psDevices[u32NumDevices-1].u8BaseType = u8BaseType;
-            psDevices[u32NumDevices-1].pcName = pcName;
-            
-            eState = E_DEVICE;
 
-            //printf("Got Device, ID: 0x%08x, Name: %s\n", u32DeviceId, pcName);
-            return;
-        }
+/** Build the entity tag of the view model.
+ *  The view model only depends on the network snapshot and the configuration,
+ *  so the tag is made from their version stamps rather than from the body.
+ *  \param pcETag       Buffer for the quoted tag
+ *  \param szLength     Size of the buffer
+ *  \param u32Version   Version stamp of the network snapshot
+ */
+static void vViewETag(char *pcETag, size_t szLength, uint32_t u32Version)
+{
+    uint32_t u32Stamp = CGI_HASH_INIT;
+    
+    u32Stamp = u32CGIHash(u32Stamp, &u32Version, sizeof(uint32_t));
+    u32Stamp = u32CGIHash(u32Stamp, &sConfig.psHeader->i64SourceMtime, sizeof(int64_t));
+    u32Stamp = u32CGIHash(u32Stamp, &sConfig.psHeader->i64SourceSize, sizeof(int64_t));
+    snprintf(pcETag, szLength, "\"" VERSION "-%08x\"", u32Stamp);
+}
+
+
+/** Build the JSON view model of the page: devices, groups and scenes along 
+ *  with their controls from the configuration. Devices come from the node 
+ *  model of the latest snapshot, so this does not talk to the network unless
+ *  a refresh is asked for or there has never been a snapshot.
+ *  Device names are included where the snapshot has them; the page fetches
+ *  the rest afterwards with Mode=Names. */
+static int iViewModel(const char *pcRefresh)
+{
+    const tsConfigHeader *psHeader = sConfig.psHeader;
+    tsNetworkCacheModel sModel;
+    teNetworkCacheRefresh eRefresh = pcRefresh ? eNetworkCacheRefreshPolicy(pcRefresh) : E_NETWORK_CACHE_REFRESH_NEVER;
+    int iAge = 0;
+    int iFirst;
+    uint8_t *pu8Used;
+    uint32_t i;
+    uint32_t u32Version;
+    char acETag[32];
+    const char *pcETag = NULL;
+    
+    memset(&sModel, 0, sizeof(tsNetworkCacheModel));
+    eTemplateOutputInit(&sOutput);
+    eTemplateWriteStatic(&sOutput, "{");
+    
+    if (!psHeader)
+    {
+        vJsonStatus(E_CONFIG_ERROR, "No configuration");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
     }
-    else if (strcmp(NodeName, "Groups") == 0)
+    
+    if ((pcConnect_address) && 
+        (eNetworkCacheVersion(pcConnect_address, eRefresh, &u32Version) == E_NETWORK_CACHE_OK))
     {
-        if (xmlTextReaderAttributeCount(reader) == 0)
+        /* The snapshot will be used as it is - the client's copy may already be current */
+        vViewETag(acETag, sizeof(acETag), u32Version);
+        if (iCGIETagMatches(acETag))
         {
-            eState = E_GROUPS;
-            return;
+            vJsonSend(acETag);
+            return 0;
         }
     }
-    else if (strcmp(NodeName, "Scenes") == 0)
+    
+    if (!pcConnect_address)
+    {
+        vJsonStatus(E_JIP_ERROR_FAILED, "Failed to find gateway address");
+    }
+    else if (eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK)
     {
-        if (xmlTextReaderAttributeCount(reader) == 0)
+        vJsonStatus(E_JIP_ERROR_FAILED, "JIP startup failed");
+    }
+    else
+    {
+        /* Only connects to the border router if the network must be rediscovered */
+        eBrokerLinkOpen(&sLink, &sJIP_Context, pcConnect_address);
+        if (eBrokerAcquireModel(&sLink, eRefresh, &sModel, &iAge) != E_JIP_OK)
         {
-            eState = E_SCENES;
-            return;
+            vJsonStatus(E_JIP_ERROR_FAILED, "JIP discover network failed");
+        }
+        else
+        {
+            vViewETag(acETag, sizeof(acETag), sModel.psHeader->u32Version);
+            pcETag = acETag;
+            if (iCGIETagMatches(acETag))
+            {
+                vNetworkCacheModelClose(&sModel);
+                vBrokerLinkClose(&sLink);
+                eJIP_Destroy(&sJIP_Context);
+                vJsonSend(acETag);
+                return 0;
+            }
+            vJsonStatus(E_JIP_OK, "Success");
         }
+        vBrokerLinkClose(&sLink);
+        eJIP_Destroy(&sJIP_Context);
     }
+    eTemplatePrintf(&sOutput, ",\"Age\":%d", iAge);
     
+    /* Controls shared by all groups, and by all scenes */
+    iFirst = 1;
+    eTemplateWriteStatic(&sOutput, ",\"GroupControls\":{");
+    vJsonMember("StateMib",     CONFIG_STRING(psHeader->u32GroupStateControlMib), &iFirst);
+    vJsonMember("StateVar",     CONFIG_STRING(psHeader->u32GroupStateControlVar), &iFirst);
+    vJsonMember("LevelMib",     CONFIG_STRING(psHeader->u32GroupLevelControlMib), &iFirst);
+    vJsonMember("LevelVar",     CONFIG_STRING(psHeader->u32GroupLevelControlVar), &iFirst);
+    vJsonMember("LevelMax",     CONFIG_STRING(psHeader->u32GroupLevelControlMax), &iFirst);
+    eTemplateWriteStatic(&sOutput, "},\"SceneControls\":{");
+    iFirst = 1;
+    vJsonMember("Mib",          CONFIG_STRING(psHeader->u32SceneControlMib), &iFirst);
+    vJsonMember("Var",          CONFIG_STRING(psHeader->u32SceneControlVar), &iFirst);
+    eTemplateWriteStatic(&sOutput, "}");
     
-    switch (eState)
+    if (psHeader->sGlobalGroup.u32Name)
     {
-        case E_DEVICE:
+        eTemplateWriteStatic(&sOutput, ",\"Global\":{");
+        iFirst = 1;
+        vJsonMember("Name",     CONFIG_STRING(psHeader->sGlobalGroup.u32Name), &iFirst);
+        vJsonMember("Address",  CONFIG_STRING(psHeader->sGlobalGroup.u32Address), &iFirst);
+        eTemplateWriteStatic(&sOutput, "}");
+    }
+    
+    eTemplateWriteStatic(&sOutput, ",\"Groups\":[");
+    for (i = 0; i < psHeader->u32NumGroups; i++)
+    {
+        eTemplateWriteStatic(&sOutput, i ? ",{" : "{");
+        iFirst = 1;
+        vJsonMember("Name",     CONFIG_STRING(sConfig.psGroups[i].u32Name), &iFirst);
+        vJsonMember("Address",  CONFIG_STRING(sConfig.psGroups[i].u32Address), &iFirst);
+        eTemplateWriteStatic(&sOutput, "}");
+    }
+    
+    eTemplateWriteStatic(&sOutput, "],\"Scenes\":[");
+    for (i = 0; i < psHeader->u32NumScenes; i++)
+    {
+        eTemplateWriteStatic(&sOutput, i ? ",{" : "{");
+        iFirst = 1;
+        vJsonMember("Name",     CONFIG_STRING(sConfig.psScenes[i].u32Name), &iFirst);
+        vJsonMember("Address",  CONFIG_STRING(sConfig.psScenes[i].u32Address), &iFirst);
+        vJsonMember("Value",    CONFIG_STRING(sConfig.psScenes[i].u32Value), &iFirst);
+        vJsonMember("Image",    CONFIG_STRING(sConfig.psScenes[i].u32Image), &iFirst);
+        eTemplateWriteStatic(&sOutput, "}");
+    }
+    
+    /* Controls of each device entry, referred to by index from the devices.
+     * Entries that match no node in the network are sent as null. */
+    pu8Used = pvArenaZalloc(&sCGI.sArena, (psHeader->u32NumDevices + 1) * sizeof(uint8_t));
+    for (i = 0; (pu8Used) && (sModel.psHeader) && (i < sModel.psHeader->u32NumNodes); i++)
+    {
+        const tsConfigDevice *psDevice = psConfigLookupDevice(&sConfig, sModel.psNodes[i].u32DeviceId);
+        if (psDevice)
         {
-            if (strcmp(NodeName, "Image") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 1)
-                {
-                    psDevices[u32NumDevices-1].pcImage = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"src");
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "StateControl") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 2)
-                {
-                    psDevices[u32NumDevices-1].pcStateControlMib = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"MiB");
-                    psDevices[u32NumDevices-1].pcStateControlVar = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Var");
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "LevelControl") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 3)
-                {
-                    psDevices[u32NumDevices-1].pcLevelControlMib = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"MiB");
-                    psDevices[u32NumDevices-1].pcLevelControlVar = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Var");
-                    psDevices[u32NumDevices-1].pcLevelControlMax = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Max");
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "LevelFeedback") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 3)
-                {
-                    char *pcLocalUpdate;
-                    psDevices[u32NumDevices-1].pcLevelFeedbackMib   = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"MiB");
-                    psDevices[u32NumDevices-1].pcLevelFeedbackVar   = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Var");
-                    psDevices[u32NumDevices-1].pcLevelFeedbackLabel = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Label");
-                    return;
-                }
-            }
-            
-            break;
+            pu8Used[psDevice - sConfig.psDevices] = 1;
         }
+    }
+    
+    eTemplateWriteStatic(&sOutput, "],\"Profiles\":[");
+    for (i = 0; i < psHeader->u32NumDevices; i++)
+    {
+        const tsConfigDevice *psDevice = &sConfig.psDevices[i];
         
-        case E_GROUPS:
+        if ((pu8Used) && (!pu8Used[i]))
         {
-            if (strcmp(NodeName, "StateControl") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 2)
-                {
-                    pcGroupStateControlMib      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"MiB");
-                    pcGroupStateControlVar      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Var");
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "LevelControl") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 3)
-                {
-                    pcGroupLevelControlMib      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"MiB");
-                    pcGroupLevelControlVar      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Var");
-                    pcGroupLevelControlMax      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Max");
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "Global") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 2)
-                {
-                    psGlobalGroup = malloc(sizeof(tsGroup));
-                    if (!psGlobalGroup) return;
-                    psGlobalGroup->pcName       = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Name");
-                    psGlobalGroup->pcAddress    = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Address");
-                    
-                    if (!psGlobalGroup->pcName || !psGlobalGroup->pcAddress)
-                    {
-                        free(psGlobalGroup);
-                        psGlobalGroup = NULL;
-                    }
-                    else
-                    {
-                        //printf("Loaded global group\n");
-                    }
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "Group") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 2)
-                {
-                    char *pcName = NULL;
-                    char *pcAddress = NULL;
-                    
-                    pcName      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Name");
-                    pcAddress   = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Address");
-                    
-                    if (!(pcName && pcAddress))
-                    {
-                        return;
-                    }
-                    
-                    u32NumGroups++;
-                    {
-                        tsGroup *psNewGroups = realloc(psGroups, sizeof(tsGroup) * (u32NumGroups));
-                        
-                        if (!psNewGroups)
-                        {
-                            return;
-                        }
-                        else
-                        {
-                            psGroups = psNewGroups;
-                        }
-                    }
-
-                    psGroups[u32NumGroups-1].pcName     = pcName;
-                    psGroups[u32NumGroups-1].pcAddress  = pcAddress;
-                    
-                    //printf("Loaded group name %s, address %s\n", pcName, pcAddress);
-                    return;
-                }
-            }
-            
-            break;
+            eTemplateWriteStatic(&sOutput, i ? ",null" : "null");
+            continue;
         }
-            
-        case E_SCENES:
+        eTemplateWriteStatic(&sOutput, i ? ",{" : "{");
+        iFirst = 1;
+        vJsonMember("Image",        CONFIG_STRING(psDevice->u32Image), &iFirst);
+        vJsonMember("StateMib",     CONFIG_STRING(psDevice->u32StateControlMib), &iFirst);
+        vJsonMember("StateVar",     CONFIG_STRING(psDevice->u32StateControlVar), &iFirst);
+        vJsonMember("LevelMib",     CONFIG_STRING(psDevice->u32LevelControlMib), &iFirst);
+        vJsonMember("LevelVar",     CONFIG_STRING(psDevice->u32LevelControlVar), &iFirst);
+        vJsonMember("LevelMax",     CONFIG_STRING(psDevice->u32LevelControlMax), &iFirst);
+        vJsonMember("FeedbackMib",  CONFIG_STRING(psDevice->u32LevelFeedbackMib), &iFirst);
+        vJsonMember("FeedbackVar",  CONFIG_STRING(psDevice->u32LevelFeedbackVar), &iFirst);
+        vJsonMember("FeedbackLabel",CONFIG_STRING(psDevice->u32LevelFeedbackLabel), &iFirst);
+        eTemplateWriteStatic(&sOutput, "}");
+    }
+    
+    eTemplateWriteStatic(&sOutput, "],\"Devices\":[");
+    iFirst = 1;
+    for (i = 0; (sModel.psHeader) && (i < sModel.psHeader->u32NumNodes); i++)
+    {
+        const tsNetworkCacheNode *psNode = &sModel.psNodes[i];
+        const tsConfigDevice *psDevice = psConfigLookupDevice(&sConfig, psNode->u32DeviceId);
+        char acAddress[INET6_ADDRSTRLEN] = "";
+        
+        if (!psDevice)
         {
-            if (strcmp(NodeName, "SceneControl") == 0)
-            {
-                if (xmlTextReaderAttributeCount(reader) == 2)
-                {
-                    pcSceneControlMib      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"MiB");
-                    pcSceneControlVar      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Var");
-                    //printf("Scene control MiB is %s, var is %s\n", pcSceneControlMib, pcSceneControlVar);
-                    return;
-                }
-            }
-            else if (strcmp(NodeName, "Scene") == 0)
-            {
-                int attributes = xmlTextReaderAttributeCount(reader);
-                if (attributes >= 3 && attributes <= 4)
-                {
-                    char *pcName = NULL;
-                    char *pcAddress = NULL;
-                    char *pcValue = NULL;
-                    char *pcImage = NULL;
-                    
-                    pcName      = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Name");
-                    pcAddress   = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Address");
-                    pcValue     = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Value");
-                    pcImage     = (char *)xmlTextReaderGetAttribute(reader, (unsigned char *)"Image");
-                    
-                    if (!(pcName && pcAddress && pcValue))
-                    {
-                        return;
-                    }
-                    
-                    u32NumScenes++;
-                    {
-                        tsScene *psNewScenes = realloc(psScenes, sizeof(tsScene) * (u32NumScenes));
-                        
-                        if (!psNewScenes)
-                        {
-                            return;
-                        }
-                        else
-                        {
-                            psScenes = psNewScenes;
-                        }
-                    }
-
-                    psScenes[u32NumScenes-1].pcName     = pcName;
-                    psScenes[u32NumScenes-1].pcAddress  = pcAddress;
-                    psScenes[u32NumScenes-1].pcValue    = pcValue;
-                    psScenes[u32NumScenes-1].pcImage    = pcImage;
-                    
-                    //printf("Loaded Scene name %s, address %s, value %s, image %s\n", pcName, pcAddress, pcValue, pcImage);
-                }
-            }
+            /* Not handling this device ID */
+            continue;
+        }
+        inet_ntop(AF_INET6, &psNode->sAddress, acAddress, INET6_ADDRSTRLEN);
+        
+        eTemplatePrintf(&sOutput, "%s{\"Address\":\"%s\",\"DeviceID\":%u,\"Profile\":%d", 
+                        iFirst ? "" : ",", acAddress, psNode->u32DeviceId, (int)(psDevice - sConfig.psDevices));
+        if (psNode->u32Name)
+        {
+            eTemplateWriteStatic(&sOutput, ",\"Name\":");
+            vJsonString(pcNetworkCacheModelString(&sModel, psNode->u32Name));
         }
+        eTemplateWriteStatic(&sOutput, "}");
+        iFirst = 0;
     }
+    eTemplateWriteStatic(&sOutput, "]}");
     
-    return;
+    vNetworkCacheModelClose(&sModel);
+    vJsonSend(pcETag);
+    return 0;
 }
 
 
-static const int read_config(void)
+/** Read the names of configured devices from the network in one request,
+ *  for the devices that the view model had no name for.
+ *  \param pcAddress    Address of a single device to read, or NULL for all devices */
+static int iNames(const char *pcAddress)
 {
-    xmlTextReaderPtr reader;
-    int ret;
+    tsNodeWalk sWalk;
+    tsNode *psNode;
+    int iFirst = 1;
     
-    int iNumAddresses;
-    struct in6_addr *asAddresses;
-    if (ZC_Get_Module_Addresses(&asAddresses, &iNumAddresses) != 0)
+    eTemplateOutputInit(&sOutput);
+    eTemplateWriteStatic(&sOutput, "{");
+    
+    if ((!pcConnect_address) || (!sConfig.psHeader))
     {
-        printf("Could not get coordinator address\n");
+        vJsonStatus(E_JIP_ERROR_FAILED, "Failed to find gateway address");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
     }
-    else
+    
+    if ((eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK) ||
+        (eBrokerLinkOpen(&sLink, &sJIP_Context, pcConnect_address) != E_JIP_OK) ||
+        (eBrokerAcquireNetwork(&sLink, E_NETWORK_CACHE_REFRESH_NEVER, NULL) != E_JIP_OK))
     {
-        if (iNumAddresses != 1)
-        {
-            printf("Discovered an unhandled number of coordinators (%d)\n", iNumAddresses);
-        }
-        else
-        {
-            char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
-            /* Just use the first one for now */
-            inet_ntop(AF_INET6, asAddresses, buffer, INET6_ADDRSTRLEN);
-            
-            //printf("Got address %s\n", buffer);
-            
-            pcConnect_address = strdup(buffer);
-        }
-        free(asAddresses);
+        vJsonStatus(E_JIP_ERROR_FAILED, "JIP discover network failed");
+        eTemplateWriteStatic(&sOutput, "}");
+        vBrokerLinkClose(&sLink);
+        eJIP_Destroy(&sJIP_Context);
+        vJsonSend(NULL);
+        return -1;
     }
     
-    /* Load xml config file */
-    LIBXML_TEST_VERSION
+    vJsonStatus(E_JIP_OK, "Success");
+    eTemplateWriteStatic(&sOutput, ",\"Names\":{");
     
-    reader = xmlReaderForFile(CONFIG_FILE_NAME, NULL, 0);
-    if (reader != NULL)
+    /* Each name is read over the network with only its node locked */
+    (void)eNodeWalkStart(&sWalk, &sJIP_Context, JIP_DEVICEID_ALL);
+    for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
     {
-        ret = xmlTextReaderRead(reader);
-        //printf("Read: %d\n", ret);
-        while (ret == 1)
+        char acAddress[INET6_ADDRSTRLEN] = "";
+        tsMib *psMib;
+        tsVar *psVar;
+        
+        inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, acAddress, INET6_ADDRSTRLEN);
+        
+        if ((pcAddress) && (strcmp(pcAddress, acAddress) != 0))
         {
-            processNode(reader);
-            ret = xmlTextReaderRead(reader);
+            continue;
         }
-        xmlFreeTextReader(reader);
-        if (ret != 0) {
-            return 0;
+        if (!psConfigLookupDevice(&sConfig, psNode->u32DeviceId))
+        {
+            continue;
+        }
+        
+        psMib = psJIP_LookupMib(psNode, NULL, "Node");
+        psVar = psMib ? psJIP_LookupVar(psMib, NULL, "DescriptiveName") : NULL;
+        if ((psVar) && (eBrokerGetVar(&sLink, psVar) == E_JIP_OK) && 
+            (psVar->pvData) && (psVar->eVarType == E_JIP_VAR_TYPE_STR))
+        {
+            eTemplatePrintf(&sOutput, "%s\"%s\":", iFirst ? "" : ",", acAddress);
+            vJsonString((const char *)psVar->pvData);
+            iFirst = 0;
         }
-    } else {
-        return 0;
     }
+    vNodeWalkEnd(&sWalk);
+    eTemplateWriteStatic(&sOutput, "}}");
     
-
+    vBrokerLinkClose(&sLink);
+    eJIP_Destroy(&sJIP_Context);
+    vJsonSend(NULL);
     return 0;
 }
 
 
-int Menu(const char *pcName, const char *pcAddress, const char *pcImage,
-         const char *pcStateControlMib, const char *pcStateControlVar,
-         const char *pcLevelControlMib, const char *pcLevelControlVar, const char *pcLevelControlMax,
-         const char *pcLevelFeedbackMib, const char *pcLevelFeedbackVar, const char *pcLevelFeedbackLabel)
+/** Send the aggregated state of the configured groups from the group model.
+ *  Only the group table is read, so this costs the same however many nodes
+ *  there are, and nothing is read from the network. */
+static int iGroupState(void)
 {
-    static int MenuID = 0;
-    char *pcIPv6URL;
+    const tsConfigHeader *psHeader = sConfig.psHeader;
+    char acETag[32];
+    uint32_t u32Stamp = CGI_HASH_INIT;
+    uint32_t i;
+    int iFirst = 1;
     
-    if (eCGIURLEncode(&pcIPv6URL, pcAddress) != E_CGI_OK)
-    {
-        pcIPv6URL = strdup("Unknown Address");
-    }
-
-    printf("<div class=\"Lamp\">");
-    printf("<span>IPv6 Address: %s</span>\n", pcAddress);
-    printf("<h2>%s</h2>\n", pcName);
-
-    printf("<div class=\"Lamp_Image\">");
-    if (pcImage)
-    {
-        printf("  <img src=\"%s\" />\n", pcImage);
-    }
-    printf("</div>\n\n");
+    eTemplateOutputInit(&sOutput);
+    eTemplateWriteStatic(&sOutput, "{");
     
-    if ((pcStateControlMib) && (pcStateControlVar))
+    if ((!psHeader) || (eGroupModelRead(&sGroupView) != E_GROUP_MODEL_OK))
     {
-        printf("  <div class=\"button\" onclick=\"UpdateVariable('%s', '%s', '%s', '0')\">Off</div> \n", 
-               pcIPv6URL, pcStateControlMib, pcStateControlVar);
-        printf("  <div class=\"button\" onclick=\"UpdateVariable('%s', '%s', '%s', '1')\">On</div>\n", 
-               pcIPv6URL, pcStateControlMib, pcStateControlVar);
+        vJsonStatus(E_JIP_ERROR_FAILED, "No group state available");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
     }
     
-    if ((pcLevelControlMib) && (pcLevelControlVar) && (pcLevelControlMax))
+    u32Stamp = u32CGIHash(u32Stamp, &sGroupView.sHeader.u32Version, sizeof(uint32_t));
+    u32Stamp = u32CGIHash(u32Stamp, &sGroupView.sHeader.i64Built, sizeof(int64_t));
+    u32Stamp = u32CGIHash(u32Stamp, &psHeader->i64SourceMtime, sizeof(int64_t));
+    snprintf(acETag, sizeof(acETag), "\"" VERSION "-g%08x\"", u32Stamp);
+    if (iCGIETagMatches(acETag))
     {
-        printf("  <div class=\"slider\" id=\"slider%d\" ></div> \n\
-            <script language=\"javascript\"> \n\
-            var lampslider%d = new SimpleSlider(\"slider%d\", 710, 50); \n\
-            lampslider%d.onNewPosition = function() { \
-                var pos = parseInt(lampslider%d.position * %s); \n", 
-               MenuID, MenuID, MenuID, MenuID, MenuID, pcLevelControlMax);
-
-        printf("                UpdateVariable('%s', '%s', '%s', pos) \n} \n</script>", 
-               pcIPv6URL, pcLevelControlMib, pcLevelControlVar);
+        vGroupModelViewFree(&sGroupView);
+        vJsonSend(acETag);
+        return 0;
     }
     
-    if ((pcLevelFeedbackMib) && (pcLevelFeedbackVar) && (pcLevelFeedbackLabel))
+    vJsonStatus(E_JIP_OK, "Success");
+    eTemplatePrintf(&sOutput, ",\"Age\":%d,\"Groups\":[", (int)(time(NULL) - sGroupView.sHeader.i64Built));
+    
+    for (i = 0; i <= psHeader->u32NumGroups; i++)
     {
+        const tsConfigGroup *psGroup = i ? &sConfig.psGroups[i - 1] : &psHeader->sGlobalGroup;
+        const tsGroupModelGroup *psModelGroup;
+        struct in6_addr sAddress;
         
-        printf("<div class='feedback' id='feedback%d'> \n \
-            <script language=\"javascript\"> \n\
-            var Monitor%d = new JIP_Monitor(%d, '%s', '%s', '%s', function(value) { \n\
-                if (typeof(value)=='string') \n\
-                { \n\
-                    var newvalue=parseInt(value);\n\
-                    if (newvalue < 0) \n\
-                    { \n\
-                        newvalue = 0; \n\
-                    } \n\
-                    value = newvalue.toString(); \n\
-                    document.getElementById('feedback%d').innerHTML = '%s ' + value; \n\
-                    feedback_graph%d_update(value); \n\
-                } \n\
-                else \n\
-                { \n\
-                    alert(\"Non-string!\"); \n\
-                } \n\
-            })\n\
-            </script> \n\
-            </div>\n",
-            MenuID, MenuID, MenuID, pcIPv6URL, pcLevelFeedbackMib, pcLevelFeedbackVar, MenuID, pcLevelFeedbackLabel, MenuID);
+        if ((!psGroup->u32Address) ||
+            (inet_pton(AF_INET6, CONFIG_STRING(psGroup->u32Address), &sAddress) != 1) ||
+            (!(psModelGroup = psGroupModelLookupGroup(&sGroupView, &sAddress))))
+        {
+            continue;
+        }
         
-        printf("<div> \n\
-            <canvas class='feedback_graph' id='feedback_graph%d'></canvas> \n\
-            \n\
-            </div> \n\
-            <script language=\"javascript\"> \n\
-            var history_length = 60; \n\
-            var history%d = [] ; \n\
-             \n\
-            /* wait for drawing */ \n\
-            window.setTimeout( \n\
-            function() { \n\
-            /* prefill datasets */ \n\
-            for (var i = 0; i < history_length; i++) \n\
-            { \n\
-                history%d[i] = 0; \n\
-            } \n\
-            }, 1000)\n\
-            \n\
-            function feedback_graph%d_update(value) \n\
-            {\n\
-                var newvalue=parseFloat(value);\n\
-                if (isNaN(newvalue))\n\
-                {\n\
-                return;\n\
-                }\n\
-                history%d.push(newvalue);\n\
-                history%d = history%d.slice(history%d.length - history_length, history%d.length); \n\
-                var data_max = 0; \n\
-                for (var i = 0; i < history%d.length; i++) \n\
-                {\n\
-                    data_max = Math.max(data_max, history%d[i]);\n\
-                }\n\
-                if (data_max < 50) data_max = 50; \n\
-                var canvas  = document.getElementById('feedback_graph%d'); \n\
-                var ctx     = canvas.getContext(\"2d\"); \n\
-                var step   = canvas.width / history_length;\n\
-                var data_scale = canvas.height / (data_max * 1.2); \n\
-                ctx.clearRect(0,0,canvas.width, canvas.height); \n\
-                ctx.strokeStyle='#222222'\n\
-                ctx.beginPath(); \n\
-                ctx.moveTo(0, Math.floor(canvas.height - 8 - history%d[0] * data_scale)); \n\
-                for (var i = 1; i < history%d.length; i++)\n\
-                {\n\
-                    ctx.lineTo((i * step), Math.floor(canvas.height - 8 - history%d[i] * data_scale));\n\
-                }\n\
-                ctx.stroke()\n\
-            \n\
-            }\n\
-            \n\
-            </script> \n\
-            ", MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID, MenuID,  MenuID, MenuID);
-
+        eTemplatePrintf(&sOutput, "%s{\"Address\":", iFirst ? "" : ",");
+        vJsonString(CONFIG_STRING(psGroup->u32Address));
+        eTemplatePrintf(&sOutput, ",\"State\":\"%s\",\"Members\":%u,\"On\":%u,\"Off\":%u,\"Level\":%d}",
+                        pcGroupModelState(eGroupModelGroupState(psModelGroup)), psModelGroup->u32Members,
+                        psModelGroup->u32On, psModelGroup->u32Off, i32GroupModelGroupLevel(psModelGroup));
+        iFirst = 0;
     }
-
-    free(pcIPv6URL);
-    
-    printf("</div>\n\n");
-    
-    MenuID++;
+    eTemplateWriteStatic(&sOutput, "]}");
     
+    vGroupModelViewFree(&sGroupView);
+    vJsonSend(acETag);
     return 0;
 }
 
 
-int DeviceMenu(tsDevice *psDevice, const char *pcName, const char *pcAddress)
-{
-    return Menu(pcName, pcAddress, psDevice->pcImage,
-                psDevice->pcStateControlMib, psDevice->pcStateControlVar,
-                psDevice->pcLevelControlMib, psDevice->pcLevelControlVar, psDevice->pcLevelControlMax,
-                psDevice->pcLevelFeedbackMib, psDevice->pcLevelFeedbackVar, psDevice->pcLevelFeedbackLabel);
-}
-
-
-int GroupMenu(tsGroup *psGroup)
+/** Execute a configured scene: multicast it, then make sure every node 
+ *  applied it, within the scene's budget.
+ *  Nodes can only be checked when the scene is sent to the global group, as
+ *  that is the only group whose members are known. Scenes sent to any other
+ *  group are multicast only.
+ *  \param pcScene      Index of the scene in the configuration */
+static int iRunScene(const char *pcScene)
 {
-    return Menu(psGroup->pcName, psGroup->pcAddress, NULL,
-                pcGroupStateControlMib, pcGroupStateControlVar,
-                pcGroupLevelControlMib, pcGroupLevelControlVar, pcGroupLevelControlMax,
-                NULL, NULL, NULL);
-}
-
-
-int SceneMenu(tsScene *psScene)
-{
-    char *pcIPv6URL;
+    const tsConfigScene *psScene;
+    tsScenePlan sPlan;
+    tsSceneResult sResult;
+    teSceneStatus eStatus;
+    char *pcEnd;
+    unsigned long ulScene;
+    uint32_t i;
+    int iFirst = 1;
     
-    if (eCGIURLEncode(&pcIPv6URL, psScene->pcAddress) != E_CGI_OK)
+    eTemplateOutputInit(&sOutput);
+    eTemplateWriteStatic(&sOutput, "{");
+    
+    if ((!pcConnect_address) || (!sConfig.psHeader))
     {
-        pcIPv6URL = strdup("Unknown Address");
+        vJsonStatus(E_JIP_ERROR_FAILED, "Failed to find gateway address");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
     }
     
-    printf("<div class=\"Scene\" onclick=\"UpdateVariable('%s', '%s', '%s', '%s')\">%s", 
-           pcIPv6URL, pcSceneControlMib, pcSceneControlVar, psScene->pcValue, psScene->pcName);
-
-    if (psScene->pcImage)
+    ulScene = pcScene ? strtoul(pcScene, &pcEnd, 10) : 0;
+    if ((!pcScene) || (pcEnd == pcScene) || (*pcEnd != '\0') || (ulScene >= sConfig.psHeader->u32NumScenes))
     {
-        printf("<img src=\"%s\" />\n", psScene->pcImage);
+        vJsonStatus(E_JIP_ERROR_BAD_VALUE, "Unknown scene");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
     }
-    printf("</div>");
-    free(pcIPv6URL);
-    return 0;
+    psScene = &sConfig.psScenes[ulScene];
+    
+    memset(&sPlan, 0, sizeof(tsScenePlan));
+    if (inet_pton(AF_INET6, CONFIG_STRING(psScene->u32Address), &sPlan.sGroupAddress) <= 0)
+    {
+        vJsonStatus(E_JIP_ERROR_BAD_VALUE, "Invalid scene address");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
+    }
+    sPlan.pcMib         = CONFIG_STRING(sConfig.psHeader->u32SceneControlMib);
+    sPlan.pcVar         = CONFIG_STRING(sConfig.psHeader->u32SceneControlVar);
+    sPlan.pcValue       = CONFIG_STRING(psScene->u32Value);
+    sPlan.u32Hops       = psScene->u32Hops      ? psScene->u32Hops      : SCENE_DEFAULT_HOPS;
+    sPlan.u32Budget     = psScene->u32Budget    ? psScene->u32Budget    : SCENE_DEFAULT_BUDGET;
+    sPlan.u32Retries    = psScene->u32Retries   ? psScene->u32Retries   : SCENE_DEFAULT_RETRIES;
+    sPlan.iVerify       = (sConfig.psHeader->sGlobalGroup.u32Address) &&
+                          (strcasecmp(CONFIG_STRING(psScene->u32Address), 
+                                      CONFIG_STRING(sConfig.psHeader->sGlobalGroup.u32Address)) == 0);
+    
+    if ((!sPlan.pcMib) || (!sPlan.pcVar))
+    {
+        vJsonStatus(E_JIP_ERROR_FAILED, "No scene control configured");
+        eTemplateWriteStatic(&sOutput, "}");
+        vJsonSend(NULL);
+        return -1;
+    }
+    
+    if ((eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK) ||
+        (eJIP_Connect(&sJIP_Context, pcConnect_address, JIP_DEFAULT_PORT) != E_JIP_OK) ||
+        (eNetworkCacheAcquire(&sJIP_Context, pcConnect_address, E_NETWORK_CACHE_REFRESH_AUTO, NULL) != E_JIP_OK))
+    {
+        vJsonStatus(E_JIP_ERROR_FAILED, "JIP discover network failed");
+        eTemplateWriteStatic(&sOutput, "}");
+        eJIP_Destroy(&sJIP_Context);
+        vJsonSend(NULL);
+        return -1;
+    }
+    
+    eStatus = eSceneExecute(&sJIP_Context, &sPlan, &sResult);
+    switch (eStatus)
+    {
+        case (E_SCENE_OK):
+            vJsonStatus(sResult.eMulticastStatus, pcJIP_strerror(sResult.eMulticastStatus));
+            break;
+        case (E_SCENE_NO_NODES):
+            vJsonStatus(E_JIP_ERROR_FAILED, "No node has the scene control");
+            break;
+        case (E_SCENE_BAD_VALUE):
+            vJsonStatus(E_JIP_ERROR_BAD_VALUE, "Invalid scene value");
+            break;
+        default:
+            vJsonStatus(E_JIP_ERROR_FAILED, "Scene failed");
+            break;
+    }
+    
+    if (eStatus == E_SCENE_OK)
+    {
+        eTemplateWriteStatic(&sOutput, ",\"Scene\":{");
+        vJsonMember("Name",     CONFIG_STRING(psScene->u32Name), &iFirst);
+        eTemplatePrintf(&sOutput, ",\"Verified\":%s,\"Elapsed\":%u,\"Budget\":%u",
+                        sPlan.iVerify ? "true" : "false", sResult.u32Elapsed, sPlan.u32Budget);
+        eTemplatePrintf(&sOutput, ",\"Applied\":%u,\"Retried\":%u,\"Failed\":%u,\"Unverified\":%u,\"Nodes\":[",
+                        sResult.au32Count[E_SCENE_NODE_APPLIED], sResult.au32Count[E_SCENE_NODE_RETRIED],
+                        sResult.au32Count[E_SCENE_NODE_FAILED], sResult.au32Count[E_SCENE_NODE_UNVERIFIED]);
+        
+        for (i = 0; i < sResult.u32NumNodes; i++)
+        {
+            char acAddress[INET6_ADDRSTRLEN] = "";
+            
+            inet_ntop(AF_INET6, &sResult.psNodes[i].sAddress, acAddress, INET6_ADDRSTRLEN);
+            eTemplatePrintf(&sOutput, "%s{\"IPv6Address\":\"%s\",\"Result\":\"%s\",\"Attempts\":%u}",
+                            i ? "," : "", acAddress, pcSceneNodeResult(sResult.psNodes[i].eResult), 
+                            sResult.psNodes[i].u32Attempts);
+        }
+        eTemplateWriteStatic(&sOutput, "]}");
+        vSceneResultFree(&sResult);
+    }
+    eTemplateWriteStatic(&sOutput, "}");
+    
+    eJIP_Destroy(&sJIP_Context);
+    vJsonSend(NULL);
+    return eStatus == E_SCENE_OK ? 0 : -1;
 }
 
 
-
-int main(int argc, char *argv[])
+int CGI_MAIN(Smart_Devices_cgi)(int argc, char *argv[])
 {
     char *pcUpdateAddress;
     char *pcUpdateMib;
@@ -765,6 +847,9 @@ int main(int argc, char *argv[])
     
     char *pcViewAddress;
     char *pcMode;
+    char *pcRefresh;
+    char *pcBRAddress;
+    teNetworkCacheRefresh eRefresh;
     
     if (eCGIReadVariables(&sCGI) != E_CGI_OK)
     {
@@ -784,52 +869,119 @@ int main(int argc, char *argv[])
     pcUpdateValue       = pcCGIGetValue(&sCGI, "value");
     pcUpdateValue       = pcCGIGetValue(&sCGI, "value");
     pcViewAddress       = pcCGIGetValue(&sCGI, "address");
+    pcRefresh           = pcCGIGetValue(&sCGI, "refresh");
+    pcBRAddress         = pcCGIGetValue(&sCGI, "BRaddress");
 
-    printf("Content-type: text/html\r\n\r\n");
+    if ((strcmp(pcMode, "View") == 0) || (strcmp(pcMode, "Names") == 0) || 
+        (strcmp(pcMode, "RunScene") == 0) || (strcmp(pcMode, "GroupState") == 0))
+    {
+        /* JSON modes for the static page. These send their own headers once the response is known. */
+        int iResult;
+        
+        read_config(pcBRAddress);
+        if (strcmp(pcMode, "View") == 0)
+        {
+            iResult = iViewModel(pcRefresh);
+        }
+        else if (strcmp(pcMode, "Names") == 0)
+        {
+            iResult = iNames(pcViewAddress);
+        }
+        else if (strcmp(pcMode, "GroupState") == 0)
+        {
+            iResult = iGroupState();
+        }
+        else
+        {
+            iResult = iRunScene(pcCGIGetValue(&sCGI, "scene"));
+        }
+        vConfigUnload(&sConfig);
+        vCGIFree(&sCGI);
+        return iResult;
+    }
 
-    read_config();
+    eResponseInit(&sResponse, STDOUT_FILENO);
+    eResponseHeader(&sResponse, "Content-type: text/html");
+
+    read_config(pcBRAddress);
     
     if (pcConnect_address == NULL)
     {
-        printf("Failed to find gateway address\n");
+        eResponsePrintf(&sResponse, "Failed to find gateway address\n");
+        eResponseFinish(&sResponse);
         return -1;
     }
+    
+    if ((pcUpdateAddress) && (pcUpdateMib) && (pcUpdateVar) && (pcUpdateValue) &&
+        (strncasecmp(pcUpdateAddress, "FF", 2) != 0))
+    {
+        tsCoalesceReply sReply;
+        teCoalesceStatus eCoalesceStatus;
+        
+        /* Sliders send a SetVar for every step they are dragged. JIPd
+         * collapses them into the latest value, without this page
+         * loading the network */
+        eCoalesceStatus = eCoalesceSetVar(pcConnect_address, pcUpdateAddress, pcUpdateMib, pcUpdateVar, pcUpdateValue, &sReply);
+        
+        /* Unless it was never sent, JIPd may already have made it. Setting it
+         * again could repeat it after a newer value from another client */
+        if ((eCoalesceStatus == E_COALESCE_OK) || (eCoalesceStatus == E_COALESCE_ERROR))
+        {
+            eResponsePrintf(&sResponse, "<div>Update address %s, mib %s, var %s to value %s\n", pcUpdateAddress, pcUpdateMib, pcUpdateVar, pcUpdateValue);
+            if (eCoalesceStatus == E_COALESCE_ERROR)
+            {
+                eResponsePrintf(&sResponse, "Error setting new value\n");
+            }
+            else if (sReply.u32Superseded)
+            {
+                eResponsePrintf(&sResponse, "Superseded\n");
+            }
+            else if (sReply.i32Status != E_JIP_OK)
+            {
+                eResponsePrintf(&sResponse, "Error setting new value\n");
+            }
+            else
+            {
+                eResponsePrintf(&sResponse, "Success\n");
+            }
+            eResponsePrintf(&sResponse, "</div>");
+            eResponseFinish(&sResponse);
+            vConfigUnload(&sConfig);
+            vCGIFree(&sCGI);
+            return 0;
+        }
+    }
 
     if (eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK)
     {
-        printf("JIP startup failed\n");
+        eResponsePrintf(&sResponse, "JIP startup failed\n");
     }
 
-    if (eJIP_Connect(&sJIP_Context, pcConnect_address, JIP_DEFAULT_PORT) != E_JIP_OK)
+    /* Only connects to the border router if the network must be rediscovered,
+     * or JIPd is not running to make the requests through */
+    eBrokerLinkOpen(&sLink, &sJIP_Context, pcConnect_address);
+    
+    if (((pcUpdateAddress) && (pcUpdateMib) && (pcUpdateVar) && (pcUpdateValue)) && (!pcRefresh))
     {
-        printf("JIP connect failed\n");
+        /* Updates only need to find the variable - any snapshot will do */
+        eRefresh = E_NETWORK_CACHE_REFRESH_NEVER;
+    }
+    else
+    {
+        eRefresh = eNetworkCacheRefreshPolicy(pcRefresh);
     }
     
-    /* Load the cached device id's and any network contents if possible */
-    if (eJIPService_PersistXMLLoadDefinitions(&sJIP_Context, CACHE_DEFINITIONS_FILE_NAME) != E_JIP_OK)
+    if (eBrokerAcquireNetwork(&sLink, eRefresh, NULL) != E_JIP_OK)
     {
-        // Couldn't load the definitions file, fall back to discovery.
-        if (eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
-        {
-            printf("JIP discover network failed\n");
-        }
+        eResponsePrintf(&sResponse, "JIP discover network failed\n");
     }
     
     if ((pcUpdateAddress) && (pcUpdateMib) && (pcUpdateVar) && (pcUpdateValue))
     {
-        /* Load the cached network if possible */
-        if (eJIPService_PersistXMLLoadNetwork(&sJIP_Context, CACHE_NETWORK_FILE_NAME) != E_JIP_OK)
-        {
-            // Couldn't load the network file, fall back to discovery.
-            if (eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
-            {
-                printf("JIP discover network failed\n");
-            }
-        }
-        
-        printf("<div>Update address %s, mib %s, var %s to value %s\n", pcUpdateAddress, pcUpdateMib, pcUpdateVar, pcUpdateValue);
+        eResponsePrintf(&sResponse, "<div>Update address %s, mib %s, var %s to value %s\n", pcUpdateAddress, pcUpdateMib, pcUpdateVar, pcUpdateValue);
         
         int multicast = 0;
+        tsNodeWalk sWalk;
         tsNode *psNode;
         tsMib *psMib;
         tsVar *psVar;
@@ -839,10 +991,9 @@ int main(int argc, char *argv[])
             multicast = 1;
         }
         
-        eJIP_Lock(&sJIP_Context);
-
-        psNode = sJIP_Context.sNetwork.psNodes;
-        while (psNode)
+        /* Only the node being looked at is locked while the value is set */
+        (void)eNodeWalkStart(&sWalk, &sJIP_Context, JIP_DEVICEID_ALL);
+        for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
         {
             char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
             inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, buffer, INET6_ADDRSTRLEN);
@@ -858,80 +1009,17 @@ int main(int argc, char *argv[])
                     psVar = psJIP_LookupVar(psMib, NULL, pcUpdateVar);
                     if (psVar)
                     {
-                        char *buf = NULL;
-                        int supported = 1, freeable = 1;
+                        void *buf = NULL;
                         uint32_t u32Size = 0;
+                        const char *pcError;
                         
                         //printf("Found variable to update\n");
                         
-                        switch (psVar->eVarType)
+                        if (eCodecParseValue(&sCGI.sArena, psVar->eVarType, pcUpdateValue, &buf, &u32Size, &pcError) != E_CODEC_OK)
                         {
-                            case (E_JIP_VAR_TYPE_INT8):
-                            case (E_JIP_VAR_TYPE_UINT8):
-                                buf = malloc(sizeof(uint8_t));
-                                buf[0] = strtol(pcUpdateValue, NULL, 0);
-                                //printf("..%d..", buf[0] & 0xFF);
-                                break;
-                            
-                            case (E_JIP_VAR_TYPE_INT16):
-                            case (E_JIP_VAR_TYPE_UINT16):
-                            {
-                                uint16_t u16Var = strtol(pcUpdateValue, NULL, 0);
-                                buf = malloc(sizeof(uint16_t));
-                                memcpy(buf, &u16Var, sizeof(uint16_t));
-                                //printf("..%d..", *(uint16_t *)buf & 0xFFFF);
-                                break;
-                            }
-                                
-                            case (E_JIP_VAR_TYPE_INT32):
-                            case (E_JIP_VAR_TYPE_UINT32):
-                            {
-                                uint32_t u32Var = strtol(pcUpdateValue, NULL, 0);
-                                buf = malloc(sizeof(uint32_t));
-                                memcpy(buf, &u32Var, sizeof(uint32_t));
-                                //printf("..%d..", *(uint32_t *)buf);
-                                break;
-                            }
-                            
-                            case (E_JIP_VAR_TYPE_INT64):
-                            case (E_JIP_VAR_TYPE_UINT64):
-                            {
-                                uint64_t u64Var = strtoll(pcUpdateValue, NULL, 0);
-                                buf = malloc(sizeof(uint64_t));
-                                memcpy(buf, &u64Var, sizeof(uint64_t));
-                                break;
-                            }
-                            
-                            case (E_JIP_VAR_TYPE_FLT):
-                            {
-                                float f32Var = strtof(pcUpdateValue, NULL);
-                                buf = malloc(sizeof(uint32_t));
-                                memcpy(buf, &f32Var, sizeof(uint32_t));
-                                break;
-                            }
-                            
-                            case (E_JIP_VAR_TYPE_DBL):
-                            {
-                                double d64Var = strtod(pcUpdateValue, NULL);
-                                buf = malloc(sizeof(uint64_t));
-                                memcpy(buf, &d64Var, sizeof(uint64_t));
-                                break;
-                            }
-                                
-                            case(E_JIP_VAR_TYPE_STR):
-                            {
-                                buf = pcUpdateValue;
-                                //printf("Update to \"%s\"\n", buf);
-                                u32Size = strlen(pcUpdateValue);
-                                freeable = 0;
-                                break;
-                            }
-                            
-                            default:
-                                supported = 0;
+                            eResponsePrintf(&sResponse, "%s\n", pcError);
                         }
-                        
-                        if (supported)
+                        else
                         {
                             if (multicast)
                             {
@@ -947,235 +1035,118 @@ int main(int argc, char *argv[])
                                 {
                                     if (s == 0)
                                     {
-                                        printf("Unknown host: %s\n", pcUpdateAddress);
+                                        eResponsePrintf(&sResponse, "Unknown host: %s\n", pcUpdateAddress);
+                                        eResponseFinish(&sResponse);
                                         return 0;
                                     }
                                     else if (s < 0)
                                     {
-                                        printf("inet_pton failed (%s)", strerror(errno));
+                                        eResponsePrintf(&sResponse, "inet_pton failed (%s)", strerror(errno));
+                                        eResponseFinish(&sResponse);
                                         return 0;
                                     }
                                 }
                                 
-                                printf("...\n");
-                                if (eJIP_MulticastSetVar(&sJIP_Context, psVar, buf, u32Size, &MCastAddress, 2) != E_JIP_OK)
+                                eResponsePrintf(&sResponse, "...\n");
+                                if (eBrokerMulticastSetVar(&sLink, psVar, buf, u32Size, &MCastAddress, 2) != E_JIP_OK)
                                 {
-                                    printf("Error setting new value\n");
+                                    eResponsePrintf(&sResponse, "Error setting new value\n");
                                 }
                                 else
                                 {
-                                    printf("Success\n");
+                                    (void)eGroupModelSetVar(&MCastAddress.sin6_addr, pcUpdateMib, pcUpdateVar, psVar->eVarType, buf);
+                                    eResponsePrintf(&sResponse, "Success\n");
                                 }
                             }
                             else
                             {
-                                printf("...\n");
-                                if (eJIP_SetVar(&sJIP_Context, psVar, buf, u32Size) != E_JIP_OK)
+                                eResponsePrintf(&sResponse, "...\n");
+                                if (eBrokerSetVar(&sLink, psVar, buf, u32Size) != E_JIP_OK)
                                 {
-                                    printf("Error setting new value\n");
+                                    eResponsePrintf(&sResponse, "Error setting new value\n");
                                 }
                                 else
                                 {
-                                    printf("Success\n");
+                                    (void)eGroupModelSetVar(&psNode->sNode_Address.sin6_addr, pcUpdateMib, pcUpdateVar, psVar->eVarType, buf);
+                                    eResponsePrintf(&sResponse, "Success\n");
                                 }
                             }
                         }
-                        
-                        if (freeable)
-                        {
-                            free(buf);
-                        }
                         goto updated;
                     }
                 }
             }
-            psNode = psNode->psNext;
         }
-        eJIP_Unlock(&sJIP_Context);
 updated:
-        printf("</div>");
+        vNodeWalkEnd(&sWalk);
+        eResponsePrintf(&sResponse, "</div>");
     }
     else
     {
-        printf("<HTML><HEAD><TITLE>\n");
-        printf("NXP Smart Devices Demo\n");
-        printf("</TITLE>\n");
-        printf("<link rel=\"stylesheet\" href=\"/style.css\" type=\"text/css\" media=\"screen\" />\n");
-        printf("<script type=\"text/javascript\" src=\"/js/SimpleSlider.js\"></script>\n");
-
-        printf("<script type=\"text/javascript\"> \n\
-                function UpdateVariable(address, mib, variable, value) \n\
-                { \n\
-                    var xmlhttp; \n\
-                    if (window.XMLHttpRequest) \n\
-                    {// code for IE7+, Firefox, Chrome, Opera, Safari \n\
-                        xmlhttp=new XMLHttpRequest(); \n\
-                    } \n\
-                    else \n\
-                    {// code for IE6, IE5 \n\
-                        xmlhttp=new ActiveXObject(\"Microsoft.XMLHTTP\"); \n\
-                    } \n\
-                    var request; \n\
-                    var path = \"SmartDevices.cgi\"; \n\
-                    request = \"address=\" + address \n\
-                    request = request + \"&mib=\" + mib \n\
-                    request = request + \"&var=\" + variable \n\
-                    request = request + \"&value=\" + value \n\
-                    \n\
-                    xmlhttp.onreadystatechange=function() \n\
-                    { \n\
-                        if (xmlhttp.readyState==4 && xmlhttp.status==200) \n\
-                        { \n\
-                            document.getElementById(\"result\").innerHTML=xmlhttp.responseText; \n\
-                        } \n\
-                    } \n\
-                    xmlhttp.open(\"POST\",path,true); \n\
-                    xmlhttp.setRequestHeader(\"Content-type\",\"application/x-www-form-urlencoded\"); \n\
-                    xmlhttp.send(request); \n\
-                } \n\
-                </script>");
-        
-        printf("<script type=\"text/javascript\"> \n\
-                function getWindowHeight() { \n\
-                var windowHeight=0; \n\
-                if (typeof(window.innerHeight)=='number') { \n\
-                windowHeight=window.innerHeight; \n\
-                } \n\
-                else { \n\
-                if (document.documentElement&& \n\
-                document.documentElement.clientHeight) { \n\
-                windowHeight= \n\
-                document.documentElement.clientHeight; \n\
-                } \n\
-                else { \n\
-                if (document.body&&document.body.clientHeight) { \n\
-                windowHeight=document.body.clientHeight; \n\
-                } \n\
-                } \n\
-                } \n\
-                return windowHeight; \n\
-                } \n\n\
-                function setFooter() { \n\
-                if (document.getElementById) { \n\
-                var windowHeight=getWindowHeight(); \n\
-                if (windowHeight>0) { \n\
-                var contentHeight= \n\
-                document.getElementById('content').offsetHeight + \n\
-                document.getElementById('header').offsetHeight + \n\
-                document.getElementById('navigation').offsetHeight; \n\
-                var footerElement= \n\
-                document.getElementById('footer'); \n\
-                var footerHeight=footerElement.offsetHeight; \n\
-                if (windowHeight-(contentHeight+footerHeight)>=0) { \n\
-                footerElement.style.position='relative'; \n\
-                footerElement.style.top=(windowHeight- \n\
-                (contentHeight+footerHeight))+'px'; \n\
-                } \n\
-                else { \n\
-                footerElement.style.position='static'; \n\
-                } \n\
-                } \n\
-                } \n\
-                } \n\
-                window.onload = function() { \n\
-                setFooter(); \n\
-                JIP_MonitorsRun(); \n\
-                } \n\
-                window.onresize = function() { \n\
-                setFooter(); \n\
-                } \n\
-                </script>\n");
-
-        printf("</HEAD><body><div id=\"container\" >\n");
-        
-        printf("<div id=\"header\"><div style=\"float: left;\"><H1>NXP Smart Devices Demo</H1></div>");
-        printf("<div style=\"float: right;\"><img src=\"/img/NXP_logo.gif\"></div>"); 
-        printf("</div>\n"); 
-
-        printf("<div id=\"navigation\"><ul>");
+        eTemplateOutputInit(&sOutput);
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesHead);
     
-        if (psGlobalGroup)
+        if (sConfig.psHeader->sGlobalGroup.u32Name)
         {
-            printf("<li %s><a href=\"/cgi-bin/SmartDevices.cgi?Mode=Global\">Global Control</a></li>\n", strcmp(pcMode, "Global") ? "": "class=\"selected\"");
+            eTemplateRender(&sOutput, &sTemplateSmartDevicesNavItem, 
+                            strcmp(pcMode, "Global") ? "": "class=\"selected\"", "Global", "Global Control");
         }
         
-        if (u32NumGroups > 0)
+        if (sConfig.psHeader->u32NumGroups > 0)
         {
-            printf("<li %s><a href=\"/cgi-bin/SmartDevices.cgi?Mode=Group\">Group Control</a></li>\n", strcmp(pcMode, "Group") ? "": "class=\"selected\"");
+            eTemplateRender(&sOutput, &sTemplateSmartDevicesNavItem, 
+                            strcmp(pcMode, "Group") ? "": "class=\"selected\"", "Group", "Group Control");
         }
         
-        printf("<li %s><a href=\"/cgi-bin/SmartDevices.cgi?Mode=Individual\">Individual Control</a></li>\n", strcmp(pcMode, "Individual") ? "": "class=\"selected\"");
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesNavItem, 
+                        strcmp(pcMode, "Individual") ? "": "class=\"selected\"", "Individual", "Individual Control");
 
-        if (u32NumScenes > 0)
+        if (sConfig.psHeader->u32NumScenes > 0)
         {
-            printf("<li %s><a href=\"/cgi-bin/SmartDevices.cgi?Mode=Scene\">Scene Control</a></li>\n", strcmp(pcMode, "Scene") ? "": "class=\"selected\"");
+            eTemplateRender(&sOutput, &sTemplateSmartDevicesNavItem, 
+                            strcmp(pcMode, "Scene") ? "": "class=\"selected\"", "Scene", "Scene Control");
         }
         
-        printf("</ul></div>");
-        
-        printf("<div id=\"content\">\n\n");
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesNavEnd);
         
-        if (eJIPService_DiscoverNetwork(&sJIP_Context) != E_JIP_OK)
+        if ((strcmp("Global", pcMode) == 0) && sConfig.psHeader->sGlobalGroup.u32Name)
         {
-            printf("JIP discover network failed\n");
-        }
-        
-        if ((strcmp("Global", pcMode) == 0) && psGlobalGroup)
-        {
-            GroupMenu(psGlobalGroup);
+            (void)eGroupModelRead(&sGroupView);
+            GroupMenu(&sConfig.psHeader->sGlobalGroup);
+            vGroupModelViewFree(&sGroupView);
         }
         else if (strcmp("Group", pcMode) == 0)
         {
             int i;
             
-            for (i = 0; i < u32NumGroups; i++)
+            /* Group state comes from the model JIPd maintains, not from the members */
+            (void)eGroupModelRead(&sGroupView);
+            for (i = 0; i < sConfig.psHeader->u32NumGroups; i++)
             {
-                GroupMenu(&psGroups[i]);
+                GroupMenu(&sConfig.psGroups[i]);
             }
+            vGroupModelViewFree(&sGroupView);
         }
         else if (strcmp("Individual", pcMode) == 0)
         {
+            tsNodeWalk sWalk;
             tsNode *psNode;
             tsMib *psMib;
             tsVar *psVar;
             
-            eJIP_Lock(&sJIP_Context);
-
-            psNode = sJIP_Context.sNetwork.psNodes;
-            while (psNode)
+            /* Each name is read over the network with only its node locked */
+            (void)eNodeWalkStart(&sWalk, &sJIP_Context, JIP_DEVICEID_ALL);
+            for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
             {
                 char buffer[INET6_ADDRSTRLEN] = "Could not determine address\n";
                 inet_ntop(AF_INET6, &psNode->sNode_Address.sin6_addr, buffer, INET6_ADDRSTRLEN);
-                int i;
-                tsDevice *psDevice = NULL;
+                const tsConfigDevice *psDevice;
                 
-                for (i = 0; i < u32NumDevices; i++)
-                {
-                    switch (psDevices[i].eDeviceLookup)
-                    {
-                        case(E_LOOKUP_DEVICEID):
-                            if (psDevices[i].u32DeviceId == psNode->u32DeviceId)
-                            {
-                                psDevice = &psDevices[i];
-                                break;
-                            }
-                            break;
-                        case (E_LOOKUP_BASETYPE):
-                            if (psDevices[i].u8BaseType == (uint8_t)(psNode->u32DeviceId & 0x000000FF))
-                            {
-                                psDevice = &psDevices[i];
-                                break;
-                            }
-                            break;
-                        default:
-                            break;
-                    }
-                }
+                psDevice = psConfigLookupDevice(&sConfig, psNode->u32DeviceId);
                 
                 if (!psDevice)
                 {
                     /* Not handling this device ID */
-                    psNode = psNode->psNext;
                     continue;
                 }
                 
@@ -1187,7 +1158,7 @@ updated:
                     {
                         char acCurrentValue[255];
                         
-                        (void)eJIP_GetVar(&sJIP_Context, psVar);
+                        (void)eBrokerGetVar(&sLink, psVar);
 
                         if (psVar->pvData)
                         {
@@ -1207,34 +1178,32 @@ updated:
                         DeviceMenu(psDevice, acCurrentValue, buffer);
                     }
                 }
-                psNode = psNode->psNext;
             }
-            eJIP_Unlock(&sJIP_Context);
+            vNodeWalkEnd(&sWalk);
         }
         else if (strcmp("Scene", pcMode) == 0)
         {
             int i;
             
-            printf("<div id=\"Scenes\">");
-            for (i = 0; i < u32NumScenes; i++)
+            eTemplateRender(&sOutput, &sTemplateSmartDevicesScenesBegin);
+            for (i = 0; i < sConfig.psHeader->u32NumScenes; i++)
             {
-                SceneMenu(&psScenes[i]);
+                SceneMenu(i);
             }
-            printf("</div>\n");
+            eTemplateRender(&sOutput, &sTemplateSmartDevicesScenesEnd);
         }
         
-        printf("<div id=\"result\"></div>\n");
-        printf("</div>"); //content
-        printf("<div id=\"footer\">Smart Devices cgi version %s using libJIP version %s</div>\n", Version, JIP_Version);
-        printf("</div>"); //Container
-        printf("</body></HTML>\n");
+        eTemplateRender(&sOutput, &sTemplateSmartDevicesFooter, Version, JIP_Version);
+        
+        /* Send the whole page in one go */
+        eTemplateFlush(&sOutput, &sResponse);
     }
  
-    /* Save the device id's and network contents */
-    (void)eJIPService_PersistXMLSaveDefinitions(&sJIP_Context, CACHE_DEFINITIONS_FILE_NAME);
-    (void)eJIPService_PersistXMLSaveNetwork(&sJIP_Context, CACHE_NETWORK_FILE_NAME);
-    
+    vConfigUnload(&sConfig);
+    vBrokerLinkClose(&sLink);
     eJIP_Destroy(&sJIP_Context);
+    eResponseFinish(&sResponse);
+    vCGIFree(&sCGI);
     return 0;
 }
 
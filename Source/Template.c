@@ -0,0 +1,303 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTML template engine
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+
+#include "Template.h"
+
+//#define DEBUG_TEMPLATE
+
+#ifdef DEBUG_TEMPLATE
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_TEMPLATE */
+
+/** Number of io vectors the output array grows by */
+#define TEMPLATE_IOV_INCREMENT      128
+
+/** Minimum size of a dynamic text block */
+#define TEMPLATE_BLOCK_SIZE         4096
+
+
+/** Append an io vector to the output */
+static teTemplateStatus eAppendIov(tsTemplateOutput *psOutput, const char *pcData, size_t szLength)
+{
+    if (szLength == 0)
+    {
+        return E_TEMPLATE_OK;
+    }
+    
+    if (psOutput->u32NumIov > 0)
+    {
+        struct iovec *psLast = &psOutput->psIov[psOutput->u32NumIov - 1];
+        if ((const char *)psLast->iov_base + psLast->iov_len == pcData)
+        {
+            /* Contiguous with the previous vector - just extend it */
+            psLast->iov_len += szLength;
+            return E_TEMPLATE_OK;
+        }
+    }
+    
+    if (psOutput->u32NumIov == psOutput->u32IovSize)
+    {
+        struct iovec *psNewIov = realloc(psOutput->psIov, 
+                                         (psOutput->u32IovSize + TEMPLATE_IOV_INCREMENT) * sizeof(struct iovec));
+        if (!psNewIov)
+        {
+            psOutput->eStatus = E_TEMPLATE_NO_MEMORY;
+            return E_TEMPLATE_NO_MEMORY;
+        }
+        psOutput->psIov = psNewIov;
+        psOutput->u32IovSize += TEMPLATE_IOV_INCREMENT;
+    }
+    
+    psOutput->psIov[psOutput->u32NumIov].iov_base = (void *)pcData;
+    psOutput->psIov[psOutput->u32NumIov].iov_len  = szLength;
+    psOutput->u32NumIov++;
+    return E_TEMPLATE_OK;
+}
+
+
+/** Reserve space for dynamic text in the current block, starting a new one if required.
+ *  \return Pointer to the reserved space, or NULL on failure */
+static char *pcReserve(tsTemplateOutput *psOutput, size_t szLength)
+{
+    tsTemplateBlock *psBlock = psOutput->psBlocks;
+    
+    if ((!psBlock) || (psBlock->u32Size - psBlock->u32Used < szLength))
+    {
+        size_t szSize = szLength > TEMPLATE_BLOCK_SIZE ? szLength : TEMPLATE_BLOCK_SIZE;
+        
+        psBlock = malloc(sizeof(tsTemplateBlock) + szSize);
+        if (!psBlock)
+        {
+            psOutput->eStatus = E_TEMPLATE_NO_MEMORY;
+            return NULL;
+        }
+        psBlock->psNext   = psOutput->psBlocks;
+        psBlock->u32Size  = szSize;
+        psBlock->u32Used  = 0;
+        psOutput->psBlocks = psBlock;
+    }
+    return &psBlock->acData[psBlock->u32Used];
+}
+
+
+/** Copy dynamic text into the output */
+static teTemplateStatus eWriteDynamic(tsTemplateOutput *psOutput, const char *pcText, size_t szLength)
+{
+    char *pcSpace;
+    
+    if (szLength == 0)
+    {
+        return E_TEMPLATE_OK;
+    }
+    
+    pcSpace = pcReserve(psOutput, szLength);
+    if (!pcSpace)
+    {
+        return E_TEMPLATE_NO_MEMORY;
+    }
+    memcpy(pcSpace, pcText, szLength);
+    psOutput->psBlocks->u32Used += szLength;
+    return eAppendIov(psOutput, pcSpace, szLength);
+}
+
+
+/** Format text into the current block.
+ *  \return Pointer to the nul terminated text, or NULL on failure */
+static char *pcFormatDynamic(tsTemplateOutput *psOutput, size_t *pszLength, const char *pcFormatString, va_list ap)
+{
+    va_list ap2;
+    char *pcSpace;
+    int iLength;
+    
+    va_copy(ap2, ap);
+    iLength = vsnprintf(NULL, 0, pcFormatString, ap2);
+    va_end(ap2);
+    
+    if (iLength < 0)
+    {
+        psOutput->eStatus = E_TEMPLATE_ERROR;
+        return NULL;
+    }
+    
+    pcSpace = pcReserve(psOutput, iLength + 1);
+    if (!pcSpace)
+    {
+        return NULL;
+    }
+    vsnprintf(pcSpace, iLength + 1, pcFormatString, ap);
+    psOutput->psBlocks->u32Used += iLength + 1;
+    *pszLength = iLength;
+    return pcSpace;
+}
+
+
+teTemplateStatus eTemplateOutputInit(tsTemplateOutput *psOutput)
+{
+    memset(psOutput, 0, sizeof(tsTemplateOutput));
+    psOutput->eStatus = E_TEMPLATE_OK;
+    return E_TEMPLATE_OK;
+}
+
+
+teTemplateStatus eTemplateRender(tsTemplateOutput *psOutput, const tsTemplate *psTemplate, ...)
+{
+    const char *apcSlots[psTemplate->u32NumSlots + 1];
+    size_t aszSlots[psTemplate->u32NumSlots + 1];
+    const char *apcCopies[psTemplate->u32NumSlots + 1];
+    va_list ap;
+    uint32_t i;
+    
+    va_start(ap, psTemplate);
+    for (i = 0; i < psTemplate->u32NumSlots; i++)
+    {
+        apcSlots[i] = va_arg(ap, const char *);
+        aszSlots[i] = apcSlots[i] ? strlen(apcSlots[i]) : 0;
+        apcCopies[i] = NULL;
+    }
+    va_end(ap);
+    
+    for (i = 0; i < psTemplate->u32NumChunks; i++)
+    {
+        const tsTemplateChunk *psChunk = &psTemplate->psChunks[i];
+        uint32_t u32Slot = psChunk->u32Slot;
+        
+        if (eAppendIov(psOutput, psChunk->pcData, psChunk->u32Length) != E_TEMPLATE_OK)
+        {
+            return psOutput->eStatus;
+        }
+        
+        if ((u32Slot == TEMPLATE_NO_SLOT) || (u32Slot >= psTemplate->u32NumSlots))
+        {
+            continue;
+        }
+        
+        if (apcCopies[u32Slot])
+        {
+            /* Slot used more than once - reference the first copy */
+            if (eAppendIov(psOutput, apcCopies[u32Slot], aszSlots[u32Slot]) != E_TEMPLATE_OK)
+            {
+                return psOutput->eStatus;
+            }
+        }
+        else if (aszSlots[u32Slot])
+        {
+            if (eWriteDynamic(psOutput, apcSlots[u32Slot], aszSlots[u32Slot]) != E_TEMPLATE_OK)
+            {
+                return psOutput->eStatus;
+            }
+            apcCopies[u32Slot] = &psOutput->psBlocks->acData[psOutput->psBlocks->u32Used - aszSlots[u32Slot]];
+        }
+    }
+    return E_TEMPLATE_OK;
+}
+
+
+teTemplateStatus eTemplateWriteStatic(tsTemplateOutput *psOutput, const char *pcText)
+{
+    return eAppendIov(psOutput, pcText, strlen(pcText));
+}
+
+
+teTemplateStatus eTemplatePrintf(tsTemplateOutput *psOutput, const char *pcFormatString, ...)
+{
+    va_list ap;
+    char *pcText;
+    size_t szLength = 0;
+    
+    va_start(ap, pcFormatString);
+    pcText = pcFormatDynamic(psOutput, &szLength, pcFormatString, ap);
+    va_end(ap);
+    
+    if (!pcText)
+    {
+        return psOutput->eStatus;
+    }
+    return eAppendIov(psOutput, pcText, szLength);
+}
+
+
+const char *pcTemplateFormat(tsTemplateOutput *psOutput, const char *pcFormatString, ...)
+{
+    va_list ap;
+    char *pcText;
+    size_t szLength = 0;
+    
+    va_start(ap, pcFormatString);
+    pcText = pcFormatDynamic(psOutput, &szLength, pcFormatString, ap);
+    va_end(ap);
+    
+    return pcText ? pcText : "";
+}
+
+
+teTemplateStatus eTemplateFlush(tsTemplateOutput *psOutput, tsResponse *psResponse)
+{
+    teTemplateStatus eStatus = psOutput->eStatus;
+    
+    if (eResponseWritev(psResponse, psOutput->psIov, psOutput->u32NumIov) != E_RESPONSE_OK)
+    {
+        eStatus = E_TEMPLATE_ERROR;
+    }
+    
+    vTemplateOutputFree(psOutput);
+    return eStatus;
+}
+
+
+void vTemplateOutputFree(tsTemplateOutput *psOutput)
+{
+    tsTemplateBlock *psBlock = psOutput->psBlocks;
+    
+    while (psBlock)
+    {
+        tsTemplateBlock *psNext = psBlock->psNext;
+        free(psBlock);
+        psBlock = psNext;
+    }
+    free(psOutput->psIov);
+    eTemplateOutputInit(psOutput);
+}
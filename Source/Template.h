@@ -0,0 +1,162 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          HTML template engine
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __TEMPLATE_H_
+#define __TEMPLATE_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "Response.h"
+
+
+/** Chunk index value marking the last chunk of a template, which has no slot after it */
+#define TEMPLATE_NO_SLOT        0xFFFFFFFF
+
+
+/** Enumerated type of status codes from the template engine */
+typedef enum
+{
+    E_TEMPLATE_OK,              /**< All ok */
+    E_TEMPLATE_ERROR,           /**< Generic error */
+    E_TEMPLATE_NO_MEMORY,       /**< Memory allocation failed */
+} teTemplateStatus;
+
+
+/** One static run of template text, followed by a dynamic slot.
+ *  These are generated at build time by template-compile.py from Templates/ *.tmpl */
+typedef struct
+{
+    const char     *pcData;             /**< Static text */
+    uint32_t        u32Length;          /**< Length of static text */
+    uint32_t        u32Slot;            /**< Index of slot that follows, or \ref TEMPLATE_NO_SLOT */
+} tsTemplateChunk;
+
+
+/** A compiled template fragment */
+typedef struct
+{
+    const char             *pcName;         /**< Fragment name, for debugging */
+    uint32_t                u32NumSlots;    /**< Number of distinct slots the fragment takes */
+    uint32_t                u32NumChunks;   /**< Number of chunks */
+    const tsTemplateChunk  *psChunks;       /**< Array of chunks */
+} tsTemplate;
+
+
+/** Block of memory holding dynamic text until the output is flushed */
+typedef struct _tsTemplateBlock
+{
+    struct _tsTemplateBlock *psNext;    /**< Next block in list */
+    uint32_t        u32Size;            /**< Size of data area */
+    uint32_t        u32Used;            /**< Bytes of data area used */
+    char            acData[];           /**< Data area */
+} tsTemplateBlock;
+
+
+/** Pending response body. Static chunks are referenced in place, 
+ *  dynamic text is copied into blocks owned by the output. */
+typedef struct
+{
+    struct iovec   *psIov;              /**< Array of pending io vectors */
+    uint32_t        u32NumIov;          /**< Number of used io vectors */
+    uint32_t        u32IovSize;         /**< Allocated size of io vector array */
+    tsTemplateBlock *psBlocks;          /**< List of dynamic text blocks, most recent first */
+    teTemplateStatus eStatus;           /**< First error seen while building the output */
+} tsTemplateOutput;
+
+
+/** Initialise an output structure
+ *  \param psOutput     Pointer to output to initialise
+ *  \return E_TEMPLATE_OK
+ */
+teTemplateStatus eTemplateOutputInit(tsTemplateOutput *psOutput);
+
+
+/** Render a template fragment into an output.
+ *  The variable arguments are the fragment's slot values as const char *, 
+ *  in the order listed in the generated header. NULL is rendered as an empty string.
+ *  \param psOutput     Pointer to output
+ *  \param psTemplate   Pointer to the compiled fragment
+ *  \return E_TEMPLATE_OK on success
+ */
+teTemplateStatus eTemplateRender(tsTemplateOutput *psOutput, const tsTemplate *psTemplate, ...);
+
+
+/** Append static text to an output. The text must remain valid until the output is flushed.
+ *  \param psOutput     Pointer to output
+ *  \param pcText       String to append
+ *  \return E_TEMPLATE_OK on success
+ */
+teTemplateStatus eTemplateWriteStatic(tsTemplateOutput *psOutput, const char *pcText);
+
+
+/** Append formatted dynamic text to an output.
+ *  \param psOutput     Pointer to output
+ *  \param pcFormat     printf style format string
+ *  \return E_TEMPLATE_OK on success
+ */
+teTemplateStatus eTemplatePrintf(tsTemplateOutput *psOutput, const char *pcFormat, ...) 
+    __attribute__ ((format (printf, 2, 3)));
+
+
+/** Format a string into storage owned by the output, for use as a slot value.
+ *  The string is valid until the output is flushed.
+ *  \param psOutput     Pointer to output
+ *  \param pcFormat     printf style format string
+ *  \return Pointer to formatted string, or "" on failure.
+ */
+const char *pcTemplateFormat(tsTemplateOutput *psOutput, const char *pcFormat, ...) 
+    __attribute__ ((format (printf, 2, 3)));
+
+
+/** Write all pending output to a response as one set of io vectors, and free it.
+ *  \param psOutput     Pointer to output
+ *  \param psResponse   Response to write to
+ *  \return E_TEMPLATE_OK on success
+ */
+teTemplateStatus eTemplateFlush(tsTemplateOutput *psOutput, tsResponse *psResponse);
+
+
+/** Free all resources used by an output without writing it.
+ *  \param psOutput     Pointer to output
+ */
+void vTemplateOutputFree(tsTemplateOutput *psOutput);
+
+
+#endif /* __TEMPLATE_H_ */
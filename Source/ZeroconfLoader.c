@@ -0,0 +1,112 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Zeroconf loader
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+/* Stands in for Zeroconf.c in the multi-call binary. Zeroconf.c is built
+ * into a plugin linked against avahi and dbus, which is only loaded the
+ * first time a program looks for border routers. Requests that are given
+ * the border router's address never map those libraries. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <netinet/in.h>
+
+#include "Zeroconf.h"
+
+/** Plugin holding Zeroconf.c, found on the library search path */
+#ifndef ZEROCONF_PLUGIN
+#define ZEROCONF_PLUGIN     "libJIPZeroconf.so"
+#endif /* ZEROCONF_PLUGIN */
+
+//#define DEBUG_ZEROCONF_LOADER
+
+#ifdef DEBUG_ZEROCONF_LOADER
+#define PRINTF(...) fprintf(stderr, "DBG:" __VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif /* DEBUG_ZEROCONF_LOADER */
+
+
+static pthread_once_t sLoadOnce = PTHREAD_ONCE_INIT;
+
+static int (*prRegisterServices)(const char *pcServiceName) = NULL;
+
+static int (*prGetModuleAddresses)(struct in6_addr **pasAddress, int *piNumAddresses) = NULL;
+
+
+static void vLoadPlugin(void)
+{
+    void *pvPlugin;
+    
+    PRINTF("Loading %s\n", ZEROCONF_PLUGIN);
+    
+    /* Symbols are looked up in the plugin's own scope, so these find
+     * its functions rather than the ones below */
+    pvPlugin = dlopen(ZEROCONF_PLUGIN, RTLD_NOW | RTLD_LOCAL);
+    if (!pvPlugin)
+    {
+        fprintf(stderr, "Could not load Zeroconf support (%s)\n", dlerror());
+        return;
+    }
+    prRegisterServices   = (int (*)(const char *))dlsym(pvPlugin, "ZC_RegisterServices");
+    prGetModuleAddresses = (int (*)(struct in6_addr **, int *))dlsym(pvPlugin, "ZC_Get_Module_Addresses");
+}
+
+
+int ZC_RegisterServices(const char *pcServiceName)
+{
+    pthread_once(&sLoadOnce, vLoadPlugin);
+    if (!prRegisterServices)
+    {
+        return 1;
+    }
+    return prRegisterServices(pcServiceName);
+}
+
+
+int ZC_Get_Module_Addresses(struct in6_addr **pasAddress, int *piNumAddresses)
+{
+    pthread_once(&sLoadOnce, vLoadPlugin);
+    if (!prGetModuleAddresses)
+    {
+        return -1;
+    }
+    return prGetModuleAddresses(pasAddress, piNumAddresses);
+}
@@ -0,0 +1,163 @@
+#!/usr/bin/env python
+#
+# Build the static files of the web pages into one asset pack for JIPHttpd,
+# which maps it and serves each file from it without touching the file
+# system. See AssetPack.h for the runtime side.
+#
+# Each file is stored as it is and, if that makes it usefully smaller, also
+# compressed with gzip, so that neither is done per request. Each has a
+# strong ETag, the hash of its content. The pages' references to the other
+# files are given that hash as "?v=<hash>", so that a response to such a URL
+# can be cached for good: a changed file gets a new URL.
+#
+# Pack layout, every number a big endian uint32:
+#   Header:    "JIPA", version, number of files, offset of index
+#   Index:     for each file, sorted by path: offsets of its path, content
+#              type and hash (nul terminated), offset and length of its
+#              content, and offset and length of its gzip content (0 if none)
+#   Data:      strings and content
+#
+# Usage: asset-pack.py <www directory> <output pack>
+#
+
+import hashlib
+import os
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = b'JIPA'
+VERSION = 1
+
+CONTENT_TYPES = {
+    'html': 'text/html',
+    'htm':  'text/html',
+    'css':  'text/css',
+    'js':   'application/javascript',
+    'json': 'application/json',
+    'txt':  'text/plain',
+    'xml':  'text/xml',
+    'png':  'image/png',
+    'gif':  'image/gif',
+    'jpg':  'image/jpeg',
+    'jpeg': 'image/jpeg',
+    'ico':  'image/x-icon',
+    'svg':  'image/svg+xml',
+}
+
+# Images are compressed already
+COMPRESSIBLE = ('text/', 'application/javascript', 'application/json', 'image/svg+xml')
+
+# A compressed variant is only kept if it saves at least this fraction
+MIN_SAVING = 0.1
+
+# References to other files of the pack in the pages
+REFERENCE_RE = re.compile(r'''((?:src|href)=(["']))(/[^"'?#]*)(\2)''')
+
+
+def content_type(path):
+    extension = os.path.splitext(path)[1][1:].lower()
+    return CONTENT_TYPES.get(extension, 'application/octet-stream')
+
+
+def content_hash(data):
+    return hashlib.sha1(data).hexdigest()[:16]
+
+
+def gzip_compress(data):
+    # wbits 31 gives the gzip format, with no file name or time in its header
+    compressor = zlib.compressobj(9, zlib.DEFLATED, 31)
+    return compressor.compress(data) + compressor.flush()
+
+
+def read_files(root):
+    files = {}
+    for directory, _, names in os.walk(root):
+        for name in names:
+            filename = os.path.join(directory, name)
+            path = '/' + os.path.relpath(filename, root).replace(os.sep, '/')
+            with open(filename, 'rb') as f:
+                files[path] = f.read()
+    return files
+
+
+def version_references(files):
+    """Add the hash of each file a page refers to, to the reference"""
+    hashes = dict((path, content_hash(data)) for path, data in files.items()
+                  if content_type(path) != 'text/html')
+
+    def versioned(match):
+        path = match.group(3)
+        if path not in hashes:
+            return match.group(0)
+        return '%s%s?v=%s%s' % (match.group(1), path, hashes[path], match.group(4))
+
+    for path, data in files.items():
+        if content_type(path) == 'text/html':
+            files[path] = REFERENCE_RE.sub(versioned, data.decode('utf-8')).encode('utf-8')
+
+
+class Pack(object):
+    def __init__(self):
+        self.data = bytearray()
+
+    def add(self, data, align=1):
+        while len(self.data) % align:
+            self.data.append(0)
+        offset = len(self.data)
+        self.data.extend(data)
+        return offset
+
+    def add_string(self, text):
+        return self.add(text.encode('utf-8') + b'\0')
+
+
+def build(files):
+    paths = sorted(files, key=lambda p: p.encode('utf-8'))
+    header_size = 16
+    entry_size = 7 * 4
+    pack = Pack()
+    pack.add(b'\0' * (header_size + entry_size * len(paths)))
+
+    entries = []
+    stored = compressed = 0
+    for path in paths:
+        data = files[path]
+        ctype = content_type(path)
+        gzip_data = b''
+        if ctype.startswith(COMPRESSIBLE):
+            gzip_data = gzip_compress(data)
+            if len(gzip_data) > len(data) * (1.0 - MIN_SAVING):
+                gzip_data = b''
+        entries.append((pack.add_string(path), pack.add_string(ctype), pack.add_string(content_hash(data)),
+                        pack.add(data, 8), len(data),
+                        pack.add(gzip_data, 8) if gzip_data else 0, len(gzip_data)))
+        stored += len(data)
+        compressed += len(gzip_data) if gzip_data else len(data)
+
+    pack.data[0:header_size] = MAGIC + struct.pack('>III', VERSION, len(paths), header_size)
+    for index, entry in enumerate(entries):
+        offset = header_size + index * entry_size
+        pack.data[offset:offset + entry_size] = struct.pack('>7I', *entry)
+    return bytes(pack.data), stored, compressed
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write('Usage: %s <www directory> <output pack>\n' % sys.argv[0])
+        return 1
+
+    files = read_files(sys.argv[1])
+    version_references(files)
+    data, stored, compressed = build(files)
+
+    with open(sys.argv[2] + '.tmp', 'wb') as f:
+        f.write(data)
+    os.rename(sys.argv[2] + '.tmp', sys.argv[2])
+    print('%s: %d files, %d bytes, %d bytes sent compressed' % (sys.argv[2], len(files), stored, compressed))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+#
+# Compile an HTML template file into C source, so that the static text of each
+# page fragment is embedded in the cgi program and only the dynamic slots are
+# filled in per request. See Template.h for the runtime side.
+#
+# Template file format:
+#   Lines before the first fragment are comments.
+#   "@@ name" starts a new fragment called name.
+#   "{{slot}}" within a fragment marks a dynamic slot. A slot used more than
+#   once in a fragment takes a single value.
+#   Trailing blank lines of a fragment are dropped.
+#
+# Usage: template-compile.py <file.tmpl> <output basename>
+#
+
+import os
+import re
+import sys
+
+SLOT_RE = re.compile(r'\{\{([A-Za-z_][A-Za-z0-9_]*)\}\}')
+
+
+def camel(name):
+    return ''.join(part[:1].upper() + part[1:] for part in re.split(r'[_\-]', name) if part)
+
+
+def c_string(text):
+    out = []
+    for o in bytearray(text.encode('utf-8')):
+        ch = chr(o)
+        if ch == '\\':
+            out.append('\\\\')
+        elif ch == '"':
+            out.append('\\"')
+        elif ch == '\n':
+            out.append('\\n"\n    "')
+        elif ch == '\t':
+            out.append('\\t')
+        elif o < 0x20 or o > 0x7e:
+            out.append('\\%03o' % o)
+        elif ch == '?':
+            # Avoid trigraphs
+            out.append('\\?')
+        else:
+            out.append(ch)
+    return '"' + ''.join(out) + '"'
+
+
+def parse(filename):
+    fragments = []
+    current = None
+    with open(filename, 'rb') as f:
+        data = f.read().decode('utf-8')
+    for line in data.splitlines(True):
+        if line.startswith('@@'):
+            name = line[2:].strip()
+            if not re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', name):
+                sys.stderr.write('%s: bad fragment name "%s"\n' % (filename, name))
+                sys.exit(1)
+            current = [name, []]
+            fragments.append(current)
+        elif current is not None:
+            current[1].append(line)
+    result = []
+    for name, lines in fragments:
+        while lines and lines[-1].strip() == '':
+            lines.pop()
+        result.append((name, ''.join(lines)))
+    return result
+
+
+def compile_fragment(text):
+    slots = []
+    chunks = []
+    pos = 0
+    for m in SLOT_RE.finditer(text):
+        slot = m.group(1)
+        if slot not in slots:
+            slots.append(slot)
+        chunks.append((text[pos:m.start()], slots.index(slot)))
+        pos = m.end()
+    chunks.append((text[pos:], None))
+    return slots, chunks
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write('Usage: %s <file.tmpl> <output basename>\n' % sys.argv[0])
+        sys.exit(1)
+
+    source = sys.argv[1]
+    output = sys.argv[2]
+    prefix = camel(os.path.splitext(os.path.basename(source))[0])
+    base = os.path.basename(output)
+    guard = '__%s_H_' % re.sub(r'[^A-Za-z0-9]', '_', base).upper()
+
+    header = []
+    body = []
+
+    header.append('/* Generated by template-compile.py from %s - do not edit */\n' % os.path.basename(source))
+    header.append('#ifndef %s\n#define %s\n\n#include "Template.h"\n\n' % (guard, guard))
+    body.append('/* Generated by template-compile.py from %s - do not edit */\n' % os.path.basename(source))
+    body.append('#include "%s.h"\n\n' % base)
+
+    for name, text in parse(source):
+        symbol = 'sTemplate%s%s' % (prefix, camel(name))
+        slots, chunks = compile_fragment(text)
+
+        header.append('/** Fragment "%s"' % name)
+        if slots:
+            header.append(', slots: %s' % ', '.join(slots))
+        header.append(' */\nextern const tsTemplate %s;\n\n' % symbol)
+
+        body.append('static const tsTemplateChunk as%sChunks[] =\n{\n' % symbol[1:])
+        for chunk, slot in chunks:
+            body.append('    { %s,\n      %d, %s },\n' % (c_string(chunk), len(chunk.encode('utf-8')),
+                                                    'TEMPLATE_NO_SLOT' if slot is None else str(slot)))
+        body.append('};\n\n')
+        body.append('const tsTemplate %s =\n{\n    "%s", %d, %d, as%sChunks\n};\n\n' %
+                    (symbol, name, len(slots), len(chunks), symbol[1:]))
+
+    header.append('#endif /* %s */\n' % guard)
+
+    with open(output + '.h', 'w') as f:
+        f.write(''.join(header))
+    with open(output + '.c', 'w') as f:
+        f.write(''.join(body))
+
+
+if __name__ == '__main__':
+    main()
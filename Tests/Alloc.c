@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Allocation counter
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Alloc.h"
+
+void *__real_malloc(size_t szSize);
+void *__real_calloc(size_t szNum, size_t szSize);
+void *__real_realloc(void *pvOld, size_t szSize);
+char *__real_strdup(const char *pcString);
+void __real_free(void *pvData);
+
+/* Benchmarks of threaded modules count from several threads */
+static volatile uint64_t u64Allocs = 0;
+static volatile uint64_t u64Frees = 0;
+
+
+void *__wrap_malloc(size_t szSize)
+{
+    __sync_fetch_and_add(&u64Allocs, 1);
+    return __real_malloc(szSize);
+}
+
+
+void *__wrap_calloc(size_t szNum, size_t szSize)
+{
+    __sync_fetch_and_add(&u64Allocs, 1);
+    return __real_calloc(szNum, szSize);
+}
+
+
+void *__wrap_realloc(void *pvOld, size_t szSize)
+{
+    __sync_fetch_and_add(&u64Allocs, 1);
+    return __real_realloc(pvOld, szSize);
+}
+
+
+char *__wrap_strdup(const char *pcString)
+{
+    __sync_fetch_and_add(&u64Allocs, 1);
+    return __real_strdup(pcString);
+}
+
+
+void __wrap_free(void *pvData)
+{
+    if (pvData)
+    {
+        __sync_fetch_and_add(&u64Frees, 1);
+    }
+    __real_free(pvData);
+}
+
+
+uint64_t u64AllocCount(void)
+{
+    return u64Allocs;
+}
+
+
+uint64_t u64AllocFreeCount(void)
+{
+    return u64Frees;
+}
@@ -0,0 +1,182 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Microbenchmark runner
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Alloc.h"
+#include "Bench.h"
+
+/** Modules in the order they are benchmarked */
+static const struct
+{
+    const char     *pcModule;
+    const tsBench  *asBenchs;
+} asModules[] =
+{
+    { "CGI",        asBenchCGI },
+    { "Codec",      asBenchCodec },
+    { "Response",   asBenchResponse },
+    { "Cbor",       asBenchCbor },
+    { "Aggregate",  asBenchAggregate },
+    { "NodeWalk",   asBenchNodeWalk },
+};
+
+#define NUM_MODULES (sizeof(asModules) / sizeof(asModules[0]))
+
+/** Most iterations a benchmark is run for */
+#define BENCH_MAX_ITERATIONS    1000000000ULL
+
+/** Clock and allocation count at the start of the running benchmark */
+static uint64_t u64StartTime;
+static uint64_t u64StartAllocs;
+
+/** Further result of the running benchmark */
+static double dMetric;
+static const char *pcMetricUnit;
+
+
+/** Monotonic time in nanoseconds */
+static uint64_t u64Now(void)
+{
+    struct timespec sTime;
+    
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec;
+}
+
+
+void vBenchResetTimer(void)
+{
+    u64StartAllocs = u64AllocCount();
+    u64StartTime = u64Now();
+}
+
+
+void vBenchMetric(double dValue, const char *pcUnit)
+{
+    dMetric = dValue;
+    pcMetricUnit = pcUnit;
+}
+
+
+/** Run a benchmark for a number of iterations.
+ *  \param pu64Allocs   Pointer to location to store the number of allocations made
+ *  \return Time taken in nanoseconds */
+static uint64_t u64Run(const tsBench *psBench, uint64_t u64Iterations, uint64_t *pu64Allocs)
+{
+    uint64_t u64Time;
+    
+    pcMetricUnit = NULL;
+    vBenchResetTimer();
+    psBench->prBench(u64Iterations);
+    u64Time = u64Now() - u64StartTime;
+    *pu64Allocs = u64AllocCount() - u64StartAllocs;
+    return u64Time;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *pcFilter = (argc > 1) ? argv[1] : NULL;
+    uint64_t u64Target = BENCH_DEFAULT_TIME * 1000000ULL;
+    const char *pcTime;
+    unsigned int i;
+    
+    if ((argc > 2) || (pcFilter && (strcmp(pcFilter, "-h") == 0)))
+    {
+        fprintf(stderr, "Usage: %s [filter]\n", argv[0]);
+        fprintf(stderr, "  Runs the benchmarks whose \"Module.benchmark\" name contains filter, or all of them.\n");
+        fprintf(stderr, "  Each is run for %s milliseconds, default %d.\n", BENCH_TIME_ENV, BENCH_DEFAULT_TIME);
+        return EXIT_FAILURE;
+    }
+    
+    pcTime = getenv(BENCH_TIME_ENV);
+    if (pcTime && (strtoul(pcTime, NULL, 0) > 0))
+    {
+        u64Target = strtoull(pcTime, NULL, 0) * 1000000ULL;
+    }
+    
+    printf("%-40s %12s %14s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+    for (i = 0; i < NUM_MODULES; i++)
+    {
+        const tsBench *psBench;
+        
+        for (psBench = asModules[i].asBenchs; psBench->pcName; psBench++)
+        {
+            uint64_t u64Iterations = 1;
+            uint64_t u64Allocs;
+            uint64_t u64Time;
+            char acName[128];
+            
+            snprintf(acName, sizeof(acName), "%s.%s", asModules[i].pcModule, psBench->pcName);
+            if (pcFilter && !strstr(acName, pcFilter))
+            {
+                continue;
+            }
+            
+            /* Grow the number of iterations until a run takes the target time,
+             * predicting from the last run but growing at most a hundred fold */
+            u64Time = u64Run(psBench, u64Iterations, &u64Allocs);
+            while ((u64Time < u64Target) && (u64Iterations < BENCH_MAX_ITERATIONS))
+            {
+                uint64_t u64Next = u64Time ? (u64Iterations * u64Target * 6 / 5) / u64Time : u64Iterations * 100;
+                
+                if (u64Next > u64Iterations * 100)
+                {
+                    u64Next = u64Iterations * 100;
+                }
+                u64Iterations = (u64Next > u64Iterations) ? u64Next : u64Iterations + 1;
+                u64Time = u64Run(psBench, u64Iterations, &u64Allocs);
+            }
+            
+            printf("%-40s %12llu %14.1f %12.2f", acName, (unsigned long long)u64Iterations, 
+                   (double)u64Time / u64Iterations, (double)u64Allocs / u64Iterations);
+            if (pcMetricUnit)
+            {
+                printf(" %14.1f %s", dMetric, pcMetricUnit);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Microbenchmark runner
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#ifndef __BENCH_H_
+#define __BENCH_H_
+
+#include <stdint.h>
+
+/** Environment variable giving the time, in milliseconds, each benchmark is run for */
+#define BENCH_TIME_ENV          "JIPBENCH_TIME"
+
+/** Default time each benchmark is run for, in milliseconds */
+#define BENCH_DEFAULT_TIME      500
+
+
+/** A benchmark. Does the operation being measured u64Iterations times */
+typedef void (*tprBench)(uint64_t u64Iterations);
+
+/** Benchmarks of one module, run by the benchmark runner */
+typedef struct
+{
+    const char     *pcName;         /**< Name of the benchmark */
+    tprBench        prBench;        /**< Benchmark */
+} tsBench;
+
+#define BENCH(bench)            { #bench, bench }
+#define BENCH_END               { NULL, NULL }
+
+
+/** Restart the clock and allocation count of the running benchmark,
+ *  so that its setup is not measured. */
+void vBenchResetTimer(void);
+
+
+/** Report a further result of the running benchmark alongside its time,
+ *  eg. the size of its output.
+ *  \param dValue           Value per iteration
+ *  \param pcUnit           Unit of the value, eg. "bytes/op"
+ */
+void vBenchMetric(double dValue, const char *pcUnit);
+
+
+extern const tsBench asBenchCGI[];
+extern const tsBench asBenchCodec[];
+extern const tsBench asBenchResponse[];
+extern const tsBench asBenchCbor[];
+extern const tsBench asBenchAggregate[];
+extern const tsBench asBenchNodeWalk[];
+
+#endif /* __BENCH_H_ */
@@ -0,0 +1,196 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Benchmarks of the history aggregation kernels
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Aggregate.h"
+#include "Bench.h"
+
+/** Samples in each column, a day of readings every tenth of a second */
+#define BENCH_NUM_SAMPLES       1000000
+
+/** Points a series is downsampled to, about the width of a graph */
+#define BENCH_NUM_POINTS        1000
+
+
+/** Columns shared by the benchmarks, made on first use */
+static float *pfX;
+static float *pfY;
+static int32_t *pi32Values;
+static uint32_t *pu32Selected;
+
+/** Results, kept so that the work is not optimised out */
+static volatile float fResult;
+static volatile int64_t i64Result;
+
+
+/** Make the columns of samples */
+static void vMakeColumns(void)
+{
+    uint32_t u32Random = 1;
+    uint32_t i;
+    
+    if (pfX)
+    {
+        return;
+    }
+    pfX = malloc(BENCH_NUM_SAMPLES * sizeof(float));
+    pfY = malloc(BENCH_NUM_SAMPLES * sizeof(float));
+    pi32Values = malloc(BENCH_NUM_SAMPLES * sizeof(int32_t));
+    pu32Selected = malloc(BENCH_NUM_POINTS * sizeof(uint32_t));
+    if (!pfX || !pfY || !pi32Values || !pu32Selected)
+    {
+        fprintf(stderr, "No memory for samples\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    for (i = 0; i < BENCH_NUM_SAMPLES; i++)
+    {
+        u32Random = u32Random * 1103515245 + 12345;
+        pfX[i] = (float)i * 0.1f;
+        pfY[i] = 20.0f + 5.0f * sinf((float)i / 20000.0f) + (float)((u32Random >> 16) & 0xFF) / 256.0f;
+        pi32Values[i] = (int32_t)(pfY[i] * 100.0f);
+    }
+}
+
+
+static void vBenchFloat(uint64_t u64Iterations)
+{
+    tsAggregateFloat sResult;
+    uint64_t i;
+    
+    vMakeColumns();
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        vAggregateFloat(pfY, BENCH_NUM_SAMPLES, &sResult);
+        fResult = sResult.fMax;
+    }
+    vBenchMetric(BENCH_NUM_SAMPLES, "samples");
+}
+
+
+static void vBenchFloatScalar(uint64_t u64Iterations)
+{
+    tsAggregateFloat sResult;
+    uint64_t i;
+    
+    vMakeColumns();
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        vAggregateFloatScalar(pfY, BENCH_NUM_SAMPLES, &sResult);
+        fResult = sResult.fMax;
+    }
+    vBenchMetric(BENCH_NUM_SAMPLES, "samples");
+}
+
+
+static void vBenchInt32(uint64_t u64Iterations)
+{
+    tsAggregateInt32 sResult;
+    uint64_t i;
+    
+    vMakeColumns();
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        vAggregateInt32(pi32Values, BENCH_NUM_SAMPLES, &sResult);
+        i64Result = sResult.i64Sum;
+    }
+    vBenchMetric(BENCH_NUM_SAMPLES, "samples");
+}
+
+
+static void vBenchInt32Scalar(uint64_t u64Iterations)
+{
+    tsAggregateInt32 sResult;
+    uint64_t i;
+    
+    vMakeColumns();
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        vAggregateInt32Scalar(pi32Values, BENCH_NUM_SAMPLES, &sResult);
+        i64Result = sResult.i64Sum;
+    }
+    vBenchMetric(BENCH_NUM_SAMPLES, "samples");
+}
+
+
+static void vBenchLTTB(uint64_t u64Iterations)
+{
+    uint64_t i;
+    
+    vMakeColumns();
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        i64Result = u32AggregateLTTB(pfX, pfY, BENCH_NUM_SAMPLES, BENCH_NUM_POINTS, pu32Selected);
+    }
+    vBenchMetric(BENCH_NUM_SAMPLES, "samples");
+}
+
+
+static void vBenchLTTBScalar(uint64_t u64Iterations)
+{
+    uint64_t i;
+    
+    vMakeColumns();
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        i64Result = u32AggregateLTTBScalar(pfX, pfY, BENCH_NUM_SAMPLES, BENCH_NUM_POINTS, pu32Selected);
+    }
+    vBenchMetric(BENCH_NUM_SAMPLES, "samples");
+}
+
+
+const tsBench asBenchAggregate[] =
+{
+    BENCH(vBenchFloat),
+    BENCH(vBenchFloatScalar),
+    BENCH(vBenchInt32),
+    BENCH(vBenchInt32Scalar),
+    BENCH(vBenchLTTB),
+    BENCH(vBenchLTTBScalar),
+    BENCH_END
+};
@@ -0,0 +1,213 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Benchmarks of the CGI request parser
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Arena.h"
+#include "Bench.h"
+#include "CGI.h"
+
+/** Variables in the largest request */
+#define BENCH_MANY_VARS         256
+
+/** A typical request from the web pages */
+#define BENCH_QUERY             "action=setVar&BRaddress=fd04%3Abd3%3A80e8%3A2%3A%3A1" \
+                                "&nodeaddress=fd04%3Abd3%3A80e8%3A2%3A%3A2&mib=BulbControl" \
+                                "&var=Mode&value=On+at+50%25"
+
+/** Result of a lookup, kept so that the lookups are not optimised out */
+static char * volatile pcResult;
+
+
+/** Set up the environment of a GET request */
+static void vGet(const char *pcQueryString)
+{
+    unsetenv("CONTENT_TYPE");
+    unsetenv("CONTENT_LENGTH");
+    setenv("REQUEST_METHOD", "GET", 1);
+    setenv("QUERY_STRING", pcQueryString, 1);
+}
+
+
+/** Query string of many variables, in a static buffer */
+static const char *pcManyVars(void)
+{
+    static char acQuery[BENCH_MANY_VARS * 16];
+    size_t szPos = 0;
+    int i;
+    
+    for (i = 0; i < BENCH_MANY_VARS; i++)
+    {
+        szPos += sprintf(&acQuery[szPos], "%svar%d=%d", i ? "&" : "", i, i);
+    }
+    return acQuery;
+}
+
+
+static void vBenchGet(uint64_t u64Iterations)
+{
+    tsCGI sCGI;
+    uint64_t i;
+    
+    vGet(BENCH_QUERY);
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        eCGIReadVariables(&sCGI);
+        vCGIFree(&sCGI);
+    }
+}
+
+
+static void vBenchGetManyVars(uint64_t u64Iterations)
+{
+    tsCGI sCGI;
+    uint64_t i;
+    
+    vGet(pcManyVars());
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        eCGIReadVariables(&sCGI);
+        vCGIFree(&sCGI);
+    }
+}
+
+
+static void vBenchPost(uint64_t u64Iterations)
+{
+    char acFileName[] = "/tmp/jip_bench_postXXXXXX";
+    char acLength[16];
+    tsCGI sCGI;
+    uint64_t i;
+    int iFd;
+    
+    iFd = mkstemp(acFileName);
+    if ((iFd < 0) || (write(iFd, BENCH_QUERY, strlen(BENCH_QUERY)) != (ssize_t)strlen(BENCH_QUERY)))
+    {
+        perror("Creating request body");
+        exit(EXIT_FAILURE);
+    }
+    close(iFd);
+    if (!freopen(acFileName, "r", stdin))
+    {
+        perror("Opening request body");
+        exit(EXIT_FAILURE);
+    }
+    unlink(acFileName);
+    
+    snprintf(acLength, sizeof(acLength), "%u", (unsigned int)strlen(BENCH_QUERY));
+    unsetenv("CONTENT_TYPE");
+    unsetenv("QUERY_STRING");
+    setenv("REQUEST_METHOD", "POST", 1);
+    setenv("CONTENT_LENGTH", acLength, 1);
+    
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        rewind(stdin);
+        eCGIReadVariables(&sCGI);
+        vCGIFree(&sCGI);
+    }
+}
+
+
+static void vBenchGetValue(uint64_t u64Iterations)
+{
+    static const char *apcNames[] = { "var0", "var100", "var255", "missing" };
+    tsCGI sCGI;
+    uint64_t i;
+    
+    vGet(pcManyVars());
+    eCGIReadVariables(&sCGI);
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        pcResult = pcCGIGetValue(&sCGI, apcNames[i & 3]);
+    }
+    vCGIFree(&sCGI);
+}
+
+
+static void vBenchURLEncode(uint64_t u64Iterations)
+{
+    const char *pcInput = "Living room lamp / \"Reading\" 100% & more";
+    tsArena sArena;
+    char *pcOutput;
+    uint64_t i;
+    
+    vArenaInit(&sArena);
+    for (i = 0; i < u64Iterations; i++)
+    {
+        eCGIURLEncode(&sArena, &pcOutput, pcInput);
+        vArenaFree(&sArena);
+    }
+    vBenchMetric(strlen(pcInput), "input bytes");
+}
+
+
+static void vBenchURLDecode(uint64_t u64Iterations)
+{
+    const char *pcInput = "Living+room+lamp+%2F+%22Reading%22+100%25+%26+more";
+    char acBuffer[64];
+    size_t szLength = strlen(pcInput) + 1;
+    uint64_t i;
+    
+    for (i = 0; i < u64Iterations; i++)
+    {
+        memcpy(acBuffer, pcInput, szLength);
+        eCGIURLDecode(acBuffer);
+    }
+    vBenchMetric(strlen(pcInput), "input bytes");
+}
+
+
+const tsBench asBenchCGI[] =
+{
+    BENCH(vBenchGet),
+    BENCH(vBenchGetManyVars),
+    BENCH(vBenchPost),
+    BENCH(vBenchGetValue),
+    BENCH(vBenchURLEncode),
+    BENCH(vBenchURLDecode),
+    BENCH_END
+};
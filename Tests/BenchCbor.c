@@ -0,0 +1,175 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Benchmarks of the CBOR encoder against JSON
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Bench.h"
+#include "Cbor.h"
+#include "Codec.h"
+
+/** Nodes in the network described */
+#define BENCH_NUM_NODES         50
+
+/** Bytes in the blob variable of each node */
+#define BENCH_BLOB_SIZE         16
+
+
+/** Blob strings of the tree sent as CBOR, which are marked on every encode */
+static struct json_object *apsBlobs[BENCH_NUM_NODES];
+
+
+/** Build a tree much like the result of a discover with values.
+ *  \param iCbor            Non zero to hold blobs as raw bytes for CBOR, otherwise as hex text for JSON */
+static struct json_object *psMakeTree(int iCbor)
+{
+    struct json_object *psRoot = json_object_new_object();
+    struct json_object *psNodes = json_object_new_array();
+    int i;
+    
+    for (i = 0; i < BENCH_NUM_NODES; i++)
+    {
+        struct json_object *psNode = json_object_new_object();
+        struct json_object *psMibs = json_object_new_array();
+        struct json_object *psMib = json_object_new_object();
+        struct json_object *psVars = json_object_new_array();
+        struct json_object *psVar;
+        uint8_t au8Blob[BENCH_BLOB_SIZE];
+        char acAddress[64];
+        int j;
+        
+        snprintf(acAddress, sizeof(acAddress), "fd04:bd3:80e8:2::%x", i + 1);
+        json_object_object_add(psNode, "IPv6Address", json_object_new_string(acAddress));
+        json_object_object_add(psNode, "DeviceID", json_object_new_int(0x08010010 + (i & 1)));
+        
+        json_object_object_add(psMib, "Name", json_object_new_string((i & 1) ? "Environment" : "BulbControl"));
+        json_object_object_add(psMib, "ID", json_object_new_int(0x7ffffe04));
+        
+        psVar = json_object_new_object();
+        json_object_object_add(psVar, "Name", json_object_new_string("Temperature"));
+        json_object_object_add(psVar, "Type", json_object_new_int(E_JIP_VAR_TYPE_FLT));
+        json_object_object_add(psVar, "Data", json_object_new_double(20.0 + (i % 17) * 0.25));
+        json_object_array_add(psVars, psVar);
+        
+        psVar = json_object_new_object();
+        json_object_object_add(psVar, "Name", json_object_new_string("Mode"));
+        json_object_object_add(psVar, "Type", json_object_new_int(E_JIP_VAR_TYPE_UINT8));
+        json_object_object_add(psVar, "Data", json_object_new_int(i & 3));
+        json_object_array_add(psVars, psVar);
+        
+        for (j = 0; j < BENCH_BLOB_SIZE; j++)
+        {
+            au8Blob[j] = (uint8_t)(i * 31 + j * 7);
+        }
+        psVar = json_object_new_object();
+        json_object_object_add(psVar, "Name", json_object_new_string("Key"));
+        json_object_object_add(psVar, "Type", json_object_new_int(E_JIP_VAR_TYPE_BLOB));
+        if (iCbor)
+        {
+            apsBlobs[i] = json_object_new_string_len((const char *)au8Blob, sizeof(au8Blob));
+            json_object_object_add(psVar, "Data", apsBlobs[i]);
+        }
+        else
+        {
+            char *pcHex;
+            
+            eCodecFormatBlob(NULL, au8Blob, sizeof(au8Blob), &pcHex);
+            json_object_object_add(psVar, "Data", json_object_new_string(pcHex));
+            free(pcHex);
+        }
+        json_object_array_add(psVars, psVar);
+        
+        json_object_object_add(psMib, "Vars", psVars);
+        json_object_array_add(psMibs, psMib);
+        json_object_object_add(psNode, "MiBs", psMibs);
+        json_object_array_add(psNodes, psNode);
+    }
+    json_object_object_add(psRoot, "Nodes", psNodes);
+    return psRoot;
+}
+
+
+static void vBenchEncodeJson(uint64_t u64Iterations)
+{
+    struct json_object *psTree = psMakeTree(0);
+    size_t szLength = 0;
+    uint64_t i;
+    
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        szLength = strlen(json_object_to_json_string(psTree));
+    }
+    vBenchMetric(szLength, "bytes");
+    json_object_put(psTree);
+}
+
+
+static void vBenchEncodeCbor(uint64_t u64Iterations)
+{
+    struct json_object *psTree = psMakeTree(1);
+    size_t szLength = 0;
+    tsCbor sCbor;
+    uint64_t i;
+    int j;
+    
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        eCborInit(&sCbor);
+        for (j = 0; j < BENCH_NUM_NODES; j++)
+        {
+            eCborMarkBytes(&sCbor, apsBlobs[j]);
+        }
+        eCborEncodeJson(&sCbor, psTree);
+        szLength = sCbor.szLength;
+        vCborFree(&sCbor);
+    }
+    vBenchMetric(szLength, "bytes");
+    json_object_put(psTree);
+}
+
+
+const tsBench asBenchCbor[] =
+{
+    BENCH(vBenchEncodeJson),
+    BENCH(vBenchEncodeCbor),
+    BENCH_END
+};
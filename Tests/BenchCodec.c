@@ -0,0 +1,212 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Benchmarks of the value codecs
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arena.h"
+#include "Bench.h"
+#include "Codec.h"
+
+/** Bytes in the blob and in each table row */
+#define BENCH_BLOB_SIZE         64
+
+/** Rows in the table */
+#define BENCH_TABLE_ROWS        32
+
+
+/** Parse a value over and over, releasing the arena after each as a request would */
+static void vParse(uint64_t u64Iterations, teJIP_VarType eVarType, const char *pcValue)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    tsArena sArena;
+    void *pvBuffer;
+    uint64_t i;
+    
+    vArenaInit(&sArena);
+    for (i = 0; i < u64Iterations; i++)
+    {
+        if (eCodecParseValue(&sArena, eVarType, pcValue, &pvBuffer, &u32Size, &pcError) != E_CODEC_OK)
+        {
+            fprintf(stderr, "Parsing \"%s\": %s\n", pcValue, pcError);
+            exit(EXIT_FAILURE);
+        }
+        vArenaFree(&sArena);
+    }
+}
+
+
+static void vBenchParseUint32(uint64_t u64Iterations)
+{
+    vParse(u64Iterations, E_JIP_VAR_TYPE_UINT32, "0x80821CE1");
+}
+
+
+static void vBenchParseInt8(uint64_t u64Iterations)
+{
+    vParse(u64Iterations, E_JIP_VAR_TYPE_INT8, "-100");
+}
+
+
+static void vBenchParseFloat(uint64_t u64Iterations)
+{
+    vParse(u64Iterations, E_JIP_VAR_TYPE_FLT, "21.375");
+}
+
+
+static void vBenchParseString(uint64_t u64Iterations)
+{
+    vParse(u64Iterations, E_JIP_VAR_TYPE_STR, "Living room lamp");
+}
+
+
+static void vBenchParseBlob(uint64_t u64Iterations)
+{
+    char acHex[2 + 2 * BENCH_BLOB_SIZE + 1];
+    int i;
+    
+    strcpy(acHex, "0x");
+    for (i = 0; i < BENCH_BLOB_SIZE; i++)
+    {
+        sprintf(&acHex[2 + 2 * i], "%02x", (i * 37) & 0xFF);
+    }
+    vBenchResetTimer();
+    vParse(u64Iterations, E_JIP_VAR_TYPE_BLOB, acHex);
+    vBenchMetric(BENCH_BLOB_SIZE, "blob bytes");
+}
+
+
+/** Parse a blob with malloc rather than an arena, for comparison */
+static void vBenchParseBlobMalloc(uint64_t u64Iterations)
+{
+    char acHex[2 + 2 * BENCH_BLOB_SIZE + 1];
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    uint64_t i;
+    
+    strcpy(acHex, "0x");
+    for (i = 0; i < BENCH_BLOB_SIZE; i++)
+    {
+        sprintf(&acHex[2 + 2 * i], "%02x", (unsigned int)((i * 37) & 0xFF));
+    }
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        if (eCodecParseValue(NULL, E_JIP_VAR_TYPE_BLOB, acHex, &pvBuffer, &u32Size, &pcError) != E_CODEC_OK)
+        {
+            fprintf(stderr, "Parsing blob: %s\n", pcError);
+            exit(EXIT_FAILURE);
+        }
+        free(pvBuffer);
+    }
+    vBenchMetric(BENCH_BLOB_SIZE, "blob bytes");
+}
+
+
+static void vBenchFormatBlob(uint64_t u64Iterations)
+{
+    uint8_t au8Data[BENCH_BLOB_SIZE];
+    tsArena sArena;
+    char *pcText;
+    uint64_t i;
+    
+    for (i = 0; i < BENCH_BLOB_SIZE; i++)
+    {
+        au8Data[i] = (uint8_t)(i * 37);
+    }
+    vArenaInit(&sArena);
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        eCodecFormatBlob(&sArena, au8Data, sizeof(au8Data), &pcText);
+        vArenaFree(&sArena);
+    }
+    vBenchMetric(BENCH_BLOB_SIZE, "blob bytes");
+}
+
+
+static void vBenchFormatTable(uint64_t u64Iterations)
+{
+    static uint8_t au8Data[BENCH_TABLE_ROWS][BENCH_BLOB_SIZE];
+    tsTableRow asRows[BENCH_TABLE_ROWS];
+    tsTable sTable;
+    tsArena sArena;
+    char *pcText = NULL;
+    uint64_t i;
+    
+    /* Every fourth row is empty */
+    for (i = 0; i < BENCH_TABLE_ROWS; i++)
+    {
+        memset(au8Data[i], (int)i, BENCH_BLOB_SIZE);
+        asRows[i].pvData    = (i & 3) ? au8Data[i] : NULL;
+        asRows[i].u32Length = (i & 3) ? BENCH_BLOB_SIZE : 0;
+    }
+    sTable.u32NumRows = BENCH_TABLE_ROWS;
+    sTable.psRows = asRows;
+    
+    vArenaInit(&sArena);
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        eCodecFormatTable(&sArena, &sTable, &pcText);
+        if (i + 1 < u64Iterations)
+        {
+            vArenaFree(&sArena);
+        }
+    }
+    vBenchMetric(pcText ? strlen(pcText) : 0, "text bytes");
+    vArenaFree(&sArena);
+}
+
+
+const tsBench asBenchCodec[] =
+{
+    BENCH(vBenchParseUint32),
+    BENCH(vBenchParseInt8),
+    BENCH(vBenchParseFloat),
+    BENCH(vBenchParseString),
+    BENCH(vBenchParseBlob),
+    BENCH(vBenchParseBlobMalloc),
+    BENCH(vBenchFormatBlob),
+    BENCH(vBenchFormatTable),
+    BENCH_END
+};
@@ -0,0 +1,359 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Node walk benchmarks
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+/* Contention between threads using one context, as in JIPd: readers that
+ * visit every node and read a variable of each over the network, and a
+ * discovery writer that periodically updates the node tree. Reads are
+ * simulated by a sleep, as no nodes are present, so the benchmarks measure
+ * how the readers and writer hold each other up rather than the radio.
+ * The network is loaded from the snapshot JIPd keeps in /tmp. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <JIP.h>
+
+#include "Bench.h"
+#include "NetworkCache.h"
+#include "NodeWalk.h"
+
+/** Readers walking the network at once, eg. broker clients and the history sampler */
+#define BENCH_READERS           8
+
+/** Environment variable holding the border router whose snapshot is walked */
+#define BENCH_BR_ADDRESS_ENV    "JIPBENCH_BR"
+
+/** Border router walked by default, that JIPSim makes snapshots of */
+#define BENCH_BR_ADDRESS        "::1"
+
+/** Time a simulated read of a node's variable takes, in microseconds */
+#define BENCH_READ_US           200
+
+/** Time the writer holds the context for to update the tree, and the interval between updates, in microseconds */
+#define BENCH_UPDATE_US         50
+#define BENCH_UPDATE_INTERVAL   2000
+
+
+/** Context holding the network. Loaded on first use */
+static tsJIP_Context sJIP_Context;
+static int iLoaded = 0;
+static uint32_t u32NumNodes = 0;
+
+/** Nodes visited, kept so that the walks are not optimised out */
+static volatile uint32_t u32Visited;
+
+
+/** State shared by the threads of a contention benchmark */
+typedef struct
+{
+    pthread_mutex_t     sMutex;         /**< Protects the fields below */
+    uint64_t            u64Remaining;   /**< Walks still to do */
+    int                 iWholeContext;  /**< Set to hold the context lock for each whole walk */
+    int                 iDone;          /**< Set when the readers have finished */
+    uint64_t            u64Updates;     /**< Updates made by the writer */
+    uint64_t            u64WaitNs;      /**< Time the writer spent waiting for the context lock */
+} tsContention;
+
+
+/** Monotonic time in nanoseconds */
+static uint64_t u64Now(void)
+{
+    struct timespec sTime;
+    
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec;
+}
+
+
+static void vSleepUs(uint32_t u32Us)
+{
+    struct timespec sTime;
+    
+    sTime.tv_sec  = u32Us / 1000000;
+    sTime.tv_nsec = (u32Us % 1000000) * 1000;
+    nanosleep(&sTime, NULL);
+}
+
+
+/** Load the network snapshot. \return non-zero if there is a network to walk */
+static int iLoadNetwork(void)
+{
+    tsNetworkCacheState sState;
+    char acDefinitionsFileName[CACHE_FILE_NAME_LENGTH];
+    char acNetworkFileName[CACHE_FILE_NAME_LENGTH];
+    const char *pcBRAddress;
+    tsNode *psNode;
+    
+    if (iLoaded)
+    {
+        return iLoaded > 0;
+    }
+    
+    pcBRAddress = getenv(BENCH_BR_ADDRESS_ENV);
+    if (!pcBRAddress)
+    {
+        pcBRAddress = BENCH_BR_ADDRESS;
+    }
+    
+    iLoaded = -1;
+    if (eNetworkCacheReadState(pcBRAddress, &sState) != E_NETWORK_CACHE_OK)
+    {
+        fprintf(stderr, "No network snapshot of %s - run JIPd to make one, and set %s to its border router. "
+                "Node walks are not measured\n", pcBRAddress, BENCH_BR_ADDRESS_ENV);
+        return 0;
+    }
+    vNetworkCacheFileName(acDefinitionsFileName, sizeof(acDefinitionsFileName), CACHE_DEFINITIONS_FILE_NAME, &sState);
+    vNetworkCacheFileName(acNetworkFileName, sizeof(acNetworkFileName), CACHE_NETWORK_FILE_NAME, &sState);
+    
+    if ((eJIP_Init(&sJIP_Context, E_JIP_CONTEXT_CLIENT) != E_JIP_OK) ||
+        (eJIPService_PersistXMLLoadDefinitions(&sJIP_Context, acDefinitionsFileName) != E_JIP_OK) ||
+        (eJIPService_PersistXMLLoadNetwork(&sJIP_Context, acNetworkFileName) != E_JIP_OK))
+    {
+        fprintf(stderr, "No network snapshot in %s - run JIPd to make one. Node walks are not measured\n", 
+                acNetworkFileName);
+        return 0;
+    }
+    
+    for (psNode = sJIP_Context.sNetwork.psNodes; psNode; psNode = psNode->psNext)
+    {
+        u32NumNodes++;
+    }
+    if (u32NumNodes == 0)
+    {
+        fprintf(stderr, "The network snapshot in %s is empty. Node walks are not measured\n", acNetworkFileName);
+        return 0;
+    }
+    iLoaded = 1;
+    return 1;
+}
+
+
+/** Visit every node holding the context lock throughout, as the pages used to */
+static void vWalkWholeContext(uint32_t u32ReadUs)
+{
+    tsNode *psNode;
+    
+    eJIP_Lock(&sJIP_Context);
+    for (psNode = sJIP_Context.sNetwork.psNodes; psNode; psNode = psNode->psNext)
+    {
+        if (u32ReadUs)
+        {
+            vSleepUs(u32ReadUs);
+        }
+        u32Visited++;
+    }
+    eJIP_Unlock(&sJIP_Context);
+}
+
+
+/** Visit every node holding only its own lock */
+static void vWalkPerNode(uint32_t u32ReadUs)
+{
+    tsNodeWalk sWalk;
+    tsNode *psNode;
+    
+    (void)eNodeWalkStart(&sWalk, &sJIP_Context, JIP_DEVICEID_ALL);
+    for (psNode = psNodeWalkNext(&sWalk); psNode; psNode = psNodeWalkNext(&sWalk))
+    {
+        if (u32ReadUs)
+        {
+            vSleepUs(u32ReadUs);
+        }
+        u32Visited++;
+    }
+    vNodeWalkEnd(&sWalk);
+}
+
+
+static void *pvReader(void *pvUser)
+{
+    tsContention *psContention = (tsContention *)pvUser;
+    
+    for (;;)
+    {
+        pthread_mutex_lock(&psContention->sMutex);
+        if (psContention->u64Remaining == 0)
+        {
+            pthread_mutex_unlock(&psContention->sMutex);
+            break;
+        }
+        psContention->u64Remaining--;
+        pthread_mutex_unlock(&psContention->sMutex);
+        
+        if (psContention->iWholeContext)
+        {
+            vWalkWholeContext(BENCH_READ_US);
+        }
+        else
+        {
+            vWalkPerNode(BENCH_READ_US);
+        }
+    }
+    return NULL;
+}
+
+
+/** Update the tree as discovery does, timing how long the context lock takes to get */
+static void *pvWriter(void *pvUser)
+{
+    tsContention *psContention = (tsContention *)pvUser;
+    int iDone = 0;
+    
+    while (!iDone)
+    {
+        uint64_t u64Start = u64Now();
+        uint64_t u64Wait;
+        
+        eJIP_Lock(&sJIP_Context);
+        u64Wait = u64Now() - u64Start;
+        vSleepUs(BENCH_UPDATE_US);
+        eJIP_Unlock(&sJIP_Context);
+        
+        pthread_mutex_lock(&psContention->sMutex);
+        psContention->u64Updates++;
+        psContention->u64WaitNs += u64Wait;
+        iDone = psContention->iDone;
+        pthread_mutex_unlock(&psContention->sMutex);
+        
+        vSleepUs(BENCH_UPDATE_INTERVAL);
+    }
+    return NULL;
+}
+
+
+/** Run u64Iterations walks over BENCH_READERS readers, alongside the writer */
+static void vContention(uint64_t u64Iterations, int iWholeContext)
+{
+    tsContention sContention;
+    pthread_t asReaders[BENCH_READERS];
+    pthread_t sWriter;
+    int i;
+    
+    if (!iLoadNetwork())
+    {
+        return;
+    }
+    
+    pthread_mutex_init(&sContention.sMutex, NULL);
+    sContention.u64Remaining    = u64Iterations;
+    sContention.iWholeContext   = iWholeContext;
+    sContention.iDone           = 0;
+    sContention.u64Updates      = 0;
+    sContention.u64WaitNs       = 0;
+    
+    vBenchResetTimer();
+    pthread_create(&sWriter, NULL, pvWriter, &sContention);
+    for (i = 0; i < BENCH_READERS; i++)
+    {
+        pthread_create(&asReaders[i], NULL, pvReader, &sContention);
+    }
+    for (i = 0; i < BENCH_READERS; i++)
+    {
+        pthread_join(asReaders[i], NULL);
+    }
+    
+    pthread_mutex_lock(&sContention.sMutex);
+    sContention.iDone = 1;
+    pthread_mutex_unlock(&sContention.sMutex);
+    pthread_join(sWriter, NULL);
+    pthread_mutex_destroy(&sContention.sMutex);
+    
+    /* How long discovery is held up for while the pages read the network */
+    vBenchMetric(sContention.u64Updates ? (double)sContention.u64WaitNs / sContention.u64Updates / 1000.0 : 0.0, 
+                 "us writer wait");
+}
+
+
+static void vBenchContentionWholeContext(uint64_t u64Iterations)
+{
+    vContention(u64Iterations, 1);
+}
+
+
+static void vBenchContentionPerNode(uint64_t u64Iterations)
+{
+    vContention(u64Iterations, 0);
+}
+
+
+/** Cost of a walk itself, without reads or other threads */
+static void vBenchWalkWholeContext(uint64_t u64Iterations)
+{
+    uint64_t i;
+    
+    if (!iLoadNetwork())
+    {
+        return;
+    }
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        vWalkWholeContext(0);
+    }
+    vBenchMetric(u32NumNodes, "nodes");
+}
+
+
+static void vBenchWalkPerNode(uint64_t u64Iterations)
+{
+    uint64_t i;
+    
+    if (!iLoadNetwork())
+    {
+        return;
+    }
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        vWalkPerNode(0);
+    }
+    vBenchMetric(u32NumNodes, "nodes");
+}
+
+
+const tsBench asBenchNodeWalk[] =
+{
+    BENCH(vBenchWalkWholeContext),
+    BENCH(vBenchWalkPerNode),
+    BENCH(vBenchContentionWholeContext),
+    BENCH(vBenchContentionPerNode),
+    BENCH_END
+};
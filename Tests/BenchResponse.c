@@ -0,0 +1,157 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Benchmarks of the compressing response writer
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Bench.h"
+#include "Response.h"
+
+/** Size of the body sent, about that of a discover of a 50 node network */
+#define BENCH_BODY_SIZE         (48 * 1024)
+
+/** Size of each write of the body, as the JSON printer hands it over */
+#define BENCH_WRITE_SIZE        4096
+
+
+/** Fill a buffer with text much like a discover response */
+static char *pcMakeBody(void)
+{
+    char *pcBody = malloc(BENCH_BODY_SIZE);
+    size_t szOffset = 0;
+    int i = 0;
+    
+    while (pcBody && (szOffset < BENCH_BODY_SIZE))
+    {
+        char acNode[160];
+        int iLength = snprintf(acNode, sizeof(acNode), 
+                               "{ \"Address\": \"fd04:bd3:80e8:2::%x\", \"DeviceID\": %d, "
+                               "\"MiBs\": [ { \"Name\": \"%s\", \"Temperature\": %d } ] }, ", 
+                               i, 0x08010010 + (i & 1), (i & 1) ? "Environment" : "BulbControl", 
+                               2000 + (i * 37) % 500);
+        size_t szCopy = ((size_t)iLength < BENCH_BODY_SIZE - szOffset) ? (size_t)iLength : BENCH_BODY_SIZE - szOffset;
+        memcpy(pcBody + szOffset, acNode, szCopy);
+        szOffset += szCopy;
+        i++;
+    }
+    if (!pcBody)
+    {
+        fprintf(stderr, "No memory for body\n");
+        exit(EXIT_FAILURE);
+    }
+    return pcBody;
+}
+
+
+/** Send the body through responses at a compression level, to /dev/null.
+ *  \param pcLevel          Compression level, as given in the environment */
+static void vRespond(uint64_t u64Iterations, const char *pcLevel)
+{
+    char *pcBody = pcMakeBody();
+    tsResponse sResponse;
+    size_t szWire = 0;
+    uint64_t i;
+    int iFd;
+    
+    iFd = open("/dev/null", O_WRONLY);
+    if (iFd < 0)
+    {
+        perror("Opening /dev/null");
+        exit(EXIT_FAILURE);
+    }
+    setenv("HTTP_ACCEPT_ENCODING", "gzip, deflate", 1);
+    setenv(RESPONSE_LEVEL_ENV, pcLevel, 1);
+    unsetenv(RESPONSE_THRESHOLD_ENV);
+    
+    vBenchResetTimer();
+    for (i = 0; i < u64Iterations; i++)
+    {
+        size_t szOffset;
+        
+        eResponseInit(&sResponse, iFd);
+        eResponseHeader(&sResponse, "Content-type: application/json");
+        for (szOffset = 0; szOffset < BENCH_BODY_SIZE; szOffset += BENCH_WRITE_SIZE)
+        {
+            size_t szWrite = BENCH_BODY_SIZE - szOffset;
+            eResponseWrite(&sResponse, pcBody + szOffset, (szWrite < BENCH_WRITE_SIZE) ? szWrite : BENCH_WRITE_SIZE);
+        }
+        eResponseFinish(&sResponse);
+        szWire = sResponse.szWire;
+    }
+    
+    /* CPU time against bytes saved: the time is per response, this is what it put on the wire */
+    vBenchMetric(szWire, "wire bytes");
+    close(iFd);
+    free(pcBody);
+}
+
+
+/** One benchmark per compression level. Level 0 sends the body as it is */
+#define BENCH_LEVEL(level) \
+    static void vBenchLevel##level(uint64_t u64Iterations) { vRespond(u64Iterations, #level); }
+
+BENCH_LEVEL(0)
+BENCH_LEVEL(1)
+BENCH_LEVEL(2)
+BENCH_LEVEL(3)
+BENCH_LEVEL(4)
+BENCH_LEVEL(5)
+BENCH_LEVEL(6)
+BENCH_LEVEL(7)
+BENCH_LEVEL(8)
+BENCH_LEVEL(9)
+
+
+const tsBench asBenchResponse[] =
+{
+    BENCH(vBenchLevel0),
+    BENCH(vBenchLevel1),
+    BENCH(vBenchLevel2),
+    BENCH(vBenchLevel3),
+    BENCH(vBenchLevel4),
+    BENCH(vBenchLevel5),
+    BENCH(vBenchLevel6),
+    BENCH(vBenchLevel7),
+    BENCH(vBenchLevel8),
+    BENCH(vBenchLevel9),
+    BENCH_END
+};
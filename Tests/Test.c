@@ -0,0 +1,126 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Test runner
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "Test.h"
+
+/** Modules in the order they are tested */
+static const struct
+{
+    const char     *pcModule;
+    const tsTest   *asTests;
+} asModules[] =
+{
+    { "CGI",        asTestCGI },
+    { "Codec",      asTestCodec },
+    { "Config",     asTestConfig },
+    { "Response",   asTestResponse },
+    { "Cbor",       asTestCbor },
+    { "Aggregate",  asTestAggregate },
+    { "Http",       asTestHttp },
+    { "AssetPack",  asTestAssetPack },
+};
+
+#define NUM_MODULES (sizeof(asModules) / sizeof(asModules[0]))
+
+/** Set when the running test case has failed */
+static int iFailed;
+
+
+void vTestFail(const char *pcFile, int iLine, const char *pcFormat, ...)
+{
+    va_list ap;
+    
+    iFailed = 1;
+    fprintf(stderr, "    %s:%d: ", pcFile, iLine);
+    va_start(ap, pcFormat);
+    vfprintf(stderr, pcFormat, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *pcFilter = (argc > 1) ? argv[1] : NULL;
+    unsigned int u32Run = 0;
+    unsigned int u32Failed = 0;
+    unsigned int i;
+    
+    if ((argc > 2) || (pcFilter && (strcmp(pcFilter, "-h") == 0)))
+    {
+        fprintf(stderr, "Usage: %s [filter]\n", argv[0]);
+        fprintf(stderr, "  Runs the test cases whose \"Module.test\" name contains filter, or all of them.\n");
+        return EXIT_FAILURE;
+    }
+    
+    for (i = 0; i < NUM_MODULES; i++)
+    {
+        const tsTest *psTest;
+        
+        for (psTest = asModules[i].asTests; psTest->pcName; psTest++)
+        {
+            char acName[128];
+            
+            snprintf(acName, sizeof(acName), "%s.%s", asModules[i].pcModule, psTest->pcName);
+            if (pcFilter && !strstr(acName, pcFilter))
+            {
+                continue;
+            }
+            
+            iFailed = 0;
+            psTest->prTest();
+            printf("%s %s\n", iFailed ? "FAIL" : "ok  ", acName);
+            fflush(stdout);
+            
+            u32Run++;
+            if (iFailed)
+            {
+                u32Failed++;
+            }
+        }
+    }
+    
+    printf("%u tests, %u failed\n", u32Run, u32Failed);
+    return u32Failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Test runner
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+#ifndef __TEST_H_
+#define __TEST_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/** A test case. Returns on the first failed assertion */
+typedef void (*tprTest)(void);
+
+/** Test cases of one module, run by the test runner */
+typedef struct
+{
+    const char     *pcName;         /**< Name of the test case */
+    tprTest         prTest;         /**< Test case */
+} tsTest;
+
+#define TEST(test)              { #test, test }
+#define TEST_END                { NULL, NULL }
+
+
+/** Record a failed assertion in the running test case.
+ *  \param pcFile           Source file of the assertion
+ *  \param iLine            Line of the assertion
+ *  \param pcFormat         printf style description of the failure
+ */
+void vTestFail(const char *pcFile, int iLine, const char *pcFormat, ...)
+    __attribute__((format(printf, 3, 4)));
+
+
+#define TEST_ASSERT(condition) \
+    do { if (!(condition)) { vTestFail(__FILE__, __LINE__, "%s", #condition); return; } } while (0)
+
+#define TEST_ASSERT_EQUAL_INT(expected, actual) \
+    do { long long llE = (long long)(expected), llA = (long long)(actual); \
+         if (llE != llA) { vTestFail(__FILE__, __LINE__, "%s: expected %lld, got %lld", #actual, llE, llA); return; } } while (0)
+
+#define TEST_ASSERT_EQUAL_STRING(expected, actual) \
+    do { const char *pcE = (expected), *pcA = (actual); \
+         if (!pcA || strcmp(pcE, pcA)) { vTestFail(__FILE__, __LINE__, "%s: expected \"%s\", got \"%s\"", #actual, pcE, pcA ? pcA : "(null)"); return; } } while (0)
+
+#define TEST_ASSERT_EQUAL_MEMORY(expected, actual, length) \
+    do { if (memcmp((expected), (actual), (length))) { vTestFail(__FILE__, __LINE__, "%s differs from %s", #actual, #expected); return; } } while (0)
+
+#define TEST_ASSERT_FLOAT_WITHIN(tolerance, expected, actual) \
+    do { double dE = (expected), dA = (actual); \
+         if ((dA - dE > (tolerance)) || (dE - dA > (tolerance))) { vTestFail(__FILE__, __LINE__, "%s: expected %g, got %g", #actual, dE, dA); return; } } while (0)
+
+
+/* Test cases of each module */
+extern const tsTest asTestCGI[];
+extern const tsTest asTestCodec[];
+extern const tsTest asTestConfig[];
+extern const tsTest asTestResponse[];
+extern const tsTest asTestCbor[];
+extern const tsTest asTestAggregate[];
+extern const tsTest asTestHttp[];
+extern const tsTest asTestAssetPack[];
+
+
+#endif /* __TEST_H_ */
@@ -0,0 +1,288 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Tests of the history aggregation kernels
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Aggregate.h"
+#include "Test.h"
+
+/** Longest column tested. Odd, so that every kernel has a tail to finish one sample at a time */
+#define TEST_MAX_SAMPLES        (3 * AGGREGATE_BLOCK + 7)
+
+static uint32_t u32Random = 1;
+
+
+/** Pseudo random number, the same every run */
+static uint32_t u32Rand(void)
+{
+    u32Random = u32Random * 1103515245 + 12345;
+    return u32Random >> 8;
+}
+
+
+/** Random float in [-fRange, fRange) */
+static float fRand(float fRange)
+{
+    return ((float)(u32Rand() & 0xFFFF) / 32768.0f - 1.0f) * fRange;
+}
+
+
+/** Column lengths checked: empty, shorter than a vector, odd, and over a block */
+static const uint32_t au32Lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 15, 16, 17, 63, 1001, AGGREGATE_BLOCK - 1, 
+                                        AGGREGATE_BLOCK, AGGREGATE_BLOCK + 1, TEST_MAX_SAMPLES };
+
+#define NUM_LENGTHS (sizeof(au32Lengths) / sizeof(au32Lengths[0]))
+
+
+static void vTestKernelName(void)
+{
+    const char *pcKernel = pcAggregateKernel();
+    
+    TEST_ASSERT(pcKernel != NULL);
+    TEST_ASSERT((strcmp(pcKernel, "SSE2") == 0) || (strcmp(pcKernel, "NEON") == 0) || (strcmp(pcKernel, "scalar") == 0));
+}
+
+
+static void vTestFloatMatchesScalar(void)
+{
+    float *pfValues = malloc(TEST_MAX_SAMPLES * sizeof(float));
+    int iOk = (pfValues != NULL);
+    uint32_t i, j;
+    
+    for (i = 0; iOk && (i < NUM_LENGTHS); i++)
+    {
+        tsAggregateFloat sVector, sScalar;
+        uint32_t u32Count = au32Lengths[i];
+        double dTolerance;
+        
+        for (j = 0; j < u32Count; j++)
+        {
+            pfValues[j] = 20.0f + fRand(15.0f);
+        }
+        vAggregateFloat(pfValues, u32Count, &sVector);
+        vAggregateFloatScalar(pfValues, u32Count, &sScalar);
+        
+        /* The sum is added up in a different order, so may differ in its last bits */
+        dTolerance = 1e-5 * (fabs(sScalar.dSum) + 1.0);
+        iOk = (sVector.u32Count == sScalar.u32Count) && (sVector.u32Count == u32Count) &&
+              (sVector.fMin == sScalar.fMin) && (sVector.fMax == sScalar.fMax) &&
+              (fabs(sVector.dSum - sScalar.dSum) <= dTolerance);
+        if (!iOk)
+        {
+            vTestFail(__FILE__, __LINE__, "%u samples: min %f / %f, max %f / %f, sum %f / %f", u32Count,
+                      sVector.fMin, sScalar.fMin, sVector.fMax, sScalar.fMax, sVector.dSum, sScalar.dSum);
+        }
+    }
+    free(pfValues);
+    TEST_ASSERT(pfValues != NULL);
+}
+
+
+static void vTestFloatExtremes(void)
+{
+    float afValues[] = { 3.0f, -1.5f, 7.25f, 0.0f, -8.0f, 2.0f, 7.25f, -8.0f, 1.0f };
+    tsAggregateFloat sResult;
+    
+    vAggregateFloat(afValues, sizeof(afValues) / sizeof(afValues[0]), &sResult);
+    TEST_ASSERT_EQUAL_INT(9, sResult.u32Count);
+    TEST_ASSERT_FLOAT_WITHIN(0.0, -8.0, sResult.fMin);
+    TEST_ASSERT_FLOAT_WITHIN(0.0, 7.25, sResult.fMax);
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, 3.0, sResult.dSum);
+    
+    vAggregateFloat(afValues, 0, &sResult);
+    TEST_ASSERT_EQUAL_INT(0, sResult.u32Count);
+    TEST_ASSERT_FLOAT_WITHIN(0.0, 0.0, sResult.fMin);
+    TEST_ASSERT_FLOAT_WITHIN(0.0, 0.0, sResult.fMax);
+}
+
+
+static void vTestInt32MatchesScalar(void)
+{
+    int32_t *pi32Values = malloc(TEST_MAX_SAMPLES * sizeof(int32_t));
+    int iOk = (pi32Values != NULL);
+    uint32_t i, j;
+    
+    for (i = 0; iOk && (i < NUM_LENGTHS); i++)
+    {
+        tsAggregateInt32 sVector, sScalar;
+        uint32_t u32Count = au32Lengths[i];
+        
+        /* Full range values, so the sum overflows 32 bits */
+        for (j = 0; j < u32Count; j++)
+        {
+            pi32Values[j] = (int32_t)((u32Rand() << 8) ^ u32Rand());
+        }
+        vAggregateInt32(pi32Values, u32Count, &sVector);
+        vAggregateInt32Scalar(pi32Values, u32Count, &sScalar);
+        
+        iOk = (sVector.u32Count == u32Count) && (sScalar.u32Count == u32Count) &&
+              (sVector.i32Min == sScalar.i32Min) && (sVector.i32Max == sScalar.i32Max) &&
+              (sVector.i64Sum == sScalar.i64Sum);
+        if (!iOk)
+        {
+            vTestFail(__FILE__, __LINE__, "%u samples: min %d / %d, max %d / %d, sum %lld / %lld", u32Count,
+                      sVector.i32Min, sScalar.i32Min, sVector.i32Max, sScalar.i32Max, 
+                      (long long)sVector.i64Sum, (long long)sScalar.i64Sum);
+        }
+    }
+    free(pi32Values);
+    TEST_ASSERT(pi32Values != NULL);
+}
+
+
+static void vTestInt32Extremes(void)
+{
+    int32_t ai32Values[] = { 5, INT32_MAX, -3, INT32_MIN, 0, INT32_MAX, 12 };
+    tsAggregateInt32 sResult;
+    
+    vAggregateInt32(ai32Values, sizeof(ai32Values) / sizeof(ai32Values[0]), &sResult);
+    TEST_ASSERT_EQUAL_INT(7, sResult.u32Count);
+    TEST_ASSERT(sResult.i32Min == INT32_MIN);
+    TEST_ASSERT(sResult.i32Max == INT32_MAX);
+    TEST_ASSERT(sResult.i64Sum == (int64_t)INT32_MAX * 2 + INT32_MIN + 14);
+}
+
+
+/** Check a downsampled series has the expected number of points, keeps its ends and is in ascending order */
+static int iSelectionValid(const uint32_t *pu32Selected, uint32_t u32Kept, uint32_t u32Count, uint32_t u32Threshold)
+{
+    uint32_t i;
+    
+    if (u32Kept != ((u32Threshold < u32Count) ? u32Threshold : u32Count))
+    {
+        return 0;
+    }
+    if ((u32Kept > 0) && (pu32Selected[0] != 0))
+    {
+        return 0;
+    }
+    if ((u32Kept > 1) && (pu32Selected[u32Kept - 1] != u32Count - 1))
+    {
+        return 0;
+    }
+    for (i = 1; i < u32Kept; i++)
+    {
+        if (pu32Selected[i] <= pu32Selected[i - 1])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+static void vTestLTTBMatchesScalar(void)
+{
+    static const uint32_t au32Thresholds[] = { 0, 2, 3, 10, 199, 200, 1000 };
+    float *pfX = malloc(TEST_MAX_SAMPLES * sizeof(float));
+    float *pfY = malloc(TEST_MAX_SAMPLES * sizeof(float));
+    uint32_t *pu32Vector = malloc(TEST_MAX_SAMPLES * sizeof(uint32_t));
+    uint32_t *pu32Scalar = malloc(TEST_MAX_SAMPLES * sizeof(uint32_t));
+    int iOk = pfX && pfY && pu32Vector && pu32Scalar;
+    uint32_t i, j, k;
+    
+    for (i = 0; iOk && (i < NUM_LENGTHS); i++)
+    {
+        uint32_t u32Count = au32Lengths[i];
+        float fX = 0.0f;
+        
+        /* Unevenly spaced samples of a noisy wave */
+        for (j = 0; j < u32Count; j++)
+        {
+            fX += 1.0f + (float)(u32Rand() % 30);
+            pfX[j] = fX;
+            pfY[j] = 20.0f + 5.0f * sinf(fX / 500.0f) + fRand(1.0f);
+        }
+        
+        for (k = 0; iOk && (k < sizeof(au32Thresholds) / sizeof(au32Thresholds[0])); k++)
+        {
+            uint32_t u32Threshold = au32Thresholds[k];
+            const float *pfXUsed = (k & 1) ? NULL : pfX;
+            uint32_t u32Vector = u32AggregateLTTB(pfXUsed, pfY, u32Count, u32Threshold, pu32Vector);
+            uint32_t u32Scalar = u32AggregateLTTBScalar(pfXUsed, pfY, u32Count, u32Threshold, pu32Scalar);
+            
+            iOk = (u32Vector == u32Scalar) && iSelectionValid(pu32Vector, u32Vector, u32Count, u32Threshold) &&
+                  (memcmp(pu32Vector, pu32Scalar, u32Vector * sizeof(uint32_t)) == 0);
+            if (!iOk)
+            {
+                vTestFail(__FILE__, __LINE__, "%u points to %u%s: kept %u / %u", u32Count, u32Threshold, 
+                          pfXUsed ? "" : " evenly spaced", u32Vector, u32Scalar);
+            }
+        }
+    }
+    free(pfX);
+    free(pfY);
+    free(pu32Vector);
+    free(pu32Scalar);
+}
+
+
+static void vTestLTTBKeepsPeak(void)
+{
+    float afY[101];
+    uint32_t au32Selected[10];
+    uint32_t u32Kept;
+    uint32_t i;
+    
+    /* A flat line with one spike must keep the spike */
+    for (i = 0; i < 101; i++)
+    {
+        afY[i] = (i == 57) ? 100.0f : 1.0f;
+    }
+    u32Kept = u32AggregateLTTB(NULL, afY, 101, 10, au32Selected);
+    TEST_ASSERT_EQUAL_INT(10, u32Kept);
+    for (i = 0; (i < u32Kept) && (au32Selected[i] != 57); i++);
+    TEST_ASSERT(i < u32Kept);
+}
+
+
+const tsTest asTestAggregate[] =
+{
+    TEST(vTestKernelName),
+    TEST(vTestFloatMatchesScalar),
+    TEST(vTestFloatExtremes),
+    TEST(vTestInt32MatchesScalar),
+    TEST(vTestInt32Extremes),
+    TEST(vTestLTTBMatchesScalar),
+    TEST(vTestLTTBKeepsPeak),
+    TEST_END
+};
@@ -0,0 +1,220 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Unit tests of the asset pack
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "AssetPack.h"
+#include "Test.h"
+
+/** Files of the test pack, in path order as asset-pack.py sorts them */
+static const struct
+{
+    const char *pcPath;
+    const char *pcContentType;
+    const char *pcHash;
+    const char *pcData;
+    const char *pcGzip;
+} asFiles[] =
+{
+    { "/index.html",        "text/html",                "0123456789abcdef", "<html></html>",    NULL },
+    { "/js/JIP.js",         "application/javascript",   "fedcba9876543210", "var a = 1;",       "\x1f\x8b-js" },
+    { "/style.css",         "text/css",                 "00112233445566ff", "body {}",          "\x1f\x8b-css" },
+};
+
+#define NUM_FILES (sizeof(asFiles) / sizeof(asFiles[0]))
+
+/** Words of the header and index of the test pack */
+#define PACK_HEADER_WORDS       4
+#define PACK_ENTRY_WORDS        7
+
+
+/** Build the test pack in a buffer, as asset-pack.py would. \return Length */
+static size_t szBuildPack(uint8_t *pu8Pack)
+{
+    uint32_t au32Index[PACK_HEADER_WORDS + (NUM_FILES * PACK_ENTRY_WORDS)];
+    size_t szLength = sizeof(au32Index);
+    uint32_t i, j;
+    
+#define ADD(pc, sz) (memcpy(&pu8Pack[szLength], (pc), (sz)), szLength += (sz), htonl(szLength - (sz)))
+    for (i = 0; i < NUM_FILES; i++)
+    {
+        uint32_t *pu32Entry = &au32Index[PACK_HEADER_WORDS + (i * PACK_ENTRY_WORDS)];
+        
+        pu32Entry[0] = ADD(asFiles[i].pcPath, strlen(asFiles[i].pcPath) + 1);
+        pu32Entry[1] = ADD(asFiles[i].pcContentType, strlen(asFiles[i].pcContentType) + 1);
+        pu32Entry[2] = ADD(asFiles[i].pcHash, strlen(asFiles[i].pcHash) + 1);
+        pu32Entry[3] = ADD(asFiles[i].pcData, strlen(asFiles[i].pcData));
+        pu32Entry[4] = htonl(strlen(asFiles[i].pcData));
+        pu32Entry[5] = asFiles[i].pcGzip ? ADD(asFiles[i].pcGzip, strlen(asFiles[i].pcGzip)) : 0;
+        pu32Entry[6] = htonl(asFiles[i].pcGzip ? strlen(asFiles[i].pcGzip) : 0);
+    }
+#undef ADD
+    
+    memcpy(&au32Index[0], ASSET_PACK_MAGIC, 4);
+    au32Index[1] = htonl(ASSET_PACK_VERSION);
+    au32Index[2] = htonl(NUM_FILES);
+    au32Index[3] = htonl(PACK_HEADER_WORDS * 4);
+    for (j = 0; j < sizeof(au32Index); j++)
+    {
+        pu8Pack[j] = ((uint8_t *)au32Index)[j];
+    }
+    return szLength;
+}
+
+
+/** Write a pack to a temporary file and open it */
+static teAssetPackStatus eOpenPack(tsAssetPack *psPack, const uint8_t *pu8Pack, size_t szLength)
+{
+    char acFileName[] = "/tmp/jip_test_packXXXXXX";
+    teAssetPackStatus eStatus;
+    int iFd;
+    
+    iFd = mkstemp(acFileName);
+    if (iFd < 0)
+    {
+        return E_ASSET_PACK_ERROR;
+    }
+    if (write(iFd, pu8Pack, szLength) != (ssize_t)szLength)
+    {
+        close(iFd);
+        unlink(acFileName);
+        return E_ASSET_PACK_ERROR;
+    }
+    close(iFd);
+    eStatus = eAssetPackOpen(psPack, acFileName);
+    unlink(acFileName);
+    return eStatus;
+}
+
+
+static void vTestLookup(void)
+{
+    uint8_t au8Pack[1024];
+    tsAssetPack sPack;
+    tsAsset sAsset;
+    uint32_t i;
+    
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_OK, eOpenPack(&sPack, au8Pack, szBuildPack(au8Pack)));
+    TEST_ASSERT_EQUAL_INT(NUM_FILES, sPack.u32NumAssets);
+    
+    for (i = 0; i < NUM_FILES; i++)
+    {
+        TEST_ASSERT(iAssetPackLookup(&sPack, asFiles[i].pcPath, &sAsset));
+        TEST_ASSERT_EQUAL_STRING(asFiles[i].pcPath, sAsset.pcPath);
+        TEST_ASSERT_EQUAL_STRING(asFiles[i].pcContentType, sAsset.pcContentType);
+        TEST_ASSERT_EQUAL_STRING(asFiles[i].pcHash, sAsset.pcHash);
+        TEST_ASSERT_EQUAL_INT(strlen(asFiles[i].pcData), sAsset.u32Length);
+        TEST_ASSERT_EQUAL_MEMORY(asFiles[i].pcData, sAsset.pu8Data, sAsset.u32Length);
+        if (asFiles[i].pcGzip)
+        {
+            TEST_ASSERT(sAsset.pu8Gzip != NULL);
+            TEST_ASSERT_EQUAL_INT(strlen(asFiles[i].pcGzip), sAsset.u32GzipLength);
+            TEST_ASSERT_EQUAL_MEMORY(asFiles[i].pcGzip, sAsset.pu8Gzip, sAsset.u32GzipLength);
+        }
+        else
+        {
+            TEST_ASSERT(sAsset.pu8Gzip == NULL);
+        }
+    }
+    
+    TEST_ASSERT(!iAssetPackLookup(&sPack, "/", &sAsset));
+    TEST_ASSERT(!iAssetPackLookup(&sPack, "/js", &sAsset));
+    TEST_ASSERT(!iAssetPackLookup(&sPack, "/style.css/", &sAsset));
+    TEST_ASSERT(!iAssetPackLookup(&sPack, "/zzz", &sAsset));
+    vAssetPackClose(&sPack);
+}
+
+
+static void vTestInvalid(void)
+{
+    uint8_t au8Pack[1024];
+    uint8_t au8Bad[1024];
+    tsAssetPack sPack;
+    size_t szLength = szBuildPack(au8Pack);
+    uint32_t u32Word;
+    
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_ERROR, eAssetPackOpen(&sPack, "/nonexistent/www.pack"));
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Pack, 8));
+    
+    /* Magic and version */
+    memcpy(au8Bad, au8Pack, szLength);
+    au8Bad[0] = 'X';
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Bad, szLength));
+    memcpy(au8Bad, au8Pack, szLength);
+    u32Word = htonl(ASSET_PACK_VERSION + 1);
+    memcpy(&au8Bad[4], &u32Word, 4);
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Bad, szLength));
+    
+    /* More files than the pack holds */
+    memcpy(au8Bad, au8Pack, szLength);
+    u32Word = htonl(1000);
+    memcpy(&au8Bad[8], &u32Word, 4);
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Bad, szLength));
+    
+    /* Content running past the end */
+    memcpy(au8Bad, au8Pack, szLength);
+    u32Word = htonl(szLength);
+    memcpy(&au8Bad[(PACK_HEADER_WORDS + 4) * 4], &u32Word, 4);
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Bad, szLength));
+    
+    /* A path that is not terminated within the pack */
+    memcpy(au8Bad, au8Pack, szLength);
+    u32Word = htonl(szLength - 1);
+    memcpy(&au8Bad[PACK_HEADER_WORDS * 4], &u32Word, 4);
+    au8Bad[szLength - 1] = 'x';
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Bad, szLength));
+    
+    /* Files out of order */
+    memcpy(au8Bad, au8Pack, szLength);
+    memcpy(&au8Bad[PACK_HEADER_WORDS * 4], &au8Pack[(PACK_HEADER_WORDS + PACK_ENTRY_WORDS) * 4], PACK_ENTRY_WORDS * 4);
+    memcpy(&au8Bad[(PACK_HEADER_WORDS + PACK_ENTRY_WORDS) * 4], &au8Pack[PACK_HEADER_WORDS * 4], PACK_ENTRY_WORDS * 4);
+    TEST_ASSERT_EQUAL_INT(E_ASSET_PACK_INVALID, eOpenPack(&sPack, au8Bad, szLength));
+}
+
+
+const tsTest asTestAssetPack[] =
+{
+    TEST(vTestLookup),
+    TEST(vTestInvalid),
+    TEST_END
+};
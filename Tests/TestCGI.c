@@ -0,0 +1,295 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Tests of the CGI module
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Alloc.h"
+#include "CGI.h"
+#include "Test.h"
+
+
+/** Set up the environment of a GET request */
+static void vGet(const char *pcQueryString)
+{
+    unsetenv("CONTENT_TYPE");
+    unsetenv("CONTENT_LENGTH");
+    setenv("REQUEST_METHOD", "GET", 1);
+    if (pcQueryString)
+    {
+        setenv("QUERY_STRING", pcQueryString, 1);
+    }
+    else
+    {
+        unsetenv("QUERY_STRING");
+    }
+}
+
+
+/** Set up the environment and stdin of a POST request */
+static int iPost(const char *pcBody)
+{
+    char acFileName[] = "/tmp/jip_test_postXXXXXX";
+    char acLength[16];
+    int iFd;
+    
+    iFd = mkstemp(acFileName);
+    if (iFd < 0)
+    {
+        return 0;
+    }
+    if (write(iFd, pcBody, strlen(pcBody)) != (ssize_t)strlen(pcBody))
+    {
+        close(iFd);
+        unlink(acFileName);
+        return 0;
+    }
+    close(iFd);
+    
+    if (!freopen(acFileName, "r", stdin))
+    {
+        unlink(acFileName);
+        return 0;
+    }
+    unlink(acFileName);
+    
+    snprintf(acLength, sizeof(acLength), "%u", (unsigned int)strlen(pcBody));
+    unsetenv("CONTENT_TYPE");
+    unsetenv("QUERY_STRING");
+    setenv("REQUEST_METHOD", "POST", 1);
+    setenv("CONTENT_LENGTH", acLength, 1);
+    return 1;
+}
+
+
+static void vTestGetPairs(void)
+{
+    tsCGI sCGI;
+    
+    vGet("action=getVersion&BRaddress=fd04%3Abd3%3A%3A1&x=1;y=2");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIReadVariables(&sCGI));
+    TEST_ASSERT_EQUAL_INT(4, sCGI.iNumVars);
+    TEST_ASSERT_EQUAL_STRING("getVersion", pcCGIGetValue(&sCGI, "action"));
+    TEST_ASSERT_EQUAL_STRING("fd04:bd3::1", pcCGIGetValue(&sCGI, "BRaddress"));
+    TEST_ASSERT_EQUAL_STRING("1", pcCGIGetValue(&sCGI, "x"));
+    TEST_ASSERT_EQUAL_STRING("2", pcCGIGetValue(&sCGI, "y"));
+    TEST_ASSERT(pcCGIGetValue(&sCGI, "z") == NULL);
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestGetMalformedPairs(void)
+{
+    tsCGI sCGI;
+    
+    /* Pairs without a value, or without '=', are dropped */
+    vGet("empty=&noequals&a=1&&b=2&");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIReadVariables(&sCGI));
+    TEST_ASSERT_EQUAL_INT(2, sCGI.iNumVars);
+    TEST_ASSERT(pcCGIGetValue(&sCGI, "empty") == NULL);
+    TEST_ASSERT(pcCGIGetValue(&sCGI, "noequals") == NULL);
+    TEST_ASSERT_EQUAL_STRING("1", pcCGIGetValue(&sCGI, "a"));
+    TEST_ASSERT_EQUAL_STRING("2", pcCGIGetValue(&sCGI, "b"));
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestGetNoQuery(void)
+{
+    tsCGI sCGI;
+    
+    vGet(NULL);
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIReadVariables(&sCGI));
+    TEST_ASSERT_EQUAL_INT(0, sCGI.iNumVars);
+    TEST_ASSERT(pcCGIGetValue(&sCGI, "action") == NULL);
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestPost(void)
+{
+    tsCGI sCGI;
+    
+    TEST_ASSERT(iPost("action=SetVar&value=Living%20room&mib=Node"));
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIReadVariables(&sCGI));
+    TEST_ASSERT_EQUAL_INT(3, sCGI.iNumVars);
+    TEST_ASSERT_EQUAL_STRING("SetVar", pcCGIGetValue(&sCGI, "action"));
+    TEST_ASSERT_EQUAL_STRING("Living room", pcCGIGetValue(&sCGI, "value"));
+    TEST_ASSERT_EQUAL_STRING("Node", pcCGIGetValue(&sCGI, "mib"));
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestPostNoLength(void)
+{
+    tsCGI sCGI;
+    
+    TEST_ASSERT(iPost("action=SetVar"));
+    unsetenv("CONTENT_LENGTH");
+    TEST_ASSERT_EQUAL_INT(E_CGI_INVALID_PARAMS, eCGIReadVariables(&sCGI));
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestUnknownMethod(void)
+{
+    tsCGI sCGI;
+    
+    vGet("action=getVersion");
+    setenv("REQUEST_METHOD", "PUT", 1);
+    TEST_ASSERT_EQUAL_INT(E_CGI_INVALID_PARAMS, eCGIReadVariables(&sCGI));
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestManyVars(void)
+{
+    char acQuery[256 * 16];
+    size_t szPos = 0;
+    uint64_t u64Allocs;
+    tsCGI sCGI;
+    int i;
+    
+    for (i = 0; i < 256; i++)
+    {
+        szPos += sprintf(&acQuery[szPos], "%svar%d=%d", i ? "&" : "", i, i);
+    }
+    vGet(acQuery);
+    
+    u64Allocs = u64AllocCount();
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIReadVariables(&sCGI));
+    
+    /* Everything comes from the request's arena */
+    TEST_ASSERT(u64AllocCount() - u64Allocs <= 2);
+    TEST_ASSERT_EQUAL_INT(256, sCGI.iNumVars);
+    TEST_ASSERT_EQUAL_STRING("0", pcCGIGetValue(&sCGI, "var0"));
+    TEST_ASSERT_EQUAL_STRING("128", pcCGIGetValue(&sCGI, "var128"));
+    TEST_ASSERT_EQUAL_STRING("255", pcCGIGetValue(&sCGI, "var255"));
+    TEST_ASSERT(pcCGIGetValue(&sCGI, "var256") == NULL);
+    TEST_ASSERT(pcCGIGetValue(&sCGI, "var") == NULL);
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestDuplicateVars(void)
+{
+    tsCGI sCGI;
+    
+    /* The first occurrence wins */
+    vGet("mode=first&mode=second");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIReadVariables(&sCGI));
+    TEST_ASSERT_EQUAL_STRING("first", pcCGIGetValue(&sCGI, "mode"));
+    vCGIFree(&sCGI);
+}
+
+
+static void vTestURLEncode(void)
+{
+    tsArena sArena;
+    char *pcOutput;
+    
+    vArenaInit(&sArena);
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLEncode(&sArena, &pcOutput, "fd04:bd3::1/64?a=b&c;d@e"));
+    TEST_ASSERT_EQUAL_STRING("fd04%3Abd3%3A%3A1%2F64%3Fa%3Db%26c%3Bd%40e", pcOutput);
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLEncode(&sArena, &pcOutput, "Plain text"));
+    TEST_ASSERT_EQUAL_STRING("Plain text", pcOutput);
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLEncode(&sArena, &pcOutput, ""));
+    TEST_ASSERT_EQUAL_STRING("", pcOutput);
+    vArenaFree(&sArena);
+    
+    /* Without an arena the output is malloc'd */
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLEncode(NULL, &pcOutput, "a&b"));
+    TEST_ASSERT_EQUAL_STRING("a%26b", pcOutput);
+    free(pcOutput);
+}
+
+
+static void vTestURLDecode(void)
+{
+    char acBuffer[64];
+    
+    strcpy(acBuffer, "%41%42c%2fd%2Fe");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLDecode(acBuffer));
+    TEST_ASSERT_EQUAL_STRING("ABc/d/e", acBuffer);
+    
+    strcpy(acBuffer, "no escapes");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLDecode(acBuffer));
+    TEST_ASSERT_EQUAL_STRING("no escapes", acBuffer);
+    
+    /* A '%' not followed by two hex digits is kept as it is */
+    strcpy(acBuffer, "100%");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLDecode(acBuffer));
+    TEST_ASSERT_EQUAL_STRING("100%", acBuffer);
+    
+    strcpy(acBuffer, "50%zz%4");
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLDecode(acBuffer));
+    TEST_ASSERT_EQUAL_STRING("50%zz%4", acBuffer);
+}
+
+
+static void vTestURLRoundTrip(void)
+{
+    const char *pcInput = "scene=Evening;level=50&hops=2 @ fd04::1/64?x";
+    char *pcOutput;
+    
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLEncode(NULL, &pcOutput, pcInput));
+    TEST_ASSERT(strpbrk(pcOutput, ";/?:@&=") == NULL);
+    TEST_ASSERT_EQUAL_INT(E_CGI_OK, eCGIURLDecode(pcOutput));
+    TEST_ASSERT_EQUAL_STRING(pcInput, pcOutput);
+    free(pcOutput);
+}
+
+
+const tsTest asTestCGI[] =
+{
+    TEST(vTestGetPairs),
+    TEST(vTestGetMalformedPairs),
+    TEST(vTestGetNoQuery),
+    TEST(vTestPost),
+    TEST(vTestPostNoLength),
+    TEST(vTestUnknownMethod),
+    TEST(vTestManyVars),
+    TEST(vTestDuplicateVars),
+    TEST(vTestURLEncode),
+    TEST(vTestURLDecode),
+    TEST(vTestURLRoundTrip),
+    TEST_END
+};
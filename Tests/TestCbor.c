@@ -0,0 +1,253 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Tests of the CBOR encoder
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Cbor.h"
+#include "Test.h"
+
+
+/** Check the encoder holds exactly the expected bytes, then empty it */
+#define TEST_ASSERT_ENCODED(psCbor, ...) \
+    do { \
+        static const uint8_t au8Expected[] = { __VA_ARGS__ }; \
+        TEST_ASSERT_EQUAL_INT(E_CBOR_OK, (psCbor)->eStatus); \
+        TEST_ASSERT_EQUAL_INT(sizeof(au8Expected), (psCbor)->szLength); \
+        TEST_ASSERT_EQUAL_MEMORY(au8Expected, (psCbor)->pu8Buffer, sizeof(au8Expected)); \
+        (psCbor)->szLength = 0; \
+    } while (0)
+
+
+/* Expected encodings are the examples of RFC 7049 appendix A */
+
+static void vTestUnsigned(void)
+{
+    tsCbor sCbor;
+    
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, eCborInit(&sCbor));
+    eCborUint(&sCbor, 0);
+    TEST_ASSERT_ENCODED(&sCbor, 0x00);
+    eCborUint(&sCbor, 23);
+    TEST_ASSERT_ENCODED(&sCbor, 0x17);
+    eCborUint(&sCbor, 24);
+    TEST_ASSERT_ENCODED(&sCbor, 0x18, 0x18);
+    eCborUint(&sCbor, 100);
+    TEST_ASSERT_ENCODED(&sCbor, 0x18, 0x64);
+    eCborUint(&sCbor, 1000);
+    TEST_ASSERT_ENCODED(&sCbor, 0x19, 0x03, 0xe8);
+    eCborUint(&sCbor, 1000000);
+    TEST_ASSERT_ENCODED(&sCbor, 0x1a, 0x00, 0x0f, 0x42, 0x40);
+    eCborUint(&sCbor, 1000000000000ULL);
+    TEST_ASSERT_ENCODED(&sCbor, 0x1b, 0x00, 0x00, 0x00, 0xe8, 0xd4, 0xa5, 0x10, 0x00);
+    eCborUint(&sCbor, UINT64_MAX);
+    TEST_ASSERT_ENCODED(&sCbor, 0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff);
+    vCborFree(&sCbor);
+}
+
+
+static void vTestSigned(void)
+{
+    tsCbor sCbor;
+    
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, eCborInit(&sCbor));
+    eCborInt(&sCbor, 10);
+    TEST_ASSERT_ENCODED(&sCbor, 0x0a);
+    eCborInt(&sCbor, -1);
+    TEST_ASSERT_ENCODED(&sCbor, 0x20);
+    eCborInt(&sCbor, -10);
+    TEST_ASSERT_ENCODED(&sCbor, 0x29);
+    eCborInt(&sCbor, -100);
+    TEST_ASSERT_ENCODED(&sCbor, 0x38, 0x63);
+    eCborInt(&sCbor, -1000);
+    TEST_ASSERT_ENCODED(&sCbor, 0x39, 0x03, 0xe7);
+    eCborInt(&sCbor, INT64_MIN);
+    TEST_ASSERT_ENCODED(&sCbor, 0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff);
+    vCborFree(&sCbor);
+}
+
+
+static void vTestFloat(void)
+{
+    tsCbor sCbor;
+    
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, eCborInit(&sCbor));
+    /* Exact in single precision */
+    eCborFloat(&sCbor, 100000.0);
+    TEST_ASSERT_ENCODED(&sCbor, 0xfa, 0x47, 0xc3, 0x50, 0x00);
+    eCborFloat(&sCbor, 1.5);
+    TEST_ASSERT_ENCODED(&sCbor, 0xfa, 0x3f, 0xc0, 0x00, 0x00);
+    /* Needs double precision */
+    eCborFloat(&sCbor, 1.1);
+    TEST_ASSERT_ENCODED(&sCbor, 0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a);
+    eCborFloat(&sCbor, -4.1);
+    TEST_ASSERT_ENCODED(&sCbor, 0xfb, 0xc0, 0x10, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66);
+    eCborFloat(&sCbor, NAN);
+    TEST_ASSERT_ENCODED(&sCbor, 0xf9, 0x7e, 0x00);
+    /* Beyond the range of a float */
+    eCborFloat(&sCbor, 1e300);
+    TEST_ASSERT_ENCODED(&sCbor, 0xfb, 0x7e, 0x37, 0xe4, 0x3c, 0x88, 0x00, 0x75, 0x9c);
+    eCborFloat(&sCbor, INFINITY);
+    TEST_ASSERT_ENCODED(&sCbor, 0xfa, 0x7f, 0x80, 0x00, 0x00);
+    vCborFree(&sCbor);
+}
+
+
+static void vTestStrings(void)
+{
+    static const uint8_t au8Data[] = { 0x01, 0x02, 0x03, 0x04 };
+    char acLong[300];
+    tsCbor sCbor;
+    
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, eCborInit(&sCbor));
+    eCborText(&sCbor, "", 0);
+    TEST_ASSERT_ENCODED(&sCbor, 0x60);
+    eCborText(&sCbor, "IETF", 4);
+    TEST_ASSERT_ENCODED(&sCbor, 0x64, 0x49, 0x45, 0x54, 0x46);
+    eCborText(&sCbor, "\xc3\xbc", 2);
+    TEST_ASSERT_ENCODED(&sCbor, 0x62, 0xc3, 0xbc);
+    eCborBytes(&sCbor, au8Data, sizeof(au8Data));
+    TEST_ASSERT_ENCODED(&sCbor, 0x44, 0x01, 0x02, 0x03, 0x04);
+    
+    /* Long enough to need a two byte length, and to grow the buffer */
+    memset(acLong, 'x', sizeof(acLong));
+    eCborText(&sCbor, acLong, sizeof(acLong));
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, sCbor.eStatus);
+    TEST_ASSERT_EQUAL_INT(3 + sizeof(acLong), sCbor.szLength);
+    TEST_ASSERT_EQUAL_MEMORY("\x79\x01\x2c", sCbor.pu8Buffer, 3);
+    TEST_ASSERT_EQUAL_MEMORY(acLong, sCbor.pu8Buffer + 3, sizeof(acLong));
+    vCborFree(&sCbor);
+}
+
+
+static void vTestContainers(void)
+{
+    tsCbor sCbor;
+    uint32_t i;
+    
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, eCborInit(&sCbor));
+    
+    /* [1, [2, 3], [4, 5]] */
+    eCborArray(&sCbor, 3);
+    eCborUint(&sCbor, 1);
+    eCborArray(&sCbor, 2);
+    eCborUint(&sCbor, 2);
+    eCborUint(&sCbor, 3);
+    eCborArray(&sCbor, 2);
+    eCborUint(&sCbor, 4);
+    eCborUint(&sCbor, 5);
+    TEST_ASSERT_ENCODED(&sCbor, 0x83, 0x01, 0x82, 0x02, 0x03, 0x82, 0x04, 0x05);
+    
+    /* {"a": 1, "b": [2, 3]} */
+    eCborMap(&sCbor, 2);
+    eCborText(&sCbor, "a", 1);
+    eCborUint(&sCbor, 1);
+    eCborText(&sCbor, "b", 1);
+    eCborArray(&sCbor, 2);
+    eCborUint(&sCbor, 2);
+    eCborUint(&sCbor, 3);
+    TEST_ASSERT_ENCODED(&sCbor, 0xa2, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02, 0x03);
+    
+    /* Array of 25 needs a one byte length */
+    eCborArray(&sCbor, 25);
+    for (i = 1; i <= 25; i++)
+    {
+        eCborUint(&sCbor, i);
+    }
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, sCbor.eStatus);
+    TEST_ASSERT_EQUAL_INT(2 + 23 + 2 * 2, sCbor.szLength);
+    TEST_ASSERT_EQUAL_MEMORY("\x98\x19\x01", sCbor.pu8Buffer, 3);
+    sCbor.szLength = 0;
+    
+    eCborSimple(&sCbor, CBOR_FALSE);
+    eCborSimple(&sCbor, CBOR_TRUE);
+    eCborSimple(&sCbor, CBOR_NULL);
+    TEST_ASSERT_ENCODED(&sCbor, 0xf4, 0xf5, 0xf6);
+    vCborFree(&sCbor);
+}
+
+
+static void vTestEncodeJson(void)
+{
+    struct json_object *psRoot = json_object_new_object();
+    struct json_object *psArray = json_object_new_array();
+    struct json_object *psData = json_object_new_string_len("\x00\xff", 2);
+    struct json_object *psText = json_object_new_string("ok");
+    struct json_object *psUint = json_object_new_string("18446744073709551615");
+    tsCbor sCbor;
+    
+    TEST_ASSERT(psRoot && psArray && psData && psText && psUint);
+    json_object_array_add(psArray, json_object_new_int(-2));
+    json_object_array_add(psArray, json_object_new_double(0.5));
+    json_object_array_add(psArray, json_object_new_boolean(1));
+    json_object_array_add(psArray, NULL);
+    json_object_array_add(psArray, psData);
+    json_object_array_add(psArray, psText);
+    json_object_array_add(psArray, psUint);
+    json_object_object_add(psRoot, "Data", psArray);
+    
+    TEST_ASSERT_EQUAL_INT(E_CBOR_OK, eCborInit(&sCbor));
+    eCborMarkBytes(&sCbor, psData);
+    eCborMarkUint(&sCbor, psUint);
+    eCborEncodeJson(&sCbor, psRoot);
+    json_object_put(psRoot);
+    
+    /* {"Data": [-2, 0.5, true, null, h'00ff', "ok", 18446744073709551615]} */
+    TEST_ASSERT_ENCODED(&sCbor, 0xa1, 0x64, 'D', 'a', 't', 'a', 0x87, 0x21, 0xfa, 0x3f, 0x00, 0x00, 0x00, 
+                                0xf5, 0xf6, 0x42, 0x00, 0xff, 0x62, 'o', 'k',
+                                0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff);
+    
+    eCborEncodeJson(&sCbor, NULL);
+    TEST_ASSERT_ENCODED(&sCbor, 0xf6);
+    vCborFree(&sCbor);
+}
+
+
+const tsTest asTestCbor[] =
+{
+    TEST(vTestUnsigned),
+    TEST(vTestSigned),
+    TEST(vTestFloat),
+    TEST(vTestStrings),
+    TEST(vTestContainers),
+    TEST(vTestEncodeJson),
+    TEST_END
+};
@@ -0,0 +1,298 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Tests of the value codec
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <JIP.h>
+
+#include "Alloc.h"
+#include "Codec.h"
+#include "Test.h"
+
+
+static void vTestParseIntegers(void)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    tsArena sArena;
+    
+    vArenaInit(&sArena);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_UINT8, "200", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(1, u32Size);
+    TEST_ASSERT_EQUAL_INT(200, *(uint8_t *)pvBuffer);
+    
+    /* Negative values wrap to the variable's width */
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_INT8, "-1", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(-1, *(int8_t *)pvBuffer);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_UINT16, "0x1234", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(2, u32Size);
+    TEST_ASSERT_EQUAL_INT(0x1234, *(uint16_t *)pvBuffer);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_INT32, "0755", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(4, u32Size);
+    TEST_ASSERT_EQUAL_INT(0755, *(int32_t *)pvBuffer);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_UINT64, "18446744073709551615", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(8, u32Size);
+    TEST_ASSERT(*(uint64_t *)pvBuffer == UINT64_MAX);
+    
+    vArenaFree(&sArena);
+}
+
+
+static void vTestParseOutOfRange(void)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_BAD_VALUE, eCodecParseValue(NULL, E_JIP_VAR_TYPE_UINT64, "99999999999999999999", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT(pvBuffer == NULL);
+    TEST_ASSERT_EQUAL_STRING("Could not convert string to 64 bit integer", pcError);
+}
+
+
+static void vTestParseFloats(void)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(NULL, E_JIP_VAR_TYPE_FLT, "21.5", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(sizeof(float), u32Size);
+    TEST_ASSERT_FLOAT_WITHIN(0.0, 21.5, *(float *)pvBuffer);
+    free(pvBuffer);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(NULL, E_JIP_VAR_TYPE_DBL, "-1.25e3", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(sizeof(double), u32Size);
+    TEST_ASSERT_FLOAT_WITHIN(0.0, -1250.0, *(double *)pvBuffer);
+    free(pvBuffer);
+}
+
+
+static void vTestParseString(void)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(NULL, E_JIP_VAR_TYPE_STR, "Living room", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(11, u32Size);
+    TEST_ASSERT_EQUAL_STRING("Living room", pvBuffer);
+    free(pvBuffer);
+}
+
+
+static void vTestParseBlob(void)
+{
+    static const uint8_t au8Expected[] = { 0x01, 0xAB, 0xCD, 0xEF };
+    static const uint8_t au8Odd[] = { 0x12, 0x30 };
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    tsArena sArena;
+    
+    vArenaInit(&sArena);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_BLOB, "0x01abCDef", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(4, u32Size);
+    TEST_ASSERT_EQUAL_MEMORY(au8Expected, pvBuffer, 4);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_BLOB, "01ABCDEF", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(4, u32Size);
+    TEST_ASSERT_EQUAL_MEMORY(au8Expected, pvBuffer, 4);
+    
+    /* An odd number of digits leaves the low nibble of the last byte clear */
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_BLOB, "123", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(2, u32Size);
+    TEST_ASSERT_EQUAL_MEMORY(au8Odd, pvBuffer, 2);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_BAD_VALUE, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_BLOB, "0x12G4", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_STRING("String contains illegal hexadecimal characters", pcError);
+    
+    vArenaFree(&sArena);
+}
+
+
+static void vTestParseUnsupported(void)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_UNSUPPORTED, eCodecParseValue(NULL, E_JIP_VAR_TYPE_TABLE_BLOB, "00", &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT(pvBuffer == NULL);
+}
+
+
+static void vTestParseArenaAllocations(void)
+{
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    uint64_t u64Allocs;
+    tsArena sArena;
+    int i;
+    
+    /* Values parsed into an arena share its blocks */
+    vArenaInit(&sArena);
+    u64Allocs = u64AllocCount();
+    for (i = 0; i < 64; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_UINT32, "12345", &pvBuffer, &u32Size, &pcError));
+    }
+    TEST_ASSERT(u64AllocCount() - u64Allocs <= 1);
+    vArenaFree(&sArena);
+}
+
+
+static void vTestFormatBlob(void)
+{
+    static const uint8_t au8Data[] = { 0x00, 0x7F, 0x80, 0xFF, 0x0A };
+    char *pcText;
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecFormatBlob(NULL, au8Data, sizeof(au8Data), &pcText));
+    TEST_ASSERT_EQUAL_STRING("0x007f80ff0a", pcText);
+    free(pcText);
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecFormatBlob(NULL, au8Data, 0, &pcText));
+    TEST_ASSERT_EQUAL_STRING("0x", pcText);
+    free(pcText);
+}
+
+
+static void vTestFormatBlobRoundTrip(void)
+{
+    uint8_t au8Data[300];
+    const char *pcError;
+    uint32_t u32Size;
+    void *pvBuffer;
+    char *pcText;
+    tsArena sArena;
+    uint32_t i;
+    
+    /* Longer than the 255 byte buffer the encoder once used */
+    for (i = 0; i < sizeof(au8Data); i++)
+    {
+        au8Data[i] = (uint8_t)(i * 37);
+    }
+    
+    vArenaInit(&sArena);
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecFormatBlob(&sArena, au8Data, sizeof(au8Data), &pcText));
+    TEST_ASSERT_EQUAL_INT(2 + 2 * sizeof(au8Data), strlen(pcText));
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecParseValue(&sArena, E_JIP_VAR_TYPE_BLOB, pcText, &pvBuffer, &u32Size, &pcError));
+    TEST_ASSERT_EQUAL_INT(sizeof(au8Data), u32Size);
+    TEST_ASSERT_EQUAL_MEMORY(au8Data, pvBuffer, sizeof(au8Data));
+    vArenaFree(&sArena);
+}
+
+
+static void vTestFormatTable(void)
+{
+    uint8_t au8Row0[] = { 0x01, 0x02 };
+    uint8_t au8Row2[] = { 0xAB };
+    tsTableRow asRows[3];
+    tsTable sTable;
+    char *pcText;
+    
+    memset(asRows, 0, sizeof(asRows));
+    asRows[0].pvData = au8Row0;
+    asRows[0].u32Length = sizeof(au8Row0);
+    asRows[2].pvData = au8Row2;
+    asRows[2].u32Length = sizeof(au8Row2);
+    sTable.psRows = asRows;
+    sTable.u32NumRows = 3;
+    
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecFormatTable(NULL, &sTable, &pcText));
+    TEST_ASSERT_EQUAL_STRING("000 { 0x0102 }\n001 { Empty Row }002 { 0xab }\n", pcText);
+    free(pcText);
+    
+    sTable.u32NumRows = 0;
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecFormatTable(NULL, &sTable, &pcText));
+    TEST_ASSERT_EQUAL_STRING("Empty Table", pcText);
+    free(pcText);
+}
+
+
+static void vTestFormatLargeTable(void)
+{
+    static uint8_t au8Data[64];
+    tsTableRow asRows[1200];
+    tsTable sTable;
+    char *pcText;
+    tsArena sArena;
+    int i;
+    
+    /* Row numbers of four digits still fit the space allowed per row */
+    for (i = 0; i < 1200; i++)
+    {
+        asRows[i].pvData = (i % 7) ? au8Data : NULL;
+        asRows[i].u32Length = (i % 7) ? sizeof(au8Data) : 0;
+    }
+    sTable.psRows = asRows;
+    sTable.u32NumRows = 1200;
+    
+    vArenaInit(&sArena);
+    TEST_ASSERT_EQUAL_INT(E_CODEC_OK, eCodecFormatTable(&sArena, &sTable, &pcText));
+    TEST_ASSERT(strncmp(pcText, "000 { Empty Row }001 { 0x0000", 29) == 0);
+    TEST_ASSERT(strstr(pcText, "1199 { 0x") != NULL);
+    vArenaFree(&sArena);
+}
+
+
+const tsTest asTestCodec[] =
+{
+    TEST(vTestParseIntegers),
+    TEST(vTestParseOutOfRange),
+    TEST(vTestParseFloats),
+    TEST(vTestParseString),
+    TEST(vTestParseBlob),
+    TEST(vTestParseUnsupported),
+    TEST(vTestParseArenaAllocations),
+    TEST(vTestFormatBlob),
+    TEST(vTestFormatBlobRoundTrip),
+    TEST(vTestFormatTable),
+    TEST(vTestFormatLargeTable),
+    TEST_END
+};
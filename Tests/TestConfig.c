@@ -0,0 +1,340 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Tests of the SmartDevices configuration
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "SmartDevicesConfig.h"
+#include "Test.h"
+
+/** Device entries in the generated configuration */
+#define TEST_NUM_DEVICES        5000
+
+/** Device entries matched by base type, after those matched by ID */
+#define TEST_NUM_BASETYPES      300
+
+
+/** Device entry as written to the generated configuration */
+typedef struct
+{
+    int         iBaseType;          /**< Set if matched by base type */
+    uint32_t    u32Key;             /**< Device ID, or base type */
+} tsTestDevice;
+
+static tsTestDevice asDevices[TEST_NUM_DEVICES + TEST_NUM_BASETYPES];
+
+
+/** Device ID of the i'th ID entry. Every 97th repeats an earlier ID */
+static uint32_t u32DeviceId(int i)
+{
+    if ((i > 0) && ((i % 97) == 0))
+    {
+        i /= 2;
+    }
+    return 0x80000000 | ((uint32_t)i << 8) | (uint32_t)(i * 7 & 0xFF);
+}
+
+
+/** Write a configuration with thousands of device entries */
+static int iWriteConfig(const char *pcFileName)
+{
+    FILE *psFile;
+    int i;
+    
+    psFile = fopen(pcFileName, "w");
+    if (!psFile)
+    {
+        return 0;
+    }
+    fprintf(psFile, "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n");
+    fprintf(psFile, "<SmartDevicesCgiConfig Version=\"1\">\n");
+    
+    for (i = 0; i < TEST_NUM_DEVICES; i++)
+    {
+        asDevices[i].iBaseType = 0;
+        asDevices[i].u32Key = u32DeviceId(i);
+        fprintf(psFile, "  <Device ID=\"0x%08x\" Name=\"Device %d\">\n", asDevices[i].u32Key, i);
+        fprintf(psFile, "    <StateControl MiB=\"BulbControl\" Var=\"Mode\"/>\n");
+        fprintf(psFile, "  </Device>\n");
+    }
+    
+    /* Base types cycle, so later entries repeat earlier ones */
+    for (i = 0; i < TEST_NUM_BASETYPES; i++)
+    {
+        asDevices[TEST_NUM_DEVICES + i].iBaseType = 1;
+        asDevices[TEST_NUM_DEVICES + i].u32Key = (i * 3) & 0xFF;
+        fprintf(psFile, "  <Device BaseType=\"0x%02x\" Name=\"Device %d\">\n", 
+                asDevices[TEST_NUM_DEVICES + i].u32Key, TEST_NUM_DEVICES + i);
+        fprintf(psFile, "  </Device>\n");
+    }
+    fprintf(psFile, "</SmartDevicesCgiConfig>\n");
+    return fclose(psFile) == 0;
+}
+
+
+/** Reference lookup: first entry with the device ID in file order, 
+ *  then first entry with the base type. \return Index of the entry, or -1 */
+static int iReferenceLookup(uint32_t u32Id)
+{
+    int i;
+    
+    for (i = 0; i < TEST_NUM_DEVICES + TEST_NUM_BASETYPES; i++)
+    {
+        if (!asDevices[i].iBaseType && (asDevices[i].u32Key == u32Id))
+        {
+            return i;
+        }
+    }
+    for (i = 0; i < TEST_NUM_DEVICES + TEST_NUM_BASETYPES; i++)
+    {
+        if (asDevices[i].iBaseType && (asDevices[i].u32Key == (u32Id & 0xFF)))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/** Check the entry found for a device ID against the reference lookup */
+static int iLookupMatches(const tsConfig *psConfig, uint32_t u32Id)
+{
+    const tsConfigDevice *psDevice = psConfigLookupDevice(psConfig, u32Id);
+    int iExpected = iReferenceLookup(u32Id);
+    char acName[32];
+    
+    if (iExpected < 0)
+    {
+        return psDevice == NULL;
+    }
+    snprintf(acName, sizeof(acName), "Device %d", iExpected);
+    return psDevice && (strcmp(pcConfigString(psConfig, psDevice->u32Name), acName) == 0);
+}
+
+
+static void vTestLookupThousands(void)
+{
+    char acFileName[] = "/tmp/jip_test_configXXXXXX";
+    char acImageFileName[sizeof(acFileName) + 4];
+    tsConfig sConfig;
+    uint32_t u32Random = 12345;
+    int iFd;
+    int iOk = 1;
+    int i;
+    
+    iFd = mkstemp(acFileName);
+    TEST_ASSERT(iFd >= 0);
+    close(iFd);
+    snprintf(acImageFileName, sizeof(acImageFileName), "%s.bin", acFileName);
+    
+    TEST_ASSERT(iWriteConfig(acFileName));
+    iOk = (eConfigLoad(&sConfig, acFileName, acImageFileName) == E_CONFIG_OK);
+    unlink(acFileName);
+    unlink(acImageFileName);
+    TEST_ASSERT(iOk);
+    TEST_ASSERT_EQUAL_INT(TEST_NUM_DEVICES + TEST_NUM_BASETYPES, sConfig.psHeader->u32NumDevices);
+    
+    /* Every configured ID, including the repeated ones */
+    for (i = 0; iOk && (i < TEST_NUM_DEVICES); i++)
+    {
+        iOk = iLookupMatches(&sConfig, u32DeviceId(i));
+    }
+    
+    /* Unknown IDs, falling back to a base type or to nothing */
+    for (i = 0; iOk && (i < 20000); i++)
+    {
+        u32Random = u32Random * 1103515245 + 12345;
+        iOk = iLookupMatches(&sConfig, u32Random);
+    }
+    
+    vConfigUnload(&sConfig);
+    TEST_ASSERT(iOk);
+}
+
+
+static void vTestLookupPrecedence(void)
+{
+    char acFileName[] = "/tmp/jip_test_configXXXXXX";
+    char acImageFileName[sizeof(acFileName) + 4];
+    const tsConfigDevice *psDevice;
+    tsConfig sConfig;
+    FILE *psFile;
+    int iFd;
+    int iOk;
+    
+    iFd = mkstemp(acFileName);
+    TEST_ASSERT(iFd >= 0);
+    psFile = fdopen(iFd, "w");
+    TEST_ASSERT(psFile != NULL);
+    fprintf(psFile, 
+        "<SmartDevicesCgiConfig Version=\"1\">\n"
+        "  <Device BaseType=\"0xE1\" Name=\"Dimmable\"/>\n"
+        "  <Device ID=\"0x80821CE1\" Name=\"Lamp\"/>\n"
+        "  <Device ID=\"0x80821CE1\" Name=\"Lamp again\"/>\n"
+        "  <Device BaseType=\"0xE1\" Name=\"Dimmable again\"/>\n"
+        "</SmartDevicesCgiConfig>\n");
+    fclose(psFile);
+    snprintf(acImageFileName, sizeof(acImageFileName), "%s.bin", acFileName);
+    
+    iOk = (eConfigLoad(&sConfig, acFileName, acImageFileName) == E_CONFIG_OK);
+    unlink(acFileName);
+    unlink(acImageFileName);
+    TEST_ASSERT(iOk);
+    
+    /* The device ID wins over an earlier base type, and the first of each kind is used */
+    psDevice = psConfigLookupDevice(&sConfig, 0x80821CE1);
+    iOk = psDevice && (strcmp(pcConfigString(&sConfig, psDevice->u32Name), "Lamp") == 0);
+    psDevice = psConfigLookupDevice(&sConfig, 0x12345AE1);
+    iOk = iOk && psDevice && (strcmp(pcConfigString(&sConfig, psDevice->u32Name), "Dimmable") == 0);
+    iOk = iOk && (psConfigLookupDevice(&sConfig, 0x12345AE2) == NULL);
+    vConfigUnload(&sConfig);
+    TEST_ASSERT(iOk);
+}
+
+
+/** Write a small configuration to a temporary file. \return non-zero on success */
+static int iWriteSmallConfig(char *pcFileName, char *pcImageFileName, size_t szImageFileName, const char *pcContents)
+{
+    FILE *psFile;
+    int iFd;
+    
+    iFd = mkstemp(pcFileName);
+    if (iFd < 0)
+    {
+        return 0;
+    }
+    psFile = fdopen(iFd, "w");
+    if (!psFile)
+    {
+        close(iFd);
+        return 0;
+    }
+    fputs(pcContents, psFile);
+    snprintf(pcImageFileName, szImageFileName, "%s.bin", pcFileName);
+    return fclose(psFile) == 0;
+}
+
+
+static void vTestRejectedDevice(void)
+{
+    char acFileName[] = "/tmp/jip_test_configXXXXXX";
+    char acImageFileName[sizeof(acFileName) + 4];
+    const tsConfigDevice *psDevice;
+    tsConfig sConfig;
+    int iOk;
+    
+    /* The second device has no name, so its controls must not end up on the first */
+    TEST_ASSERT(iWriteSmallConfig(acFileName, acImageFileName, sizeof(acImageFileName),
+        "<SmartDevicesCgiConfig Version=\"1\">\n"
+        "  <Device ID=\"0x80821CE1\" Name=\"Lamp\">\n"
+        "    <StateControl MiB=\"BulbControl\" Var=\"Mode\"/>\n"
+        "  </Device>\n"
+        "  <Device ID=\"0x00000002\" Label=\"Plug\">\n"
+        "    <StateControl MiB=\"DeviceControl\" Var=\"Relay\"/>\n"
+        "  </Device>\n"
+        "</SmartDevicesCgiConfig>\n"));
+    
+    iOk = (eConfigLoad(&sConfig, acFileName, acImageFileName) == E_CONFIG_OK);
+    unlink(acFileName);
+    unlink(acImageFileName);
+    TEST_ASSERT(iOk);
+    
+    iOk = (sConfig.psHeader->u32NumDevices == 1);
+    psDevice = psConfigLookupDevice(&sConfig, 0x80821CE1);
+    iOk = iOk && psDevice && (strcmp(pcConfigString(&sConfig, psDevice->u32StateControlMib), "BulbControl") == 0);
+    iOk = iOk && (psConfigLookupDevice(&sConfig, 0x00000002) == NULL);
+    vConfigUnload(&sConfig);
+    TEST_ASSERT(iOk);
+}
+
+
+static void vTestCorruptLookups(void)
+{
+    char acFileName[] = "/tmp/jip_test_configXXXXXX";
+    char acImageFileName[sizeof(acFileName) + 4];
+    tsConfigLookup asLookup[2] = { { 0x80821CE1, 7 }, { 0x80821CE1, 7 } };
+    const tsConfigDevice *psDevice;
+    tsConfig sConfig;
+    off_t iOffset;
+    int iFd;
+    int iOk;
+    
+    TEST_ASSERT(iWriteSmallConfig(acFileName, acImageFileName, sizeof(acImageFileName),
+        "<SmartDevicesCgiConfig Version=\"1\">\n"
+        "  <Device ID=\"0x80821CE1\" Name=\"Lamp\"/>\n"
+        "</SmartDevicesCgiConfig>\n"));
+    
+    iOk = (eConfigLoad(&sConfig, acFileName, acImageFileName) == E_CONFIG_OK);
+    iOk = iOk && (sConfig.psHeader->u32DeviceIdHashSize == 2);
+    iOffset = (const char *)sConfig.psDeviceIdHash - (const char *)sConfig.pvMap;
+    vConfigUnload(&sConfig);
+    
+    /* Fill the hash with entries pointing past the device table */
+    iFd = open(acImageFileName, O_WRONLY);
+    iOk = iOk && (iFd >= 0) && (pwrite(iFd, asLookup, sizeof(asLookup), iOffset) == sizeof(asLookup));
+    if (iFd >= 0)
+    {
+        close(iFd);
+    }
+    
+    /* The image must be rejected and compiled again, rather than used */
+    iOk = iOk && (eConfigLoad(&sConfig, acFileName, acImageFileName) == E_CONFIG_OK);
+    unlink(acFileName);
+    unlink(acImageFileName);
+    TEST_ASSERT(iOk);
+    
+    psDevice = psConfigLookupDevice(&sConfig, 0x80821CE1);
+    iOk = psDevice && (strcmp(pcConfigString(&sConfig, psDevice->u32Name), "Lamp") == 0);
+    iOk = iOk && (psConfigLookupDevice(&sConfig, 0x12345678) == NULL);
+    vConfigUnload(&sConfig);
+    TEST_ASSERT(iOk);
+}
+
+
+const tsTest asTestConfig[] =
+{
+    TEST(vTestLookupThousands),
+    TEST(vTestLookupPrecedence),
+    TEST(vTestRejectedDevice),
+    TEST(vTestCorruptLookups),
+    TEST_END
+};
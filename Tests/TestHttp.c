@@ -0,0 +1,265 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Unit tests of the HTTP parser
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Http.h"
+#include "Test.h"
+
+
+/** Parse a request from a writable copy of a string literal */
+#define PARSE(psRequest, acBuffer, pcText) \
+    (strcpy((acBuffer), (pcText)), eHttpParseRequest((psRequest), (acBuffer), strlen(pcText)))
+
+
+static void vTestGet(void)
+{
+    tsHttpRequest sRequest;
+    char acBuffer[256];
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, 
+        "GET /cgi-bin/JIP.cgi?action=getVersion HTTP/1.1\r\nHost: router\r\nAccept:  application/json  \r\n\r\n"));
+    TEST_ASSERT_EQUAL_STRING("GET", sRequest.pcMethod);
+    TEST_ASSERT_EQUAL_STRING("/cgi-bin/JIP.cgi", sRequest.pcPath);
+    TEST_ASSERT_EQUAL_STRING("action=getVersion", sRequest.pcQuery);
+    TEST_ASSERT_EQUAL_INT(1, sRequest.iMinorVersion);
+    TEST_ASSERT_EQUAL_INT(2, sRequest.u32NumHeaders);
+    TEST_ASSERT_EQUAL_STRING("router", pcHttpHeader(&sRequest, "host"));
+    TEST_ASSERT_EQUAL_STRING("application/json", pcHttpHeader(&sRequest, "ACCEPT"));
+    TEST_ASSERT(pcHttpHeader(&sRequest, "Cookie") == NULL);
+    TEST_ASSERT_EQUAL_INT(0, sRequest.szBody);
+    TEST_ASSERT_EQUAL_INT(sizeof("GET /cgi-bin/JIP.cgi?action=getVersion HTTP/1.1\r\nHost: router\r\n"
+                                 "Accept:  application/json  \r\n\r\n") - 1, sRequest.szLength);
+}
+
+
+static void vTestNoQuery(void)
+{
+    tsHttpRequest sRequest;
+    char acBuffer[256];
+    
+    /* Bare line feeds are accepted */
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, "HEAD /style.css HTTP/1.0\n\n"));
+    TEST_ASSERT_EQUAL_STRING("HEAD", sRequest.pcMethod);
+    TEST_ASSERT_EQUAL_STRING("/style.css", sRequest.pcPath);
+    TEST_ASSERT_EQUAL_STRING("", sRequest.pcQuery);
+    TEST_ASSERT_EQUAL_INT(0, sRequest.iMinorVersion);
+    TEST_ASSERT_EQUAL_INT(strlen("HEAD /style.css HTTP/1.0\n\n"), sRequest.szLength);
+}
+
+
+static void vTestKeepAlive(void)
+{
+    tsHttpRequest sRequest;
+    char acBuffer[256];
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, "GET / HTTP/1.1\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(1, sRequest.iKeepAlive);
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, "GET / HTTP/1.1\r\nConnection: Close\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(0, sRequest.iKeepAlive);
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, "GET / HTTP/1.0\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(0, sRequest.iKeepAlive);
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, "GET / HTTP/1.0\r\nConnection: TE, keep-alive\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(1, sRequest.iKeepAlive);
+}
+
+
+static void vTestIncomplete(void)
+{
+    static const char acRequest[] = "POST /cgi-bin/SmartDevices.cgi HTTP/1.1\r\nContent-Length: 11\r\n\r\nMode=Groups";
+    tsHttpRequest sRequest;
+    char acBuffer[256];
+    size_t szLength;
+    
+    /* Every prefix is incomplete, and leaves the buffer as it was */
+    strcpy(acBuffer, acRequest);
+    for (szLength = 0; szLength < strlen(acRequest); szLength++)
+    {
+        TEST_ASSERT_EQUAL_INT(E_HTTP_INCOMPLETE, eHttpParseRequest(&sRequest, acBuffer, szLength));
+        TEST_ASSERT_EQUAL_STRING(acRequest, acBuffer);
+    }
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, eHttpParseRequest(&sRequest, acBuffer, szLength));
+    TEST_ASSERT_EQUAL_STRING("POST", sRequest.pcMethod);
+    TEST_ASSERT_EQUAL_INT(11, sRequest.szBody);
+    TEST_ASSERT_EQUAL_MEMORY("Mode=Groups", sRequest.pcBody, 11);
+    TEST_ASSERT_EQUAL_INT(strlen(acRequest), sRequest.szLength);
+}
+
+
+static void vTestPipelined(void)
+{
+    static const char acRequests[] = 
+        "POST /cgi-bin/JIP.cgi HTTP/1.1\r\nContent-Length: 3\r\n\r\na=1"
+        "GET /js/JIP.js HTTP/1.1\r\n\r\n";
+    tsHttpRequest sRequest;
+    char acBuffer[256];
+    size_t szOffset;
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, PARSE(&sRequest, acBuffer, acRequests));
+    TEST_ASSERT_EQUAL_MEMORY("a=1", sRequest.pcBody, 3);
+    szOffset = sRequest.szLength;
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, eHttpParseRequest(&sRequest, &acBuffer[szOffset], strlen(acRequests) - szOffset));
+    TEST_ASSERT_EQUAL_STRING("/js/JIP.js", sRequest.pcPath);
+    TEST_ASSERT_EQUAL_INT(strlen(acRequests) - szOffset, sRequest.szLength);
+}
+
+
+static void vTestInvalid(void)
+{
+    tsHttpRequest sRequest;
+    char acBuffer[256];
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, "GET\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, "GET index.html HTTP/1.1\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, "GET / HTTX/1.1\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, "GET / HTTP/1.1\r\nHost : router\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, "GET / HTTP/1.1\r\nHost: a\r\n  folded\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, "GET / HTTP/1.1\r\nContent-Length: -1\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, PARSE(&sRequest, acBuffer, 
+        "GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_UNSUPPORTED, PARSE(&sRequest, acBuffer, "GET / HTTP/2.0\r\n\r\n"));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_UNSUPPORTED, PARSE(&sRequest, acBuffer, 
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+}
+
+
+static void vTestTooManyHeaders(void)
+{
+    tsHttpRequest sRequest;
+    char acBuffer[2048];
+    size_t szLength;
+    int i;
+    
+    szLength = sprintf(acBuffer, "GET / HTTP/1.1\r\n");
+    for (i = 0; i < HTTP_MAX_HEADERS; i++)
+    {
+        szLength += sprintf(&acBuffer[szLength], "X-%d: %d\r\n", i, i);
+    }
+    strcpy(&acBuffer[szLength], "\r\n");
+    TEST_ASSERT_EQUAL_INT(E_HTTP_OK, eHttpParseRequest(&sRequest, acBuffer, szLength + 2));
+    TEST_ASSERT_EQUAL_INT(HTTP_MAX_HEADERS, sRequest.u32NumHeaders);
+    
+    szLength += sprintf(&acBuffer[szLength], "X-More: 1\r\n\r\n");
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, eHttpParseRequest(&sRequest, acBuffer, szLength));
+}
+
+
+/** Convert CGI output, checking the response it becomes */
+static int iFromCgi(const char *pcOutput, int iHeadOnly, int iKeepAlive, const char *pcExpected)
+{
+    char *pcResponse;
+    size_t szResponse;
+    int iMatch;
+    
+    if (eHttpFromCgi(pcOutput, strlen(pcOutput), iHeadOnly, iKeepAlive, &pcResponse, &szResponse) != E_HTTP_OK)
+    {
+        return 0;
+    }
+    iMatch = (szResponse == strlen(pcExpected)) && (memcmp(pcResponse, pcExpected, szResponse) == 0);
+    if (!iMatch)
+    {
+        fprintf(stderr, "    got \"%.*s\"\n", (int)szResponse, pcResponse);
+    }
+    free(pcResponse);
+    return iMatch;
+}
+
+
+static void vTestFromCgi(void)
+{
+    char *pcResponse;
+    size_t szResponse;
+    
+    TEST_ASSERT(iFromCgi("Content-type: application/json\r\n\r\n{}", 0, 1,
+                         "HTTP/1.1 200 OK\r\nContent-type: application/json\r\nContent-Length: 2\r\n"
+                         "Connection: keep-alive\r\n\r\n{}"));
+    
+    /* The program's own framing is replaced */
+    TEST_ASSERT(iFromCgi("Content-Length: 99\nContent-type: text/html\n\n<p>", 0, 0,
+                         "HTTP/1.1 200 OK\r\nContent-type: text/html\r\nContent-Length: 3\r\n"
+                         "Connection: close\r\n\r\n<p>"));
+    
+    TEST_ASSERT(iFromCgi("Status: 304 Not Modified\r\nETag: \"1\"\r\n\r\n", 0, 1,
+                         "HTTP/1.1 304 Not Modified\r\nETag: \"1\"\r\nConnection: keep-alive\r\n\r\n"));
+    
+    TEST_ASSERT(iFromCgi("Location: /Browser.html\r\n\r\n", 0, 1,
+                         "HTTP/1.1 302 Found\r\nLocation: /Browser.html\r\nContent-Length: 0\r\n"
+                         "Connection: keep-alive\r\n\r\n"));
+    
+    /* HEAD gets the length of the body it does not get */
+    TEST_ASSERT(iFromCgi("Content-type: text/plain\r\n\r\nhello", 1, 1,
+                         "HTTP/1.1 200 OK\r\nContent-type: text/plain\r\nContent-Length: 5\r\n"
+                         "Connection: keep-alive\r\n\r\n"));
+    
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, eHttpFromCgi("", 0, 0, 1, &pcResponse, &szResponse));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, eHttpFromCgi("no headers\r\n\r\n", 14, 0, 1, &pcResponse, &szResponse));
+    TEST_ASSERT_EQUAL_INT(E_HTTP_BAD_REQUEST, eHttpFromCgi("Content-type: text/plain\r\n", 26, 0, 1, &pcResponse, &szResponse));
+}
+
+
+static void vTestFormatHead(void)
+{
+    char acBuffer[128];
+    
+    TEST_ASSERT_EQUAL_INT(strlen("HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 14\r\n"
+                                 "Connection: close\r\n\r\n"),
+                          szHttpFormatHead(acBuffer, sizeof(acBuffer), 404, "text/plain", 14, 0));
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 14\r\n"
+                             "Connection: close\r\n\r\n", acBuffer);
+    TEST_ASSERT_EQUAL_INT(0, szHttpFormatHead(acBuffer, 16, 200, NULL, 0, 1));
+}
+
+
+const tsTest asTestHttp[] =
+{
+    TEST(vTestGet),
+    TEST(vTestNoQuery),
+    TEST(vTestKeepAlive),
+    TEST(vTestIncomplete),
+    TEST(vTestPipelined),
+    TEST(vTestInvalid),
+    TEST(vTestTooManyHeaders),
+    TEST(vTestFromCgi),
+    TEST(vTestFormatHead),
+    TEST_END
+};
@@ -0,0 +1,303 @@
+/****************************************************************************
+ *
+ * MODULE:             JIP Web Apps
+ *
+ * COMPONENT:          Tests of the compressing response writer
+ *
+ * REVISION:           $Revision$
+ *
+ * DATED:              $Date$
+ *
+ * AUTHOR:             JIP Web Apps
+ *
+ ****************************************************************************
+ *
+ * This software is owned by NXP B.V. and/or its supplier and is protected
+ * under applicable copyright laws. All rights are reserved. We grant You,
+ * and any third parties, a license to use this software solely and
+ * exclusively on NXP products [NXP Microcontrollers such as JN5148, JN5142, JN5139]. 
+ * You, and any third parties must reproduce the copyright and warranty notice
+ * and any other legend of ownership on each copy or partial copy of the 
+ * software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ * Copyright NXP B.V. 2012. All rights reserved
+ *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "Response.h"
+#include "Test.h"
+
+/** Size of the compressible body */
+#define TEST_BODY_SIZE          (64 * 1024)
+
+
+/** Output of a response, split into its headers and body */
+typedef struct
+{
+    char        *pcOutput;          /**< Everything written to the file descriptor */
+    size_t      szOutput;           /**< Length of output */
+    const char  *pcHeaders;         /**< Header lines, nul terminated */
+    const char  *pcBody;            /**< Body, as sent */
+    size_t      szBody;             /**< Length of body as sent */
+    tsResponse  sResponse;          /**< Response after it finished, for its byte counts */
+} tsTestOutput;
+
+
+/** Set up the request environment */
+static void vEnvironment(const char *pcAcceptEncoding, const char *pcLevel)
+{
+    if (pcAcceptEncoding)
+    {
+        setenv("HTTP_ACCEPT_ENCODING", pcAcceptEncoding, 1);
+    }
+    else
+    {
+        unsetenv("HTTP_ACCEPT_ENCODING");
+    }
+    if (pcLevel)
+    {
+        setenv(RESPONSE_LEVEL_ENV, pcLevel, 1);
+    }
+    else
+    {
+        unsetenv(RESPONSE_LEVEL_ENV);
+    }
+    unsetenv(RESPONSE_THRESHOLD_ENV);
+}
+
+
+/** Send a body through a response, in pieces of szPiece bytes, into a temporary file
+ *  and read back what was written. \return Non zero on success */
+static int iRespond(tsTestOutput *psOutput, const char *pcBody, size_t szLength, size_t szPiece)
+{
+    char acFileName[] = "/tmp/jip_test_responseXXXXXX";
+    char *pcSeparator;
+    size_t szOffset;
+    FILE *psFile;
+    int iFd;
+    int iOk = 1;
+    
+    memset(psOutput, 0, sizeof(tsTestOutput));
+    iFd = mkstemp(acFileName);
+    if (iFd < 0)
+    {
+        return 0;
+    }
+    unlink(acFileName);
+    
+    eResponseInit(&psOutput->sResponse, iFd);
+    eResponseHeader(&psOutput->sResponse, "Content-type: text/plain");
+    for (szOffset = 0; szOffset < szLength; szOffset += szPiece)
+    {
+        size_t szWrite = (szLength - szOffset < szPiece) ? szLength - szOffset : szPiece;
+        iOk = iOk && (eResponseWrite(&psOutput->sResponse, pcBody + szOffset, szWrite) == E_RESPONSE_OK);
+    }
+    iOk = iOk && (eResponseFinish(&psOutput->sResponse) == E_RESPONSE_OK);
+    
+    psFile = fdopen(iFd, "r");
+    if (!psFile)
+    {
+        close(iFd);
+        return 0;
+    }
+    psOutput->szOutput = lseek(iFd, 0, SEEK_END);
+    psOutput->pcOutput = malloc(psOutput->szOutput + 1);
+    rewind(psFile);
+    iOk = iOk && psOutput->pcOutput && 
+          (fread(psOutput->pcOutput, 1, psOutput->szOutput, psFile) == psOutput->szOutput);
+    fclose(psFile);
+    if (!iOk)
+    {
+        free(psOutput->pcOutput);
+        psOutput->pcOutput = NULL;
+        return 0;
+    }
+    psOutput->pcOutput[psOutput->szOutput] = '\0';
+    
+    pcSeparator = strstr(psOutput->pcOutput, "\r\n\r\n");
+    if (!pcSeparator)
+    {
+        return 0;
+    }
+    pcSeparator[2] = '\0';
+    psOutput->pcHeaders = psOutput->pcOutput;
+    psOutput->pcBody    = pcSeparator + 4;
+    psOutput->szBody    = psOutput->szOutput - (psOutput->pcBody - psOutput->pcOutput);
+    return 1;
+}
+
+
+/** Decompress a gzip or zlib body and compare it with the original. \return Non zero if they match */
+static int iInflatesTo(const tsTestOutput *psOutput, const char *pcBody, size_t szLength)
+{
+    z_stream sStream;
+    char *pcInflated = malloc(szLength + 1);
+    int iResult;
+    
+    memset(&sStream, 0, sizeof(sStream));
+    /* Adding 32 to the window bits detects a gzip or zlib header */
+    if (!pcInflated || (inflateInit2(&sStream, 15 + 32) != Z_OK))
+    {
+        free(pcInflated);
+        return 0;
+    }
+    sStream.next_in   = (Bytef *)psOutput->pcBody;
+    sStream.avail_in  = psOutput->szBody;
+    sStream.next_out  = (Bytef *)pcInflated;
+    sStream.avail_out = szLength + 1;
+    iResult = inflate(&sStream, Z_FINISH);
+    inflateEnd(&sStream);
+    
+    iResult = (iResult == Z_STREAM_END) && (sStream.total_out == szLength) &&
+              (memcmp(pcInflated, pcBody, szLength) == 0);
+    free(pcInflated);
+    return iResult;
+}
+
+
+/** Fill a buffer with text much like a discover response */
+static char *pcMakeBody(size_t szLength)
+{
+    char *pcBody = malloc(szLength + 1);
+    size_t szOffset = 0;
+    int i = 0;
+    
+    while (pcBody && (szOffset < szLength))
+    {
+        char acNode[128];
+        int iLength = snprintf(acNode, sizeof(acNode), 
+                               "{ \"Address\": \"fd04:bd3:80e8:2::%x\", \"Type\": %d, \"Temperature\": %d }, ", 
+                               i, 0x08010010 + (i & 1), 2000 + (i * 37) % 500);
+        size_t szCopy = ((size_t)iLength < szLength - szOffset) ? (size_t)iLength : szLength - szOffset;
+        memcpy(pcBody + szOffset, acNode, szCopy);
+        szOffset += szCopy;
+        i++;
+    }
+    if (pcBody)
+    {
+        pcBody[szLength] = '\0';
+    }
+    return pcBody;
+}
+
+
+static void vTestSmallBodyUncompressed(void)
+{
+    const char *pcBody = "{ \"Status\": { \"Value\": 0 } }";
+    tsTestOutput sOutput;
+    
+    vEnvironment("gzip, deflate", NULL);
+    TEST_ASSERT(iRespond(&sOutput, pcBody, strlen(pcBody), 7));
+    
+    TEST_ASSERT(strstr(sOutput.pcHeaders, "Content-type: text/plain\r\n") != NULL);
+    TEST_ASSERT(strstr(sOutput.pcHeaders, "Content-Encoding") == NULL);
+    TEST_ASSERT_EQUAL_INT(strlen(pcBody), sOutput.szBody);
+    TEST_ASSERT_EQUAL_MEMORY(pcBody, sOutput.pcBody, sOutput.szBody);
+    TEST_ASSERT_EQUAL_INT(sOutput.sResponse.szBody, sOutput.sResponse.szWire);
+    free(sOutput.pcOutput);
+}
+
+
+static void vTestLargeBodyGzip(void)
+{
+    char *pcBody = pcMakeBody(TEST_BODY_SIZE);
+    tsTestOutput sOutput;
+    int iOk;
+    
+    TEST_ASSERT(pcBody != NULL);
+    vEnvironment("deflate, gzip;q=0.8", NULL);
+    iOk = iRespond(&sOutput, pcBody, TEST_BODY_SIZE, 1000);
+    iOk = iOk && (strstr(sOutput.pcHeaders, "Content-Encoding: gzip\r\n") != NULL) &&
+          (strstr(sOutput.pcHeaders, "Vary: Accept-Encoding\r\n") != NULL) &&
+          (sOutput.sResponse.szBody == TEST_BODY_SIZE) &&
+          (sOutput.sResponse.szWire == sOutput.szBody) &&
+          (sOutput.szBody < TEST_BODY_SIZE / 4) &&
+          (iInflatesTo(&sOutput, pcBody, TEST_BODY_SIZE));
+    free(sOutput.pcOutput);
+    free(pcBody);
+    TEST_ASSERT(iOk);
+}
+
+
+static void vTestLargeBodyDeflate(void)
+{
+    char *pcBody = pcMakeBody(TEST_BODY_SIZE);
+    tsTestOutput sOutput;
+    int iOk;
+    
+    TEST_ASSERT(pcBody != NULL);
+    vEnvironment("gzip;q=0, deflate", "9");
+    /* One write bigger than the compressor's output chunk */
+    iOk = iRespond(&sOutput, pcBody, TEST_BODY_SIZE, TEST_BODY_SIZE);
+    iOk = iOk && (strstr(sOutput.pcHeaders, "Content-Encoding: deflate\r\n") != NULL) &&
+          (iInflatesTo(&sOutput, pcBody, TEST_BODY_SIZE));
+    free(sOutput.pcOutput);
+    free(pcBody);
+    TEST_ASSERT(iOk);
+}
+
+
+static void vTestNotAccepted(void)
+{
+    char *pcBody = pcMakeBody(TEST_BODY_SIZE);
+    tsTestOutput sOutput;
+    int iOk;
+    
+    TEST_ASSERT(pcBody != NULL);
+    vEnvironment(NULL, NULL);
+    iOk = iRespond(&sOutput, pcBody, TEST_BODY_SIZE, 4096);
+    iOk = iOk && (strstr(sOutput.pcHeaders, "Content-Encoding") == NULL) &&
+          (sOutput.szBody == TEST_BODY_SIZE) &&
+          (memcmp(sOutput.pcBody, pcBody, TEST_BODY_SIZE) == 0);
+    free(sOutput.pcOutput);
+    free(pcBody);
+    TEST_ASSERT(iOk);
+}
+
+
+static void vTestLevelZeroDisables(void)
+{
+    char *pcBody = pcMakeBody(TEST_BODY_SIZE);
+    tsTestOutput sOutput;
+    int iOk;
+    
+    TEST_ASSERT(pcBody != NULL);
+    vEnvironment("gzip", "0");
+    iOk = iRespond(&sOutput, pcBody, TEST_BODY_SIZE, 4096);
+    iOk = iOk && (strstr(sOutput.pcHeaders, "Vary") == NULL) &&
+          (sOutput.szBody == TEST_BODY_SIZE) &&
+          (memcmp(sOutput.pcBody, pcBody, TEST_BODY_SIZE) == 0);
+    free(sOutput.pcOutput);
+    free(pcBody);
+    TEST_ASSERT(iOk);
+}
+
+
+const tsTest asTestResponse[] =
+{
+    TEST(vTestSmallBodyUncompressed),
+    TEST(vTestLargeBodyGzip),
+    TEST(vTestLargeBodyDeflate),
+    TEST(vTestNotAccepted),
+    TEST(vTestLevelZeroDisables),
+    TEST_END
+};
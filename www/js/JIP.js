@@ -45,14 +45,75 @@ var ActiveBorderRouter = ""
 /** Placeholder for JenNet-IP network contents */
 var Network=[];
 
+/** Version of the network held in Network, the border router and the depth it was discovered at.
+ *  Used to ask for only the nodes that changed since. */
+var NetworkVersion;
+var NetworkBorderRouter;
+var NetworkDepth;
 
-/** jQuery queue based manager for ajax requests. */
+
+/** jQuery queue based manager for ajax requests.
+ *  Requests are sent one after another, in the order they were made.
+ *  GetVar and SetVar requests waiting together are sent as one batch
+ *  request, which JIP.cgi executes across nodes concurrently. Each
+ *  request's callbacks are called with its own part of the result. */
 var JIP_AjaxManager = (function() {
      var requests = [];
+     var active = null;
+     var BatchMax = 32;
+     
+     /** Combine batchable requests into one */
+     function batch(list) {
+        var subrequests = [];
+        var i;
+        
+        for (i = 0; i < list.length; i++) {
+            subrequests.push(list[i].batch.request);
+        }
+        
+        return {
+            type: 'POST',
+            url: '/cgi-bin/JIP.cgi',
+            /* JIP.cgi does not decode '+' as a space, so encode the requests here rather than with $.param */
+            data: "action=batch&BRaddress=" + list[0].batch.BRaddress + "&refresh=no" +
+                  "&requests=" + encodeURIComponent(JSON.stringify(subrequests)),
+            success: function(Result) {
+                for (i = 0; i < list.length; i++) {
+                    var SubResult = (Result.Results && Result.Results[i]) ? Result.Results[i] : {Status: Result.Status};
+                    if( typeof list[i].success === 'function' ) list[i].success(SubResult);
+                }
+            },
+            error: function(jqXHR, textStatus, errorThrown) {
+                /* None of the requests got an answer, so each is told it failed */
+                var Status = {Value: 0xFF, Description: "Batch request failed (" + textStatus + ")"};
+                for (i = 0; i < list.length; i++) {
+                    if( typeof list[i].error === 'function' ) list[i].error(jqXHR, textStatus, errorThrown);
+                    else if( typeof list[i].success === 'function' ) list[i].success({Status: Status});
+                }
+            },
+            complete: function() {
+                for (i = 0; i < list.length; i++) {
+                    if( typeof list[i].complete === 'function' ) list[i].complete();
+                }
+            }
+        };
+     }
 
      return {
         addReq:  function(opt) {
+            var i;
+            if (opt.coalesce) {
+                /* A newer value for the same variable replaces one still waiting to be sent */
+                for (i = 0; i < requests.length; i++) {
+                    if (requests[i].coalesce === opt.coalesce) {
+                        if( typeof requests[i].superseded === 'function' ) requests[i].superseded();
+                        requests[i] = opt;
+                        return;
+                    }
+                }
+            }
             requests.push(opt);
+            this.run();
         },
         removeReq:  function(opt) {
             if( $.inArray(opt, requests) > -1 )
@@ -60,34 +121,45 @@ var JIP_AjaxManager = (function() {
         },
         run: function() {
             var self = this,
-                orgSuc;
-
-            if( requests.length ) {
-                oriSuc = requests[0].complete;
+                list = [],
+                opt,
+                oriComplete;
 
-                requests[0].complete = function() {
-                     if( typeof oriSuc === 'function' ) oriSuc();
-                     requests.shift();
-                     self.run.apply(self, []);
-                };   
-
-                $.ajax(requests[0]);
+            if( active || !requests.length ) {
+                return;
+            }
+            
+            while( requests.length && requests[0].batch && (list.length < BatchMax) &&
+                   ((list.length == 0) || (requests[0].batch.BRaddress == list[0].batch.BRaddress)) ) {
+                list.push(requests.shift());
+            }
+            
+            if( list.length > 1 ) {
+                opt = batch(list);
+            } else if( list.length == 1 ) {
+                opt = list[0];
             } else {
-              self.tid = setTimeout(function() {
-                 self.run.apply(self, []);
-              }, 100);
+                opt = requests.shift();
             }
+            
+            oriComplete = opt.complete;
+            opt.complete = function() {
+                 if( typeof oriComplete === 'function' ) oriComplete();
+                 active = null;
+                 self.run.apply(self, []);
+            };
+            
+            active = opt;
+            $.ajax(opt);
         },
         stop:  function() {
             requests = [];
-            clearTimeout(this.tid);
         },
         clear: function() {
             requests = [];
         }
      };
 }());
-JIP_AjaxManager.run();
 
 function JIP_CancelPendingRequests()
 {
@@ -106,6 +178,22 @@ function JIP_Request(request, callback)
 }
 
 
+/** Request that may be answered from the browser cache.
+ *  The response carries an ETag and must be revalidated, so the browser asks
+ *  with If-None-Match and the server replies 304 if nothing has changed. */
+function JIP_CachedRequest(request, callback)
+{
+    JIP_AjaxManager.addReq({
+        type: 'GET',
+        url: '/cgi-bin/JIP.cgi',
+        data: request,
+        cache: true,
+        success: callback
+    });
+    return;
+}
+
+
 function JIP_GetVersion(callback) 
 { 
     var request; 
@@ -122,22 +210,94 @@ function JIP_DiscoverBRs(callback)
     var request; 
     request = "action=discoverBRs";
     
-    JIP_Request(request, function(Result) {
+    JIP_CachedRequest(request, function(Result) {
         BRList = Result.BRList;
         callback(Result.Status);
     });
 }
 
-function JIP_Discover(callback, IPv6Address) 
+/** Add since= to a discover request if Network can be brought up to date with a delta */
+function JIP_DeltaRequest(request, Depth)
+{
+    if ((NetworkVersion != undefined) && (NetworkBorderRouter == ActiveBorderRouter) && (NetworkDepth == Depth))
+    {
+        request = request + "&since=" + NetworkVersion;
+    }
+    return request;
+}
+
+
+/** Bring Network up to date from a discover response.
+ *  Delta responses hold the nodes that were added or changed, and the
+ *  addresses of the nodes that were removed, since NetworkVersion. */
+function JIP_UpdateNetwork(Result, Depth)
+{
+    var nodeidx, i;
+    
+    if ((Result.Network == undefined) || (!Result.Network.Delta) || (Network.Nodes == undefined))
+    {
+        Network = Result.Network;
+    }
+    else
+    {
+        for (i in Result.Network.Nodes)
+        {
+            var found = false;
+            for (nodeidx in Network.Nodes)
+            {
+                if (Network.Nodes[nodeidx].IPv6Address == Result.Network.Nodes[i].IPv6Address)
+                {
+                    Network.Nodes[nodeidx] = Result.Network.Nodes[i];
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                Network.Nodes.push(Result.Network.Nodes[i]);
+            }
+        }
+        for (i in Result.Network.Removed)
+        {
+            for (nodeidx = Network.Nodes.length - 1; nodeidx >= 0; nodeidx--)
+            {
+                if (Network.Nodes[nodeidx].IPv6Address == Result.Network.Removed[i])
+                {
+                    Network.Nodes.splice(nodeidx, 1);
+                }
+            }
+        }
+        Network.Version = Result.Network.Version;
+    }
+    
+    if ((Network != undefined) && (Network.Version != undefined))
+    {
+        NetworkVersion = Network.Version;
+        NetworkBorderRouter = ActiveBorderRouter;
+        NetworkDepth = Depth;
+    }
+    else
+    {
+        NetworkVersion = undefined;
+    }
+}
+
+
+function JIP_Discover(callback, IPv6Address, Refresh) 
 { 
     if (IPv6Address != undefined)
     {
         ActiveBorderRouter = IPv6Address;
         var request;
         request = "action=discover&BRaddress=" + ActiveBorderRouter;
+        if (Refresh)
+        {
+            /* Bypass the background snapshot and rediscover now */
+            request = request + "&refresh=force";
+        }
+        request = JIP_DeltaRequest(request, "full");
         
-        JIP_Request(request, function(Result) {
-            Network = Result.Network;
+        JIP_CachedRequest(request, function(Result) {
+            JIP_UpdateNetwork(Result, "full");
             if (callback)
             {
                 callback(Result.Status);
@@ -147,6 +307,77 @@ function JIP_Discover(callback, IPv6Address)
 }
 
 
+/** Discover only the node headers (address, device ID and name) of the network.
+ *  MiBs are fetched per node on first use with JIP_LoadNode. */
+function JIP_DiscoverNodes(callback, IPv6Address, Refresh) 
+{ 
+    if (IPv6Address != undefined)
+    {
+        ActiveBorderRouter = IPv6Address;
+        var request;
+        request = "action=discover&depth=nodes&BRaddress=" + ActiveBorderRouter;
+        if (Refresh)
+        {
+            request = request + "&refresh=force";
+        }
+        request = JIP_DeltaRequest(request, "nodes");
+        
+        JIP_CachedRequest(request, function(Result) {
+            JIP_UpdateNetwork(Result, "nodes");
+            if (callback)
+            {
+                callback(Result.Status);
+            }
+        });
+    }
+}
+
+
+/** Make sure the MiBs of a node have been loaded into Network, then call callback */
+function JIP_LoadNode(IPv6Address, callback)
+{
+    var nodeidx;
+    
+    for (nodeidx in Network.Nodes)
+    {
+        if ((Network.Nodes[nodeidx].IPv6Address == IPv6Address) && (Network.Nodes[nodeidx].MiBs != undefined))
+        {
+            callback({Value: 0, Description: "Success"});
+            return;
+        }
+    }
+    
+    var request;
+    request = "action=discover&BRaddress=" + ActiveBorderRouter;
+    request = request + "&nodeaddress=" + IPv6Address;
+    
+    JIP_CachedRequest(request, function(Result) {
+        if ((Result.Status.Value == 0) && (Result.Network.Nodes.length == 1))
+        {
+            var found = false;
+            
+            if (Network.Nodes == undefined)
+            {
+                Network = {Nodes: []};
+            }
+            for (nodeidx in Network.Nodes)
+            {
+                if (Network.Nodes[nodeidx].IPv6Address == IPv6Address)
+                {
+                    Network.Nodes[nodeidx] = Result.Network.Nodes[0];
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                Network.Nodes.push(Result.Network.Nodes[0]);
+            }
+        }
+        callback(Result.Status);
+    });
+}
+
+
 function JIP_GetVar(address, mib, variable, callback, user) 
 { 
     var request; 
@@ -156,20 +387,28 @@ function JIP_GetVar(address, mib, variable, callback, user)
     request = request + "&var=" + variable; 
     request = request + "&refresh=no"; 
     
-    JIP_Request(request, function(Result) {
-        var Network = Result.Network
-        var Nodes = Network["Nodes"];
-        if (Nodes.length == 0)
-        {
-            callback(0xFF, user, "?");
-            return;
-        }
-        var NewValue = Network["Nodes"][0]["MiBs"][0]["Vars"][0]["Value"];
-        if (NewValue)
-        {
-            NewValue = NewValue.toString();
+    JIP_AjaxManager.addReq({
+        type: 'POST',
+        url: '/cgi-bin/JIP.cgi',
+        data: request,
+        batch: {
+            BRaddress: ActiveBorderRouter,
+            request: {action: "GetVar", nodeaddress: address, mib: mib, "var": variable}
+        },
+        success: function(Result) {
+            var Network = Result.Network
+            if ((Network == undefined) || (Network["Nodes"].length == 0))
+            {
+                callback(0xFF, user, "?");
+                return;
+            }
+            var NewValue = Network["Nodes"][0]["MiBs"][0]["Vars"][0]["Value"];
+            if (NewValue)
+            {
+                NewValue = NewValue.toString();
+            }
+            callback(Result.Status, user, NewValue);
         }
-        callback(Result.Status, user, NewValue);
     });
 }
 
@@ -184,8 +423,56 @@ function JIP_SetVar(address, mib, variable, value, callback, user)
     request = request + "&value=" + value; 
     request = request + "&refresh=no"; 
     
-    JIP_Request(request, function(Result) {
-        callback(Result.Status, user);
+    /* Sliders and the colour wheel set a variable on every step they are
+     * dragged. Only the latest value waiting to be sent is kept, and JIPd
+     * collapses those that reach the server close together. */
+    JIP_AjaxManager.addReq({
+        type: 'POST',
+        url: '/cgi-bin/JIP.cgi',
+        data: request,
+        coalesce: address + "/" + mib + "/" + variable,
+        batch: {
+            BRaddress: ActiveBorderRouter,
+            request: {action: "SetVar", nodeaddress: address, mib: mib, "var": variable, value: String(value)}
+        },
+        success: function(Result) {
+            callback(Result.Status, user);
+        },
+        superseded: function() {
+            callback({Value: 0, Description: "Superseded"}, user);
+        }
     });
 }
 
+
+
+/** Read the history JIPd keeps of a variable, over the last Range seconds.
+ *  If Points is given, the server thins the history to that many buckets.
+ *  The callback is given the status and an array of [time, min, max, avg]
+ *  buckets, time being the start of the bucket in seconds since 1970. */
+function JIP_GetHistory(address, mib, variable, Range, callback, user, Points)
+{
+    var request;
+    request = "action=history&nodeaddress=" + address;
+    request = request + "&mib=" + mib;
+    request = request + "&var=" + variable;
+    request = request + "&range=" + Range;
+    if (Points != undefined)
+    {
+        request = request + "&points=" + Points;
+    }
+    
+    JIP_CachedRequest(request, function(Result) {
+        var History = Result.History;
+        var Buckets = [];
+        if (History != undefined)
+        {
+            for (var i = 0; i < History.Offset.length; i++)
+            {
+                Buckets.push([History.Start + (History.Offset[i] * History.Resolution),
+                              History.Min[i], History.Max[i], History.Avg[i]]);
+            }
+        }
+        callback(Result.Status, user, Buckets);
+    });
+}